@@ -45,6 +45,207 @@
  *          Wei Fu (wfu@likewisesoftware.com)
  */
 #include "client.h"
+#include <poll.h>
+
+#ifdef HAVE_NONLIBPTHREAD_MUTEX_LOCK
+#include <pthread.h>
+#endif
+
+/* Number of idle connections kept for reuse per process */
+#define LSA_IPC_POOL_SIZE 4
+
+/*
+ * lsassd drops connections which have been idle for 10 seconds,
+ * so pooled connections are only reused well before that.
+ */
+#define LSA_IPC_POOL_MAX_IDLE_SECONDS 5
+
+/*
+ * Connections released by LsaCloseServer are kept here so that the
+ * next LsaOpenServer in the process can skip the connect, credential
+ * exchange and session handshake.  Each handle still has a connection
+ * to itself while it is open, so concurrent threads and the lwmsg
+ * handles they hold never share one.
+ */
+typedef struct _LSA_IPC_POOL
+{
+#ifdef HAVE_NONLIBPTHREAD_MUTEX_LOCK
+    pthread_mutex_t Lock;
+#endif
+    pid_t owner;
+    DWORD dwIdleCount;
+    PLSA_CLIENT_CONNECTION_CONTEXT Idle[LSA_IPC_POOL_SIZE];
+} LSA_IPC_POOL, *PLSA_IPC_POOL;
+
+#ifdef HAVE_NONLIBPTHREAD_MUTEX_LOCK
+static LSA_IPC_POOL gLsaIpcPool = { .Lock = PTHREAD_MUTEX_INITIALIZER };
+#define POOL_LOCK() pthread_mutex_lock(&gLsaIpcPool.Lock)
+#define POOL_UNLOCK() pthread_mutex_unlock(&gLsaIpcPool.Lock)
+#else
+static LSA_IPC_POOL gLsaIpcPool = { 0 };
+#define POOL_LOCK()
+#define POOL_UNLOCK()
+#endif
+
+static
+VOID
+LsaIpcFreeContext(
+    PLSA_CLIENT_CONNECTION_CONTEXT pContext,
+    BOOLEAN bClose
+    )
+{
+    if (pContext->pAssoc)
+    {
+        if (bClose)
+        {
+            (void) lwmsg_assoc_close(pContext->pAssoc);
+        }
+        lwmsg_assoc_delete(pContext->pAssoc);
+    }
+
+    if (pContext->pProtocol)
+    {
+        lwmsg_protocol_delete(pContext->pProtocol);
+    }
+
+    LwFreeMemory(pContext);
+}
+
+/*
+ * Nothing is ever sent to an idle connection, so anything pending on
+ * its socket means lsassd hung up (e.g. it was restarted) or is about
+ * to.  Such connections would fail the next call.
+ */
+static
+BOOLEAN
+LsaIpcPoolIsAlive(
+    PLSA_CLIENT_CONNECTION_CONTEXT pContext
+    )
+{
+    struct pollfd pfd = { 0 };
+
+    pfd.fd = lwmsg_connection_get_fd(pContext->pAssoc);
+    pfd.events = POLLIN;
+
+    return pfd.fd >= 0 && poll(&pfd, 1, 0) == 0;
+}
+
+/*
+ * Takes a connection established by this process with its current
+ * credentials from the pool, if there is one.  Connections inherited
+ * across a fork belong to the parent and are dropped without closing
+ * them, as LsaDropServer does.
+ */
+static
+PLSA_CLIENT_CONNECTION_CONTEXT
+LsaIpcPoolAcquire(
+    VOID
+    )
+{
+    PLSA_CLIENT_CONNECTION_CONTEXT pContext = NULL;
+    PLSA_CLIENT_CONNECTION_CONTEXT pCandidate = NULL;
+    PLSA_CLIENT_CONNECTION_CONTEXT stale[LSA_IPC_POOL_SIZE] = { NULL };
+    DWORD dwStaleCount = 0;
+    BOOLEAN bForked = FALSE;
+    pid_t pid = getpid();
+    time_t now = time(NULL);
+    DWORD dwIndex = 0;
+
+    POOL_LOCK();
+
+    if (gLsaIpcPool.owner != pid)
+    {
+        bForked = TRUE;
+        while (gLsaIpcPool.dwIdleCount > 0)
+        {
+            stale[dwStaleCount++] = gLsaIpcPool.Idle[--gLsaIpcPool.dwIdleCount];
+        }
+        gLsaIpcPool.owner = pid;
+    }
+
+    while (!pContext && gLsaIpcPool.dwIdleCount > 0)
+    {
+        pCandidate = gLsaIpcPool.Idle[--gLsaIpcPool.dwIdleCount];
+
+        if (now - pCandidate->idleSince > LSA_IPC_POOL_MAX_IDLE_SECONDS ||
+            now < pCandidate->idleSince ||
+            pCandidate->uid != geteuid() ||
+            pCandidate->gid != getegid() ||
+            !LsaIpcPoolIsAlive(pCandidate))
+        {
+            stale[dwStaleCount++] = pCandidate;
+        }
+        else
+        {
+            pContext = pCandidate;
+        }
+    }
+
+    POOL_UNLOCK();
+
+    for (dwIndex = 0; dwIndex < dwStaleCount; dwIndex++)
+    {
+        LsaIpcFreeContext(stale[dwIndex], !bForked);
+    }
+
+    return pContext;
+}
+
+/*
+ * Offers a connection back to the pool.  Returns FALSE if the
+ * connection is unhealthy, was inherited across a fork or the pool
+ * is full, in which case the caller disposes of it.
+ */
+static
+BOOLEAN
+LsaIpcPoolRelease(
+    PLSA_CLIENT_CONNECTION_CONTEXT pContext
+    )
+{
+    BOOLEAN bPooled = FALSE;
+
+    if (!pContext->pAssoc ||
+        pContext->owner != getpid() ||
+        lwmsg_assoc_get_state(pContext->pAssoc) != LWMSG_ASSOC_STATE_IDLE)
+    {
+        goto cleanup;
+    }
+
+    pContext->idleSince = time(NULL);
+
+    POOL_LOCK();
+
+    if (gLsaIpcPool.owner == pContext->owner &&
+        gLsaIpcPool.dwIdleCount < LSA_IPC_POOL_SIZE)
+    {
+        gLsaIpcPool.Idle[gLsaIpcPool.dwIdleCount++] = pContext;
+        bPooled = TRUE;
+    }
+
+    POOL_UNLOCK();
+
+cleanup:
+
+    return bPooled;
+}
+
+static
+VOID
+__attribute__((destructor))
+LsaIpcPoolShutdown(
+    VOID
+    )
+{
+    /* Don't wait on lsassd during exit; it notices the hangup */
+    POOL_LOCK();
+
+    while (gLsaIpcPool.dwIdleCount > 0)
+    {
+        LsaIpcFreeContext(gLsaIpcPool.Idle[--gLsaIpcPool.dwIdleCount], FALSE);
+    }
+
+    POOL_UNLOCK();
+}
 
 DWORD
 LsaOpenServer(
@@ -57,6 +258,13 @@ LsaOpenServer(
 
     BAIL_ON_INVALID_POINTER(phConnection);
 
+    pContext = LsaIpcPoolAcquire();
+    if (pContext)
+    {
+        *phConnection = (HANDLE)pContext;
+        goto cleanup;
+    }
+
     dwError = LwAllocateMemory(sizeof(LSA_CLIENT_CONNECTION_CONTEXT), (PVOID*)&pContext);
     BAIL_ON_LSA_ERROR(dwError);
 
@@ -92,6 +300,11 @@ LsaOpenServer(
     dwError = MAP_LWMSG_ERROR(lwmsg_assoc_get_session(pContext->pAssoc, &pContext->pSession));
     BAIL_ON_LSA_ERROR(dwError);
 
+    /* lsassd identifies the session by the credentials at connect time */
+    pContext->owner = getpid();
+    pContext->uid = geteuid();
+    pContext->gid = getegid();
+
     *phConnection = (HANDLE)pContext;
 
 cleanup:
@@ -100,17 +313,7 @@ cleanup:
 error:
     if (pContext)
     {
-        if (pContext->pAssoc)
-        {
-            lwmsg_assoc_delete(pContext->pAssoc);
-        }
-
-        if (pContext->pProtocol)
-        {
-            lwmsg_protocol_delete(pContext->pProtocol);
-        }
-
-        LwFreeMemory(pContext);
+        LsaIpcFreeContext(pContext, FALSE);
     }
 
     if (phConnection)
@@ -130,19 +333,11 @@ LsaCloseServer(
     PLSA_CLIENT_CONNECTION_CONTEXT pContext =
                      (PLSA_CLIENT_CONNECTION_CONTEXT)hConnection;
 
-    if (pContext->pAssoc)
+    if (!LsaIpcPoolRelease(pContext))
     {
-        (void) lwmsg_assoc_close(pContext->pAssoc);
-        lwmsg_assoc_delete(pContext->pAssoc);
+        LsaIpcFreeContext(pContext, TRUE);
     }
 
-    if (pContext->pProtocol)
-    {
-        lwmsg_protocol_delete(pContext->pProtocol);
-    }
-
-    LwFreeMemory(pContext);
-
     return dwError;
 }
 
@@ -155,17 +350,7 @@ LsaDropServer(
     PLSA_CLIENT_CONNECTION_CONTEXT pContext =
                      (PLSA_CLIENT_CONNECTION_CONTEXT)hConnection;
 
-    if (pContext->pAssoc)
-    {
-        lwmsg_assoc_delete(pContext->pAssoc);
-    }
-
-    if (pContext->pProtocol)
-    {
-        lwmsg_protocol_delete(pContext->pProtocol);
-    }
-
-    LwFreeMemory(pContext);
+    LsaIpcFreeContext(pContext, FALSE);
 
     return dwError;
 }
@@ -56,6 +56,12 @@ typedef struct __LSA_CLIENT_CONNECTION_CONTEXT
     LWMsgProtocol* pProtocol;
     LWMsgAssoc* pAssoc;
     LWMsgSession* pSession;
+    /* Process and credentials the connection was established with */
+    pid_t owner;
+    uid_t uid;
+    gid_t gid;
+    /* When the connection was returned to the pool */
+    time_t idleSince;
 } LSA_CLIENT_CONNECTION_CONTEXT, *PLSA_CLIENT_CONNECTION_CONTEXT;
 
 DWORD
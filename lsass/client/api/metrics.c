@@ -87,6 +87,10 @@ LsaGetMetrics(
                     *ppMetricPack = (PVOID*)pResult->pMetricPack.pMetricPack1;
                     pResult->pMetricPack.pMetricPack1 = NULL;
                     break;
+                case 2:
+                    *ppMetricPack = (PVOID*)pResult->pMetricPack.pMetricPack2;
+                    pResult->pMetricPack.pMetricPack2 = NULL;
+                    break;
                 default:
                    dwError = LW_ERROR_INVALID_PARAMETER;
                    BAIL_ON_LSA_ERROR(dwError);
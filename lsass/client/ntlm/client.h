@@ -53,15 +53,19 @@
 #include <pthread.h>
 #include <string.h>
 
+#include <openssl/rc4.h>
+
 #include <lsasystem.h>
 #include <lwdef.h>
 #include <lwmem.h>
+#include <lwhash.h>
 #include <lwsecurityidentifier.h>
 #include <lsautils.h>
 
 #include <ntlm/sspintlm.h>
 #include <ntlm/gssntlm.h>
 #include <ntlmipc.h>
+#include <ntlmsession.h>
 
 #include "defines.h"
 #include "structs.h"
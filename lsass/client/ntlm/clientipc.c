@@ -625,6 +625,123 @@ error:
     goto cleanup;
 }
 
+DWORD
+NtlmTransactExportSessionState(
+    IN NTLM_CONTEXT_HANDLE hContext,
+    OUT PNTLM_IPC_SESSION_STATE pState
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    NTLM_IPC_EXPORT_SESSION_STATE_REQ ExportSessionStateReq;
+    // Do not free pResult and pError
+    PNTLM_IPC_SESSION_STATE pResult = NULL;
+    PNTLM_IPC_ERROR pError = NULL;
+    LWMsgParams In = LWMSG_PARAMS_INITIALIZER;
+    LWMsgParams Out = LWMSG_PARAMS_INITIALIZER;
+    LWMsgCall* pCall = NULL;
+
+    dwError = NtlmIpcAcquireCall(&pCall);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    memset(&ExportSessionStateReq, 0, sizeof(ExportSessionStateReq));
+
+    ExportSessionStateReq.hContext = (LWMsgHandle*) hContext;
+
+    In.tag = NTLM_Q_EXPORT_SESSION_STATE;
+    In.data = &ExportSessionStateReq;
+
+    dwError = MAP_LWMSG_ERROR(
+        lwmsg_call_dispatch(pCall, &In, &Out, NULL, NULL));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    switch (Out.tag)
+    {
+        case NTLM_R_EXPORT_SESSION_STATE_SUCCESS:
+            pResult = (PNTLM_IPC_SESSION_STATE)Out.data;
+
+            memcpy(pState, pResult, sizeof(*pState));
+            memset(pResult, 0, sizeof(*pResult));
+
+            break;
+        case NTLM_R_GENERIC_FAILURE:
+            pError = (PNTLM_IPC_ERROR) Out.data;
+            dwError = pError->dwError;
+            BAIL_ON_LSA_ERROR(dwError);
+            break;
+        default:
+            dwError = LW_ERROR_INTERNAL;
+            BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+    if (pCall)
+    {
+        lwmsg_call_destroy_params(pCall, &Out);
+        lwmsg_call_release(pCall);
+    }
+
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+DWORD
+NtlmTransactImportSessionState(
+    IN NTLM_CONTEXT_HANDLE hContext,
+    IN const NTLM_IPC_SESSION_STATE* pState
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    NTLM_IPC_IMPORT_SESSION_STATE_REQ ImportSessionStateReq;
+    // Do not free pError
+    PNTLM_IPC_ERROR pError = NULL;
+    LWMsgParams In = LWMSG_PARAMS_INITIALIZER;
+    LWMsgParams Out = LWMSG_PARAMS_INITIALIZER;
+    LWMsgCall* pCall = NULL;
+
+    dwError = NtlmIpcAcquireCall(&pCall);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    ImportSessionStateReq.hContext = (LWMsgHandle*) hContext;
+    memcpy(&ImportSessionStateReq.State, pState, sizeof(*pState));
+
+    In.tag = NTLM_Q_IMPORT_SESSION_STATE;
+    In.data = &ImportSessionStateReq;
+
+    dwError = MAP_LWMSG_ERROR(
+        lwmsg_call_dispatch(pCall, &In, &Out, NULL, NULL));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    switch (Out.tag)
+    {
+        case NTLM_R_IMPORT_SESSION_STATE_SUCCESS:
+            break;
+        case NTLM_R_GENERIC_FAILURE:
+            pError = (PNTLM_IPC_ERROR) Out.data;
+            dwError = pError->dwError;
+            BAIL_ON_LSA_ERROR(dwError);
+            break;
+        default:
+            dwError = LW_ERROR_INTERNAL;
+            BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+    if (pCall)
+    {
+        lwmsg_call_destroy_params(pCall, &Out);
+        lwmsg_call_release(pCall);
+    }
+
+    memset(&ImportSessionStateReq, 0, sizeof(ImportSessionStateReq));
+
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
 DWORD
 NtlmTransactFreeCredentialsHandle(
     IN OUT NTLM_CRED_HANDLE hCredential
@@ -56,19 +56,34 @@ NtlmClientDecryptMessage(
     )
 {
     DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_CLIENT_SESSION pSession = NULL;
 
     BAIL_ON_INVALID_POINTER(phContext);
 
     *pbEncrypted = 0;
 
-    dwError = NtlmTransactDecryptMessage(
-        *phContext,
-        pMessage,
-        MessageSeqNo,
-        pbEncrypted);
+    pSession = NtlmLocalSessionAcquire(*phContext);
+    if (pSession)
+    {
+        dwError = NtlmLocalDecryptMessage(pSession, pMessage, pbEncrypted);
+    }
+
+    // The session may have been handed back to lsassd meanwhile
+    if (!pSession || dwError == LW_ERROR_NOT_HANDLED)
+    {
+        dwError = NtlmTransactDecryptMessage(
+            *phContext,
+            pMessage,
+            MessageSeqNo,
+            pbEncrypted);
+    }
     BAIL_ON_LSA_ERROR(dwError);
 
 cleanup:
+    if (pSession)
+    {
+        NtlmLocalSessionRelease(pSession);
+    }
     return(dwError);
 error:
     // we may not want to clear the IN OUT params on error
@@ -45,4 +45,7 @@
 #ifndef __DEFINES_H__
 #define __DEFINES_H__
 
+// Sent in place of the sealed random pad of an NTLM1 signature
+#define NTLM_COUNTER_VALUE              0x78010900
+
 #endif /* __DEFINES_H__ */
@@ -56,6 +56,8 @@ NtlmClientDeleteSecurityContext(
 
     BAIL_ON_INVALID_POINTER(phContext);
 
+    NtlmLocalSessionRemove(*phContext);
+
     dwError = NtlmTransactDeleteSecurityContext(*phContext);
 
 error:
@@ -56,17 +56,32 @@ NtlmClientEncryptMessage(
     )
 {
     DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_CLIENT_SESSION pSession = NULL;
 
     BAIL_ON_INVALID_POINTER(phContext);
 
-    dwError = NtlmTransactEncryptMessage(
-        *phContext,
-        bEncrypt,
-        pMessage,
-        MessageSeqNo);
+    pSession = NtlmLocalSessionAcquire(*phContext);
+    if (pSession)
+    {
+        dwError = NtlmLocalEncryptMessage(pSession, bEncrypt, pMessage);
+    }
+
+    // The session may have been handed back to lsassd meanwhile
+    if (!pSession || dwError == LW_ERROR_NOT_HANDLED)
+    {
+        dwError = NtlmTransactEncryptMessage(
+            *phContext,
+            bEncrypt,
+            pMessage,
+            MessageSeqNo);
+    }
     BAIL_ON_LSA_ERROR(dwError);
 
 cleanup:
+    if (pSession)
+    {
+        NtlmLocalSessionRelease(pSession);
+    }
     return(dwError);
 error:
     // we may not want to clear the IN OUT params on error
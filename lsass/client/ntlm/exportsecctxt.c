@@ -55,9 +55,21 @@ NtlmClientExportSecurityContext(
     )
 {
     DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_CLIENT_SESSION pSession = NULL;
 
     BAIL_ON_INVALID_POINTER(phContext);
 
+    // lsassd can only pack up the context once it has the current sealing
+    // state again
+    pSession = NtlmLocalSessionAcquire(*phContext);
+    if (pSession)
+    {
+        dwError = NtlmLocalSessionReturnState(pSession);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        NtlmLocalSessionRemove(*phContext);
+    }
+
     dwError = NtlmTransactExportSecurityContext(
         *phContext,
         fFlags,
@@ -65,5 +77,11 @@ NtlmClientExportSecurityContext(
     BAIL_ON_LSA_ERROR(dwError);
 
 error:
+
+    if (pSession)
+    {
+        NtlmLocalSessionRelease(pSession);
+    }
+
     return(dwError);
 }
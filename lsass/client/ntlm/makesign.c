@@ -56,16 +56,32 @@ NtlmClientMakeSignature(
     )
 {
     DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_CLIENT_SESSION pSession = NULL;
 
     BAIL_ON_INVALID_POINTER(phContext);
 
-    dwError = NtlmTransactMakeSignature(
-        *phContext,
-        dwQop,
-        pMessage,
-        MessageSeqNo);
+    pSession = NtlmLocalSessionAcquire(*phContext);
+    if (pSession)
+    {
+        dwError = NtlmLocalMakeSignature(pSession, pMessage);
+    }
+
+    // The session may have been handed back to lsassd meanwhile
+    if (!pSession || dwError == LW_ERROR_NOT_HANDLED)
+    {
+        dwError = NtlmTransactMakeSignature(
+            *phContext,
+            dwQop,
+            pMessage,
+            MessageSeqNo);
+    }
 
 error:
 
+    if (pSession)
+    {
+        NtlmLocalSessionRelease(pSession);
+    }
+
     return dwError;
 }
@@ -100,6 +100,18 @@ NtlmTransactExportSecurityContext(
     OUT PSecBuffer pPackedContext
     );
 
+DWORD
+NtlmTransactExportSessionState(
+    IN NTLM_CONTEXT_HANDLE hContext,
+    OUT PNTLM_IPC_SESSION_STATE pState
+    );
+
+DWORD
+NtlmTransactImportSessionState(
+    IN NTLM_CONTEXT_HANDLE hContext,
+    IN const NTLM_IPC_SESSION_STATE* pState
+    );
+
 DWORD
 NtlmTransactFreeCredentialsHandle(
     IN OUT NTLM_CRED_HANDLE hCredential
@@ -178,4 +190,87 @@ NtlmTransferSecBufferToDesc(
     BOOLEAN bDeepCopy
     );
 
+// session.c
+
+PNTLM_CLIENT_SESSION
+NtlmLocalSessionAcquire(
+    IN NTLM_CONTEXT_HANDLE hContext
+    );
+
+VOID
+NtlmLocalSessionRelease(
+    IN PNTLM_CLIENT_SESSION pSession
+    );
+
+VOID
+NtlmLocalSessionRemove(
+    IN NTLM_CONTEXT_HANDLE hContext
+    );
+
+DWORD
+NtlmLocalSessionReturnState(
+    IN PNTLM_CLIENT_SESSION pSession
+    );
+
+DWORD
+NtlmLocalMakeSignature(
+    IN PNTLM_CLIENT_SESSION pSession,
+    IN OUT PSecBufferDesc pMessage
+    );
+
+DWORD
+NtlmLocalVerifySignature(
+    IN PNTLM_CLIENT_SESSION pSession,
+    IN PSecBufferDesc pMessage,
+    OUT PDWORD pQop
+    );
+
+DWORD
+NtlmLocalEncryptMessage(
+    IN PNTLM_CLIENT_SESSION pSession,
+    IN BOOLEAN bEncrypt,
+    IN OUT PSecBufferDesc pMessage
+    );
+
+DWORD
+NtlmLocalDecryptMessage(
+    IN PNTLM_CLIENT_SESSION pSession,
+    IN OUT PSecBufferDesc pMessage,
+    OUT PBOOLEAN pbEncrypted
+    );
+
+DWORD
+NtlmLocalQueryContextAttributes(
+    IN PNTLM_CLIENT_SESSION pSession,
+    IN DWORD ulAttribute,
+    OUT PVOID pBuffer
+    );
+
+// sessionsec.c
+
+DWORD
+NtlmSecuritySign(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN OUT PSecBufferDesc pMessage
+    );
+
+DWORD
+NtlmSecurityVerify(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN const SecBufferDesc* pMessage
+    );
+
+DWORD
+NtlmSecuritySeal(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN BOOLEAN bEncrypt,
+    IN OUT PSecBufferDesc pMessage
+    );
+
+DWORD
+NtlmSecurityUnseal(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN OUT PSecBufferDesc pMessage
+    );
+
 #endif // __PROTOTYPES_H__
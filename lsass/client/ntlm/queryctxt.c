@@ -55,9 +55,23 @@ NtlmClientQueryContextAttributes(
     )
 {
     DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_CLIENT_SESSION pSession = NULL;
 
     BAIL_ON_INVALID_POINTER(phContext);
 
+    pSession = NtlmLocalSessionAcquire(*phContext);
+    if (pSession)
+    {
+        dwError = NtlmLocalQueryContextAttributes(
+            pSession,
+            ulAttribute,
+            pBuffer);
+        if (dwError != LW_ERROR_NOT_HANDLED)
+        {
+            goto error;
+        }
+    }
+
     dwError = NtlmTransactQueryContextAttributes(
         *phContext,
         ulAttribute,
@@ -65,5 +79,10 @@ NtlmClientQueryContextAttributes(
 
 error:
 
+    if (pSession)
+    {
+        NtlmLocalSessionRelease(pSession);
+    }
+
     return dwError;
 }
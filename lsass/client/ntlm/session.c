@@ -0,0 +1,507 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright Likewise Software    2004-2008
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the license, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.  You should have received a copy
+ * of the GNU Lesser General Public License along with this program.  If
+ * not, see <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * LESSER GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        session.c
+ *
+ * Abstract:
+ *
+ *        Likewise Security and Authentication Subsystem (LSASS)
+ *
+ *        In-process message signing and sealing (NTLM Client)
+ *
+ *        Once a context is established its signing keys, RC4 state and
+ *        sequence numbers can be moved out of lsassd so that MakeSignature,
+ *        VerifySignature, EncryptMessage and DecryptMessage no longer need
+ *        a round trip per message. The algorithms are in sessionsec.c.
+ *
+ */
+
+#include "client.h"
+
+#define NTLM_SESSION_TABLE_SIZE     61
+
+// Sessions by context handle. Lookups on the per-message paths only take
+// the lock shared.
+static PLW_HASH_TABLE gpSessionTable = NULL;
+static pthread_rwlock_t gSessionLock = PTHREAD_RWLOCK_INITIALIZER;
+
+static
+VOID
+NtlmLocalSessionFree(
+    IN PNTLM_CLIENT_SESSION pSession
+    )
+{
+    pthread_mutex_destroy(&pSession->Mutex);
+    LW_SECURE_FREE_MEMORY(pSession, sizeof(*pSession));
+}
+
+static
+VOID
+NtlmLocalImportRC4State(
+    IN const NTLM_IPC_RC4_STATE* pState,
+    OUT RC4_KEY* pKey
+    )
+{
+    DWORD dwIndex = 0;
+
+    pKey->x = pState->x;
+    pKey->y = pState->y;
+
+    for (dwIndex = 0; dwIndex < 256; dwIndex++)
+    {
+        pKey->data[dwIndex] = pState->data[dwIndex];
+    }
+}
+
+static
+VOID
+NtlmLocalExportRC4State(
+    IN const RC4_KEY* pKey,
+    OUT PNTLM_IPC_RC4_STATE pState
+    )
+{
+    DWORD dwIndex = 0;
+
+    pState->x = pKey->x;
+    pState->y = pKey->y;
+
+    for (dwIndex = 0; dwIndex < 256; dwIndex++)
+    {
+        pState->data[dwIndex] = pKey->data[dwIndex];
+    }
+}
+
+static
+DWORD
+NtlmLocalSessionInsert(
+    IN PNTLM_CLIENT_SESSION pSession
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    size_t sTableSize = 0;
+
+    pthread_rwlock_wrlock(&gSessionLock);
+
+    if (!gpSessionTable)
+    {
+        dwError = LwHashCreate(
+                      NTLM_SESSION_TABLE_SIZE,
+                      LwHashPVoidCompare,
+                      LwHashPVoidHash,
+                      NULL,
+                      NULL,
+                      &gpSessionTable);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    if (LwHashExists(gpSessionTable, pSession->hContext))
+    {
+        dwError = LW_ERROR_INVALID_CONTEXT;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    // The table does not grow by itself
+    sTableSize = gpSessionTable->sTableSize;
+    if (LwHashGetKeyCount(gpSessionTable) >= sTableSize * 2)
+    {
+        dwError = LwHashResize(gpSessionTable, sTableSize * 4 + 1);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    dwError = LwHashSetValue(gpSessionTable, pSession->hContext, pSession);
+    BAIL_ON_LSA_ERROR(dwError);
+
+error:
+
+    pthread_rwlock_unlock(&gSessionLock);
+
+    return dwError;
+}
+
+PNTLM_CLIENT_SESSION
+NtlmLocalSessionAcquire(
+    IN NTLM_CONTEXT_HANDLE hContext
+    )
+{
+    PNTLM_CLIENT_SESSION pSession = NULL;
+
+    pthread_rwlock_rdlock(&gSessionLock);
+
+    if (gpSessionTable &&
+        LwHashGetValue(
+            gpSessionTable,
+            hContext,
+            OUT_PPVOID(&pSession)) == LW_ERROR_SUCCESS)
+    {
+        pthread_mutex_lock(&pSession->Mutex);
+        pSession->nRefCount++;
+        pthread_mutex_unlock(&pSession->Mutex);
+    }
+    else
+    {
+        pSession = NULL;
+    }
+
+    pthread_rwlock_unlock(&gSessionLock);
+
+    return pSession;
+}
+
+VOID
+NtlmLocalSessionRelease(
+    IN PNTLM_CLIENT_SESSION pSession
+    )
+{
+    BOOLEAN bFree = FALSE;
+
+    if (pSession)
+    {
+        // Once the table has dropped its reference nobody can find the
+        // session any more, so the last holder can free it unlocked
+        pthread_mutex_lock(&pSession->Mutex);
+        bFree = (--pSession->nRefCount == 0);
+        pthread_mutex_unlock(&pSession->Mutex);
+
+        if (bFree)
+        {
+            NtlmLocalSessionFree(pSession);
+        }
+    }
+}
+
+VOID
+NtlmLocalSessionRemove(
+    IN NTLM_CONTEXT_HANDLE hContext
+    )
+{
+    PNTLM_CLIENT_SESSION pSession = NULL;
+
+    pthread_rwlock_wrlock(&gSessionLock);
+
+    if (gpSessionTable &&
+        LwHashGetValue(
+            gpSessionTable,
+            hContext,
+            OUT_PPVOID(&pSession)) == LW_ERROR_SUCCESS)
+    {
+        LwHashRemoveKey(gpSessionTable, hContext);
+    }
+    else
+    {
+        pSession = NULL;
+    }
+
+    pthread_rwlock_unlock(&gSessionLock);
+
+    // Drops the table's reference
+    NtlmLocalSessionRelease(pSession);
+}
+
+DWORD
+NtlmClientEnableLocalSessionSecurity(
+    IN PNTLM_CONTEXT_HANDLE phContext
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    NTLM_CONTEXT_HANDLE hContext = NULL;
+    PNTLM_CLIENT_SESSION pSession = NULL;
+    NTLM_IPC_SESSION_STATE State;
+    BOOLEAN bExported = FALSE;
+
+    memset(&State, 0, sizeof(State));
+
+    BAIL_ON_INVALID_POINTER(phContext);
+    hContext = *phContext;
+
+    dwError = LwAllocateMemory(sizeof(*pSession), OUT_PPVOID(&pSession));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pthread_mutex_init(&pSession->Mutex, NULL);
+
+    dwError = NtlmTransactExportSessionState(hContext, &State);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    bExported = TRUE;
+
+    pSession->hContext = hContext;
+    // Owned by the table
+    pSession->nRefCount = 1;
+    pSession->ContextFlags = State.ContextFlags;
+    pSession->Sizes.cbMaxToken = State.cbMaxToken;
+    pSession->Sizes.cbMaxSignature = State.cbMaxSignature;
+    pSession->Sizes.cbBlockSize = State.cbBlockSize;
+    pSession->Sizes.cbSecurityTrailer = State.cbSecurityTrailer;
+
+    memcpy(pSession->SignKey, State.SignKey, sizeof(pSession->SignKey));
+    memcpy(pSession->VerifyKey, State.VerifyKey, sizeof(pSession->VerifyKey));
+
+    NtlmLocalImportRC4State(&State.SealKey, &pSession->SealKey);
+    NtlmLocalImportRC4State(&State.UnsealKey, &pSession->UnsealKey);
+
+    pSession->dwSendMsgSeq = State.dwSendMsgSeq;
+    pSession->dwRecvMsgSeq = State.dwRecvMsgSeq;
+
+    pSession->Security.NegotiatedFlags = State.NegotiatedFlags;
+    pSession->Security.pSignKey = pSession->SignKey;
+    pSession->Security.pVerifyKey = pSession->VerifyKey;
+    pSession->Security.pSealKey = &pSession->SealKey;
+    pSession->Security.pdwSendMsgSeq = &pSession->dwSendMsgSeq;
+
+    if (State.bSharedState)
+    {
+        pSession->Security.pUnsealKey = &pSession->SealKey;
+        pSession->Security.pdwRecvMsgSeq = &pSession->dwSendMsgSeq;
+    }
+    else
+    {
+        pSession->Security.pUnsealKey = &pSession->UnsealKey;
+        pSession->Security.pdwRecvMsgSeq = &pSession->dwRecvMsgSeq;
+    }
+
+    pSession->bSharedState = State.bSharedState;
+
+    dwError = NtlmLocalSessionInsert(pSession);
+    BAIL_ON_LSA_ERROR(dwError);
+
+cleanup:
+
+    memset(&State, 0, sizeof(State));
+
+    return dwError;
+
+error:
+
+    if (pSession)
+    {
+        if (bExported)
+        {
+            // lsassd believes we hold the state now, so give it back
+            NtlmLocalSessionReturnState(pSession);
+        }
+        NtlmLocalSessionFree(pSession);
+    }
+
+    goto cleanup;
+}
+
+/*
+ * Hands the sealing state back to lsassd so that the context can be
+ * exported or used through IPC again. Later per-message calls on this
+ * session get LW_ERROR_NOT_HANDLED and go to lsassd.
+ */
+DWORD
+NtlmLocalSessionReturnState(
+    IN PNTLM_CLIENT_SESSION pSession
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    NTLM_IPC_SESSION_STATE State;
+
+    memset(&State, 0, sizeof(State));
+
+    pthread_mutex_lock(&pSession->Mutex);
+
+    if (pSession->bReturned)
+    {
+        goto cleanup;
+    }
+
+    State.NegotiatedFlags = pSession->Security.NegotiatedFlags;
+    State.bSharedState = pSession->bSharedState;
+
+    NtlmLocalExportRC4State(&pSession->SealKey, &State.SealKey);
+    NtlmLocalExportRC4State(&pSession->UnsealKey, &State.UnsealKey);
+
+    State.dwSendMsgSeq = pSession->dwSendMsgSeq;
+    State.dwRecvMsgSeq = pSession->dwRecvMsgSeq;
+
+    dwError = NtlmTransactImportSessionState(pSession->hContext, &State);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pSession->bReturned = TRUE;
+
+cleanup:
+
+    pthread_mutex_unlock(&pSession->Mutex);
+
+    memset(&State, 0, sizeof(State));
+
+    return dwError;
+
+error:
+
+    goto cleanup;
+}
+
+DWORD
+NtlmLocalMakeSignature(
+    IN PNTLM_CLIENT_SESSION pSession,
+    IN OUT PSecBufferDesc pMessage
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+
+    pthread_mutex_lock(&pSession->Mutex);
+
+    if (pSession->bReturned)
+    {
+        dwError = LW_ERROR_NOT_HANDLED;
+    }
+    else
+    {
+        dwError = NtlmSecuritySign(&pSession->Security, pMessage);
+    }
+
+    pthread_mutex_unlock(&pSession->Mutex);
+
+    return dwError;
+}
+
+DWORD
+NtlmLocalVerifySignature(
+    IN PNTLM_CLIENT_SESSION pSession,
+    IN PSecBufferDesc pMessage,
+    OUT PDWORD pQop
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+
+    pthread_mutex_lock(&pSession->Mutex);
+
+    if (pSession->bReturned)
+    {
+        dwError = LW_ERROR_NOT_HANDLED;
+    }
+    else
+    {
+        dwError = NtlmSecurityVerify(&pSession->Security, pMessage);
+    }
+
+    pthread_mutex_unlock(&pSession->Mutex);
+
+    if (pQop)
+    {
+        *pQop = 0;
+    }
+
+    return dwError;
+}
+
+DWORD
+NtlmLocalEncryptMessage(
+    IN PNTLM_CLIENT_SESSION pSession,
+    IN BOOLEAN bEncrypt,
+    IN OUT PSecBufferDesc pMessage
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+
+    pthread_mutex_lock(&pSession->Mutex);
+
+    if (pSession->bReturned)
+    {
+        dwError = LW_ERROR_NOT_HANDLED;
+    }
+    else
+    {
+        dwError = NtlmSecuritySeal(
+                      &pSession->Security,
+                      bEncrypt,
+                      pMessage);
+    }
+
+    pthread_mutex_unlock(&pSession->Mutex);
+
+    return dwError;
+}
+
+DWORD
+NtlmLocalDecryptMessage(
+    IN PNTLM_CLIENT_SESSION pSession,
+    IN OUT PSecBufferDesc pMessage,
+    OUT PBOOLEAN pbEncrypted
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+
+    pthread_mutex_lock(&pSession->Mutex);
+
+    if (pSession->bReturned)
+    {
+        dwError = LW_ERROR_NOT_HANDLED;
+    }
+    else
+    {
+        dwError = NtlmSecurityUnseal(&pSession->Security, pMessage);
+    }
+
+    pthread_mutex_unlock(&pSession->Mutex);
+
+    if (pbEncrypted)
+    {
+        *pbEncrypted = TRUE;
+    }
+
+    return dwError;
+}
+
+/*
+ * Answers the attributes which the per-message paths query every time.
+ * Anything else still goes to lsassd.
+ */
+DWORD
+NtlmLocalQueryContextAttributes(
+    IN PNTLM_CLIENT_SESSION pSession,
+    IN DWORD ulAttribute,
+    OUT PVOID pBuffer
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+
+    switch (ulAttribute)
+    {
+        case SECPKG_ATTR_SIZES:
+            *(PSecPkgContext_Sizes)pBuffer = pSession->Sizes;
+            break;
+        case SECPKG_ATTR_FLAGS:
+            ((PSecPkgContext_Flags)pBuffer)->Flags = pSession->ContextFlags;
+            break;
+        default:
+            dwError = LW_ERROR_NOT_HANDLED;
+            break;
+    }
+
+    return dwError;
+}
@@ -0,0 +1,453 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright Likewise Software    2004-2008
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the license, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.  You should have received a copy
+ * of the GNU Lesser General Public License along with this program.  If
+ * not, see <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * LESSER GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        sessionsec.c
+ *
+ * Abstract:
+ *
+ *        Likewise Security and Authentication Subsystem (LSASS)
+ *
+ *        NTLM session security for in-process sessions (NTLM Client)
+ *
+ *        Message signatures and sealing as described in [MS-NLMP] 3.4.3
+ *        and 3.4.4. The output must match what lsassd produces for the
+ *        same context, since the state can be handed back to it.
+ *
+ */
+
+#include "client.h"
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+// Returns the signature token of a message after checking that the message
+// carries data to sign. Nothing is changed, so a refused message leaves the
+// sequence numbers alone.
+static
+DWORD
+NtlmSecurityGetSignature(
+    IN const SecBufferDesc* pMessage,
+    OUT PNTLM_SIGNATURE* ppSignature
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_SIGNATURE pSignature = NULL;
+    BOOLEAN bHaveData = FALSE;
+    ULONG ulIndex = 0;
+    // Do not free
+    const SecBuffer* pBuffer = NULL;
+
+    for (ulIndex = 0; ulIndex < pMessage->cBuffers; ulIndex++)
+    {
+        pBuffer = &pMessage->pBuffers[ulIndex];
+
+        if (pBuffer->BufferType == SECBUFFER_TOKEN)
+        {
+            if (!pSignature)
+            {
+                if (pBuffer->cbBuffer != sizeof(NTLM_SIGNATURE) ||
+                    !pBuffer->pvBuffer)
+                {
+                    dwError = LW_ERROR_INVALID_PARAMETER;
+                    BAIL_ON_LSA_ERROR(dwError);
+                }
+
+                pSignature = pBuffer->pvBuffer;
+            }
+        }
+        else if ((pBuffer->BufferType & ~SECBUFFER_ATTRMASK) == SECBUFFER_DATA)
+        {
+            if (!pBuffer->pvBuffer)
+            {
+                dwError = LW_ERROR_INVALID_PARAMETER;
+                BAIL_ON_LSA_ERROR(dwError);
+            }
+
+            bHaveData = TRUE;
+        }
+    }
+
+    if (!pSignature || !bHaveData)
+    {
+        dwError = LW_ERROR_INVALID_PARAMETER;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    *ppSignature = pSignature;
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    *ppSignature = NULL;
+
+    goto cleanup;
+}
+
+// Runs RC4 over the data buffers of a message in place
+static
+VOID
+NtlmSecurityCryptData(
+    IN RC4_KEY* pKey,
+    IN OUT PSecBufferDesc pMessage
+    )
+{
+    ULONG ulIndex = 0;
+
+    for (ulIndex = 0; ulIndex < pMessage->cBuffers; ulIndex++)
+    {
+        if (pMessage->pBuffers[ulIndex].BufferType == SECBUFFER_DATA)
+        {
+            RC4(pKey,
+                pMessage->pBuffers[ulIndex].cbBuffer,
+                pMessage->pBuffers[ulIndex].pvBuffer,
+                pMessage->pBuffers[ulIndex].pvBuffer);
+        }
+    }
+}
+
+// The first eight bytes of HMAC_MD5(key, seqnum + data), which is the
+// checksum with extended session security
+static
+VOID
+NtlmSecurityHmac(
+    IN const BYTE* pKey,
+    IN DWORD dwSeqNum,
+    IN const SecBufferDesc* pMessage,
+    OUT BYTE Checksum[8]
+    )
+{
+    HMAC_CTX HmacCtx;
+    BYTE Digest[EVP_MAX_MD_SIZE] = {0};
+    unsigned int DigestLen = sizeof(Digest);
+    ULONG ulIndex = 0;
+
+    memset(&HmacCtx, 0, sizeof(HmacCtx));
+
+    HMAC_CTX_init(&HmacCtx);
+    HMAC_Init_ex(&HmacCtx,
+                 pKey, NTLM_SESSION_SIGN_KEY_SIZE,
+                 EVP_md5(), NULL);
+
+    HMAC_Update(&HmacCtx, (PBYTE)&dwSeqNum, sizeof(dwSeqNum));
+
+    for (ulIndex = 0; ulIndex < pMessage->cBuffers; ulIndex++)
+    {
+        if ((pMessage->pBuffers[ulIndex].BufferType & ~SECBUFFER_ATTRMASK) ==
+                SECBUFFER_DATA)
+        {
+            HMAC_Update(&HmacCtx,
+                        pMessage->pBuffers[ulIndex].pvBuffer,
+                        pMessage->pBuffers[ulIndex].cbBuffer);
+        }
+    }
+
+    HMAC_Final(&HmacCtx, Digest, &DigestLen);
+    HMAC_CTX_cleanup(&HmacCtx);
+
+    memcpy(Checksum, Digest, 8);
+}
+
+// Fills in the plain signature for the next outgoing message. Sealing
+// the data, if any, has to happen before NtlmSecuritySealSignature.
+static
+DWORD
+NtlmSecurityComputeSignature(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN const SecBufferDesc* pMessage,
+    OUT PNTLM_SIGNATURE pSignature
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    DWORD dwSeqNum = *pSecurity->pdwSendMsgSeq;
+    DWORD dwCrc32 = 0;
+
+    memset(pSignature, 0, sizeof(*pSignature));
+    pSignature->dwVersion = NTLM_VERSION;
+
+    if (pSecurity->NegotiatedFlags & NTLM_FLAG_NTLM2)
+    {
+        NtlmSecurityHmac(
+            pSecurity->pSignKey,
+            dwSeqNum,
+            pMessage,
+            pSignature->v2.encrypted.hmac);
+        pSignature->v2.dwMsgSeqNum = dwSeqNum;
+    }
+    else
+    {
+        dwError = NtlmCrc32(pMessage, &dwCrc32);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        pSignature->v1.encrypted.dwCrc32 = dwCrc32;
+        pSignature->v1.encrypted.dwMsgSeqNum = dwSeqNum;
+    }
+
+    (*pSecurity->pdwSendMsgSeq)++;
+
+error:
+
+    return dwError;
+}
+
+static
+VOID
+NtlmSecuritySealSignature(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN OUT PNTLM_SIGNATURE pSignature
+    )
+{
+    if (pSecurity->NegotiatedFlags & NTLM_FLAG_NTLM2)
+    {
+        // The checksum is only sealed when a key was exchanged
+        if (pSecurity->NegotiatedFlags & NTLM_FLAG_KEY_EXCH)
+        {
+            RC4(pSecurity->pSealKey,
+                sizeof(pSignature->v2.encrypted.hmac),
+                pSignature->v2.encrypted.hmac,
+                pSignature->v2.encrypted.hmac);
+        }
+    }
+    else
+    {
+        RC4(pSecurity->pSealKey,
+            sizeof(pSignature->v1.encrypted),
+            (PBYTE)&pSignature->v1.encrypted,
+            (PBYTE)&pSignature->v1.encrypted);
+
+        // Windows sends this in place of the sealed random pad
+        pSignature->v1.encrypted.dwCounterValue = NTLM_COUNTER_VALUE;
+    }
+}
+
+// Checks the signature of an incoming message whose data is already
+// unsealed, and moves the receive sequence number on if it matches
+static
+DWORD
+NtlmSecurityCheckSignature(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN const SecBufferDesc* pMessage,
+    IN const NTLM_SIGNATURE* pReceived
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    NTLM_SIGNATURE Received = *pReceived;
+    BYTE Expected[8] = {0};
+    DWORD dwCrc32 = 0;
+
+    if (pSecurity->NegotiatedFlags & NTLM_FLAG_NTLM2)
+    {
+        if (!(pSecurity->NegotiatedFlags & NTLM_FLAG_SIGN))
+        {
+            dwError = LW_ERROR_INVALID_PARAMETER;
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+
+        if (pSecurity->NegotiatedFlags & NTLM_FLAG_KEY_EXCH)
+        {
+            RC4(pSecurity->pUnsealKey,
+                sizeof(Received.v2.encrypted.hmac),
+                Received.v2.encrypted.hmac,
+                Received.v2.encrypted.hmac);
+        }
+
+        NtlmSecurityHmac(
+            pSecurity->pVerifyKey,
+            Received.v2.dwMsgSeqNum,
+            pMessage,
+            Expected);
+
+        if (memcmp(Expected, Received.v2.encrypted.hmac, sizeof(Expected)))
+        {
+            dwError = ERROR_CRC;
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+    }
+    else
+    {
+        RC4(pSecurity->pUnsealKey,
+            sizeof(Received.v1.encrypted),
+            (PBYTE)&Received.v1.encrypted,
+            (PBYTE)&Received.v1.encrypted);
+
+        if (pSecurity->NegotiatedFlags & NTLM_FLAG_ALWAYS_SIGN)
+        {
+            // The peer sends the dummy signature, with a zero checksum
+            dwCrc32 = 0;
+        }
+        else if (pSecurity->NegotiatedFlags & NTLM_FLAG_SIGN)
+        {
+            dwError = NtlmCrc32(pMessage, &dwCrc32);
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+        else
+        {
+            dwError = LW_ERROR_INVALID_PARAMETER;
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+
+        if (dwCrc32 != Received.v1.encrypted.dwCrc32)
+        {
+            dwError = ERROR_CRC;
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+    }
+
+    // Both layouts keep the sequence number in the last four bytes
+    if (Received.v2.dwMsgSeqNum != *pSecurity->pdwRecvMsgSeq)
+    {
+        dwError = ERROR_REQUEST_OUT_OF_SEQUENCE;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    (*pSecurity->pdwRecvMsgSeq)++;
+
+error:
+
+    return dwError;
+}
+
+DWORD
+NtlmSecuritySign(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN OUT PSecBufferDesc pMessage
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_SIGNATURE pSignature = NULL;
+
+    dwError = NtlmSecurityGetSignature(pMessage, &pSignature);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (pSecurity->NegotiatedFlags & NTLM_FLAG_ALWAYS_SIGN)
+    {
+        // Dummy signature: version 1 followed by zeros
+        memset(pSignature, 0, sizeof(*pSignature));
+        pSignature->dwVersion = NTLM_VERSION;
+    }
+    else if (pSecurity->NegotiatedFlags & NTLM_FLAG_SIGN)
+    {
+        dwError = NtlmSecurityComputeSignature(pSecurity, pMessage, pSignature);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        NtlmSecuritySealSignature(pSecurity, pSignature);
+    }
+    else
+    {
+        dwError = LW_ERROR_INVALID_PARAMETER;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+error:
+
+    return dwError;
+}
+
+DWORD
+NtlmSecurityVerify(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN const SecBufferDesc* pMessage
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_SIGNATURE pSignature = NULL;
+
+    dwError = NtlmSecurityGetSignature(pMessage, &pSignature);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = NtlmSecurityCheckSignature(pSecurity, pMessage, pSignature);
+    BAIL_ON_LSA_ERROR(dwError);
+
+error:
+
+    return dwError;
+}
+
+DWORD
+NtlmSecuritySeal(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN BOOLEAN bEncrypt,
+    IN OUT PSecBufferDesc pMessage
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_SIGNATURE pSignature = NULL;
+
+    if (bEncrypt && !(pSecurity->NegotiatedFlags & NTLM_FLAG_SEAL))
+    {
+        dwError = LW_ERROR_INVALID_PARAMETER;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    dwError = NtlmSecurityGetSignature(pMessage, &pSignature);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    // The signature covers the plain text. The data is sealed even when
+    // the caller did not ask for it, as Windows does.
+    dwError = NtlmSecurityComputeSignature(pSecurity, pMessage, pSignature);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    NtlmSecurityCryptData(pSecurity->pSealKey, pMessage);
+
+    NtlmSecuritySealSignature(pSecurity, pSignature);
+
+error:
+
+    return dwError;
+}
+
+DWORD
+NtlmSecurityUnseal(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN OUT PSecBufferDesc pMessage
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_SIGNATURE pSignature = NULL;
+
+    dwError = NtlmSecurityGetSignature(pMessage, &pSignature);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    NtlmSecurityCryptData(pSecurity->pUnsealKey, pMessage);
+
+    dwError = NtlmSecurityCheckSignature(pSecurity, pMessage, pSignature);
+    BAIL_ON_LSA_ERROR(dwError);
+
+error:
+
+    return dwError;
+}
@@ -51,4 +51,30 @@ typedef struct __NTLM_CLIENT_CONNECTION_CONTEXT
     LWMsgAssoc* pAssoc;
 } NTLM_CLIENT_CONNECTION_CONTEXT, *PNTLM_CLIENT_CONNECTION_CONTEXT;
 
+// Sealing state of a context whose per-message operations run in-process
+// once NtlmClientEnableLocalSessionSecurity has succeeded
+typedef struct __NTLM_CLIENT_SESSION
+{
+    NTLM_CONTEXT_HANDLE hContext;
+    // Protected by Mutex, as is everything below
+    LONG nRefCount;
+    pthread_mutex_t Mutex;
+    // Set once the state has been handed back to lsassd
+    BOOLEAN bReturned;
+
+    DWORD ContextFlags;
+    SecPkgContext_Sizes Sizes;
+
+    BYTE SignKey[NTLM_IPC_SESSION_KEY_SIZE];
+    BYTE VerifyKey[NTLM_IPC_SESSION_KEY_SIZE];
+    RC4_KEY SealKey;
+    RC4_KEY UnsealKey;
+    DWORD dwSendMsgSeq;
+    DWORD dwRecvMsgSeq;
+    BOOLEAN bSharedState;
+
+    // Points at the fields above
+    NTLM_SESSION_SECURITY Security;
+} NTLM_CLIENT_SESSION, *PNTLM_CLIENT_SESSION;
+
 #endif /* __STRUCTS_H__ */
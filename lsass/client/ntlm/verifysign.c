@@ -56,19 +56,34 @@ NtlmClientVerifySignature(
     )
 {
     DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_CLIENT_SESSION pSession = NULL;
 
     BAIL_ON_INVALID_POINTER(phContext);
 
     *pQop = 0;
 
-    dwError = NtlmTransactVerifySignature(
-        *phContext,
-        pMessage,
-        MessageSeqNo,
-        pQop);
+    pSession = NtlmLocalSessionAcquire(*phContext);
+    if (pSession)
+    {
+        dwError = NtlmLocalVerifySignature(pSession, pMessage, pQop);
+    }
+
+    // The session may have been handed back to lsassd meanwhile
+    if (!pSession || dwError == LW_ERROR_NOT_HANDLED)
+    {
+        dwError = NtlmTransactVerifySignature(
+            *phContext,
+            pMessage,
+            MessageSeqNo,
+            pQop);
+    }
     BAIL_ON_LSA_ERROR(dwError);
 
 cleanup:
+    if (pSession)
+    {
+        NtlmLocalSessionRelease(pSession);
+    }
     return(dwError);
 error:
     *pQop = 0;
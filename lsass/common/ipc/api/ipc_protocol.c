@@ -247,8 +247,20 @@ static LWMsgTypeSpec gLsaMetricPack1Spec[] =
     LWMSG_TYPE_END
 };
 
+static LWMsgTypeSpec gLsaMetricPack2Spec[] =
+{
+    LWMSG_STRUCT_BEGIN(LSA_METRIC_PACK_2),
+    LWMSG_MEMBER_TYPESPEC(LSA_METRIC_PACK_2, pack1, gLsaMetricPack1Spec),
+    LWMSG_MEMBER_UINT64(LSA_METRIC_PACK_2, coalescedLookups),
+    LWMSG_MEMBER_UINT64(LSA_METRIC_PACK_2, mergedLookups),
+    LWMSG_MEMBER_UINT64(LSA_METRIC_PACK_2, mergedLookupBatches),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
 #define METRIC_INFO_LEVEL_0 0
 #define METRIC_INFO_LEVEL_1 1
+#define METRIC_INFO_LEVEL_2 2
 
 static LWMsgTypeSpec gLsaMetricPackSpec[] =
 {
@@ -263,6 +275,10 @@ static LWMsgTypeSpec gLsaMetricPackSpec[] =
     LWMSG_TYPESPEC(gLsaMetricPack1Spec),
     LWMSG_POINTER_END,
     LWMSG_ATTR_TAG(METRIC_INFO_LEVEL_1),
+    LWMSG_MEMBER_POINTER_BEGIN(union _METRIC_PACK, pMetricPack2),
+    LWMSG_TYPESPEC(gLsaMetricPack2Spec),
+    LWMSG_POINTER_END,
+    LWMSG_ATTR_TAG(METRIC_INFO_LEVEL_2),
     LWMSG_UNION_END,
     LWMSG_ATTR_DISCRIM(LSA_METRIC_PACK, dwInfoLevel),
     LWMSG_STRUCT_END,
@@ -878,6 +878,81 @@ static LWMsgTypeSpec gNtlmVerifySignRespSpec[] =
 
 /******************************************************************************/
 
+static LWMsgTypeSpec gNtlmExportSessionStateSpec[] =
+{
+    // NTLM_CONTEXT_HANDLE hContext;
+
+    LWMSG_STRUCT_BEGIN(NTLM_IPC_EXPORT_SESSION_STATE_REQ),
+
+    LWMSG_MEMBER_HANDLE(NTLM_IPC_EXPORT_SESSION_STATE_REQ, hContext, NTLM_CONTEXT_HANDLE),
+    LWMSG_ATTR_HANDLE_LOCAL_FOR_RECEIVER,
+
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec gNtlmRC4StateSpec[] =
+{
+    LWMSG_STRUCT_BEGIN(NTLM_IPC_RC4_STATE),
+    LWMSG_MEMBER_UINT32(NTLM_IPC_RC4_STATE, x),
+    LWMSG_MEMBER_UINT32(NTLM_IPC_RC4_STATE, y),
+    LWMSG_MEMBER_ARRAY(NTLM_IPC_RC4_STATE, data, LWMSG_UINT32(DWORD)),
+    LWMSG_ATTR_LENGTH_STATIC(256),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec gNtlmSessionStateSpec[] =
+{
+    LWMSG_STRUCT_BEGIN(NTLM_IPC_SESSION_STATE),
+
+    LWMSG_MEMBER_UINT32(NTLM_IPC_SESSION_STATE, NegotiatedFlags),
+    LWMSG_MEMBER_UINT32(NTLM_IPC_SESSION_STATE, ContextFlags),
+    LWMSG_MEMBER_UINT32(NTLM_IPC_SESSION_STATE, cbMaxToken),
+    LWMSG_MEMBER_UINT32(NTLM_IPC_SESSION_STATE, cbMaxSignature),
+    LWMSG_MEMBER_UINT32(NTLM_IPC_SESSION_STATE, cbBlockSize),
+    LWMSG_MEMBER_UINT32(NTLM_IPC_SESSION_STATE, cbSecurityTrailer),
+
+    LWMSG_MEMBER_ARRAY(NTLM_IPC_SESSION_STATE, SignKey, LWMSG_UINT8(BYTE)),
+    LWMSG_ATTR_SENSITIVE,
+    LWMSG_ATTR_LENGTH_STATIC(NTLM_IPC_SESSION_KEY_SIZE),
+
+    LWMSG_MEMBER_ARRAY(NTLM_IPC_SESSION_STATE, VerifyKey, LWMSG_UINT8(BYTE)),
+    LWMSG_ATTR_SENSITIVE,
+    LWMSG_ATTR_LENGTH_STATIC(NTLM_IPC_SESSION_KEY_SIZE),
+
+    LWMSG_MEMBER_TYPESPEC(NTLM_IPC_SESSION_STATE, SealKey, gNtlmRC4StateSpec),
+    LWMSG_ATTR_SENSITIVE,
+
+    LWMSG_MEMBER_TYPESPEC(NTLM_IPC_SESSION_STATE, UnsealKey, gNtlmRC4StateSpec),
+    LWMSG_ATTR_SENSITIVE,
+
+    LWMSG_MEMBER_UINT32(NTLM_IPC_SESSION_STATE, dwSendMsgSeq),
+    LWMSG_MEMBER_UINT32(NTLM_IPC_SESSION_STATE, dwRecvMsgSeq),
+    LWMSG_MEMBER_UINT32(NTLM_IPC_SESSION_STATE, bSharedState),
+
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec gNtlmImportSessionStateSpec[] =
+{
+    // NTLM_CONTEXT_HANDLE hContext;
+    // NTLM_IPC_SESSION_STATE State;
+
+    LWMSG_STRUCT_BEGIN(NTLM_IPC_IMPORT_SESSION_STATE_REQ),
+
+    LWMSG_MEMBER_HANDLE(NTLM_IPC_IMPORT_SESSION_STATE_REQ, hContext, NTLM_CONTEXT_HANDLE),
+    LWMSG_ATTR_HANDLE_LOCAL_FOR_RECEIVER,
+
+    LWMSG_MEMBER_TYPESPEC(NTLM_IPC_IMPORT_SESSION_STATE_REQ, State, gNtlmSessionStateSpec),
+
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+/******************************************************************************/
+
 static LWMsgProtocolSpec gNtlmIpcSpec[] =
 {
     LWMSG_MESSAGE(NTLM_R_GENERIC_FAILURE, gNtlmIpcErrorSpec),
@@ -924,6 +999,12 @@ static LWMsgProtocolSpec gNtlmIpcSpec[] =
     LWMSG_MESSAGE(NTLM_Q_VERIFY_SIGN, gNtlmVerifySignSpec),
     LWMSG_MESSAGE(NTLM_R_VERIFY_SIGN_SUCCESS, gNtlmVerifySignRespSpec),
 
+    LWMSG_MESSAGE(NTLM_Q_EXPORT_SESSION_STATE, gNtlmExportSessionStateSpec),
+    LWMSG_MESSAGE(NTLM_R_EXPORT_SESSION_STATE_SUCCESS, gNtlmSessionStateSpec),
+
+    LWMSG_MESSAGE(NTLM_Q_IMPORT_SESSION_STATE, gNtlmImportSessionStateSpec),
+    LWMSG_MESSAGE(NTLM_R_IMPORT_SESSION_STATE_SUCCESS, NULL),
+
     LWMSG_PROTOCOL_END
 };
 
@@ -36,13 +36,36 @@
  *        crc32.c
  *
  * Abstract:
- *        CRC32-C generator
+ *        CRC32 of the data buffers of a message, as used by NTLM1 signatures
  *
  * Authors: Kyle Stemen <kstemen@likewise.com>
  *
  */
-#include "ntlmsrvapi.h"
-#include <krb5.h>
+#include "ntlm.h"
+
+static DWORD gNtlmCrc32Table[256];
+static pthread_once_t gNtlmCrc32TableOnce = PTHREAD_ONCE_INIT;
+
+static
+VOID
+NtlmInitCrc32Table(
+    VOID
+    )
+{
+    DWORD i = 0;
+    DWORD j = 0;
+    DWORD c = 0;
+
+    for (i = 0; i < 256; i++)
+    {
+        c = i;
+        for (j = 0; j < 8; j++)
+        {
+            c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+        }
+        gNtlmCrc32Table[i] = c;
+    }
+}
 
 DWORD
 NtlmCrc32(
@@ -51,16 +74,22 @@ NtlmCrc32(
     )
 {
     DWORD dwError = LW_ERROR_SUCCESS;
-    krb5_error_code KrbError= 0;
-    DWORD dwChecksum = 0;
-    size_t cKiov = 0;
-    krb5_crypto_iov *kiov = NULL;
+    DWORD dwCrc = 0xFFFFFFFF;
     DWORD dwIndex = 0;
-    DWORD dwKiovPos = 0;
+    DWORD dwByte = 0;
+    BOOLEAN bFoundData = FALSE;
+    BYTE Checksum[4];
     // Do not free
     SecBuffer *pData = NULL;
-    BYTE pbMagic[] = { 0x62, 0xF5, 0x26, 0x92 };
+    PBYTE pBytes = NULL;
+
+    pthread_once(&gNtlmCrc32TableOnce, NtlmInitCrc32Table);
 
+    // NTLM uses the "Preset to -1" and "Post-invert" variant of CRC32, where
+    // the checksum is initialized to -1 before taking the input data into
+    // account. After processing the input data, the one's complement of the
+    // checksum is calculated. (see
+    // http://en.wikipedia.org/wiki/Computation_of_CRC#Preset_to_.E2.88.921 )
     for (dwIndex = 0 ; dwIndex < pMessage->cBuffers ; dwIndex++)
     {
         pData = &pMessage->pBuffers[dwIndex];
@@ -73,72 +102,35 @@ NtlmCrc32(
                 BAIL_ON_LSA_ERROR(dwError);
             }
 
-            cKiov++;
+            bFoundData = TRUE;
+            pBytes = pData->pvBuffer;
+
+            for (dwByte = 0; dwByte < pData->cbBuffer; dwByte++)
+            {
+                dwCrc = gNtlmCrc32Table[(dwCrc ^ pBytes[dwByte]) & 0xFF] ^
+                        (dwCrc >> 8);
+            }
         }
     }
-    if (cKiov == 0)
+
+    if (!bFoundData)
     {
         dwError = LW_ERROR_INVALID_PARAMETER;
         BAIL_ON_LSA_ERROR(dwError);
     }
 
-    // Add 1 for the checksum buffer and 1 for the magic buffer
-    cKiov += 2;
-
-    dwError = LwAllocateMemory(
-                  cKiov * sizeof(*kiov),
-                  OUT_PPVOID(&kiov));
-    BAIL_ON_LSA_ERROR(dwError);
-
-    kiov[dwKiovPos].flags = KRB5_CRYPTO_TYPE_CHECKSUM;
-    kiov[dwKiovPos].data.length = sizeof(dwChecksum);
-    kiov[dwKiovPos].data.data = (void *)&dwChecksum;
-
-    dwKiovPos++;
-
-    // NTLM uses the "Preset to -1" and "Post-invert" variant of CRC32, where
-    // the checksum is initialized to -1 before taking the input data into
-    // account. After processing the input data, the one's complement of the
-    // checksum is calculated. (see
-    // http://en.wikipedia.org/wiki/Computation_of_CRC#Preset_to_.E2.88.921 )
-    
-    // Calculating this 4 byte magic sequence will set the current checksum
-    // to -1.
-    kiov[dwKiovPos].flags = KRB5_CRYPTO_TYPE_SIGN_ONLY;
-    kiov[dwKiovPos].data.length = sizeof(pbMagic);
-    kiov[dwKiovPos++].data.data = (void*)&pbMagic[0];
-
-    for (dwIndex = 0 ; dwIndex < pMessage->cBuffers ; dwIndex++)
-    {
-        pData = &pMessage->pBuffers[dwIndex];
-
-        if ((pData->BufferType & ~SECBUFFER_ATTRMASK) == SECBUFFER_DATA)
-        {
-            kiov[dwKiovPos].flags = KRB5_CRYPTO_TYPE_SIGN_ONLY;
-            kiov[dwKiovPos].data.length = pData->cbBuffer;
-            kiov[dwKiovPos++].data.data = pData->pvBuffer;
-        }
-    }
-
-    KrbError = krb5_c_make_checksum_iov(
-                   NULL,
-                   CKSUMTYPE_CRC32,
-                   NULL,
-                   0,
-                   kiov,
-                   cKiov
-                   );
-    BAIL_ON_KRB_ERROR(NULL, KrbError);
+    // Do the post-invert
+    dwCrc ^= 0xFFFFFFFF;
 
-    LW_ASSERT(kiov[0].data.length == 4);
+    // The checksum goes on the wire little-endian
+    Checksum[0] = dwCrc & 0xFF;
+    Checksum[1] = (dwCrc >> 8) & 0xFF;
+    Checksum[2] = (dwCrc >> 16) & 0xFF;
+    Checksum[3] = (dwCrc >> 24) & 0xFF;
 
-    memcpy(&dwChecksum, kiov[0].data.data, kiov[0].data.length);
-    // Do the post-invert
-    *pdwCrc32 = dwChecksum ^ 0xFFFFFFFF;
+    memcpy(pdwCrc32, Checksum, sizeof(Checksum));
 
 cleanup:
-    LW_SAFE_FREE_MEMORY(kiov);
-
     return dwError;
 
 error:
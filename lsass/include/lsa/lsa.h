@@ -506,6 +506,18 @@ typedef struct __LSA_METRIC_PACK_1
     LW_UINT64 failedChangePassword;
 } LSA_METRIC_PACK_1, *PLSA_METRIC_PACK_1;
 
+typedef struct __LSA_METRIC_PACK_2
+{
+    // Everything in level 1
+    LSA_METRIC_PACK_1 pack1;
+    // Directory lookups that waited for an identical lookup in progress
+    LW_UINT64 coalescedLookups;
+    // Directory lookups that were sent together with others
+    LW_UINT64 mergedLookups;
+    // Directory queries that carried merged lookups
+    LW_UINT64 mergedLookupBatches;
+} LSA_METRIC_PACK_2, *PLSA_METRIC_PACK_2;
+
 typedef struct __LSA_METRIC_PACK
 {
     LW_DWORD dwInfoLevel;
@@ -513,6 +525,7 @@ typedef struct __LSA_METRIC_PACK
     {
         PLSA_METRIC_PACK_0 pMetricPack0;
         PLSA_METRIC_PACK_1 pMetricPack1;
+        PLSA_METRIC_PACK_2 pMetricPack2;
     } pMetricPack;
 } LSA_METRIC_PACK, *PLSA_METRIC_PACK;
 
@@ -747,7 +760,9 @@ typedef struct _LSA_PAM_CONFIG
 /**
  * @brief Open connection to local lsass server
  *
- * Creates a connection handle to the local lsass server.
+ * Creates a connection handle to the local lsass server.  A recently
+ * closed connection of the calling process is reused when one is
+ * available and was opened with the same effective credentials.
  *
  * @param[out] phConnection the created connection handle
  * @retval LW_ERROR_SUCCESS success
@@ -1156,7 +1171,8 @@ LsaReadVersionFile(
  * @brief Closes connection to lsass server
  *
  * Closes a connection handle opened with #LsaOpenServer()
- * or #LsaOpenServerThreaded().
+ * or #LsaOpenServerThreaded().  Healthy connections are kept
+ * briefly for reuse by the next #LsaOpenServer() in the process.
  *
  * @param[in,out] hConnection the connection handle to close
  * @retval LW_ERROR_SUCCESS success
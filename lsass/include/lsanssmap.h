@@ -0,0 +1,155 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright Likewise Software
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the license, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.  You should have received a copy
+ * of the GNU Lesser General Public License along with this program.  If
+ * not, see <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * LESSER GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        lsanssmap.h
+ *
+ * Abstract:
+ *
+ *        Likewise Security and Authentication Subsystem (LSASS)
+ *
+ *        Layout of the shared NSS lookup map
+ *
+ *        lsassd publishes resolved passwd and group records into a
+ *        fixed-size, memory-mapped hash table.  The nsswitch modules
+ *        map the file read-only and answer lookups from it without
+ *        taking any lock or talking to lsassd.  Every slot is guarded
+ *        by a sequence counter: the writer makes it odd while the slot
+ *        is being rewritten and even again afterwards, and readers
+ *        discard any copy taken while the counter moved.
+ *
+ *        The map is only a cache.  A miss, a stale generation or an
+ *        expired slot makes the reader fall back to IPC.
+ *
+ */
+
+#ifndef __LSANSSMAP_H__
+#define __LSANSSMAP_H__
+
+#define LSA_NSS_MAP_PATH              CACHEDIR "/nssmap"
+
+#define LSA_NSS_MAP_MAGIC             0x4C4E4D50 /* "LNMP" */
+#define LSA_NSS_MAP_VERSION           1
+
+#define LSA_NSS_MAP_SLOT_COUNT        8192
+#define LSA_NSS_MAP_PROBE_COUNT       4
+#define LSA_NSS_MAP_SLOT_DATA_SIZE    472
+
+/* Lifetime of a published entry when the registry does not override it */
+#define LSA_NSS_MAP_DEFAULT_LIFETIME  60
+
+#define LSA_NSS_MAP_BARRIER()         __sync_synchronize()
+
+typedef enum _LSA_NSS_MAP_KEY_TYPE
+{
+    LSA_NSS_MAP_KEY_NONE = 0,
+    LSA_NSS_MAP_KEY_USER_NAME,
+    LSA_NSS_MAP_KEY_USER_ID,
+    LSA_NSS_MAP_KEY_GROUP_NAME,
+    LSA_NSS_MAP_KEY_GROUP_ID
+} LSA_NSS_MAP_KEY_TYPE;
+
+typedef struct _LSA_NSS_MAP_HEADER
+{
+    /* Zero once lsassd has replaced the file; readers must remap */
+    UINT32 volatile dwMagic;
+    UINT32 dwVersion;
+    UINT32 dwSlotCount;
+    UINT32 dwSlotSize;
+    /* Bumped to invalidate every slot at once */
+    UINT32 volatile dwGeneration;
+    UINT32 dwReserved;
+} LSA_NSS_MAP_HEADER, *PLSA_NSS_MAP_HEADER;
+
+/*
+ * Data holds NUL-terminated strings back to back.  For name keys the
+ * first string is the lookup key as it was queried.  It is followed by
+ * name, passwd, gecos, shell and homedir for users, or name, passwd
+ * and one string per member for groups.  Absent optional values are
+ * stored as empty strings.
+ */
+typedef struct _LSA_NSS_MAP_SLOT
+{
+    UINT32 volatile dwSequence;
+    UINT32 dwGeneration;
+    UINT32 dwKeyType;
+    UINT32 dwKeyHash;
+    UINT32 dwId;
+    UINT32 dwGid;
+    UINT64 qwExpires;
+    UINT32 dwStringCount;
+    UINT32 dwDataLength;
+    CHAR   Data[LSA_NSS_MAP_SLOT_DATA_SIZE];
+} LSA_NSS_MAP_SLOT, *PLSA_NSS_MAP_SLOT;
+
+#define LSA_NSS_MAP_SIZE                        \
+    (sizeof(LSA_NSS_MAP_HEADER) +               \
+     sizeof(LSA_NSS_MAP_SLOT) * LSA_NSS_MAP_SLOT_COUNT)
+
+#define LSA_NSS_MAP_SLOTS(pHeader)              \
+    ((PLSA_NSS_MAP_SLOT) ((PBYTE) (pHeader) + sizeof(LSA_NSS_MAP_HEADER)))
+
+/* FNV-1a over the key type and either the key string or the id */
+static inline
+UINT32
+LsaNssMapHashKey(
+    LSA_NSS_MAP_KEY_TYPE KeyType,
+    PCSTR pszKey,
+    UINT32 dwId
+    )
+{
+    UINT32 dwHash = 2166136261U;
+    size_t i = 0;
+
+    dwHash = (dwHash ^ (UINT32) KeyType) * 16777619U;
+
+    if (pszKey)
+    {
+        for (i = 0; pszKey[i]; i++)
+        {
+            dwHash = (dwHash ^ (BYTE) pszKey[i]) * 16777619U;
+        }
+    }
+    else
+    {
+        for (i = 0; i < sizeof(dwId); i++)
+        {
+            dwHash = (dwHash ^ ((dwId >> (i * 8)) & 0xFF)) * 16777619U;
+        }
+    }
+
+    return dwHash;
+}
+
+#endif /* __LSANSSMAP_H__ */
@@ -325,6 +325,9 @@ typedef enum
     LsaMetricSuccessfulChangePassword     = 15,
     LsaMetricFailedChangePassword         = 16,
     LsaMetricUnauthorizedAccesses         = 17,
+    LsaMetricCoalescedLookups             = 18,
+    LsaMetricMergedLookups                = 19,
+    LsaMetricMergedLookupBatches          = 20,
     LsaMetricSentinel
 } LsaMetricType;
 
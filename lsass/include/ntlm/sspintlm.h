@@ -360,6 +360,16 @@ NtlmClientDeleteSecurityContext(
     IN PNTLM_CONTEXT_HANDLE phContext
     );
 
+// Moves the per-message state of an established context into this process
+// so that signing, sealing and verification no longer round-trip through
+// lsassd. Call it once, when the context is complete. Exporting the context
+// hands the state back to lsassd first. Failure is harmless: the
+// per-message calls keep using IPC.
+DWORD
+NtlmClientEnableLocalSessionSecurity(
+    IN PNTLM_CONTEXT_HANDLE phContext
+    );
+
 DWORD
 NtlmClientEncryptMessage(
     IN PNTLM_CONTEXT_HANDLE phContext,
@@ -83,7 +83,11 @@ typedef enum __NTLM_IPC_TAG
     NTLM_Q_SET_CREDS,
     NTLM_R_SET_CREDS_SUCCESS,
     NTLM_Q_VERIFY_SIGN,
-    NTLM_R_VERIFY_SIGN_SUCCESS
+    NTLM_R_VERIFY_SIGN_SUCCESS,
+    NTLM_Q_EXPORT_SESSION_STATE,
+    NTLM_R_EXPORT_SESSION_STATE_SUCCESS,
+    NTLM_Q_IMPORT_SESSION_STATE,
+    NTLM_R_IMPORT_SESSION_STATE_SUCCESS
 } NTLM_IPC_TAG;
 
 /******************************************************************************/
@@ -296,6 +300,52 @@ typedef struct __NTLM_IPC_VERIFY_SIGN_RESPONSE
 
 /******************************************************************************/
 
+#define NTLM_IPC_SESSION_KEY_SIZE 16
+
+// Kept independent of the width of RC4_INT so that the client and the
+// server do not need to agree on how OpenSSL was built
+typedef struct __NTLM_IPC_RC4_STATE
+{
+    DWORD x;
+    DWORD y;
+    DWORD data[256];
+} NTLM_IPC_RC4_STATE, *PNTLM_IPC_RC4_STATE;
+
+typedef struct __NTLM_IPC_EXPORT_SESSION_STATE_REQ
+{
+    LWMsgHandle* hContext;
+} NTLM_IPC_EXPORT_SESSION_STATE_REQ, *PNTLM_IPC_EXPORT_SESSION_STATE_REQ;
+
+typedef struct __NTLM_IPC_SESSION_STATE
+{
+    DWORD NegotiatedFlags;
+    // ISC_RET_* flags as returned for SECPKG_ATTR_FLAGS
+    DWORD ContextFlags;
+    // As returned for SECPKG_ATTR_SIZES
+    DWORD cbMaxToken;
+    DWORD cbMaxSignature;
+    DWORD cbBlockSize;
+    DWORD cbSecurityTrailer;
+    BYTE SignKey[NTLM_IPC_SESSION_KEY_SIZE];
+    BYTE VerifyKey[NTLM_IPC_SESSION_KEY_SIZE];
+    NTLM_IPC_RC4_STATE SealKey;
+    NTLM_IPC_RC4_STATE UnsealKey;
+    DWORD dwSendMsgSeq;
+    DWORD dwRecvMsgSeq;
+    // NTLM1 session security uses one key and one sequence number for both
+    // directions. Only SealKey and dwSendMsgSeq are meaningful then.
+    DWORD bSharedState;
+} NTLM_IPC_SESSION_STATE, *PNTLM_IPC_SESSION_STATE;
+
+// Hands the state back to lsassd, which owns the context again afterwards
+typedef struct __NTLM_IPC_IMPORT_SESSION_STATE_REQ
+{
+    LWMsgHandle* hContext;
+    NTLM_IPC_SESSION_STATE State;
+} NTLM_IPC_IMPORT_SESSION_STATE_REQ, *PNTLM_IPC_IMPORT_SESSION_STATE_REQ;
+
+/******************************************************************************/
+
 #define NTLM_MAP_LWMSG_ERROR(_e_) (LwMapLwmsgStatusToLwError(_e_))
 #define MAP_NTLM_ERROR_IPC(_e_) ((_e_) ? LWMSG_STATUS_ERROR : LWMSG_STATUS_SUCCESS)
 
@@ -0,0 +1,76 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ */
+
+/*
+ * Copyright Likewise Software    2004-2008
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the license, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.  You should have received a copy
+ * of the GNU Lesser General Public License along with this program.  If
+ * not, see <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * LESSER GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        ntlmsession.h
+ *
+ * Abstract:
+ *
+ *        Likewise Security and Authentication Subsystem (LSASS)
+ *
+ *        NTLM session security state and checksum, shared by lsassd and
+ *        the in-process client sessions
+ *
+ */
+
+#ifndef __NTLMSESSION_H__
+#define __NTLMSESSION_H__
+
+#include <ntlm/sspintlm.h>
+#include <openssl/rc4.h>
+
+#define NTLM_SESSION_SIGN_KEY_SIZE 16
+
+// A view of the session security state of an established context. The
+// owner (an NTLM_CONTEXT in lsassd or a client session) keeps the storage
+// and serializes calls. With NTLM1 session security both directions point
+// at the same seal key and sequence number.
+typedef struct __NTLM_SESSION_SECURITY
+{
+    DWORD NegotiatedFlags;
+    const BYTE* pSignKey;
+    const BYTE* pVerifyKey;
+    RC4_KEY* pSealKey;
+    RC4_KEY* pUnsealKey;
+    PDWORD pdwSendMsgSeq;
+    PDWORD pdwRecvMsgSeq;
+} NTLM_SESSION_SECURITY, *PNTLM_SESSION_SECURITY;
+
+DWORD
+NtlmCrc32(
+    const SecBufferDesc* pMessage,
+    PDWORD pdwCrc32
+    );
+
+#endif /* __NTLMSESSION_H__ */
@@ -52,5 +52,8 @@ extern BOOLEAN gbLogInitialized;
 extern PLW_HASH_TABLE gpUserIgnoreHash;
 extern PLW_HASH_TABLE gpGroupIgnoreHash;
 extern time_t gtIgnoreHashLastUpdated;
+#ifdef HAVE_NONLIBPTHREAD_MUTEX_LOCK
+extern pthread_mutex_t gIgnoreHashLock;
+#endif
 
 #endif /* __EXTERNS_H__ */
@@ -53,3 +53,6 @@ DWORD   gdwLogLevel      = LSA_PAM_LOG_LEVEL_ERROR;
 PLW_HASH_TABLE gpUserIgnoreHash = NULL;
 PLW_HASH_TABLE gpGroupIgnoreHash = NULL;
 time_t gtIgnoreHashLastUpdated = 0;
+#ifdef HAVE_NONLIBPTHREAD_MUTEX_LOCK
+pthread_mutex_t gIgnoreHashLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
@@ -52,6 +52,14 @@
 #define LSA_USER_IGNORE_LIST_PATH CONFIGDIR "/user-ignore"
 #define LSA_GROUP_IGNORE_LIST_PATH CONFIGDIR "/group-ignore"
 
+#ifdef HAVE_NONLIBPTHREAD_MUTEX_LOCK
+#define IGNORE_HASH_LOCK() pthread_mutex_lock(&gIgnoreHashLock)
+#define IGNORE_HASH_UNLOCK() pthread_mutex_unlock(&gIgnoreHashLock)
+#else
+#define IGNORE_HASH_LOCK()
+#define IGNORE_HASH_UNLOCK()
+#endif
+
 static
 DWORD
 LsaPamGetConfigFromServer(
@@ -566,19 +574,30 @@ error:
     goto cleanup;
 }
 
+/*
+ * The nsswitch module calls these from many threads at once, and
+ * LsaReadIgnoreHashes may replace the tables underneath a lookup.
+ */
 BOOLEAN
 LsaShouldIgnoreGroup(
     PCSTR pszName
     )
 {
+    BOOLEAN bIgnore = FALSE;
+
+    IGNORE_HASH_LOCK();
+
     // Ignore errors
     LsaReadIgnoreHashes();
 
     if (gpGroupIgnoreHash)
     {
-        return LwHashExists(gpGroupIgnoreHash, pszName);
+        bIgnore = LwHashExists(gpGroupIgnoreHash, pszName);
     }
-    return FALSE;
+
+    IGNORE_HASH_UNLOCK();
+
+    return bIgnore;
 }
 
 BOOLEAN
@@ -586,19 +605,30 @@ LsaShouldIgnoreUser(
     PCSTR pszName
     )
 {
+    BOOLEAN bIgnore = FALSE;
+
+    IGNORE_HASH_LOCK();
+
     // Ignore errors
     LsaReadIgnoreHashes();
 
     if (gpUserIgnoreHash)
     {
-        return (LwHashExists(gpUserIgnoreHash, pszName));
+        bIgnore = LwHashExists(gpUserIgnoreHash, pszName);
     }
-    return FALSE;
+
+    IGNORE_HASH_UNLOCK();
+
+    return bIgnore;
 }
 
 VOID
 LsaFreeIgnoreHashes(VOID)
 {
+    IGNORE_HASH_LOCK();
+
     LwHashSafeFree(&gpUserIgnoreHash);
     LwHashSafeFree(&gpGroupIgnoreHash);
+
+    IGNORE_HASH_UNLOCK();
 }
@@ -631,6 +631,19 @@ static GSS_MECH_CONFIG gNtlmMech =
 // Function Definitions
 //
 
+// Per-message calls are answered inside this process once the context is
+// fully established, so this runs once when init, accept or import
+// completes. If lsassd cannot hand the state over the calls keep going
+// through IPC, so the result is deliberately ignored.
+static
+VOID
+NtlmGssEnableLocalSession(
+    NTLM_CONTEXT_HANDLE ContextHandle
+    )
+{
+    NtlmClientEnableLocalSessionSecurity(&ContextHandle);
+}
+
 
 OM_uint32
 ntlm_gss_acquire_cred(
@@ -953,6 +966,8 @@ ntlm_gss_init_sec_context(
     else
     {
         BAIL_ON_LSA_ERROR(MinorStatus);
+
+        NtlmGssEnableLocalSession(hNewContext);
     }
 
     if (dwOutNtlmFlags & ISC_RET_INTEGRITY)
@@ -1142,6 +1157,8 @@ ntlm_gss_accept_sec_context(
                           NULL
                           );
         BAIL_ON_LSA_ERROR(MinorStatus);
+
+        NtlmGssEnableLocalSession(NewCtxtHandle);
     }
 
 cleanup:
@@ -2382,6 +2399,8 @@ ntlm_gss_import_sec_context(
                       &NewContext);
     BAIL_ON_LSA_ERROR(MinorStatus);
 
+    NtlmGssEnableLocalSession(NewContext);
+
 cleanup:
 
     *pMinorStatus = MinorStatus;
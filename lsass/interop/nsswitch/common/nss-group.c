@@ -466,6 +466,17 @@ LsaNssCommonGroupGetgrgid(
     PVOID pGroupInfo = NULL;
     DWORD dwGroupInfoLevel = 1;
 
+    ret = LsaNssMapGetgrgid(
+              gid,
+              pResultGroup,
+              pszBuf,
+              bufLen,
+              pErrorNumber);
+    if (ret != NSS_STATUS_NOTFOUND)
+    {
+        goto cleanup;
+    }
+
     ret = MAP_LSA_ERROR(NULL,
             LsaNssCommonEnsureConnected(pConnection));
     BAIL_ON_NSS_ERROR(ret);
@@ -530,6 +541,17 @@ LsaNssCommonGroupGetgrnam(
         BAIL_ON_NSS_ERROR(ret);
     }
 
+    ret = LsaNssMapGetgrnam(
+              pszGroupName,
+              pResultGroup,
+              pszBuf,
+              bufLen,
+              pErrorNumber);
+    if (ret != NSS_STATUS_NOTFOUND)
+    {
+        goto cleanup;
+    }
+
     ret = MAP_LSA_ERROR(NULL,
             LsaNssCommonEnsureConnected(pConnection));
     BAIL_ON_NSS_ERROR(ret);
@@ -91,3 +91,83 @@ LsaNssCommonCloseConnection(
     }
     return dwError;
 }
+
+#ifdef HAVE_NONLIBPTHREAD_MUTEX_LOCK
+#define POOL_LOCK(pPool) pthread_mutex_lock(&(pPool)->Lock)
+#define POOL_UNLOCK(pPool) pthread_mutex_unlock(&(pPool)->Lock)
+#else
+#define POOL_LOCK(pPool)
+#define POOL_UNLOCK(pPool)
+#endif
+
+/*
+ * Hands out an idle pooled connection, or an empty handle that the
+ * lookup will open on demand.  The pool lock is only held long enough
+ * to pop the handle, so concurrent lookups each talk to lsassd over
+ * their own connection.
+ */
+VOID
+LsaNssCommonAcquireConnection(
+    PLSA_NSS_CONNECTION_POOL pPool,
+    PLSA_NSS_CACHED_HANDLE pConnection
+    )
+{
+    pConnection->hLsaConnection = NULL;
+    pConnection->owner = 0;
+
+    POOL_LOCK(pPool);
+
+    if (pPool->dwIdleCount > 0)
+    {
+        *pConnection = pPool->Idle[--pPool->dwIdleCount];
+    }
+
+    POOL_UNLOCK(pPool);
+}
+
+/*
+ * Returns a connection to the pool.  Connections which were dropped
+ * after an error are simply forgotten, and any beyond the pool size
+ * are closed.
+ */
+VOID
+LsaNssCommonReleaseConnection(
+    PLSA_NSS_CONNECTION_POOL pPool,
+    PLSA_NSS_CACHED_HANDLE pConnection
+    )
+{
+    if (pConnection->hLsaConnection == (HANDLE)NULL)
+    {
+        return;
+    }
+
+    if (pConnection->owner == getpid())
+    {
+        POOL_LOCK(pPool);
+
+        if (pPool->dwIdleCount < LSA_NSS_CONNECTION_POOL_SIZE)
+        {
+            pPool->Idle[pPool->dwIdleCount++] = *pConnection;
+            pConnection->hLsaConnection = NULL;
+        }
+
+        POOL_UNLOCK(pPool);
+    }
+
+    LsaNssCommonCloseConnection(pConnection);
+}
+
+VOID
+LsaNssCommonClosePool(
+    PLSA_NSS_CONNECTION_POOL pPool
+    )
+{
+    POOL_LOCK(pPool);
+
+    while (pPool->dwIdleCount > 0)
+    {
+        LsaNssCommonCloseConnection(&pPool->Idle[--pPool->dwIdleCount]);
+    }
+
+    POOL_UNLOCK(pPool);
+}
@@ -0,0 +1,451 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright Likewise Software
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the license, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.  You should have received a copy
+ * of the GNU Lesser General Public License along with this program.  If
+ * not, see <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * LESSER GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        nss-map.c
+ *
+ * Abstract:
+ *
+ *        Name Server Switch (Likewise LSASS)
+ *
+ *        Lock-free lookups in the map published by lsassd
+ *
+ *        Every function here returns NSS_STATUS_NOTFOUND when the map
+ *        cannot answer, in which case the caller must ask lsassd.
+ */
+
+#include "lsanss.h"
+#include "lsanssmap.h"
+#include <sys/mman.h>
+
+static PLSA_NSS_MAP_HEADER volatile gpNssMap = NULL;
+static time_t volatile gNssMapLastOpen = 0;
+
+static
+PLSA_NSS_MAP_HEADER
+LsaNssMapOpen(
+    VOID
+    )
+{
+    int fd = -1;
+    struct stat statbuf;
+    PVOID pMap = MAP_FAILED;
+    PLSA_NSS_MAP_HEADER pHeader = NULL;
+
+    fd = open(LSA_NSS_MAP_PATH, O_RDONLY);
+    if (fd < 0)
+    {
+        goto error;
+    }
+
+    if (fstat(fd, &statbuf) < 0 || statbuf.st_size < LSA_NSS_MAP_SIZE)
+    {
+        goto error;
+    }
+
+    pMap = mmap(NULL, LSA_NSS_MAP_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    if (pMap == MAP_FAILED)
+    {
+        goto error;
+    }
+
+    pHeader = (PLSA_NSS_MAP_HEADER) pMap;
+
+    if (pHeader->dwMagic != LSA_NSS_MAP_MAGIC ||
+        pHeader->dwVersion != LSA_NSS_MAP_VERSION ||
+        pHeader->dwSlotCount != LSA_NSS_MAP_SLOT_COUNT ||
+        pHeader->dwSlotSize != sizeof(LSA_NSS_MAP_SLOT))
+    {
+        goto error;
+    }
+
+cleanup:
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    return pHeader;
+
+error:
+
+    if (pMap != MAP_FAILED)
+    {
+        munmap(pMap, LSA_NSS_MAP_SIZE);
+    }
+
+    pHeader = NULL;
+
+    goto cleanup;
+}
+
+static
+PLSA_NSS_MAP_HEADER
+LsaNssMapGet(
+    VOID
+    )
+{
+    PLSA_NSS_MAP_HEADER pMap = gpNssMap;
+    PLSA_NSS_MAP_HEADER pNewMap = NULL;
+    time_t now = 0;
+
+    if (pMap && pMap->dwMagic == LSA_NSS_MAP_MAGIC)
+    {
+        return pMap;
+    }
+
+    /* Don't hammer the filesystem while lsassd is down or restarting */
+    now = time(NULL);
+    if (now == gNssMapLastOpen)
+    {
+        return NULL;
+    }
+    gNssMapLastOpen = now;
+
+    pNewMap = LsaNssMapOpen();
+    if (!pNewMap)
+    {
+        return NULL;
+    }
+
+    if (!__sync_bool_compare_and_swap(&gpNssMap, pMap, pNewMap))
+    {
+        munmap(pNewMap, LSA_NSS_MAP_SIZE);
+        return NULL;
+    }
+
+    /*
+     * A retired map is deliberately left mapped since other threads may
+     * still be copying out of it.  This only happens once per lsassd
+     * restart.
+     */
+    return pNewMap;
+}
+
+/*
+ * Copies the slot holding the given key into pSlot.  The copy is only
+ * trusted if the slot sequence counter was even and unchanged around it.
+ */
+static
+BOOLEAN
+LsaNssMapLookup(
+    IN LSA_NSS_MAP_KEY_TYPE KeyType,
+    IN OPTIONAL PCSTR pszKey,
+    IN DWORD dwId,
+    OUT PLSA_NSS_MAP_SLOT pSlot
+    )
+{
+    PLSA_NSS_MAP_HEADER pMap = LsaNssMapGet();
+    PLSA_NSS_MAP_SLOT pShared = NULL;
+    UINT32 dwKeyHash = 0;
+    UINT32 dwSequence = 0;
+    DWORD dwIndex = 0;
+    time_t now = 0;
+
+    if (!pMap)
+    {
+        return FALSE;
+    }
+
+    dwKeyHash = LsaNssMapHashKey(KeyType, pszKey, dwId);
+    now = time(NULL);
+
+    for (dwIndex = 0; dwIndex < LSA_NSS_MAP_PROBE_COUNT; dwIndex++)
+    {
+        pShared = &LSA_NSS_MAP_SLOTS(pMap)[
+            (dwKeyHash + dwIndex) % LSA_NSS_MAP_SLOT_COUNT];
+
+        dwSequence = pShared->dwSequence;
+        if (dwSequence & 1)
+        {
+            continue;
+        }
+
+        LSA_NSS_MAP_BARRIER();
+        memcpy(pSlot, (PVOID) pShared, sizeof(*pSlot));
+        LSA_NSS_MAP_BARRIER();
+
+        if (pShared->dwSequence != dwSequence)
+        {
+            continue;
+        }
+
+        if (pSlot->dwGeneration != pMap->dwGeneration ||
+            pSlot->dwKeyType != KeyType ||
+            pSlot->dwKeyHash != dwKeyHash ||
+            pSlot->qwExpires <= (UINT64) now ||
+            pSlot->dwDataLength == 0 ||
+            pSlot->dwDataLength > sizeof(pSlot->Data) ||
+            pSlot->Data[pSlot->dwDataLength - 1] != '\0')
+        {
+            continue;
+        }
+
+        if (pszKey ? strcmp(pSlot->Data, pszKey) : pSlot->dwId != dwId)
+        {
+            continue;
+        }
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/*
+ * Splits the slot data into its strings, skipping the key for name
+ * lookups.  Returns FALSE if the slot does not hold as many strings as
+ * it claims.
+ */
+static
+BOOLEAN
+LsaNssMapGetStrings(
+    IN PLSA_NSS_MAP_SLOT pSlot,
+    IN BOOLEAN bHasKey,
+    IN DWORD dwMaxStrings,
+    OUT PSTR* ppszStrings
+    )
+{
+    PSTR pszCursor = pSlot->Data;
+    PSTR pszEnd = pSlot->Data + pSlot->dwDataLength;
+    DWORD dwIndex = 0;
+
+    if (pSlot->dwStringCount > dwMaxStrings)
+    {
+        return FALSE;
+    }
+
+    if (bHasKey)
+    {
+        pszCursor += strlen(pszCursor) + 1;
+    }
+
+    for (dwIndex = 0; dwIndex < pSlot->dwStringCount; dwIndex++)
+    {
+        if (pszCursor >= pszEnd)
+        {
+            return FALSE;
+        }
+
+        ppszStrings[dwIndex] = pszCursor;
+        pszCursor += strlen(pszCursor) + 1;
+    }
+
+    return TRUE;
+}
+
+static
+NSS_STATUS
+LsaNssMapWriteUser(
+    IN PLSA_NSS_MAP_SLOT pSlot,
+    IN BOOLEAN bHasKey,
+    struct passwd * pResultUser,
+    char * pszBuf,
+    size_t bufLen,
+    int * pErrorNumber
+    )
+{
+    LSA_USER_INFO_0 userInfo;
+    PSTR ppszStrings[5];
+
+    if (pSlot->dwStringCount != LW_ARRAY_SIZE(ppszStrings) ||
+        !LsaNssMapGetStrings(
+            pSlot,
+            bHasKey,
+            LW_ARRAY_SIZE(ppszStrings),
+            ppszStrings))
+    {
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    memset(&userInfo, 0, sizeof(userInfo));
+    userInfo.uid = (uid_t) pSlot->dwId;
+    userInfo.gid = (gid_t) pSlot->dwGid;
+    userInfo.pszName = ppszStrings[0];
+    userInfo.pszPasswd = ppszStrings[1];
+    userInfo.pszGecos = ppszStrings[2];
+    userInfo.pszShell = ppszStrings[3];
+    userInfo.pszHomedir = ppszStrings[4];
+
+    return MAP_LSA_ERROR(pErrorNumber,
+                         LsaNssWriteUserInfo(
+                             0,
+                             &userInfo,
+                             pResultUser,
+                             &pszBuf,
+                             bufLen));
+}
+
+static
+NSS_STATUS
+LsaNssMapWriteGroup(
+    IN PLSA_NSS_MAP_SLOT pSlot,
+    IN BOOLEAN bHasKey,
+    struct group * pResultGroup,
+    char * pszBuf,
+    size_t bufLen,
+    int * pErrorNumber
+    )
+{
+    LSA_GROUP_INFO_1 groupInfo;
+    /* name, passwd, members and the terminating NULL */
+    PSTR ppszStrings[LSA_NSS_MAP_SLOT_DATA_SIZE / 2 + 3];
+
+    if (pSlot->dwStringCount < 2 ||
+        !LsaNssMapGetStrings(
+            pSlot,
+            bHasKey,
+            LW_ARRAY_SIZE(ppszStrings) - 1,
+            ppszStrings))
+    {
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    ppszStrings[pSlot->dwStringCount] = NULL;
+
+    memset(&groupInfo, 0, sizeof(groupInfo));
+    groupInfo.gid = (gid_t) pSlot->dwId;
+    groupInfo.pszName = ppszStrings[0];
+    groupInfo.pszPasswd = ppszStrings[1];
+    groupInfo.ppszMembers = &ppszStrings[2];
+
+    return MAP_LSA_ERROR(pErrorNumber,
+                         LsaNssWriteGroupInfo(
+                             1,
+                             &groupInfo,
+                             pResultGroup,
+                             &pszBuf,
+                             bufLen));
+}
+
+NSS_STATUS
+LsaNssMapGetpwnam(
+    const char * pszLoginId,
+    struct passwd * pResultUser,
+    char * pszBuf,
+    size_t bufLen,
+    int * pErrorNumber
+    )
+{
+    LSA_NSS_MAP_SLOT slot;
+
+    if (!LsaNssMapLookup(LSA_NSS_MAP_KEY_USER_NAME, pszLoginId, 0, &slot))
+    {
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    return LsaNssMapWriteUser(
+        &slot,
+        TRUE,
+        pResultUser,
+        pszBuf,
+        bufLen,
+        pErrorNumber);
+}
+
+NSS_STATUS
+LsaNssMapGetpwuid(
+    uid_t uid,
+    struct passwd * pResultUser,
+    char * pszBuf,
+    size_t bufLen,
+    int * pErrorNumber
+    )
+{
+    LSA_NSS_MAP_SLOT slot;
+
+    if (!LsaNssMapLookup(LSA_NSS_MAP_KEY_USER_ID, NULL, (DWORD) uid, &slot))
+    {
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    return LsaNssMapWriteUser(
+        &slot,
+        FALSE,
+        pResultUser,
+        pszBuf,
+        bufLen,
+        pErrorNumber);
+}
+
+NSS_STATUS
+LsaNssMapGetgrnam(
+    const char * pszGroupName,
+    struct group * pResultGroup,
+    char * pszBuf,
+    size_t bufLen,
+    int * pErrorNumber
+    )
+{
+    LSA_NSS_MAP_SLOT slot;
+
+    if (!LsaNssMapLookup(LSA_NSS_MAP_KEY_GROUP_NAME, pszGroupName, 0, &slot))
+    {
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    return LsaNssMapWriteGroup(
+        &slot,
+        TRUE,
+        pResultGroup,
+        pszBuf,
+        bufLen,
+        pErrorNumber);
+}
+
+NSS_STATUS
+LsaNssMapGetgrgid(
+    gid_t gid,
+    struct group * pResultGroup,
+    char * pszBuf,
+    size_t bufLen,
+    int * pErrorNumber
+    )
+{
+    LSA_NSS_MAP_SLOT slot;
+
+    if (!LsaNssMapLookup(LSA_NSS_MAP_KEY_GROUP_ID, NULL, (DWORD) gid, &slot))
+    {
+        return NSS_STATUS_NOTFOUND;
+    }
+
+    return LsaNssMapWriteGroup(
+        &slot,
+        FALSE,
+        pResultGroup,
+        pszBuf,
+        bufLen,
+        pErrorNumber);
+}
@@ -421,6 +421,17 @@ LsaNssCommonPasswdGetpwnam(
         BAIL_ON_NSS_ERROR(ret);
     }
 
+    ret = LsaNssMapGetpwnam(
+              pszLoginId,
+              pResultUser,
+              pszBuf,
+              bufLen,
+              pErrorNumber);
+    if (ret != NSS_STATUS_NOTFOUND)
+    {
+        goto cleanup;
+    }
+
     ret = MAP_LSA_ERROR(NULL,
             LsaNssCommonEnsureConnected(pConnection));
     BAIL_ON_NSS_ERROR(ret);
@@ -475,6 +486,17 @@ LsaNssCommonPasswdGetpwuid(
     PVOID pUserInfo = NULL;
     DWORD dwUserInfoLevel = 0;
 
+    ret = LsaNssMapGetpwuid(
+              uid,
+              pResultUser,
+              pszBuf,
+              bufLen,
+              pErrorNumber);
+    if (ret != NSS_STATUS_NOTFOUND)
+    {
+        goto cleanup;
+    }
+
     ret = MAP_LSA_ERROR(NULL,
             LsaNssCommonEnsureConnected(pConnection));
     BAIL_ON_NSS_ERROR(ret);
@@ -139,6 +139,24 @@ typedef struct __LSA_NSS_CACHED_HANDLE
     pid_t owner;
 } LSA_NSS_CACHED_HANDLE, *PLSA_NSS_CACHED_HANDLE;
 
+/* Idle connections kept around for keyed lookups */
+#define LSA_NSS_CONNECTION_POOL_SIZE 8
+
+typedef struct __LSA_NSS_CONNECTION_POOL
+{
+#ifdef HAVE_NONLIBPTHREAD_MUTEX_LOCK
+    pthread_mutex_t Lock;
+#endif
+    DWORD dwIdleCount;
+    LSA_NSS_CACHED_HANDLE Idle[LSA_NSS_CONNECTION_POOL_SIZE];
+} LSA_NSS_CONNECTION_POOL, *PLSA_NSS_CONNECTION_POOL;
+
+#ifdef HAVE_NONLIBPTHREAD_MUTEX_LOCK
+#define LSA_NSS_CONNECTION_POOL_INITIALIZER { PTHREAD_MUTEX_INITIALIZER, 0 }
+#else
+#define LSA_NSS_CONNECTION_POOL_INITIALIZER { 0 }
+#endif
+
 DWORD
 LsaNssCommonEnsureConnected(
     PLSA_NSS_CACHED_HANDLE pConnection
@@ -149,6 +167,23 @@ LsaNssCommonCloseConnection(
     PLSA_NSS_CACHED_HANDLE pConnection
     );
 
+VOID
+LsaNssCommonAcquireConnection(
+    PLSA_NSS_CONNECTION_POOL pPool,
+    PLSA_NSS_CACHED_HANDLE pConnection
+    );
+
+VOID
+LsaNssCommonReleaseConnection(
+    PLSA_NSS_CONNECTION_POOL pPool,
+    PLSA_NSS_CACHED_HANDLE pConnection
+    );
+
+VOID
+LsaNssCommonClosePool(
+    PLSA_NSS_CONNECTION_POOL pPool
+    );
+
 VOID
 LsaNssClearEnumUsersState(
     HANDLE hLsaConnection,
@@ -297,6 +332,42 @@ LsaNssCommonGroupGetGroupsByUserName(
     int* pErrorNumber
     );
 
+NSS_STATUS
+LsaNssMapGetpwnam(
+    const char * pszLoginId,
+    struct passwd * pResultUser,
+    char * pszBuf,
+    size_t bufLen,
+    int * pErrorNumber
+    );
+
+NSS_STATUS
+LsaNssMapGetpwuid(
+    uid_t uid,
+    struct passwd * pResultUser,
+    char * pszBuf,
+    size_t bufLen,
+    int * pErrorNumber
+    );
+
+NSS_STATUS
+LsaNssMapGetgrnam(
+    const char * pszGroupName,
+    struct group * pResultGroup,
+    char * pszBuf,
+    size_t bufLen,
+    int * pErrorNumber
+    );
+
+NSS_STATUS
+LsaNssMapGetgrgid(
+    gid_t gid,
+    struct group * pResultGroup,
+    char * pszBuf,
+    size_t bufLen,
+    int * pErrorNumber
+    );
+
 NSS_STATUS
 LsaNssCommonNetgroupFindByName(
     PLSA_NSS_CACHED_HANDLE pConnection,
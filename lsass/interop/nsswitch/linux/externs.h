@@ -51,7 +51,13 @@
 #include <pthread.h>
 #endif
 
+/*
+ * lsaConnection and NSS_LOCK serialize the enumeration entry points,
+ * whose state is shared by the whole process.  Keyed lookups take a
+ * connection from gConnectionPool instead and run concurrently.
+ */
 extern LSA_NSS_CACHED_HANDLE lsaConnection;
+extern LSA_NSS_CONNECTION_POOL gConnectionPool;
 #ifdef HAVE_NONLIBPTHREAD_MUTEX_LOCK
 extern pthread_mutex_t gLock;
 #define NSS_LOCK() pthread_mutex_lock(&gLock);
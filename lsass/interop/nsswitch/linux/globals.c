@@ -34,6 +34,7 @@
 #endif
 
 LSA_NSS_CACHED_HANDLE lsaConnection = { 0 };
+LSA_NSS_CONNECTION_POOL gConnectionPool = LSA_NSS_CONNECTION_POOL_INITIALIZER;
 #ifdef HAVE_NONLIBPTHREAD_MUTEX_LOCK
 pthread_mutex_t gLock = PTHREAD_MUTEX_INITIALIZER;
 #endif
@@ -46,5 +47,6 @@ LsaNssLinuxDestruct(
     )
 {
     LsaNssCommonCloseConnection(&lsaConnection);
+    LsaNssCommonClosePool(&gConnectionPool);
     LsaFreeIgnoreHashes();
 }
@@ -121,17 +121,18 @@ _nss_lsass_getgrgid_r(
     )
 {
     NSS_STATUS status;
+    LSA_NSS_CACHED_HANDLE connection;
 
-    NSS_LOCK();
+    LsaNssCommonAcquireConnection(&gConnectionPool, &connection);
 
-    status = LsaNssCommonGroupGetgrgid(&lsaConnection,
+    status = LsaNssCommonGroupGetgrgid(&connection,
                                        gid,
                                        pResultGroup,
                                        pszBuf,
                                        bufLen,
                                        pErrorNumber);
 
-    NSS_UNLOCK();
+    LsaNssCommonReleaseConnection(&gConnectionPool, &connection);
 
     return status;
 }
@@ -146,17 +147,18 @@ _nss_lsass_getgrnam_r(
     )
 {
     NSS_STATUS status;
+    LSA_NSS_CACHED_HANDLE connection;
 
-    NSS_LOCK();
+    LsaNssCommonAcquireConnection(&gConnectionPool, &connection);
 
-    status = LsaNssCommonGroupGetgrnam(&lsaConnection,
+    status = LsaNssCommonGroupGetgrnam(&connection,
                                        pszGroupName,
                                        pResultGroup,
                                        pszBuf,
                                        bufLen,
                                        pErrorNumber);
 
-    NSS_UNLOCK();
+    LsaNssCommonReleaseConnection(&gConnectionPool, &connection);
 
     return status;
 }
@@ -178,11 +180,12 @@ _nss_lsass_initgroups_dyn(
     size_t resultsSize = 0;
     gid_t* pGidResults = *ppGidResults;
     gid_t* pGidResultsNew = NULL;
+    LSA_NSS_CACHED_HANDLE connection;
 
-    NSS_LOCK();
+    LsaNssCommonAcquireConnection(&gConnectionPool, &connection);
 
     ret = LsaNssCommonGroupGetGroupsByUserName(
-        &lsaConnection,
+        &connection,
         pszUserName,
         resultsExistingSize,
         resultsCapacity,
@@ -216,7 +219,7 @@ _nss_lsass_initgroups_dyn(
         resultsCapacity = resultsSize;
         /* Try again */
         ret = LsaNssCommonGroupGetGroupsByUserName(
-            &lsaConnection,
+            &connection,
             pszUserName,
             resultsExistingSize,
             resultsCapacity,
@@ -233,7 +236,7 @@ _nss_lsass_initgroups_dyn(
 
 error:
 
-    NSS_UNLOCK();
+    LsaNssCommonReleaseConnection(&gConnectionPool, &connection);
 
     return ret;
 }
@@ -78,12 +78,13 @@ _nss_lsass_setnetgrent (
     )
 {
     NSS_STATUS ret = NSS_STATUS_SUCCESS;
+    LSA_NSS_CACHED_HANDLE connection;
     PSTR pszValue = NULL;
 
-    NSS_LOCK();
+    LsaNssCommonAcquireConnection(&gConnectionPool, &connection);
 
     ret = LsaNssCommonNetgroupFindByName(
-        &lsaConnection,
+        &connection,
         group,
         &pszValue);
     BAIL_ON_NSS_ERROR(ret);
@@ -95,7 +96,7 @@ _nss_lsass_setnetgrent (
 
 error:
 
-    NSS_UNLOCK();
+    LsaNssCommonReleaseConnection(&gConnectionPool, &connection);
 
     return ret;
 }
@@ -122,17 +122,18 @@ _nss_lsass_getpwnam_r(
     )
 {
     NSS_STATUS status;
+    LSA_NSS_CACHED_HANDLE connection;
 
-    NSS_LOCK();
+    LsaNssCommonAcquireConnection(&gConnectionPool, &connection);
 
-    status = LsaNssCommonPasswdGetpwnam(&lsaConnection,
+    status = LsaNssCommonPasswdGetpwnam(&connection,
                                         pszLoginId,
                                         pResultUser,
                                         pszBuf,
                                         bufLen,
                                         pErrorNumber);
 
-    NSS_UNLOCK();
+    LsaNssCommonReleaseConnection(&gConnectionPool, &connection);
 
     return status;
 }
@@ -147,17 +148,18 @@ _nss_lsass_getpwuid_r(
     )
 {
     NSS_STATUS status;
+    LSA_NSS_CACHED_HANDLE connection;
 
-    NSS_LOCK();
+    LsaNssCommonAcquireConnection(&gConnectionPool, &connection);
 
-    status = LsaNssCommonPasswdGetpwuid(&lsaConnection,
+    status = LsaNssCommonPasswdGetpwuid(&connection,
                                         uid,
                                         pResultUser,
                                         pszBuf,
                                         bufLen,
                                         pErrorNumber);
 
-    NSS_UNLOCK();
+    LsaNssCommonReleaseConnection(&gConnectionPool, &connection);
 
     return status;
 }
@@ -87,6 +87,7 @@
 #include "metrics_p.h"
 #include "status_p.h"
 #include "config_p.h"
+#include "nssmap_p.h"
 
 #include "lsasrvapi.h"
 #include "lsasrvapi2.h"
@@ -95,6 +96,7 @@
 
 #include "lsaipc-common.h"
 #include "lsaipc.h"
+#include "lsanssmap.h"
 
 #include "ipc_error_p.h"
 #include "externs_p.h"
@@ -730,6 +730,21 @@ LsaSrvFindObjects(
         break;
     }
 
+    /* Only queries shaped like the ones the nsswitch module makes
+       produce the same answer it would get over IPC */
+    if (!pszTargetProvider &&
+        FindFlags == 0 &&
+        ObjectType == LSA_OBJECT_TYPE_USER &&
+        (QueryType == LSA_QUERY_TYPE_BY_NAME ||
+         QueryType == LSA_QUERY_TYPE_BY_UNIX_ID))
+    {
+        LsaSrvNssMapPublishUsers(
+            QueryType,
+            dwCount,
+            QueryList,
+            ppCombinedObjects);
+    }
+
     *pppObjects = ppCombinedObjects;
 
 cleanup:
@@ -1712,6 +1727,19 @@ LsaSrvFindGroupAndExpandedMembers(
         pppMemberObjects);
     BAIL_ON_LSA_ERROR(dwError);
 
+    if (!pszTargetProvider &&
+        FindFlags == LSA_FIND_FLAGS_NSS &&
+        (QueryType == LSA_QUERY_TYPE_BY_NAME ||
+         QueryType == LSA_QUERY_TYPE_BY_UNIX_ID))
+    {
+        LsaSrvNssMapPublishGroup(
+            QueryType,
+            QueryItem,
+            ppObjects[0],
+            *pdwMemberObjectCount,
+            *pppMemberObjects);
+    }
+
     *ppGroupObject = ppObjects[0];
     ppObjects[0] = NULL;
 
@@ -1839,6 +1867,9 @@ LsaSrvAddUser2(
         BAIL_ON_LSA_ERROR(dwError);
     }
 
+    /* The published NSS records may now be out of date */
+    LsaSrvNssMapInvalidate();
+
 cleanup:
 
     LW_SAFE_FREE_STRING(pszTargetProviderName);
@@ -1942,6 +1973,9 @@ LsaSrvModifyUser2(
         BAIL_ON_LSA_ERROR(dwError);
     }
 
+    /* The published NSS records may now be out of date */
+    LsaSrvNssMapInvalidate();
+
 cleanup:
 
     LW_SAFE_FREE_STRING(pszTargetProviderName);
@@ -2042,6 +2076,9 @@ LsaSrvAddGroup2(
         BAIL_ON_LSA_ERROR(dwError);
     }
 
+    /* The published NSS records may now be out of date */
+    LsaSrvNssMapInvalidate();
+
 cleanup:
 
     LW_SAFE_FREE_STRING(pszTargetProviderName);
@@ -2145,6 +2182,9 @@ LsaSrvModifyGroup2(
         BAIL_ON_LSA_ERROR(dwError);
     }
 
+    /* The published NSS records may now be out of date */
+    LsaSrvNssMapInvalidate();
+
 cleanup:
 
     LW_SAFE_FREE_STRING(pszTargetProviderName);
@@ -2249,6 +2289,9 @@ LsaSrvDeleteObject(
         BAIL_ON_LSA_ERROR(dwError);
     }
 
+    /* The published NSS records may now be out of date */
+    LsaSrvNssMapInvalidate();
+
 cleanup:
 
     LW_SAFE_FREE_STRING(pszTargetProviderName);
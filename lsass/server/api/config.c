@@ -85,6 +85,9 @@ LsaSrvRefreshConfiguration(
     pthread_mutex_unlock(&gAPIConfigLock);
     bUnlockConfigLock = FALSE;
 
+    /* Name formatting settings may have changed */
+    LsaSrvNssMapInvalidate();
+
     ENTER_AUTH_PROVIDER_LIST_READER_LOCK(bInLock);
 
     dwError = LW_ERROR_NOT_HANDLED;
@@ -148,6 +151,8 @@ LsaSrvApiInitConfig(
     pConfig->dwSaslMaxBufSize = 16777215;  // 16MB
     pConfig->cDomainSeparator = '\\';
     pConfig->cSpaceReplacement = '^';
+    pConfig->bEnableNssMap = TRUE;
+    pConfig->dwNssMapLifetime = LSA_NSS_MAP_DEFAULT_LIFETIME;
 
     return 0;
 }
@@ -202,6 +207,26 @@ LsaSrvApiReadRegistry(
            &StagingConfig.dwSaslMaxBufSize,
            NULL
         },
+        {
+           "EnableNssMap",
+           TRUE,
+           LwRegTypeBoolean,
+           0,
+           MAXDWORD,
+           NULL,
+           &StagingConfig.bEnableNssMap,
+           NULL
+        },
+        {
+           "NssMapEntryLifetime",
+           TRUE,
+           LwRegTypeDword,
+           1,
+           3600,
+           NULL,
+           &StagingConfig.dwNssMapLifetime,
+           NULL
+        },
     };
 
     memset(&StagingConfig, 0, sizeof(StagingConfig));
@@ -113,6 +113,9 @@ LsaSrvApiInit(
     dwError = LsaSrvInitAuthProviders(pStaticProviders);
     BAIL_ON_LSA_ERROR(dwError);
 
+    dwError = LsaSrvNssMapInit();
+    BAIL_ON_LSA_ERROR(dwError);
+
 #ifndef DISABLE_RPC_SERVERS
     dwError = LsaSrvInitRpcServers();
     BAIL_ON_LSA_ERROR(dwError);
@@ -134,6 +137,8 @@ LsaSrvApiShutdown(
     VOID
     )
 {
+    LsaSrvNssMapShutdown();
+
     LsaSrvFreeAuthProviders();
 
     LsaSrvFreeRpcServers();
@@ -874,6 +874,11 @@ LsaSrvIpcGetMetrics(
                 pMetricPack = NULL;
                 break;
 
+            case 2:
+                pResult->pMetricPack.pMetricPack2 = (PLSA_METRIC_PACK_2)pMetricPack;
+                pMetricPack = NULL;
+                break;
+
             default:
                 dwError = LW_ERROR_INVALID_PARAMETER;
                 BAIL_ON_LSA_ERROR(dwError);
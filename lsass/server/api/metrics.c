@@ -73,6 +73,12 @@ LsaSrvGetMetrics(
                             &pMetricPack);
             break;
 
+        case 2:
+
+            dwError = LsaSrvGetMetrics_2(
+                            &pMetricPack);
+            break;
+
         default:
 
             dwError = LW_ERROR_INVALID_METRIC_INFO_LEVEL;
@@ -160,6 +166,72 @@ LsaSrvGetMetrics_1(
                   (PVOID*)&pMetricPack);
     BAIL_ON_LSA_ERROR(dwError);
 
+    LsaSrvFillMetricPack_1(pMetricPack);
+
+    *ppMetricPack = pMetricPack;
+
+cleanup:
+
+    pthread_rwlock_unlock(&gPerfCounters_rwlock);
+
+    return dwError;
+
+error:
+
+    *ppMetricPack = NULL;
+
+    LW_SAFE_FREE_MEMORY(pMetricPack);
+
+    goto cleanup;
+}
+
+DWORD
+LsaSrvGetMetrics_2(
+    PVOID* ppMetricPack
+    )
+{
+    DWORD dwError = 0;
+    PLSA_METRIC_PACK_2 pMetricPack = NULL;
+
+    pthread_rwlock_rdlock(&gPerfCounters_rwlock);
+
+    dwError = LwAllocateMemory(
+                  sizeof(LSA_METRIC_PACK_2),
+                  (PVOID*)&pMetricPack);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    LsaSrvFillMetricPack_1(&pMetricPack->pack1);
+
+    pMetricPack->coalescedLookups =
+                 gPerfCounters[LsaMetricCoalescedLookups];
+    pMetricPack->mergedLookups =
+                 gPerfCounters[LsaMetricMergedLookups];
+    pMetricPack->mergedLookupBatches =
+                 gPerfCounters[LsaMetricMergedLookupBatches];
+
+    *ppMetricPack = pMetricPack;
+
+cleanup:
+
+    pthread_rwlock_unlock(&gPerfCounters_rwlock);
+
+    return dwError;
+
+error:
+
+    *ppMetricPack = NULL;
+
+    LW_SAFE_FREE_MEMORY(pMetricPack);
+
+    goto cleanup;
+}
+
+// Caller holds gPerfCounters_rwlock
+VOID
+LsaSrvFillMetricPack_1(
+    PLSA_METRIC_PACK_1 pMetricPack
+    )
+{
     pMetricPack->successfulAuthentications =
                  gPerfCounters[LsaMetricSuccessfulAuthentications];
     pMetricPack->failedAuthentications =
@@ -194,22 +266,6 @@ LsaSrvGetMetrics_1(
                  gPerfCounters[LsaMetricSuccessfulChangePassword];
     pMetricPack->failedChangePassword =
                  gPerfCounters[LsaMetricFailedChangePassword];
-
-    *ppMetricPack = pMetricPack;
-
-cleanup:
-
-    pthread_rwlock_unlock(&gPerfCounters_rwlock);
-
-    return dwError;
-
-error:
-
-    *ppMetricPack = NULL;
-
-    LW_SAFE_FREE_MEMORY(pMetricPack);
-
-    goto cleanup;
 }
 
 VOID
@@ -239,6 +295,9 @@ LsaSrvFreeIpcMetriPack(
             case 1:
                 LW_SAFE_FREE_MEMORY(pMetricPack->pMetricPack.pMetricPack1);
                 break;
+            case 2:
+                LW_SAFE_FREE_MEMORY(pMetricPack->pMetricPack.pMetricPack2);
+                break;
             default:
                 {
                     LSA_LOG_ERROR("Unsupported Metric Pack Info Level [%u]", pMetricPack->dwInfoLevel);
@@ -57,9 +57,14 @@ LsaSrvGetMetrics_1(
     PVOID* ppMetricPack
     );
 
+DWORD
+LsaSrvGetMetrics_2(
+    PVOID* ppMetricPack
+    );
+
 VOID
-LsaSrvIncrementMetricValue(
-    LsaMetricType metricType
+LsaSrvFillMetricPack_1(
+    PLSA_METRIC_PACK_1 pMetricPack
     );
 
 #endif /* __METRICS_P_H__ */
@@ -0,0 +1,586 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright Likewise Software
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.  You should have received a copy of the GNU General
+ * Public License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        nssmap.c
+ *
+ * Abstract:
+ *
+ *        Likewise Security and Authentication Subsystem (LSASS)
+ *
+ *        Shared NSS lookup map (Server)
+ *
+ *        Objects resolved for the nsswitch module are written into a
+ *        memory-mapped file so that later lookups from any process can
+ *        be answered without IPC.  Records come from whichever provider
+ *        answered the query (AD memory/sqlite cache or local provider).
+ *        See lsanssmap.h for the layout.
+ */
+
+#include "api.h"
+#include <sys/mman.h>
+
+#define LSA_NSS_MAP_NEW_PATH LSA_NSS_MAP_PATH ".new"
+
+static pthread_mutex_t gNssMapLock = PTHREAD_MUTEX_INITIALIZER;
+static PLSA_NSS_MAP_HEADER gpNssMap = NULL;
+
+static
+VOID
+LsaSrvNssMapRetire(
+    VOID
+    )
+{
+    int fd = -1;
+    PVOID pMap = MAP_FAILED;
+    PLSA_NSS_MAP_HEADER pHeader = NULL;
+
+    fd = open(LSA_NSS_MAP_PATH, O_RDWR);
+    if (fd < 0)
+    {
+        goto cleanup;
+    }
+
+    pMap = mmap(NULL,
+                sizeof(LSA_NSS_MAP_HEADER),
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED,
+                fd,
+                0);
+    if (pMap == MAP_FAILED)
+    {
+        goto cleanup;
+    }
+
+    /* Readers still holding this file will notice and remap */
+    pHeader = (PLSA_NSS_MAP_HEADER) pMap;
+    pHeader->dwMagic = 0;
+    LSA_NSS_MAP_BARRIER();
+
+cleanup:
+
+    if (pMap != MAP_FAILED)
+    {
+        munmap(pMap, sizeof(LSA_NSS_MAP_HEADER));
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+static
+BOOLEAN
+LsaSrvNssMapEnabled(
+    OUT OPTIONAL PDWORD pdwLifetime
+    )
+{
+    BOOLEAN bEnabled = FALSE;
+
+    pthread_mutex_lock(&gAPIConfigLock);
+
+    bEnabled = gAPIConfig.bEnableNssMap;
+    if (pdwLifetime)
+    {
+        *pdwLifetime = gAPIConfig.dwNssMapLifetime;
+    }
+
+    pthread_mutex_unlock(&gAPIConfigLock);
+
+    return bEnabled;
+}
+
+DWORD
+LsaSrvNssMapInit(
+    VOID
+    )
+{
+    DWORD dwError = 0;
+    int fd = -1;
+    PVOID pMap = MAP_FAILED;
+    PLSA_NSS_MAP_HEADER pHeader = NULL;
+
+    LsaSrvNssMapRetire();
+
+    if (!LsaSrvNssMapEnabled(NULL))
+    {
+        unlink(LSA_NSS_MAP_PATH);
+        goto cleanup;
+    }
+
+    fd = open(LSA_NSS_MAP_NEW_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        dwError = LwMapErrnoToLwError(errno);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    if (fchmod(fd, 0644) < 0 ||
+        ftruncate(fd, LSA_NSS_MAP_SIZE) < 0)
+    {
+        dwError = LwMapErrnoToLwError(errno);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    pMap = mmap(NULL,
+                LSA_NSS_MAP_SIZE,
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED,
+                fd,
+                0);
+    if (pMap == MAP_FAILED)
+    {
+        dwError = LwMapErrnoToLwError(errno);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    pHeader = (PLSA_NSS_MAP_HEADER) pMap;
+    pHeader->dwVersion = LSA_NSS_MAP_VERSION;
+    pHeader->dwSlotCount = LSA_NSS_MAP_SLOT_COUNT;
+    pHeader->dwSlotSize = sizeof(LSA_NSS_MAP_SLOT);
+    /* Zero-filled slots carry generation 0 and are never valid */
+    pHeader->dwGeneration = 1;
+    LSA_NSS_MAP_BARRIER();
+    pHeader->dwMagic = LSA_NSS_MAP_MAGIC;
+
+    if (rename(LSA_NSS_MAP_NEW_PATH, LSA_NSS_MAP_PATH) < 0)
+    {
+        dwError = LwMapErrnoToLwError(errno);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    pthread_mutex_lock(&gNssMapLock);
+    gpNssMap = pHeader;
+    pthread_mutex_unlock(&gNssMapLock);
+
+    pMap = MAP_FAILED;
+
+cleanup:
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    return dwError;
+
+error:
+
+    LSA_LOG_ERROR("Could not create NSS lookup map [error code %u]", dwError);
+
+    if (pMap != MAP_FAILED)
+    {
+        munmap(pMap, LSA_NSS_MAP_SIZE);
+    }
+
+    unlink(LSA_NSS_MAP_NEW_PATH);
+
+    /* The map is an optimization only */
+    dwError = 0;
+
+    goto cleanup;
+}
+
+VOID
+LsaSrvNssMapShutdown(
+    VOID
+    )
+{
+    pthread_mutex_lock(&gNssMapLock);
+
+    if (gpNssMap)
+    {
+        gpNssMap->dwMagic = 0;
+        LSA_NSS_MAP_BARRIER();
+        munmap(gpNssMap, LSA_NSS_MAP_SIZE);
+        gpNssMap = NULL;
+        unlink(LSA_NSS_MAP_PATH);
+    }
+
+    pthread_mutex_unlock(&gNssMapLock);
+}
+
+VOID
+LsaSrvNssMapInvalidate(
+    VOID
+    )
+{
+    pthread_mutex_lock(&gNssMapLock);
+
+    if (gpNssMap)
+    {
+        gpNssMap->dwGeneration++;
+        LSA_NSS_MAP_BARRIER();
+    }
+
+    pthread_mutex_unlock(&gNssMapLock);
+}
+
+static
+BOOLEAN
+LsaSrvNssMapSlotMatches(
+    IN PLSA_NSS_MAP_SLOT pSlot,
+    IN LSA_NSS_MAP_KEY_TYPE KeyType,
+    IN UINT32 dwKeyHash,
+    IN PCSTR pszKey,
+    IN DWORD dwId
+    )
+{
+    if (pSlot->dwKeyType != KeyType || pSlot->dwKeyHash != dwKeyHash)
+    {
+        return FALSE;
+    }
+
+    if (pszKey)
+    {
+        return strcmp(pSlot->Data, pszKey) == 0;
+    }
+
+    return pSlot->dwId == dwId;
+}
+
+static
+BOOLEAN
+LsaSrvNssMapSlotIsLive(
+    IN PLSA_NSS_MAP_SLOT pSlot,
+    IN time_t now
+    )
+{
+    return pSlot->dwGeneration == gpNssMap->dwGeneration &&
+           pSlot->qwExpires > (UINT64) now;
+}
+
+/*
+ * Must be called with gNssMapLock held.  Picks the slot already holding
+ * this key, else the first stale slot in the probe window, else the one
+ * closest to expiry.
+ */
+static
+PLSA_NSS_MAP_SLOT
+LsaSrvNssMapChooseSlot(
+    IN LSA_NSS_MAP_KEY_TYPE KeyType,
+    IN UINT32 dwKeyHash,
+    IN PCSTR pszKey,
+    IN DWORD dwId,
+    IN time_t now
+    )
+{
+    PLSA_NSS_MAP_SLOT pSlots = LSA_NSS_MAP_SLOTS(gpNssMap);
+    PLSA_NSS_MAP_SLOT pSlot = NULL;
+    PLSA_NSS_MAP_SLOT pVictim = NULL;
+    DWORD dwIndex = 0;
+
+    for (dwIndex = 0; dwIndex < LSA_NSS_MAP_PROBE_COUNT; dwIndex++)
+    {
+        pSlot = &pSlots[(dwKeyHash + dwIndex) % LSA_NSS_MAP_SLOT_COUNT];
+
+        if (!LsaSrvNssMapSlotIsLive(pSlot, now))
+        {
+            if (!pVictim || LsaSrvNssMapSlotIsLive(pVictim, now))
+            {
+                pVictim = pSlot;
+            }
+            continue;
+        }
+
+        if (LsaSrvNssMapSlotMatches(pSlot, KeyType, dwKeyHash, pszKey, dwId))
+        {
+            return pSlot;
+        }
+
+        if (!pVictim ||
+            (LsaSrvNssMapSlotIsLive(pVictim, now) &&
+             pSlot->qwExpires < pVictim->qwExpires))
+        {
+            pVictim = pSlot;
+        }
+    }
+
+    return pVictim;
+}
+
+static
+VOID
+LsaSrvNssMapStore(
+    IN LSA_NSS_MAP_KEY_TYPE KeyType,
+    IN OPTIONAL PCSTR pszKey,
+    IN DWORD dwId,
+    IN DWORD dwGid,
+    IN DWORD dwLifetime,
+    IN DWORD dwStringCount,
+    IN PCSTR* ppszStrings
+    )
+{
+    CHAR Data[LSA_NSS_MAP_SLOT_DATA_SIZE];
+    DWORD dwDataLength = 0;
+    DWORD dwIndex = 0;
+    DWORD dwLength = 0;
+    PCSTR pszString = NULL;
+    UINT32 dwKeyHash = LsaNssMapHashKey(KeyType, pszKey, dwId);
+    PLSA_NSS_MAP_SLOT pSlot = NULL;
+    time_t now = time(NULL);
+
+    for (dwIndex = 0; dwIndex < dwStringCount + (pszKey ? 1 : 0); dwIndex++)
+    {
+        if (pszKey)
+        {
+            pszString = dwIndex ? ppszStrings[dwIndex - 1] : pszKey;
+        }
+        else
+        {
+            pszString = ppszStrings[dwIndex];
+        }
+
+        if (!pszString)
+        {
+            pszString = "";
+        }
+
+        dwLength = strlen(pszString) + 1;
+        if (dwDataLength + dwLength > sizeof(Data))
+        {
+            /* Does not fit; lookups for it will keep using IPC */
+            return;
+        }
+
+        memcpy(Data + dwDataLength, pszString, dwLength);
+        dwDataLength += dwLength;
+    }
+
+    pthread_mutex_lock(&gNssMapLock);
+
+    if (!gpNssMap)
+    {
+        goto cleanup;
+    }
+
+    pSlot = LsaSrvNssMapChooseSlot(KeyType, dwKeyHash, pszKey, dwId, now);
+
+    pSlot->dwSequence++;
+    LSA_NSS_MAP_BARRIER();
+
+    pSlot->dwGeneration = gpNssMap->dwGeneration;
+    pSlot->dwKeyType = KeyType;
+    pSlot->dwKeyHash = dwKeyHash;
+    pSlot->dwId = dwId;
+    pSlot->dwGid = dwGid;
+    pSlot->qwExpires = (UINT64) now + dwLifetime;
+    pSlot->dwStringCount = dwStringCount;
+    pSlot->dwDataLength = dwDataLength;
+    memcpy(pSlot->Data, Data, dwDataLength);
+
+    LSA_NSS_MAP_BARRIER();
+    pSlot->dwSequence++;
+
+cleanup:
+
+    pthread_mutex_unlock(&gNssMapLock);
+}
+
+static
+BOOLEAN
+LsaSrvNssMapIsPublicPasswd(
+    IN PCSTR pszPasswd
+    )
+{
+    /* The map is world readable, so never copy anything that could be a hash */
+    return LW_IS_NULL_OR_EMPTY_STR(pszPasswd) || strlen(pszPasswd) == 1;
+}
+
+VOID
+LsaSrvNssMapPublishUsers(
+    IN LSA_QUERY_TYPE QueryType,
+    IN DWORD dwCount,
+    IN LSA_QUERY_LIST QueryList,
+    IN PLSA_SECURITY_OBJECT* ppObjects
+    )
+{
+    DWORD dwIndex = 0;
+    DWORD dwLifetime = 0;
+    PLSA_SECURITY_OBJECT pUser = NULL;
+    PCSTR ppszStrings[5];
+
+    if (!LsaSrvNssMapEnabled(&dwLifetime))
+    {
+        return;
+    }
+
+    for (dwIndex = 0; dwIndex < dwCount; dwIndex++)
+    {
+        pUser = ppObjects[dwIndex];
+
+        if (!pUser ||
+            pUser->type != LSA_OBJECT_TYPE_USER ||
+            !pUser->enabled ||
+            !pUser->userInfo.pszUnixName ||
+            !LsaSrvNssMapIsPublicPasswd(pUser->userInfo.pszPasswd))
+        {
+            continue;
+        }
+
+        ppszStrings[0] = pUser->userInfo.pszUnixName;
+        ppszStrings[1] = pUser->userInfo.pszPasswd;
+        ppszStrings[2] = pUser->userInfo.pszGecos;
+        ppszStrings[3] = pUser->userInfo.pszShell;
+        ppszStrings[4] = pUser->userInfo.pszHomedir;
+
+        if (QueryType == LSA_QUERY_TYPE_BY_NAME &&
+            strcmp(QueryList.ppszStrings[dwIndex], pUser->userInfo.pszUnixName))
+        {
+            LsaSrvNssMapStore(
+                LSA_NSS_MAP_KEY_USER_NAME,
+                QueryList.ppszStrings[dwIndex],
+                pUser->userInfo.uid,
+                pUser->userInfo.gid,
+                dwLifetime,
+                LW_ARRAY_SIZE(ppszStrings),
+                ppszStrings);
+        }
+
+        LsaSrvNssMapStore(
+            LSA_NSS_MAP_KEY_USER_NAME,
+            pUser->userInfo.pszUnixName,
+            pUser->userInfo.uid,
+            pUser->userInfo.gid,
+            dwLifetime,
+            LW_ARRAY_SIZE(ppszStrings),
+            ppszStrings);
+
+        LsaSrvNssMapStore(
+            LSA_NSS_MAP_KEY_USER_ID,
+            NULL,
+            pUser->userInfo.uid,
+            pUser->userInfo.gid,
+            dwLifetime,
+            LW_ARRAY_SIZE(ppszStrings),
+            ppszStrings);
+    }
+}
+
+VOID
+LsaSrvNssMapPublishGroup(
+    IN LSA_QUERY_TYPE QueryType,
+    IN LSA_QUERY_ITEM QueryItem,
+    IN PLSA_SECURITY_OBJECT pGroup,
+    IN DWORD dwMemberCount,
+    IN PLSA_SECURITY_OBJECT* ppMembers
+    )
+{
+    DWORD dwError = 0;
+    DWORD dwIndex = 0;
+    DWORD dwStringCount = 0;
+    DWORD dwLifetime = 0;
+    PCSTR* ppszStrings = NULL;
+
+    if (!LsaSrvNssMapEnabled(&dwLifetime) ||
+        !pGroup ||
+        pGroup->type != LSA_OBJECT_TYPE_GROUP ||
+        !pGroup->enabled ||
+        !pGroup->groupInfo.pszUnixName ||
+        !LsaSrvNssMapIsPublicPasswd(pGroup->groupInfo.pszPasswd))
+    {
+        goto cleanup;
+    }
+
+    /* Each member needs at least two bytes, so large groups never fit */
+    if (dwMemberCount > LSA_NSS_MAP_SLOT_DATA_SIZE / 2)
+    {
+        goto cleanup;
+    }
+
+    dwError = LwAllocateMemory(
+        sizeof(*ppszStrings) * (dwMemberCount + 2),
+        OUT_PPVOID(&ppszStrings));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    ppszStrings[dwStringCount++] = pGroup->groupInfo.pszUnixName;
+    ppszStrings[dwStringCount++] = pGroup->groupInfo.pszPasswd;
+
+    /* Same filtering the client applies in LsaMarshalGroupInfo1 */
+    for (dwIndex = 0; dwIndex < dwMemberCount; dwIndex++)
+    {
+        if (ppMembers[dwIndex] && ppMembers[dwIndex]->enabled)
+        {
+            if (ppMembers[dwIndex]->type != LSA_OBJECT_TYPE_USER ||
+                LW_IS_NULL_OR_EMPTY_STR(ppMembers[dwIndex]->userInfo.pszUnixName))
+            {
+                goto cleanup;
+            }
+
+            ppszStrings[dwStringCount++] = ppMembers[dwIndex]->userInfo.pszUnixName;
+        }
+    }
+
+    if (QueryType == LSA_QUERY_TYPE_BY_NAME &&
+        strcmp(QueryItem.pszString, pGroup->groupInfo.pszUnixName))
+    {
+        LsaSrvNssMapStore(
+            LSA_NSS_MAP_KEY_GROUP_NAME,
+            QueryItem.pszString,
+            pGroup->groupInfo.gid,
+            pGroup->groupInfo.gid,
+            dwLifetime,
+            dwStringCount,
+            ppszStrings);
+    }
+
+    LsaSrvNssMapStore(
+        LSA_NSS_MAP_KEY_GROUP_NAME,
+        pGroup->groupInfo.pszUnixName,
+        pGroup->groupInfo.gid,
+        pGroup->groupInfo.gid,
+        dwLifetime,
+        dwStringCount,
+        ppszStrings);
+
+    LsaSrvNssMapStore(
+        LSA_NSS_MAP_KEY_GROUP_ID,
+        NULL,
+        pGroup->groupInfo.gid,
+        pGroup->groupInfo.gid,
+        dwLifetime,
+        dwStringCount,
+        ppszStrings);
+
+cleanup:
+
+    LW_SAFE_FREE_MEMORY(ppszStrings);
+
+    return;
+
+error:
+
+    goto cleanup;
+}
@@ -0,0 +1,80 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright Likewise Software
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.  You should have received a copy of the GNU General
+ * Public License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        nssmap_p.h
+ *
+ * Abstract:
+ *
+ *        Likewise Security and Authentication Subsystem (LSASS)
+ *
+ *        Shared NSS lookup map (Server)
+ *
+ */
+#ifndef __NSSMAP_P_H__
+#define __NSSMAP_P_H__
+
+DWORD
+LsaSrvNssMapInit(
+    VOID
+    );
+
+VOID
+LsaSrvNssMapShutdown(
+    VOID
+    );
+
+VOID
+LsaSrvNssMapInvalidate(
+    VOID
+    );
+
+VOID
+LsaSrvNssMapPublishUsers(
+    IN LSA_QUERY_TYPE QueryType,
+    IN DWORD dwCount,
+    IN LSA_QUERY_LIST QueryList,
+    IN PLSA_SECURITY_OBJECT* ppObjects
+    );
+
+VOID
+LsaSrvNssMapPublishGroup(
+    IN LSA_QUERY_TYPE QueryType,
+    IN LSA_QUERY_ITEM QueryItem,
+    IN PLSA_SECURITY_OBJECT pGroup,
+    IN DWORD dwMemberCount,
+    IN PLSA_SECURITY_OBJECT* ppMembers
+    );
+
+#endif /* __NSSMAP_P_H__ */
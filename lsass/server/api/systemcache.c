@@ -106,6 +106,9 @@ LsaSrvFlushSystemCache(
 cleanup:
     LSA_LOG_VERBOSE("Finished flushing the Mac DirectoryService cache");
 #endif
+
+    LsaSrvNssMapInvalidate();
+
     return dwError;
 
 #if defined (__LWI_DARWIN__)
@@ -123,6 +123,8 @@ AD_InitializeConfig(
     pConfig->bSyncSystemTime  = TRUE;
     pConfig->dwCacheEntryExpirySecs   = AD_CACHE_ENTRY_EXPIRY_DEFAULT_SECS;
     pConfig->dwCacheSizeCap           = 0;
+    pConfig->bMemoryCacheLogEnabled   = FALSE;
+    pConfig->dwDomainLookupConcurrency = AD_DOMAIN_LOOKUP_CONCURRENCY_DEFAULT;
     pConfig->dwMachinePasswordSyncLifetime = AD_MACHINE_PASSWORD_SYNC_DEFAULT_SECS;
     pConfig->dwUmask          = AD_DEFAULT_UMASK;
 
@@ -349,6 +351,26 @@ AD_ReadRegistry(
             &StagingConfig.dwCacheSizeCap,
             NULL
         },
+        {
+            "MemoryCacheLogEnabled",
+            TRUE,
+            LwRegTypeBoolean,
+            0,
+            MAXDWORD,
+            NULL,
+            &StagingConfig.bMemoryCacheLogEnabled,
+            NULL
+        },
+        {
+            "DomainLookupConcurrency",
+            TRUE,
+            LwRegTypeDword,
+            AD_DOMAIN_LOOKUP_CONCURRENCY_MINIMUM,
+            AD_DOMAIN_LOOKUP_CONCURRENCY_MAXIMUM,
+            NULL,
+            &StagingConfig.dwDomainLookupConcurrency,
+            NULL
+        },
         {
             "LdapSignAndSeal",
             TRUE,
@@ -1950,6 +1972,40 @@ AD_GetCacheSizeCap(
     return dwResult;
 }
 
+BOOLEAN
+AD_GetMemoryCacheLogEnabled(
+    IN PLSA_AD_PROVIDER_STATE pState
+    )
+{
+    BOOLEAN result = FALSE;
+    BOOLEAN bInLock = FALSE;
+
+    ENTER_AD_CONFIG_RW_READER_LOCK(bInLock, pState);
+
+    result = pState->config.bMemoryCacheLogEnabled;
+
+    LEAVE_AD_CONFIG_RW_READER_LOCK(bInLock, pState);
+
+    return result;
+}
+
+DWORD
+AD_GetDomainLookupConcurrency(
+    IN PLSA_AD_PROVIDER_STATE pState
+    )
+{
+    DWORD dwResult = 0;
+    BOOLEAN bInLock = FALSE;
+
+    ENTER_AD_CONFIG_RW_READER_LOCK(bInLock, pState);
+
+    dwResult = pState->config.dwDomainLookupConcurrency;
+
+    LEAVE_AD_CONFIG_RW_READER_LOCK(bInLock, pState);
+
+    return dwResult;
+}
+
 BOOLEAN
 AD_GetTrimUserMembershipEnabled(
     IN PLSA_AD_PROVIDER_STATE pState
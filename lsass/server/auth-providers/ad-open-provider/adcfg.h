@@ -279,6 +279,16 @@ AD_GetCacheSizeCap(
     IN PLSA_AD_PROVIDER_STATE pState
     );
 
+BOOLEAN
+AD_GetMemoryCacheLogEnabled(
+    IN PLSA_AD_PROVIDER_STATE pState
+    );
+
+DWORD
+AD_GetDomainLookupConcurrency(
+    IN PLSA_AD_PROVIDER_STATE pState
+    );
+
 BOOLEAN
 AD_GetTrimUserMembershipEnabled(
     IN PLSA_AD_PROVIDER_STATE pState
@@ -66,6 +66,10 @@
 
 #define AD_MAX_ALLOWED_CLOCK_DRIFT_SECONDS 60
 
+#define AD_DOMAIN_LOOKUP_CONCURRENCY_MINIMUM 1
+#define AD_DOMAIN_LOOKUP_CONCURRENCY_DEFAULT 4
+#define AD_DOMAIN_LOOKUP_CONCURRENCY_MAXIMUM 64
+
 #define AD_STR_IS_SID(str) \
     (!LW_IS_NULL_OR_EMPTY_STR(str) && !strncasecmp(str, "s-", sizeof("s-")-1))
 
@@ -62,6 +62,7 @@
 #include <uuid/uuid.h>
 #include <lwnet.h>
 #include <lwio/lwio.h>
+#include <lw/base.h>
 #include <reg/lwreg.h>
 #include <reg/regutil.h>
 
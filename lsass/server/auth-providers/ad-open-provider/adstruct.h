@@ -74,6 +74,8 @@ typedef struct _LSA_AD_CONFIG {
 
     DWORD               dwCacheEntryExpirySecs;
     DWORD               dwCacheSizeCap;
+    BOOLEAN             bMemoryCacheLogEnabled;
+    DWORD               dwDomainLookupConcurrency;
     BOOLEAN             bEnableEventLog;
     BOOLEAN             bShouldLogNetworkConnectionEvents;
     BOOLEAN             bCreateK5Login;
@@ -200,6 +202,9 @@ typedef struct _LSA_AD_PROVIDER_STATE {
     LSA_MACHINEPWD_STATE_HANDLE hMachinePwdState;
 
     LSA_SCHANNEL_STATE_HANDLE hSchannelState;
+
+    /// Runs batch lookups against several domains at once.
+    PLW_THREAD_POOL pThreadPool;
 } LSA_AD_PROVIDER_STATE, *PLSA_AD_PROVIDER_STATE;
 
 typedef struct __AD_PROVIDER_CONTEXT
@@ -1115,6 +1115,13 @@ LsaAdBatchResolveObjectsForDomainList(
     PLSA_SECURITY_OBJECT* ppObjects = NULL;
     DWORD dwCurrentIndex = 0;
 
+    dwError = LsaAdBatchFindObjectsForDomainList(
+                    pContext,
+                    QueryType,
+                    pDomainList,
+                    bResolvePseudoObjects);
+    BAIL_ON_LSA_ERROR(dwError);
+
     for (pLinks = pDomainList->Next;
          pLinks != pDomainList;
          pLinks = pLinks->Next)
@@ -1126,13 +1133,6 @@ LsaAdBatchResolveObjectsForDomainList(
             continue;
         }
 
-        dwError = LsaAdBatchFindObjectsForDomainEntry(
-                      pContext,
-                      QueryType,
-                      bResolvePseudoObjects,
-                      pEntry);
-        BAIL_ON_LSA_ERROR(dwError);
-
         dwObjectsCount += pEntry->dwBatchItemCount;
     }
 
@@ -1620,7 +1620,7 @@ error:
 }
 
 DWORD
-LsaAdBatchFindObjects(
+LsaAdBatchFindObjectsDirect(
     IN PAD_PROVIDER_CONTEXT pContext,
     IN LSA_AD_BATCH_QUERY_TYPE QueryType,
     IN DWORD dwQueryItemsCount,
@@ -1691,6 +1691,225 @@ LsaAdBatchFindObjectsForDomainEntry(
                 &pEntry->BatchItemList);
 }
 
+static
+DWORD
+LsaAdBatchFindObjectsForDomainList(
+    IN PAD_PROVIDER_CONTEXT pContext,
+    IN LSA_AD_BATCH_QUERY_TYPE QueryType,
+    IN PLSA_LIST_LINKS pDomainList,
+    IN BOOLEAN bResolvePseudoObjects
+    )
+{
+    DWORD dwError = 0;
+    PLSA_AD_PROVIDER_STATE pState = pContext->pState;
+    // Do not free pLinks
+    PLSA_LIST_LINKS pLinks = NULL;
+    LSA_AD_BATCH_DOMAIN_JOBS jobs = { .Mutex = PTHREAD_MUTEX_INITIALIZER,
+                                      .Done = PTHREAD_COND_INITIALIZER };
+    DWORD dwConcurrency = 0;
+    DWORD dwIndex = 0;
+    PLW_WORK_ITEM pWorkItem = NULL;
+    BOOLEAN bInLock = FALSE;
+
+    for (pLinks = pDomainList->Next;
+         pLinks != pDomainList;
+         pLinks = pLinks->Next)
+    {
+        PLSA_AD_BATCH_DOMAIN_ENTRY pEntry = LW_STRUCT_FROM_FIELD(pLinks, LSA_AD_BATCH_DOMAIN_ENTRY, DomainEntryListLinks);
+
+        if (!IsSetFlag(pEntry->Flags, LSA_AD_BATCH_DOMAIN_ENTRY_FLAG_SKIP))
+        {
+            jobs.dwEntryCount++;
+        }
+    }
+
+    dwConcurrency = AD_GetDomainLookupConcurrency(pState);
+
+    if (jobs.dwEntryCount <= 1 || dwConcurrency <= 1 || !pState->pThreadPool)
+    {
+        for (pLinks = pDomainList->Next;
+             pLinks != pDomainList;
+             pLinks = pLinks->Next)
+        {
+            PLSA_AD_BATCH_DOMAIN_ENTRY pEntry = LW_STRUCT_FROM_FIELD(pLinks, LSA_AD_BATCH_DOMAIN_ENTRY, DomainEntryListLinks);
+
+            if (IsSetFlag(pEntry->Flags, LSA_AD_BATCH_DOMAIN_ENTRY_FLAG_SKIP))
+            {
+                continue;
+            }
+
+            dwError = LsaAdBatchFindObjectsForDomainEntry(
+                          pContext,
+                          QueryType,
+                          bResolvePseudoObjects,
+                          pEntry);
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+
+        goto cleanup;
+    }
+
+    jobs.pContext = pContext;
+    jobs.QueryType = QueryType;
+    jobs.bResolvePseudoObjects = bResolvePseudoObjects;
+
+    dwError = LwAllocateMemory(
+                    sizeof(*jobs.ppEntries) * jobs.dwEntryCount,
+                    OUT_PPVOID(&jobs.ppEntries));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwAllocateMemory(
+                    sizeof(*jobs.pdwErrors) * jobs.dwEntryCount,
+                    OUT_PPVOID(&jobs.pdwErrors));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    for (pLinks = pDomainList->Next;
+         pLinks != pDomainList;
+         pLinks = pLinks->Next)
+    {
+        PLSA_AD_BATCH_DOMAIN_ENTRY pEntry = LW_STRUCT_FROM_FIELD(pLinks, LSA_AD_BATCH_DOMAIN_ENTRY, DomainEntryListLinks);
+
+        if (!IsSetFlag(pEntry->Flags, LSA_AD_BATCH_DOMAIN_ENTRY_FLAG_SKIP))
+        {
+            jobs.ppEntries[dwIndex++] = pEntry;
+        }
+    }
+
+    // The calling thread takes part, so it only needs help for the rest
+    for (dwIndex = 1;
+         dwIndex < LW_MIN(dwConcurrency, jobs.dwEntryCount);
+         dwIndex++)
+    {
+        dwError = LwNtStatusToWin32Error(
+                        LwRtlCreateWorkItem(
+                            pState->pThreadPool,
+                            &pWorkItem,
+                            LsaAdBatchDomainJobsWorkItem,
+                            &jobs));
+        if (dwError)
+        {
+            // Whatever is left is done by the threads already running
+            LSA_LOG_DEBUG("Could not create work item for domain lookup (error = %u)", dwError);
+            dwError = 0;
+            break;
+        }
+
+        ENTER_MUTEX(&jobs.Mutex, bInLock);
+        jobs.dwWorkItemCount++;
+        LEAVE_MUTEX(&jobs.Mutex, bInLock);
+
+        LwRtlScheduleWorkItem(pWorkItem, 0);
+        pWorkItem = NULL;
+    }
+
+    LsaAdBatchRunDomainJobs(&jobs);
+
+    ENTER_MUTEX(&jobs.Mutex, bInLock);
+    while (jobs.dwWorkItemCount)
+    {
+        pthread_cond_wait(&jobs.Done, &jobs.Mutex);
+    }
+    LEAVE_MUTEX(&jobs.Mutex, bInLock);
+
+    // Report the error of the first domain in the list that failed,
+    // which is what a lookup of one domain at a time stops at.
+    for (dwIndex = 0; dwIndex < jobs.dwEntryCount; dwIndex++)
+    {
+        dwError = jobs.pdwErrors[dwIndex];
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+    LW_SAFE_FREE_MEMORY(jobs.ppEntries);
+    LW_SAFE_FREE_MEMORY(jobs.pdwErrors);
+
+    pthread_cond_destroy(&jobs.Done);
+    pthread_mutex_destroy(&jobs.Mutex);
+
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+static
+VOID
+LsaAdBatchRunDomainJobs(
+    IN OUT PLSA_AD_BATCH_DOMAIN_JOBS pJobs
+    )
+{
+    DWORD dwError = 0;
+    DWORD dwIndex = 0;
+    BOOLEAN bInLock = FALSE;
+
+    for (;;)
+    {
+        ENTER_MUTEX(&pJobs->Mutex, bInLock);
+        if (pJobs->bFailed || pJobs->dwNextEntry >= pJobs->dwEntryCount)
+        {
+            LEAVE_MUTEX(&pJobs->Mutex, bInLock);
+            break;
+        }
+        dwIndex = pJobs->dwNextEntry++;
+        LEAVE_MUTEX(&pJobs->Mutex, bInLock);
+
+        dwError = LsaAdBatchFindObjectsForDomainEntry(
+                      pJobs->pContext,
+                      pJobs->QueryType,
+                      pJobs->bResolvePseudoObjects,
+                      pJobs->ppEntries[dwIndex]);
+
+        ENTER_MUTEX(&pJobs->Mutex, bInLock);
+        pJobs->pdwErrors[dwIndex] = dwError;
+        if (dwError)
+        {
+            pJobs->bFailed = TRUE;
+        }
+        LEAVE_MUTEX(&pJobs->Mutex, bInLock);
+    }
+}
+
+static
+VOID
+LsaAdBatchDomainJobsWorkItem(
+    IN PLW_WORK_ITEM pWorkItem,
+    IN PVOID pContext
+    )
+{
+    DWORD dwError = 0;
+    PLSA_AD_BATCH_DOMAIN_JOBS pJobs = pContext;
+    BOOLEAN bInLock = FALSE;
+    PSTR pszPreviousCachePath = NULL;
+
+    // The gss ccache is per-thread and pool threads start without the
+    // machine's, so a trusted domain whose DC connection is not open yet
+    // would fail its GSSAPI bind here.  If it cannot be switched, leave
+    // the jobs to the calling thread, which already uses it.
+    dwError = LwKrb5SetThreadDefaultCachePath(
+                    pJobs->pContext->pState->MachineCreds.pszCachePath,
+                    &pszPreviousCachePath);
+    if (dwError)
+    {
+        LSA_LOG_DEBUG("Could not set krb5 cache for domain lookup (error = %u)", dwError);
+    }
+    else
+    {
+        LsaAdBatchRunDomainJobs(pJobs);
+
+        LwKrb5SetThreadDefaultCachePath(pszPreviousCachePath, NULL);
+        LW_SAFE_FREE_STRING(pszPreviousCachePath);
+    }
+
+    LwRtlFreeWorkItem(&pWorkItem);
+
+    ENTER_MUTEX(&pJobs->Mutex, bInLock);
+    if (--pJobs->dwWorkItemCount == 0)
+    {
+        pthread_cond_signal(&pJobs->Done);
+    }
+    LEAVE_MUTEX(&pJobs->Mutex, bInLock);
+}
+
 static
 DWORD
 LsaAdBatchFindObjectsForDomain(
@@ -1939,7 +2158,6 @@ LsaAdBatchResolveRealObjects(
     PLSA_DM_LDAP_CONNECTION pConn = NULL;
     LDAP* pLd = NULL;
     PSTR pszScopeDn = NULL;
-    PSTR pszQuery = 0;
     PSTR szAttributeList[] =
     {
         // AD attributes:
@@ -1970,40 +2188,61 @@ LsaAdBatchResolveRealObjects(
         AD_LDAP_LOCALWINDOWSHOMEFOLDER_TAG,
         NULL
     };
-    LDAPMessage* pMessage = NULL;
     PLSA_LIST_LINKS pLinks = NULL;
     PLSA_LIST_LINKS pNextLinks = NULL;
     DWORD dwMaxQuerySize = LsaAdBatchGetMaxQuerySize();
     DWORD dwMaxQueryCount = LsaAdBatchGetMaxQueryCount();
+    // One entry per query. Every query covers at least one item, and
+    // query N covers the items from ppQueryStartLinks[N] up to
+    // ppQueryStartLinks[N + 1].
+    PSTR* ppszQueries = NULL;
+    PLSA_LIST_LINKS* ppQueryStartLinks = NULL;
+    PDWORD pdwQueryCounts = NULL;
+    DWORD dwQueries = 0;
+    DWORD dwItemCount = 0;
+    DWORD dwIndex = 0;
+    LDAPMessage** ppMessages = NULL;
+
+    for (pLinks = pBatchItemList->Next;
+         pLinks != pBatchItemList;
+         pLinks = pLinks->Next)
+    {
+        dwItemCount++;
+    }
+
+    if (!dwItemCount)
+    {
+        goto cleanup;
+    }
 
     dwError = LwLdapConvertDomainToDN(
                        pszDnsDomainName,
                        &pszScopeDn);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = LsaDmLdapOpenDc(
-                  pContext,
-                  pszDnsDomainName,
-                  &pConn);
+    dwError = LwAllocateMemory(
+                    sizeof(*ppszQueries) * dwItemCount,
+                    OUT_PPVOID(&ppszQueries));
     BAIL_ON_LSA_ERROR(dwError);
 
+    dwError = LwAllocateMemory(
+                    sizeof(*ppQueryStartLinks) * (dwItemCount + 1),
+                    OUT_PPVOID(&ppQueryStartLinks));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwAllocateMemory(
+                    sizeof(*pdwQueryCounts) * dwItemCount,
+                    OUT_PPVOID(&pdwQueryCounts));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    // Build all of the queries first, so that they can be sent together.
+    // Processing a result only touches the items of its own query.
     for (pLinks = pBatchItemList->Next;
-         pLinks != pBatchItemList;
+         pLinks != pBatchItemList && dwQueries < dwItemCount;
          pLinks = pNextLinks)
     {
-        DWORD dwQueryCount = 0;
-        DWORD dwCount = 0;
-        LDAPMessage* pCurrentMessage = NULL;
-
         pNextLinks = NULL;
 
-        LW_SAFE_FREE_STRING(pszQuery);
-        if (pMessage)
-        {
-            ldap_msgfree(pMessage);
-            pMessage = NULL;
-        }
-
         dwError = LsaAdBatchBuildQueryForReal(
                         pState->pProviderData,
                         QueryType,
@@ -2012,27 +2251,55 @@ LsaAdBatchResolveRealObjects(
                         &pNextLinks,
                         dwMaxQuerySize,
                         dwMaxQueryCount,
-                        &dwQueryCount,
-                        &pszQuery);
+                        &pdwQueryCounts[dwQueries],
+                        &ppszQueries[dwQueries]);
         BAIL_ON_LSA_ERROR(dwError);
 
-        dwError = LsaDmLdapDirectorySearch(
-                        pConn,
-                        pszScopeDn,
-                        LDAP_SCOPE_SUBTREE,
-                        pszQuery,
-                        szAttributeList,
-                        &hDirectory,
-                        &pMessage);
-        BAIL_ON_LSA_ERROR(dwError);
+        if (!ppszQueries[dwQueries])
+        {
+            // None of the remaining items has a value to search for.
+            break;
+        }
 
-        pLd = LwLdapGetSession(hDirectory);
+        ppQueryStartLinks[dwQueries] = pLinks;
+        ppQueryStartLinks[dwQueries + 1] = pNextLinks;
+        dwQueries++;
+    }
 
-        dwCount = ldap_count_entries(pLd, pMessage);
-        if (dwCount > dwQueryCount)
+    if (!dwQueries)
+    {
+        goto cleanup;
+    }
+
+    dwError = LsaDmLdapOpenDc(
+                  pContext,
+                  pszDnsDomainName,
+                  &pConn);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LsaDmLdapDirectoryPipelinedSearch(
+                    pConn,
+                    pszScopeDn,
+                    LDAP_SCOPE_SUBTREE,
+                    dwQueries,
+                    ppszQueries,
+                    szAttributeList,
+                    &hDirectory,
+                    &ppMessages);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pLd = LwLdapGetSession(hDirectory);
+
+    for (dwIndex = 0; dwIndex < dwQueries; dwIndex++)
+    {
+        DWORD dwCount = 0;
+        LDAPMessage* pCurrentMessage = NULL;
+
+        dwCount = ldap_count_entries(pLd, ppMessages[dwIndex]);
+        if (dwCount > pdwQueryCounts[dwIndex])
         {
             LSA_LOG_ERROR("Too many results returned (got %u, expected %u)",
-                          dwCount, dwQueryCount);
+                          dwCount, pdwQueryCounts[dwIndex]);
             dwError = LW_ERROR_LDAP_ERROR;
             BAIL_ON_LSA_ERROR(dwError);
         }
@@ -2041,14 +2308,14 @@ LsaAdBatchResolveRealObjects(
             continue;
         }
 
-        pCurrentMessage = ldap_first_entry(pLd, pMessage);
+        pCurrentMessage = ldap_first_entry(pLd, ppMessages[dwIndex]);
         while (pCurrentMessage)
         {
             dwError = LsaAdBatchProcessRealObject(
                             pState->pProviderData,
                             QueryType,
-                            pLinks,
-                            pNextLinks,
+                            ppQueryStartLinks[dwIndex],
+                            ppQueryStartLinks[dwIndex + 1],
                             hDirectory,
                             pCurrentMessage);
             BAIL_ON_LSA_ERROR(dwError);
@@ -2060,11 +2327,18 @@ LsaAdBatchResolveRealObjects(
 cleanup:
     LsaDmLdapClose(pConn);
     LW_SAFE_FREE_STRING(pszScopeDn);
-    LW_SAFE_FREE_STRING(pszQuery);
-    if (pMessage)
+    for (dwIndex = 0; dwIndex < dwQueries; dwIndex++)
     {
-        ldap_msgfree(pMessage);
+        LW_SAFE_FREE_STRING(ppszQueries[dwIndex]);
+        if (ppMessages && ppMessages[dwIndex])
+        {
+            ldap_msgfree(ppMessages[dwIndex]);
+        }
     }
+    LW_SAFE_FREE_MEMORY(ppszQueries);
+    LW_SAFE_FREE_MEMORY(ppQueryStartLinks);
+    LW_SAFE_FREE_MEMORY(pdwQueryCounts);
+    LW_SAFE_FREE_MEMORY(ppMessages);
     return dwError;
 
 error:
@@ -68,6 +68,19 @@ LsaAdBatchFindObjects(
     OUT PLSA_SECURITY_OBJECT** pppObjects
     );
 
+// Same as LsaAdBatchFindObjects, without waiting for or merging with
+// concurrent lookups of the same objects
+DWORD
+LsaAdBatchFindObjectsDirect(
+    IN PAD_PROVIDER_CONTEXT pContext,
+    IN LSA_AD_BATCH_QUERY_TYPE QueryType,
+    IN DWORD dwQueryItemsCount,
+    IN OPTIONAL PSTR* ppszQueryList,
+    IN OPTIONAL PDWORD pdwId,
+    OUT PDWORD pdwObjectsCount,
+    OUT PLSA_SECURITY_OBJECT** pppObjects
+    );
+
 DWORD
 LsaAdBatchFindSingleObject(
     IN PAD_PROVIDER_CONTEXT pContext,
@@ -0,0 +1,776 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright Likewise Software
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.  You should have received a copy of the GNU General
+ * Public License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        batch_coalesce.c
+ *
+ * Abstract:
+ *
+ *        Likewise Security and Authentication Subsystem (LSASS)
+ *
+ *        Active Directory Authentication Provider
+ *
+ *        Coalescing of concurrent batch lookups
+ *
+ *        Every query term that is being looked up in AD is tracked as a
+ *        "flight".  A lookup for a term that already has a flight waits
+ *        for that flight's result instead of querying the DC again.
+ *
+ *        Single-object lookups by sid, DN, uid or gid that miss are also
+ *        queued for a short time while other lookups of the same kind are
+ *        in progress, so that they can be sent to the DC as one batch.
+ *        The objects that come back are handed to the flights they match.
+ *
+ *        A flight is sent with the provider context of the lookup that
+ *        started it, so lookups only share a flight or a batch when they
+ *        come from the same provider state and the same caller (uid/gid).
+ */
+
+#include "adprovider.h"
+
+// How long a single-object lookup waits for others to merge with, if
+// lookups of the same kind are already being sent
+#define LSA_AD_BATCH_COALESCE_WINDOW_MSECS 5
+#define LSA_AD_BATCH_COALESCE_MAX_MERGED 100
+
+#define LSA_AD_BATCH_COALESCE_QUERY_TYPE_COUNT (LSA_AD_BATCH_QUERY_TYPE_BY_GID + 1)
+
+typedef struct _LSA_AD_BATCH_FLIGHT
+{
+    // Key of this flight in gLsaAdBatchCoalesce.pFlights
+    PSTR pszKey;
+    BOOLEAN bRegistered;
+    PLSA_AD_PROVIDER_STATE pState;
+    // Caller of the lookup that started the flight
+    uid_t Uid;
+    gid_t Gid;
+    // Do not free. Owned by the caller that started the flight, which waits
+    // for it to finish.
+    PSTR pszQueryTerm;
+    DWORD dwId;
+    // The thread that sends the query
+    pthread_t Leader;
+
+    BOOLEAN bDone;
+    DWORD dwError;
+    DWORD dwObjectsCount;
+    PLSA_SECURITY_OBJECT* ppObjects;
+
+    // One for every caller that waits for the flight
+    DWORD dwRefCount;
+    // Next lookup waiting to be merged
+    struct _LSA_AD_BATCH_FLIGHT* pNextMerge;
+} LSA_AD_BATCH_FLIGHT, *PLSA_AD_BATCH_FLIGHT;
+
+typedef struct _LSA_AD_BATCH_MERGE_QUEUE
+{
+    // Flight of the lookup that collects the queue, or NULL if nothing
+    // collects it
+    PLSA_AD_BATCH_FLIGHT pCollector;
+    PLSA_AD_BATCH_FLIGHT pPending;
+    DWORD dwPendingCount;
+    // Number of queries of this type currently sent to the DC
+    DWORD dwInProgress;
+} LSA_AD_BATCH_MERGE_QUEUE, *PLSA_AD_BATCH_MERGE_QUEUE;
+
+static struct
+{
+    pthread_mutex_t Mutex;
+    // Broadcast whenever flights finish
+    pthread_cond_t FlightDone;
+    // Signaled when a merge queue is full
+    pthread_cond_t MergeFull;
+    PLW_HASH_TABLE pFlights;
+    size_t sFlightsTableSize;
+    LSA_AD_BATCH_MERGE_QUEUE Merge[LSA_AD_BATCH_COALESCE_QUERY_TYPE_COUNT];
+} gLsaAdBatchCoalesce =
+{
+    .Mutex = PTHREAD_MUTEX_INITIALIZER,
+    .FlightDone = PTHREAD_COND_INITIALIZER,
+    .MergeFull = PTHREAD_COND_INITIALIZER
+};
+
+static
+BOOLEAN
+LsaAdBatchCoalesceIsMergeable(
+    IN LSA_AD_BATCH_QUERY_TYPE QueryType
+    )
+{
+    // The results of these can be matched back to the query terms
+    switch (QueryType)
+    {
+        case LSA_AD_BATCH_QUERY_TYPE_BY_SID:
+        case LSA_AD_BATCH_QUERY_TYPE_BY_DN:
+        case LSA_AD_BATCH_QUERY_TYPE_BY_UID:
+        case LSA_AD_BATCH_QUERY_TYPE_BY_GID:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+static
+BOOLEAN
+LsaAdBatchCoalesceIsSameCaller(
+    IN PLSA_AD_BATCH_FLIGHT pFlight1,
+    IN PLSA_AD_BATCH_FLIGHT pFlight2
+    )
+{
+    return pFlight1->pState == pFlight2->pState &&
+           pFlight1->Uid == pFlight2->Uid &&
+           pFlight1->Gid == pFlight2->Gid;
+}
+
+static
+BOOLEAN
+LsaAdBatchCoalesceIsMatch(
+    IN LSA_AD_BATCH_QUERY_TYPE QueryType,
+    IN PLSA_AD_BATCH_FLIGHT pFlight,
+    IN PLSA_SECURITY_OBJECT pObject
+    )
+{
+    switch (QueryType)
+    {
+        case LSA_AD_BATCH_QUERY_TYPE_BY_SID:
+            return pObject->pszObjectSid &&
+                   LwRtlCStringIsEqual(
+                       pFlight->pszQueryTerm,
+                       pObject->pszObjectSid,
+                       FALSE);
+        case LSA_AD_BATCH_QUERY_TYPE_BY_DN:
+            return pObject->pszDN &&
+                   LwRtlCStringIsEqual(
+                       pFlight->pszQueryTerm,
+                       pObject->pszDN,
+                       FALSE);
+        case LSA_AD_BATCH_QUERY_TYPE_BY_UID:
+            return pObject->type == LSA_OBJECT_TYPE_USER &&
+                   pObject->userInfo.uid == pFlight->dwId;
+        case LSA_AD_BATCH_QUERY_TYPE_BY_GID:
+            return pObject->type == LSA_OBJECT_TYPE_GROUP &&
+                   pObject->groupInfo.gid == pFlight->dwId;
+        default:
+            return FALSE;
+    }
+}
+
+static
+VOID
+LsaAdBatchCoalesceReleaseFlightInLock(
+    IN PLSA_AD_BATCH_FLIGHT pFlight
+    )
+{
+    LSA_ASSERT(pFlight->dwRefCount > 0);
+
+    if (--pFlight->dwRefCount == 0)
+    {
+        LSA_ASSERT(!pFlight->bRegistered);
+        ADCacheSafeFreeObjectList(pFlight->dwObjectsCount, &pFlight->ppObjects);
+        LW_SAFE_FREE_STRING(pFlight->pszKey);
+        LwFreeMemory(pFlight);
+    }
+}
+
+static
+DWORD
+LsaAdBatchCoalesceRegisterFlightInLock(
+    IN PLSA_AD_BATCH_FLIGHT pFlight
+    )
+{
+    DWORD dwError = 0;
+
+    if (!gLsaAdBatchCoalesce.pFlights)
+    {
+        dwError = LwHashCreate(
+                        64,
+                        LwHashCaselessStringCompare,
+                        LwHashCaselessStringHash,
+                        NULL,
+                        NULL,
+                        &gLsaAdBatchCoalesce.pFlights);
+        BAIL_ON_LSA_ERROR(dwError);
+        gLsaAdBatchCoalesce.sFlightsTableSize = 64;
+    }
+
+    // The table does not grow on its own
+    if (LwHashGetKeyCount(gLsaAdBatchCoalesce.pFlights) * 2 >=
+            gLsaAdBatchCoalesce.sFlightsTableSize)
+    {
+        dwError = LwHashResize(
+                        gLsaAdBatchCoalesce.pFlights,
+                        gLsaAdBatchCoalesce.sFlightsTableSize * 2);
+        BAIL_ON_LSA_ERROR(dwError);
+        gLsaAdBatchCoalesce.sFlightsTableSize *= 2;
+    }
+
+    dwError = LwHashSetValue(
+                    gLsaAdBatchCoalesce.pFlights,
+                    pFlight->pszKey,
+                    pFlight);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pFlight->bRegistered = TRUE;
+
+error:
+    return dwError;
+}
+
+// Sends one query for all of the flights and hands every object that comes
+// back to the flight it belongs to. Called without the lock.
+static
+VOID
+LsaAdBatchCoalesceSendFlights(
+    IN PAD_PROVIDER_CONTEXT pContext,
+    IN LSA_AD_BATCH_QUERY_TYPE QueryType,
+    IN DWORD dwFlightCount,
+    IN PLSA_AD_BATCH_FLIGHT* ppFlights
+    )
+{
+    DWORD dwError = 0;
+    PSTR* ppszQueryList = NULL;
+    PDWORD pdwIdList = NULL;
+    DWORD dwObjectsCount = 0;
+    PLSA_SECURITY_OBJECT* ppObjects = NULL;
+    DWORD dwIndex = 0;
+    DWORD dwObjectIndex = 0;
+    // Do not free
+    PLSA_AD_BATCH_FLIGHT pFlight = NULL;
+    PDWORD pdwOwners = NULL;
+    BOOLEAN bInLock = FALSE;
+
+    if (ppFlights[0]->pszQueryTerm)
+    {
+        dwError = LwAllocateMemory(
+                        sizeof(*ppszQueryList) * dwFlightCount,
+                        OUT_PPVOID(&ppszQueryList));
+        BAIL_ON_LSA_ERROR(dwError);
+
+        for (dwIndex = 0; dwIndex < dwFlightCount; dwIndex++)
+        {
+            ppszQueryList[dwIndex] = ppFlights[dwIndex]->pszQueryTerm;
+        }
+    }
+    else
+    {
+        dwError = LwAllocateMemory(
+                        sizeof(*pdwIdList) * dwFlightCount,
+                        OUT_PPVOID(&pdwIdList));
+        BAIL_ON_LSA_ERROR(dwError);
+
+        for (dwIndex = 0; dwIndex < dwFlightCount; dwIndex++)
+        {
+            pdwIdList[dwIndex] = ppFlights[dwIndex]->dwId;
+        }
+    }
+
+    dwError = LsaAdBatchFindObjectsDirect(
+                    pContext,
+                    QueryType,
+                    dwFlightCount,
+                    ppszQueryList,
+                    pdwIdList,
+                    &dwObjectsCount,
+                    &ppObjects);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (dwFlightCount == 1)
+    {
+        // Everything that was found belongs to the only flight
+        ppFlights[0]->dwObjectsCount = dwObjectsCount;
+        ppFlights[0]->ppObjects = ppObjects;
+        ppObjects = NULL;
+        dwObjectsCount = 0;
+    }
+    else if (dwObjectsCount)
+    {
+        dwError = LwAllocateMemory(
+                        sizeof(*pdwOwners) * dwObjectsCount,
+                        OUT_PPVOID(&pdwOwners));
+        BAIL_ON_LSA_ERROR(dwError);
+
+        for (dwObjectIndex = 0; dwObjectIndex < dwObjectsCount; dwObjectIndex++)
+        {
+            pdwOwners[dwObjectIndex] = dwFlightCount;
+
+            if (!ppObjects[dwObjectIndex])
+            {
+                continue;
+            }
+
+            for (dwIndex = 0; dwIndex < dwFlightCount; dwIndex++)
+            {
+                if (LsaAdBatchCoalesceIsMatch(
+                        QueryType,
+                        ppFlights[dwIndex],
+                        ppObjects[dwObjectIndex]))
+                {
+                    pdwOwners[dwObjectIndex] = dwIndex;
+                    ppFlights[dwIndex]->dwObjectsCount++;
+                    break;
+                }
+            }
+
+            if (pdwOwners[dwObjectIndex] == dwFlightCount)
+            {
+                LSA_LOG_DEBUG("Dropping object %s, which does not match any merged lookup",
+                        LSA_SAFE_LOG_STRING(ppObjects[dwObjectIndex]->pszObjectSid));
+            }
+        }
+
+        for (dwIndex = 0; dwIndex < dwFlightCount; dwIndex++)
+        {
+            pFlight = ppFlights[dwIndex];
+
+            if (pFlight->dwObjectsCount)
+            {
+                dwError = LwAllocateMemory(
+                                sizeof(*pFlight->ppObjects) *
+                                    pFlight->dwObjectsCount,
+                                OUT_PPVOID(&pFlight->ppObjects));
+                BAIL_ON_LSA_ERROR(dwError);
+                pFlight->dwObjectsCount = 0;
+            }
+        }
+
+        for (dwObjectIndex = 0; dwObjectIndex < dwObjectsCount; dwObjectIndex++)
+        {
+            if (pdwOwners[dwObjectIndex] < dwFlightCount)
+            {
+                pFlight = ppFlights[pdwOwners[dwObjectIndex]];
+                pFlight->ppObjects[pFlight->dwObjectsCount++] =
+                    ppObjects[dwObjectIndex];
+                ppObjects[dwObjectIndex] = NULL;
+            }
+        }
+    }
+
+cleanup:
+    ENTER_MUTEX(&gLsaAdBatchCoalesce.Mutex, bInLock);
+
+    gLsaAdBatchCoalesce.Merge[QueryType].dwInProgress--;
+
+    for (dwIndex = 0; dwIndex < dwFlightCount; dwIndex++)
+    {
+        pFlight = ppFlights[dwIndex];
+
+        pFlight->dwError = dwError;
+        pFlight->bDone = TRUE;
+
+        if (pFlight->bRegistered)
+        {
+            // Later lookups find the object in the cache
+            LwHashRemoveKey(
+                gLsaAdBatchCoalesce.pFlights,
+                pFlight->pszKey);
+            pFlight->bRegistered = FALSE;
+        }
+    }
+
+    pthread_cond_broadcast(&gLsaAdBatchCoalesce.FlightDone);
+
+    LEAVE_MUTEX(&gLsaAdBatchCoalesce.Mutex, bInLock);
+
+    ADCacheSafeFreeObjectList(dwObjectsCount, &ppObjects);
+    LW_SAFE_FREE_MEMORY(ppszQueryList);
+    LW_SAFE_FREE_MEMORY(pdwIdList);
+    LW_SAFE_FREE_MEMORY(pdwOwners);
+
+    return;
+
+error:
+    for (dwIndex = 0; dwIndex < dwFlightCount; dwIndex++)
+    {
+        ADCacheSafeFreeObjectList(
+            ppFlights[dwIndex]->dwObjectsCount,
+            &ppFlights[dwIndex]->ppObjects);
+        ppFlights[dwIndex]->dwObjectsCount = 0;
+    }
+
+    goto cleanup;
+}
+
+// Queues a single-object lookup to be merged with others of the same type.
+// Returns the flights to send if the caller ends up collecting the queue, or
+// nothing if another lookup will send the flight.
+static
+VOID
+LsaAdBatchCoalesceMergeInLock(
+    IN PLSA_AD_BATCH_FLIGHT pFlight,
+    IN LSA_AD_BATCH_QUERY_TYPE QueryType,
+    IN OUT PLSA_AD_BATCH_FLIGHT* ppSendList,
+    OUT PDWORD pdwSendCount
+    )
+{
+    PLSA_AD_BATCH_MERGE_QUEUE pQueue = &gLsaAdBatchCoalesce.Merge[QueryType];
+    struct timespec deadline = {0, 0};
+    DWORD dwSendCount = 0;
+    PLSA_AD_BATCH_FLIGHT pPos = NULL;
+    pthread_t self = pthread_self();
+
+    if (pQueue->pCollector &&
+        (!LsaAdBatchCoalesceIsSameCaller(pQueue->pCollector, pFlight) ||
+         pQueue->dwPendingCount >= LSA_AD_BATCH_COALESCE_MAX_MERGED))
+    {
+        // The queue is full or collects lookups of another domain or
+        // caller. Send this one alone.
+        ppSendList[dwSendCount++] = pFlight;
+        goto cleanup;
+    }
+
+    pFlight->pNextMerge = pQueue->pPending;
+    pQueue->pPending = pFlight;
+    pQueue->dwPendingCount++;
+
+    if (pQueue->pCollector)
+    {
+        if (pQueue->dwPendingCount >= LSA_AD_BATCH_COALESCE_MAX_MERGED)
+        {
+            pthread_cond_signal(&gLsaAdBatchCoalesce.MergeFull);
+        }
+        goto cleanup;
+    }
+
+    // Collect the queue. Nothing is gained by waiting unless other lookups
+    // of this type are in progress.
+    pQueue->pCollector = pFlight;
+
+    if (pQueue->dwInProgress)
+    {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LSA_AD_BATCH_COALESCE_WINDOW_MSECS * 1000000;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        while (pQueue->dwPendingCount < LSA_AD_BATCH_COALESCE_MAX_MERGED)
+        {
+            if (pthread_cond_timedwait(
+                    &gLsaAdBatchCoalesce.MergeFull,
+                    &gLsaAdBatchCoalesce.Mutex,
+                    &deadline) == ETIMEDOUT)
+            {
+                break;
+            }
+        }
+    }
+
+    for (pPos = pQueue->pPending; pPos; pPos = pPos->pNextMerge)
+    {
+        // This thread sends the query now. A lookup it makes while doing so
+        // must not wait for any of these flights.
+        pPos->Leader = self;
+        ppSendList[dwSendCount++] = pPos;
+    }
+
+    if (dwSendCount > 1)
+    {
+        LsaSrvIncrementMetricValue(LsaMetricMergedLookupBatches);
+        for (pPos = pQueue->pPending; pPos; pPos = pPos->pNextMerge)
+        {
+            LsaSrvIncrementMetricValue(LsaMetricMergedLookups);
+        }
+    }
+
+    pQueue->pPending = NULL;
+    pQueue->dwPendingCount = 0;
+    pQueue->pCollector = NULL;
+
+cleanup:
+    *pdwSendCount = dwSendCount;
+}
+
+DWORD
+LsaAdBatchFindObjects(
+    IN PAD_PROVIDER_CONTEXT pContext,
+    IN LSA_AD_BATCH_QUERY_TYPE QueryType,
+    IN DWORD dwQueryItemsCount,
+    IN OPTIONAL PSTR* ppszQueryList,
+    IN OPTIONAL PDWORD pdwId,
+    OUT PDWORD pdwObjectsCount,
+    OUT PLSA_SECURITY_OBJECT** pppObjects
+    )
+{
+    DWORD dwError = 0;
+    BOOLEAN bInLock = FALSE;
+    PLSA_AD_BATCH_FLIGHT* ppFlights = NULL;
+    PLSA_AD_BATCH_FLIGHT* ppSendList = NULL;
+    DWORD dwSendCount = 0;
+    PLSA_AD_BATCH_FLIGHT pFlight = NULL;
+    // Do not free
+    PLSA_AD_BATCH_FLIGHT pExisting = NULL;
+    DWORD dwFlightCount = 0;
+    DWORD dwIndex = 0;
+    DWORD dwObjectIndex = 0;
+    DWORD dwObjectsCount = 0;
+    PLSA_SECURITY_OBJECT* ppObjects = NULL;
+    pthread_t self = pthread_self();
+
+    if (!dwQueryItemsCount ||
+        QueryType >= LSA_AD_BATCH_COALESCE_QUERY_TYPE_COUNT ||
+        !LSA_IS_XOR(ppszQueryList, pdwId) ||
+        (dwQueryItemsCount > 1 && !LsaAdBatchCoalesceIsMergeable(QueryType)))
+    {
+        // The results cannot be told apart by query term
+        return LsaAdBatchFindObjectsDirect(
+                    pContext,
+                    QueryType,
+                    dwQueryItemsCount,
+                    ppszQueryList,
+                    pdwId,
+                    pdwObjectsCount,
+                    pppObjects);
+    }
+
+    dwError = LwAllocateMemory(
+                    sizeof(*ppFlights) * dwQueryItemsCount,
+                    OUT_PPVOID(&ppFlights));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwAllocateMemory(
+                    sizeof(*ppSendList) *
+                        LW_MAX(dwQueryItemsCount, LSA_AD_BATCH_COALESCE_MAX_MERGED),
+                    OUT_PPVOID(&ppSendList));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    ENTER_MUTEX(&gLsaAdBatchCoalesce.Mutex, bInLock);
+
+    for (dwIndex = 0; dwIndex < dwQueryItemsCount; dwIndex++)
+    {
+        dwError = LwAllocateMemory(sizeof(*pFlight), OUT_PPVOID(&pFlight));
+        BAIL_ON_LSA_ERROR(dwError);
+
+        pFlight->pState = pContext->pState;
+        pFlight->Uid = pContext->uid;
+        pFlight->Gid = pContext->gid;
+        pFlight->Leader = self;
+        pFlight->dwRefCount = 1;
+
+        if (ppszQueryList)
+        {
+            pFlight->pszQueryTerm = ppszQueryList[dwIndex];
+            dwError = LwAllocateStringPrintf(
+                            &pFlight->pszKey,
+                            "%p/%u/%u/%u/%s",
+                            pContext->pState,
+                            (unsigned int) pContext->uid,
+                            (unsigned int) pContext->gid,
+                            QueryType,
+                            LSA_SAFE_LOG_STRING(pFlight->pszQueryTerm));
+        }
+        else
+        {
+            pFlight->dwId = pdwId[dwIndex];
+            dwError = LwAllocateStringPrintf(
+                            &pFlight->pszKey,
+                            "%p/%u/%u/%u/#%u",
+                            pContext->pState,
+                            (unsigned int) pContext->uid,
+                            (unsigned int) pContext->gid,
+                            QueryType,
+                            pFlight->dwId);
+        }
+        BAIL_ON_LSA_ERROR(dwError);
+
+        pExisting = NULL;
+        if (gLsaAdBatchCoalesce.pFlights)
+        {
+            dwError = LwHashGetValue(
+                            gLsaAdBatchCoalesce.pFlights,
+                            pFlight->pszKey,
+                            OUT_PPVOID(&pExisting));
+            if (dwError == ERROR_NOT_FOUND)
+            {
+                dwError = 0;
+            }
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+
+        if (pExisting && !pthread_equal(pExisting->Leader, self))
+        {
+            // Somebody else is already looking this up
+            LsaSrvIncrementMetricValue(LsaMetricCoalescedLookups);
+            pExisting->dwRefCount++;
+            ppFlights[dwFlightCount++] = pExisting;
+            LsaAdBatchCoalesceReleaseFlightInLock(pFlight);
+            pFlight = NULL;
+            continue;
+        }
+
+        if (!pExisting)
+        {
+            // A lookup this thread makes while it sends the same term is
+            // not registered, so it cannot wait for itself
+            dwError = LsaAdBatchCoalesceRegisterFlightInLock(pFlight);
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+
+        ppFlights[dwFlightCount++] = pFlight;
+        ppSendList[dwSendCount++] = pFlight;
+        pFlight = NULL;
+    }
+
+    gLsaAdBatchCoalesce.Merge[QueryType].dwInProgress++;
+
+    if (dwSendCount == 1 &&
+        dwQueryItemsCount == 1 &&
+        ppSendList[0]->bRegistered &&
+        LsaAdBatchCoalesceIsMergeable(QueryType))
+    {
+        gLsaAdBatchCoalesce.Merge[QueryType].dwInProgress--;
+        LsaAdBatchCoalesceMergeInLock(
+            ppSendList[0],
+            QueryType,
+            ppSendList,
+            &dwSendCount);
+        if (dwSendCount)
+        {
+            gLsaAdBatchCoalesce.Merge[QueryType].dwInProgress++;
+        }
+    }
+    else if (!dwSendCount)
+    {
+        gLsaAdBatchCoalesce.Merge[QueryType].dwInProgress--;
+    }
+
+    if (dwSendCount)
+    {
+        LEAVE_MUTEX(&gLsaAdBatchCoalesce.Mutex, bInLock);
+
+        LsaAdBatchCoalesceSendFlights(
+            pContext,
+            QueryType,
+            dwSendCount,
+            ppSendList);
+
+        ENTER_MUTEX(&gLsaAdBatchCoalesce.Mutex, bInLock);
+    }
+
+    for (dwIndex = 0; dwIndex < dwFlightCount; dwIndex++)
+    {
+        while (!ppFlights[dwIndex]->bDone)
+        {
+            pthread_cond_wait(
+                &gLsaAdBatchCoalesce.FlightDone,
+                &gLsaAdBatchCoalesce.Mutex);
+        }
+    }
+
+    LEAVE_MUTEX(&gLsaAdBatchCoalesce.Mutex, bInLock);
+
+    // Finished flights do not change any more, and the references held here
+    // keep them alive
+    for (dwIndex = 0; dwIndex < dwFlightCount; dwIndex++)
+    {
+        dwError = ppFlights[dwIndex]->dwError;
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwObjectsCount += ppFlights[dwIndex]->dwObjectsCount;
+    }
+
+    if (dwObjectsCount)
+    {
+        dwError = LwAllocateMemory(
+                        sizeof(*ppObjects) * dwObjectsCount,
+                        OUT_PPVOID(&ppObjects));
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    dwObjectsCount = 0;
+    for (dwIndex = 0; dwIndex < dwFlightCount; dwIndex++)
+    {
+        for (dwObjectIndex = 0;
+             dwObjectIndex < ppFlights[dwIndex]->dwObjectsCount;
+             dwObjectIndex++)
+        {
+            dwError = ADCacheDuplicateObject(
+                            &ppObjects[dwObjectsCount],
+                            ppFlights[dwIndex]->ppObjects[dwObjectIndex]);
+            BAIL_ON_LSA_ERROR(dwError);
+            dwObjectsCount++;
+        }
+    }
+
+    *pdwObjectsCount = dwObjectsCount;
+    *pppObjects = ppObjects;
+
+cleanup:
+    if (ppFlights)
+    {
+        ENTER_MUTEX(&gLsaAdBatchCoalesce.Mutex, bInLock);
+        for (dwIndex = 0; dwIndex < dwFlightCount; dwIndex++)
+        {
+            LsaAdBatchCoalesceReleaseFlightInLock(ppFlights[dwIndex]);
+        }
+    }
+    LEAVE_MUTEX(&gLsaAdBatchCoalesce.Mutex, bInLock);
+
+    LW_SAFE_FREE_MEMORY(ppFlights);
+    LW_SAFE_FREE_MEMORY(ppSendList);
+
+    return dwError;
+
+error:
+    if (pFlight)
+    {
+        LSA_ASSERT(!pFlight->bRegistered);
+        LsaAdBatchCoalesceReleaseFlightInLock(pFlight);
+    }
+
+    if (bInLock)
+    {
+        // Flights registered by this call were never sent. Fail them so that
+        // anything waiting for them wakes up.
+        for (dwIndex = 0; dwIndex < dwSendCount; dwIndex++)
+        {
+            if (ppSendList[dwIndex]->bRegistered)
+            {
+                LwHashRemoveKey(
+                    gLsaAdBatchCoalesce.pFlights,
+                    ppSendList[dwIndex]->pszKey);
+                ppSendList[dwIndex]->bRegistered = FALSE;
+            }
+            ppSendList[dwIndex]->dwError = dwError;
+            ppSendList[dwIndex]->bDone = TRUE;
+        }
+        pthread_cond_broadcast(&gLsaAdBatchCoalesce.FlightDone);
+    }
+
+    ADCacheSafeFreeObjectList(dwObjectsCount, &ppObjects);
+    *pdwObjectsCount = 0;
+    *pppObjects = NULL;
+
+    goto cleanup;
+}
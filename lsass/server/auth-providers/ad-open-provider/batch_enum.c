@@ -609,6 +609,8 @@ LsaAdBatchEnumObjectsInCell(
     HANDLE hDirectory = NULL;
     BOOLEAN bIsByRealObject = FALSE;
     BOOLEAN bIsSchemaMode = SchemaMode == adMode;
+    PLW_LDAP_ASYNC_SEARCH pNextPage = NULL;
+    int scope = 0;
 
     if (pCookie->bSearchFinished)
     {
@@ -628,6 +630,7 @@ LsaAdBatchEnumObjectsInCell(
     }
 
     pszAttributeList = bIsByRealObject ? szRealAttributeList : szBacklinkAttributeList;
+    scope = bIsByRealObject ? LDAP_SCOPE_SUBTREE : LDAP_SCOPE_ONELEVEL;
 
     dwError = LsaAdBatchEnumGetScopeRoot(
                     ObjectType,
@@ -647,18 +650,60 @@ LsaAdBatchEnumObjectsInCell(
 
     while (!pCookie->bSearchFinished && dwRemainingObjectsWanted)
     {
-        dwError = LsaDmLdapDirectoryOnePagedSearch(
-                        pConn,
-                        pszScopeRoot,
-                        pszQuery,
-                        pszAttributeList,
-                        dwRemainingObjectsWanted,
-                        pCookie,
-                        bIsByRealObject ? LDAP_SCOPE_SUBTREE : LDAP_SCOPE_ONELEVEL,
-                        &hDirectory,
-                        &pMessage);
+        DWORD dwEntryCount = 0;
+
+        if (pNextPage)
+        {
+            dwError = LsaDmLdapDirectoryOnePagedSearchFinish(
+                            pConn,
+                            pNextPage,
+                            pCookie,
+                            &hDirectory,
+                            &pMessage);
+            pNextPage = NULL;
+        }
+        else
+        {
+            dwError = LsaDmLdapDirectoryOnePagedSearch(
+                            pConn,
+                            pszScopeRoot,
+                            pszQuery,
+                            pszAttributeList,
+                            dwRemainingObjectsWanted,
+                            pCookie,
+                            scope,
+                            &hDirectory,
+                            &pMessage);
+        }
         BAIL_ON_LSA_ERROR(dwError);
 
+        // Ask for the next page before processing this one, so that the
+        // server works on it in the meantime. Some entries may be skipped
+        // during processing, so this page size is a lower bound on what is
+        // still wanted and the search never returns more than requested.
+        dwEntryCount = ldap_count_entries(LwLdapGetSession(hDirectory), pMessage);
+        if (!pCookie->bSearchFinished &&
+            dwEntryCount < dwRemainingObjectsWanted)
+        {
+            dwError = LsaDmLdapDirectoryOnePagedSearchStart(
+                            pConn,
+                            pszScopeRoot,
+                            pszQuery,
+                            pszAttributeList,
+                            dwRemainingObjectsWanted - dwEntryCount,
+                            pCookie,
+                            scope,
+                            &pNextPage);
+            if (dwError)
+            {
+                // The next iteration falls back to a synchronous search.
+                LSA_LOG_DEBUG("Failed to request the next page (error = %u)",
+                              dwError);
+                dwError = 0;
+                pNextPage = NULL;
+            }
+        }
+
         dwError = LsaAdBatchEnumProcessMessages(
                         pContext,
                         pszDnsDomainName,
@@ -691,6 +736,11 @@ LsaAdBatchEnumObjectsInCell(
     }
 
 cleanup:
+    if (pNextPage)
+    {
+        // Leaves the cookie at the last page that was returned.
+        LsaDmLdapDirectorySearchAbandon(pConn, pNextPage);
+    }
     LW_SAFE_FREE_STRING(pszScopeRoot);
     LW_SAFE_FREE_STRING(pszNetbiosDomainName);
     if (pMessage)
@@ -58,6 +58,26 @@ typedef DWORD LSA_PROVISIONING_MODE, *PLSA_PROVISIONING_MODE;
 #define LSA_PROVISIONING_MODE_NON_DEFAULT_CELL 2
 #define LSA_PROVISIONING_MODE_UNPROVISIONED    3
 
+// Domain entries that are being looked up at the same time.  Entries are
+// handed out in list order to the calling thread and to the work items.
+typedef struct _LSA_AD_BATCH_DOMAIN_JOBS
+{
+    pthread_mutex_t Mutex;
+    // Signaled when the last work item finishes
+    pthread_cond_t Done;
+    PAD_PROVIDER_CONTEXT pContext;
+    LSA_AD_BATCH_QUERY_TYPE QueryType;
+    BOOLEAN bResolvePseudoObjects;
+    DWORD dwEntryCount;
+    // Do not free the entries
+    PLSA_AD_BATCH_DOMAIN_ENTRY* ppEntries;
+    PDWORD pdwErrors;
+    DWORD dwNextEntry;
+    // Stop handing out entries once a lookup fails
+    BOOLEAN bFailed;
+    DWORD dwWorkItemCount;
+} LSA_AD_BATCH_DOMAIN_JOBS, *PLSA_AD_BATCH_DOMAIN_JOBS;
+
 static
 DWORD
 LsaAdBatchCreateDomainEntry(
@@ -111,6 +131,28 @@ LsaAdBatchFindObjectsForDomain(
     IN OUT PLSA_LIST_LINKS pBatchItemList
     );
 
+static
+DWORD
+LsaAdBatchFindObjectsForDomainList(
+    IN PAD_PROVIDER_CONTEXT pContext,
+    IN LSA_AD_BATCH_QUERY_TYPE QueryType,
+    IN PLSA_LIST_LINKS pDomainList,
+    IN BOOLEAN bResolvePseudoObjects
+    );
+
+static
+VOID
+LsaAdBatchRunDomainJobs(
+    IN OUT PLSA_AD_BATCH_DOMAIN_JOBS pJobs
+    );
+
+static
+VOID
+LsaAdBatchDomainJobsWorkItem(
+    IN PLW_WORK_ITEM pWorkItem,
+    IN PVOID pContext
+    );
+
 // Resolve Functions
 
 static
@@ -3630,6 +3630,191 @@ error:
     goto cleanup;
 }
 
+DWORD
+LsaDmLdapDirectoryPipelinedSearch(
+    IN PLSA_DM_LDAP_CONNECTION pConn,
+    IN PCSTR pszObjectDN,
+    IN int scope,
+    IN DWORD dwQueryCount,
+    IN PSTR* ppszQueryList,
+    IN PSTR* ppszAttributeList,
+    OUT HANDLE* phDirectory,
+    OUT LDAPMessage*** pppMessages
+    )
+{
+    DWORD dwError = 0;
+    DWORD dwSearchError = 0;
+    HANDLE hDirectory = NULL;
+    DWORD dwTry = 0;
+    DWORD dwIndex = 0;
+    DWORD dwStarted = 0;
+    PLW_LDAP_ASYNC_SEARCH* ppSearches = NULL;
+    LDAPMessage** ppMessages = NULL;
+
+    dwError = LwAllocateMemory(
+                    sizeof(*ppSearches) * dwQueryCount,
+                    OUT_PPVOID(&ppSearches));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwAllocateMemory(
+                    sizeof(*ppMessages) * dwQueryCount,
+                    OUT_PPVOID(&ppMessages));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    while (TRUE)
+    {
+        hDirectory = LsaDmpGetLdapHandle(pConn);
+
+        for (dwStarted = 0; dwStarted < dwQueryCount; dwStarted++)
+        {
+            dwError = LwLdapDirectorySearchStart(
+                            hDirectory,
+                            pszObjectDN,
+                            scope,
+                            ppszQueryList[dwStarted],
+                            ppszAttributeList,
+                            NULL,
+                            0,
+                            NULL,
+                            NULL,
+                            &ppSearches[dwStarted]);
+            if (dwError)
+            {
+                break;
+            }
+        }
+
+        // Every search that was sent has to be finished to free it
+        for (dwIndex = 0; dwIndex < dwStarted; dwIndex++)
+        {
+            dwSearchError = LwLdapDirectorySearchFinish(
+                                hDirectory,
+                                ppSearches[dwIndex],
+                                &ppMessages[dwIndex]);
+            ppSearches[dwIndex] = NULL;
+            if (!dwError)
+            {
+                dwError = dwSearchError;
+            }
+        }
+
+        if (LsaDmpLdapIsRetryError(dwError) && dwTry < 3)
+        {
+            if (dwTry > 0)
+            {
+                LSA_LOG_ERROR("Error code %u occurred during attempt %u of a ldap search. Retrying.", dwError, dwTry);
+            }
+            for (dwIndex = 0; dwIndex < dwStarted; dwIndex++)
+            {
+                if (ppMessages[dwIndex])
+                {
+                    ldap_msgfree(ppMessages[dwIndex]);
+                    ppMessages[dwIndex] = NULL;
+                }
+            }
+            dwError = LsaDmpLdapReconnect(pConn);
+            BAIL_ON_LSA_ERROR(dwError);
+            dwTry++;
+        }
+        else if(dwError)
+        {
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    *phDirectory = hDirectory;
+    *pppMessages = ppMessages;
+
+cleanup:
+    LW_SAFE_FREE_MEMORY(ppSearches);
+
+    return dwError;
+
+error:
+    if (ppMessages)
+    {
+        for (dwIndex = 0; dwIndex < dwQueryCount; dwIndex++)
+        {
+            if (ppMessages[dwIndex])
+            {
+                ldap_msgfree(ppMessages[dwIndex]);
+            }
+        }
+        LwFreeMemory(ppMessages);
+    }
+
+    *phDirectory = NULL;
+    *pppMessages = NULL;
+    goto cleanup;
+}
+
+DWORD
+LsaDmLdapDirectoryOnePagedSearchStart(
+    IN PLSA_DM_LDAP_CONNECTION pConn,
+    IN PCSTR pszObjectDN,
+    IN PCSTR pszQuery,
+    IN PSTR* ppszAttributeList,
+    IN DWORD dwPageSize,
+    IN PLW_SEARCH_COOKIE pCookie,
+    IN int scope,
+    OUT PLW_LDAP_ASYNC_SEARCH* ppSearch
+    )
+{
+    return LwLdapDirectoryOnePagedSearchStart(
+                LsaDmpGetLdapHandle(pConn),
+                pszObjectDN,
+                pszQuery,
+                ppszAttributeList,
+                dwPageSize,
+                pCookie,
+                scope,
+                ppSearch);
+}
+
+DWORD
+LsaDmLdapDirectoryOnePagedSearchFinish(
+    IN PLSA_DM_LDAP_CONNECTION pConn,
+    IN PLW_LDAP_ASYNC_SEARCH pSearch,
+    IN OUT PLW_SEARCH_COOKIE pCookie,
+    OUT HANDLE* phDirectory,
+    OUT LDAPMessage** ppMessage
+    )
+{
+    DWORD dwError = 0;
+    HANDLE hDirectory = LsaDmpGetLdapHandle(pConn);
+
+    dwError = LwLdapDirectoryOnePagedSearchFinish(
+                    hDirectory,
+                    pSearch,
+                    pCookie,
+                    ppMessage);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    *phDirectory = hDirectory;
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    *phDirectory = NULL;
+    goto cleanup;
+}
+
+VOID
+LsaDmLdapDirectorySearchAbandon(
+    IN PLSA_DM_LDAP_CONNECTION pConn,
+    IN PLW_LDAP_ASYNC_SEARCH pSearch
+    )
+{
+    LwLdapDirectorySearchAbandon(LsaDmpGetLdapHandle(pConn), pSearch);
+}
+
 DWORD
 LsaDmConnectDomain(
     IN LSA_DM_STATE_HANDLE hDmState,
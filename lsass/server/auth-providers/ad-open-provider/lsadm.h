@@ -549,6 +549,51 @@ LsaDmLdapDirectoryOnePagedSearch(
     OUT LDAPMessage** ppMessage
     );
 
+// Sends all of the queries on the connection before waiting for any of
+// the results. Returns one message per query, in query order. Free each
+// message with ldap_msgfree and the array with LwFreeMemory.
+DWORD
+LsaDmLdapDirectoryPipelinedSearch(
+    IN PLSA_DM_LDAP_CONNECTION pConn,
+    IN PCSTR pszObjectDN,
+    IN int scope,
+    IN DWORD dwQueryCount,
+    IN PSTR* ppszQueryList,
+    IN PSTR* ppszAttributeList,
+    OUT HANDLE* phDirectory,
+    OUT LDAPMessage*** pppMessages
+    );
+
+// Requests the next page of a paged search without waiting for it, so that
+// it can be fetched while the previous page is processed. The request is
+// not retried on another connection, because the cookie belongs to this one.
+DWORD
+LsaDmLdapDirectoryOnePagedSearchStart(
+    IN PLSA_DM_LDAP_CONNECTION pConn,
+    IN PCSTR pszObjectDN,
+    IN PCSTR pszQuery,
+    IN PSTR* ppszAttributeList,
+    IN DWORD dwPageSize,
+    IN PLW_SEARCH_COOKIE pCookie,
+    IN int scope,
+    OUT PLW_LDAP_ASYNC_SEARCH* ppSearch
+    );
+
+DWORD
+LsaDmLdapDirectoryOnePagedSearchFinish(
+    IN PLSA_DM_LDAP_CONNECTION pConn,
+    IN PLW_LDAP_ASYNC_SEARCH pSearch,
+    IN OUT PLW_SEARCH_COOKIE pCookie,
+    OUT HANDLE* phDirectory,
+    OUT LDAPMessage** ppMessage
+    );
+
+VOID
+LsaDmLdapDirectorySearchAbandon(
+    IN PLSA_DM_LDAP_CONNECTION pConn,
+    IN PLW_LDAP_ASYNC_SEARCH pSearch
+    );
+
 DWORD
 LsaDmConnectDomain(
     IN LSA_DM_STATE_HANDLE hDmState,
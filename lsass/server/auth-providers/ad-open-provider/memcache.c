@@ -50,9 +50,20 @@ typedef enum __MemCachePersistTag
     MEM_CACHE_OBJECT_V1,
     MEM_CACHE_MEMBERSHIP,
     MEM_CACHE_PASSWORD,
-    MEM_CACHE_OBJECT
+    MEM_CACHE_OBJECT,
+    // The rest only appear in the log
+    MEM_CACHE_REMOVE_OBJECT,
+    MEM_CACHE_REMOVE_MEMBERSHIPS,
+    MEM_CACHE_EMPTY
 } MemCachePersistTag;
 
+typedef struct _MEM_CACHE_LOG_REMOVAL
+{
+    PSTR pszSid;
+    BOOLEAN bIsParentSid;
+    BOOLEAN bRemoveCompleteness;
+} MEM_CACHE_LOG_REMOVAL, *PMEM_CACHE_LOG_REMOVAL;
+
 static LWMsgTypeSpec gLsaObjectTypeSpec[] =
 {
     LWMSG_ENUM_BEGIN(LSA_OBJECT_TYPE, 1, LWMSG_UNSIGNED),
@@ -216,12 +227,25 @@ static LWMsgTypeSpec gLsaCacheSecurityObjectSpec[] =
     LWMSG_TYPE_END
 };
 
+static LWMsgTypeSpec gMemCacheLogRemovalSpec[] =
+{
+    LWMSG_STRUCT_BEGIN(MEM_CACHE_LOG_REMOVAL),
+    LWMSG_MEMBER_PSTR(MEM_CACHE_LOG_REMOVAL, pszSid),
+    LWMSG_MEMBER_UINT8(MEM_CACHE_LOG_REMOVAL, bIsParentSid),
+    LWMSG_MEMBER_UINT8(MEM_CACHE_LOG_REMOVAL, bRemoveCompleteness),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
 static LWMsgProtocolSpec gMemCachePersistence[] = 
 {
     LWMSG_MESSAGE(MEM_CACHE_OBJECT_V1, gLsaCacheSecurityObjectV1Spec),
     LWMSG_MESSAGE(MEM_CACHE_MEMBERSHIP, gLsaGroupMembershipSpec),
     LWMSG_MESSAGE(MEM_CACHE_PASSWORD, gLsaPasswordVerifierSpec),
     LWMSG_MESSAGE(MEM_CACHE_OBJECT, gLsaCacheSecurityObjectSpec),
+    LWMSG_MESSAGE(MEM_CACHE_REMOVE_OBJECT, gMemCacheLogRemovalSpec),
+    LWMSG_MESSAGE(MEM_CACHE_REMOVE_MEMBERSHIPS, gMemCacheLogRemovalSpec),
+    LWMSG_MESSAGE(MEM_CACHE_EMPTY, NULL),
     LWMSG_PROTOCOL_END
 };
 
@@ -231,6 +255,12 @@ MemCacheCheckSizeInLock(
     IN PMEM_DB_CONNECTION pConn
     );
 
+static
+DWORD
+MemCacheEmptyCacheInLock(
+    IN PMEM_DB_CONNECTION pConn
+    );
+
 void
 MemCacheFreeGuardian(
     IN const LW_HASH_ENTRY* pEntry
@@ -258,263 +288,394 @@ MemCacheFreePasswordVerifier(
 }
 
 static
-void *
-MemCacheBackupRoutine(
-    void* pDb
+DWORD
+MemCacheCreateProtocol(
+    OUT LWMsgProtocol** ppProtocol
     )
 {
     DWORD dwError = 0;
-    PMEM_DB_CONNECTION pConn = (PMEM_DB_CONNECTION)pDb;
-    struct timespec timeout = {0, 0};
-    BOOLEAN bMutexLocked = FALSE;
-
-    ENTER_MUTEX(&pConn->backupMutex, bMutexLocked);
-
-    while (!pConn->bNeedShutdown)
-    {
-        while (!pConn->bNeedBackup && !pConn->bNeedShutdown)
-        {
-            dwError = LwMapErrnoToLwError(pthread_cond_wait(
-                            &pConn->signalBackup,
-                            &pConn->backupMutex));
-            BAIL_ON_LSA_ERROR(dwError);
-        }
-        if (!pConn->bNeedBackup)
-        {
-            break;
-        }
-        LSA_LOG_INFO("Delayed backup scheduled");
-
-        timeout.tv_sec = time(NULL) + pConn->dwBackupDelay;
-        timeout.tv_nsec = 0;
-        while (!pConn->bNeedShutdown && time(NULL) < timeout.tv_sec)
-        {
-            dwError = LwMapErrnoToLwError(pthread_cond_timedwait(
-                            &pConn->signalShutdown,
-                            &pConn->backupMutex,
-                            &timeout));
-            if (dwError == LW_ERROR_ERRNO_ETIMEDOUT)
-            {
-                dwError = 0;
-            }
-            BAIL_ON_LSA_ERROR(dwError);
-        }
+    LWMsgProtocol* pProtocol = NULL;
 
-        LSA_LOG_INFO("Performing backup");
-        dwError = MemCacheStoreFile((LSA_DB_HANDLE)pConn);
-        BAIL_ON_LSA_ERROR(dwError);
+    dwError = MAP_LWMSG_ERROR(lwmsg_protocol_new(
+                    NULL,
+                    &pProtocol));
+    BAIL_ON_LSA_ERROR(dwError);
+    dwError = MAP_LWMSG_ERROR(lwmsg_protocol_add_protocol_spec(
+                    pProtocol,
+                    gMemCachePersistence));
+    BAIL_ON_LSA_ERROR(dwError);
 
-        pConn->bNeedBackup = FALSE;
-    }
+    *ppProtocol = pProtocol;
 
 cleanup:
-    LEAVE_MUTEX(&pConn->backupMutex, bMutexLocked);
-    return (void *)(size_t)dwError;
+    return dwError;
 
 error:
-    LSA_LOG_INFO("The in-memory backup thread is exiting with error code %u\n", dwError);
+    if (pProtocol)
+    {
+        lwmsg_protocol_delete(pProtocol);
+    }
+    *ppProtocol = NULL;
     goto cleanup;
 }
 
+static
 DWORD
-MemCacheOpen(
-    IN PCSTR pszDbPath,
-    IN PLSA_AD_PROVIDER_STATE pState,
-    OUT PLSA_DB_HANDLE phDb
+MemCacheRemoveFileIfExists(
+    IN PCSTR pszPath
     )
 {
     DWORD dwError = 0;
-    PMEM_DB_CONNECTION pConn = NULL;
-
-    dwError = LwAllocateMemory(
-                    sizeof(*pConn),
-                    (PVOID*)&pConn);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    pConn->pProviderState = pState;
-
-    dwError = LwMapErrnoToLwError(pthread_rwlock_init(&pConn->lock, NULL));
-    BAIL_ON_LSA_ERROR(dwError);
-    pConn->bLockCreated = TRUE;
-
-    dwError = LwAllocateString(
-                    pszDbPath,
-                    &pConn->pszFilename);
-    BAIL_ON_LSA_ERROR(dwError);
+    BOOLEAN bExists = FALSE;
 
-    //indexes
-    dwError = LwHashCreate(
-                    100,
-                    LwHashCaselessStringCompare,
-                    LwHashCaselessStringHash,
-                    NULL,
-                    NULL,
-                    &pConn->pDNToSecurityObject);
+    dwError = LsaCheckFileExists(pszPath, &bExists);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = LwHashCreate(
-                    100,
-                    LwHashCaselessStringCompare,
-                    LwHashCaselessStringHash,
-                    LwHashFreeStringKey,
-                    NULL,
-                    &pConn->pNT4ToSecurityObject);
-    BAIL_ON_LSA_ERROR(dwError);
+    if (bExists)
+    {
+        dwError = LsaRemoveFile(pszPath);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
 
-    dwError = LwHashCreate(
-                    100,
-                    LwHashCaselessStringCompare,
-                    LwHashCaselessStringHash,
-                    NULL,
-                    NULL,
-                    &pConn->pSIDToSecurityObject);
-    BAIL_ON_LSA_ERROR(dwError);
+error:
+    return dwError;
+}
 
-    dwError = LwHashCreate(
-                    100,
-                    LwHashPVoidCompare,
-                    LwHashPVoidHash,
-                    NULL,
-                    NULL,
-                    &pConn->pUIDToSecurityObject);
-    BAIL_ON_LSA_ERROR(dwError);
+static
+VOID
+MemCacheCloseLogInLock(
+    IN PMEM_DB_CONNECTION pConn
+    )
+{
+    DWORD dwError = 0;
 
-    dwError = LwHashCreate(
-                    100,
-                    LwHashCaselessStringCompare,
-                    LwHashCaselessStringHash,
-                    NULL,
-                    NULL,
-                    &pConn->pUserAliasToSecurityObject);
-    BAIL_ON_LSA_ERROR(dwError);
+    if (pConn->pLog)
+    {
+        dwError = MAP_LWMSG_ERROR(lwmsg_archive_close(pConn->pLog));
+        if (dwError)
+        {
+            LSA_LOG_WARNING("Unable to close the in-memory cache log (error %u)", dwError);
+        }
+        lwmsg_archive_delete(pConn->pLog);
+        pConn->pLog = NULL;
+    }
+}
 
-    dwError = LwHashCreate(
-                    100,
-                    LwHashCaselessStringCompare,
-                    LwHashCaselessStringHash,
-                    NULL,
-                    NULL,
-                    &pConn->pUPNToSecurityObject);
-    BAIL_ON_LSA_ERROR(dwError);
+// Starts a new, empty "<pszFilename>.log". Any log already at that path must
+// have been folded into the snapshot or rotated by the caller.
+static
+DWORD
+MemCacheOpenLogInLock(
+    IN PMEM_DB_CONNECTION pConn
+    )
+{
+    DWORD dwError = 0;
+    PSTR pszLogPath = NULL;
+    LWMsgArchive* pLog = NULL;
 
-    dwError = LwHashCreate(
-                    100,
-                    LwHashCaselessStringCompare,
-                    LwHashCaselessStringHash,
-                    MemCacheFreePasswordVerifier,
-                    NULL,
-                    &pConn->pSIDToPasswordVerifier);
-    BAIL_ON_LSA_ERROR(dwError);
+    LSA_ASSERT(pConn->pLog == NULL);
 
-    dwError = LwHashCreate(
-                    100,
-                    LwHashPVoidCompare,
-                    LwHashPVoidHash,
-                    NULL,
-                    NULL,
-                    &pConn->pGIDToSecurityObject);
-    BAIL_ON_LSA_ERROR(dwError);
+    if (!pConn->pLogProtocol)
+    {
+        dwError = MemCacheCreateProtocol(&pConn->pLogProtocol);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
 
-    dwError = LwHashCreate(
-                    100,
-                    LwHashCaselessStringCompare,
-                    LwHashCaselessStringHash,
-                    NULL,
-                    NULL,
-                    &pConn->pGroupAliasToSecurityObject);
+    dwError = LwAllocateStringPrintf(
+                    &pszLogPath,
+                    "%s.log",
+                    pConn->pszFilename);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = LwHashCreate(
-                    100,
-                    LwHashCaselessStringCompare,
-                    LwHashCaselessStringHash,
-                    MemCacheFreeGuardian,
-                    NULL,
-                    &pConn->pParentSIDToMembershipList);
+    // Archives are not truncated when they are opened for writing
+    dwError = MemCacheRemoveFileIfExists(pszLogPath);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = LwHashCreate(
-                    100,
-                    LwHashCaselessStringCompare,
-                    LwHashCaselessStringHash,
-                    MemCacheFreeGuardian,
+    dwError = MAP_LWMSG_ERROR(lwmsg_archive_new(
                     NULL,
-                    &pConn->pChildSIDToMembershipList);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    dwError = MemCacheLoadFile((LSA_DB_HANDLE)pConn);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    dwError = LwMapErrnoToLwError(pthread_mutex_init(
-            &pConn->backupMutex,
-            NULL));
+                    pConn->pLogProtocol,
+                    &pLog));
     BAIL_ON_LSA_ERROR(dwError);
-    pConn->bBackupMutexCreated = TRUE;
-
-    pConn->dwBackupDelay = BACKUP_DELAY;
-
-    pConn->bNeedBackup = FALSE;
-    dwError = LwMapErrnoToLwError(pthread_cond_init(
-                    &pConn->signalBackup,
-                    NULL));
-    BAIL_ON_LSA_ERROR(dwError);
-    pConn->bSignalBackupCreated = TRUE;
-
-    pConn->bNeedShutdown = FALSE;
-    dwError = LwMapErrnoToLwError(pthread_cond_init(
-                    &pConn->signalShutdown,
-                    NULL));
+    dwError = MAP_LWMSG_ERROR(lwmsg_archive_set_file(
+                    pLog,
+                    pszLogPath,
+                    0600));
     BAIL_ON_LSA_ERROR(dwError);
-    pConn->bSignalShutdownCreated = TRUE;
-
-    dwError = LwMapErrnoToLwError(pthread_create(
-                    &pConn->backupThread,
-                    NULL,
-                    MemCacheBackupRoutine,
-                    pConn));
+    dwError = MAP_LWMSG_ERROR(lwmsg_archive_open(
+                    pLog,
+                    LWMSG_ARCHIVE_WRITE | LWMSG_ARCHIVE_SCHEMA));
     BAIL_ON_LSA_ERROR(dwError);
-    pConn->bBackupThreadCreated = TRUE;
 
-    *phDb = (LSA_DB_HANDLE)pConn;
+    pConn->pLog = pLog;
+    pConn->sLogRecords = 0;
+    pLog = NULL;
 
 cleanup:
+    if (pLog)
+    {
+        lwmsg_archive_delete(pLog);
+    }
+    LW_SAFE_FREE_STRING(pszLogPath);
+
     return dwError;
 
 error:
-    MemCacheSafeClose((PLSA_DB_HANDLE)&pConn);
-    *phDb = NULL;
-
     goto cleanup;
 }
 
-DWORD
-MemCacheLoadFile(
-    IN LSA_DB_HANDLE hDb
+// Appends one change to the log. The change has already been made in memory,
+// so a failed append is not returned to the caller. The log is dropped
+// instead, and the next backup writes out the whole cache.
+static
+VOID
+MemCacheLogMessage(
+    IN PMEM_DB_CONNECTION pConn,
+    IN MemCachePersistTag tag,
+    IN PVOID pData
     )
 {
-    PMEM_DB_CONNECTION pConn = (PMEM_DB_CONNECTION)hDb;
-    LWMsgArchive* pArchive = NULL;
-    LWMsgProtocol* pArchiveProtocol = NULL;
-    LWMsgStatus status = 0;
-    BOOLEAN bInLock = FALSE;
     DWORD dwError = 0;
     LWMsgMessage message = LWMSG_MESSAGE_INITIALIZER;
-    PMEM_GROUP_MEMBERSHIP pMemCacheMembership = NULL;
-    BOOLEAN bMutexLocked = FALSE;
-    PLSA_PASSWORD_VERIFIER pFromHash = NULL;
 
-    ENTER_MUTEX(&pConn->backupMutex, bMutexLocked);
-    ENTER_WRITER_RW_LOCK(&pConn->lock, bInLock);
+    if (!pConn->pLog)
+    {
+        return;
+    }
 
-    dwError = MAP_LWMSG_ERROR(lwmsg_protocol_new(
-                    NULL,
-                    &pArchiveProtocol));
+    message.tag = tag;
+    message.data = pData;
+    dwError = MAP_LWMSG_ERROR(lwmsg_archive_write_message(
+                    pConn->pLog,
+                    &message));
+    if (dwError)
+    {
+        LSA_LOG_ERROR("Unable to append to the in-memory cache log (error %u). The next backup will write out the whole cache.", dwError);
+        MemCacheCloseLogInLock(pConn);
+        return;
+    }
+
+    pConn->sLogRecords++;
+}
+
+static
+VOID
+MemCacheLogRemoval(
+    IN PMEM_DB_CONNECTION pConn,
+    IN MemCachePersistTag tag,
+    IN PCSTR pszSid,
+    IN BOOLEAN bIsParentSid,
+    IN BOOLEAN bRemoveCompleteness
+    )
+{
+    MEM_CACHE_LOG_REMOVAL removal = {0};
+
+    removal.pszSid = (PSTR)pszSid;
+    removal.bIsParentSid = bIsParentSid;
+    removal.bRemoveCompleteness = bRemoveCompleteness;
+
+    MemCacheLogMessage(pConn, tag, &removal);
+}
+
+// Writes every object, membership and password verifier in the cache to
+// "<pszFilename>.new" and moves it over pszFilename. The caller holds
+// pConn->lock, or is the only user of pConn.
+static
+DWORD
+MemCacheWriteSnapshot(
+    IN PMEM_DB_CONNECTION pConn
+    )
+{
+    DWORD dwError = 0;
+    LWMsgArchive* pArchive = NULL;
+    LWMsgProtocol* pArchiveProtocol = NULL;
+    LWMsgMessage message = LWMSG_MESSAGE_INITIALIZER;
+    MEM_CACHE_INDEX_ITERATOR iterator = {0};
+    // do not free
+    LW_HASH_ENTRY *pEntry = NULL;
+    // do not free
+    PLSA_LIST_LINKS pGuardian = NULL;
+    // do not free
+    PLSA_LIST_LINKS pMemPos = NULL;
+    // do not free
+    PLW_DLINKED_LIST pPos = NULL;
+    PSTR pszTempFile = NULL;
+
+    dwError = MemCacheCreateProtocol(&pArchiveProtocol);
     BAIL_ON_LSA_ERROR(dwError);
-    dwError = MAP_LWMSG_ERROR(lwmsg_protocol_add_protocol_spec(
+
+    dwError = LwAllocateStringPrintf(
+                    &pszTempFile,
+                    "%s.new",
+                    pConn->pszFilename);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    // A file left behind by an earlier failed backup would not be truncated
+    dwError = MemCacheRemoveFileIfExists(pszTempFile);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MAP_LWMSG_ERROR(lwmsg_archive_new(
+                    NULL,
                     pArchiveProtocol,
-                    gMemCachePersistence));
+                    &pArchive));
+    BAIL_ON_LSA_ERROR(dwError);
+    dwError = MAP_LWMSG_ERROR(lwmsg_archive_set_file(
+                    pArchive,
+                    pszTempFile,
+                    0600));
+    BAIL_ON_LSA_ERROR(dwError);
+    dwError = MAP_LWMSG_ERROR(lwmsg_archive_open(
+                    pArchive,
+                    LWMSG_ARCHIVE_WRITE | LWMSG_ARCHIVE_SCHEMA));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    // Write the oldest object first. Loading prepends every object, so this
+    // keeps the eviction order across restarts.
+    message.tag = MEM_CACHE_OBJECT;
+    pPos = pConn->pObjectsTail;
+    while (pPos)
+    {
+        message.data = pPos->pItem;
+        dwError = MAP_LWMSG_ERROR(lwmsg_archive_write_message(
+                        pArchive,
+                        &message));
+        BAIL_ON_LSA_ERROR(dwError);
+
+        pPos = pPos->pPrev;
+    }
+
+    message.tag = MEM_CACHE_MEMBERSHIP;
+    dwError = MemCacheIndexGetIterator(
+                    pConn->pParentSIDToMembershipList,
+                    &iterator);
+    BAIL_ON_LSA_ERROR(dwError);
+    while ((pEntry = MemCacheIndexNext(&iterator)) != NULL)
+    {
+        pGuardian = (PLSA_LIST_LINKS) pEntry->pValue;
+        pMemPos = pGuardian->Next;
+        while (pMemPos != pGuardian)
+        {
+            message.data = PARENT_NODE_TO_MEMBERSHIP(pMemPos);
+            dwError = MAP_LWMSG_ERROR(lwmsg_archive_write_message(
+                            pArchive,
+                            &message));
+            BAIL_ON_LSA_ERROR(dwError);
+
+            pMemPos = pMemPos->Next;
+        }
+    }
+
+    message.tag = MEM_CACHE_PASSWORD;
+    dwError = MemCacheIndexGetIterator(
+                    pConn->pSIDToPasswordVerifier,
+                    &iterator);
+    BAIL_ON_LSA_ERROR(dwError);
+    while ((pEntry = MemCacheIndexNext(&iterator)) != NULL)
+    {
+        message.data = pEntry->pValue;
+        dwError = MAP_LWMSG_ERROR(lwmsg_archive_write_message(
+                        pArchive,
+                        &message));
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    dwError = MAP_LWMSG_ERROR(lwmsg_archive_close(pArchive));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LsaMoveFile(pszTempFile, pConn->pszFilename);
+    BAIL_ON_LSA_ERROR(dwError);
+
+cleanup:
+    if (pArchive)
+    {
+        lwmsg_archive_delete(pArchive);
+    }
+
+    if (pArchiveProtocol)
+    {
+        lwmsg_protocol_delete(pArchiveProtocol);
+    }
+
+    LW_SAFE_FREE_STRING(pszTempFile);
+
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+// Writes out the whole cache. Once the snapshot is in place, nothing in the
+// logs is needed any more, so they are discarded.
+static
+DWORD
+MemCacheStoreFileInLock(
+    IN PMEM_DB_CONNECTION pConn
+    )
+{
+    DWORD dwError = 0;
+    PSTR pszLogPath = NULL;
+    PSTR pszOldLogPath = NULL;
+
+    dwError = LwAllocateStringPrintf(
+                    &pszLogPath,
+                    "%s.log",
+                    pConn->pszFilename);
+    BAIL_ON_LSA_ERROR(dwError);
+    dwError = LwAllocateStringPrintf(
+                    &pszOldLogPath,
+                    "%s.log.old",
+                    pConn->pszFilename);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheWriteSnapshot(pConn);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheRemoveFileIfExists(pszOldLogPath);
     BAIL_ON_LSA_ERROR(dwError);
 
+    MemCacheCloseLogInLock(pConn);
+    if (pConn->bLogEnabled)
+    {
+        dwError = MemCacheOpenLogInLock(pConn);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+    else
+    {
+        dwError = MemCacheRemoveFileIfExists(pszLogPath);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+    LW_SAFE_FREE_STRING(pszLogPath);
+    LW_SAFE_FREE_STRING(pszOldLogPath);
+
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+// Replays one archive into the cache. The caller holds pConn->lock, or is the
+// only user of pConn. lsassd may have stopped in the middle of appending to a
+// log, so a log is only replayed up to the first record that cannot be read.
+static
+DWORD
+MemCacheLoadArchive(
+    IN PMEM_DB_CONNECTION pConn,
+    IN LWMsgProtocol* pArchiveProtocol,
+    IN PCSTR pszPath,
+    IN BOOLEAN bIsLog
+    )
+{
+    DWORD dwError = 0;
+    LWMsgArchive* pArchive = NULL;
+    LWMsgStatus status = 0;
+    LWMsgMessage message = LWMSG_MESSAGE_INITIALIZER;
+    PMEM_GROUP_MEMBERSHIP pMemCacheMembership = NULL;
+    PLSA_PASSWORD_VERIFIER pFromHash = NULL;
+    // Do not free
+    PMEM_CACHE_LOG_REMOVAL pRemoval = NULL;
+    size_t sRecords = 0;
+
     dwError = MAP_LWMSG_ERROR(lwmsg_archive_new(
                     NULL,
                     pArchiveProtocol,
@@ -522,14 +683,25 @@ MemCacheLoadFile(
     BAIL_ON_LSA_ERROR(dwError);
     dwError = MAP_LWMSG_ERROR(lwmsg_archive_set_file(
                     pArchive,
-                    pConn->pszFilename,
+                    pszPath,
                     0));
     BAIL_ON_LSA_ERROR(dwError);
 
     status = lwmsg_archive_open(pArchive, LWMSG_ARCHIVE_READ | LWMSG_ARCHIVE_SCHEMA);
     if (status == LWMSG_STATUS_FILE_NOT_FOUND)
     {
-        LSA_LOG_INFO("The in-memory cache file does not exist yet");
+        if (!bIsLog)
+        {
+            LSA_LOG_INFO("The in-memory cache file does not exist yet");
+        }
+        status = 0;
+        goto cleanup;
+    }
+    if (status && bIsLog)
+    {
+        LSA_LOG_WARNING("Ignoring the in-memory cache log %s because its header cannot be read (error %u)",
+                pszPath,
+                MAP_LWMSG_ERROR(status));
         status = 0;
         goto cleanup;
     }
@@ -546,9 +718,20 @@ MemCacheLoadFile(
             status = 0;
             break;
         }
+        if (status && bIsLog)
+        {
+            LSA_LOG_WARNING("The in-memory cache log %s ends in an incomplete record after %zu records (error %u)",
+                    pszPath,
+                    sRecords,
+                    MAP_LWMSG_ERROR(status));
+            status = 0;
+            break;
+        }
         dwError = MAP_LWMSG_ERROR(status);
         BAIL_ON_LSA_ERROR(dwError);
 
+        sRecords++;
+
         switch(message.tag)
         {
             case MEM_CACHE_OBJECT_V1:
@@ -574,7 +757,8 @@ MemCacheLoadFile(
                 pMemCacheMembership = NULL;
                 break;
             case MEM_CACHE_PASSWORD:
-                dwError = LwHashGetValue(
+                pFromHash = NULL;
+                dwError = MemCacheIndexGetValue(
                                 pConn->pSIDToPasswordVerifier,
                                 ((PLSA_PASSWORD_VERIFIER)message.data)->pszObjectSid,
                                 (PVOID*)&pFromHash);
@@ -588,16 +772,47 @@ MemCacheLoadFile(
                 }
                 BAIL_ON_LSA_ERROR(dwError);
 
-                dwError = LwHashSetValue(
+                dwError = MemCacheIndexSetValue(
                                 pConn->pSIDToPasswordVerifier,
                                 ((PLSA_PASSWORD_VERIFIER)message.data)->pszObjectSid,
                                 message.data);
                 BAIL_ON_LSA_ERROR(dwError);
                 pConn->sCacheSize += ((PLSA_PASSWORD_VERIFIER)message.data)->
                                         version.dwObjectSize;
+
+                dwError = MemCacheProtectLoggedInUser(
+                                pConn,
+                                ((PLSA_PASSWORD_VERIFIER)message.data)->pszObjectSid);
                 // It is now owned by the global datastructures
                 message.data = NULL;
                 message.tag = -1;
+                BAIL_ON_LSA_ERROR(dwError);
+                break;
+            case MEM_CACHE_REMOVE_OBJECT:
+                pRemoval = (PMEM_CACHE_LOG_REMOVAL)message.data;
+                dwError = MemCacheRemoveObjectByHashKey(
+                                pConn,
+                                pConn->pSIDToSecurityObject,
+                                pRemoval->pszSid);
+                BAIL_ON_LSA_ERROR(dwError);
+
+                MemCacheRemoveMembershipsBySid(
+                    pConn,
+                    pRemoval->pszSid,
+                    pRemoval->bIsParentSid,
+                    pRemoval->bRemoveCompleteness);
+                break;
+            case MEM_CACHE_REMOVE_MEMBERSHIPS:
+                pRemoval = (PMEM_CACHE_LOG_REMOVAL)message.data;
+                MemCacheRemoveMembershipsBySid(
+                    pConn,
+                    pRemoval->pszSid,
+                    pRemoval->bIsParentSid,
+                    pRemoval->bRemoveCompleteness);
+                break;
+            case MEM_CACHE_EMPTY:
+                dwError = MemCacheEmptyCacheInLock(pConn);
+                BAIL_ON_LSA_ERROR(dwError);
                 break;
         }
     }
@@ -605,30 +820,580 @@ MemCacheLoadFile(
     dwError = MAP_LWMSG_ERROR(lwmsg_archive_close(pArchive));
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = MemCacheMaintainSizeCap(pConn);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    pConn->bNeedBackup = TRUE;
-    if (pConn->bSignalBackupCreated)
+    if (bIsLog && sRecords)
     {
-        dwError = LwMapErrnoToLwError(pthread_cond_signal(&pConn->signalBackup));
-        BAIL_ON_LSA_ERROR(dwError);
+        LSA_LOG_INFO("Replayed %zu records from the in-memory cache log %s",
+                sRecords,
+                pszPath);
     }
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
-    LEAVE_MUTEX(&pConn->backupMutex, bMutexLocked);
     if (pArchive)
     {
         lwmsg_archive_destroy_message(pArchive, &message);
         lwmsg_archive_delete(pArchive);
     }
 
+    return dwError;
+
+error:
+    MemCacheSafeFreeGroupMembership(&pMemCacheMembership);
+    goto cleanup;
+}
+
+// Sets up the locks and indexes of an empty cache without loading anything
+// or starting the backup thread
+static
+DWORD
+MemCacheCreateConnection(
+    IN PCSTR pszDbPath,
+    IN PLSA_AD_PROVIDER_STATE pState,
+    OUT PMEM_DB_CONNECTION* ppConn
+    )
+{
+    DWORD dwError = 0;
+    PMEM_DB_CONNECTION pConn = NULL;
+
+    dwError = LwAllocateMemory(
+                    sizeof(*pConn),
+                    (PVOID*)&pConn);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pConn->pProviderState = pState;
+
+    dwError = LwMapErrnoToLwError(pthread_mutex_init(&pConn->lock, NULL));
+    BAIL_ON_LSA_ERROR(dwError);
+    pConn->bLockCreated = TRUE;
+
+    dwError = LwMapErrnoToLwError(pthread_rwlock_init(
+                    &pConn->objectsLock,
+                    NULL));
+    BAIL_ON_LSA_ERROR(dwError);
+    pConn->bObjectsLockCreated = TRUE;
+
+    dwError = LwAllocateString(
+                    pszDbPath,
+                    &pConn->pszFilename);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    //indexes
+    dwError = MemCacheIndexCreate(
+                    100,
+                    LwHashCaselessStringCompare,
+                    LwHashCaselessStringHash,
+                    NULL,
+                    NULL,
+                    &pConn->pDNToSecurityObject);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheIndexCreate(
+                    100,
+                    LwHashCaselessStringCompare,
+                    LwHashCaselessStringHash,
+                    LwHashFreeStringKey,
+                    NULL,
+                    &pConn->pNT4ToSecurityObject);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheIndexCreate(
+                    100,
+                    LwHashCaselessStringCompare,
+                    LwHashCaselessStringHash,
+                    NULL,
+                    NULL,
+                    &pConn->pSIDToSecurityObject);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheIndexCreate(
+                    100,
+                    LwHashPVoidCompare,
+                    LwHashPVoidHash,
+                    NULL,
+                    NULL,
+                    &pConn->pUIDToSecurityObject);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheIndexCreate(
+                    100,
+                    LwHashCaselessStringCompare,
+                    LwHashCaselessStringHash,
+                    NULL,
+                    NULL,
+                    &pConn->pUserAliasToSecurityObject);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheIndexCreate(
+                    100,
+                    LwHashCaselessStringCompare,
+                    LwHashCaselessStringHash,
+                    NULL,
+                    NULL,
+                    &pConn->pUPNToSecurityObject);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheIndexCreate(
+                    100,
+                    LwHashCaselessStringCompare,
+                    LwHashCaselessStringHash,
+                    MemCacheFreePasswordVerifier,
+                    NULL,
+                    &pConn->pSIDToPasswordVerifier);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheIndexCreate(
+                    100,
+                    LwHashPVoidCompare,
+                    LwHashPVoidHash,
+                    NULL,
+                    NULL,
+                    &pConn->pGIDToSecurityObject);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheIndexCreate(
+                    100,
+                    LwHashCaselessStringCompare,
+                    LwHashCaselessStringHash,
+                    NULL,
+                    NULL,
+                    &pConn->pGroupAliasToSecurityObject);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheIndexCreate(
+                    100,
+                    LwHashCaselessStringCompare,
+                    LwHashCaselessStringHash,
+                    MemCacheFreeGuardian,
+                    NULL,
+                    &pConn->pParentSIDToMembershipList);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheIndexCreate(
+                    100,
+                    LwHashCaselessStringCompare,
+                    LwHashCaselessStringHash,
+                    MemCacheFreeGuardian,
+                    NULL,
+                    &pConn->pChildSIDToMembershipList);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    *ppConn = pConn;
+
+cleanup:
+    return dwError;
+
+error:
+    MemCacheSafeClose((PLSA_DB_HANDLE)&pConn);
+    *ppConn = NULL;
+
+    goto cleanup;
+}
+
+// Folds the log into the snapshot. Only the rotation of "<pszFilename>.log"
+// to "<pszFilename>.log.old" happens under pConn->lock. The new snapshot is
+// built by replaying the previous snapshot and the rotated log into a scratch
+// cache, so lookups and stores carry on while it is written, at the cost of
+// holding a second copy of the cache in memory for that time.
+static
+DWORD
+MemCacheCompactLog(
+    IN PMEM_DB_CONNECTION pConn,
+    IN BOOLEAN bForce
+    )
+{
+    DWORD dwError = 0;
+    BOOLEAN bInLock = FALSE;
+    PSTR pszLogPath = NULL;
+    PSTR pszOldLogPath = NULL;
+    BOOLEAN bOldLogExists = FALSE;
+    size_t sSizeCap = 0;
+    PMEM_DB_CONNECTION pScratch = NULL;
+    LWMsgProtocol* pArchiveProtocol = NULL;
+
+    dwError = LwAllocateStringPrintf(
+                    &pszLogPath,
+                    "%s.log",
+                    pConn->pszFilename);
+    BAIL_ON_LSA_ERROR(dwError);
+    dwError = LwAllocateStringPrintf(
+                    &pszOldLogPath,
+                    "%s.log.old",
+                    pConn->pszFilename);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    ENTER_MUTEX(&pConn->lock, bInLock);
+
+    if (!pConn->pLog)
+    {
+        // Appending failed at some point, so the logs are incomplete
+        LSA_LOG_INFO("Writing out the whole in-memory cache");
+        dwError = MemCacheStoreFileInLock(pConn);
+        BAIL_ON_LSA_ERROR(dwError);
+        goto cleanup;
+    }
+
+    // A log that was rotated earlier but not folded in yet is folded in
+    // first. Otherwise the current log is rotated once it is big enough.
+    dwError = LsaCheckFileExists(pszOldLogPath, &bOldLogExists);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (!bOldLogExists)
+    {
+        if (!bForce && pConn->sLogRecords < MEM_CACHE_LOG_COMPACT_RECORDS)
+        {
+            goto cleanup;
+        }
+
+        MemCacheCloseLogInLock(pConn);
+
+        dwError = LsaMoveFile(pszLogPath, pszOldLogPath);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = MemCacheOpenLogInLock(pConn);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    sSizeCap = pConn->sSizeCap;
+
+    LEAVE_MUTEX(&pConn->lock, bInLock);
+
+    LSA_LOG_INFO("Folding the in-memory cache log into the snapshot");
+
+    dwError = MemCacheCreateConnection(
+                    pConn->pszFilename,
+                    pConn->pProviderState,
+                    &pScratch);
+    BAIL_ON_LSA_ERROR(dwError);
+    pScratch->sSizeCap = sSizeCap;
+
+    dwError = MemCacheCreateProtocol(&pArchiveProtocol);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheLoadArchive(
+                    pScratch,
+                    pArchiveProtocol,
+                    pConn->pszFilename,
+                    FALSE);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheLoadArchive(
+                    pScratch,
+                    pArchiveProtocol,
+                    pszOldLogPath,
+                    TRUE);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    // Evictions are not logged, so objects the live cache has evicted since
+    // the last snapshot are evicted again here
+    dwError = MemCacheMaintainSizeCap(pScratch);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheWriteSnapshot(pScratch);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LsaRemoveFile(pszOldLogPath);
+    BAIL_ON_LSA_ERROR(dwError);
+
+cleanup:
+    LEAVE_MUTEX(&pConn->lock, bInLock);
+    MemCacheSafeClose((PLSA_DB_HANDLE)&pScratch);
+
+    if (pArchiveProtocol)
+    {
+        lwmsg_protocol_delete(pArchiveProtocol);
+    }
+
+    LW_SAFE_FREE_STRING(pszLogPath);
+    LW_SAFE_FREE_STRING(pszOldLogPath);
+
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+static
+void *
+MemCacheBackupRoutine(
+    void* pDb
+    )
+{
+    DWORD dwError = 0;
+    PMEM_DB_CONNECTION pConn = (PMEM_DB_CONNECTION)pDb;
+    struct timespec timeout = {0, 0};
+    BOOLEAN bMutexLocked = FALSE;
+    BOOLEAN bShutdown = FALSE;
+
+    ENTER_MUTEX(&pConn->backupMutex, bMutexLocked);
+
+    while (!pConn->bNeedShutdown || pConn->bNeedBackup)
+    {
+        while (!pConn->bNeedBackup && !pConn->bNeedShutdown)
+        {
+            dwError = LwMapErrnoToLwError(pthread_cond_wait(
+                            &pConn->signalBackup,
+                            &pConn->backupMutex));
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+        if (!pConn->bNeedBackup)
+        {
+            break;
+        }
+        LSA_LOG_INFO("Delayed backup scheduled");
+
+        timeout.tv_sec = time(NULL) + pConn->dwBackupDelay;
+        timeout.tv_nsec = 0;
+        while (!pConn->bNeedShutdown && time(NULL) < timeout.tv_sec)
+        {
+            dwError = LwMapErrnoToLwError(pthread_cond_timedwait(
+                            &pConn->signalShutdown,
+                            &pConn->backupMutex,
+                            &timeout));
+            if (dwError == LW_ERROR_ERRNO_ETIMEDOUT)
+            {
+                dwError = 0;
+            }
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+
+        LSA_LOG_INFO("Performing backup");
+        pConn->bNeedBackup = FALSE;
+        bShutdown = pConn->bNeedShutdown;
+
+        // Stores take the backup mutex to ask for a backup, so it is not held
+        // while the cache is written out. Anything stored meanwhile asks for
+        // another backup.
+        LEAVE_MUTEX(&pConn->backupMutex, bMutexLocked);
+        if (pConn->bLogEnabled)
+        {
+            dwError = MemCacheCompactLog(pConn, bShutdown);
+        }
+        else
+        {
+            dwError = MemCacheStoreFile((LSA_DB_HANDLE)pConn);
+        }
+        ENTER_MUTEX(&pConn->backupMutex, bMutexLocked);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+    LEAVE_MUTEX(&pConn->backupMutex, bMutexLocked);
+    return (void *)(size_t)dwError;
+
+error:
+    LSA_LOG_INFO("The in-memory backup thread is exiting with error code %u\n", dwError);
+    goto cleanup;
+}
+
+// Called once the snapshot and any logs have been loaded, before the backup
+// thread starts. A log left over from the last run is rotated so that the
+// backup thread folds it in. If a rotated log is also still there, the loaded
+// cache is written out in full instead.
+static
+DWORD
+MemCacheStartLog(
+    IN PMEM_DB_CONNECTION pConn
+    )
+{
+    DWORD dwError = 0;
+    BOOLEAN bInLock = FALSE;
+    PSTR pszLogPath = NULL;
+    PSTR pszOldLogPath = NULL;
+    BOOLEAN bLogExists = FALSE;
+    BOOLEAN bOldLogExists = FALSE;
+
+    dwError = LwAllocateStringPrintf(
+                    &pszLogPath,
+                    "%s.log",
+                    pConn->pszFilename);
+    BAIL_ON_LSA_ERROR(dwError);
+    dwError = LwAllocateStringPrintf(
+                    &pszOldLogPath,
+                    "%s.log.old",
+                    pConn->pszFilename);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    ENTER_MUTEX(&pConn->lock, bInLock);
+
+    dwError = LsaCheckFileExists(pszLogPath, &bLogExists);
+    BAIL_ON_LSA_ERROR(dwError);
+    dwError = LsaCheckFileExists(pszOldLogPath, &bOldLogExists);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (bLogExists && bOldLogExists)
+    {
+        dwError = MemCacheStoreFileInLock(pConn);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+    else
+    {
+        if (bLogExists)
+        {
+            dwError = LsaMoveFile(pszLogPath, pszOldLogPath);
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+
+        dwError = MemCacheOpenLogInLock(pConn);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+    LEAVE_MUTEX(&pConn->lock, bInLock);
+    LW_SAFE_FREE_STRING(pszLogPath);
+    LW_SAFE_FREE_STRING(pszOldLogPath);
+
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+DWORD
+MemCacheOpen(
+    IN PCSTR pszDbPath,
+    IN PLSA_AD_PROVIDER_STATE pState,
+    OUT PLSA_DB_HANDLE phDb
+    )
+{
+    DWORD dwError = 0;
+    PMEM_DB_CONNECTION pConn = NULL;
+
+    dwError = MemCacheCreateConnection(
+                    pszDbPath,
+                    pState,
+                    &pConn);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (pState)
+    {
+        pConn->bLogEnabled = AD_GetMemoryCacheLogEnabled(pState);
+    }
+
+    dwError = MemCacheLoadFile((LSA_DB_HANDLE)pConn);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (pConn->bLogEnabled)
+    {
+        dwError = MemCacheStartLog(pConn);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    dwError = LwMapErrnoToLwError(pthread_mutex_init(
+            &pConn->backupMutex,
+            NULL));
+    BAIL_ON_LSA_ERROR(dwError);
+    pConn->bBackupMutexCreated = TRUE;
+
+    pConn->dwBackupDelay = BACKUP_DELAY;
+
+    pConn->bNeedBackup = FALSE;
+    dwError = LwMapErrnoToLwError(pthread_cond_init(
+                    &pConn->signalBackup,
+                    NULL));
+    BAIL_ON_LSA_ERROR(dwError);
+    pConn->bSignalBackupCreated = TRUE;
+
+    pConn->bNeedShutdown = FALSE;
+    dwError = LwMapErrnoToLwError(pthread_cond_init(
+                    &pConn->signalShutdown,
+                    NULL));
+    BAIL_ON_LSA_ERROR(dwError);
+    pConn->bSignalShutdownCreated = TRUE;
+
+    dwError = LwMapErrnoToLwError(pthread_create(
+                    &pConn->backupThread,
+                    NULL,
+                    MemCacheBackupRoutine,
+                    pConn));
+    BAIL_ON_LSA_ERROR(dwError);
+    pConn->bBackupThreadCreated = TRUE;
+
+    *phDb = (LSA_DB_HANDLE)pConn;
+
+cleanup:
+    return dwError;
+
+error:
+    MemCacheSafeClose((PLSA_DB_HANDLE)&pConn);
+    *phDb = NULL;
+
+    goto cleanup;
+}
+
+DWORD
+MemCacheLoadFile(
+    IN LSA_DB_HANDLE hDb
+    )
+{
+    PMEM_DB_CONNECTION pConn = (PMEM_DB_CONNECTION)hDb;
+    LWMsgProtocol* pArchiveProtocol = NULL;
+    BOOLEAN bInLock = FALSE;
+    DWORD dwError = 0;
+    BOOLEAN bMutexLocked = FALSE;
+    PSTR pszLogPath = NULL;
+    PSTR pszOldLogPath = NULL;
+
+    dwError = LwAllocateStringPrintf(
+                    &pszLogPath,
+                    "%s.log",
+                    pConn->pszFilename);
+    BAIL_ON_LSA_ERROR(dwError);
+    dwError = LwAllocateStringPrintf(
+                    &pszOldLogPath,
+                    "%s.log.old",
+                    pConn->pszFilename);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    ENTER_MUTEX(&pConn->backupMutex, bMutexLocked);
+    ENTER_MUTEX(&pConn->lock, bInLock);
+
+    dwError = MemCacheCreateProtocol(&pArchiveProtocol);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheLoadArchive(
+                    pConn,
+                    pArchiveProtocol,
+                    pConn->pszFilename,
+                    FALSE);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    // Logs are replayed even when the log is disabled, since they may hold
+    // changes from a run that had it enabled. The next backup removes them.
+    dwError = MemCacheLoadArchive(
+                    pConn,
+                    pArchiveProtocol,
+                    pszOldLogPath,
+                    TRUE);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheLoadArchive(
+                    pConn,
+                    pArchiveProtocol,
+                    pszLogPath,
+                    TRUE);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheMaintainSizeCap(pConn);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pConn->bNeedBackup = TRUE;
+    if (pConn->bSignalBackupCreated)
+    {
+        dwError = LwMapErrnoToLwError(pthread_cond_signal(&pConn->signalBackup));
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+    LEAVE_MUTEX(&pConn->lock, bInLock);
+    LEAVE_MUTEX(&pConn->backupMutex, bMutexLocked);
+
     if (pArchiveProtocol)
     {
         lwmsg_protocol_delete(pArchiveProtocol);
     }
 
+    LW_SAFE_FREE_STRING(pszLogPath);
+    LW_SAFE_FREE_STRING(pszOldLogPath);
+
     return dwError;
 
 error:
@@ -642,119 +1407,15 @@ MemCacheStoreFile(
 {
     PMEM_DB_CONNECTION pConn = (PMEM_DB_CONNECTION)hDb;
     DWORD dwError = 0;
-    LWMsgArchive* pArchive = NULL;
-    LWMsgProtocol* pArchiveProtocol = NULL;
     BOOLEAN bInLock = FALSE;
-    LWMsgMessage message = LWMSG_MESSAGE_INITIALIZER;
-    LW_HASH_ITERATOR iterator = {0};
-    // do not free
-    LW_HASH_ENTRY *pEntry = NULL;
-    // do not free
-    PLSA_LIST_LINKS pGuardian = NULL;
-    // do not free
-    PLSA_LIST_LINKS pMemPos = NULL;
-    // do not free
-    PLW_DLINKED_LIST pPos = NULL;
-    PSTR pszTempFile = NULL;
-
-    ENTER_READER_RW_LOCK(&pConn->lock, bInLock);
-
-    dwError = MAP_LWMSG_ERROR(lwmsg_protocol_new(
-                    NULL,
-                    &pArchiveProtocol));
-    BAIL_ON_LSA_ERROR(dwError);
-    dwError = MAP_LWMSG_ERROR(lwmsg_protocol_add_protocol_spec(
-                    pArchiveProtocol,
-                    gMemCachePersistence));
-    BAIL_ON_LSA_ERROR(dwError);
-
-    dwError = LwAllocateStringPrintf(
-                    &pszTempFile,
-                    "%s.new",
-                    pConn->pszFilename);
-    BAIL_ON_LSA_ERROR(dwError);
-    dwError = MAP_LWMSG_ERROR(lwmsg_archive_new(
-                    NULL,
-                    pArchiveProtocol,
-                    &pArchive));
-    BAIL_ON_LSA_ERROR(dwError);
-    dwError = MAP_LWMSG_ERROR(lwmsg_archive_set_file(
-                    pArchive,
-                    pszTempFile,
-                    0600));
-    BAIL_ON_LSA_ERROR(dwError);
-    dwError = MAP_LWMSG_ERROR(lwmsg_archive_open(
-                    pArchive,
-                    LWMSG_ARCHIVE_WRITE | LWMSG_ARCHIVE_SCHEMA));
-    BAIL_ON_LSA_ERROR(dwError);
-
-    message.tag = MEM_CACHE_OBJECT;
-    pPos = pConn->pObjects;
-    while (pPos)
-    {
-        message.data = pPos->pItem;
-        dwError = MAP_LWMSG_ERROR(lwmsg_archive_write_message(
-                        pArchive,
-                        &message));
-        BAIL_ON_LSA_ERROR(dwError);
-
-        pPos = pPos->pNext;
-    }
-
-    message.tag = MEM_CACHE_MEMBERSHIP;
-    dwError = LwHashGetIterator(
-                    pConn->pParentSIDToMembershipList,
-                    &iterator);
-    BAIL_ON_LSA_ERROR(dwError);
-    while ((pEntry = LwHashNext(&iterator)) != NULL)
-    {
-        pGuardian = (PLSA_LIST_LINKS) pEntry->pValue;
-        pMemPos = pGuardian->Next;
-        while (pMemPos != pGuardian)
-        {
-            message.data = PARENT_NODE_TO_MEMBERSHIP(pMemPos);
-            dwError = MAP_LWMSG_ERROR(lwmsg_archive_write_message(
-                            pArchive,
-                            &message));
-            BAIL_ON_LSA_ERROR(dwError);
-
-            pMemPos = pMemPos->Next;
-        }
-    }
-
-    message.tag = MEM_CACHE_PASSWORD;
-    dwError = LwHashGetIterator(
-                    pConn->pSIDToPasswordVerifier,
-                    &iterator);
-    BAIL_ON_LSA_ERROR(dwError);
-    while ((pEntry = LwHashNext(&iterator)) != NULL)
-    {
-        message.data = pEntry->pValue;
-        dwError = MAP_LWMSG_ERROR(lwmsg_archive_write_message(
-                        pArchive,
-                        &message));
-        BAIL_ON_LSA_ERROR(dwError);
-    }
 
-    dwError = MAP_LWMSG_ERROR(lwmsg_archive_close(pArchive));
-    BAIL_ON_LSA_ERROR(dwError);
+    ENTER_MUTEX(&pConn->lock, bInLock);
 
-    dwError = LsaMoveFile(pszTempFile, pConn->pszFilename);
+    dwError = MemCacheStoreFileInLock(pConn);
     BAIL_ON_LSA_ERROR(dwError);
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
-    if (pArchive)
-    {
-        lwmsg_archive_delete(pArchive);
-    }
-
-    if (pArchiveProtocol)
-    {
-        lwmsg_protocol_delete(pArchiveProtocol);
-    }
-
-    LW_SAFE_FREE_STRING(pszTempFile);
+    LEAVE_MUTEX(&pConn->lock, bInLock);
 
     return dwError;
 
@@ -781,18 +1442,27 @@ MemCacheRemoveMembership(
 {
     DWORD dwError = 0;
     BOOLEAN bLastItem = FALSE;
+    // Do not free
+    PMEM_CACHE_SHARD pShard = NULL;
+    BOOLEAN bInLock = FALSE;
 
     pConn->sCacheSize -= pMembership->membership.version.dwObjectSize;
+    pConn->sMembershipCount--;
 
     // See if only this membership plus the guardian is in the list
     bLastItem = (pMembership->parentListNode.Next->Next ==
             &pMembership->parentListNode);
+    pShard = MemCacheIndexGetShard(
+                    pConn->pParentSIDToMembershipList,
+                    pMembership->membership.pszParentSid);
+    ENTER_WRITER_RW_LOCK(&pShard->lock, bInLock);
     LsaListRemove(&pMembership->parentListNode);
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
 
     if (bLastItem)
     {
         // Only the guardian is left, so remove the hash entry
-        dwError = LwHashRemoveKey(
+        dwError = MemCacheIndexRemoveKey(
                         pConn->pParentSIDToMembershipList,
                         pMembership->membership.pszParentSid);
         BAIL_ON_LSA_ERROR(dwError);
@@ -801,12 +1471,17 @@ MemCacheRemoveMembership(
     // See if only this membership plus the guardian is in the list
     bLastItem = (pMembership->childListNode.Next->Next ==
             &pMembership->childListNode);
+    pShard = MemCacheIndexGetShard(
+                    pConn->pChildSIDToMembershipList,
+                    pMembership->membership.pszChildSid);
+    ENTER_WRITER_RW_LOCK(&pShard->lock, bInLock);
     LsaListRemove(&pMembership->childListNode);
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
 
     if (bLastItem)
     {
         // Only the guardian is left, so remove the hash entry
-        dwError = LwHashRemoveKey(
+        dwError = MemCacheIndexRemoveKey(
                         pConn->pChildSIDToMembershipList,
                         pMembership->membership.pszChildSid);
         BAIL_ON_LSA_ERROR(dwError);
@@ -852,29 +1527,43 @@ MemCacheSafeClose(
             LSA_ASSERT(pError == NULL);
         }
 
+        // Emptying the cache must not reach the log
+        MemCacheCloseLogInLock(pConn);
+        if (pConn->pLogProtocol)
+        {
+            lwmsg_protocol_delete(pConn->pLogProtocol);
+            pConn->pLogProtocol = NULL;
+        }
+
         dwError = MemCacheEmptyCache(*phDb);
         LSA_ASSERT(dwError == 0);
 
-        LwHashSafeFree(&pConn->pDNToSecurityObject);
-        LwHashSafeFree(&pConn->pNT4ToSecurityObject);
-        LwHashSafeFree(&pConn->pSIDToSecurityObject);
+        MemCacheIndexSafeFree(&pConn->pDNToSecurityObject);
+        MemCacheIndexSafeFree(&pConn->pNT4ToSecurityObject);
+        MemCacheIndexSafeFree(&pConn->pSIDToSecurityObject);
 
-        LwHashSafeFree(&pConn->pUIDToSecurityObject);
-        LwHashSafeFree(&pConn->pUserAliasToSecurityObject);
-        LwHashSafeFree(&pConn->pUPNToSecurityObject);
+        MemCacheIndexSafeFree(&pConn->pUIDToSecurityObject);
+        MemCacheIndexSafeFree(&pConn->pUserAliasToSecurityObject);
+        MemCacheIndexSafeFree(&pConn->pUPNToSecurityObject);
 
-        LwHashSafeFree(&pConn->pSIDToPasswordVerifier);
+        MemCacheIndexSafeFree(&pConn->pSIDToPasswordVerifier);
 
-        LwHashSafeFree(&pConn->pGIDToSecurityObject);
-        LwHashSafeFree(&pConn->pGroupAliasToSecurityObject);
+        MemCacheIndexSafeFree(&pConn->pGIDToSecurityObject);
+        MemCacheIndexSafeFree(&pConn->pGroupAliasToSecurityObject);
         LW_SAFE_FREE_STRING(pConn->pszFilename);
 
-        LwHashSafeFree(&pConn->pParentSIDToMembershipList);
-        LwHashSafeFree(&pConn->pChildSIDToMembershipList);
+        MemCacheIndexSafeFree(&pConn->pParentSIDToMembershipList);
+        MemCacheIndexSafeFree(&pConn->pChildSIDToMembershipList);
 
         if (pConn->bLockCreated)
         {
-            dwError = LwMapErrnoToLwError(pthread_rwlock_destroy(&pConn->lock));
+            dwError = LwMapErrnoToLwError(pthread_mutex_destroy(&pConn->lock));
+            LSA_ASSERT(dwError == 0);
+        }
+        if (pConn->bObjectsLockCreated)
+        {
+            dwError = LwMapErrnoToLwError(pthread_rwlock_destroy(
+                            &pConn->objectsLock));
             LSA_ASSERT(dwError == 0);
         }
         if (pConn->bBackupMutexCreated)
@@ -910,15 +1599,15 @@ MemCacheFindUserByName(
     BOOLEAN bInLock = FALSE;
     PLSA_SECURITY_OBJECT pObject = NULL;
     // Do not free
-    PLW_HASH_TABLE pIndex = NULL;
+    PMEM_CACHE_INDEX pIndex = NULL;
+    // Do not free
+    PMEM_CACHE_SHARD pShard = NULL;
     PSTR pszKey = NULL;
     PSTR pszDnsDomain = NULL;
     PSTR pszShortDomain = NULL;
     // Do not free
     PLW_DLINKED_LIST pListEntry = NULL;
 
-    ENTER_READER_RW_LOCK(&pConn->lock, bInLock);
-
     switch (pUserNameInfo->nameType)
     {
         case NameType_UPN:
@@ -985,8 +1674,11 @@ MemCacheFindUserByName(
             BAIL_ON_LSA_ERROR(dwError);
     }
 
+    pShard = MemCacheIndexGetShard(pIndex, pszKey);
+    ENTER_READER_RW_LOCK(&pShard->lock, bInLock);
+
     dwError = LwHashGetValue(
-                    pIndex,
+                    pShard->pTable,
                     pszKey,
                     (PVOID*)&pListEntry);
     if (dwError == ERROR_NOT_FOUND)
@@ -1009,7 +1701,7 @@ MemCacheFindUserByName(
     *ppObject = pObject;
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
     LW_SAFE_FREE_STRING(pszKey);
     LW_SAFE_FREE_STRING(pszDnsDomain);
     LW_SAFE_FREE_STRING(pszShortDomain);
@@ -1036,16 +1728,19 @@ MemCacheFindUserById(
     BOOLEAN bInLock = FALSE;
     PLSA_SECURITY_OBJECT pObject = NULL;
     // Do not free
-    PLW_HASH_TABLE pIndex = NULL;
+    PMEM_CACHE_INDEX pIndex = NULL;
+    // Do not free
+    PMEM_CACHE_SHARD pShard = NULL;
     // Do not free
     PLW_DLINKED_LIST pListEntry = NULL;
 
-    ENTER_READER_RW_LOCK(&pConn->lock, bInLock);
-
     pIndex = pConn->pUIDToSecurityObject;
 
+    pShard = MemCacheIndexGetShard(pIndex, (PVOID)(size_t)uid);
+    ENTER_READER_RW_LOCK(&pShard->lock, bInLock);
+
     dwError = LwHashGetValue(
-                    pIndex,
+                    pShard->pTable,
                     (PVOID)(size_t)uid,
                     (PVOID*)&pListEntry);
     if (dwError == ERROR_NOT_FOUND)
@@ -1068,7 +1763,7 @@ MemCacheFindUserById(
     *ppObject = pObject;
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
 
     return dwError;
 
@@ -1091,13 +1786,13 @@ MemCacheFindGroupByName(
     BOOLEAN bInLock = FALSE;
     PLSA_SECURITY_OBJECT pObject = NULL;
     // Do not free
-    PLW_HASH_TABLE pIndex = NULL;
+    PMEM_CACHE_INDEX pIndex = NULL;
+    // Do not free
+    PMEM_CACHE_SHARD pShard = NULL;
     PSTR pszKey = NULL;
     // Do not free
     PLW_DLINKED_LIST pListEntry = NULL;
 
-    ENTER_READER_RW_LOCK(&pConn->lock, bInLock);
-
     switch (pGroupNameInfo->nameType)
     {
        case NameType_NT4:
@@ -1129,8 +1824,11 @@ MemCacheFindGroupByName(
             BAIL_ON_LSA_ERROR(dwError);
     }
 
+    pShard = MemCacheIndexGetShard(pIndex, pszKey);
+    ENTER_READER_RW_LOCK(&pShard->lock, bInLock);
+
     dwError = LwHashGetValue(
-                    pIndex,
+                    pShard->pTable,
                     pszKey,
                     (PVOID *)&pListEntry);
     if (dwError == ERROR_NOT_FOUND)
@@ -1153,7 +1851,7 @@ MemCacheFindGroupByName(
     *ppObject = pObject;
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
     LW_SAFE_FREE_STRING(pszKey);
 
     return dwError;
@@ -1177,16 +1875,19 @@ MemCacheFindGroupById(
     BOOLEAN bInLock = FALSE;
     PLSA_SECURITY_OBJECT pObject = NULL;
     // Do not free
-    PLW_HASH_TABLE pIndex = NULL;
+    PMEM_CACHE_INDEX pIndex = NULL;
+    // Do not free
+    PMEM_CACHE_SHARD pShard = NULL;
     // Do not free
     PLW_DLINKED_LIST pListEntry = NULL;
 
-    ENTER_READER_RW_LOCK(&pConn->lock, bInLock);
-
     pIndex = pConn->pGIDToSecurityObject;
 
+    pShard = MemCacheIndexGetShard(pIndex, (PVOID)(size_t)gid);
+    ENTER_READER_RW_LOCK(&pShard->lock, bInLock);
+
     dwError = LwHashGetValue(
-                    pIndex,
+                    pShard->pTable,
                     (PVOID)(size_t)gid,
                     (PVOID *)&pListEntry);
     if (dwError == ERROR_NOT_FOUND)
@@ -1209,7 +1910,7 @@ MemCacheFindGroupById(
     *ppObject = pObject;
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
 
     return dwError;
 
@@ -1231,7 +1932,7 @@ MemCacheRemoveUserBySid(
     BOOLEAN bMutexLocked = FALSE;
 
     ENTER_MUTEX(&pConn->backupMutex, bMutexLocked);
-    ENTER_WRITER_RW_LOCK(&pConn->lock, bInLock);
+    ENTER_MUTEX(&pConn->lock, bInLock);
 
     dwError = MemCacheRemoveObjectByHashKey(
                     pConn,
@@ -1241,12 +1942,14 @@ MemCacheRemoveUserBySid(
 
     MemCacheRemoveMembershipsBySid(pConn, pszSid, FALSE, TRUE);
 
+    MemCacheLogRemoval(pConn, MEM_CACHE_REMOVE_OBJECT, pszSid, FALSE, TRUE);
+
     pConn->bNeedBackup = TRUE;
     dwError = LwMapErrnoToLwError(pthread_cond_signal(&pConn->signalBackup));
     BAIL_ON_LSA_ERROR(dwError);
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_MUTEX(&pConn->lock, bInLock);
     LEAVE_MUTEX(&pConn->backupMutex, bMutexLocked);
     return dwError;
 
@@ -1266,7 +1969,7 @@ MemCacheRemoveGroupBySid(
     BOOLEAN bMutexLocked = FALSE;
 
     ENTER_MUTEX(&pConn->backupMutex, bMutexLocked);
-    ENTER_WRITER_RW_LOCK(&pConn->lock, bInLock);
+    ENTER_MUTEX(&pConn->lock, bInLock);
 
     dwError = MemCacheRemoveObjectByHashKey(
                     pConn,
@@ -1276,12 +1979,14 @@ MemCacheRemoveGroupBySid(
 
     MemCacheRemoveMembershipsBySid(pConn, pszSid, TRUE, TRUE);
 
+    MemCacheLogRemoval(pConn, MEM_CACHE_REMOVE_OBJECT, pszSid, TRUE, TRUE);
+
     pConn->bNeedBackup = TRUE;
     dwError = LwMapErrnoToLwError(pthread_cond_signal(&pConn->signalBackup));
     BAIL_ON_LSA_ERROR(dwError);
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_MUTEX(&pConn->lock, bInLock);
     LEAVE_MUTEX(&pConn->backupMutex, bMutexLocked);
     return dwError;
 
@@ -1297,9 +2002,6 @@ MemCacheEmptyCache(
     BOOLEAN bInLock = FALSE;
     PMEM_DB_CONNECTION pConn = (PMEM_DB_CONNECTION)hDb;
     DWORD dwError = 0;
-    LW_HASH_ITERATOR iterator = {0};
-    // Do not free
-    LW_HASH_ENTRY *pEntry = NULL;
     BOOLEAN bMutexLocked = FALSE;
 
     if (pConn->bBackupMutexCreated)
@@ -1309,59 +2011,94 @@ MemCacheEmptyCache(
 
     if (pConn->bLockCreated)
     {
-        ENTER_WRITER_RW_LOCK(&pConn->lock, bInLock);
+        ENTER_MUTEX(&pConn->lock, bInLock);
+    }
+
+    dwError = MemCacheEmptyCacheInLock(pConn);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    MemCacheLogMessage(pConn, MEM_CACHE_EMPTY, NULL);
+
+    if (bMutexLocked)
+    {
+        pConn->bNeedBackup = TRUE;
+        dwError = LwMapErrnoToLwError(pthread_cond_signal(&pConn->signalBackup));
+        BAIL_ON_LSA_ERROR(dwError);
     }
 
+cleanup:
+    LEAVE_MUTEX(&pConn->lock, bInLock);
+    LEAVE_MUTEX(&pConn->backupMutex, bMutexLocked);
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+static
+DWORD
+MemCacheEmptyCacheInLock(
+    IN PMEM_DB_CONNECTION pConn
+    )
+{
+    DWORD dwError = 0;
+    MEM_CACHE_INDEX_ITERATOR iterator = {0};
+    // Do not free
+    LW_HASH_ENTRY *pEntry = NULL;
+    DWORD dwIndex = 0;
+    BOOLEAN bInObjectsLock = FALSE;
+    PLW_DLINKED_LIST pObjects = NULL;
+
     MemCacheCheckSizeInLock(pConn);
 
     if (pConn->pDNToSecurityObject)
     {
-        LwHashRemoveAll(pConn->pDNToSecurityObject);
+        MemCacheIndexRemoveAll(pConn->pDNToSecurityObject);
     }
     if (pConn->pNT4ToSecurityObject)
     {
-        LwHashRemoveAll(pConn->pNT4ToSecurityObject);
+        MemCacheIndexRemoveAll(pConn->pNT4ToSecurityObject);
     }
     if (pConn->pSIDToSecurityObject)
     {
-        LwHashRemoveAll(pConn->pSIDToSecurityObject);
+        MemCacheIndexRemoveAll(pConn->pSIDToSecurityObject);
     }
 
     if (pConn->pUIDToSecurityObject)
     {
-        LwHashRemoveAll(pConn->pUIDToSecurityObject);
+        MemCacheIndexRemoveAll(pConn->pUIDToSecurityObject);
     }
     if (pConn->pUserAliasToSecurityObject)
     {
-        LwHashRemoveAll(pConn->pUserAliasToSecurityObject);
+        MemCacheIndexRemoveAll(pConn->pUserAliasToSecurityObject);
     }
     if (pConn->pUPNToSecurityObject)
     {
-        LwHashRemoveAll(pConn->pUPNToSecurityObject);
+        MemCacheIndexRemoveAll(pConn->pUPNToSecurityObject);
     }
 
     if (pConn->pSIDToPasswordVerifier)
     {
-        LwHashRemoveAll(pConn->pSIDToPasswordVerifier);
+        MemCacheIndexRemoveAll(pConn->pSIDToPasswordVerifier);
     }
 
     if (pConn->pGIDToSecurityObject)
     {
-        LwHashRemoveAll(pConn->pGIDToSecurityObject);
+        MemCacheIndexRemoveAll(pConn->pGIDToSecurityObject);
     }
     if (pConn->pGroupAliasToSecurityObject)
     {
-        LwHashRemoveAll(pConn->pGroupAliasToSecurityObject);
+        MemCacheIndexRemoveAll(pConn->pGroupAliasToSecurityObject);
     }
 
     // Remove all of the group memberships. Either table may be iterated,
     // so the parentsid list was chosen.
-    dwError = LwHashGetIterator(
+    dwError = MemCacheIndexGetIterator(
                     pConn->pParentSIDToMembershipList,
                     &iterator);
     BAIL_ON_LSA_ERROR(dwError);
 
-    while ((pEntry = LwHashNext(&iterator)) != NULL)
+    while ((pEntry = MemCacheIndexNext(&iterator)) != NULL)
     {
         PLSA_LIST_LINKS pGuardian = (PLSA_LIST_LINKS)pEntry->pValue;
         // Since the hash entry exists, the list must be non-empty
@@ -1388,28 +2125,37 @@ MemCacheEmptyCache(
         }
     }
 
-    LSA_ASSERT(pConn->pParentSIDToMembershipList->sCount == 0);
-    LSA_ASSERT(pConn->pChildSIDToMembershipList->sCount == 0);
+    LSA_ASSERT(MemCacheIndexGetKeyCount(
+                    pConn->pParentSIDToMembershipList) == 0);
+    LSA_ASSERT(MemCacheIndexGetKeyCount(
+                    pConn->pChildSIDToMembershipList) == 0);
+
+    if (pConn->bObjectsLockCreated)
+    {
+        ENTER_WRITER_RW_LOCK(&pConn->objectsLock, bInObjectsLock);
+    }
+    pObjects = pConn->pObjects;
+    pConn->pObjects = NULL;
+    pConn->pObjectsTail = NULL;
+    pConn->sObjectCount = 0;
+    LEAVE_RW_LOCK(&pConn->objectsLock, bInObjectsLock);
 
     LwDLinkedListForEach(
-        pConn->pObjects,
+        pObjects,
         MemCacheFreeObjects,
         NULL);
-    LwDLinkedListFree(pConn->pObjects);
-    pConn->pObjects = NULL;
-
-    pConn->sCacheSize = 0;
+    LwDLinkedListFree(pObjects);
 
-    if (bMutexLocked)
+    for (dwIndex = 0; dwIndex < PINNED_USER_COUNT; dwIndex++)
     {
-        pConn->bNeedBackup = TRUE;
-        dwError = LwMapErrnoToLwError(pthread_cond_signal(&pConn->signalBackup));
-        BAIL_ON_LSA_ERROR(dwError);
+        LW_SAFE_FREE_STRING(pConn->pszPinnedSids[dwIndex]);
     }
+    pConn->dwNextPinnedSid = 0;
+
+    pConn->sCacheSize = 0;
+    pConn->sInsertsSinceSweep = 0;
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
-    LEAVE_MUTEX(&pConn->backupMutex, bMutexLocked);
     return dwError;
 
 error:
@@ -1429,7 +2175,7 @@ MemCacheCheckSizeInLock(
     // Do not free
     PLW_DLINKED_LIST pListEntry = NULL;
     // DWORD dwOut = 0;
-    LW_HASH_ITERATOR iterator = {0};
+    MEM_CACHE_INDEX_ITERATOR iterator = {0};
     // Do not free
     PMEM_GROUP_MEMBERSHIP pMembership = NULL;
     // Do not free
@@ -1452,11 +2198,11 @@ MemCacheCheckSizeInLock(
         sCacheSize += pObject->version.dwObjectSize;
     }
 
-    dwError = LwHashGetIterator(
+    dwError = MemCacheIndexGetIterator(
                     pConn->pParentSIDToMembershipList,
                     &iterator);
     BAIL_ON_LSA_ERROR(dwError);
-    while ((pEntry = LwHashNext(&iterator)) != NULL)
+    while ((pEntry = MemCacheIndexNext(&iterator)) != NULL)
     {
         pGuardian = (PLSA_LIST_LINKS) pEntry->pValue;
         pMemPos = pGuardian->Next;
@@ -1469,11 +2215,11 @@ MemCacheCheckSizeInLock(
         }
     }
 
-    dwError = LwHashGetIterator(
+    dwError = MemCacheIndexGetIterator(
                     pConn->pSIDToPasswordVerifier,
                     &iterator);
     BAIL_ON_LSA_ERROR(dwError);
-    while ((pEntry = LwHashNext(&iterator)) != NULL)
+    while ((pEntry = MemCacheIndexNext(&iterator)) != NULL)
     {
         pFromHash = (PLSA_PASSWORD_VERIFIER)pEntry->pValue;
         sCacheSize += pFromHash->version.dwObjectSize;
@@ -1492,16 +2238,14 @@ error:
 DWORD
 MemCacheRemoveObjectByHashKey(
     IN PMEM_DB_CONNECTION pConn,
-    IN OUT PLW_HASH_TABLE pTable,
+    IN OUT PMEM_CACHE_INDEX pTable,
     IN const void* pvKey
     )
 {
     DWORD dwError = 0;
     PLW_DLINKED_LIST pListEntry = NULL;
-    PLSA_SECURITY_OBJECT pObject = NULL;
-    PSTR pszKey = NULL;
 
-    dwError = LwHashGetValue(
+    dwError = MemCacheIndexGetValue(
                     pTable,
                     pvKey,
                     (PVOID*)&pListEntry);
@@ -1513,14 +2257,40 @@ MemCacheRemoveObjectByHashKey(
     }
     BAIL_ON_LSA_ERROR(dwError);
 
+    dwError = MemCacheRemoveObjectEntry(
+                    pConn,
+                    pListEntry);
+    BAIL_ON_LSA_ERROR(dwError);
+
+cleanup:
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+// Keys of the object which have already been pointed at a replacement are
+// left alone
+DWORD
+MemCacheRemoveObjectEntry(
+    IN PMEM_DB_CONNECTION pConn,
+    IN PLW_DLINKED_LIST pListEntry
+    )
+{
+    DWORD dwError = 0;
+    PLSA_SECURITY_OBJECT pObject = NULL;
+    PSTR pszKey = NULL;
+    BOOLEAN bInLock = FALSE;
+
     pObject = (PLSA_SECURITY_OBJECT)pListEntry->pItem;
 
     //Remove it from all indexes
     if (!LW_IS_NULL_OR_EMPTY_STR(pObject->pszDN))
     {
-        dwError = LwHashRemoveKey(
+        dwError = MemCacheIndexRemoveKeyIfValue(
                         pConn->pDNToSecurityObject,
-                        pObject->pszDN);
+                        pObject->pszDN,
+                        pListEntry);
         BAIL_ON_LSA_ERROR(dwError);
     }
 
@@ -1533,61 +2303,69 @@ MemCacheRemoveObjectByHashKey(
                         pObject->pszSamAccountName : "");
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = LwHashRemoveKey(
+    dwError = MemCacheIndexRemoveKeyIfValue(
                     pConn->pNT4ToSecurityObject,
-                    pszKey);
+                    pszKey,
+                    pListEntry);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = LwHashRemoveKey(
+    dwError = MemCacheIndexRemoveKeyIfValue(
                     pConn->pSIDToSecurityObject,
-                    pObject->pszObjectSid);
+                    pObject->pszObjectSid,
+                    pListEntry);
     BAIL_ON_LSA_ERROR(dwError);
 
     if (pObject->type == LSA_OBJECT_TYPE_USER)
     {
         if (pObject->enabled)
         {
-            dwError = LwHashRemoveKey(
+            dwError = MemCacheIndexRemoveKeyIfValue(
                             pConn->pUIDToSecurityObject,
-                            (PVOID)(size_t)pObject->userInfo.uid);
+                            (PVOID)(size_t)pObject->userInfo.uid,
+                            pListEntry);
             BAIL_ON_LSA_ERROR(dwError);
 
             if (pObject->userInfo.pszAliasName != NULL &&
                     pObject->userInfo.pszAliasName[0])
             {
-                dwError = LwHashRemoveKey(
+                dwError = MemCacheIndexRemoveKeyIfValue(
                                 pConn->pUserAliasToSecurityObject,
-                                pObject->userInfo.pszAliasName);
+                                pObject->userInfo.pszAliasName,
+                                pListEntry);
                 BAIL_ON_LSA_ERROR(dwError);
             }
         }
 
         if (!LW_IS_NULL_OR_EMPTY_STR(pObject->userInfo.pszUPN))
         {
-            dwError = LwHashRemoveKey(
+            dwError = MemCacheIndexRemoveKeyIfValue(
                             pConn->pUPNToSecurityObject,
-                            pObject->userInfo.pszUPN);
+                            pObject->userInfo.pszUPN,
+                            pListEntry);
             BAIL_ON_LSA_ERROR(dwError);
         }
     }
     else if (pObject->enabled && pObject->type == LSA_OBJECT_TYPE_GROUP)
     {
-        dwError = LwHashRemoveKey(
+        dwError = MemCacheIndexRemoveKeyIfValue(
                         pConn->pGIDToSecurityObject,
-                        (PVOID)(size_t)pObject->groupInfo.gid);
+                        (PVOID)(size_t)pObject->groupInfo.gid,
+                        pListEntry);
         BAIL_ON_LSA_ERROR(dwError);
 
         if (pObject->groupInfo.pszAliasName != NULL &&
                 pObject->groupInfo.pszAliasName[0])
         {
-            dwError = LwHashRemoveKey(
+            dwError = MemCacheIndexRemoveKeyIfValue(
                             pConn->pGroupAliasToSecurityObject,
-                            pObject->groupInfo.pszAliasName);
+                            pObject->groupInfo.pszAliasName,
+                            pListEntry);
             BAIL_ON_LSA_ERROR(dwError);
         }
     }
 
     //Remove it from the global linked list
+    ENTER_WRITER_RW_LOCK(&pConn->objectsLock, bInLock);
     if (pListEntry->pPrev != NULL)
     {
         pListEntry->pPrev->pNext = pListEntry->pNext;
@@ -1601,35 +2379,109 @@ MemCacheRemoveObjectByHashKey(
     {
         pListEntry->pNext->pPrev = pListEntry->pPrev;
     }
+    else
+    {
+        pConn->pObjectsTail = pListEntry->pPrev;
+    }
+    pConn->sObjectCount--;
+    LEAVE_RW_LOCK(&pConn->objectsLock, bInLock);
+
     LW_SAFE_FREE_MEMORY(pListEntry);
     pConn->sCacheSize -= pObject->version.dwObjectSize;
 
-    ADCacheSafeFreeObject(&pObject);
+    // No reader can still see the object, since it is gone from or replaced
+    // in every index, and gone from the list
+    ADCacheSafeFreeObject(&pObject);
+
+cleanup:
+    LW_SAFE_FREE_STRING(pszKey);
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+static
+BOOLEAN
+MemCacheIsExistingObject(
+    IN PLW_DLINKED_LIST pListEntry,
+    IN PLW_DLINKED_LIST* ppExisting,
+    IN size_t sExistingCount
+    )
+{
+    size_t sIndex = 0;
+
+    for (sIndex = 0; sIndex < sExistingCount; sIndex++)
+    {
+        if (ppExisting[sIndex] == pListEntry)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static
+DWORD
+MemCacheAddExistingObject(
+    IN PMEM_CACHE_INDEX pIndex,
+    IN const void* pvKey,
+    IN OUT PLW_DLINKED_LIST* ppExisting,
+    IN OUT size_t* psExistingCount
+    )
+{
+    DWORD dwError = 0;
+    PLW_DLINKED_LIST pListEntry = NULL;
+
+    dwError = MemCacheIndexGetValue(
+                    pIndex,
+                    pvKey,
+                    (PVOID*)&pListEntry);
+    if (dwError == ERROR_NOT_FOUND)
+    {
+        // The key does not exist
+        dwError = 0;
+        goto cleanup;
+    }
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (!MemCacheIsExistingObject(pListEntry, ppExisting, *psExistingCount))
+    {
+        LSA_ASSERT(*psExistingCount < MEM_CACHE_MAX_OBJECT_KEYS);
+        ppExisting[(*psExistingCount)++] = pListEntry;
+    }
 
 cleanup:
-    LW_SAFE_FREE_STRING(pszKey);
     return dwError;
 
 error:
     goto cleanup;
 }
 
+// Finds the objects which the new object replaces because they share a key
+// with it. The caller removes them once the new object is in place.
 DWORD
-MemCacheClearExistingObjectKeys(
+MemCacheFindExistingObjects(
     IN PMEM_DB_CONNECTION pConn,
-    IN PLSA_SECURITY_OBJECT pObject
+    IN PLSA_SECURITY_OBJECT pObject,
+    OUT PLW_DLINKED_LIST* ppExisting,
+    OUT size_t* psExistingCount
     )
 {
     DWORD dwError = 0;
     PSTR pszKey = NULL;
     PLW_DLINKED_LIST pListEntry = NULL;
 
+    *psExistingCount = 0;
+
     if (!LW_IS_NULL_OR_EMPTY_STR(pObject->pszDN))
     {
-        dwError = MemCacheRemoveObjectByHashKey(
-                        pConn,
+        dwError = MemCacheAddExistingObject(
                         pConn->pDNToSecurityObject,
-                        pObject->pszDN);
+                        pObject->pszDN,
+                        ppExisting,
+                        psExistingCount);
         BAIL_ON_LSA_ERROR(dwError);
     }
 
@@ -1642,23 +2494,25 @@ MemCacheClearExistingObjectKeys(
                         pObject->pszSamAccountName : "");
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = MemCacheRemoveObjectByHashKey(
-                    pConn,
+    dwError = MemCacheAddExistingObject(
                     pConn->pNT4ToSecurityObject,
-                    pszKey);
+                    pszKey,
+                    ppExisting,
+                    psExistingCount);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = MemCacheRemoveObjectByHashKey(
-                    pConn,
+    dwError = MemCacheAddExistingObject(
                     pConn->pSIDToSecurityObject,
-                    pObject->pszObjectSid);
+                    pObject->pszObjectSid,
+                    ppExisting,
+                    psExistingCount);
     BAIL_ON_LSA_ERROR(dwError);
 
     if (pObject->type == LSA_OBJECT_TYPE_USER)
     {
         if (pObject->enabled)
         {
-            dwError = LwHashGetValue(
+            dwError = MemCacheIndexGetValue(
                             pConn->pUIDToSecurityObject,
                             (PVOID)(size_t)pObject->userInfo.uid,
                             (PVOID*)&pListEntry);
@@ -1667,7 +2521,11 @@ MemCacheClearExistingObjectKeys(
                 // The key does not exist
                 dwError = 0;
             }
-            else
+            else if (dwError ||
+                     !MemCacheIsExistingObject(
+                            pListEntry,
+                            ppExisting,
+                            *psExistingCount))
             {
                 char oldTimeBuf[128] = { 0 };
                 char newTimeBuf[128] = { 0 };
@@ -1708,28 +2566,31 @@ MemCacheClearExistingObjectKeys(
 
             }
 
-            dwError = MemCacheRemoveObjectByHashKey(
-                            pConn,
+            dwError = MemCacheAddExistingObject(
                             pConn->pUIDToSecurityObject,
-                            (PVOID)(size_t)pObject->userInfo.uid);
+                            (PVOID)(size_t)pObject->userInfo.uid,
+                            ppExisting,
+                            psExistingCount);
             BAIL_ON_LSA_ERROR(dwError);
 
-            dwError = MemCacheRemoveObjectByHashKey(
-                            pConn,
+            dwError = MemCacheAddExistingObject(
                             pConn->pUserAliasToSecurityObject,
-                            pObject->userInfo.pszAliasName);
+                            pObject->userInfo.pszAliasName,
+                            ppExisting,
+                            psExistingCount);
             BAIL_ON_LSA_ERROR(dwError);
         }
 
-        dwError = MemCacheRemoveObjectByHashKey(
-                        pConn,
+        dwError = MemCacheAddExistingObject(
                         pConn->pUPNToSecurityObject,
-                        pObject->userInfo.pszUPN);
+                        pObject->userInfo.pszUPN,
+                        ppExisting,
+                        psExistingCount);
         BAIL_ON_LSA_ERROR(dwError);
     }
     else if (pObject->enabled && pObject->type == LSA_OBJECT_TYPE_GROUP)
     {
-        dwError = LwHashGetValue(
+        dwError = MemCacheIndexGetValue(
                         pConn->pGIDToSecurityObject,
                         (PVOID)(size_t)pObject->groupInfo.gid,
                         (PVOID*)&pListEntry);
@@ -1738,7 +2599,11 @@ MemCacheClearExistingObjectKeys(
             // The key does not exist
             dwError = 0;
         }
-        else
+        else if (dwError ||
+                 !MemCacheIsExistingObject(
+                        pListEntry,
+                        ppExisting,
+                        *psExistingCount))
         {
             char oldTimeBuf[128] = { 0 };
             char newTimeBuf[128] = { 0 };
@@ -1777,16 +2642,18 @@ MemCacheClearExistingObjectKeys(
                 gpszADProviderName,
                 LSASS_EVENT_WARNING_CONFIGURATION_ID_CONFLICT);
         }
-        dwError = MemCacheRemoveObjectByHashKey(
-                        pConn,
+        dwError = MemCacheAddExistingObject(
                         pConn->pGIDToSecurityObject,
-                        (PVOID)(size_t)pObject->groupInfo.gid);
+                        (PVOID)(size_t)pObject->groupInfo.gid,
+                        ppExisting,
+                        psExistingCount);
         BAIL_ON_LSA_ERROR(dwError);
 
-        dwError = MemCacheRemoveObjectByHashKey(
-                        pConn,
+        dwError = MemCacheAddExistingObject(
                         pConn->pGroupAliasToSecurityObject,
-                        pObject->groupInfo.pszAliasName);
+                        pObject->groupInfo.pszAliasName,
+                        ppExisting,
+                        psExistingCount);
         BAIL_ON_LSA_ERROR(dwError);
     }
 
@@ -1798,29 +2665,6 @@ error:
     goto cleanup;
 }
 
-DWORD
-MemCacheEnsureHashSpace(
-    IN OUT PLW_HASH_TABLE pTable,
-    IN size_t sNewEntries
-    )
-{
-    DWORD dwError = 0;
-
-    if ((pTable->sCount + sNewEntries) * 2 > pTable->sTableSize)
-    {
-        dwError = LwHashResize(
-            pTable,
-            (pTable->sCount + sNewEntries + 10) * 3);
-        BAIL_ON_LSA_ERROR(dwError);
-    }
-
-cleanup:
-    return dwError;
-
-error:
-    goto cleanup;
-}
-
 DWORD
 MemCacheStoreObjectEntries(
     IN LSA_DB_HANDLE hDb,
@@ -1843,52 +2687,52 @@ MemCacheStoreObjectEntries(
     BAIL_ON_LSA_ERROR(dwError);
 
     ENTER_MUTEX(&pConn->backupMutex, bMutexLocked);
-    ENTER_WRITER_RW_LOCK(&pConn->lock, bInLock);
+    ENTER_MUTEX(&pConn->lock, bInLock);
 
     // For simplicity, don't check whether keys exist for sure or whether the
     // objects are users or groups. Just make sure there is enough space in all
     // cases.
-    dwError = MemCacheEnsureHashSpace(
+    dwError = MemCacheIndexEnsureSpace(
                     pConn->pDNToSecurityObject,
                     sObjectCount);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = MemCacheEnsureHashSpace(
+    dwError = MemCacheIndexEnsureSpace(
                     pConn->pNT4ToSecurityObject,
                     sObjectCount);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = MemCacheEnsureHashSpace(
+    dwError = MemCacheIndexEnsureSpace(
                     pConn->pSIDToSecurityObject,
                     sObjectCount);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = MemCacheEnsureHashSpace(
+    dwError = MemCacheIndexEnsureSpace(
                     pConn->pUIDToSecurityObject,
                     sObjectCount);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = MemCacheEnsureHashSpace(
+    dwError = MemCacheIndexEnsureSpace(
                     pConn->pUserAliasToSecurityObject,
                     sObjectCount);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = MemCacheEnsureHashSpace(
+    dwError = MemCacheIndexEnsureSpace(
                     pConn->pUPNToSecurityObject,
                     sObjectCount);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = MemCacheEnsureHashSpace(
+    dwError = MemCacheIndexEnsureSpace(
                     pConn->pSIDToPasswordVerifier,
                     sObjectCount);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = MemCacheEnsureHashSpace(
+    dwError = MemCacheIndexEnsureSpace(
                     pConn->pGIDToSecurityObject,
                     sObjectCount);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = MemCacheEnsureHashSpace(
+    dwError = MemCacheIndexEnsureSpace(
                     pConn->pGroupAliasToSecurityObject,
                     sObjectCount);
     BAIL_ON_LSA_ERROR(dwError);
@@ -1901,6 +2745,7 @@ MemCacheStoreObjectEntries(
         BAIL_ON_LSA_ERROR(dwError);
 
         pObject->version.tLastUpdated = now;
+        pObject->version.fWeight = 0;
 
         dwError = MemCacheStoreObjectEntryInLock(
                         pConn,
@@ -1908,6 +2753,11 @@ MemCacheStoreObjectEntries(
         // It is now owned by the hash table
         pObject = NULL;
         BAIL_ON_LSA_ERROR(dwError);
+
+        MemCacheLogMessage(
+            pConn,
+            MEM_CACHE_OBJECT,
+            pConn->pObjects->pItem);
     }
 
     dwError = MemCacheMaintainSizeCap(pConn);
@@ -1919,7 +2769,7 @@ MemCacheStoreObjectEntries(
 
 cleanup:
     LW_SAFE_FREE_STRING(pszKey);
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_MUTEX(&pConn->lock, bInLock);
     LEAVE_MUTEX(&pConn->backupMutex, bMutexLocked);
 
     return dwError;
@@ -1959,7 +2809,7 @@ MemCacheFindMembership(
     // Do not free
     PMEM_GROUP_MEMBERSHIP pMembership = NULL;
 
-    dwError = LwHashGetValue(
+    dwError = MemCacheIndexGetValue(
                     pConn->pParentSIDToMembershipList,
                     pszParentSid,
                     (PVOID*)&pGuardian);
@@ -1990,166 +2840,173 @@ MemCacheFindMembership(
 }
 
 VOID
-MemCacheResetWeight(
-    IN PVOID pData,
-    IN PVOID pNow
+MemCacheMoveObjectToFront(
+    IN PMEM_DB_CONNECTION pConn,
+    IN PLW_DLINKED_LIST pListEntry
     )
 {
-    PLSA_SECURITY_OBJECT pObject = (PLSA_SECURITY_OBJECT)pData;
-    time_t age = *(time_t*)pNow - pObject->version.tLastUpdated;
+    BOOLEAN bInLock = FALSE;
+
+    if (pListEntry == pConn->pObjects)
+    {
+        return;
+    }
+
+    ENTER_WRITER_RW_LOCK(&pConn->objectsLock, bInLock);
 
-    if (age < 0)
+    // The entry is not the head, so it must have a previous entry
+    pListEntry->pPrev->pNext = pListEntry->pNext;
+    if (pListEntry->pNext != NULL)
+    {
+        pListEntry->pNext->pPrev = pListEntry->pPrev;
+    }
+    else
     {
-        age = 0;
+        pConn->pObjectsTail = pListEntry->pPrev;
     }
 
-    pObject->version.fWeight = 1.0 / (age + LOGGED_IN_VS_NSEC);
+    pListEntry->pPrev = NULL;
+    pListEntry->pNext = pConn->pObjects;
+    pConn->pObjects->pPrev = pListEntry;
+    pConn->pObjects = pListEntry;
+
+    LEAVE_RW_LOCK(&pConn->objectsLock, bInLock);
 }
 
-VOID
-MemCacheMergeLists(
-    IN OUT PLW_DLINKED_LIST pList1,
-    IN OUT PLW_DLINKED_LIST pList2,
-    IN OUT PLW_DLINKED_LIST pList2End
+// Called whenever a user logs in. The user and the groups it is a member of
+// are sent back to the front of the eviction queue a few more times before
+// they can be evicted, and the user is pinned as one of the most recently
+// logged in users.
+DWORD
+MemCacheProtectLoggedInUser(
+    IN PMEM_DB_CONNECTION pConn,
+    IN PCSTR pszSid
     )
 {
-    PLSA_SECURITY_OBJECT pObject1 = NULL;
-    PLSA_SECURITY_OBJECT pObject2 = NULL;
-    PLW_DLINKED_LIST pInsertAfter = pList1->pPrev;
-    PLW_DLINKED_LIST pList1End = pList2;
+    DWORD dwError = 0;
+    DWORD dwIndex = 0;
+    // Do not free
+    PLW_DLINKED_LIST pListEntry = NULL;
+    // Do not free
+    PLSA_LIST_LINKS pGuardian = NULL;
+    // Do not free
+    PLSA_LIST_LINKS pPos = NULL;
+    // Do not free
+    PMEM_GROUP_MEMBERSHIP pMembership = NULL;
 
-    while (pList1 != pList1End && pList2 != pList2End)
+    dwError = MemCacheIndexGetValue(
+                    pConn->pSIDToSecurityObject,
+                    pszSid,
+                    (PVOID*)&pListEntry);
+    if (dwError == ERROR_NOT_FOUND)
     {
-        pObject1 = (PLSA_SECURITY_OBJECT)pList1->pItem;
-        pObject2 = (PLSA_SECURITY_OBJECT)pList2->pItem;
-
-        if (pObject1->version.fWeight < pObject2->version.fWeight)
-        {
-            pInsertAfter->pNext = pList1;
-            pList1->pPrev = pInsertAfter;
+        dwError = 0;
+    }
+    BAIL_ON_LSA_ERROR(dwError);
 
-            pInsertAfter = pList1;
-            pList1 = pList1->pNext;
-        }
-        else
-        {
-            pInsertAfter->pNext = pList2;
-            pList2->pPrev = pInsertAfter;
+    if (pListEntry)
+    {
+        ((PLSA_SECURITY_OBJECT)pListEntry->pItem)->version.fWeight =
+            LOGGED_IN_REPRIEVE_COUNT;
+    }
 
-            pInsertAfter = pList2;
-            pList2 = pList2->pNext;
-        }
+    // Protect all the groups the user is a member of
+    dwError = MemCacheIndexGetValue(
+                    pConn->pChildSIDToMembershipList,
+                    pszSid,
+                    (PVOID*)&pGuardian);
+    if (dwError == ERROR_NOT_FOUND)
+    {
+        dwError = 0;
     }
+    BAIL_ON_LSA_ERROR(dwError);
 
-    if (pList1 != pList1End)
+    if (pGuardian)
     {
-        pInsertAfter->pNext = pList1;
-        pList1->pPrev = pInsertAfter;
+        pPos = pGuardian->Next;
+    }
+    else
+    {
+        pPos = pGuardian;
+    }
+    while (pPos != pGuardian)
+    {
+        pMembership = CHILD_NODE_TO_MEMBERSHIP(pPos);
+        pPos = pPos->Next;
 
-        while (pList1->pNext != pList1End)
+        // Skip the completeness entry
+        if (pMembership->membership.pszParentSid == NULL)
         {
-            pList1 = pList1->pNext;
+            continue;
+        }
+
+        pListEntry = NULL;
+        dwError = MemCacheIndexGetValue(
+                        pConn->pSIDToSecurityObject,
+                        pMembership->membership.pszParentSid,
+                        (PVOID*)&pListEntry);
+        if (dwError == ERROR_NOT_FOUND)
+        {
+            dwError = 0;
         }
-        pList1->pNext = pList2End;
-        if (pList2End != NULL)
+        BAIL_ON_LSA_ERROR(dwError);
+
+        if (pListEntry)
         {
-            pList2End->pPrev = pList1;
+            ((PLSA_SECURITY_OBJECT)pListEntry->pItem)->version.fWeight =
+                LOGGED_IN_REPRIEVE_COUNT;
         }
     }
-    else
+
+    for (dwIndex = 0; dwIndex < PINNED_USER_COUNT; dwIndex++)
     {
-        pInsertAfter->pNext = pList2;
-        pList2->pPrev = pInsertAfter;
+        if (pConn->pszPinnedSids[dwIndex] &&
+            !strcasecmp(pConn->pszPinnedSids[dwIndex], pszSid))
+        {
+            // Already pinned
+            goto cleanup;
+        }
     }
-}
 
-// Returns the first item in the object list that is out of order, or NULL if
-// the entire list is ordered.
-PLW_DLINKED_LIST
-MemCacheFindOutOfOrderNode(
-    IN PLW_DLINKED_LIST pList
-    )
-{
-    PLSA_SECURITY_OBJECT pCurObject = NULL;
-    PLSA_SECURITY_OBJECT pNextObject = NULL;
+    // Replace the user that logged in longest ago
+    LW_SAFE_FREE_STRING(pConn->pszPinnedSids[pConn->dwNextPinnedSid]);
+    dwError = LwAllocateString(
+                    pszSid,
+                    &pConn->pszPinnedSids[pConn->dwNextPinnedSid]);
+    BAIL_ON_LSA_ERROR(dwError);
 
-    while (pList->pNext != NULL)
-    {
-        pCurObject = (PLSA_SECURITY_OBJECT)pList->pItem;
-        pNextObject = (PLSA_SECURITY_OBJECT)pList->pNext->pItem;
+    pConn->dwNextPinnedSid = (pConn->dwNextPinnedSid + 1) % PINNED_USER_COUNT;
 
-        if (pCurObject->version.fWeight > pNextObject->version.fWeight)
-        {
-            // The next object is out of order
-            break;
-        }
+cleanup:
+    return dwError;
 
-        pList = pList->pNext;
-    }
-    return pList->pNext;
+error:
+    goto cleanup;
 }
 
-VOID
-MemCacheSortObjectList(
-    IN OUT PLW_DLINKED_LIST* ppObjects
+BOOLEAN
+MemCacheIsPinnedObject(
+    IN PMEM_DB_CONNECTION pConn,
+    IN PLSA_SECURITY_OBJECT pObject
     )
 {
-    LW_DLINKED_LIST guardian = { 0 };
-    PLW_DLINKED_LIST pObjects = *ppObjects;
-    PLW_DLINKED_LIST pList1 = NULL;
-    PLW_DLINKED_LIST pList2 = NULL;
-    PLW_DLINKED_LIST pList2End = NULL;
+    DWORD dwIndex = 0;
 
-    if (pObjects)
+    if (pObject->type != LSA_OBJECT_TYPE_USER)
     {
-        // Add a fake first node to simplify the calculations. This node will be
-        // removed after the list is sorted.
-        pObjects->pPrev = &guardian;
-        guardian.pNext = pObjects;
-
-        do
-        {
-            pList2End = guardian.pNext;
-            while (pList2End != NULL)
-            {
-                // Find two consecutive lists which are ordered
-                pList1 = pList2End;
-                pList2 = MemCacheFindOutOfOrderNode(pList1);
-                if (pList2 != NULL)
-                {
-                    pList2End = MemCacheFindOutOfOrderNode(pList2);
-                    // Merge them together to make one ordered list
-                    MemCacheMergeLists(pList1, pList2, pList2End);
-                }
-                else
-                {
-                    break;
-                }
-            }
-        // while the entire list is not ordered
-        } while (pList1 != guardian.pNext);
+        return FALSE;
+    }
 
-        // Double check the sort worked
-        pList1 = guardian.pNext;
-        while (pList1)
+    for (dwIndex = 0; dwIndex < PINNED_USER_COUNT; dwIndex++)
+    {
+        if (pConn->pszPinnedSids[dwIndex] &&
+            !strcasecmp(pConn->pszPinnedSids[dwIndex], pObject->pszObjectSid))
         {
-            if (pList1->pNext)
-            {
-                PLSA_SECURITY_OBJECT pCurObject = NULL;
-                PLSA_SECURITY_OBJECT pNextObject = NULL;
-
-                pCurObject = (PLSA_SECURITY_OBJECT)pList1->pItem;
-                pNextObject = (PLSA_SECURITY_OBJECT)pList1->pNext->pItem;
-
-                LSA_ASSERT(pCurObject->version.fWeight <=
-                        pNextObject->version.fWeight);
-            }
-            pList1 = pList1->pNext;
+            return TRUE;
         }
-
-        *ppObjects = guardian.pNext;
-        guardian.pNext->pPrev = NULL;
     }
+
+    return FALSE;
 }
 
 DWORD
@@ -2158,7 +3015,7 @@ MemCacheRemoveOrphanedMemberships(
     )
 {
     DWORD dwError = 0;
-    LW_HASH_ITERATOR iterator = {0};
+    MEM_CACHE_INDEX_ITERATOR iterator = {0};
     LW_HASH_ENTRY *pEntry = NULL;
     PMEM_GROUP_MEMBERSHIP pMembership = NULL;
     BOOLEAN bOrphaned = FALSE;
@@ -2166,12 +3023,12 @@ MemCacheRemoveOrphanedMemberships(
     PMEM_GROUP_MEMBERSHIP pCompleteness = NULL;
 
     // Only one table needs to be enumerated to see all memberships
-    dwError = LwHashGetIterator(
+    dwError = MemCacheIndexGetIterator(
                     pConn->pParentSIDToMembershipList,
                     &iterator);
     BAIL_ON_LSA_ERROR(dwError);
 
-    while ((pEntry = LwHashNext(&iterator)) != NULL)
+    while ((pEntry = MemCacheIndexNext(&iterator)) != NULL)
     {
         PLSA_LIST_LINKS pGuardian = (PLSA_LIST_LINKS)pEntry->pValue;
         PLSA_LIST_LINKS pPos = pGuardian->Next;
@@ -2183,7 +3040,7 @@ MemCacheRemoveOrphanedMemberships(
 
             if (pMembership->membership.pszParentSid != NULL)
             {
-                dwError = LwHashGetValue(
+                dwError = MemCacheIndexGetValue(
                                 pConn->pSIDToSecurityObject,
                                 pMembership->membership.pszParentSid,
                                 (PVOID*)&pListEntry);
@@ -2197,7 +3054,7 @@ MemCacheRemoveOrphanedMemberships(
 
             if (pMembership->membership.pszChildSid != NULL)
             {
-                dwError = LwHashGetValue(
+                dwError = MemCacheIndexGetValue(
                                 pConn->pSIDToSecurityObject,
                                 pMembership->membership.pszChildSid,
                                 (PVOID*)&pListEntry);
@@ -2263,7 +3120,7 @@ MemCacheRemoveOrphanedMemberships(
                     // This was not an issue for deleting the parent
                     // completeness node, since it was guarenteed to be in the
                     // same linked list (and thus the same hash entry).
-                    iterator.pEntryPos = NULL;
+                    iterator.inner.pEntryPos = NULL;
                 }
 
                 // It is safe to remove this membership since pPos points to
@@ -2282,109 +3139,157 @@ error:
     goto cleanup;
 }
 
-VOID
-MemCacheAddPinnedObject(
-    IN OUT PLSA_SECURITY_OBJECT pPinnedObjects[PINNED_USER_COUNT],
-    IN PLSA_SECURITY_OBJECT pObject
+// Remove any orphaned password verifiers (password verifiers where the
+// corresponding user security object is not cached)
+DWORD
+MemCacheRemoveOrphanedPasswordVerifiers(
+    IN PMEM_DB_CONNECTION pConn
     )
 {
-    ssize_t ssIndex = 0;
+    DWORD dwError = 0;
+    MEM_CACHE_INDEX_ITERATOR iterator = {0};
+    // Do not free
+    LW_HASH_ENTRY *pEntry = NULL;
+    // Do not free
+    PLW_DLINKED_LIST pListEntry = NULL;
+
+    dwError = MemCacheIndexGetIterator(
+                    pConn->pSIDToPasswordVerifier,
+                    &iterator);
+    BAIL_ON_LSA_ERROR(dwError);
 
-    for (ssIndex = PINNED_USER_COUNT - 1;
-        ssIndex >= 0;
-        ssIndex--)
+    while ((pEntry = MemCacheIndexNext(&iterator)) != NULL)
     {
-        if (!pPinnedObjects[ssIndex] ||
-                pObject->version.tLastUpdated >
-                pPinnedObjects[ssIndex]->version.tLastUpdated)
+        PLSA_PASSWORD_VERIFIER pFromHash = (PLSA_PASSWORD_VERIFIER)
+            pEntry->pValue;
+
+        dwError = MemCacheIndexGetValue(
+                        pConn->pSIDToSecurityObject,
+                        pFromHash->pszObjectSid,
+                        (PVOID*)&pListEntry);
+        if (dwError == ERROR_NOT_FOUND)
         {
-            memmove(pPinnedObjects, pPinnedObjects + 1, ssIndex);
-            pPinnedObjects[ssIndex] = pObject;
-            return;
+            LSA_LOG_INFO("Removing orphaned password verifier for sid %s",
+                    pFromHash->pszObjectSid);
+            pConn->sCacheSize -= pFromHash->version.dwObjectSize;
+
+            // It is safe to remove this key because the iterator already
+            // points to the next item.
+            dwError = MemCacheIndexRemoveKey(
+                            pConn->pSIDToPasswordVerifier,
+                            pEntry->pKey);
+            BAIL_ON_LSA_ERROR(dwError);
         }
+        BAIL_ON_LSA_ERROR(dwError);
     }
+
+cleanup:
+    return dwError;
+error:
+    goto cleanup;
 }
 
-static
 DWORD
-MemCacheSetPinnedObjectWeights(
+MemCacheEvictObject(
     IN PMEM_DB_CONNECTION pConn,
-    IN OUT PLSA_SECURITY_OBJECT pPinnedObjects[PINNED_USER_COUNT]
+    IN PLSA_SECURITY_OBJECT pObject
     )
 {
     DWORD dwError = 0;
-    size_t ssIndex = 0;
-    time_t age = 0;
-    PLSA_SECURITY_OBJECT pObject = NULL;
-    // Do not free
-    PLSA_LIST_LINKS pGuardian = NULL;
-    // Do not free
-    PLSA_LIST_LINKS pPos = NULL;
     // Do not free
-    PMEM_GROUP_MEMBERSHIP pMembership = NULL;
+    PSTR pszSid = pObject->pszObjectSid;
     // Do not free
-    PLW_DLINKED_LIST pListEntry = NULL;
+    PLSA_PASSWORD_VERIFIER pFromHash = NULL;
 
-    for (ssIndex = 0; ssIndex < PINNED_USER_COUNT; ssIndex++)
+    if (pObject->type == LSA_OBJECT_TYPE_USER)
     {
-        pObject = pPinnedObjects[ssIndex];
-        if (pObject)
-        {
-            LSA_LOG_VERBOSE("User object %s\\%s (sid %s) is pinned (cannot be evicted before unpinned objects)",
-                    pObject->pszNetbiosDomainName,
-                    pObject->pszSamAccountName,
-                    pObject->pszObjectSid);
+        LSA_LOG_VERBOSE("Evicting user %s\\%s (sid %s)",
+                pObject->pszNetbiosDomainName,
+                pObject->pszSamAccountName,
+                pszSid);
+    }
+    else if (pObject->type == LSA_OBJECT_TYPE_GROUP)
+    {
+        LSA_LOG_VERBOSE("Evicting group %s\\%s (sid %s)",
+                pObject->pszNetbiosDomainName,
+                pObject->pszSamAccountName,
+                pszSid);
+    }
+    else
+    {
+        LSA_LOG_VERBOSE("Evicting object with sid %s", pszSid);
+    }
+
+    dwError = MemCacheIndexGetValue(
+                    pConn->pSIDToPasswordVerifier,
+                    pszSid,
+                    (PVOID*)&pFromHash);
+    if (dwError == ERROR_NOT_FOUND)
+    {
+        // The password verifier did not exist
+        dwError = 0;
+    }
+    else if (dwError)
+    {
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+    else
+    {
+        pConn->sCacheSize -= pFromHash->version.dwObjectSize;
 
-            pObject->version.fWeight = 1.0 / (age + LOGGED_IN_VS_NSEC) *
-                ((LOGGED_IN_VS_ZERO_SEC + LOGGED_IN_VS_NSEC)/
-                 LOGGED_IN_VS_NSEC);
+        dwError = MemCacheIndexRemoveKey(
+                        pConn->pSIDToPasswordVerifier,
+                        pszSid);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
 
-            // Increase the weight of all the groups the user is a member of
-            dwError = LwHashGetValue(
-                            pConn->pChildSIDToMembershipList,
-                            pObject->pszObjectSid,
-                            (PVOID*)&pGuardian);
-            if (dwError == ERROR_NOT_FOUND)
-            {
-                dwError = 0;
-            }
-            BAIL_ON_LSA_ERROR(dwError);
+    // Remove all membership information for what this group contains (and
+    // remove the completeness entry in the children's member-of list)
+    MemCacheRemoveMembershipsBySid(
+        pConn,
+        pszSid,
+        TRUE,
+        TRUE);
 
-            if (pGuardian)
-            {
-                pPos = pGuardian->Next;
-            }
-            else
-            {
-                pPos = pGuardian;
-            }
-            while (pPos != pGuardian)
-            {
-                pMembership = CHILD_NODE_TO_MEMBERSHIP(pPos);
+    // Remove all membership information for what groups this user is a
+    // member of (and remove the completeness entry in the parent group's
+    // member-of list)
+    MemCacheRemoveMembershipsBySid(
+        pConn,
+        pszSid,
+        FALSE,
+        TRUE);
+
+    dwError = MemCacheRemoveObjectByHashKey(
+                    pConn,
+                    pConn->pSIDToSecurityObject,
+                    pszSid);
+    BAIL_ON_LSA_ERROR(dwError);
+
+cleanup:
+    return dwError;
 
-                dwError = LwHashGetValue(
-                                pConn->pSIDToSecurityObject,
-                                pMembership->membership.pszParentSid,
-                                (PVOID*)&pListEntry);
-                if (dwError == ERROR_NOT_FOUND)
-                {
-                    dwError = 0;
-                }
-                BAIL_ON_LSA_ERROR(dwError);
+error:
+    goto cleanup;
+}
 
-                if (pListEntry)
-                {
-                    pObject = (PLSA_SECURITY_OBJECT)pListEntry->pItem;
+static
+DWORD
+MemCacheSweepOrphans(
+    IN PMEM_DB_CONNECTION pConn
+    )
+{
+    DWORD dwError = 0;
 
-                    pObject->version.fWeight = 1.0 / (age + LOGGED_IN_VS_NSEC) *
-                        ((LOGGED_IN_VS_ZERO_SEC + LOGGED_IN_VS_NSEC)/
-                             LOGGED_IN_VS_NSEC);
-                }
+    // Remove any orphaned memberships (memberships where the parent or child
+    // security object is not cached)
+    dwError = MemCacheRemoveOrphanedMemberships(pConn);
+    BAIL_ON_LSA_ERROR(dwError);
 
-                pPos = pPos->Next;
-            }
-        }
-    }
+    dwError = MemCacheRemoveOrphanedPasswordVerifiers(pConn);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pConn->sInsertsSinceSweep = 0;
 
 cleanup:
     return dwError;
@@ -2392,6 +3297,20 @@ error:
     goto cleanup;
 }
 
+// Objects are evicted from the tail of pConn->pObjects, which holds the
+// objects that were stored longest ago. Protected objects found at the tail
+// are moved back to the head instead:
+//
+// - pinned users are moved back, but at most PINNED_USER_COUNT times per
+//   call. Each pinned user is therefore skipped once, and is only evicted if
+//   it reaches the tail again after everything in front of it was evicted
+//   or moved back
+// - users that logged in, and their groups, are moved back while they have
+//   reprieves left (version.fWeight) and are younger than
+//   LOGGED_IN_VS_ZERO_SEC
+//
+// Every reprieve is handed out by an insert or a login, so the work done here
+// is O(1) per insert on average and no pass over the whole cache is needed.
 DWORD
 MemCacheMaintainSizeCap(
     IN PMEM_DB_CONNECTION pConn
@@ -2399,25 +3318,14 @@ MemCacheMaintainSizeCap(
 {
     DWORD dwError = 0;
     // Do not free
-    PMEM_GROUP_MEMBERSHIP pMembership = NULL;
-    // Do not free
     PLW_DLINKED_LIST pListEntry = NULL;
     // Do not free
-    LW_HASH_ENTRY *pEntry = NULL;
-    LW_HASH_ITERATOR iterator = {0};
-    time_t now = 0;
     PLSA_SECURITY_OBJECT pObject = NULL;
+    time_t now = 0;
     time_t age = 0;
-    // Do not free
-    PLSA_LIST_LINKS pGuardian = NULL;
-    // Do not free
-    PLSA_LIST_LINKS pPos = NULL;
-    // Do not free
-    PSTR pszSid = NULL;
-    PLSA_SECURITY_OBJECT pPinnedObjects[PINNED_USER_COUNT] = { 0 };
-
-    dwError = LsaGetCurrentTimeSeconds(&now);
-    BAIL_ON_LSA_ERROR(dwError);
+    size_t sTargetSize = 0;
+    DWORD dwPinnedMoves = 0;
+    BOOLEAN bSwept = FALSE;
 
     // The connection already has a write lock
 
@@ -2431,198 +3339,70 @@ MemCacheMaintainSizeCap(
         goto cleanup;
     }
 
-    LSA_LOG_WARNING("The current cache size (%zu) is larger than the cap (%zu) - evicting old objects", pConn->sCacheSize, pConn->sSizeCap);
-
-    // Remove any orphaned memberships (memberships where the parent or child
-    // security object is not cached)
-
-    dwError = MemCacheRemoveOrphanedMemberships(pConn);
+    dwError = LsaGetCurrentTimeSeconds(&now);
     BAIL_ON_LSA_ERROR(dwError);
 
-    LwDLinkedListForEach(
-        pConn->pObjects,
-        MemCacheResetWeight,
-        &now);
+    LSA_LOG_WARNING("The current cache size (%zu) is larger than the cap (%zu) - evicting old objects", pConn->sCacheSize, pConn->sSizeCap);
 
-    // Remove any orphaned password verifiers (password verifiers where the
-    // corresponding user security object is not cached). Also increase the
-    // weight of security objects associated with users who have logged in.
+    if (pConn->sInsertsSinceSweep >=
+            pConn->sMembershipCount +
+            MemCacheIndexGetKeyCount(pConn->pSIDToPasswordVerifier))
+    {
+        dwError = MemCacheSweepOrphans(pConn);
+        BAIL_ON_LSA_ERROR(dwError);
+        bSwept = TRUE;
+    }
 
-    dwError = LwHashGetIterator(
-                    pConn->pSIDToPasswordVerifier,
-                    &iterator);
-    BAIL_ON_LSA_ERROR(dwError);
+    sTargetSize = pConn->sSizeCap * 3/4;
 
-    while ((pEntry = LwHashNext(&iterator)) != NULL)
+    while (pConn->sCacheSize > sTargetSize)
     {
-        PLSA_PASSWORD_VERIFIER pFromHash = (PLSA_PASSWORD_VERIFIER)
-            pEntry->pValue;
-
-        dwError = LwHashGetValue(
-                        pConn->pSIDToSecurityObject,
-                        pFromHash->pszObjectSid,
-                        (PVOID*)&pListEntry);
-        if (dwError == ERROR_NOT_FOUND)
+        pListEntry = pConn->pObjectsTail;
+        if (pListEntry == NULL)
         {
-            LSA_LOG_INFO("Removing orphaned password verifier for sid %s",
-                    pFromHash->pszObjectSid);
-            pConn->sCacheSize -= pFromHash->version.dwObjectSize;
+            if (bSwept)
+            {
+                break;
+            }
 
-            // It is safe to remove this key because the iterator already
-            // points to the next item.
-            dwError = LwHashRemoveKey(
-                            pConn->pSIDToPasswordVerifier,
-                            pEntry->pKey);
+            // Only memberships and password verifiers are left
+            dwError = MemCacheSweepOrphans(pConn);
             BAIL_ON_LSA_ERROR(dwError);
+            bSwept = TRUE;
+            continue;
         }
-        BAIL_ON_LSA_ERROR(dwError);
 
-        if (pListEntry != NULL)
-        {
-            pObject = (PLSA_SECURITY_OBJECT)pListEntry->pItem;
+        pObject = (PLSA_SECURITY_OBJECT)pListEntry->pItem;
 
-            if (!pPinnedObjects[0] || pObject->version.tLastUpdated > pPinnedObjects[0]->version.tLastUpdated)
+        // The last object left is evicted no matter what
+        if (pListEntry != pConn->pObjects)
+        {
+            // Pinned users share PINNED_USER_COUNT moves back per call, which
+            // is one each; a pinned user that reaches the tail again after
+            // that is evicted like anything else.
+            if (dwPinnedMoves < PINNED_USER_COUNT &&
+                MemCacheIsPinnedObject(pConn, pObject))
             {
-                MemCacheAddPinnedObject(pPinnedObjects, pObject);
+                LSA_LOG_VERBOSE("User object %s\\%s (sid %s) is pinned (cannot be evicted before unpinned objects)",
+                        pObject->pszNetbiosDomainName,
+                        pObject->pszSamAccountName,
+                        pObject->pszObjectSid);
+
+                dwPinnedMoves++;
+                MemCacheMoveObjectToFront(pConn, pListEntry);
+                continue;
             }
 
             age = now - pObject->version.tLastUpdated;
-            if (age < 0)
-            {
-                age = 0;
-            }
-            pObject->version.fWeight = 1.0 / (age + LOGGED_IN_VS_NSEC) *
-                ((LOGGED_IN_VS_ZERO_SEC + LOGGED_IN_VS_NSEC)/ LOGGED_IN_VS_NSEC);
-
-            // Increase the weight of all the groups the user is a member of
-            dwError = LwHashGetValue(
-                            pConn->pChildSIDToMembershipList,
-                            pFromHash->pszObjectSid,
-                            (PVOID*)&pGuardian);
-            if (dwError == ERROR_NOT_FOUND)
-            {
-                dwError = 0;
-            }
-            BAIL_ON_LSA_ERROR(dwError);
-
-            if (pGuardian)
-            {
-                pPos = pGuardian->Next;
-            }
-            else
+            if (pObject->version.fWeight >= 1 && age < LOGGED_IN_VS_ZERO_SEC)
             {
-                pPos = pGuardian;
+                pObject->version.fWeight -= 1;
+                MemCacheMoveObjectToFront(pConn, pListEntry);
+                continue;
             }
-            while (pPos != pGuardian)
-            {
-                pMembership = CHILD_NODE_TO_MEMBERSHIP(pPos);
-
-                dwError = LwHashGetValue(
-                                pConn->pSIDToSecurityObject,
-                                pMembership->membership.pszParentSid,
-                                (PVOID*)&pListEntry);
-                if (dwError == ERROR_NOT_FOUND)
-                {
-                    dwError = 0;
-                }
-                BAIL_ON_LSA_ERROR(dwError);
-
-                if (pListEntry)
-                {
-                    pObject = (PLSA_SECURITY_OBJECT)pListEntry->pItem;
-
-                    age = now - pObject->version.tLastUpdated;
-                    if (age < 0)
-                    {
-                        age = 0;
-                    }
-                    pObject->version.fWeight = 1.0 / (age + LOGGED_IN_VS_NSEC) *
-                        ((LOGGED_IN_VS_ZERO_SEC + LOGGED_IN_VS_NSEC)/
-                             LOGGED_IN_VS_NSEC);
-                }
-
-                pPos = pPos->Next;
-            }
-        }
-    }
-
-    dwError = MemCacheSetPinnedObjectWeights(
-                    pConn,
-                    pPinnedObjects);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    MemCacheSortObjectList(&pConn->pObjects);
-
-    while (pConn->sCacheSize > pConn->sSizeCap * 3/4)
-    {
-        PLSA_PASSWORD_VERIFIER pFromHash = NULL;
-
-        pObject = (PLSA_SECURITY_OBJECT)pConn->pObjects->pItem;
-        pszSid = pObject->pszObjectSid;
-
-        if (pObject->type == LSA_OBJECT_TYPE_USER)
-        {
-            LSA_LOG_VERBOSE("Evicting user %s\\%s (sid %s)",
-                    pObject->pszNetbiosDomainName,
-                    pObject->pszSamAccountName,
-                    pszSid);
-        }
-        else if (pObject->type == LSA_OBJECT_TYPE_GROUP)
-        {
-            LSA_LOG_VERBOSE("Evicting group %s\\%s (sid %s)",
-                    pObject->pszNetbiosDomainName,
-                    pObject->pszSamAccountName,
-                    pszSid);
-        }
-        else
-        {
-            LSA_LOG_VERBOSE("Evicting object with sid %s", pszSid);
-        }
-
-        dwError = LwHashGetValue(
-                        pConn->pSIDToPasswordVerifier,
-                        pszSid,
-                        (PVOID*)&pFromHash);
-        if (dwError == ERROR_NOT_FOUND)
-        {
-            // The password verifier did not exist
-            dwError = 0;
-        }
-        else if (dwError)
-        {
-            BAIL_ON_LSA_ERROR(dwError);
-        }
-        else
-        {
-            pConn->sCacheSize -= pFromHash->version.dwObjectSize;
-
-            dwError = LwHashRemoveKey(
-                            pConn->pSIDToPasswordVerifier,
-                            pszSid);
-            BAIL_ON_LSA_ERROR(dwError);
         }
 
-        // Remove all membership information for what this group contains (and
-        // remove the completeness entry in the children's member-of list)
-        MemCacheRemoveMembershipsBySid(
-            pConn,
-            pszSid,
-            TRUE,
-            TRUE);
-
-        // Remove all membership information for what groups this user is a
-        // member of (and remove the completeness entry in the parent group's
-        // member-of list)
-        MemCacheRemoveMembershipsBySid(
-            pConn,
-            pszSid,
-            FALSE,
-            TRUE);
-
-        dwError = MemCacheRemoveObjectByHashKey(
-                        pConn,
-                        pConn->pSIDToSecurityObject,
-                        pszSid);
+        dwError = MemCacheEvictObject(pConn, pObject);
         BAIL_ON_LSA_ERROR(dwError);
     }
 
@@ -2648,15 +3428,47 @@ MemCacheStoreObjectEntryInLock(
     // Keep track of how much space is used to store the object (including hash
     // space)
     size_t sObjectSize = sizeof(*pObject) + HEAP_HEADER_SIZE;
+    // Do not free
+    PLW_DLINKED_LIST pExisting = NULL;
+    PLSA_SECURITY_OBJECT pExistingObject = NULL;
+    BOOLEAN bInLock = FALSE;
+    // Do not free
+    PLW_DLINKED_LIST existing[MEM_CACHE_MAX_OBJECT_KEYS] = { NULL };
+    size_t sExistingCount = 0;
+    size_t sIndex = 0;
 
     BAIL_ON_INVALID_STRING(pObject->pszNetbiosDomainName);
     BAIL_ON_INVALID_STRING(pObject->pszSamAccountName);
 
-    dwError = MemCacheClearExistingObjectKeys(
+    // A refreshed object keeps the reprieves it had
+    dwError = MemCacheIndexGetValue(
+                    pConn->pSIDToSecurityObject,
+                    pObject->pszObjectSid,
+                    (PVOID*)&pExisting);
+    if (dwError == ERROR_NOT_FOUND)
+    {
+        dwError = 0;
+    }
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (pExisting)
+    {
+        pExistingObject = (PLSA_SECURITY_OBJECT)pExisting->pItem;
+        if (pExistingObject->version.fWeight > pObject->version.fWeight)
+        {
+            pObject->version.fWeight = pExistingObject->version.fWeight;
+        }
+    }
+
+    dwError = MemCacheFindExistingObjects(
                     pConn,
-                    pObject);
+                    pObject,
+                    existing,
+                    &sExistingCount);
     BAIL_ON_LSA_ERROR(dwError);
 
+    ENTER_WRITER_RW_LOCK(&pConn->objectsLock, bInLock);
+
     // Afterwards pConn->pObjects points to the new node with pObject
     // inside. This node pointer will stored in the hash tables.
     dwError = LwDLinkedListPrepend(
@@ -2664,6 +3476,15 @@ MemCacheStoreObjectEntryInLock(
                     pObject);
     BAIL_ON_LSA_ERROR(dwError);
 
+    if (pConn->pObjects->pNext == NULL)
+    {
+        pConn->pObjectsTail = pConn->pObjects;
+    }
+    pConn->sObjectCount++;
+
+    LEAVE_RW_LOCK(&pConn->objectsLock, bInLock);
+    pConn->sInsertsSinceSweep++;
+
     sObjectSize += sizeof(*pConn->pObjects) + HEAP_HEADER_SIZE;
 
     if (pObject->pszDN != NULL)
@@ -2671,7 +3492,7 @@ MemCacheStoreObjectEntryInLock(
         sObjectSize += MemCacheGetStringSpace(pObject->pszDN);
 
         sObjectSize += HASH_ENTRY_SPACE;
-        dwError = LwHashSetValue(
+        dwError = MemCacheIndexSetValue(
                         pConn->pDNToSecurityObject,
                         pObject->pszDN,
                         pConn->pObjects);
@@ -2681,7 +3502,7 @@ MemCacheStoreObjectEntryInLock(
     LSA_ASSERT(pObject->pszObjectSid);
     sObjectSize += MemCacheGetStringSpace(pObject->pszObjectSid);
     sObjectSize += HASH_ENTRY_SPACE;
-    dwError = LwHashSetValue(
+    dwError = MemCacheIndexSetValue(
                     pConn->pSIDToSecurityObject,
                     pObject->pszObjectSid,
                     pConn->pObjects);
@@ -2701,7 +3522,7 @@ MemCacheStoreObjectEntryInLock(
 
     LSA_ASSERT(pszKey != NULL);
     sObjectSize += HASH_ENTRY_SPACE;
-    dwError = LwHashSetValue(
+    dwError = MemCacheIndexSetValue(
                     pConn->pNT4ToSecurityObject,
                     pszKey,
                     pConn->pObjects);
@@ -2715,7 +3536,7 @@ MemCacheStoreObjectEntryInLock(
             if (pObject->enabled)
             {
                 sObjectSize += HASH_ENTRY_SPACE;
-                dwError = LwHashSetValue(
+                dwError = MemCacheIndexSetValue(
                                 pConn->pGIDToSecurityObject,
                                 (PVOID)(size_t)pObject->groupInfo.gid,
                                 pConn->pObjects);
@@ -2725,7 +3546,7 @@ MemCacheStoreObjectEntryInLock(
                         pObject->groupInfo.pszAliasName[0])
                 {
                     sObjectSize += HASH_ENTRY_SPACE;
-                    dwError = LwHashSetValue(
+                    dwError = MemCacheIndexSetValue(
                                     pConn->pGroupAliasToSecurityObject,
                                     pObject->groupInfo.pszAliasName,
                                     pConn->pObjects);
@@ -2743,7 +3564,7 @@ MemCacheStoreObjectEntryInLock(
             if (pObject->enabled)
             {
                 sObjectSize += HASH_ENTRY_SPACE;
-                dwError = LwHashSetValue(
+                dwError = MemCacheIndexSetValue(
                                 pConn->pUIDToSecurityObject,
                                 (PVOID)(size_t)pObject->userInfo.uid,
                                 pConn->pObjects);
@@ -2754,7 +3575,7 @@ MemCacheStoreObjectEntryInLock(
                     sObjectSize += MemCacheGetStringSpace(
                             pObject->userInfo.pszAliasName);
                     sObjectSize += HASH_ENTRY_SPACE;
-                    dwError = LwHashSetValue(
+                    dwError = MemCacheIndexSetValue(
                                     pConn->pUserAliasToSecurityObject,
                                     pObject->userInfo.pszAliasName,
                                     pConn->pObjects);
@@ -2777,7 +3598,7 @@ MemCacheStoreObjectEntryInLock(
             {
                 sObjectSize += MemCacheGetStringSpace(pObject->userInfo.pszUPN);
                 sObjectSize += HASH_ENTRY_SPACE;
-                dwError = LwHashSetValue(
+                dwError = MemCacheIndexSetValue(
                                 pConn->pUPNToSecurityObject,
                                 pObject->userInfo.pszUPN,
                                 pConn->pObjects);
@@ -2799,7 +3620,19 @@ MemCacheStoreObjectEntryInLock(
 
     pConn->sCacheSize += sObjectSize;
 
+    // Readers only hold shard locks, so the objects being replaced are
+    // removed after the new one has taken over their keys. A lookup racing
+    // the store finds one or the other, never neither.
+    for (sIndex = 0; sIndex < sExistingCount; sIndex++)
+    {
+        dwError = MemCacheRemoveObjectEntry(
+                        pConn,
+                        existing[sIndex]);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
 cleanup:
+    LEAVE_RW_LOCK(&pConn->objectsLock, bInLock);
     LW_SAFE_FREE_STRING(pszKey);
 
     return dwError;
@@ -2872,6 +3705,9 @@ MemCacheAddMembership(
     PLSA_LIST_LINKS pGuardianTemp = NULL;
     PSTR pszSidCopy = NULL;
     size_t sObjectSize = sizeof(*pMembership) + HEAP_HEADER_SIZE;
+    // Do not free
+    PMEM_CACHE_SHARD pShard = NULL;
+    BOOLEAN bInLock = FALSE;
 
     sObjectSize += MemCacheGetStringSpace(pMembership->membership.pszParentSid);
     sObjectSize += MemCacheGetStringSpace(pMembership->membership.pszChildSid);
@@ -2885,7 +3721,7 @@ MemCacheAddMembership(
 
     pMembership->membership.version.dwObjectSize = sObjectSize;
 
-    dwError = LwHashGetValue(
+    dwError = MemCacheIndexGetValue(
                     pConn->pParentSIDToMembershipList,
                     pMembership->membership.pszParentSid,
                     (PVOID*)&pGuardian);
@@ -2906,7 +3742,7 @@ MemCacheAddMembership(
                         &pszSidCopy);
         BAIL_ON_LSA_ERROR(dwError);
 
-        dwError = LwHashSetValue(
+        dwError = MemCacheIndexSetValue(
                         pConn->pParentSIDToMembershipList,
                         pszSidCopy,
                         pGuardianTemp);
@@ -2923,11 +3759,16 @@ MemCacheAddMembership(
         BAIL_ON_LSA_ERROR(dwError);
     }
 
+    pShard = MemCacheIndexGetShard(
+                    pConn->pParentSIDToMembershipList,
+                    pMembership->membership.pszParentSid);
+    ENTER_WRITER_RW_LOCK(&pShard->lock, bInLock);
     LsaListInsertAfter(
         pGuardian,
         &pMembership->parentListNode);
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
 
-    dwError = LwHashGetValue(
+    dwError = MemCacheIndexGetValue(
                     pConn->pChildSIDToMembershipList,
                     pMembership->membership.pszChildSid,
                     (PVOID*)&pGuardian);
@@ -2948,7 +3789,7 @@ MemCacheAddMembership(
                         &pszSidCopy);
         BAIL_ON_LSA_ERROR(dwError);
 
-        dwError = LwHashSetValue(
+        dwError = MemCacheIndexSetValue(
                         pConn->pChildSIDToMembershipList,
                         pszSidCopy,
                         pGuardianTemp);
@@ -2965,11 +3806,18 @@ MemCacheAddMembership(
         BAIL_ON_LSA_ERROR(dwError);
     }
 
+    pShard = MemCacheIndexGetShard(
+                    pConn->pChildSIDToMembershipList,
+                    pMembership->membership.pszChildSid);
+    ENTER_WRITER_RW_LOCK(&pShard->lock, bInLock);
     LsaListInsertAfter(
             pGuardian,
             &pMembership->childListNode);
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
 
     pConn->sCacheSize += sObjectSize;
+    pConn->sMembershipCount++;
+    pConn->sInsertsSinceSweep++;
 
 cleanup:
     LW_SAFE_FREE_MEMORY(pGuardianTemp);
@@ -2992,7 +3840,7 @@ MemCacheRemoveMembershipsBySid(
     PLSA_LIST_LINKS pGuardian = NULL;
     BOOLEAN bListNonempty = FALSE;
     // Do not free
-    PLW_HASH_TABLE pIndex = NULL;
+    PMEM_CACHE_INDEX pIndex = NULL;
     // Do not free
     PMEM_GROUP_MEMBERSHIP pMembership = NULL;
     // Do not free
@@ -3010,7 +3858,7 @@ MemCacheRemoveMembershipsBySid(
 
     // Copy the existing pac and primary domain memberships to the temporary
     // hash table
-    dwError = LwHashGetValue(
+    dwError = MemCacheIndexGetValue(
                     pIndex,
                     pszSid,
                     (PVOID*)&pGuardian);
@@ -3143,21 +3991,21 @@ MemCacheStoreGroupMembership(
     }
 
     ENTER_MUTEX(&pConn->backupMutex, bMutexLocked);
-    ENTER_WRITER_RW_LOCK(&pConn->lock, bInLock);
+    ENTER_MUTEX(&pConn->lock, bInLock);
 
-    dwError = MemCacheEnsureHashSpace(
+    dwError = MemCacheIndexEnsureSpace(
                     pConn->pParentSIDToMembershipList,
                     sMemberCount);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = MemCacheEnsureHashSpace(
+    dwError = MemCacheIndexEnsureSpace(
                     pConn->pChildSIDToMembershipList,
                     sMemberCount);
     BAIL_ON_LSA_ERROR(dwError);
 
     // Copy the existing pac and primary domain memberships to the temporary
     // hash table
-    dwError = LwHashGetValue(
+    dwError = MemCacheIndexGetValue(
                     pConn->pParentSIDToMembershipList,
                     pszParentSid,
                     (PVOID*)&pGuardian);
@@ -3222,6 +4070,13 @@ MemCacheStoreGroupMembership(
         TRUE,
         FALSE);
 
+    MemCacheLogRemoval(
+        pConn,
+        MEM_CACHE_REMOVE_MEMBERSHIPS,
+        pszParentSid,
+        TRUE,
+        FALSE);
+
     // Copy the combined list into the parent and child hashes
     dwError = LwHashGetIterator(
                     pCombined,
@@ -3230,12 +4085,19 @@ MemCacheStoreGroupMembership(
 
     while ((pEntry = LwHashNext(&iterator)) != NULL)
     {
+        PMEM_GROUP_MEMBERSHIP pMember = (PMEM_GROUP_MEMBERSHIP)pEntry->pValue;
+
         dwError = MemCacheAddMembership(
                     pConn,
-                    (PMEM_GROUP_MEMBERSHIP)pEntry->pValue);
+                    pMember);
         BAIL_ON_LSA_ERROR(dwError);
 
         pEntry->pValue = NULL;
+
+        MemCacheLogMessage(
+            pConn,
+            MEM_CACHE_MEMBERSHIP,
+            &pMember->membership);
     }
 
     dwError = MemCacheMaintainSizeCap(pConn);
@@ -3246,7 +4108,7 @@ MemCacheStoreGroupMembership(
     BAIL_ON_LSA_ERROR(dwError);
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_MUTEX(&pConn->lock, bInLock);
     LEAVE_MUTEX(&pConn->backupMutex, bMutexLocked);
     LwHashSafeFree(&pCombined);
 
@@ -3320,19 +4182,19 @@ MemCacheStoreGroupsForUser(
     }
 
     ENTER_MUTEX(&pConn->backupMutex, bMutexLocked);
-    ENTER_WRITER_RW_LOCK(&pConn->lock, bInLock);
+    ENTER_MUTEX(&pConn->lock, bInLock);
 
-    dwError = MemCacheEnsureHashSpace(
+    dwError = MemCacheIndexEnsureSpace(
                     pConn->pParentSIDToMembershipList,
                     sMemberCount);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = MemCacheEnsureHashSpace(
+    dwError = MemCacheIndexEnsureSpace(
                     pConn->pChildSIDToMembershipList,
                     sMemberCount);
     BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = LwHashGetValue(
+    dwError = MemCacheIndexGetValue(
                     pConn->pParentSIDToMembershipList,
                     pszChildSid,
                     (PVOID*)&pGuardian);
@@ -3396,6 +4258,13 @@ MemCacheStoreGroupsForUser(
         FALSE,
         FALSE);
 
+    MemCacheLogRemoval(
+        pConn,
+        MEM_CACHE_REMOVE_MEMBERSHIPS,
+        pszChildSid,
+        FALSE,
+        FALSE);
+
     // Copy the combined list into the parent and child hashes
     dwError = LwHashGetIterator(
                     pCombined,
@@ -3417,7 +4286,30 @@ MemCacheStoreGroupsForUser(
         BAIL_ON_LSA_ERROR(dwError);
 
         pEntry->pValue = NULL;
+
+        MemCacheLogMessage(
+            pConn,
+            MEM_CACHE_MEMBERSHIP,
+            &pMember->membership);
+    }
+
+    // Groups of a user that has logged in get the same protection as the
+    // user
+    dwError = MemCacheIndexGetValue(
+                    pConn->pSIDToPasswordVerifier,
+                    pszChildSid,
+                    NULL);
+    if (dwError == ERROR_NOT_FOUND)
+    {
+        dwError = 0;
     }
+    else if (!dwError)
+    {
+        dwError = MemCacheProtectLoggedInUser(
+                        pConn,
+                        pszChildSid);
+    }
+    BAIL_ON_LSA_ERROR(dwError);
 
     dwError = MemCacheMaintainSizeCap(pConn);
     BAIL_ON_LSA_ERROR(dwError);
@@ -3427,7 +4319,7 @@ MemCacheStoreGroupsForUser(
     BAIL_ON_LSA_ERROR(dwError);
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_MUTEX(&pConn->lock, bInLock);
     LEAVE_MUTEX(&pConn->backupMutex, bMutexLocked);
     LwHashSafeFree(&pCombined);
 
@@ -3453,7 +4345,9 @@ MemCacheGetMemberships(
     PMEM_DB_CONNECTION pConn = (PMEM_DB_CONNECTION)hDb;
     BOOLEAN bInLock = FALSE;
     // Do not free
-    PLW_HASH_TABLE pIndex = NULL;
+    PMEM_CACHE_INDEX pIndex = NULL;
+    // Do not free
+    PMEM_CACHE_SHARD pShard = NULL;
     // Do not free
     PLSA_LIST_LINKS pGuardian = NULL;
     // Do not free
@@ -3463,8 +4357,6 @@ MemCacheGetMemberships(
     PMEM_GROUP_MEMBERSHIP pMembership = NULL;
     PLSA_GROUP_MEMBERSHIP* ppResults = NULL;
 
-    ENTER_READER_RW_LOCK(&pConn->lock, bInLock);
-
     if (bIsGroupMembers)
     {
         pIndex = pConn->pParentSIDToMembershipList;
@@ -3474,8 +4366,11 @@ MemCacheGetMemberships(
         pIndex = pConn->pChildSIDToMembershipList;
     }
 
+    pShard = MemCacheIndexGetShard(pIndex, pszSid);
+    ENTER_READER_RW_LOCK(&pShard->lock, bInLock);
+
     dwError = LwHashGetValue(
-                    pIndex,
+                    pShard->pTable,
                     pszSid,
                     (PVOID*)&pGuardian);
     if (dwError == ERROR_NOT_FOUND)
@@ -3549,7 +4444,7 @@ MemCacheGetMemberships(
     *psCount = sCount;
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
 
     return dwError;
 
@@ -3573,20 +4468,24 @@ MemCacheEnumUsersCache(
     // Do not free
     PMEM_DB_CONNECTION pConn = (PMEM_DB_CONNECTION)hDb;
     BOOLEAN bInLock = FALSE;
+    BOOLEAN bInShardLock = FALSE;
     PLSA_SECURITY_OBJECT* ppObjects = NULL;
     // Do not free
     PLSA_SECURITY_OBJECT pObject = NULL;
     // Do not free
-    PLW_HASH_TABLE pIndex = NULL;
+    PMEM_CACHE_INDEX pIndex = NULL;
+    // Do not free
+    PMEM_CACHE_SHARD pShard = NULL;
     // Do not free
     PLW_DLINKED_LIST pListEntry = NULL;
     DWORD dwOut = 0;
 
-    ENTER_READER_RW_LOCK(&pConn->lock, bInLock);
+    // Entries cannot be unlinked or freed while the list is locked
+    ENTER_READER_RW_LOCK(&pConn->objectsLock, bInLock);
 
     pIndex = pConn->pSIDToSecurityObject;
 
-    dwMaxNumUsers = LW_MIN(dwMaxNumUsers, pIndex->sCount);
+    dwMaxNumUsers = LW_MIN(dwMaxNumUsers, pConn->sObjectCount);
 
     dwError = LwAllocateMemory(
                     sizeof(*ppObjects) * dwMaxNumUsers,
@@ -3596,10 +4495,13 @@ MemCacheEnumUsersCache(
     if (pszResume)
     {
         // Start at one after the resume SID
+        pShard = MemCacheIndexGetShard(pIndex, pszResume);
+        ENTER_READER_RW_LOCK(&pShard->lock, bInShardLock);
         dwError = LwHashGetValue(
-                        pIndex,
+                        pShard->pTable,
                         pszResume,
                         (PVOID*)&pListEntry);
+        LEAVE_RW_LOCK(&pShard->lock, bInShardLock);
         if (dwError == ERROR_NOT_FOUND)
         {
             dwError = LW_ERROR_NOT_HANDLED;
@@ -3637,7 +4539,7 @@ MemCacheEnumUsersCache(
     *pdwNumUsersFound = dwOut;
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_RW_LOCK(&pConn->objectsLock, bInLock);
 
     return dwError;
 
@@ -3663,20 +4565,24 @@ MemCacheEnumGroupsCache(
     // Do not free
     PMEM_DB_CONNECTION pConn = (PMEM_DB_CONNECTION)hDb;
     BOOLEAN bInLock = FALSE;
+    BOOLEAN bInShardLock = FALSE;
     PLSA_SECURITY_OBJECT* ppObjects = NULL;
     // Do not free
     PLSA_SECURITY_OBJECT pObject = NULL;
     // Do not free
-    PLW_HASH_TABLE pIndex = NULL;
+    PMEM_CACHE_INDEX pIndex = NULL;
+    // Do not free
+    PMEM_CACHE_SHARD pShard = NULL;
     // Do not free
     PLW_DLINKED_LIST pListEntry = NULL;
     DWORD dwOut = 0;
 
-    ENTER_READER_RW_LOCK(&pConn->lock, bInLock);
+    // Entries cannot be unlinked or freed while the list is locked
+    ENTER_READER_RW_LOCK(&pConn->objectsLock, bInLock);
 
     pIndex = pConn->pSIDToSecurityObject;
 
-    dwMaxNumGroups = LW_MIN(dwMaxNumGroups, pIndex->sCount);
+    dwMaxNumGroups = LW_MIN(dwMaxNumGroups, pConn->sObjectCount);
 
     dwError = LwAllocateMemory(
                     sizeof(*ppObjects) * dwMaxNumGroups,
@@ -3686,10 +4592,13 @@ MemCacheEnumGroupsCache(
     if (pszResume)
     {
         // Start at one after the resume SID
+        pShard = MemCacheIndexGetShard(pIndex, pszResume);
+        ENTER_READER_RW_LOCK(&pShard->lock, bInShardLock);
         dwError = LwHashGetValue(
-                        pIndex,
+                        pShard->pTable,
                         pszResume,
                         (PVOID*)&pListEntry);
+        LEAVE_RW_LOCK(&pShard->lock, bInShardLock);
         if (dwError == ERROR_NOT_FOUND)
         {
             dwError = LW_ERROR_NOT_HANDLED;
@@ -3727,7 +4636,7 @@ MemCacheEnumGroupsCache(
     *pdwNumGroupsFound = dwOut;
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_RW_LOCK(&pConn->objectsLock, bInLock);
 
     return dwError;
 
@@ -3754,16 +4663,19 @@ MemCacheFindObjectByDN(
     BOOLEAN bInLock = FALSE;
     PLSA_SECURITY_OBJECT pObject = NULL;
     // Do not free
-    PLW_HASH_TABLE pIndex = NULL;
+    PMEM_CACHE_INDEX pIndex = NULL;
+    // Do not free
+    PMEM_CACHE_SHARD pShard = NULL;
     // Do not free
     PLW_DLINKED_LIST pListEntry = NULL;
 
-    ENTER_READER_RW_LOCK(&pConn->lock, bInLock);
-
     pIndex = pConn->pDNToSecurityObject;
 
+    pShard = MemCacheIndexGetShard(pIndex, pszDN);
+    ENTER_READER_RW_LOCK(&pShard->lock, bInLock);
+
     dwError = LwHashGetValue(
-                    pIndex,
+                    pShard->pTable,
                     pszDN,
                     (PVOID*)&pListEntry);
     if (dwError == ERROR_NOT_FOUND)
@@ -3780,7 +4692,7 @@ MemCacheFindObjectByDN(
     *ppObject = pObject;
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
 
     return dwError;
 
@@ -3845,16 +4757,19 @@ MemCacheFindObjectBySid(
     BOOLEAN bInLock = FALSE;
     PLSA_SECURITY_OBJECT pObject = NULL;
     // Do not free
-    PLW_HASH_TABLE pIndex = NULL;
+    PMEM_CACHE_INDEX pIndex = NULL;
+    // Do not free
+    PMEM_CACHE_SHARD pShard = NULL;
     // Do not free
     PLW_DLINKED_LIST pListEntry = NULL;
 
-    ENTER_READER_RW_LOCK(&pConn->lock, bInLock);
-
     pIndex = pConn->pSIDToSecurityObject;
 
+    pShard = MemCacheIndexGetShard(pIndex, pszSid);
+    ENTER_READER_RW_LOCK(&pShard->lock, bInLock);
+
     dwError = LwHashGetValue(
-                    pIndex,
+                    pShard->pTable,
                     pszSid,
                     (PVOID*)&pListEntry);
     if (dwError == ERROR_NOT_FOUND)
@@ -3871,7 +4786,7 @@ MemCacheFindObjectBySid(
     *ppObject = pObject;
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
 
     return dwError;
 
@@ -3941,14 +4856,17 @@ MemCacheGetPasswordVerifier(
     // Do not free
     PLSA_PASSWORD_VERIFIER pFromHash = NULL;
     // Do not free
-    PLW_HASH_TABLE pIndex = NULL;
-
-    ENTER_READER_RW_LOCK(&pConn->lock, bInLock);
+    PMEM_CACHE_INDEX pIndex = NULL;
+    // Do not free
+    PMEM_CACHE_SHARD pShard = NULL;
 
     pIndex = pConn->pSIDToPasswordVerifier;
 
+    pShard = MemCacheIndexGetShard(pIndex, pszUserSid);
+    ENTER_READER_RW_LOCK(&pShard->lock, bInLock);
+
     dwError = LwHashGetValue(
-                    pIndex,
+                    pShard->pTable,
                     pszUserSid,
                     (PVOID*)&pFromHash);
     if (dwError == ERROR_NOT_FOUND)
@@ -3965,7 +4883,7 @@ MemCacheGetPasswordVerifier(
     *ppResult = pResult;
 
 cleanup:
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
 
     return dwError;
 
@@ -3987,7 +4905,7 @@ MemCacheStorePasswordVerifier(
     BOOLEAN bInLock = FALSE;
     PLSA_PASSWORD_VERIFIER pCopy = NULL;
     // Do not free
-    PLW_HASH_TABLE pIndex = NULL;
+    PMEM_CACHE_INDEX pIndex = NULL;
     // Do not free
     PLSA_PASSWORD_VERIFIER pFromHash = NULL;
     BOOLEAN bMutexLocked = FALSE;
@@ -3995,11 +4913,11 @@ MemCacheStorePasswordVerifier(
     size_t sOldObjectSize = 0;
 
     ENTER_MUTEX(&pConn->backupMutex, bMutexLocked);
-    ENTER_WRITER_RW_LOCK(&pConn->lock, bInLock);
+    ENTER_MUTEX(&pConn->lock, bInLock);
 
     pIndex = pConn->pSIDToPasswordVerifier;
 
-    dwError = LwHashGetValue(
+    dwError = MemCacheIndexGetValue(
                     pIndex,
                     pVerifier->pszObjectSid,
                     (PVOID*)&pFromHash);
@@ -4025,17 +4943,25 @@ MemCacheStorePasswordVerifier(
 
     pCopy->version.dwObjectSize = sObjectSize;
 
-    dwError = LwHashSetValue(
+    dwError = MemCacheIndexSetValue(
                     pIndex,
                     pCopy->pszObjectSid,
                     pCopy);
     BAIL_ON_LSA_ERROR(dwError);
+
+    MemCacheLogMessage(pConn, MEM_CACHE_PASSWORD, pCopy);
+
     // This is now owned by the hash
     pCopy = NULL;
 
     pConn->sCacheSize -= sOldObjectSize;
     pConn->sCacheSize += sObjectSize;
 
+    dwError = MemCacheProtectLoggedInUser(
+                    pConn,
+                    pVerifier->pszObjectSid);
+    BAIL_ON_LSA_ERROR(dwError);
+
     dwError = MemCacheMaintainSizeCap(pConn);
     BAIL_ON_LSA_ERROR(dwError);
 
@@ -4045,7 +4971,7 @@ MemCacheStorePasswordVerifier(
 
 cleanup:
     LSA_DB_SAFE_FREE_PASSWORD_VERIFIER(pCopy);
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_MUTEX(&pConn->lock, bInLock);
     LEAVE_MUTEX(&pConn->backupMutex, bMutexLocked);
 
     return dwError;
@@ -4064,11 +4990,11 @@ MemCacheSetSizeCap(
     PMEM_DB_CONNECTION pConn = (PMEM_DB_CONNECTION)hDb;
     BOOLEAN bInLock = FALSE;
 
-    ENTER_WRITER_RW_LOCK(&pConn->lock, bInLock);
+    ENTER_MUTEX(&pConn->lock, bInLock);
 
     pConn->sSizeCap = sMemoryCap;
 
-    LEAVE_RW_LOCK(&pConn->lock, bInLock);
+    LEAVE_MUTEX(&pConn->lock, bInLock);
 
     return 0;
 }
@@ -0,0 +1,364 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright Likewise Software    2004-2008
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.  You should have received a copy of the GNU General
+ * Public License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        memcache_index.c
+ *
+ * Abstract:
+ *
+ *        Sharded hash indexes used by the in-memory AD Provider Local Cache
+ *
+ */
+
+#include "adprovider.h"
+
+static
+DWORD
+MemCacheIndexGetShardNumber(
+    IN PMEM_CACHE_INDEX pIndex,
+    IN PCVOID pKey
+    )
+{
+    // The hash tables pick their bucket from the low bits of the same hash
+    // value, so scramble it before taking the shard number from the high bits.
+    // Otherwise every key in a shard would land in the same few buckets.
+    UINT32 dwHash = (UINT32)pIndex->fnHash(pKey);
+
+    return (dwHash * 2654435761U) >> (32 - MEM_CACHE_SHARD_BITS);
+}
+
+DWORD
+MemCacheIndexCreate(
+    IN size_t sTableSize,
+    IN LW_HASH_KEY_COMPARE fnComparator,
+    IN LW_HASH_KEY fnHash,
+    IN OPTIONAL LW_HASH_FREE_ENTRY fnFree,
+    IN OPTIONAL LW_HASH_COPY_ENTRY fnCopy,
+    OUT PMEM_CACHE_INDEX* ppIndex
+    )
+{
+    DWORD dwError = 0;
+    PMEM_CACHE_INDEX pIndex = NULL;
+    DWORD dwShard = 0;
+
+    dwError = LwAllocateMemory(
+                    sizeof(*pIndex),
+                    (PVOID*)&pIndex);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pIndex->fnHash = fnHash;
+
+    for (dwShard = 0; dwShard < MEM_CACHE_SHARD_COUNT; dwShard++)
+    {
+        dwError = LwMapErrnoToLwError(pthread_rwlock_init(
+                        &pIndex->shards[dwShard].lock,
+                        NULL));
+        BAIL_ON_LSA_ERROR(dwError);
+        pIndex->shards[dwShard].bLockCreated = TRUE;
+
+        dwError = LwHashCreate(
+                        sTableSize / MEM_CACHE_SHARD_COUNT + 1,
+                        fnComparator,
+                        fnHash,
+                        fnFree,
+                        fnCopy,
+                        &pIndex->shards[dwShard].pTable);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    *ppIndex = pIndex;
+
+cleanup:
+    return dwError;
+
+error:
+    MemCacheIndexSafeFree(&pIndex);
+    *ppIndex = NULL;
+    goto cleanup;
+}
+
+VOID
+MemCacheIndexSafeFree(
+    IN OUT PMEM_CACHE_INDEX* ppIndex
+    )
+{
+    PMEM_CACHE_INDEX pIndex = *ppIndex;
+    DWORD dwShard = 0;
+    DWORD dwError = 0;
+
+    if (pIndex)
+    {
+        for (dwShard = 0; dwShard < MEM_CACHE_SHARD_COUNT; dwShard++)
+        {
+            LwHashSafeFree(&pIndex->shards[dwShard].pTable);
+
+            if (pIndex->shards[dwShard].bLockCreated)
+            {
+                dwError = LwMapErrnoToLwError(pthread_rwlock_destroy(
+                                &pIndex->shards[dwShard].lock));
+                LSA_ASSERT(dwError == 0);
+            }
+        }
+
+        LW_SAFE_FREE_MEMORY(pIndex);
+        *ppIndex = NULL;
+    }
+}
+
+PMEM_CACHE_SHARD
+MemCacheIndexGetShard(
+    IN PMEM_CACHE_INDEX pIndex,
+    IN PCVOID pKey
+    )
+{
+    return &pIndex->shards[MemCacheIndexGetShardNumber(pIndex, pKey)];
+}
+
+// Only exact when called by a writer
+size_t
+MemCacheIndexGetKeyCount(
+    IN PMEM_CACHE_INDEX pIndex
+    )
+{
+    size_t sCount = 0;
+    DWORD dwShard = 0;
+
+    for (dwShard = 0; dwShard < MEM_CACHE_SHARD_COUNT; dwShard++)
+    {
+        sCount += pIndex->shards[dwShard].pTable->sCount;
+    }
+
+    return sCount;
+}
+
+// The caller must either be a writer or hold the read lock of the shard that
+// pKey maps to
+DWORD
+MemCacheIndexGetValue(
+    IN PMEM_CACHE_INDEX pIndex,
+    IN PCVOID pKey,
+    OUT OPTIONAL PVOID* ppValue
+    )
+{
+    return LwHashGetValue(
+                MemCacheIndexGetShard(pIndex, pKey)->pTable,
+                pKey,
+                ppValue);
+}
+
+DWORD
+MemCacheIndexSetValue(
+    IN PMEM_CACHE_INDEX pIndex,
+    IN PVOID pKey,
+    IN PVOID pValue
+    )
+{
+    DWORD dwError = 0;
+    PMEM_CACHE_SHARD pShard = MemCacheIndexGetShard(pIndex, pKey);
+    BOOLEAN bInLock = FALSE;
+
+    ENTER_WRITER_RW_LOCK(&pShard->lock, bInLock);
+
+    // Callers that store many entries at once size the tables up front with
+    // MemCacheIndexEnsureSpace. Loading the cache file stores one entry at a
+    // time, so keep the chains short here as well.
+    if ((pShard->pTable->sCount + 1) * 2 > pShard->pTable->sTableSize)
+    {
+        dwError = LwHashResize(
+            pShard->pTable,
+            (pShard->pTable->sCount + 10) * 3);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    dwError = LwHashSetValue(
+                    pShard->pTable,
+                    pKey,
+                    pValue);
+    BAIL_ON_LSA_ERROR(dwError);
+
+cleanup:
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
+
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+DWORD
+MemCacheIndexRemoveKey(
+    IN PMEM_CACHE_INDEX pIndex,
+    IN PVOID pKey
+    )
+{
+    DWORD dwError = 0;
+    PMEM_CACHE_SHARD pShard = MemCacheIndexGetShard(pIndex, pKey);
+    BOOLEAN bInLock = FALSE;
+
+    ENTER_WRITER_RW_LOCK(&pShard->lock, bInLock);
+
+    dwError = LwHashRemoveKey(
+                    pShard->pTable,
+                    pKey);
+
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
+
+    return dwError;
+}
+
+// Removes the key only if it still maps to pValue, and not if it has since
+// been pointed at another object
+DWORD
+MemCacheIndexRemoveKeyIfValue(
+    IN PMEM_CACHE_INDEX pIndex,
+    IN PVOID pKey,
+    IN PVOID pValue
+    )
+{
+    DWORD dwError = 0;
+    PMEM_CACHE_SHARD pShard = MemCacheIndexGetShard(pIndex, pKey);
+    BOOLEAN bInLock = FALSE;
+    PVOID pCurrent = NULL;
+
+    ENTER_WRITER_RW_LOCK(&pShard->lock, bInLock);
+
+    dwError = LwHashGetValue(
+                    pShard->pTable,
+                    pKey,
+                    &pCurrent);
+    if (dwError == ERROR_NOT_FOUND)
+    {
+        dwError = 0;
+    }
+    else if (dwError == 0 && pCurrent == pValue)
+    {
+        dwError = LwHashRemoveKey(
+                        pShard->pTable,
+                        pKey);
+    }
+
+    LEAVE_RW_LOCK(&pShard->lock, bInLock);
+
+    return dwError;
+}
+
+VOID
+MemCacheIndexRemoveAll(
+    IN PMEM_CACHE_INDEX pIndex
+    )
+{
+    DWORD dwShard = 0;
+    BOOLEAN bInLock = FALSE;
+
+    for (dwShard = 0; dwShard < MEM_CACHE_SHARD_COUNT; dwShard++)
+    {
+        ENTER_WRITER_RW_LOCK(&pIndex->shards[dwShard].lock, bInLock);
+        LwHashRemoveAll(pIndex->shards[dwShard].pTable);
+        LEAVE_RW_LOCK(&pIndex->shards[dwShard].lock, bInLock);
+    }
+}
+
+DWORD
+MemCacheIndexEnsureSpace(
+    IN PMEM_CACHE_INDEX pIndex,
+    IN size_t sNewEntries
+    )
+{
+    DWORD dwError = 0;
+    DWORD dwShard = 0;
+    BOOLEAN bInLock = FALSE;
+    // Do not free
+    PLW_HASH_TABLE pTable = NULL;
+
+    // Assume the new entries are spread evenly over the shards
+    sNewEntries = sNewEntries / MEM_CACHE_SHARD_COUNT + 1;
+
+    for (dwShard = 0; dwShard < MEM_CACHE_SHARD_COUNT; dwShard++)
+    {
+        pTable = pIndex->shards[dwShard].pTable;
+
+        if ((pTable->sCount + sNewEntries) * 2 > pTable->sTableSize)
+        {
+            ENTER_WRITER_RW_LOCK(&pIndex->shards[dwShard].lock, bInLock);
+            dwError = LwHashResize(
+                pTable,
+                (pTable->sCount + sNewEntries + 10) * 3);
+            LEAVE_RW_LOCK(&pIndex->shards[dwShard].lock, bInLock);
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+    }
+
+cleanup:
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+// The iterator stays valid if the entry it last returned is removed.
+// Resetting inner.pEntryPos to NULL makes it safe after removing any other
+// entry, at the cost of skipping the rest of the current bucket.
+DWORD
+MemCacheIndexGetIterator(
+    IN PMEM_CACHE_INDEX pIndex,
+    OUT PMEM_CACHE_INDEX_ITERATOR pIterator
+    )
+{
+    pIterator->pIndex = pIndex;
+    pIterator->dwShard = 0;
+
+    return LwHashGetIterator(
+                pIndex->shards[0].pTable,
+                &pIterator->inner);
+}
+
+// returns NULL after passing the last entry
+LW_HASH_ENTRY *
+MemCacheIndexNext(
+    IN OUT PMEM_CACHE_INDEX_ITERATOR pIterator
+    )
+{
+    LW_HASH_ENTRY *pEntry = NULL;
+
+    while ((pEntry = LwHashNext(&pIterator->inner)) == NULL &&
+            pIterator->dwShard + 1 < MEM_CACHE_SHARD_COUNT)
+    {
+        pIterator->dwShard++;
+        LwHashGetIterator(
+            pIterator->pIndex->shards[pIterator->dwShard].pTable,
+            &pIterator->inner);
+    }
+
+    return pEntry;
+}
@@ -100,12 +100,14 @@ typedef struct _MEM_GROUP_MEMBERSHIP
                             HEAP_HEADER_SIZE + \
                             2 * sizeof(LW_HASH_ENTRY *))
 
-// A user who has logged in must be this old before it can be evicted by a 0
-// second object
+// A user who has logged in (and the groups it belongs to) must be this old
+// before it can be evicted ahead of objects that nobody has logged in as
 #define LOGGED_IN_VS_ZERO_SEC (30 * 24 * 60 * 60)
 
-// A user who has logged in must be LOGGED_IN_VS_ZERO*2 seconds old before it can be evicted by a LOGGED_IN_VS_NSEC old object.
-#define LOGGED_IN_VS_NSEC 5
+// How many times a logged in user (or one of its groups) is sent back to the
+// front of the eviction queue instead of being evicted. This is stored in
+// version.fWeight of the cached object.
+#define LOGGED_IN_REPRIEVE_COUNT 2
 
 // This many logged in users cannot be evicted by non-logged in users, no
 // matter how old the entries are
@@ -113,11 +115,49 @@ typedef struct _MEM_GROUP_MEMBERSHIP
 
 #define BACKUP_DELAY (5 * 60)
 
+// When the log is enabled, the backup thread only folds the log into the
+// snapshot once it holds this many records (or on shutdown)
+#define MEM_CACHE_LOG_COMPACT_RECORDS 10000
 
-typedef struct _MEM_DB_CONNECTION
+// Every index is split into this many hash tables, each with its own lock, so
+// that a lookup only waits for writers that change the same shard
+#define MEM_CACHE_SHARD_BITS 4
+#define MEM_CACHE_SHARD_COUNT (1 << MEM_CACHE_SHARD_BITS)
+
+// An object is indexed by at most its DN, NT4 name, SID, UID or GID, alias
+// and UPN, so storing it replaces at most this many others
+#define MEM_CACHE_MAX_OBJECT_KEYS 6
+
+typedef struct _MEM_CACHE_SHARD
 {
     BOOLEAN bLockCreated;
     pthread_rwlock_t lock;
+    PLW_HASH_TABLE pTable;
+} MEM_CACHE_SHARD, *PMEM_CACHE_SHARD;
+
+// Readers hold the read lock of the one shard they search until they have
+// copied what they found. Writers are serialized by the connection lock, so
+// they may search any shard without locking it, and only take a shard's write
+// lock while they change it.
+typedef struct _MEM_CACHE_INDEX
+{
+    LW_HASH_KEY fnHash;
+    MEM_CACHE_SHARD shards[MEM_CACHE_SHARD_COUNT];
+} MEM_CACHE_INDEX, *PMEM_CACHE_INDEX;
+
+// Only usable by writers
+typedef struct _MEM_CACHE_INDEX_ITERATOR
+{
+    PMEM_CACHE_INDEX pIndex;
+    DWORD dwShard;
+    LW_HASH_ITERATOR inner;
+} MEM_CACHE_INDEX_ITERATOR, *PMEM_CACHE_INDEX_ITERATOR;
+
+typedef struct _MEM_DB_CONNECTION
+{
+    BOOLEAN bLockCreated;
+    // Serializes everything that modifies the cache. Lookups do not take it.
+    pthread_mutex_t lock;
     PLSA_AD_PROVIDER_STATE pProviderState;
 
     pthread_mutex_t backupMutex;
@@ -134,37 +174,140 @@ typedef struct _MEM_DB_CONNECTION
 
     PSTR pszFilename;
 
+    // When set, every change is appended to "<pszFilename>.log" as it is
+    // stored, and the backup thread rebuilds the snapshot in pszFilename from
+    // the previous snapshot and the log instead of from the live cache.
+    BOOLEAN bLogEnabled;
+    // Protected by lock. pLog is NULL if appending to the log failed, in
+    // which case the next backup writes the live cache out in full.
+    LWMsgProtocol* pLogProtocol;
+    LWMsgArchive* pLog;
+    size_t sLogRecords;
+
     size_t sCacheSize;
     size_t sSizeCap;
 
     //linked lists
-    // pItem is of type PLSA_SECURITY_OBJECT
+    // pItem is of type PLSA_SECURITY_OBJECT. New and refreshed objects are
+    // added at the head, and eviction starts at the tail.
     PLW_DLINKED_LIST pObjects;
+    PLW_DLINKED_LIST pObjectsTail;
+    size_t sObjectCount;
+    // Writers hold this for writing while they link or unlink list entries.
+    // Enumerations hold it for reading while they walk the list.
+    BOOLEAN bObjectsLockCreated;
+    pthread_rwlock_t objectsLock;
+
+    // Sids of the most recently logged in users, which are never evicted
+    // before other objects. Used as a ring.
+    PSTR pszPinnedSids[PINNED_USER_COUNT];
+    DWORD dwNextPinnedSid;
+
+    size_t sMembershipCount;
+    // Orphaned memberships and password verifiers are only swept once there
+    // have been as many inserts as there are entries to look at, so the sweep
+    // costs O(1) per insert on average
+    size_t sInsertsSinceSweep;
 
     //indexes
-    PLW_HASH_TABLE pDNToSecurityObject;
-    PLW_HASH_TABLE pNT4ToSecurityObject;
-    PLW_HASH_TABLE pSIDToSecurityObject;
+    PMEM_CACHE_INDEX pDNToSecurityObject;
+    PMEM_CACHE_INDEX pNT4ToSecurityObject;
+    PMEM_CACHE_INDEX pSIDToSecurityObject;
 
-    PLW_HASH_TABLE pUIDToSecurityObject;
-    PLW_HASH_TABLE pUserAliasToSecurityObject;
-    PLW_HASH_TABLE pUPNToSecurityObject;
+    PMEM_CACHE_INDEX pUIDToSecurityObject;
+    PMEM_CACHE_INDEX pUserAliasToSecurityObject;
+    PMEM_CACHE_INDEX pUPNToSecurityObject;
 
-    PLW_HASH_TABLE pSIDToPasswordVerifier;
+    PMEM_CACHE_INDEX pSIDToPasswordVerifier;
 
-    PLW_HASH_TABLE pGIDToSecurityObject;
-    PLW_HASH_TABLE pGroupAliasToSecurityObject;
+    PMEM_CACHE_INDEX pGIDToSecurityObject;
+    PMEM_CACHE_INDEX pGroupAliasToSecurityObject;
 
     // Points to a guardian LSA_LIST_LINKS. The rest of the linked list points
     // to LSA_LIST_LINKS from the parentListNode field in MEM_GROUP_MEMBERSHIP
     // objects.
-    PLW_HASH_TABLE pParentSIDToMembershipList;
+    PMEM_CACHE_INDEX pParentSIDToMembershipList;
     // Points to a guardian LSA_LIST_LINKS. The rest of the linked list points
     // to LSA_LIST_LINKS from the childListNode field in MEM_GROUP_MEMBERSHIP
     // objects.
-    PLW_HASH_TABLE pChildSIDToMembershipList;
+    PMEM_CACHE_INDEX pChildSIDToMembershipList;
 } MEM_DB_CONNECTION, *PMEM_DB_CONNECTION;
 
+DWORD
+MemCacheIndexCreate(
+    IN size_t sTableSize,
+    IN LW_HASH_KEY_COMPARE fnComparator,
+    IN LW_HASH_KEY fnHash,
+    IN OPTIONAL LW_HASH_FREE_ENTRY fnFree,
+    IN OPTIONAL LW_HASH_COPY_ENTRY fnCopy,
+    OUT PMEM_CACHE_INDEX* ppIndex
+    );
+
+VOID
+MemCacheIndexSafeFree(
+    IN OUT PMEM_CACHE_INDEX* ppIndex
+    );
+
+PMEM_CACHE_SHARD
+MemCacheIndexGetShard(
+    IN PMEM_CACHE_INDEX pIndex,
+    IN PCVOID pKey
+    );
+
+size_t
+MemCacheIndexGetKeyCount(
+    IN PMEM_CACHE_INDEX pIndex
+    );
+
+DWORD
+MemCacheIndexGetValue(
+    IN PMEM_CACHE_INDEX pIndex,
+    IN PCVOID pKey,
+    OUT OPTIONAL PVOID* ppValue
+    );
+
+DWORD
+MemCacheIndexSetValue(
+    IN PMEM_CACHE_INDEX pIndex,
+    IN PVOID pKey,
+    IN PVOID pValue
+    );
+
+DWORD
+MemCacheIndexRemoveKey(
+    IN PMEM_CACHE_INDEX pIndex,
+    IN PVOID pKey
+    );
+
+DWORD
+MemCacheIndexRemoveKeyIfValue(
+    IN PMEM_CACHE_INDEX pIndex,
+    IN PVOID pKey,
+    IN PVOID pValue
+    );
+
+VOID
+MemCacheIndexRemoveAll(
+    IN PMEM_CACHE_INDEX pIndex
+    );
+
+DWORD
+MemCacheIndexEnsureSpace(
+    IN PMEM_CACHE_INDEX pIndex,
+    IN size_t sNewEntries
+    );
+
+DWORD
+MemCacheIndexGetIterator(
+    IN PMEM_CACHE_INDEX pIndex,
+    OUT PMEM_CACHE_INDEX_ITERATOR pIterator
+    );
+
+LW_HASH_ENTRY *
+MemCacheIndexNext(
+    IN OUT PMEM_CACHE_INDEX_ITERATOR pIterator
+    );
+
 void
 InitializeMemCacheProvider(
     OUT PADCACHE_PROVIDER_FUNCTION_TABLE pCacheTable
@@ -262,20 +405,22 @@ MemCacheEmptyCache(
 DWORD
 MemCacheRemoveObjectByHashKey(
     IN PMEM_DB_CONNECTION pConn,
-    IN OUT PLW_HASH_TABLE pTable,
+    IN OUT PMEM_CACHE_INDEX pTable,
     IN const void* pvKey
     );
 
 DWORD
-MemCacheClearExistingObjectKeys(
+MemCacheRemoveObjectEntry(
     IN PMEM_DB_CONNECTION pConn,
-    IN PLSA_SECURITY_OBJECT pObject
+    IN PLW_DLINKED_LIST pListEntry
     );
 
 DWORD
-MemCacheEnsureHashSpace(
-    IN OUT PLW_HASH_TABLE pTable,
-    IN size_t sNewEntries
+MemCacheFindExistingObjects(
+    IN PMEM_DB_CONNECTION pConn,
+    IN PLSA_SECURITY_OBJECT pObject,
+    OUT PLW_DLINKED_LIST* ppExisting,
+    OUT size_t* psExistingCount
     );
 
 DWORD
@@ -298,26 +443,21 @@ MemCacheFindMembership(
     );
 
 VOID
-MemCacheResetWeight(
-    IN PVOID pData,
-    IN PVOID pNow
-    );
-
-VOID
-MemCacheMergeLists(
-    IN OUT PLW_DLINKED_LIST pList1,
-    IN OUT PLW_DLINKED_LIST pList2,
-    IN OUT PLW_DLINKED_LIST pList2End
+MemCacheMoveObjectToFront(
+    IN PMEM_DB_CONNECTION pConn,
+    IN PLW_DLINKED_LIST pListEntry
     );
 
-PLW_DLINKED_LIST
-MemCacheFindOutOfOrderNode(
-    IN PLW_DLINKED_LIST pList
+DWORD
+MemCacheProtectLoggedInUser(
+    IN PMEM_DB_CONNECTION pConn,
+    IN PCSTR pszSid
     );
 
-VOID
-MemCacheSortObjectList(
-    IN OUT PLW_DLINKED_LIST* ppObjects
+BOOLEAN
+MemCacheIsPinnedObject(
+    IN PMEM_DB_CONNECTION pConn,
+    IN PLSA_SECURITY_OBJECT pObject
     );
 
 DWORD
@@ -325,15 +465,15 @@ MemCacheRemoveOrphanedMemberships(
     IN PMEM_DB_CONNECTION pConn
     );
 
-VOID
-MemCacheAddPinnedObject(
-    IN OUT PLSA_SECURITY_OBJECT pPinnedObjects[PINNED_USER_COUNT],
-    IN PLSA_SECURITY_OBJECT pObject
+DWORD
+MemCacheRemoveOrphanedPasswordVerifiers(
+    IN PMEM_DB_CONNECTION pConn
     );
 
 DWORD
-MemCacheMaintainSizeCap(
-    IN PMEM_DB_CONNECTION pConn
+MemCacheEvictObject(
+    IN PMEM_DB_CONNECTION pConn,
+    IN PLSA_SECURITY_OBJECT pObject
     );
 
 DWORD
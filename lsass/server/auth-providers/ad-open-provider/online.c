@@ -4008,10 +4008,17 @@ AD_OnlineFindObjectsById(
     PLSA_SECURITY_OBJECT pCachedUser = NULL;
     DWORD dwIndex = 0;
     PLSA_SECURITY_OBJECT* ppObjects = NULL;
+    // Objects fetched from AD, which are cached together at the end.
+    // Do not free the entries, they are also in ppObjects.
+    PLSA_SECURITY_OBJECT* ppDownloaded = NULL;
+    DWORD dwDownloadedCount = 0;
 
     dwError = LwAllocateMemory(sizeof(*ppObjects) * dwCount, OUT_PPVOID(&ppObjects));
     BAIL_ON_LSA_ERROR(dwError);
 
+    dwError = LwAllocateMemory(sizeof(*ppDownloaded) * dwCount, OUT_PPVOID(&ppDownloaded));
+    BAIL_ON_LSA_ERROR(dwError);
+
     for (dwIndex = 0; dwIndex < dwCount; dwIndex++)
     {
         switch(ObjectType)
@@ -4058,11 +4065,7 @@ AD_OnlineFindObjectsById(
             switch (dwError)
             {
             case LW_ERROR_SUCCESS:
-                dwError = ADCacheStoreObjectEntry(
-                    pContext->pState->hCacheConnection,
-                    pCachedUser);
-                BAIL_ON_LSA_ERROR(dwError);
-                
+                ppDownloaded[dwDownloadedCount++] = pCachedUser;
                 ppObjects[dwIndex] = pCachedUser;
                 pCachedUser = NULL;
                 break;
@@ -4081,10 +4084,22 @@ AD_OnlineFindObjectsById(
         }
     }
 
+    if (dwDownloadedCount)
+    {
+        // One store, so that the sqlite cache commits a single transaction
+        dwError = ADCacheStoreObjectEntries(
+                        pContext->pState->hCacheConnection,
+                        dwDownloadedCount,
+                        ppDownloaded);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
     *pppObjects = ppObjects;
 
 cleanup:
 
+    LW_SAFE_FREE_MEMORY(ppDownloaded);
+
     return dwError;
 
 error:
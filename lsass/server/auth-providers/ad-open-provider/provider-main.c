@@ -768,6 +768,8 @@ LsaAdProviderStateDestroy(
             AD_NetDestroySchannelState(pState->hSchannelState);
         }
 
+        LwRtlFreeThreadPool(&pState->pThreadPool);
+
         LW_SAFE_FREE_STRING(pState->MachineCreds.pszCachePath);
         LW_SAFE_FREE_STRING(pState->pszUserGroupCachePath);
         LW_SAFE_FREE_STRING(pState->pszDomainSID);
@@ -864,6 +866,10 @@ LsaAdProviderStateCreate(
     dwError = AD_NetCreateSchannelState(&pState->hSchannelState);
     BAIL_ON_LSA_ERROR(dwError);
 
+    dwError = LwNtStatusToWin32Error(
+                    LwRtlCreateThreadPool(&pState->pThreadPool, NULL));
+    BAIL_ON_LSA_ERROR(dwError);
+
     dwError = AD_InitializeConfig(&config);
     BAIL_ON_LSA_ERROR(dwError);
 
@@ -2195,6 +2201,9 @@ AD_RemoveUserByNameFromCache(
                   ppObjects[0]->pszObjectSid);
     BAIL_ON_LSA_ERROR(dwError);
 
+    /* Drop anything already handed out to the nsswitch modules */
+    LsaSrvFlushSystemCache();
+
 cleanup:
     LsaUtilFreeSecurityObjectList(1, ppObjects);
     AD_ClearProviderState(pContext);
@@ -2267,6 +2276,9 @@ AD_RemoveUserByIdFromCache(
                   ppObjects[0]->pszObjectSid);
     BAIL_ON_LSA_ERROR(dwError);
 
+    /* Drop anything already handed out to the nsswitch modules */
+    LsaSrvFlushSystemCache();
+
 cleanup:
     LsaUtilFreeSecurityObjectList(1, ppObjects);
     AD_ClearProviderState(pContext);
@@ -3374,6 +3386,9 @@ AD_RemoveGroupByNameFromCache(
                   ppObjects[0]->pszObjectSid);
     BAIL_ON_LSA_ERROR(dwError);
 
+    /* Drop anything already handed out to the nsswitch modules */
+    LsaSrvFlushSystemCache();
+
 cleanup:
     LsaUtilFreeSecurityObjectList(1, ppObjects);
     AD_ClearProviderState(pContext);
@@ -3439,6 +3454,9 @@ AD_RemoveGroupByIdFromCache(
                   ppObjects[0]->pszObjectSid);
     BAIL_ON_LSA_ERROR(dwError);
 
+    /* Drop anything already handed out to the nsswitch modules */
+    LsaSrvFlushSystemCache();
+
 cleanup:
     LsaUtilFreeSecurityObjectList(1, ppObjects);
     AD_ClearProviderState(pContext);
@@ -3623,6 +3641,9 @@ AD_EmptyCache(
     dwError = ADCacheEmptyCache(pContext->pState->hCacheConnection);
     BAIL_ON_LSA_ERROR(dwError);
 
+    /* Drop anything already handed out to the nsswitch modules */
+    LsaSrvFlushSystemCache();
+
 cleanup:
 
     AD_ClearProviderState(pContext);
@@ -97,18 +97,14 @@ error:
     goto cleanup;
 }
 
+// Prepares every statement on the connection's own sqlite handle.
 static
 DWORD
-LsaDbOpen(
-    IN PCSTR pszDbPath,
-    IN PLSA_AD_PROVIDER_STATE pState,
-    OUT PLSA_DB_HANDLE phDb
+LsaDbPrepareStatements(
+    IN OUT PLSA_DB_CONNECTION pConn
     )
 {
     DWORD dwError = 0;
-    BOOLEAN bLockCreated = FALSE;
-    PLSA_DB_CONNECTION pConn = NULL;
-    BOOLEAN bExists = FALSE;
     PSTR pszQuery = NULL;
     PCSTR pszEitherQueryFormat =
         "select "
@@ -139,49 +135,7 @@ LsaDbOpen(
             "%s";
     PCSTR pszRemoveBySidFormat =
         "delete from %s where ObjectSid = ?1;";
-    PSTR pszDbDir = NULL;
-
-    dwError = LsaGetDirectoryFromPath(
-                    pszDbPath,
-                    &pszDbDir);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    dwError = LwAllocateMemory(
-                    sizeof(LSA_DB_CONNECTION),
-                    (PVOID*)&pConn);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    pConn->pProviderState = pState;
-
-    dwError = pthread_rwlock_init(&pConn->lock, NULL);
-    BAIL_ON_LSA_ERROR(dwError);
-    bLockCreated = TRUE;
-
-    dwError = LsaCheckDirectoryExists(pszDbDir, &bExists);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    if (!bExists)
-    {
-        mode_t cacheDirMode = S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH;
-
-        dwError = LsaCreateDirectory(pszDbDir, cacheDirMode);
-        BAIL_ON_LSA_ERROR(dwError);
-    }
-
-    /* restrict access to u+rwx to the db folder */
-    dwError = LsaChangeOwnerAndPermissions(pszDbDir, 0, 0, S_IRWXU);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    dwError = sqlite3_open(pszDbPath, &pConn->pDb);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    dwError = LsaChangeOwnerAndPermissions(pszDbPath, 0, 0, S_IRWXU);
-    BAIL_ON_LSA_ERROR(dwError);
-
-    dwError = LsaDbSetup(pConn->pDb);
-    BAIL_ON_LSA_ERROR(dwError);
 
-    LW_SAFE_FREE_STRING(pszQuery);
     dwError = LwAllocateStringPrintf(
         &pszQuery,
         pszUserQueryFormat,
@@ -509,11 +463,324 @@ LsaDbOpen(
             NULL);
     BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
 
+cleanup:
+
+    LW_SAFE_FREE_STRING(pszQuery);
+
+    return dwError;
+
+error:
+
+    goto cleanup;
+}
+
+// Switches the database to write-ahead logging when the sqlite library
+// supports it. Older libraries report the journal mode that stays in use.
+static
+DWORD
+LsaDbEnableWalMode(
+    IN OUT PLSA_DB_CONNECTION pConn
+    )
+{
+    DWORD dwError = 0;
+    sqlite3_stmt *pstQuery = NULL;
+    PCSTR pszMode = NULL;
+    PSTR pszError = NULL;
+
+    dwError = sqlite3_prepare_v2(
+            pConn->pDb,
+            "PRAGMA journal_mode = WAL",
+            -1, //search for null termination in szQuery to get length
+            &pstQuery,
+            NULL);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+
+    dwError = (DWORD)sqlite3_step(pstQuery);
+    if (dwError == SQLITE_ROW)
+    {
+        pszMode = (PCSTR)sqlite3_column_text(pstQuery, 0);
+        dwError = LW_ERROR_SUCCESS;
+    }
+    else if (dwError == SQLITE_DONE)
+    {
+        dwError = LW_ERROR_SUCCESS;
+    }
+    BAIL_ON_SQLITE3_ERROR_STMT(dwError, pstQuery);
+
+    pConn->bWalMode = pszMode && !strcasecmp(pszMode, "wal");
+
+    if (pConn->bWalMode)
+    {
+        // The cache can always be refetched, so it does not need to be
+        // synced on every commit. WAL keeps it consistent either way.
+        dwError = LsaSqliteExec(
+                        pConn->pDb,
+                        "PRAGMA synchronous = NORMAL",
+                        &pszError);
+        BAIL_ON_SQLITE3_ERROR(dwError, pszError);
+    }
+
+    LSA_LOG_INFO("AD cache database is %s",
+                 pConn->bWalMode ?
+                    "in WAL mode, lookups run alongside updates" :
+                    "not in WAL mode, lookups wait for updates");
+
+cleanup:
+    if (pstQuery)
+    {
+        sqlite3_finalize(pstQuery);
+    }
+    SQLITE3_SAFE_FREE_STRING(pszError);
+
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+static
+VOID
+LsaDbFreeConnection(
+    IN OUT PLSA_DB_CONNECTION* ppConn
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PLSA_DB_CONNECTION pConn = *ppConn;
+
+    if (pConn)
+    {
+        dwError = LsaDbFreePreparedStatements(pConn);
+        if (dwError != LW_ERROR_SUCCESS)
+        {
+            LSA_LOG_ERROR("Error freeing prepared statements [%u]", dwError);
+        }
+
+        if (pConn->pDb != NULL)
+        {
+            sqlite3_close(pConn->pDb);
+            pConn->pDb = NULL;
+        }
+
+        LW_SAFE_FREE_MEMORY(pConn);
+        *ppConn = NULL;
+    }
+}
+
+static
+DWORD
+LsaDbOpenReader(
+    IN PLSA_DB_CONNECTION pConn,
+    OUT PLSA_DB_CONNECTION* ppReader
+    )
+{
+    DWORD dwError = 0;
+    PLSA_DB_CONNECTION pReader = NULL;
+
+    dwError = LwAllocateMemory(
+                    sizeof(*pReader),
+                    (PVOID*)&pReader);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pReader->pProviderState = pConn->pProviderState;
+
+    dwError = sqlite3_open_v2(
+                    pConn->pszDbPath,
+                    &pReader->pDb,
+                    SQLITE_OPEN_READONLY,
+                    NULL);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
+
+    dwError = sqlite3_busy_timeout(
+                    pReader->pDb,
+                    LSA_DB_READ_BUSY_TIMEOUT_MSECS);
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
+
+    dwError = LsaDbPrepareStatements(pReader);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    *ppReader = pReader;
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    LsaDbFreeConnection(&pReader);
+    *ppReader = NULL;
+
+    goto cleanup;
+}
+
+// Hands out a read connection from the pool, opening a new one if all of
+// them are busy and the pool is not full yet. Outside of WAL mode, this
+// also keeps writers out until the connection is released.
+static
+DWORD
+LsaDbAcquireReader(
+    IN PLSA_DB_CONNECTION pConn,
+    OUT PLSA_DB_CONNECTION* ppReader
+    )
+{
+    DWORD dwError = 0;
+    PLSA_DB_CONNECTION pReader = NULL;
+
+    pthread_mutex_lock(&pConn->readerLock);
+
+    while (!pConn->pIdleReaders &&
+           pConn->dwReaderCount >= LSA_DB_MAX_READ_CONNECTIONS)
+    {
+        pthread_cond_wait(&pConn->readerAvailable, &pConn->readerLock);
+    }
+
+    if (pConn->pIdleReaders)
+    {
+        pReader = pConn->pIdleReaders;
+        pConn->pIdleReaders = pReader->pNextReader;
+        pReader->pNextReader = NULL;
+    }
+    else
+    {
+        // Reserve the slot so the connection can be opened unlocked
+        pConn->dwReaderCount++;
+    }
+
+    pthread_mutex_unlock(&pConn->readerLock);
+
+    if (!pReader)
+    {
+        dwError = LsaDbOpenReader(pConn, &pReader);
+        if (dwError)
+        {
+            pthread_mutex_lock(&pConn->readerLock);
+            pConn->dwReaderCount--;
+            pthread_cond_signal(&pConn->readerAvailable);
+            pthread_mutex_unlock(&pConn->readerLock);
+        }
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    if (!pConn->bWalMode)
+    {
+        pthread_rwlock_rdlock(&pConn->lock);
+    }
+
+    *ppReader = pReader;
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    *ppReader = NULL;
+
+    goto cleanup;
+}
+
+static
+VOID
+LsaDbReleaseReader(
+    IN PLSA_DB_CONNECTION pConn,
+    IN OUT PLSA_DB_CONNECTION* ppReader
+    )
+{
+    PLSA_DB_CONNECTION pReader = *ppReader;
+
+    if (pReader)
+    {
+        if (!pConn->bWalMode)
+        {
+            pthread_rwlock_unlock(&pConn->lock);
+        }
+
+        pthread_mutex_lock(&pConn->readerLock);
+        pReader->pNextReader = pConn->pIdleReaders;
+        pConn->pIdleReaders = pReader;
+        pthread_cond_signal(&pConn->readerAvailable);
+        pthread_mutex_unlock(&pConn->readerLock);
+
+        *ppReader = NULL;
+    }
+}
+
+static
+DWORD
+LsaDbOpen(
+    IN PCSTR pszDbPath,
+    IN PLSA_AD_PROVIDER_STATE pState,
+    OUT PLSA_DB_HANDLE phDb
+    )
+{
+    DWORD dwError = 0;
+    BOOLEAN bLockCreated = FALSE;
+    BOOLEAN bReaderLockCreated = FALSE;
+    BOOLEAN bReaderCondCreated = FALSE;
+    PLSA_DB_CONNECTION pConn = NULL;
+    BOOLEAN bExists = FALSE;
+    PSTR pszDbDir = NULL;
+
+    dwError = LsaGetDirectoryFromPath(
+                    pszDbPath,
+                    &pszDbDir);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LwAllocateMemory(
+                    sizeof(LSA_DB_CONNECTION),
+                    (PVOID*)&pConn);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pConn->pProviderState = pState;
+
+    dwError = pthread_rwlock_init(&pConn->lock, NULL);
+    BAIL_ON_LSA_ERROR(dwError);
+    bLockCreated = TRUE;
+
+    dwError = pthread_mutex_init(&pConn->readerLock, NULL);
+    BAIL_ON_LSA_ERROR(dwError);
+    bReaderLockCreated = TRUE;
+
+    dwError = pthread_cond_init(&pConn->readerAvailable, NULL);
+    BAIL_ON_LSA_ERROR(dwError);
+    bReaderCondCreated = TRUE;
+
+    dwError = LwAllocateString(pszDbPath, &pConn->pszDbPath);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LsaCheckDirectoryExists(pszDbDir, &bExists);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (!bExists)
+    {
+        mode_t cacheDirMode = S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH;
+
+        dwError = LsaCreateDirectory(pszDbDir, cacheDirMode);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    /* restrict access to u+rwx to the db folder */
+    dwError = LsaChangeOwnerAndPermissions(pszDbDir, 0, 0, S_IRWXU);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = sqlite3_open(pszDbPath, &pConn->pDb);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LsaChangeOwnerAndPermissions(pszDbPath, 0, 0, S_IRWXU);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LsaDbSetup(pConn->pDb);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LsaDbEnableWalMode(pConn);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LsaDbPrepareStatements(pConn);
+    BAIL_ON_LSA_ERROR(dwError);
+
     *phDb = pConn;
 
 cleanup:
 
-    LW_SAFE_FREE_STRING(pszQuery);
     LW_SAFE_FREE_STRING(pszDbDir);
 
     return dwError;
@@ -525,20 +792,22 @@ error:
         {
             pthread_rwlock_destroy(&pConn->lock);
         }
-        LsaDbFreePreparedStatements(pConn);
-
-        if (pConn->pDb != NULL)
+        if (bReaderLockCreated)
         {
-            sqlite3_close(pConn->pDb);
+            pthread_mutex_destroy(&pConn->readerLock);
         }
-        LW_SAFE_FREE_MEMORY(pConn);
+        if (bReaderCondCreated)
+        {
+            pthread_cond_destroy(&pConn->readerAvailable);
+        }
+        LW_SAFE_FREE_STRING(pConn->pszDbPath);
+        LsaDbFreeConnection(&pConn);
     }
     *phDb = (HANDLE)NULL;
 
     goto cleanup;
 }
 
-
 DWORD
 LsaDbFreePreparedStatements(
     IN OUT PLSA_DB_CONNECTION pConn
@@ -604,6 +873,7 @@ LsaDbSafeClose(
     // along the way
     DWORD dwError = LW_ERROR_SUCCESS;
     PLSA_DB_CONNECTION pConn = NULL;
+    PLSA_DB_CONNECTION pReader = NULL;
 
     if (phDb == NULL)
     {
@@ -617,17 +887,12 @@ LsaDbSafeClose(
         goto cleanup;
     }
 
-    dwError = LsaDbFreePreparedStatements(pConn);
-    if (dwError != LW_ERROR_SUCCESS)
-    {
-        LSA_LOG_ERROR("Error freeing prepared statements [%u]", dwError);
-        dwError = LW_ERROR_SUCCESS;
-    }
-
-    if (pConn->pDb != NULL)
+    // Every read connection is idle once the cache is no longer used
+    while (pConn->pIdleReaders)
     {
-        sqlite3_close(pConn->pDb);
-        pConn->pDb = NULL;
+        pReader = pConn->pIdleReaders;
+        pConn->pIdleReaders = pReader->pNextReader;
+        LsaDbFreeConnection(&pReader);
     }
 
     dwError = pthread_rwlock_destroy(&pConn->lock);
@@ -636,7 +901,11 @@ LsaDbSafeClose(
         LSA_LOG_ERROR("Error destroying lock [%u]", dwError);
         dwError = LW_ERROR_SUCCESS;
     }
-    LW_SAFE_FREE_MEMORY(pConn);
+    pthread_mutex_destroy(&pConn->readerLock);
+    pthread_cond_destroy(&pConn->readerAvailable);
+    LW_SAFE_FREE_STRING(pConn->pszDbPath);
+
+    LsaDbFreeConnection(&pConn);
 
     *phDb = (HANDLE)0;
 
@@ -655,13 +924,14 @@ LsaDbFindUserByName(
 {
     DWORD dwError = 0;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PLSA_DB_CONNECTION pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
     PLSA_SECURITY_OBJECT pObject = NULL;
     PSTR pszDnsDomain = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    dwError = LsaDbAcquireReader(pConn, &pReader);
+    BAIL_ON_LSA_ERROR(dwError);
 
     switch (pUserNameInfo->nameType)
     {
@@ -686,7 +956,7 @@ LsaDbFindUserByName(
                             NULL);
             BAIL_ON_LSA_ERROR(dwError);
 
-            pstQuery = pConn->pstFindUserByUPN;
+            pstQuery = pReader->pstFindUserByUPN;
             dwError = sqlite3_bind_text(
                     pstQuery,
                     1,
@@ -694,7 +964,7 @@ LsaDbFindUserByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
             dwError = sqlite3_bind_text(
                     pstQuery,
@@ -703,10 +973,10 @@ LsaDbFindUserByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
             break;
        case NameType_NT4:
-            pstQuery = pConn->pstFindObjectByNT4;
+            pstQuery = pReader->pstFindObjectByNT4;
             dwError = sqlite3_bind_text(
                     pstQuery,
                     1,
@@ -714,7 +984,7 @@ LsaDbFindUserByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
             dwError = sqlite3_bind_text(
                     pstQuery,
@@ -723,10 +993,10 @@ LsaDbFindUserByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
             break;
        case NameType_Alias:
-            pstQuery = pConn->pstFindUserByAlias;
+            pstQuery = pReader->pstFindUserByAlias;
             dwError = sqlite3_bind_text(
                     pstQuery,
                     1,
@@ -734,7 +1004,7 @@ LsaDbFindUserByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
             break;
        default:
             dwError = LW_ERROR_INTERNAL;
@@ -754,7 +1024,7 @@ LsaDbFindUserByName(
 
 cleanup:
     LW_SAFE_FREE_STRING(pszDnsDomain);
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -775,20 +1045,21 @@ LsaDbFindUserById(
 {
     DWORD dwError = 0;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PLSA_DB_CONNECTION pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
     PLSA_SECURITY_OBJECT pObject = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    dwError = LsaDbAcquireReader(pConn, &pReader);
+    BAIL_ON_LSA_ERROR(dwError);
 
-    pstQuery = pConn->pstFindUserById;
+    pstQuery = pReader->pstFindUserById;
     dwError = sqlite3_bind_int64(
             pstQuery,
             1,
             (uint64_t)uid
             );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     dwError = LsaDbQueryObject(pstQuery, &pObject);
     BAIL_ON_LSA_ERROR(dwError);
@@ -802,7 +1073,7 @@ LsaDbFindUserById(
     *ppObject = pObject;
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -822,17 +1093,18 @@ LsaDbFindGroupByName(
 {
     DWORD dwError = 0;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PLSA_DB_CONNECTION pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
     PLSA_SECURITY_OBJECT pObject = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    dwError = LsaDbAcquireReader(pConn, &pReader);
+    BAIL_ON_LSA_ERROR(dwError);
 
     switch (pGroupNameInfo->nameType)
     {
        case NameType_NT4:
-            pstQuery = pConn->pstFindObjectByNT4;
+            pstQuery = pReader->pstFindObjectByNT4;
             dwError = sqlite3_bind_text(
                     pstQuery,
                     1,
@@ -840,7 +1112,7 @@ LsaDbFindGroupByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
             dwError = sqlite3_bind_text(
                     pstQuery,
@@ -849,10 +1121,10 @@ LsaDbFindGroupByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
             break;
        case NameType_Alias:
-            pstQuery = pConn->pstFindGroupByAlias;
+            pstQuery = pReader->pstFindGroupByAlias;
             dwError = sqlite3_bind_text(
                     pstQuery,
                     1,
@@ -860,7 +1132,7 @@ LsaDbFindGroupByName(
                     -1, // let sqlite calculate the length
                     SQLITE_TRANSIENT //let sqlite make its own copy
                     );
-            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+            BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
             break;
        default:
             dwError = LW_ERROR_INTERNAL;
@@ -879,7 +1151,7 @@ LsaDbFindGroupByName(
     *ppObject = pObject;
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -899,20 +1171,21 @@ LsaDbFindGroupById(
 {
     DWORD dwError = 0;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PLSA_DB_CONNECTION pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
     PLSA_SECURITY_OBJECT pObject = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    dwError = LsaDbAcquireReader(pConn, &pReader);
+    BAIL_ON_LSA_ERROR(dwError);
 
-    pstQuery = pConn->pstFindGroupById;
+    pstQuery = pReader->pstFindGroupById;
     dwError = sqlite3_bind_int64(
             pstQuery,
             1,
             (uint64_t)gid
             );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     dwError = LsaDbQueryObject(pstQuery, &pObject);
     BAIL_ON_LSA_ERROR(dwError);
@@ -926,7 +1199,7 @@ LsaDbFindGroupById(
     *ppObject = pObject;
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -2375,7 +2648,7 @@ LsaDbGetMemberships(
 {
     DWORD dwError = LW_ERROR_SUCCESS;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PLSA_DB_CONNECTION pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
     size_t sResultCapacity = 0;
@@ -2386,15 +2659,16 @@ LsaDbGetMemberships(
     int nGotColumns = 0;
     PLSA_GROUP_MEMBERSHIP pMembership = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    dwError = LsaDbAcquireReader(pConn, &pReader);
+    BAIL_ON_LSA_ERROR(dwError);
 
     if (bIsGroupMembers)
     {
-        pstQuery = pConn->pstGetGroupMembers;
+        pstQuery = pReader->pstGetGroupMembers;
     }
     else
     {
-        pstQuery = pConn->pstGetGroupsForUser;
+        pstQuery = pReader->pstGetGroupsForUser;
     }
 
     dwError = LsaSqliteBindString(pstQuery, 1, pszSid);
@@ -2467,16 +2741,16 @@ LsaDbGetMemberships(
         // No more results found
         dwError = LW_ERROR_SUCCESS;
     }
-    BAIL_ON_SQLITE3_ERROR_DB(dwError, pConn->pDb);
+    BAIL_ON_SQLITE3_ERROR_DB(dwError, pReader->pDb);
 
     dwError = (DWORD)sqlite3_reset(pstQuery);
-    BAIL_ON_SQLITE3_ERROR_DB(dwError, pConn->pDb);
+    BAIL_ON_SQLITE3_ERROR_DB(dwError, pReader->pDb);
 
     *pppResults = ppResults;
     *psCount = sResultCount;
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -2593,8 +2867,8 @@ LsaDbEnumUsersCache(
 {
     DWORD                 dwError = 0;
     PLSA_DB_CONNECTION    pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN               bInLock = FALSE;
-    sqlite3_stmt *        pstQuery = pConn->pstEnumUsers;
+    PLSA_DB_CONNECTION    pReader = NULL;
+    sqlite3_stmt *        pstQuery = NULL;
     DWORD                 dwUserCount = 0;
     PLSA_SECURITY_OBJECT* ppObjectsLocal = NULL;
 
@@ -2603,7 +2877,10 @@ LsaDbEnumUsersCache(
                   (PVOID*)&ppObjectsLocal);
     BAIL_ON_LSA_ERROR(dwError);
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    dwError = LsaDbAcquireReader(pConn, &pReader);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pstQuery = pReader->pstEnumUsers;
 
     dwError = sqlite3_bind_text(
                   pstQuery,
@@ -2612,14 +2889,14 @@ LsaDbEnumUsersCache(
                   -1, // let sqlite calculate the length
                   SQLITE_TRANSIENT //let sqlite make its own copy
                   );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     dwError = sqlite3_bind_int64(
                   pstQuery,
                   2,
                   (uint64_t)dwMaxNumUsers
                   );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     for ( dwUserCount = 0 ;
           dwUserCount < dwMaxNumUsers ;
@@ -2648,7 +2925,7 @@ LsaDbEnumUsersCache(
 
 cleanup:
 
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -2676,8 +2953,8 @@ LsaDbEnumGroupsCache(
 {
     DWORD                 dwError = 0;
     PLSA_DB_CONNECTION    pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN               bInLock = FALSE;
-    sqlite3_stmt *        pstQuery = pConn->pstEnumGroups;
+    PLSA_DB_CONNECTION    pReader = NULL;
+    sqlite3_stmt *        pstQuery = NULL;
     DWORD                 dwGroupCount = 0;
     PLSA_SECURITY_OBJECT* ppObjectsLocal = NULL;
 
@@ -2686,7 +2963,10 @@ LsaDbEnumGroupsCache(
                   (PVOID*)&ppObjectsLocal);
     BAIL_ON_LSA_ERROR(dwError);
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    dwError = LsaDbAcquireReader(pConn, &pReader);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pstQuery = pReader->pstEnumGroups;
 
     dwError = sqlite3_bind_text(
                   pstQuery,
@@ -2695,14 +2975,14 @@ LsaDbEnumGroupsCache(
                   -1, // let sqlite calculate the length
                   SQLITE_TRANSIENT //let sqlite make its own copy
                   );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     dwError = sqlite3_bind_int64(
                   pstQuery,
                   2,
                   (uint64_t)dwMaxNumGroups
                   );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     for ( dwGroupCount = 0 ;
           dwGroupCount < dwMaxNumGroups ;
@@ -2731,7 +3011,7 @@ LsaDbEnumGroupsCache(
 
 cleanup:
 
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -2915,34 +3195,59 @@ LsaDbGetObjectFieldList(
 
 static
 DWORD
-LsaDbFindObjectByDN(
-    LSA_DB_HANDLE hDb,
-    PCSTR pszDN,
-    PLSA_SECURITY_OBJECT *ppObject)
+LsaDbFindObjectByString(
+    IN PLSA_DB_CONNECTION pReader,
+    IN sqlite3_stmt* pstQuery,
+    IN PCSTR pszValue,
+    OUT PLSA_SECURITY_OBJECT *ppObject
+    )
 {
     DWORD dwError = 0;
-    PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
-    // do not free
-    sqlite3_stmt *pstQuery = NULL;
-
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
 
-    pstQuery = pConn->pstFindObjectByDN;
     dwError = sqlite3_bind_text(
             pstQuery,
             1,
-            pszDN,
+            pszValue,
             -1, // let sqlite calculate the length
             SQLITE_TRANSIENT //let sqlite make its own copy
             );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     dwError = LsaDbQueryObject(pstQuery, ppObject);
     BAIL_ON_LSA_ERROR(dwError);
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+
+    return dwError;
+
+error:
+    *ppObject = NULL;
+    goto cleanup;
+}
+
+static
+DWORD
+LsaDbFindObjectByDN(
+    LSA_DB_HANDLE hDb,
+    PCSTR pszDN,
+    PLSA_SECURITY_OBJECT *ppObject)
+{
+    DWORD dwError = 0;
+    PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
+    PLSA_DB_CONNECTION pReader = NULL;
+
+    dwError = LsaDbAcquireReader(pConn, &pReader);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = LsaDbFindObjectByString(
+                    pReader,
+                    pReader->pstFindObjectByDN,
+                    pszDN,
+                    ppObject);
+    BAIL_ON_LSA_ERROR(dwError);
+
+cleanup:
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -2952,7 +3257,7 @@ error:
 }
 
 // Leaves NULLs in pppResults for the objects which can't be found in the
-// version.
+// version. All of the objects are read on one connection.
 static
 DWORD
 LsaDbFindObjectsByDNList(
@@ -2963,6 +3268,8 @@ LsaDbFindObjectsByDNList(
     )
 {
     DWORD dwError = LW_ERROR_SUCCESS;
+    PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
+    PLSA_DB_CONNECTION pReader = NULL;
     size_t sIndex;
     PLSA_SECURITY_OBJECT* ppResults = NULL;
 
@@ -2971,10 +3278,14 @@ LsaDbFindObjectsByDNList(
                     (PVOID*)&ppResults);
     BAIL_ON_LSA_ERROR(dwError);
 
+    dwError = LsaDbAcquireReader(pConn, &pReader);
+    BAIL_ON_LSA_ERROR(dwError);
+
     for(sIndex = 0; sIndex < sCount; sIndex++)
     {
-        dwError = LsaDbFindObjectByDN(
-            hDb,
+        dwError = LsaDbFindObjectByString(
+            pReader,
+            pReader->pstFindObjectByDN,
             ppszDnList[sIndex],
             &ppResults[sIndex]);
         if (dwError == LW_ERROR_NOT_HANDLED)
@@ -2985,6 +3296,8 @@ LsaDbFindObjectsByDNList(
     *pppResults = ppResults;
 
 cleanup:
+    LsaDbReleaseReader(pConn, &pReader);
+
     return dwError;
 
 error:
@@ -3001,27 +3314,20 @@ LsaDbFindObjectBySid(
 {
     DWORD dwError = 0;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
-    // do not free
-    sqlite3_stmt *pstQuery = NULL;
+    PLSA_DB_CONNECTION pReader = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
-
-    pstQuery = pConn->pstFindObjectBySid;
-    dwError = sqlite3_bind_text(
-            pstQuery,
-            1,
-            pszSid,
-            -1, // let sqlite calculate the length
-            SQLITE_TRANSIENT //let sqlite make its own copy
-            );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    dwError = LsaDbAcquireReader(pConn, &pReader);
+    BAIL_ON_LSA_ERROR(dwError);
 
-    dwError = LsaDbQueryObject(pstQuery, ppObject);
+    dwError = LsaDbFindObjectByString(
+                    pReader,
+                    pReader->pstFindObjectBySid,
+                    pszSid,
+                    ppObject);
     BAIL_ON_LSA_ERROR(dwError);
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
 
     return dwError;
 
@@ -3031,7 +3337,7 @@ error:
 }
 
 // Leaves NULLs in pppResults for the objects which can't be found in the
-// version.
+// version. All of the objects are read on one connection.
 static
 DWORD
 LsaDbFindObjectsBySidList(
@@ -3042,6 +3348,8 @@ LsaDbFindObjectsBySidList(
     )
 {
     DWORD dwError = LW_ERROR_SUCCESS;
+    PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
+    PLSA_DB_CONNECTION pReader = NULL;
     size_t sIndex;
     PLSA_SECURITY_OBJECT* ppResults = NULL;
 
@@ -3050,10 +3358,14 @@ LsaDbFindObjectsBySidList(
                     (PVOID*)&ppResults);
     BAIL_ON_LSA_ERROR(dwError);
 
+    dwError = LsaDbAcquireReader(pConn, &pReader);
+    BAIL_ON_LSA_ERROR(dwError);
+
     for(sIndex = 0; sIndex < sCount; sIndex++)
     {
-        dwError = LsaDbFindObjectBySid(
-            hDb,
+        dwError = LsaDbFindObjectByString(
+            pReader,
+            pReader->pstFindObjectBySid,
             ppszSidList[sIndex],
             &ppResults[sIndex]);
         if (dwError == LW_ERROR_NOT_HANDLED)
@@ -3064,6 +3376,8 @@ LsaDbFindObjectsBySidList(
     *pppResults = ppResults;
 
 cleanup:
+    LsaDbReleaseReader(pConn, &pReader);
+
     return dwError;
 
 error:
@@ -3082,7 +3396,7 @@ LsaDbGetPasswordVerifier(
 {
     DWORD dwError = 0;
     PLSA_DB_CONNECTION pConn = (PLSA_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PLSA_DB_CONNECTION pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
     const int nExpectedCols = 4;
@@ -3090,9 +3404,10 @@ LsaDbGetPasswordVerifier(
     int nGotColumns = 0;
     PLSA_PASSWORD_VERIFIER pResult = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    dwError = LsaDbAcquireReader(pConn, &pReader);
+    BAIL_ON_LSA_ERROR(dwError);
 
-    pstQuery = pConn->pstGetPasswordVerifier;
+    pstQuery = pReader->pstGetPasswordVerifier;
     dwError = sqlite3_bind_text(
             pstQuery,
             1,
@@ -3100,7 +3415,7 @@ LsaDbGetPasswordVerifier(
             -1, // let sqlite calculate the length
             SQLITE_TRANSIENT //let sqlite make its own copy
             );
-    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pConn->pDb));
+    BAIL_ON_SQLITE3_ERROR(dwError, sqlite3_errmsg(pReader->pDb));
 
     dwError = (DWORD)sqlite3_step(pstQuery);
     if (dwError == SQLITE_DONE)
@@ -3174,7 +3489,7 @@ LsaDbGetPasswordVerifier(
 
 cleanup:
 
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    LsaDbReleaseReader(pConn, &pReader);
     return dwError;
 
 error:
@@ -53,12 +53,34 @@
         "CacheId NOT IN ( select CacheId from " LSA_DB_TABLE_NAME_OBJECTS " ) AND " \
         "CacheId NOT IN ( select CacheId from " LSA_DB_TABLE_NAME_VERIFIERS " );\n"
 
+// Most read-only connections opened next to the writer connection
+#define LSA_DB_MAX_READ_CONNECTIONS 8
+
+// How long a read connection waits on a locked database
+#define LSA_DB_READ_BUSY_TIMEOUT_MSECS 5000
+
 typedef struct _LSA_DB_CONNECTION
 {
     sqlite3 *pDb;
+    // Held exclusively by writers. Unless the database is in WAL mode,
+    // read connections hold it shared while they run a query.
     pthread_rwlock_t lock;
     PLSA_AD_PROVIDER_STATE pProviderState;
 
+    // The pool of read connections. These fields are only used on the
+    // writer connection.
+    PSTR pszDbPath;
+    BOOLEAN bWalMode;
+    pthread_mutex_t readerLock;
+    pthread_cond_t readerAvailable;
+    struct _LSA_DB_CONNECTION *pIdleReaders;
+    DWORD dwReaderCount;
+
+    // Links the idle read connections
+    struct _LSA_DB_CONNECTION *pNextReader;
+
+    // Every connection prepares its own copy of these
+
     sqlite3_stmt *pstFindObjectByNT4;
     sqlite3_stmt *pstFindObjectByDN;
     sqlite3_stmt *pstFindObjectBySid;
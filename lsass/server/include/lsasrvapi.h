@@ -48,6 +48,7 @@
 #define __LSASRVAPI_H__
 
 #include <lsa/provider.h>
+#include <lsautils.h>
 
 DWORD
 LsaSrvApiInit(
@@ -249,6 +250,11 @@ LsaSrvGetMetrics(
     PVOID* ppMetricPack
     );
 
+VOID
+LsaSrvIncrementMetricValue(
+    LsaMetricType metricType
+    );
+
 DWORD
 LsaSrvGetStatus(
     HANDLE hServer,
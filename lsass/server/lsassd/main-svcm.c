@@ -138,6 +138,9 @@ LsaSvcmStart(
 {
     DWORD dwError = 0;
 
+    dwError = RegEnableValueCache();
+    BAIL_ON_LSA_ERROR(dwError);
+
     dwError = LsaSrvSetDefaults();
     BAIL_ON_LSA_ERROR(dwError);
 
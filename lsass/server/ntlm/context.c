@@ -121,6 +121,22 @@ NtlmGetContextInfo(
     }
 }
 
+/******************************************************************************/
+VOID
+NtlmGetSessionSecurity(
+    IN PNTLM_CONTEXT pContext,
+    OUT PNTLM_SESSION_SECURITY pSecurity
+    )
+{
+    pSecurity->NegotiatedFlags = pContext->NegotiatedFlags;
+    pSecurity->pSignKey = pContext->SignKey;
+    pSecurity->pVerifyKey = pContext->VerifyKey;
+    pSecurity->pSealKey = pContext->pSealKey;
+    pSecurity->pUnsealKey = pContext->pUnsealKey;
+    pSecurity->pdwSendMsgSeq = pContext->pdwSendMsgSeq;
+    pSecurity->pdwRecvMsgSeq = pContext->pdwRecvMsgSeq;
+}
+
 /******************************************************************************/
 DWORD
 NtlmCreateContext(
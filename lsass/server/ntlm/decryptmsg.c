@@ -56,48 +56,19 @@ NtlmServerDecryptMessage(
     )
 {
     DWORD dwError = LW_ERROR_SUCCESS;
-    PSecBuffer pData = NULL;
-    PSecBuffer pToken = NULL;
     PNTLM_CONTEXT pContext = hContext;
     BOOLEAN bEncrypted = TRUE;
-    DWORD dwIndex = 0;
+    NTLM_SESSION_SECURITY Security;
 
-    NtlmGetSecBuffers(pMessage, &pToken, NULL);
-
-    // Do a full sanity check here
-    if (!pToken ||
-        pToken->cbBuffer != NTLM_SIGNATURE_SIZE ||
-        !pToken->pvBuffer)
+    if (pContext->bSessionExported)
     {
-        dwError = LW_ERROR_INVALID_PARAMETER;
+        dwError = LW_ERROR_INVALID_CONTEXT;
         BAIL_ON_LSA_ERROR(dwError);
     }
 
-    for (dwIndex = 0 ; dwIndex < pMessage->cBuffers ; dwIndex++)
-    {
-        pData = &pMessage->pBuffers[dwIndex];
-
-        if (pData->BufferType == SECBUFFER_DATA)
-        {
-            if (!pData->pvBuffer)
-            {
-                dwError = LW_ERROR_INVALID_PARAMETER;
-                BAIL_ON_LSA_ERROR(dwError);
-            }
+    NtlmGetSessionSecurity(pContext, &Security);
 
-            RC4(
-                pContext->pUnsealKey,
-                pData->cbBuffer,
-                pData->pvBuffer,
-                pData->pvBuffer);
-        }
-    }
-
-    //verify the key
-    dwError = NtlmVerifySignature(
-        pContext,
-        pMessage,
-        pToken);
+    dwError = NtlmSessionDecryptMessage(&Security, pMessage);
     BAIL_ON_LSA_ERROR(dwError);
 
 cleanup:
@@ -114,6 +85,7 @@ error:
 }
 
 
+
 /*
 local variables:
 mode: c
@@ -57,69 +57,19 @@ NtlmServerEncryptMessage(
 {
     DWORD dwError = LW_ERROR_SUCCESS;
     PNTLM_CONTEXT pContext = *phContext;
-    // The following pointers point into pMessage and will not be freed
-    PSecBuffer pToken = NULL;
-    PSecBuffer pData = NULL;
-    PNTLM_SIGNATURE pSignature = NULL;
-    DWORD dwIndex = 0;
+    NTLM_SESSION_SECURITY Security;
 
-    // Sanity check to see if we handle sealing
-    if (bEncrypt && !(pContext->NegotiatedFlags & NTLM_FLAG_SEAL))
+    if (pContext->bSessionExported)
     {
-        dwError = LW_ERROR_INVALID_PARAMETER;
+        dwError = LW_ERROR_INVALID_CONTEXT;
         BAIL_ON_LSA_ERROR(dwError);
     }
 
-    // The message should be in the format of:
-    // SECBUFFER_TOKEN      - Where the signature is placed
-    // SECBUFFER_DATA       - The data we are signing
-    // SECBUFFER_PADDING    - Padding (for RC4 or CRC32?) - ignore padding
-    //
-    // Find these buffers... the first one found of each type will be the one
-    // that is used.
-    NtlmGetSecBuffers(pMessage, &pToken, NULL);
+    NtlmGetSessionSecurity(pContext, &Security);
 
-    // Do a full sanity check here
-    if (!pToken ||
-        pToken->cbBuffer != NTLM_SIGNATURE_SIZE ||
-        !pToken->pvBuffer)
-    {
-        dwError = LW_ERROR_INVALID_PARAMETER;
-        BAIL_ON_LSA_ERROR(dwError);
-    }
-
-    pSignature = (PNTLM_SIGNATURE)pToken->pvBuffer;
-
-    // Sign the original message before sealing it.
-    dwError = NtlmInitializeSignature(
-                pContext,
-                pMessage,
-                pSignature);
+    dwError = NtlmSessionEncryptMessage(&Security, bEncrypt, pMessage);
     BAIL_ON_LSA_ERROR(dwError);
 
-    // Always encrypt the message to match Windows' behavior
-    for (dwIndex = 0 ; dwIndex < pMessage->cBuffers ; dwIndex++)
-    {
-        pData = &pMessage->pBuffers[dwIndex];
-
-        if (pData->BufferType == SECBUFFER_DATA) 
-        {
-            if (!pData->pvBuffer)
-            {
-                dwError = LW_ERROR_INVALID_PARAMETER;
-                BAIL_ON_LSA_ERROR(dwError);
-            }
-
-            RC4(
-                pContext->pSealKey,
-                pData->cbBuffer,
-                pData->pvBuffer,
-                pData->pvBuffer);
-        }
-    }
-
-    NtlmFinalizeSignature(pContext, pSignature);
-
 cleanup:
     return dwError;
 error:
@@ -127,6 +77,7 @@ error:
 }
 
 
+
 /*
 local variables:
 mode: c
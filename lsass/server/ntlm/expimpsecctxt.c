@@ -142,7 +142,9 @@ NtlmServerExportSecurityContext(
     LWMsgDataContext *pDataContext = NULL;
     NTLM_CONTEXT_EXPORT ContextExport = {0};
 
-    if (pContext == NULL || pContext->NtlmState != NtlmStateResponse)
+    if (pContext == NULL ||
+        pContext->NtlmState != NtlmStateResponse ||
+        pContext->bSessionExported)
     {
         dwError = LW_ERROR_INVALID_CONTEXT;
         BAIL_ON_LSA_ERROR(dwError);
@@ -205,6 +207,147 @@ error:
     return dwError;
 }
 
+static
+VOID
+NtlmExportRC4State(
+    IN const RC4_KEY* pKey,
+    OUT PNTLM_IPC_RC4_STATE pState
+    )
+{
+    DWORD dwIndex = 0;
+
+    pState->x = pKey->x;
+    pState->y = pKey->y;
+
+    for (dwIndex = 0; dwIndex < 256; dwIndex++)
+    {
+        pState->data[dwIndex] = pKey->data[dwIndex];
+    }
+}
+
+DWORD
+NtlmServerExportSessionState(
+    IN PNTLM_CONTEXT_HANDLE phContext,
+    OUT PNTLM_IPC_SESSION_STATE pState
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_CONTEXT pContext = *phContext;
+    PSecPkgContext_Sizes pSizes = NULL;
+
+    if (pContext == NULL ||
+        pContext->NtlmState != NtlmStateResponse ||
+        pContext->bSessionExported ||
+        !pContext->pSealKey ||
+        !pContext->pUnsealKey ||
+        !pContext->pdwSendMsgSeq ||
+        !pContext->pdwRecvMsgSeq)
+    {
+        dwError = LW_ERROR_INVALID_CONTEXT;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    memset(pState, 0, sizeof(*pState));
+
+    pState->NegotiatedFlags = pContext->NegotiatedFlags;
+
+    NtlmGetContextInfo(
+        pContext,
+        NULL,
+        &pState->ContextFlags,
+        NULL,
+        NULL,
+        NULL);
+
+    // The sizes never change, so the client can answer SECPKG_ATTR_SIZES
+    // without coming back here
+    dwError = NtlmServerQueryCtxtSizeAttribute(phContext, &pSizes);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pState->cbMaxToken = pSizes->cbMaxToken;
+    pState->cbMaxSignature = pSizes->cbMaxSignature;
+    pState->cbBlockSize = pSizes->cbBlockSize;
+    pState->cbSecurityTrailer = pSizes->cbSecurityTrailer;
+
+    memcpy(pState->SignKey, pContext->SignKey, sizeof(pState->SignKey));
+    memcpy(pState->VerifyKey, pContext->VerifyKey, sizeof(pState->VerifyKey));
+
+    NtlmExportRC4State(pContext->pSealKey, &pState->SealKey);
+    NtlmExportRC4State(pContext->pUnsealKey, &pState->UnsealKey);
+
+    pState->dwSendMsgSeq = *pContext->pdwSendMsgSeq;
+    pState->dwRecvMsgSeq = *pContext->pdwRecvMsgSeq;
+    pState->bSharedState = (pContext->pSealKey == pContext->pUnsealKey);
+
+    // From now on the client advances the RC4 and sequence state, so any
+    // further per-message call here would silently desynchronize the peers
+    // until NtlmServerImportSessionState hands it back
+    pContext->bSessionExported = TRUE;
+
+cleanup:
+    LW_SAFE_FREE_MEMORY(pSizes);
+
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+static
+VOID
+NtlmImportRC4State(
+    IN const NTLM_IPC_RC4_STATE* pState,
+    OUT RC4_KEY* pKey
+    )
+{
+    DWORD dwIndex = 0;
+
+    pKey->x = pState->x;
+    pKey->y = pState->y;
+
+    for (dwIndex = 0; dwIndex < 256; dwIndex++)
+    {
+        pKey->data[dwIndex] = pState->data[dwIndex];
+    }
+}
+
+DWORD
+NtlmServerImportSessionState(
+    IN PNTLM_CONTEXT_HANDLE phContext,
+    IN const NTLM_IPC_SESSION_STATE* pState
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_CONTEXT pContext = *phContext;
+
+    if (pContext == NULL ||
+        !pContext->bSessionExported ||
+        pState->bSharedState != (pContext->pSealKey == pContext->pUnsealKey))
+    {
+        dwError = LW_ERROR_INVALID_CONTEXT;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    // Only the state which moves with every message is taken back. The keys
+    // and flags never left lsassd.
+    NtlmImportRC4State(&pState->SealKey, pContext->pSealKey);
+    *pContext->pdwSendMsgSeq = pState->dwSendMsgSeq;
+
+    if (!pState->bSharedState)
+    {
+        NtlmImportRC4State(&pState->UnsealKey, pContext->pUnsealKey);
+        *pContext->pdwRecvMsgSeq = pState->dwRecvMsgSeq;
+    }
+
+    pContext->bSessionExported = FALSE;
+
+cleanup:
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
 DWORD
 NtlmServerImportSecurityContext(
     IN PSecBuffer pPackedContext,
@@ -1057,6 +1057,97 @@ error:
     goto cleanup;
 }
 
+static
+LWMsgStatus
+NtlmSrvIpcExportSessionState(
+    LWMsgCall* pCall,
+    const LWMsgParams* pIn,
+    LWMsgParams* pOut,
+    PVOID pData
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_IPC_EXPORT_SESSION_STATE_REQ pReq = pIn->data;
+    PNTLM_IPC_SESSION_STATE pNtlmResp = NULL;
+    PNTLM_IPC_ERROR pError = NULL;
+    NTLM_CONTEXT_HANDLE hContext = NULL;
+
+    dwError = LwAllocateMemory(
+        sizeof(NTLM_IPC_SESSION_STATE),
+        OUT_PPVOID(&pNtlmResp));
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = NtlmSrvIpcGetContextHandle(pCall, pReq->hContext, &hContext);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = NtlmServerExportSessionState(
+        &hContext,
+        pNtlmResp);
+
+    if (!dwError)
+    {
+        pOut->tag = NTLM_R_EXPORT_SESSION_STATE_SUCCESS;
+        pOut->data = pNtlmResp;
+    }
+    else
+    {
+        LW_SECURE_FREE_MEMORY(pNtlmResp, sizeof(*pNtlmResp));
+
+        dwError = NtlmSrvIpcCreateError(dwError, &pError);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        pOut->tag = NTLM_R_GENERIC_FAILURE;
+        pOut->data = pError;
+    }
+
+cleanup:
+    return MAP_NTLM_ERROR_IPC(dwError);
+error:
+    LW_SAFE_FREE_MEMORY(pNtlmResp);
+    goto cleanup;
+}
+
+static
+LWMsgStatus
+NtlmSrvIpcImportSessionState(
+    LWMsgCall* pCall,
+    const LWMsgParams* pIn,
+    LWMsgParams* pOut,
+    PVOID pData
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PNTLM_IPC_IMPORT_SESSION_STATE_REQ pReq = pIn->data;
+    PNTLM_IPC_ERROR pError = NULL;
+    NTLM_CONTEXT_HANDLE hContext = NULL;
+
+    dwError = NtlmSrvIpcGetContextHandle(pCall, pReq->hContext, &hContext);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = NtlmServerImportSessionState(
+        &hContext,
+        &pReq->State);
+
+    if (!dwError)
+    {
+        pOut->tag = NTLM_R_IMPORT_SESSION_STATE_SUCCESS;
+        pOut->data = NULL;
+    }
+    else
+    {
+        dwError = NtlmSrvIpcCreateError(dwError, &pError);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        pOut->tag = NTLM_R_GENERIC_FAILURE;
+        pOut->data = pError;
+    }
+
+cleanup:
+    return MAP_NTLM_ERROR_IPC(dwError);
+error:
+    goto cleanup;
+}
+
 static LWMsgDispatchSpec gMessageHandlers[] =
 {
     LWMSG_DISPATCH_BLOCK(NTLM_Q_ACCEPT_SEC_CTXT, NtlmSrvIpcAcceptSecurityContext),
@@ -1073,6 +1164,8 @@ static LWMsgDispatchSpec gMessageHandlers[] =
     LWMSG_DISPATCH_BLOCK(NTLM_Q_QUERY_CTXT, NtlmSrvIpcQueryContextAttributes),
     LWMSG_DISPATCH_BLOCK(NTLM_Q_SET_CREDS, NtlmSrvIpcSetCredentialsAttributes),
     LWMSG_DISPATCH_BLOCK(NTLM_Q_VERIFY_SIGN, NtlmSrvIpcVerifySignature),
+    LWMSG_DISPATCH_BLOCK(NTLM_Q_EXPORT_SESSION_STATE, NtlmSrvIpcExportSessionState),
+    LWMSG_DISPATCH_BLOCK(NTLM_Q_IMPORT_SESSION_STATE, NtlmSrvIpcImportSessionState),
     LWMSG_DISPATCH_END
 };
 
@@ -57,144 +57,18 @@ NtlmServerMakeSignature(
 {
     DWORD dwError = LW_ERROR_SUCCESS;
     PNTLM_CONTEXT pContext = *phContext;
-    // The following pointers point into pMessage and will not be freed
-    PSecBuffer pToken = NULL;
-    PNTLM_SIGNATURE pSignature = NULL;
+    NTLM_SESSION_SECURITY Security;
 
-    NtlmGetSecBuffers(pMessage, &pToken, NULL);
-
-    // Do a full sanity check here
-    if (!pToken ||
-        pToken->cbBuffer != NTLM_SIGNATURE_SIZE ||
-        !pToken->pvBuffer)
-    {
-        dwError = LW_ERROR_INVALID_PARAMETER;
-        BAIL_ON_LSA_ERROR(dwError);
-    }
-
-    pSignature = (PNTLM_SIGNATURE)pToken->pvBuffer;
-
-    if (pContext->NegotiatedFlags & NTLM_FLAG_ALWAYS_SIGN)
-    {
-        // Use the dummy signature 0x01000000000000000000000000000000
-        pSignature = (PNTLM_SIGNATURE)pToken->pvBuffer;
-
-        pSignature->dwVersion = NTLM_VERSION;
-        pSignature->v1.encrypted.dwCounterValue = 0;
-        pSignature->v1.encrypted.dwCrc32 = 0;
-        pSignature->v1.encrypted.dwMsgSeqNum = 0;
-    }
-    else if (pContext->NegotiatedFlags & NTLM_FLAG_SIGN)
-    {
-        dwError = NtlmInitializeSignature(
-                    pContext,
-                    pMessage,
-                    pSignature);
-        BAIL_ON_LSA_ERROR(dwError);
-
-        NtlmFinalizeSignature(pContext, pSignature);
-    }
-    else
-    {
-        dwError = LW_ERROR_INVALID_PARAMETER;
-        BAIL_ON_LSA_ERROR(dwError);
-    }
-
-cleanup:
-    return dwError;
-
-error:
-    goto cleanup;
-}
-
-DWORD
-NtlmInitializeSignature(
-    PNTLM_CONTEXT pContext,
-    const PSecBufferDesc pMessage,
-    PNTLM_SIGNATURE pSignature
-    )
-{
-    DWORD dwError = 0;
-    DWORD dwIndex = 0;
-    // Do not free
-    SecBuffer *pData = NULL;
-    BOOLEAN bFoundData = FALSE;
-
-    if (!pContext->pdwSendMsgSeq)
+    if (pContext->bSessionExported)
     {
-        dwError = ERROR_INVALID_PARAMETER;
+        dwError = LW_ERROR_INVALID_CONTEXT;
         BAIL_ON_LSA_ERROR(dwError);
     }
 
-    pSignature->dwVersion = 1;
-    pSignature->v2.dwMsgSeqNum = *pContext->pdwSendMsgSeq;
-    (*pContext->pdwSendMsgSeq)++;
-
-    if (pContext->NegotiatedFlags & NTLM_FLAG_NTLM2)
-    {
-        unsigned char tempHmac[EVP_MAX_MD_SIZE];
-        HMAC_CTX c;
-
-        HMAC_CTX_init(&c);
-        HMAC_Init(
-                &c,
-                pContext->SignKey,
-                sizeof(pContext->SignKey),
-                EVP_md5());
-
-        HMAC_Update(
-                &c,
-                (PBYTE)&pSignature->v2.dwMsgSeqNum,
-                sizeof(pSignature->v2.dwMsgSeqNum));
-
-        for (dwIndex = 0 ; dwIndex < pMessage->cBuffers ; dwIndex++)
-        {
-            pData = &pMessage->pBuffers[dwIndex];
-
-            if ((pData->BufferType & ~SECBUFFER_ATTRMASK) == SECBUFFER_DATA)
-            {
-                if (!pData->pvBuffer)
-                {
-                    HMAC_CTX_cleanup(&c);
-                    dwError = LW_ERROR_INVALID_PARAMETER;
-                    BAIL_ON_LSA_ERROR(dwError);
-                }
-
-                bFoundData = TRUE;
-
-                HMAC_Update(
-                        &c,
-                        pData->pvBuffer,
-                        pData->cbBuffer);
-            }
-        }
-
-        if (!bFoundData)
-        {
-            HMAC_CTX_cleanup(&c);
-            dwError = LW_ERROR_INVALID_PARAMETER;
-            BAIL_ON_LSA_ERROR(dwError);
-        }
-
-        HMAC_Final(
-                &c,
-                tempHmac,
-                NULL);
-
-        HMAC_CTX_cleanup(&c);
+    NtlmGetSessionSecurity(pContext, &Security);
 
-        // Copy only the first part of the hmac
-        memcpy(pSignature->v2.encrypted.hmac,
-                tempHmac,
-                sizeof(pSignature->v2.encrypted.hmac));
-    }
-    else
-    {
-        dwError = NtlmCrc32(
-                pMessage,
-                &pSignature->v1.encrypted.dwCrc32);
-        BAIL_ON_LSA_ERROR(dwError);
-    }
+    dwError = NtlmSessionMakeSignature(&Security, pMessage);
+    BAIL_ON_LSA_ERROR(dwError);
 
 cleanup:
     return dwError;
@@ -202,35 +76,3 @@ cleanup:
 error:
     goto cleanup;
 }
-
-VOID
-NtlmFinalizeSignature(
-    PNTLM_CONTEXT pContext,
-    PNTLM_SIGNATURE pSignature
-    )
-{
-    if (pContext->NegotiatedFlags & NTLM_FLAG_NTLM2)
-    {
-        // The davenport doc says that the hmac is sealed after being generated
-        // with the signing key. In reality that only happens if the key
-        // exchange flag is set.
-        if (pContext->NegotiatedFlags & NTLM_FLAG_KEY_EXCH)
-        {
-            RC4(
-                pContext->pSealKey,
-                sizeof(pSignature->v2.encrypted),
-                (PBYTE)&pSignature->v2.encrypted,
-                (PBYTE)&pSignature->v2.encrypted);
-        }
-    }
-    else
-    {
-        RC4(
-            pContext->pSealKey,
-            sizeof(pSignature->v1.encrypted),
-            (PBYTE)&pSignature->v1.encrypted,
-            (PBYTE)&pSignature->v1.encrypted);
-
-        pSignature->v1.encrypted.dwCounterValue = NTLM_COUNTER_VALUE;
-    }
-}
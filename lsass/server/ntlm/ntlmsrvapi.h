@@ -54,6 +54,7 @@
 
 #include <ntlm/sspintlm.h>
 #include <ntlmipc.h>
+#include <ntlmsession.h>
 
 #include <openssl/des.h>
 #include <openssl/md5.h>
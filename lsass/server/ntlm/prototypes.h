@@ -97,29 +97,22 @@ NtlmServerEncryptMessage(
     );
 
 DWORD
-NtlmInitializeSignature(
-    PNTLM_CONTEXT pContext,
-    const PSecBufferDesc pMessage,
-    PNTLM_SIGNATURE pSignature
-    );
-
-VOID
-NtlmFinalizeSignature(
-    PNTLM_CONTEXT pContext,
-    PNTLM_SIGNATURE pSignature
+NtlmServerExportSecurityContext(
+    IN PNTLM_CONTEXT_HANDLE phContext,
+    IN DWORD fFlags,
+    OUT PSecBuffer pPackedContext
     );
 
 DWORD
-NtlmCrc32(
-    const SecBufferDesc* pMessage,
-    PDWORD pdwCrc32
+NtlmServerExportSessionState(
+    IN PNTLM_CONTEXT_HANDLE phContext,
+    OUT PNTLM_IPC_SESSION_STATE pState
     );
 
 DWORD
-NtlmServerExportSecurityContext(
+NtlmServerImportSessionState(
     IN PNTLM_CONTEXT_HANDLE phContext,
-    IN DWORD fFlags,
-    OUT PSecBuffer pPackedContext
+    IN const NTLM_IPC_SESSION_STATE* pState
     );
 
 DWORD
@@ -186,13 +179,6 @@ NtlmServerVerifySignature(
     OUT PDWORD pQop
     );
 
-DWORD
-NtlmVerifySignature(
-    IN PNTLM_CONTEXT pContext,
-    IN const SecBufferDesc* pMessage,
-    IN const SecBuffer* pToken
-    );
-
 DWORD
 NtlmServerQueryCtxtNameAttribute(
     IN PNTLM_CONTEXT_HANDLE phContext,
@@ -238,6 +224,37 @@ NtlmGetContextInfo(
     OUT OPTIONAL PBOOLEAN pMappedToGuest
     );
 
+VOID
+NtlmGetSessionSecurity(
+    IN PNTLM_CONTEXT pContext,
+    OUT PNTLM_SESSION_SECURITY pSecurity
+    );
+
+DWORD
+NtlmSessionMakeSignature(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN OUT PSecBufferDesc pMessage
+    );
+
+DWORD
+NtlmSessionVerifySignature(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN const SecBufferDesc* pMessage
+    );
+
+DWORD
+NtlmSessionEncryptMessage(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN BOOLEAN bEncrypt,
+    IN OUT PSecBufferDesc pMessage
+    );
+
+DWORD
+NtlmSessionDecryptMessage(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN OUT PSecBufferDesc pMessage
+    );
+
 DWORD
 NtlmCreateContext(
     IN NTLM_CRED_HANDLE hCred,
@@ -601,13 +618,6 @@ NtlmGetProcessSecurity(
     OUT gid_t* pGid
     );
 
-VOID
-NtlmGetSecBuffers(
-    PSecBufferDesc pMessage,
-    PSecBuffer* ppToken,
-    PSecBuffer* ppPadding
-    );
-
 DWORD
 NtlmReadRegistry(
     OUT PNTLM_CONFIG pConfig
@@ -0,0 +1,595 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright Likewise Software    2004-2008
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.  You should have received a copy of the GNU General
+ * Public License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        signseal.c
+ *
+ * Abstract:
+ *
+ *        Likewise Security and Authentication Subsystem (LSASS)
+ *
+ *        NTLM MakeSignature, VerifySignature, EncryptMessage and
+ *        DecryptMessage over the session security state of a context
+ *
+ * Authors: Krishna Ganugapati (krishnag@likewisesoftware.com)
+ *          Marc Guy (mguy@likewisesoftware.com)
+ */
+
+#include "ntlmsrvapi.h"
+
+static
+VOID
+NtlmGetSecBuffers(
+    PSecBufferDesc pMessage,
+    PSecBuffer* ppToken,
+    PSecBuffer* ppPadding
+    )
+{
+    DWORD dwIndex = 0;
+    PSecBuffer pToken = NULL;
+    PSecBuffer pPadding = NULL;
+
+    for (dwIndex = 0; dwIndex < pMessage->cBuffers; dwIndex++)
+    {
+        if (pMessage->pBuffers[dwIndex].BufferType == SECBUFFER_TOKEN)
+        {
+            if (!pToken)
+            {
+                pToken = &pMessage->pBuffers[dwIndex];
+            }
+        }
+        else if (pMessage->pBuffers[dwIndex].BufferType == SECBUFFER_PADDING)
+        {
+            if (!pPadding)
+            {
+                pPadding = &pMessage->pBuffers[dwIndex];
+            }
+        }
+    }
+
+    if (ppToken)
+    {
+        *ppToken = pToken;
+    }
+
+    if (ppPadding)
+    {
+        *ppPadding = pPadding;
+    }
+}
+
+static
+DWORD
+NtlmSessionCheckDataBuffers(
+    IN const SecBufferDesc* pMessage
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    DWORD dwIndex = 0;
+    BOOLEAN bFoundData = FALSE;
+    // Do not free
+    SecBuffer* pData = NULL;
+
+    for (dwIndex = 0 ; dwIndex < pMessage->cBuffers ; dwIndex++)
+    {
+        pData = &pMessage->pBuffers[dwIndex];
+
+        if ((pData->BufferType & ~SECBUFFER_ATTRMASK) == SECBUFFER_DATA)
+        {
+            if (!pData->pvBuffer)
+            {
+                dwError = LW_ERROR_INVALID_PARAMETER;
+                BAIL_ON_LSA_ERROR(dwError);
+            }
+
+            bFoundData = TRUE;
+        }
+    }
+
+    if (!bFoundData)
+    {
+        dwError = LW_ERROR_INVALID_PARAMETER;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+error:
+    return dwError;
+}
+
+static
+DWORD
+NtlmSessionGetToken(
+    IN const SecBufferDesc* pMessage,
+    OUT PSecBuffer* ppToken
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    // The following pointers point into pMessage and will not be freed
+    PSecBuffer pToken = NULL;
+
+    NtlmGetSecBuffers((PSecBufferDesc)pMessage, &pToken, NULL);
+
+    // Do a full sanity check here
+    if (!pToken ||
+        pToken->cbBuffer != sizeof(NTLM_SIGNATURE) ||
+        !pToken->pvBuffer)
+    {
+        dwError = LW_ERROR_INVALID_PARAMETER;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    // Refuse the message before the sequence number moves, so that a bad
+    // call does not desynchronize the peers
+    dwError = NtlmSessionCheckDataBuffers(pMessage);
+    BAIL_ON_LSA_ERROR(dwError);
+
+cleanup:
+    *ppToken = pToken;
+    return dwError;
+
+error:
+    pToken = NULL;
+    goto cleanup;
+}
+
+static
+DWORD
+NtlmSessionInitializeSignature(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN const SecBufferDesc* pMessage,
+    OUT PNTLM_SIGNATURE pSignature
+    )
+{
+    DWORD dwError = 0;
+    DWORD dwIndex = 0;
+    // Do not free
+    SecBuffer *pData = NULL;
+
+    if (!pSecurity->pdwSendMsgSeq)
+    {
+        dwError = ERROR_INVALID_PARAMETER;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    pSignature->dwVersion = 1;
+    pSignature->v2.dwMsgSeqNum = *pSecurity->pdwSendMsgSeq;
+    (*pSecurity->pdwSendMsgSeq)++;
+
+    if (pSecurity->NegotiatedFlags & NTLM_FLAG_NTLM2)
+    {
+        unsigned char tempHmac[EVP_MAX_MD_SIZE];
+        HMAC_CTX c;
+
+        HMAC_CTX_init(&c);
+        HMAC_Init(
+                &c,
+                pSecurity->pSignKey,
+                NTLM_SESSION_SIGN_KEY_SIZE,
+                EVP_md5());
+
+        HMAC_Update(
+                &c,
+                (PBYTE)&pSignature->v2.dwMsgSeqNum,
+                sizeof(pSignature->v2.dwMsgSeqNum));
+
+        for (dwIndex = 0 ; dwIndex < pMessage->cBuffers ; dwIndex++)
+        {
+            pData = &pMessage->pBuffers[dwIndex];
+
+            if ((pData->BufferType & ~SECBUFFER_ATTRMASK) == SECBUFFER_DATA)
+            {
+                HMAC_Update(
+                        &c,
+                        pData->pvBuffer,
+                        pData->cbBuffer);
+            }
+        }
+
+        HMAC_Final(
+                &c,
+                tempHmac,
+                NULL);
+
+        HMAC_CTX_cleanup(&c);
+
+        // Copy only the first part of the hmac
+        memcpy(pSignature->v2.encrypted.hmac,
+                tempHmac,
+                sizeof(pSignature->v2.encrypted.hmac));
+    }
+    else
+    {
+        dwError = NtlmCrc32(
+                pMessage,
+                &pSignature->v1.encrypted.dwCrc32);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+static
+VOID
+NtlmSessionFinalizeSignature(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN OUT PNTLM_SIGNATURE pSignature
+    )
+{
+    if (pSecurity->NegotiatedFlags & NTLM_FLAG_NTLM2)
+    {
+        // The davenport doc says that the hmac is sealed after being generated
+        // with the signing key. In reality that only happens if the key
+        // exchange flag is set.
+        if (pSecurity->NegotiatedFlags & NTLM_FLAG_KEY_EXCH)
+        {
+            RC4(
+                pSecurity->pSealKey,
+                sizeof(pSignature->v2.encrypted),
+                (PBYTE)&pSignature->v2.encrypted,
+                (PBYTE)&pSignature->v2.encrypted);
+        }
+    }
+    else
+    {
+        RC4(
+            pSecurity->pSealKey,
+            sizeof(pSignature->v1.encrypted),
+            (PBYTE)&pSignature->v1.encrypted,
+            (PBYTE)&pSignature->v1.encrypted);
+
+        pSignature->v1.encrypted.dwCounterValue = NTLM_COUNTER_VALUE;
+    }
+}
+
+static
+DWORD
+NtlmSessionCheckSignature(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN const SecBufferDesc* pMessage,
+    IN const SecBuffer* pToken
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    DWORD dwCrc32 = 0;
+    NTLM_SIGNATURE signature;
+    DWORD dwIndex = 0;
+    // Do not free
+    SecBuffer* pData = NULL;
+
+    memcpy(&signature, pToken->pvBuffer, sizeof(signature));
+
+    if (pSecurity->NegotiatedFlags & NTLM_FLAG_NTLM2)
+    {
+        unsigned char tempHmac[EVP_MAX_MD_SIZE];
+        HMAC_CTX c;
+
+        if (!(pSecurity->NegotiatedFlags & NTLM_FLAG_SIGN))
+        {
+            dwError = LW_ERROR_INVALID_PARAMETER;
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+
+        HMAC_CTX_init(&c);
+        HMAC_Init(
+                &c,
+                pSecurity->pVerifyKey,
+                NTLM_SESSION_SIGN_KEY_SIZE,
+                EVP_md5());
+
+        HMAC_Update(
+                &c,
+                (PBYTE)&signature.v2.dwMsgSeqNum,
+                sizeof(signature.v2.dwMsgSeqNum));
+
+        for (dwIndex = 0 ; dwIndex < pMessage->cBuffers ; dwIndex++)
+        {
+            pData = &pMessage->pBuffers[dwIndex];
+
+            if ((pData->BufferType & ~SECBUFFER_ATTRMASK) == SECBUFFER_DATA)
+            {
+                HMAC_Update(
+                        &c,
+                        pData->pvBuffer,
+                        pData->cbBuffer);
+            }
+        }
+
+        HMAC_Final(
+                &c,
+                tempHmac,
+                NULL);
+
+        HMAC_CTX_cleanup(&c);
+
+        // The davenport doc says that the hmac is sealed after being generated
+        // with the signing key. In reality that only happens if the key
+        // exchange flag is set.
+        if (pSecurity->NegotiatedFlags & NTLM_FLAG_KEY_EXCH)
+        {
+            RC4(
+                pSecurity->pUnsealKey,
+                sizeof(signature.v2.encrypted.hmac),
+                signature.v2.encrypted.hmac,
+                signature.v2.encrypted.hmac);
+        }
+
+        if (memcmp(signature.v2.encrypted.hmac,
+                    tempHmac,
+                    sizeof(signature.v2.encrypted.hmac)))
+        {
+            dwError = ERROR_CRC;
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+    }
+    else
+    {
+        RC4(
+            pSecurity->pUnsealKey,
+            sizeof(signature.v1.encrypted),
+            (PBYTE)&signature.v1.encrypted,
+            (PBYTE)&signature.v1.encrypted);
+        signature.v1.encrypted.dwCounterValue = 0;
+
+        if (pSecurity->NegotiatedFlags & NTLM_FLAG_ALWAYS_SIGN)
+        {
+            // Use the dummy signature 0x01000000000000000000000000000000
+            dwCrc32 = 0;
+        }
+        else if (pSecurity->NegotiatedFlags & NTLM_FLAG_SIGN)
+        {
+            // generate a crc for the message
+            dwError = NtlmCrc32(pMessage, &dwCrc32);
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+        else
+        {
+            dwError = LW_ERROR_INVALID_PARAMETER;
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+
+        if (dwCrc32 != signature.v1.encrypted.dwCrc32)
+        {
+            dwError = ERROR_CRC;
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+    }
+
+    if (!pSecurity->pdwRecvMsgSeq)
+    {
+        dwError = ERROR_INVALID_PARAMETER;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+    if (*pSecurity->pdwRecvMsgSeq != signature.v2.dwMsgSeqNum)
+    {
+        dwError = ERROR_REQUEST_OUT_OF_SEQUENCE;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+    (*pSecurity->pdwRecvMsgSeq)++;
+
+cleanup:
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+DWORD
+NtlmSessionMakeSignature(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN OUT PSecBufferDesc pMessage
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    // The following pointers point into pMessage and will not be freed
+    PSecBuffer pToken = NULL;
+    PNTLM_SIGNATURE pSignature = NULL;
+
+    dwError = NtlmSessionGetToken(pMessage, &pToken);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pSignature = (PNTLM_SIGNATURE)pToken->pvBuffer;
+
+    if (pSecurity->NegotiatedFlags & NTLM_FLAG_ALWAYS_SIGN)
+    {
+        // Use the dummy signature 0x01000000000000000000000000000000
+        pSignature->dwVersion = NTLM_VERSION;
+        pSignature->v1.encrypted.dwCounterValue = 0;
+        pSignature->v1.encrypted.dwCrc32 = 0;
+        pSignature->v1.encrypted.dwMsgSeqNum = 0;
+    }
+    else if (pSecurity->NegotiatedFlags & NTLM_FLAG_SIGN)
+    {
+        dwError = NtlmSessionInitializeSignature(
+                    pSecurity,
+                    pMessage,
+                    pSignature);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        NtlmSessionFinalizeSignature(pSecurity, pSignature);
+    }
+    else
+    {
+        dwError = LW_ERROR_INVALID_PARAMETER;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+DWORD
+NtlmSessionVerifySignature(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN const SecBufferDesc* pMessage
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    // The following pointers point into pMessage and will not be freed
+    PSecBuffer pToken = NULL;
+
+    dwError = NtlmSessionGetToken(pMessage, &pToken);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = NtlmSessionCheckSignature(pSecurity, pMessage, pToken);
+    BAIL_ON_LSA_ERROR(dwError);
+
+cleanup:
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+DWORD
+NtlmSessionEncryptMessage(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN BOOLEAN bEncrypt,
+    IN OUT PSecBufferDesc pMessage
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    // The following pointers point into pMessage and will not be freed
+    PSecBuffer pToken = NULL;
+    PSecBuffer pData = NULL;
+    PNTLM_SIGNATURE pSignature = NULL;
+    DWORD dwIndex = 0;
+
+    // Sanity check to see if we handle sealing
+    if (bEncrypt && !(pSecurity->NegotiatedFlags & NTLM_FLAG_SEAL))
+    {
+        dwError = LW_ERROR_INVALID_PARAMETER;
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    // The message should be in the format of:
+    // SECBUFFER_TOKEN      - Where the signature is placed
+    // SECBUFFER_DATA       - The data we are signing
+    // SECBUFFER_PADDING    - Padding (for RC4 or CRC32?) - ignore padding
+    //
+    // Find these buffers... the first one found of each type will be the one
+    // that is used.
+    dwError = NtlmSessionGetToken(pMessage, &pToken);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    pSignature = (PNTLM_SIGNATURE)pToken->pvBuffer;
+
+    // Sign the original message before sealing it.
+    dwError = NtlmSessionInitializeSignature(
+                pSecurity,
+                pMessage,
+                pSignature);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    // Always encrypt the message to match Windows' behavior
+    for (dwIndex = 0 ; dwIndex < pMessage->cBuffers ; dwIndex++)
+    {
+        pData = &pMessage->pBuffers[dwIndex];
+
+        if (pData->BufferType == SECBUFFER_DATA)
+        {
+            RC4(
+                pSecurity->pSealKey,
+                pData->cbBuffer,
+                pData->pvBuffer,
+                pData->pvBuffer);
+        }
+    }
+
+    NtlmSessionFinalizeSignature(pSecurity, pSignature);
+
+cleanup:
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+DWORD
+NtlmSessionDecryptMessage(
+    IN PNTLM_SESSION_SECURITY pSecurity,
+    IN OUT PSecBufferDesc pMessage
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    // The following pointers point into pMessage and will not be freed
+    PSecBuffer pToken = NULL;
+    PSecBuffer pData = NULL;
+    DWORD dwIndex = 0;
+
+    dwError = NtlmSessionGetToken(pMessage, &pToken);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    for (dwIndex = 0 ; dwIndex < pMessage->cBuffers ; dwIndex++)
+    {
+        pData = &pMessage->pBuffers[dwIndex];
+
+        if (pData->BufferType == SECBUFFER_DATA)
+        {
+            RC4(
+                pSecurity->pUnsealKey,
+                pData->cbBuffer,
+                pData->pvBuffer,
+                pData->pvBuffer);
+        }
+    }
+
+    //verify the key
+    dwError = NtlmSessionCheckSignature(
+        pSecurity,
+        pMessage,
+        pToken);
+    BAIL_ON_LSA_ERROR(dwError);
+
+cleanup:
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+/*
+local variables:
+mode: c
+c-basic-offset: 4
+indent-tabs-mode: nil
+tab-width: 4
+end:
+*/
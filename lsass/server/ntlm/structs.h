@@ -249,6 +249,10 @@ typedef struct _NTLM_CONTEXT
     DWORD *pdwRecvMsgSeq;
 
     BOOLEAN MappedToGuest;
+
+    // Set once the sealing state has been handed to the client with
+    // NtlmServerExportSessionState. The copy kept here is stale from then on.
+    BOOLEAN bSessionExported;
 } NTLM_CONTEXT, *PNTLM_CONTEXT;
 
 typedef struct _NTLM_CREDENTIALS
@@ -0,0 +1,402 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright Likewise Software    2004-2008
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.  You should have received a copy of the GNU General
+ * Public License along with this program.  If not, see 
+ * <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        main.c
+ *
+ * Abstract:
+ *
+ *        Likewise Security and Authentication Subsystem (LSASS)
+ *
+ *        Lock contention benchmark for the AD provider caches
+ *
+ *        Measures FindUserByName throughput with reader threads alone,
+ *        and again while writer threads keep refreshing users, first in
+ *        batches of STORE_BATCH objects per store and then one object
+ *        per store. The backend is picked by name, as with the
+ *        CacheType setting. Link it with the ad-open-provider objects
+ *        and sqlite.
+ *
+ *        Usage: test_adcache_contention memory|sqlite
+ *                   [readers [writers [seconds]]]
+ *
+ */
+
+#include "adprovider.h"
+#include <stdio.h>
+#include <pthread.h>
+
+#define USER_COUNT      10000
+#define STORE_BATCH     20
+#define MAX_THREADS     64
+
+typedef struct _BENCH_STATE
+{
+    ADCACHE_PROVIDER_FUNCTION_TABLE cache;
+    LSA_DB_HANDLE hDb;
+    PLSA_SECURITY_OBJECT* ppUsers;
+    DWORD dwStoreBatch;
+    volatile BOOLEAN bStop;
+} BENCH_STATE, *PBENCH_STATE;
+
+typedef struct _BENCH_THREAD
+{
+    PBENCH_STATE pState;
+    pthread_t thread;
+    unsigned int seed;
+    UINT64 qwCalls;
+    DWORD dwError;
+} BENCH_THREAD, *PBENCH_THREAD;
+
+static
+DWORD
+CreateUsers(
+    OUT PLSA_SECURITY_OBJECT** pppUsers
+    )
+{
+    DWORD dwError = 0;
+    PLSA_SECURITY_OBJECT* ppUsers = NULL;
+    PLSA_SECURITY_OBJECT pUser = NULL;
+    DWORD dwIndex = 0;
+
+    dwError = LwAllocateMemory(
+                    sizeof(*ppUsers) * USER_COUNT,
+                    (PVOID*)&ppUsers);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    for (dwIndex = 0; dwIndex < USER_COUNT; dwIndex++)
+    {
+        dwError = LwAllocateMemory(sizeof(*pUser), (PVOID*)&pUser);
+        BAIL_ON_LSA_ERROR(dwError);
+        ppUsers[dwIndex] = pUser;
+
+        // Not stored yet, as for objects fresh from AD
+        pUser->version.qwDbId = -1;
+        pUser->type = LSA_OBJECT_TYPE_USER;
+        pUser->enabled = TRUE;
+        pUser->userInfo.uid = 100000 + dwIndex;
+        pUser->userInfo.gid = 100000;
+
+        dwError = LwAllocateStringPrintf(
+                        &pUser->pszObjectSid,
+                        "S-1-5-21-1111-2222-3333-%u",
+                        dwIndex + 1000);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwAllocateStringPrintf(
+                        &pUser->pszDN,
+                        "CN=bench%u,CN=Users,DC=bench,DC=example,DC=com",
+                        dwIndex);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwAllocateString("BENCH", &pUser->pszNetbiosDomainName);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwAllocateStringPrintf(
+                        &pUser->pszSamAccountName,
+                        "bench%u",
+                        dwIndex);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwAllocateString(
+                        pUser->pszSamAccountName,
+                        &pUser->userInfo.pszAliasName);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwAllocateStringPrintf(
+                        &pUser->userInfo.pszUPN,
+                        "bench%u@BENCH.EXAMPLE.COM",
+                        dwIndex);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    *pppUsers = ppUsers;
+
+cleanup:
+    return dwError;
+
+error:
+    if (ppUsers)
+    {
+        ADCacheSafeFreeObjectList(USER_COUNT, &ppUsers);
+    }
+    *pppUsers = NULL;
+    goto cleanup;
+}
+
+static
+PVOID
+LookupThread(
+    PVOID pArg
+    )
+{
+    PBENCH_THREAD pThread = (PBENCH_THREAD)pArg;
+    LSA_LOGIN_NAME_INFO nameInfo = { 0 };
+    PLSA_SECURITY_OBJECT pObject = NULL;
+    DWORD dwIndex = 0;
+
+    nameInfo.nameType = NameType_Alias;
+
+    while (!pThread->pState->bStop)
+    {
+        dwIndex = rand_r(&pThread->seed) % USER_COUNT;
+        nameInfo.pszName =
+            pThread->pState->ppUsers[dwIndex]->userInfo.pszAliasName;
+
+        pThread->dwError = pThread->pState->cache.pfnFindUserByName(
+                                pThread->pState->hDb,
+                                &nameInfo,
+                                &pObject);
+        if (pThread->dwError)
+        {
+            break;
+        }
+
+        ADCacheSafeFreeObject(&pObject);
+        pThread->qwCalls++;
+    }
+
+    return NULL;
+}
+
+static
+PVOID
+StoreThread(
+    PVOID pArg
+    )
+{
+    PBENCH_THREAD pThread = (PBENCH_THREAD)pArg;
+    DWORD dwIndex = 0;
+
+    while (!pThread->pState->bStop)
+    {
+        dwIndex = rand_r(&pThread->seed) % (USER_COUNT - STORE_BATCH);
+
+        pThread->dwError = pThread->pState->cache.pfnStoreObjectEntries(
+                                pThread->pState->hDb,
+                                pThread->pState->dwStoreBatch,
+                                &pThread->pState->ppUsers[dwIndex]);
+        if (pThread->dwError)
+        {
+            break;
+        }
+
+        pThread->qwCalls++;
+    }
+
+    return NULL;
+}
+
+static
+DWORD
+RunMix(
+    PBENCH_STATE pState,
+    int readers,
+    int writers,
+    int seconds
+    )
+{
+    DWORD dwError = 0;
+    BENCH_THREAD threads[MAX_THREADS * 2] = { { 0 } };
+    int started = 0;
+    int i = 0;
+    UINT64 qwLookups = 0;
+    UINT64 qwStores = 0;
+
+    pState->bStop = FALSE;
+
+    for (started = 0; started < readers + writers; started++)
+    {
+        threads[started].pState = pState;
+        threads[started].seed = started + 1;
+
+        dwError = LwMapErrnoToLwError(pthread_create(
+                        &threads[started].thread,
+                        NULL,
+                        started < readers ? LookupThread : StoreThread,
+                        &threads[started]));
+        if (dwError)
+        {
+            break;
+        }
+    }
+
+    if (!dwError)
+    {
+        sleep(seconds);
+    }
+
+    pState->bStop = TRUE;
+
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(threads[i].thread, NULL);
+
+        if (threads[i].dwError && !dwError)
+        {
+            dwError = threads[i].dwError;
+        }
+
+        if (i < readers)
+        {
+            qwLookups += threads[i].qwCalls;
+        }
+        else
+        {
+            qwStores += threads[i].qwCalls;
+        }
+    }
+
+    printf("%2d readers, %2d writers, %2u objects per store: "
+           "%12.0f lookups/sec %10.0f objects stored/sec\n",
+           readers,
+           writers,
+           pState->dwStoreBatch,
+           (double)qwLookups / seconds,
+           (double)qwStores * pState->dwStoreBatch / seconds);
+
+    return dwError;
+}
+
+int
+main(
+    int argc,
+    char** argv
+    )
+{
+    DWORD dwError = 0;
+    BENCH_STATE state = { 0 };
+    char szPath[] = "/tmp/test_adcache_contention.XXXXXX";
+    int fd = -1;
+    int readers = 8;
+    int writers = 1;
+    int seconds = 5;
+    // Files sqlite keeps next to the database
+    PCSTR pszSuffixes[] = { "-journal", "-wal", "-shm" };
+    char szSidePath[sizeof(szPath) + 16];
+    size_t i = 0;
+
+    if (argc > 1 && !strcmp(argv[1], "memory"))
+    {
+        InitializeMemCacheProvider(&state.cache);
+    }
+    else if (argc > 1 && !strcmp(argv[1], "sqlite"))
+    {
+        InitializeDbCacheProvider(&state.cache);
+    }
+    if (argc > 2)
+    {
+        readers = atoi(argv[2]);
+    }
+    if (argc > 3)
+    {
+        writers = atoi(argv[3]);
+    }
+    if (argc > 4)
+    {
+        seconds = atoi(argv[4]);
+    }
+
+    if (!state.cache.pfnOpenHandle ||
+        readers < 1 || readers > MAX_THREADS ||
+        writers < 0 || writers > MAX_THREADS ||
+        seconds < 1)
+    {
+        fprintf(stderr,
+                "Usage: %s memory|sqlite [readers [writers [seconds]]]\n",
+                argv[0]);
+        return 1;
+    }
+
+    fd = mkstemp(szPath);
+    if (fd < 0)
+    {
+        dwError = LwMapErrnoToLwError(errno);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+    close(fd);
+    // Neither cache may be given an empty file; each creates its own
+    unlink(szPath);
+
+    dwError = CreateUsers(&state.ppUsers);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = state.cache.pfnOpenHandle(szPath, NULL, &state.hDb);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = state.cache.pfnStoreObjectEntries(
+                    state.hDb,
+                    USER_COUNT,
+                    state.ppUsers);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    state.dwStoreBatch = STORE_BATCH;
+
+    dwError = RunMix(&state, readers, 0, seconds);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    if (writers)
+    {
+        dwError = RunMix(&state, readers, writers, seconds);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        state.dwStoreBatch = 1;
+
+        dwError = RunMix(&state, readers, writers, seconds);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+    if (state.hDb)
+    {
+        state.cache.pfnSafeClose(&state.hDb);
+    }
+    unlink(szPath);
+    for (i = 0; i < sizeof(pszSuffixes) / sizeof(pszSuffixes[0]); i++)
+    {
+        snprintf(szSidePath, sizeof(szSidePath), "%s%s", szPath, pszSuffixes[i]);
+        unlink(szSidePath);
+    }
+    if (state.ppUsers)
+    {
+        ADCacheSafeFreeObjectList(USER_COUNT, &state.ppUsers);
+    }
+
+    return dwError ? 1 : 0;
+
+error:
+    fprintf(stderr, "Benchmark failed with error %u\n", dwError);
+    goto cleanup;
+}
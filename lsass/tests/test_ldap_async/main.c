@@ -0,0 +1,887 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright Likewise Software    2004-2008
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.  You should have received a copy of the GNU General
+ * Public License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        main.c
+ *
+ * Abstract:
+ *
+ *        Likewise Security and Authentication Subsystem (LSASS)
+ *
+ *        Test program for the asynchronous lwldap searches used by
+ *        the AD provider
+ *
+ *        The timeout, abandon and connection loss tests run against a
+ *        fake server in this process, which answers the bind and then
+ *        stays silent or hangs up.  Given a server, the concurrent
+ *        search tests also run against a real directory holding
+ *        inetOrgPerson entries uid=user0 ... uid=user<n-1> under
+ *        <baseDn> (see run_slapd.sh for the in-tree slapd).
+ *
+ *        Usage: test_ldap_async [<serverAddress[:port]> <baseDn>]
+ *
+ */
+
+#include "config.h"
+#include "lsasystem.h"
+#include "lsadef.h"
+#include "lwmem.h"
+#include "lwstr.h"
+#include "lwerror.h"
+#include "lwldap.h"
+
+#include <stdio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define BAIL_ON_TEST_ERROR(dwError) \
+    do { \
+        if (dwError) \
+        { \
+            printf("%s:%d: error %u\n", __FILE__, __LINE__, (dwError)); \
+            goto error; \
+        } \
+    } while (0)
+
+#define TEST_ASSERT(expr) \
+    do { \
+        if (!(expr)) \
+        { \
+            printf("%s:%d: assertion failed: %s\n", __FILE__, __LINE__, #expr); \
+            dwError = LW_ERROR_INTERNAL; \
+            goto error; \
+        } \
+    } while (0)
+
+#define LDAP_REQ_BIND_TAG      0x60
+#define LDAP_REQ_UNBIND_TAG    0x42
+#define LDAP_REQ_SEARCH_TAG    0x63
+#define LDAP_REQ_ABANDON_TAG   0x50
+
+#define MAX_FAKE_REQUESTS      32
+#define CONCURRENT_SEARCHES    24
+
+//
+// Fake server
+//
+
+typedef struct _FAKE_SERVER
+{
+    int ListenFd;
+    int ClientFd;
+    USHORT usPort;
+    pthread_t Thread;
+    pthread_mutex_t Mutex;
+    // Protocol op tags of the requests read so far
+    BYTE Requests[MAX_FAKE_REQUESTS];
+    DWORD dwRequestCount;
+} FAKE_SERVER, *PFAKE_SERVER;
+
+static
+BOOLEAN
+ReadAll(
+    int fd,
+    PBYTE pBuffer,
+    size_t length
+    )
+{
+    ssize_t count = 0;
+
+    while (length)
+    {
+        count = read(fd, pBuffer, length);
+        if (count <= 0)
+        {
+            return FALSE;
+        }
+        pBuffer += count;
+        length -= count;
+    }
+
+    return TRUE;
+}
+
+// Reads one LDAPMessage and returns its message id (as encoded) and
+// protocol op tag
+static
+BOOLEAN
+ReadRequest(
+    int fd,
+    PBYTE pMessageId,
+    PDWORD pdwMessageIdLength,
+    PBYTE pOpTag
+    )
+{
+    BYTE header[2] = {0};
+    BYTE lengthBytes[4] = {0};
+    BYTE body[4096];
+    size_t length = 0;
+    DWORD dwIndex = 0;
+
+    if (!ReadAll(fd, header, sizeof(header)) || header[0] != 0x30)
+    {
+        return FALSE;
+    }
+
+    if (header[1] & 0x80)
+    {
+        if ((header[1] & 0x7f) > sizeof(lengthBytes) ||
+            !ReadAll(fd, lengthBytes, header[1] & 0x7f))
+        {
+            return FALSE;
+        }
+        for (dwIndex = 0; dwIndex < (header[1] & 0x7f); dwIndex++)
+        {
+            length = (length << 8) | lengthBytes[dwIndex];
+        }
+    }
+    else
+    {
+        length = header[1];
+    }
+
+    if (length > sizeof(body) || !ReadAll(fd, body, length))
+    {
+        return FALSE;
+    }
+
+    // messageID INTEGER, then the protocol op
+    if (length < 3 || body[0] != 0x02 || body[1] > 4 || length < 2 + body[1] + 1)
+    {
+        return FALSE;
+    }
+
+    memcpy(pMessageId, &body[2], body[1]);
+    *pdwMessageIdLength = body[1];
+    *pOpTag = body[2 + body[1]];
+
+    return TRUE;
+}
+
+static
+PVOID
+FakeServerThread(
+    PVOID pContext
+    )
+{
+    PFAKE_SERVER pServer = (PFAKE_SERVER) pContext;
+    BYTE messageId[4] = {0};
+    DWORD dwMessageIdLength = 0;
+    BYTE opTag = 0;
+    BYTE response[32];
+    size_t length = 0;
+    int fd = -1;
+
+    fd = accept(pServer->ListenFd, NULL, NULL);
+
+    pthread_mutex_lock(&pServer->Mutex);
+    pServer->ClientFd = fd;
+    pthread_mutex_unlock(&pServer->Mutex);
+
+    while (fd >= 0 && ReadRequest(fd, messageId, &dwMessageIdLength, &opTag))
+    {
+        pthread_mutex_lock(&pServer->Mutex);
+        if (pServer->dwRequestCount < MAX_FAKE_REQUESTS)
+        {
+            pServer->Requests[pServer->dwRequestCount++] = opTag;
+        }
+        pthread_mutex_unlock(&pServer->Mutex);
+
+        if (opTag == LDAP_REQ_BIND_TAG)
+        {
+            // BindResponse: success, empty matchedDN and diagnosticMessage
+            length = 0;
+            response[length++] = 0x30;
+            response[length++] = 2 + dwMessageIdLength + 9;
+            response[length++] = 0x02;
+            response[length++] = dwMessageIdLength;
+            memcpy(&response[length], messageId, dwMessageIdLength);
+            length += dwMessageIdLength;
+            memcpy(&response[length], "\x61\x07\x0a\x01\x00\x04\x00\x04\x00", 9);
+            length += 9;
+
+            if (write(fd, response, length) != (ssize_t) length)
+            {
+                break;
+            }
+        }
+        // Everything else goes unanswered
+    }
+
+    return NULL;
+}
+
+static
+DWORD
+FakeServerStart(
+    PFAKE_SERVER pServer
+    )
+{
+    DWORD dwError = 0;
+    struct sockaddr_in addr;
+    socklen_t addrLength = sizeof(addr);
+
+    memset(pServer, 0, sizeof(*pServer));
+    pServer->ListenFd = -1;
+    pServer->ClientFd = -1;
+    pthread_mutex_init(&pServer->Mutex, NULL);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    pServer->ListenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (pServer->ListenFd < 0 ||
+        bind(pServer->ListenFd, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+        listen(pServer->ListenFd, 1) < 0 ||
+        getsockname(pServer->ListenFd, (struct sockaddr*) &addr, &addrLength) < 0)
+    {
+        dwError = LwMapErrnoToLwError(errno);
+        BAIL_ON_TEST_ERROR(dwError);
+    }
+
+    pServer->usPort = ntohs(addr.sin_port);
+
+    dwError = LwMapErrnoToLwError(pthread_create(&pServer->Thread, NULL, FakeServerThread, pServer));
+    BAIL_ON_TEST_ERROR(dwError);
+
+error:
+
+    return dwError;
+}
+
+// Hangs up on the client as if the server had gone away
+static
+VOID
+FakeServerDisconnect(
+    PFAKE_SERVER pServer
+    )
+{
+    pthread_mutex_lock(&pServer->Mutex);
+    if (pServer->ClientFd >= 0)
+    {
+        shutdown(pServer->ClientFd, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&pServer->Mutex);
+}
+
+static
+VOID
+FakeServerStop(
+    PFAKE_SERVER pServer
+    )
+{
+    FakeServerDisconnect(pServer);
+    // Also wakes the server if the client never connected
+    shutdown(pServer->ListenFd, SHUT_RDWR);
+    pthread_join(pServer->Thread, NULL);
+
+    if (pServer->ClientFd >= 0)
+    {
+        close(pServer->ClientFd);
+    }
+    close(pServer->ListenFd);
+    pthread_mutex_destroy(&pServer->Mutex);
+}
+
+// Waits up to 5 seconds for the server to have read dwCount requests
+static
+DWORD
+FakeServerGetRequests(
+    PFAKE_SERVER pServer,
+    DWORD dwCount,
+    PBYTE pRequests
+    )
+{
+    DWORD dwError = 0;
+    DWORD dwWait = 0;
+    DWORD dwHave = 0;
+
+    for (dwWait = 0; dwWait < 500; dwWait++)
+    {
+        pthread_mutex_lock(&pServer->Mutex);
+        dwHave = pServer->dwRequestCount;
+        memcpy(pRequests, pServer->Requests, dwHave);
+        pthread_mutex_unlock(&pServer->Mutex);
+
+        if (dwHave >= dwCount)
+        {
+            break;
+        }
+        usleep(10000);
+    }
+
+    if (dwHave != dwCount)
+    {
+        printf("Fake server read %u requests, expected %u\n", dwHave, dwCount);
+        dwError = LW_ERROR_INTERNAL;
+    }
+
+    return dwError;
+}
+
+static
+DWORD
+FakeServerOpen(
+    PFAKE_SERVER pServer,
+    PHANDLE phDirectory
+    )
+{
+    DWORD dwError = 0;
+    PSTR pszAddress = NULL;
+
+    dwError = LwAllocateStringPrintf(&pszAddress, "127.0.0.1:%u", pServer->usPort);
+    BAIL_ON_TEST_ERROR(dwError);
+
+    dwError = LwLdapOpenDirectoryServer(
+                    pszAddress,
+                    pszAddress,
+                    LW_LDAP_OPT_ANNONYMOUS,
+                    phDirectory);
+    BAIL_ON_TEST_ERROR(dwError);
+
+error:
+
+    LW_SAFE_FREE_STRING(pszAddress);
+
+    return dwError;
+}
+
+//
+// Search helpers
+//
+
+typedef struct _SEARCH_RESULT
+{
+    DWORD dwCalls;
+    DWORD dwError;
+    int count;
+} SEARCH_RESULT, *PSEARCH_RESULT;
+
+static
+VOID
+SearchCallback(
+    HANDLE hDirectory,
+    PVOID pContext,
+    DWORD dwError,
+    LDAPMessage* pMessage
+    )
+{
+    PSEARCH_RESULT pResult = (PSEARCH_RESULT) pContext;
+
+    pResult->dwCalls++;
+    pResult->dwError = dwError;
+    pResult->count = -1;
+
+    if (pMessage)
+    {
+        pResult->count = ldap_count_entries(LwLdapGetSession(hDirectory), pMessage);
+        ldap_msgfree(pMessage);
+    }
+}
+
+static PSTR gpszAttributes[] = { "uid", NULL };
+
+static
+DWORD
+StartSearch(
+    HANDLE hDirectory,
+    PCSTR pszBaseDn,
+    PCSTR pszQuery,
+    PSEARCH_RESULT pResult,
+    PLW_LDAP_ASYNC_SEARCH* ppSearch
+    )
+{
+    return LwLdapDirectorySearchStart(
+                hDirectory,
+                pszBaseDn,
+                LDAP_SCOPE_SUBTREE,
+                pszQuery,
+                gpszAttributes,
+                NULL,
+                0,
+                pResult ? SearchCallback : NULL,
+                pResult,
+                ppSearch);
+}
+
+static
+DWORD
+CountEntries(
+    HANDLE hDirectory,
+    PCSTR pszBaseDn,
+    PCSTR pszQuery,
+    int* pCount
+    )
+{
+    DWORD dwError = 0;
+    LDAPMessage* pMessage = NULL;
+
+    dwError = LwLdapDirectorySearch(
+                    hDirectory,
+                    pszBaseDn,
+                    LDAP_SCOPE_SUBTREE,
+                    pszQuery,
+                    gpszAttributes,
+                    &pMessage);
+    BAIL_ON_TEST_ERROR(dwError);
+
+    *pCount = ldap_count_entries(LwLdapGetSession(hDirectory), pMessage);
+
+error:
+
+    if (pMessage)
+    {
+        ldap_msgfree(pMessage);
+    }
+
+    return dwError;
+}
+
+//
+// Tests
+//
+
+// A search nobody answers stays outstanding through a dispatch timeout,
+// and both abandoning it and closing the directory reach the server.
+static
+DWORD
+TestTimeoutAndAbandon(
+    VOID
+    )
+{
+    DWORD dwError = 0;
+    FAKE_SERVER server;
+    BOOLEAN bServerStarted = FALSE;
+    HANDLE hDirectory = NULL;
+    SEARCH_RESULT result = {0};
+    PLW_LDAP_ASYNC_SEARCH pSearch = NULL;
+    DWORD dwOutstanding = 0;
+    BYTE requests[MAX_FAKE_REQUESTS];
+    const BYTE expected[] =
+    {
+        LDAP_REQ_BIND_TAG,
+        LDAP_REQ_SEARCH_TAG,
+        LDAP_REQ_SEARCH_TAG,
+        LDAP_REQ_ABANDON_TAG,
+        LDAP_REQ_ABANDON_TAG,
+        LDAP_REQ_UNBIND_TAG
+    };
+
+    dwError = FakeServerStart(&server);
+    BAIL_ON_TEST_ERROR(dwError);
+    bServerStarted = TRUE;
+
+    dwError = FakeServerOpen(&server, &hDirectory);
+    BAIL_ON_TEST_ERROR(dwError);
+
+    dwError = StartSearch(hDirectory, "dc=example,dc=com", "(uid=a)", &result, NULL);
+    BAIL_ON_TEST_ERROR(dwError);
+
+    dwError = StartSearch(hDirectory, "dc=example,dc=com", "(uid=b)", NULL, &pSearch);
+    BAIL_ON_TEST_ERROR(dwError);
+
+    // Timing out is not a failure of either search
+    dwError = LwLdapDirectoryDispatchAsync(hDirectory, 200, &dwOutstanding);
+    BAIL_ON_TEST_ERROR(dwError);
+    TEST_ASSERT(dwOutstanding == 2);
+    TEST_ASSERT(result.dwCalls == 0);
+
+    LwLdapDirectorySearchAbandon(hDirectory, pSearch);
+    pSearch = NULL;
+
+    dwError = LwLdapDirectoryDispatchAsync(hDirectory, 0, &dwOutstanding);
+    BAIL_ON_TEST_ERROR(dwError);
+    TEST_ASSERT(dwOutstanding == 1);
+
+    // Closing abandons the rest and cancels their callbacks
+    LwLdapCloseDirectory(hDirectory);
+    hDirectory = NULL;
+
+    TEST_ASSERT(result.dwCalls == 1);
+    TEST_ASSERT(result.dwError == ERROR_CANCELLED);
+
+    dwError = FakeServerGetRequests(&server, sizeof(expected), requests);
+    BAIL_ON_TEST_ERROR(dwError);
+    TEST_ASSERT(!memcmp(requests, expected, sizeof(expected)));
+
+error:
+
+    if (pSearch)
+    {
+        LwLdapDirectorySearchAbandon(hDirectory, pSearch);
+    }
+    if (hDirectory)
+    {
+        LwLdapCloseDirectory(hDirectory);
+    }
+    if (bServerStarted)
+    {
+        FakeServerStop(&server);
+    }
+
+    return dwError;
+}
+
+// Losing the connection fails every outstanding search, whether it was
+// started with a callback or is finished explicitly.
+static
+DWORD
+TestConnectionLoss(
+    VOID
+    )
+{
+    DWORD dwError = 0;
+    DWORD dwSearchError = 0;
+    FAKE_SERVER server;
+    BOOLEAN bServerStarted = FALSE;
+    HANDLE hDirectory = NULL;
+    SEARCH_RESULT result = {0};
+    PLW_LDAP_ASYNC_SEARCH pSearch1 = NULL;
+    PLW_LDAP_ASYNC_SEARCH pSearch2 = NULL;
+    LDAPMessage* pMessage = NULL;
+    DWORD dwOutstanding = 0;
+    BYTE requests[MAX_FAKE_REQUESTS];
+
+    dwError = FakeServerStart(&server);
+    BAIL_ON_TEST_ERROR(dwError);
+    bServerStarted = TRUE;
+
+    dwError = FakeServerOpen(&server, &hDirectory);
+    BAIL_ON_TEST_ERROR(dwError);
+
+    dwError = StartSearch(hDirectory, "dc=example,dc=com", "(uid=a)", NULL, &pSearch1);
+    BAIL_ON_TEST_ERROR(dwError);
+
+    dwError = StartSearch(hDirectory, "dc=example,dc=com", "(uid=b)", &result, NULL);
+    BAIL_ON_TEST_ERROR(dwError);
+
+    dwError = StartSearch(hDirectory, "dc=example,dc=com", "(uid=c)", NULL, &pSearch2);
+    BAIL_ON_TEST_ERROR(dwError);
+
+    dwError = FakeServerGetRequests(&server, 4, requests);
+    BAIL_ON_TEST_ERROR(dwError);
+
+    FakeServerDisconnect(&server);
+
+    // Waiting on one search notices the loss for all of them
+    dwSearchError = LwLdapDirectorySearchFinish(hDirectory, pSearch1, &pMessage);
+    pSearch1 = NULL;
+    TEST_ASSERT(dwSearchError != 0);
+    TEST_ASSERT(pMessage == NULL);
+
+    TEST_ASSERT(result.dwCalls == 1);
+    TEST_ASSERT(result.dwError == dwSearchError);
+
+    dwError = LwLdapDirectoryDispatchAsync(hDirectory, 0, &dwOutstanding);
+    BAIL_ON_TEST_ERROR(dwError);
+    TEST_ASSERT(dwOutstanding == 0);
+
+    // Already failed, so this does not wait
+    TEST_ASSERT(LwLdapDirectorySearchFinish(hDirectory, pSearch2, &pMessage) == dwSearchError);
+    pSearch2 = NULL;
+    TEST_ASSERT(pMessage == NULL);
+
+    printf("Outstanding searches failed with error %u after the connection was lost\n",
+           dwSearchError);
+
+error:
+
+    if (pSearch1)
+    {
+        LwLdapDirectorySearchAbandon(hDirectory, pSearch1);
+    }
+    if (pSearch2)
+    {
+        LwLdapDirectorySearchAbandon(hDirectory, pSearch2);
+    }
+    if (hDirectory)
+    {
+        LwLdapCloseDirectory(hDirectory);
+    }
+    if (bServerStarted)
+    {
+        FakeServerStop(&server);
+    }
+
+    return dwError;
+}
+
+// Many searches outstanding on one connection, some with callbacks and
+// some finished explicitly in reverse order, with a synchronous search
+// on the same connection in the middle.  Every search must get its own
+// result.
+static
+DWORD
+TestConcurrentSearches(
+    PCSTR pszServerAddress,
+    PCSTR pszBaseDn
+    )
+{
+    DWORD dwError = 0;
+    HANDLE hDirectory = NULL;
+    CHAR szQuery[CONCURRENT_SEARCHES][64];
+    int expected[CONCURRENT_SEARCHES] = {0};
+    SEARCH_RESULT results[CONCURRENT_SEARCHES];
+    PLW_LDAP_ASYNC_SEARCH pSearches[CONCURRENT_SEARCHES] = {NULL};
+    LDAPMessage* pMessage = NULL;
+    DWORD dwOutstanding = 0;
+    DWORD dwIndex = 0;
+    DWORD dwWait = 0;
+    int count = 0;
+
+    memset(results, 0, sizeof(results));
+
+    dwError = LwLdapOpenDirectoryServer(
+                    pszServerAddress,
+                    pszServerAddress,
+                    LW_LDAP_OPT_ANNONYMOUS,
+                    &hDirectory);
+    BAIL_ON_TEST_ERROR(dwError);
+
+    for (dwIndex = 0; dwIndex < CONCURRENT_SEARCHES; dwIndex++)
+    {
+        // Result sizes differ: user1* matches many, user23 one, user99999 none
+        switch (dwIndex % 3)
+        {
+        case 0:
+            snprintf(szQuery[dwIndex], sizeof(szQuery[dwIndex]), "(uid=user%u*)", dwIndex / 3 + 1);
+            break;
+        case 1:
+            snprintf(szQuery[dwIndex], sizeof(szQuery[dwIndex]), "(uid=user%u)", dwIndex);
+            break;
+        default:
+            snprintf(szQuery[dwIndex], sizeof(szQuery[dwIndex]), "(uid=user9999%u)", dwIndex);
+            break;
+        }
+
+        dwError = CountEntries(hDirectory, pszBaseDn, szQuery[dwIndex], &expected[dwIndex]);
+        BAIL_ON_TEST_ERROR(dwError);
+    }
+
+    TEST_ASSERT(expected[0] > 1);
+
+    for (dwIndex = 0; dwIndex < CONCURRENT_SEARCHES; dwIndex++)
+    {
+        if (dwIndex % 2)
+        {
+            dwError = StartSearch(hDirectory, pszBaseDn, szQuery[dwIndex], NULL, &pSearches[dwIndex]);
+        }
+        else
+        {
+            dwError = StartSearch(hDirectory, pszBaseDn, szQuery[dwIndex], &results[dwIndex], NULL);
+        }
+        BAIL_ON_TEST_ERROR(dwError);
+    }
+
+    // A synchronous search on the same connection leaves the others alone
+    dwError = CountEntries(hDirectory, pszBaseDn, szQuery[0], &count);
+    BAIL_ON_TEST_ERROR(dwError);
+    TEST_ASSERT(count == expected[0]);
+
+    for (dwIndex = CONCURRENT_SEARCHES; dwIndex-- > 0;)
+    {
+        if (!pSearches[dwIndex])
+        {
+            continue;
+        }
+
+        dwError = LwLdapDirectorySearchFinish(hDirectory, pSearches[dwIndex], &pMessage);
+        pSearches[dwIndex] = NULL;
+        BAIL_ON_TEST_ERROR(dwError);
+
+        results[dwIndex].dwCalls = 1;
+        results[dwIndex].count = ldap_count_entries(LwLdapGetSession(hDirectory), pMessage);
+        ldap_msgfree(pMessage);
+        pMessage = NULL;
+    }
+
+    for (dwWait = 0; dwWait < 50; dwWait++)
+    {
+        dwError = LwLdapDirectoryDispatchAsync(hDirectory, 100, &dwOutstanding);
+        BAIL_ON_TEST_ERROR(dwError);
+
+        if (!dwOutstanding)
+        {
+            break;
+        }
+    }
+
+    TEST_ASSERT(dwOutstanding == 0);
+
+    for (dwIndex = 0; dwIndex < CONCURRENT_SEARCHES; dwIndex++)
+    {
+        if (results[dwIndex].dwCalls != 1 ||
+            results[dwIndex].dwError ||
+            results[dwIndex].count != expected[dwIndex])
+        {
+            printf("Search %u '%s': %u results, error %u, %d entries, expected %d\n",
+                   dwIndex,
+                   szQuery[dwIndex],
+                   results[dwIndex].dwCalls,
+                   results[dwIndex].dwError,
+                   results[dwIndex].count,
+                   expected[dwIndex]);
+            dwError = LW_ERROR_INTERNAL;
+            BAIL_ON_TEST_ERROR(dwError);
+        }
+    }
+
+error:
+
+    for (dwIndex = 0; dwIndex < CONCURRENT_SEARCHES; dwIndex++)
+    {
+        if (pSearches[dwIndex])
+        {
+            LwLdapDirectorySearchAbandon(hDirectory, pSearches[dwIndex]);
+        }
+    }
+    if (hDirectory)
+    {
+        LwLdapCloseDirectory(hDirectory);
+    }
+
+    return dwError;
+}
+
+// Results of abandoned searches that were already on the way are dropped
+// without disturbing later searches on the connection.
+static
+DWORD
+TestAbandonInFlight(
+    PCSTR pszServerAddress,
+    PCSTR pszBaseDn
+    )
+{
+    DWORD dwError = 0;
+    HANDLE hDirectory = NULL;
+    PLW_LDAP_ASYNC_SEARCH pSearch = NULL;
+    SEARCH_RESULT result = {0};
+    DWORD dwOutstanding = 0;
+    DWORD dwIndex = 0;
+    DWORD dwWait = 0;
+    int expected = 0;
+    int count = 0;
+
+    dwError = LwLdapOpenDirectoryServer(
+                    pszServerAddress,
+                    pszServerAddress,
+                    LW_LDAP_OPT_ANNONYMOUS,
+                    &hDirectory);
+    BAIL_ON_TEST_ERROR(dwError);
+
+    dwError = CountEntries(hDirectory, pszBaseDn, "(uid=*)", &expected);
+    BAIL_ON_TEST_ERROR(dwError);
+
+    for (dwIndex = 0; dwIndex < 10; dwIndex++)
+    {
+        dwError = StartSearch(hDirectory, pszBaseDn, "(uid=*)", NULL, &pSearch);
+        BAIL_ON_TEST_ERROR(dwError);
+
+        LwLdapDirectorySearchAbandon(hDirectory, pSearch);
+        pSearch = NULL;
+    }
+
+    dwError = StartSearch(hDirectory, pszBaseDn, "(uid=*)", &result, NULL);
+    BAIL_ON_TEST_ERROR(dwError);
+
+    for (dwWait = 0; result.dwCalls == 0 && dwWait < 50; dwWait++)
+    {
+        dwError = LwLdapDirectoryDispatchAsync(hDirectory, 100, &dwOutstanding);
+        BAIL_ON_TEST_ERROR(dwError);
+    }
+
+    TEST_ASSERT(result.dwCalls == 1);
+    TEST_ASSERT(result.dwError == 0);
+    TEST_ASSERT(result.count == expected);
+    TEST_ASSERT(dwOutstanding == 0);
+
+    dwError = CountEntries(hDirectory, pszBaseDn, "(uid=*)", &count);
+    BAIL_ON_TEST_ERROR(dwError);
+    TEST_ASSERT(count == expected);
+
+error:
+
+    if (pSearch)
+    {
+        LwLdapDirectorySearchAbandon(hDirectory, pSearch);
+    }
+    if (hDirectory)
+    {
+        LwLdapCloseDirectory(hDirectory);
+    }
+
+    return dwError;
+}
+
+static
+DWORD
+RunTest(
+    PCSTR pszName,
+    DWORD dwError
+    )
+{
+    printf("%s: %s\n", pszName, dwError ? "FAILED" : "passed");
+
+    return dwError;
+}
+
+int
+main(
+    int argc,
+    char* argv[]
+    )
+{
+    DWORD dwFailures = 0;
+
+    if (argc != 1 && argc != 3)
+    {
+        printf("usage: %s [<serverAddress[:port]> <baseDn>]\n", argv[0]);
+        return 1;
+    }
+
+    dwFailures += !!RunTest("timeout and abandon", TestTimeoutAndAbandon());
+    dwFailures += !!RunTest("connection loss", TestConnectionLoss());
+
+    if (argc == 3)
+    {
+        dwFailures += !!RunTest("concurrent searches", TestConcurrentSearches(argv[1], argv[2]));
+        dwFailures += !!RunTest("abandon in flight", TestAbandonInFlight(argv[1], argv[2]));
+    }
+
+    printf("%s\n", dwFailures ? "ERROR" : "SUCCESS");
+
+    return dwFailures ? 1 : 0;
+}
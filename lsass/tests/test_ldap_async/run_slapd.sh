@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# Runs test_ldap_async against a scratch slapd from the openldap tree,
+# using back-ldif and inetOrgPerson entries uid=user0 ... uid=user199.
+#
+# usage: run_slapd.sh <slapd> <schemaDir> <test_ldap_async> [<port>]
+#
+slapd=$1
+schema=$2
+test=$3
+port=${4:-3890}
+base="dc=example,dc=com"
+users=200
+
+if [ -z "$slapd" -o -z "$schema" -o -z "$test" ]; then
+    echo "usage: $0 <slapd> <schemaDir> <test_ldap_async> [<port>]"
+    exit 1
+fi
+
+dir=`mktemp -d /tmp/test_ldap_async.XXXXXX` || exit 1
+trap 'kill `cat $dir/slapd.pid 2>/dev/null` 2>/dev/null; rm -rf $dir' 0
+
+mkdir $dir/db
+
+cat > $dir/slapd.conf <<EOF
+include $schema/core.schema
+include $schema/cosine.schema
+include $schema/inetorgperson.schema
+pidfile $dir/slapd.pid
+database ldif
+directory $dir/db
+suffix "$base"
+rootdn "cn=admin,$base"
+EOF
+
+{
+    echo "dn: $base"
+    echo "objectClass: dcObject"
+    echo "objectClass: organization"
+    echo "dc: example"
+    echo "o: example"
+    echo
+    echo "dn: ou=people,$base"
+    echo "objectClass: organizationalUnit"
+    echo "ou: people"
+    echo
+    i=0
+    while [ $i -lt $users ]; do
+        echo "dn: uid=user$i,ou=people,$base"
+        echo "objectClass: inetOrgPerson"
+        echo "uid: user$i"
+        echo "cn: User $i"
+        echo "sn: $i"
+        echo
+        i=`expr $i + 1`
+    done
+} > $dir/users.ldif
+
+$slapd -T add -f $dir/slapd.conf -l $dir/users.ldif || exit 1
+$slapd -f $dir/slapd.conf -h "ldap://127.0.0.1:$port/" || exit 1
+
+# slapd forks into the background; wait for it to listen
+i=0
+while [ ! -s $dir/slapd.pid -a $i -lt 50 ]; do
+    sleep 0.1
+    i=`expr $i + 1`
+done
+
+$test "127.0.0.1:$port" "$base"
@@ -0,0 +1,228 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright Likewise Software    2004-2008
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.  You should have received a copy of the GNU General
+ * Public License along with this program.  If not, see 
+ * <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        main.c
+ *
+ * Abstract:
+ *
+ *        Likewise Security and Authentication Subsystem (LSASS)
+ *
+ *        Client connection benchmark
+ *
+ *        Measures how many LsaOpenServer, LsaFindUserByName,
+ *        LsaCloseServer cycles per second a number of threads can
+ *        complete against a running lsassd.
+ *
+ *        Usage: test_lsaclient_pool [user [threads [seconds]]]
+ *
+ */
+
+#include "config.h"
+#include "lsasystem.h"
+#include "lsadef.h"
+#include "lsa/lsa.h"
+#include "lwmem.h"
+#include "lsautils.h"
+#include <stdio.h>
+#include <pthread.h>
+
+#define MAX_THREADS     64
+
+typedef struct _BENCH_STATE
+{
+    PCSTR pszUser;
+    volatile BOOLEAN bStop;
+} BENCH_STATE, *PBENCH_STATE;
+
+typedef struct _BENCH_THREAD
+{
+    PBENCH_STATE pState;
+    pthread_t thread;
+    UINT64 qwCycles;
+    DWORD dwError;
+} BENCH_THREAD, *PBENCH_THREAD;
+
+static
+PVOID
+CycleThread(
+    PVOID pArg
+    )
+{
+    PBENCH_THREAD pThread = (PBENCH_THREAD)pArg;
+    HANDLE hLsaConnection = (HANDLE)NULL;
+    PVOID pUserInfo = NULL;
+
+    while (!pThread->pState->bStop)
+    {
+        pThread->dwError = LsaOpenServer(&hLsaConnection);
+        if (pThread->dwError)
+        {
+            break;
+        }
+
+        pThread->dwError = LsaFindUserByName(
+                                hLsaConnection,
+                                pThread->pState->pszUser,
+                                0,
+                                &pUserInfo);
+
+        LsaCloseServer(hLsaConnection);
+        hLsaConnection = (HANDLE)NULL;
+
+        if (pThread->dwError)
+        {
+            break;
+        }
+
+        LsaFreeUserInfo(0, pUserInfo);
+        pUserInfo = NULL;
+        pThread->qwCycles++;
+    }
+
+    return NULL;
+}
+
+static
+DWORD
+RunThreads(
+    PBENCH_STATE pState,
+    int threadCount,
+    int seconds
+    )
+{
+    DWORD dwError = 0;
+    BENCH_THREAD threads[MAX_THREADS] = { { 0 } };
+    int started = 0;
+    int i = 0;
+    UINT64 qwCycles = 0;
+
+    pState->bStop = FALSE;
+
+    for (started = 0; started < threadCount; started++)
+    {
+        threads[started].pState = pState;
+
+        dwError = LwMapErrnoToLwError(pthread_create(
+                        &threads[started].thread,
+                        NULL,
+                        CycleThread,
+                        &threads[started]));
+        if (dwError)
+        {
+            break;
+        }
+    }
+
+    if (!dwError)
+    {
+        sleep(seconds);
+    }
+
+    pState->bStop = TRUE;
+
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(threads[i].thread, NULL);
+
+        if (threads[i].dwError && !dwError)
+        {
+            dwError = threads[i].dwError;
+        }
+
+        qwCycles += threads[i].qwCycles;
+    }
+
+    printf("%2d threads: %12.0f open/find/close cycles/sec\n",
+           threadCount,
+           (double)qwCycles / seconds);
+
+    return dwError;
+}
+
+int
+main(
+    int argc,
+    char** argv
+    )
+{
+    DWORD dwError = 0;
+    BENCH_STATE state = { 0 };
+    int threadCount = 8;
+    int seconds = 5;
+    int count = 0;
+
+    state.pszUser = "root";
+
+    if (argc > 1)
+    {
+        state.pszUser = argv[1];
+    }
+    if (argc > 2)
+    {
+        threadCount = atoi(argv[2]);
+    }
+    if (argc > 3)
+    {
+        seconds = atoi(argv[3]);
+    }
+
+    if (threadCount < 1 || threadCount > MAX_THREADS || seconds < 1)
+    {
+        fprintf(stderr, "Usage: %s [user [threads [seconds]]]\n", argv[0]);
+        return 1;
+    }
+
+    // Scale up to the requested thread count to show contention
+    for (count = 1; count <= threadCount; count *= 2)
+    {
+        dwError = RunThreads(&state, count, seconds);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    if (count / 2 != threadCount)
+    {
+        dwError = RunThreads(&state, threadCount, seconds);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+cleanup:
+
+    return dwError ? 1 : 0;
+
+error:
+    fprintf(stderr, "Benchmark failed with error %u\n", dwError);
+    goto cleanup;
+}
@@ -0,0 +1,377 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright Likewise Software    2004-2008
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.  You should have received a copy of the GNU General
+ * Public License along with this program.  If not, see 
+ * <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        main.c
+ *
+ * Abstract:
+ *
+ *        Likewise Security and Authentication Subsystem (LSASS)
+ *
+ *        Load time benchmark for the AD provider memory cache
+ *
+ *        Fills a memory cache with users, groups, memberships and
+ *        password verifiers, writes its snapshot, and then measures how
+ *        long MemCacheOpen takes to load the snapshot back. Link it with
+ *        the ad-open-provider objects.
+ *
+ *        Usage: test_memcache_load [users [rounds]]
+ *
+ */
+
+#include "adprovider.h"
+#include <stdio.h>
+#include <time.h>
+
+#define GROUP_COUNT         500
+#define GROUPS_PER_USER     5
+#define VERIFIER_EVERY      10
+
+static
+DWORD
+CreateObjects(
+    IN DWORD dwUserCount,
+    OUT PLSA_SECURITY_OBJECT** pppObjects
+    )
+{
+    DWORD dwError = 0;
+    PLSA_SECURITY_OBJECT* ppObjects = NULL;
+    PLSA_SECURITY_OBJECT pObject = NULL;
+    DWORD dwIndex = 0;
+
+    dwError = LwAllocateMemory(
+                    sizeof(*ppObjects) * (dwUserCount + GROUP_COUNT),
+                    (PVOID*)&ppObjects);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    for (dwIndex = 0; dwIndex < dwUserCount + GROUP_COUNT; dwIndex++)
+    {
+        dwError = LwAllocateMemory(sizeof(*pObject), (PVOID*)&pObject);
+        BAIL_ON_LSA_ERROR(dwError);
+        ppObjects[dwIndex] = pObject;
+
+        pObject->enabled = TRUE;
+        pObject->version.tLastUpdated = time(NULL);
+
+        dwError = LwAllocateStringPrintf(
+                        &pObject->pszObjectSid,
+                        "S-1-5-21-1111-2222-3333-%u",
+                        dwIndex + 1000);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwAllocateString("BENCH", &pObject->pszNetbiosDomainName);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        if (dwIndex >= dwUserCount)
+        {
+            pObject->type = LSA_OBJECT_TYPE_GROUP;
+            pObject->groupInfo.gid = 200000 + dwIndex - dwUserCount;
+
+            dwError = LwAllocateStringPrintf(
+                            &pObject->pszDN,
+                            "CN=group%u,OU=Groups,DC=bench,DC=example,DC=com",
+                            dwIndex - dwUserCount);
+            BAIL_ON_LSA_ERROR(dwError);
+
+            dwError = LwAllocateStringPrintf(
+                            &pObject->pszSamAccountName,
+                            "group%u",
+                            dwIndex - dwUserCount);
+            BAIL_ON_LSA_ERROR(dwError);
+
+            dwError = LwAllocateString(
+                            pObject->pszSamAccountName,
+                            &pObject->groupInfo.pszAliasName);
+            BAIL_ON_LSA_ERROR(dwError);
+            continue;
+        }
+
+        pObject->type = LSA_OBJECT_TYPE_USER;
+        pObject->userInfo.uid = 100000 + dwIndex;
+        pObject->userInfo.gid = 200000;
+        pObject->userInfo.bIsAccountInfoKnown = TRUE;
+
+        dwError = LwAllocateStringPrintf(
+                        &pObject->pszDN,
+                        "CN=bench%u,OU=Users,DC=bench,DC=example,DC=com",
+                        dwIndex);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwAllocateStringPrintf(
+                        &pObject->pszSamAccountName,
+                        "bench%u",
+                        dwIndex);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwAllocateString(
+                        pObject->pszSamAccountName,
+                        &pObject->userInfo.pszAliasName);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwAllocateString(
+                        ppObjects[0]->pszObjectSid,
+                        &pObject->userInfo.pszPrimaryGroupSid);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwAllocateStringPrintf(
+                        &pObject->userInfo.pszUPN,
+                        "bench%u@BENCH.EXAMPLE.COM",
+                        dwIndex);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwAllocateStringPrintf(
+                        &pObject->userInfo.pszGecos,
+                        "Bench User %u",
+                        dwIndex);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwAllocateString("/bin/sh", &pObject->userInfo.pszShell);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwAllocateStringPrintf(
+                        &pObject->userInfo.pszHomedir,
+                        "/home/BENCH/bench%u",
+                        dwIndex);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        dwError = LwAllocateString(
+                        pObject->userInfo.pszGecos,
+                        &pObject->userInfo.pszDisplayName);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    *pppObjects = ppObjects;
+
+cleanup:
+    return dwError;
+
+error:
+    if (ppObjects)
+    {
+        ADCacheSafeFreeObjectList(dwUserCount + GROUP_COUNT, &ppObjects);
+    }
+    *pppObjects = NULL;
+    goto cleanup;
+}
+
+static
+DWORD
+FillCache(
+    IN LSA_DB_HANDLE hDb,
+    IN DWORD dwUserCount,
+    IN PLSA_SECURITY_OBJECT* ppObjects
+    )
+{
+    DWORD dwError = 0;
+    LSA_GROUP_MEMBERSHIP memberships[GROUPS_PER_USER] = { { { 0 } } };
+    PLSA_GROUP_MEMBERSHIP ppMemberships[GROUPS_PER_USER] = { 0 };
+    LSA_PASSWORD_VERIFIER verifier = { { 0 } };
+    PSTR pszVerifier = NULL;
+    DWORD dwIndex = 0;
+    DWORD dwGroup = 0;
+
+    dwError = MemCacheStoreObjectEntries(
+                    hDb,
+                    dwUserCount + GROUP_COUNT,
+                    ppObjects);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    for (dwIndex = 0; dwIndex < dwUserCount; dwIndex++)
+    {
+        for (dwGroup = 0; dwGroup < GROUPS_PER_USER; dwGroup++)
+        {
+            memberships[dwGroup].version.tLastUpdated = time(NULL);
+            memberships[dwGroup].pszChildSid = ppObjects[dwIndex]->pszObjectSid;
+            memberships[dwGroup].pszParentSid = ppObjects[dwUserCount +
+                (dwIndex + dwGroup * 97) % GROUP_COUNT]->pszObjectSid;
+            memberships[dwGroup].bIsInPac = TRUE;
+            memberships[dwGroup].bIsInLdap = TRUE;
+            ppMemberships[dwGroup] = &memberships[dwGroup];
+        }
+
+        dwError = MemCacheStoreGroupsForUser(
+                        hDb,
+                        ppObjects[dwIndex]->pszObjectSid,
+                        GROUPS_PER_USER,
+                        ppMemberships,
+                        TRUE);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        if (dwIndex % VERIFIER_EVERY == 0)
+        {
+            LW_SAFE_FREE_STRING(pszVerifier);
+            dwError = LwAllocateStringPrintf(
+                            &pszVerifier,
+                            "%032X",
+                            dwIndex);
+            BAIL_ON_LSA_ERROR(dwError);
+
+            verifier.version.tLastUpdated = time(NULL);
+            verifier.pszObjectSid = ppObjects[dwIndex]->pszObjectSid;
+            verifier.pszPasswordVerifier = pszVerifier;
+
+            dwError = MemCacheStorePasswordVerifier(hDb, &verifier);
+            BAIL_ON_LSA_ERROR(dwError);
+        }
+    }
+
+    dwError = MemCacheStoreFile(hDb);
+    BAIL_ON_LSA_ERROR(dwError);
+
+cleanup:
+    LW_SAFE_FREE_STRING(pszVerifier);
+
+    return dwError;
+
+error:
+    goto cleanup;
+}
+
+static
+double
+GetSeconds(
+    VOID
+    )
+{
+    struct timespec now = { 0 };
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int
+main(
+    int argc,
+    char** argv
+    )
+{
+    DWORD dwError = 0;
+    LSA_DB_HANDLE hDb = NULL;
+    PLSA_SECURITY_OBJECT* ppObjects = NULL;
+    char szPath[] = "/tmp/test_memcache_load.XXXXXX";
+    struct stat fileStat = { 0 };
+    int fd = -1;
+    int users = 50000;
+    int rounds = 5;
+    int round = 0;
+    double start = 0;
+    double elapsed = 0;
+    double best = 0;
+    double total = 0;
+
+    if (argc > 1)
+    {
+        users = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        rounds = atoi(argv[2]);
+    }
+
+    if (users < 1 || rounds < 1)
+    {
+        fprintf(stderr, "Usage: %s [users [rounds]]\n", argv[0]);
+        return 1;
+    }
+
+    fd = mkstemp(szPath);
+    if (fd < 0)
+    {
+        dwError = LwMapErrnoToLwError(errno);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+    close(fd);
+    // The cache must not try to load the empty file
+    unlink(szPath);
+
+    dwError = CreateObjects(users, &ppObjects);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = MemCacheOpen(szPath, NULL, &hDb);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    dwError = FillCache(hDb, users, ppObjects);
+    BAIL_ON_LSA_ERROR(dwError);
+
+    MemCacheSafeClose(&hDb);
+
+    if (stat(szPath, &fileStat) < 0)
+    {
+        dwError = LwMapErrnoToLwError(errno);
+        BAIL_ON_LSA_ERROR(dwError);
+    }
+
+    for (round = 0; round < rounds; round++)
+    {
+        start = GetSeconds();
+
+        dwError = MemCacheOpen(szPath, NULL, &hDb);
+        BAIL_ON_LSA_ERROR(dwError);
+
+        elapsed = GetSeconds() - start;
+
+        MemCacheSafeClose(&hDb);
+
+        total += elapsed;
+        if (!round || elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+
+    printf("%d users, %d groups, %lu byte snapshot: "
+           "best %.3fs, mean %.3fs per load (%.0f objects/sec)\n",
+           users,
+           GROUP_COUNT,
+           (unsigned long)fileStat.st_size,
+           best,
+           total / rounds,
+           (users + GROUP_COUNT) / best);
+
+cleanup:
+    MemCacheSafeClose(&hDb);
+    unlink(szPath);
+    if (ppObjects)
+    {
+        ADCacheSafeFreeObjectList(users + GROUP_COUNT, &ppObjects);
+    }
+
+    return dwError ? 1 : 0;
+
+error:
+    fprintf(stderr, "Benchmark failed with error %u\n", dwError);
+    goto cleanup;
+}
@@ -58,9 +58,15 @@
 #if HAVE_DLFCN_H
 #include <dlfcn.h>
 #endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 #include <errno.h>
+#include <pthread.h>
 #include "tests.h"
 
+#define MAX_SCALING_THREADS 64
+
 #ifndef CLOCK_REALTIME
 #define CLOCK_REALTIME 0
 #endif
@@ -116,6 +122,99 @@ GetTimeDiff(
     return endNanoSecs - startNanoSecs;
 }
 
+typedef struct
+{
+    TestTimedFunc run;
+    PVOID runArg;
+    volatile BOOL *stop;
+    int64_t runNum;
+    BOOL passed;
+} ThreadState;
+
+void *
+ThreadedRunner(
+        void *arg
+        )
+{
+    ThreadState *state = (ThreadState *)arg;
+
+    state->passed = TRUE;
+    while (!*state->stop)
+    {
+        if (!state->run(state->runArg))
+        {
+            state->passed = FALSE;
+            break;
+        }
+        state->runNum++;
+    }
+
+    return NULL;
+}
+
+BOOL
+RunThreaded(
+        TestTimedFunc run,
+        PVOID runArg,
+        int threadCount,
+        double *callsPerSec
+        )
+{
+    pthread_t threads[MAX_SCALING_THREADS];
+    ThreadState states[MAX_SCALING_THREADS] = {{0}};
+    volatile BOOL stop = FALSE;
+    struct timespec startTime = {0};
+    struct timespec endTime = {0};
+    int started;
+    int i;
+    int64_t runNum = 0;
+    BOOL passed = TRUE;
+
+    if (clock_gettime(CLOCK_REALTIME, &startTime) < 0)
+    {
+        perror("clock_gettime");
+        return FALSE;
+    }
+
+    for (started = 0; started < threadCount; started++)
+    {
+        states[started].run = run;
+        states[started].runArg = runArg;
+        states[started].stop = &stop;
+
+        if (pthread_create(&threads[started], NULL, ThreadedRunner,
+                    &states[started]) != 0)
+        {
+            perror("pthread_create");
+            passed = FALSE;
+            break;
+        }
+    }
+
+    if (passed)
+    {
+        sleep(10);
+    }
+    stop = TRUE;
+
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+        runNum += states[i].runNum;
+        passed = passed && states[i].passed;
+    }
+
+    if (clock_gettime(CLOCK_REALTIME, &endTime) < 0)
+    {
+        perror("clock_gettime");
+        return FALSE;
+    }
+
+    *callsPerSec = runNum /
+        (GetTimeDiff(&endTime, &startTime) / 1000000000.0);
+    return passed;
+}
+
 void RunTests(
         PerfTest* tests,
         size_t testCount
@@ -128,6 +227,8 @@ void RunTests(
     struct timespec endTime = {0};
     int result;
     int runNum;
+    int threadCount;
+    double callsPerSec;
 
     for (testIndex = 0; testIndex < testCount; testIndex++)
     {
@@ -213,6 +314,26 @@ void RunTests(
                 }
                 break;
 
+            case TEST_TYPE_THREAD_SCALING:
+                for (threadCount = 1;
+                        threadCount <= MAX_SCALING_THREADS;
+                        threadCount *= 2)
+                {
+                    passed = RunThreaded(
+                            tests[testIndex].run,
+                            runArg,
+                            threadCount,
+                            &callsPerSec);
+                    if (!passed)
+                    {
+                        printf("Failed with %d threads\n", threadCount);
+                        break;
+                    }
+                    printf("Result: %2d threads: %f calls per second\n",
+                            threadCount, callsPerSec);
+                }
+                break;
+
             default:
                 printf("Unknown test type %d\n", tests[testIndex].type);
                 return;
@@ -265,6 +386,7 @@ void RunLsassTests(
 int main(int argc, const char *argv[])
 {
     char user0001[256];
+    char missinguser[256];
     char groupsize1[256];
     char groupsize1000[256];
     char user[256];
@@ -297,6 +419,22 @@ int main(int argc, const char *argv[])
             NULL,
             groupsize1000
         },
+        {
+            "Concurrent getgrouplist's per second for user0001",
+            TEST_TYPE_THREAD_SCALING,
+            SetupGrabGroupList,
+            RunGrabGroupList,
+            NULL,
+            user0001,
+        },
+        {
+            "Concurrent getpwnam_r's per second for missinguser",
+            TEST_TYPE_THREAD_SCALING,
+            SetupGrabMissingName,
+            RunGrabMissingNameReentrant,
+            NULL,
+            missinguser,
+        },
         {
             "Uncached 500 user lookup for user0001-user0500",
             TEST_TYPE_SINGLE_RUN,
@@ -328,12 +466,15 @@ int main(int argc, const char *argv[])
                 "The following groups should be available from the domain:\n"
                 "<domain>\\groupsize1\n"
                 "<domain>\\groupsize1000\n"
-                "<domain>\\usergroup0001 through <domain>\\usergroup0500\n",
+                "<domain>\\usergroup0001 through <domain>\\usergroup0500\n"
+                "\n"
+                "<domain>\\missinguser must not exist.\n",
                 argv[0]);
         exit(1);
     }
 
     snprintf(user0001, sizeof(user0001), "%s\\user0001", argv[1]);
+    snprintf(missinguser, sizeof(missinguser), "%s\\missinguser", argv[1]);
     snprintf(groupsize1, sizeof(groupsize1), "%s\\groupsize1", argv[1]);
     snprintf(groupsize1000, sizeof(groupsize1000), "%s\\groupsize1000", argv[1]);
     snprintf(user, sizeof(user), "%s\\user", argv[1]);
@@ -61,6 +61,9 @@
 #if HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
+#if HAVE_STRING_H
+#include <string.h>
+#endif
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
@@ -101,6 +104,82 @@ SetupGrabUid(
     return TRUE;
 }
 
+/* The thread scaling tests must reach lsassd on every call, so they avoid
+ * lookups the nsswitch module can answer from the lsassd map: membership
+ * lists are never published there, and neither are names that do not exist.
+ */
+BOOL
+RunGrabGroupList(
+    IN PVOID arg
+    )
+{
+    gid_t groups[1024];
+    int groupCount = sizeof(groups) / sizeof(groups[0]);
+
+    /* Any gid will do for the group that is always included */
+    if (getgrouplist((PSTR)arg, 0, groups, &groupCount) < 0)
+    {
+        fprintf(stderr, "%s: more than %d groups\n", __FUNCTION__,
+                groupCount);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+BOOL
+SetupGrabGroupList(
+    IN PVOID username,
+    OUT PVOID *name
+    )
+{
+    if (!RunGrabGroupList(username))
+    {
+        return FALSE;
+    }
+
+    *name = username;
+    return TRUE;
+}
+
+BOOL
+RunGrabMissingNameReentrant(
+    IN PVOID arg
+    )
+{
+    struct passwd pwd;
+    struct passwd *result = NULL;
+    char buffer[1024];
+    int error;
+
+    error = getpwnam_r((PSTR)arg, &pwd, buffer, sizeof(buffer), &result);
+    if (result != NULL)
+    {
+        fprintf(stderr, "%s: %s exists\n", __FUNCTION__, (PSTR)arg);
+        return FALSE;
+    }
+    if (error && error != ENOENT)
+    {
+        fprintf(stderr, "%s: %s\n", __FUNCTION__, strerror(error));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+BOOL
+SetupGrabMissingName(
+    IN PVOID username,
+    OUT PVOID *name
+    )
+{
+    if (!RunGrabMissingNameReentrant(username))
+    {
+        return FALSE;
+    }
+
+    *name = username;
+    return TRUE;
+}
+
 BOOL
 RunGrabGid(
     IN PVOID arg
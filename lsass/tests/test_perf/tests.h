@@ -59,6 +59,28 @@ SetupGrabUid(
     OUT PVOID *uid
     );
 
+BOOL
+RunGrabGroupList(
+    IN PVOID arg
+    );
+
+BOOL
+SetupGrabGroupList(
+    IN PVOID username,
+    OUT PVOID *name
+    );
+
+BOOL
+RunGrabMissingNameReentrant(
+    IN PVOID arg
+    );
+
+BOOL
+SetupGrabMissingName(
+    IN PVOID username,
+    OUT PVOID *name
+    );
+
 BOOL
 RunGrabGid(
     IN PVOID arg
@@ -80,6 +80,8 @@ typedef enum
 {
     TEST_TYPE_RUNS_PER_SEC,
     TEST_TYPE_SINGLE_RUN,
+    /* Runs per second with 1, 2, 4 ... 64 threads calling the test */
+    TEST_TYPE_THREAD_SCALING,
 } TestType;
 
 typedef struct
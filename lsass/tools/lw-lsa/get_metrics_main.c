@@ -80,6 +80,12 @@ PrintMetricPack_1(
     PLSA_METRIC_PACK_1 pMetricPack
     );
 
+static
+VOID
+PrintMetricPack_2(
+    PLSA_METRIC_PACK_2 pMetricPack
+    );
+
 static
 DWORD
 MapErrorCode(
@@ -126,6 +132,13 @@ get_metrics_main(
 
             break;
 
+        case 2:
+
+            PrintMetricPack_2(
+                 (PLSA_METRIC_PACK_2)pMetricPack);
+
+            break;
+
     }
 
 cleanup:
@@ -240,6 +253,12 @@ ParseArgs(
                 }
                 
                 dwInfoLevel = atoi(pszArg);
+                if (dwInfoLevel > 2)
+                {
+                    fprintf(stderr, "Please enter an info level of 0, 1 or 2.\n");
+                    ShowUsage();
+                    exit(1);
+                }
                 parseMode = PARSE_MODE_DONE;
                 
                 break;
@@ -265,7 +284,7 @@ ParseArgs(
 void
 ShowUsage()
 {
-    printf("Usage: get-metrics { --level [0, 1] }\n");
+    printf("Usage: get-metrics { --level [0, 1, 2] }\n");
 }
 
 VOID
@@ -307,6 +326,17 @@ PrintMetricPack_1(
     printf("Failed password changes:              %llu\n", (unsigned long long)pMetricPack->failedChangePassword);
 }
 
+VOID
+PrintMetricPack_2(
+    PLSA_METRIC_PACK_2 pMetricPack
+    )
+{
+    PrintMetricPack_1(&pMetricPack->pack1);
+    printf("Coalesced directory lookups:          %llu\n", (unsigned long long)pMetricPack->coalescedLookups);
+    printf("Merged directory lookups:             %llu\n", (unsigned long long)pMetricPack->mergedLookups);
+    printf("Queries carrying merged lookups:      %llu\n", (unsigned long long)pMetricPack->mergedLookupBatches);
+}
+
 DWORD
 MapErrorCode(
     DWORD dwError
@@ -67,6 +67,18 @@ typedef struct __LW_SEARCH_COOKIE
     PFNLW_COOKIE_FREE pfnFree;
 } LW_SEARCH_COOKIE, *PLW_SEARCH_COOKIE;
 
+typedef struct _LW_LDAP_ASYNC_SEARCH
+    LW_LDAP_ASYNC_SEARCH, *PLW_LDAP_ASYNC_SEARCH;
+
+// Receives the result of an asynchronous search. The callback owns pMessage,
+// which may be NULL if dwError is set.
+typedef VOID (*PFNLW_LDAP_SEARCH_CALLBACK)(
+    HANDLE hDirectory,
+    PVOID pContext,
+    DWORD dwError,
+    LDAPMessage* pMessage
+    );
+
 
 LW_BEGIN_EXTERN_C
 
@@ -170,6 +182,102 @@ LwLdapDirectoryOnePagedSearch(
     LDAPMessage**  ppMessage
     );
 
+/**
+ * @brief Send a search without waiting for its result.
+ *
+ * Any number of searches may be outstanding on one connection. Results are
+ * matched to their searches by message id as they arrive.
+ *
+ * If pfnCallback is given, it is called with the result from whichever call
+ * reads it off the connection (#LwLdapDirectorySearchFinish for another
+ * search, or #LwLdapDirectoryDispatchAsync), and ppSearch must be NULL.
+ * Otherwise the result is kept until #LwLdapDirectorySearchFinish is called
+ * with the handle returned in ppSearch.
+ *
+ * Outstanding searches are abandoned when the directory is closed. Callbacks
+ * of abandoned searches are called with ERROR_CANCELLED.
+ */
+DWORD
+LwLdapDirectorySearchStart(
+    IN HANDLE hDirectory,
+    IN PCSTR pszObjectDN,
+    IN int scope,
+    IN PCSTR pszQuery,
+    IN PSTR* ppszAttributeList,
+    IN OPTIONAL LDAPControl** ppServerControls,
+    IN DWORD dwNumMaxEntries,
+    IN OPTIONAL PFNLW_LDAP_SEARCH_CALLBACK pfnCallback,
+    IN OPTIONAL PVOID pContext,
+    OUT OPTIONAL PLW_LDAP_ASYNC_SEARCH* ppSearch
+    );
+
+/**
+ * @brief Wait for the result of a search started without a callback.
+ *
+ * Results of other searches that arrive in the meantime are delivered too.
+ * The search handle is freed, whether or not the search succeeded.
+ */
+DWORD
+LwLdapDirectorySearchFinish(
+    IN HANDLE hDirectory,
+    IN PLW_LDAP_ASYNC_SEARCH pSearch,
+    OUT LDAPMessage** ppMessage
+    );
+
+/**
+ * @brief Abandon a search started without a callback.
+ *
+ * The search handle is freed. If the search was for a page, the cookie is
+ * left as it was before the page was requested.
+ */
+VOID
+LwLdapDirectorySearchAbandon(
+    IN HANDLE hDirectory,
+    IN PLW_LDAP_ASYNC_SEARCH pSearch
+    );
+
+/**
+ * @brief Deliver results of outstanding searches.
+ *
+ * Waits up to dwTimeoutMsecs for the first result, then delivers whatever
+ * else has already arrived without waiting.
+ *
+ * @param[out] pdwOutstanding - Number of searches still outstanding.
+ */
+DWORD
+LwLdapDirectoryDispatchAsync(
+    IN HANDLE hDirectory,
+    IN DWORD dwTimeoutMsecs,
+    OUT OPTIONAL PDWORD pdwOutstanding
+    );
+
+/**
+ * @brief Send the request for one page of a paged search.
+ *
+ * Together with #LwLdapDirectoryOnePagedSearchFinish, this lets the request
+ * for the next page go out while the current page is processed. The cookie
+ * must not be used for another page until this one is finished.
+ */
+DWORD
+LwLdapDirectoryOnePagedSearchStart(
+    IN HANDLE hDirectory,
+    IN PCSTR pszObjectDN,
+    IN PCSTR pszQuery,
+    IN PSTR* ppszAttributeList,
+    IN DWORD dwPageSize,
+    IN PLW_SEARCH_COOKIE pCookie,
+    IN int scope,
+    OUT PLW_LDAP_ASYNC_SEARCH* ppSearch
+    );
+
+DWORD
+LwLdapDirectoryOnePagedSearchFinish(
+    IN HANDLE hDirectory,
+    IN PLW_LDAP_ASYNC_SEARCH pSearch,
+    IN OUT PLW_SEARCH_COOKIE pCookie,
+    OUT LDAPMessage** ppMessage
+    );
+
 DWORD
 LwLdapCountEntries(
     HANDLE hDirectory,
@@ -64,6 +64,28 @@
 
 static DWORD gSaslMaxBufSize = LW_LDAP_16MB;
 
+static
+VOID
+LwLdapResetCookie(
+    IN OUT PLW_SEARCH_COOKIE pCookie
+    );
+
+static
+DWORD
+LwLdapParsePageResult(
+    IN PLW_LDAP_DIRECTORY_CONTEXT pDirectory,
+    IN LDAPMessage* pMessage,
+    IN OUT PLW_SEARCH_COOKIE pCookie
+    );
+
+static
+VOID
+LwLdapFailAsyncSearches(
+    IN PLW_LDAP_DIRECTORY_CONTEXT pDirectory,
+    IN DWORD dwError,
+    IN BOOLEAN bAbandon
+    );
+
 DWORD
 LwCLdapOpenDirectory(
     IN PCSTR pszServerName,
@@ -641,6 +663,7 @@ LwLdapCloseDirectory(
     PLW_LDAP_DIRECTORY_CONTEXT pDirectory = (PLW_LDAP_DIRECTORY_CONTEXT)hDirectory;
 
     if (pDirectory) {
+        LwLdapFailAsyncSearches(pDirectory, ERROR_CANCELLED, TRUE);
         if(pDirectory->ld)
         {
             ldap_unbind_s(pDirectory->ld);
@@ -894,14 +917,10 @@ LwLdapDirectoryOnePagedSearch(
 {
     DWORD dwError = LW_ERROR_SUCCESS;
     PLW_LDAP_DIRECTORY_CONTEXT pDirectory = NULL;
-    ber_int_t pageCount = 0;
     CHAR pagingCriticality = 'T';
     LDAPControl *pPageControl = NULL;
     LDAPControl *ppInputControls[2] = { NULL, NULL };
-    LDAPControl **ppReturnedControls = NULL;
-    int errorcodep = 0;
     LDAPMessage* pMessage = NULL;
-    BOOLEAN bSearchFinished = FALSE;
     struct berval * pBerCookie = (struct berval *)pCookie->pvData;
 
     LW_ASSERT(pCookie->pfnFree == NULL || pCookie->pfnFree == LwLdapFreeCookie);
@@ -930,6 +949,72 @@ LwLdapDirectoryOnePagedSearch(
                &pMessage);
     BAIL_ON_LW_ERROR(dwError);
 
+    dwError = LwLdapParsePageResult(
+                    pDirectory,
+                    pMessage,
+                    pCookie);
+    BAIL_ON_LW_ERROR(dwError);
+
+    *ppMessage = pMessage;
+
+cleanup:
+  /*  dwError_disable = ADDisablePageControlOption(hDirectory);
+    if (dwError_disable)
+        LW_RTL_LOG_ERROR("Error: LDAP Disable PageControl Info: failed");*/
+
+    ppInputControls[0] = NULL;
+
+    if (pPageControl) {
+        ldap_control_free(pPageControl);
+    }
+
+    return (dwError);
+
+error:
+
+    *ppMessage = NULL;
+
+    if (pMessage)
+    {
+        ldap_msgfree(pMessage);
+    }
+
+    LwLdapResetCookie(pCookie);
+
+    goto cleanup;
+}
+
+static
+VOID
+LwLdapResetCookie(
+    IN OUT PLW_SEARCH_COOKIE pCookie
+    )
+{
+    if (pCookie->pvData != NULL)
+    {
+        ber_bvfree((struct berval *)pCookie->pvData);
+    }
+
+    pCookie->pvData = NULL;
+    pCookie->pfnFree = NULL;
+    pCookie->bSearchFinished = TRUE;
+}
+
+static
+DWORD
+LwLdapParsePageResult(
+    IN PLW_LDAP_DIRECTORY_CONTEXT pDirectory,
+    IN LDAPMessage* pMessage,
+    IN OUT PLW_SEARCH_COOKIE pCookie
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    ber_int_t pageCount = 0;
+    LDAPControl **ppReturnedControls = NULL;
+    int errorcodep = 0;
+    BOOLEAN bSearchFinished = FALSE;
+    struct berval * pBerCookie = (struct berval *)pCookie->pvData;
+
     dwError = ldap_parse_result(pDirectory->ld,
                                 pMessage,
                                 &errorcodep,
@@ -957,31 +1042,449 @@ LwLdapDirectoryOnePagedSearch(
         bSearchFinished = TRUE;
     }
 
-    if (ppReturnedControls)
-    {
-       ldap_controls_free(ppReturnedControls);
-       ppReturnedControls = NULL;
-    }
-
-    ppInputControls[0] = NULL;
-    ldap_control_free(pPageControl);
-    pPageControl = NULL;
-
     pCookie->bSearchFinished = bSearchFinished;
-    *ppMessage = pMessage;
     pCookie->pvData = pBerCookie;
     pCookie->pfnFree = LwLdapFreeCookie;
 
 cleanup:
-  /*  dwError_disable = ADDisablePageControlOption(hDirectory);
-    if (dwError_disable)
-        LW_RTL_LOG_ERROR("Error: LDAP Disable PageControl Info: failed");*/
 
     if (ppReturnedControls) {
         ldap_controls_free(ppReturnedControls);
     }
 
-    ppInputControls[0] = NULL;
+    return (dwError);
+
+error:
+
+    pCookie->pvData = pBerCookie;
+    LwLdapResetCookie(pCookie);
+
+    goto cleanup;
+}
+
+static
+VOID
+LwLdapUnlinkAsyncSearch(
+    IN PLW_LDAP_DIRECTORY_CONTEXT pDirectory,
+    IN PLW_LDAP_ASYNC_SEARCH pSearch
+    )
+{
+    PLW_LDAP_ASYNC_SEARCH* ppPos = &pDirectory->pOutstanding;
+
+    while (*ppPos)
+    {
+        if (*ppPos == pSearch)
+        {
+            *ppPos = pSearch->pNext;
+            pSearch->pNext = NULL;
+            pDirectory->dwOutstandingCount--;
+            break;
+        }
+        ppPos = &(*ppPos)->pNext;
+    }
+}
+
+static
+VOID
+LwLdapCompleteAsyncSearch(
+    IN PLW_LDAP_DIRECTORY_CONTEXT pDirectory,
+    IN PLW_LDAP_ASYNC_SEARCH pSearch,
+    IN DWORD dwError,
+    IN LDAPMessage* pMessage
+    )
+{
+    LwLdapUnlinkAsyncSearch(pDirectory, pSearch);
+
+    if (pSearch->pfnCallback)
+    {
+        pSearch->pfnCallback(
+            (HANDLE)pDirectory,
+            pSearch->pContext,
+            dwError,
+            pMessage);
+        LwFreeMemory(pSearch);
+    }
+    else
+    {
+        pSearch->bDone = TRUE;
+        pSearch->dwError = dwError;
+        pSearch->pMessage = pMessage;
+    }
+}
+
+static
+VOID
+LwLdapFailAsyncSearches(
+    IN PLW_LDAP_DIRECTORY_CONTEXT pDirectory,
+    IN DWORD dwError,
+    IN BOOLEAN bAbandon
+    )
+{
+    PLW_LDAP_ASYNC_SEARCH pSearch = NULL;
+
+    while (pDirectory->pOutstanding)
+    {
+        pSearch = pDirectory->pOutstanding;
+
+        if (bAbandon && pDirectory->ld)
+        {
+            ldap_abandon_ext(pDirectory->ld, pSearch->msgid, NULL, NULL);
+        }
+
+        if (!pSearch->pfnCallback && bAbandon)
+        {
+            // Nobody can finish it any more
+            LwLdapUnlinkAsyncSearch(pDirectory, pSearch);
+            LwFreeMemory(pSearch);
+        }
+        else
+        {
+            LwLdapCompleteAsyncSearch(pDirectory, pSearch, dwError, NULL);
+        }
+    }
+}
+
+// Reads results off the connection until one arrives or the timeout
+// expires, then hands every complete result that has arrived to its search.
+static
+DWORD
+LwLdapReadAsyncResults(
+    IN PLW_LDAP_DIRECTORY_CONTEXT pDirectory,
+    IN struct timeval* pTimeout
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    struct timeval poll = {0};
+    LDAPMessage* pMessage = NULL;
+    PLW_LDAP_ASYNC_SEARCH pSearch = NULL;
+    int rc = 0;
+    int msgid = 0;
+    int resultCode = 0;
+
+    while (pDirectory->pOutstanding)
+    {
+        // All searches are read as whole chains. With LDAP_RES_ANY, this
+        // returns the chain of the first search to complete.
+        rc = ldap_result(
+                pDirectory->ld,
+                LDAP_RES_ANY,
+                LDAP_MSG_ALL,
+                pTimeout,
+                &pMessage);
+        if (rc == 0)
+        {
+            if (pTimeout == &poll)
+            {
+                // Nothing more has arrived
+                break;
+            }
+            dwError = LW_ERROR_LDAP_TIMEOUT;
+            BAIL_ON_LW_ERROR(dwError);
+        }
+        else if (rc < 0)
+        {
+            ldap_get_option(pDirectory->ld, LDAP_OPT_RESULT_CODE, &resultCode);
+            dwError = resultCode ? resultCode : LDAP_SERVER_DOWN;
+            BAIL_ON_LDAP_ERROR(dwError);
+        }
+
+        msgid = ldap_msgid(pMessage);
+        for (pSearch = pDirectory->pOutstanding;
+             pSearch && pSearch->msgid != msgid;
+             pSearch = pSearch->pNext);
+
+        if (!pSearch)
+        {
+            LW_RTL_LOG_DEBUG("Dropping ldap result for unknown message id %d", msgid);
+            ldap_msgfree(pMessage);
+            pMessage = NULL;
+            continue;
+        }
+
+        resultCode = 0;
+        dwError = ldap_parse_result(
+                        pDirectory->ld,
+                        pMessage,
+                        &resultCode,
+                        NULL,
+                        NULL,
+                        NULL,
+                        NULL,
+                        0);
+        if (!dwError)
+        {
+            dwError = resultCode;
+        }
+        if (dwError)
+        {
+            LW_RTL_LOG_VERBOSE("Ldap search with message id %d failed with ldap error %d", msgid, dwError);
+            dwError = LwMapLdapErrorToLwError(dwError);
+            ldap_msgfree(pMessage);
+            pMessage = NULL;
+        }
+
+        LwLdapCompleteAsyncSearch(pDirectory, pSearch, dwError, pMessage);
+        pMessage = NULL;
+        dwError = LW_ERROR_SUCCESS;
+
+        // Deliver whatever else is ready without waiting again
+        pTimeout = &poll;
+    }
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    if (dwError != LW_ERROR_LDAP_TIMEOUT)
+    {
+        // The connection is not usable any more
+        LwLdapFailAsyncSearches(pDirectory, dwError, FALSE);
+    }
+
+    goto cleanup;
+}
+
+DWORD
+LwLdapDirectorySearchStart(
+    IN HANDLE hDirectory,
+    IN PCSTR pszObjectDN,
+    IN int scope,
+    IN PCSTR pszQuery,
+    IN PSTR* ppszAttributeList,
+    IN OPTIONAL LDAPControl** ppServerControls,
+    IN DWORD dwNumMaxEntries,
+    IN OPTIONAL PFNLW_LDAP_SEARCH_CALLBACK pfnCallback,
+    IN OPTIONAL PVOID pContext,
+    OUT OPTIONAL PLW_LDAP_ASYNC_SEARCH* ppSearch
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PLW_LDAP_DIRECTORY_CONTEXT pDirectory = (PLW_LDAP_DIRECTORY_CONTEXT)hDirectory;
+    PLW_LDAP_ASYNC_SEARCH pSearch = NULL;
+
+    if (!pfnCallback == !ppSearch)
+    {
+        dwError = LW_ERROR_INVALID_PARAMETER;
+        BAIL_ON_LW_ERROR(dwError);
+    }
+
+    dwError = LwAllocateMemory(sizeof(*pSearch), OUT_PPVOID(&pSearch));
+    BAIL_ON_LW_ERROR(dwError);
+
+    pSearch->pfnCallback = pfnCallback;
+    pSearch->pContext = pContext;
+
+    dwError = ldap_search_ext(
+                    pDirectory->ld,
+                    pszObjectDN,
+                    scope,
+                    pszQuery,
+                    ppszAttributeList,
+                    0,
+                    ppServerControls,
+                    NULL,
+                    NULL,
+                    dwNumMaxEntries,
+                    &pSearch->msgid);
+    if (dwError)
+    {
+        LW_RTL_LOG_VERBOSE("LDAP Search Info: DN: [%s]", LW_IS_NULL_OR_EMPTY_STR(pszObjectDN) ? "<null>" : pszObjectDN);
+        LW_RTL_LOG_VERBOSE("LDAP Search Info: query: [%s]", LW_IS_NULL_OR_EMPTY_STR(pszQuery) ? "<null>" : pszQuery);
+    }
+    BAIL_ON_LDAP_ERROR(dwError);
+
+    pSearch->pNext = pDirectory->pOutstanding;
+    pDirectory->pOutstanding = pSearch;
+    pDirectory->dwOutstandingCount++;
+
+    if (ppSearch)
+    {
+        *ppSearch = pSearch;
+    }
+
+cleanup:
+
+    return dwError;
+
+error:
+
+    LW_SAFE_FREE_MEMORY(pSearch);
+
+    if (ppSearch)
+    {
+        *ppSearch = NULL;
+    }
+
+    goto cleanup;
+}
+
+DWORD
+LwLdapDirectorySearchFinish(
+    IN HANDLE hDirectory,
+    IN PLW_LDAP_ASYNC_SEARCH pSearch,
+    OUT LDAPMessage** ppMessage
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PLW_LDAP_DIRECTORY_CONTEXT pDirectory = (PLW_LDAP_DIRECTORY_CONTEXT)hDirectory;
+    struct timeval timeout = {0};
+    struct timeval now = {0};
+    struct timeval deadline = {0};
+    LDAPMessage* pMessage = NULL;
+
+    gettimeofday(&deadline, NULL);
+    deadline.tv_sec += LW_LDAP_ASYNC_SEARCH_TIMEOUT_SECS;
+
+    while (!pSearch->bDone)
+    {
+        gettimeofday(&now, NULL);
+        if (timercmp(&now, &deadline, >=))
+        {
+            timeout.tv_sec = 0;
+            timeout.tv_usec = 0;
+        }
+        else
+        {
+            timersub(&deadline, &now, &timeout);
+        }
+
+        dwError = LwLdapReadAsyncResults(pDirectory, &timeout);
+        if (dwError == LW_ERROR_LDAP_TIMEOUT)
+        {
+            ldap_abandon_ext(pDirectory->ld, pSearch->msgid, NULL, NULL);
+            LwLdapUnlinkAsyncSearch(pDirectory, pSearch);
+            BAIL_ON_LW_ERROR(dwError);
+        }
+        // Other errors fail every outstanding search, this one included
+        dwError = LW_ERROR_SUCCESS;
+    }
+
+    dwError = pSearch->dwError;
+    pMessage = pSearch->pMessage;
+    pSearch->pMessage = NULL;
+    BAIL_ON_LW_ERROR(dwError);
+
+    *ppMessage = pMessage;
+
+cleanup:
+
+    LwFreeMemory(pSearch);
+
+    return dwError;
+
+error:
+
+    *ppMessage = NULL;
+
+    if (pMessage)
+    {
+        ldap_msgfree(pMessage);
+    }
+
+    goto cleanup;
+}
+
+VOID
+LwLdapDirectorySearchAbandon(
+    IN HANDLE hDirectory,
+    IN PLW_LDAP_ASYNC_SEARCH pSearch
+    )
+{
+    PLW_LDAP_DIRECTORY_CONTEXT pDirectory = (PLW_LDAP_DIRECTORY_CONTEXT)hDirectory;
+
+    if (pSearch)
+    {
+        if (!pSearch->bDone)
+        {
+            ldap_abandon_ext(pDirectory->ld, pSearch->msgid, NULL, NULL);
+            LwLdapUnlinkAsyncSearch(pDirectory, pSearch);
+        }
+
+        if (pSearch->pMessage)
+        {
+            ldap_msgfree(pSearch->pMessage);
+        }
+
+        LwFreeMemory(pSearch);
+    }
+}
+
+DWORD
+LwLdapDirectoryDispatchAsync(
+    IN HANDLE hDirectory,
+    IN DWORD dwTimeoutMsecs,
+    OUT OPTIONAL PDWORD pdwOutstanding
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PLW_LDAP_DIRECTORY_CONTEXT pDirectory = (PLW_LDAP_DIRECTORY_CONTEXT)hDirectory;
+    struct timeval timeout = {0};
+
+    timeout.tv_sec = dwTimeoutMsecs / 1000;
+    timeout.tv_usec = (dwTimeoutMsecs % 1000) * 1000;
+
+    dwError = LwLdapReadAsyncResults(pDirectory, &timeout);
+    if (dwError == LW_ERROR_LDAP_TIMEOUT)
+    {
+        // Nothing arrived, which is not a failure of any search
+        dwError = LW_ERROR_SUCCESS;
+    }
+
+    if (pdwOutstanding)
+    {
+        *pdwOutstanding = pDirectory->dwOutstandingCount;
+    }
+
+    return dwError;
+}
+
+DWORD
+LwLdapDirectoryOnePagedSearchStart(
+    IN HANDLE hDirectory,
+    IN PCSTR pszObjectDN,
+    IN PCSTR pszQuery,
+    IN PSTR* ppszAttributeList,
+    IN DWORD dwPageSize,
+    IN PLW_SEARCH_COOKIE pCookie,
+    IN int scope,
+    OUT PLW_LDAP_ASYNC_SEARCH* ppSearch
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PLW_LDAP_DIRECTORY_CONTEXT pDirectory = (PLW_LDAP_DIRECTORY_CONTEXT)hDirectory;
+    CHAR pagingCriticality = 'T';
+    LDAPControl *pPageControl = NULL;
+    LDAPControl *ppInputControls[2] = { NULL, NULL };
+
+    LW_ASSERT(pCookie->pfnFree == NULL || pCookie->pfnFree == LwLdapFreeCookie);
+
+    dwError = ldap_create_page_control(pDirectory->ld,
+                                       dwPageSize,
+                                       (struct berval *)pCookie->pvData,
+                                       pagingCriticality,
+                                       &pPageControl);
+    BAIL_ON_LDAP_ERROR(dwError);
+
+    ppInputControls[0] = pPageControl;
+
+    // The control is encoded into the request when it is sent, so it can
+    // be freed right away
+    dwError = LwLdapDirectorySearchStart(
+                    hDirectory,
+                    pszObjectDN,
+                    scope,
+                    pszQuery,
+                    ppszAttributeList,
+                    ppInputControls,
+                    0,
+                    NULL,
+                    NULL,
+                    ppSearch);
+    BAIL_ON_LW_ERROR(dwError);
+
+cleanup:
 
     if (pPageControl) {
         ldap_control_free(pPageControl);
@@ -989,19 +1492,54 @@ cleanup:
 
     return (dwError);
 
+error:
+
+    *ppSearch = NULL;
+
+    goto cleanup;
+}
+
+DWORD
+LwLdapDirectoryOnePagedSearchFinish(
+    IN HANDLE hDirectory,
+    IN PLW_LDAP_ASYNC_SEARCH pSearch,
+    IN OUT PLW_SEARCH_COOKIE pCookie,
+    OUT LDAPMessage** ppMessage
+    )
+{
+    DWORD dwError = LW_ERROR_SUCCESS;
+    PLW_LDAP_DIRECTORY_CONTEXT pDirectory = (PLW_LDAP_DIRECTORY_CONTEXT)hDirectory;
+    LDAPMessage* pMessage = NULL;
+
+    dwError = LwLdapDirectorySearchFinish(
+                    hDirectory,
+                    pSearch,
+                    &pMessage);
+    BAIL_ON_LW_ERROR(dwError);
+
+    dwError = LwLdapParsePageResult(
+                    pDirectory,
+                    pMessage,
+                    pCookie);
+    BAIL_ON_LW_ERROR(dwError);
+
+    *ppMessage = pMessage;
+
+cleanup:
+
+    return dwError;
+
 error:
 
     *ppMessage = NULL;
-    pCookie->pvData = NULL;
-    pCookie->pfnFree = NULL;
-    pCookie->bSearchFinished = TRUE;
 
-    if (pBerCookie != NULL)
+    if (pMessage)
     {
-        ber_bvfree(pBerCookie);
-        pBerCookie = NULL;
+        ldap_msgfree(pMessage);
     }
 
+    LwLdapResetCookie(pCookie);
+
     goto cleanup;
 }
 
@@ -49,8 +49,25 @@
 #ifndef __LWLDAP_P_H__
 #define __LWLDAP_P_H__
 
+// Time to wait for the result of a search, from when the caller starts
+// waiting for it
+#define LW_LDAP_ASYNC_SEARCH_TIMEOUT_SECS 60
+
+struct _LW_LDAP_ASYNC_SEARCH {
+    int msgid;
+    PFNLW_LDAP_SEARCH_CALLBACK pfnCallback;
+    PVOID pContext;
+    BOOLEAN bDone;
+    DWORD dwError;
+    LDAPMessage* pMessage;
+    struct _LW_LDAP_ASYNC_SEARCH* pNext;
+};
+
 typedef struct _LW_LDAP_DIRECTORY_CONTEXT {
     LDAP *ld;
+    // Searches whose results have not been read yet
+    PLW_LDAP_ASYNC_SEARCH pOutstanding;
+    DWORD dwOutstandingCount;
 } LW_LDAP_DIRECTORY_CONTEXT, *PLW_LDAP_DIRECTORY_CONTEXT;
 
 DWORD
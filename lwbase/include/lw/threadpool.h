@@ -219,6 +219,29 @@ typedef enum LW_SCHEDULE_FLAGS
  */
 typedef struct _LW_WORK_ITEM LW_WORK_ITEM, *PLW_WORK_ITEM;
 
+/**
+ * @brief Task thread statistics
+ *
+ * Load statistics for one task (event) thread in a thread pool,
+ * as returned by #LwRtlQueryTaskThreadStatistics().
+ */
+typedef struct _LW_TASK_THREAD_STATISTICS
+{
+    /** Number of tasks currently owned by the thread */
+    LW_ULONG ulTasks;
+    /** Time spent running task functions over the last sampling
+        interval, in tenths of a percent */
+    LW_ULONG ulLoad;
+    /** Total time spent running task functions, in nanoseconds */
+    LW_ULONG64 ullBusyTime;
+    /** Total number of task function invocations */
+    LW_ULONG64 ullRunCount;
+    /** Number of tasks moved to this thread to balance load */
+    LW_ULONG ulMigratedIn;
+    /** Number of tasks moved away from this thread to balance load */
+    LW_ULONG ulMigratedOut;
+} LW_TASK_THREAD_STATISTICS, *PLW_TASK_THREAD_STATISTICS;
+
 
 /**
  * @brief Thread pool option
@@ -778,6 +801,40 @@ LwRtlFreeThreadPool(
     LW_IN LW_OUT PLW_THREAD_POOL* ppPool
     );
 
+/**
+ * @brief Query task thread statistics
+ *
+ * Returns a snapshot of the load statistics of each task thread in
+ * the given thread pool.  Thread pool implementations which do not
+ * track a statistic report it as 0.
+ *
+ * @param[in] pPool the thread pool
+ * @param[out] pulCount set to the number of task threads
+ * @param[out] ppStats set to an array of statistics, one per task thread,
+ * which must be freed with #LwRtlFreeTaskThreadStatistics()
+ * @retval #LW_STATUS_SUCCESS success
+ * @retval #LW_STATUS_INSUFFICIENT_RESOURCES out of memory
+ */
+LW_NTSTATUS
+LwRtlQueryTaskThreadStatistics(
+    LW_IN PLW_THREAD_POOL pPool,
+    LW_OUT LW_PULONG pulCount,
+    LW_OUT PLW_TASK_THREAD_STATISTICS* ppStats
+    );
+
+/**
+ * @brief Free task thread statistics
+ *
+ * Frees statistics returned by #LwRtlQueryTaskThreadStatistics().
+ *
+ * @param[in,out] ppStats a reference to the array to free. *ppStats
+ * may be NULL when called and will be set to NULL before returning.
+ */
+LW_VOID
+LwRtlFreeTaskThreadStatistics(
+    LW_IN LW_OUT PLW_TASK_THREAD_STATISTICS* ppStats
+    );
+
 /**
  * @brief Main signal loop
  *
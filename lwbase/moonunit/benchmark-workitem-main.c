@@ -0,0 +1,47 @@
+#include <stdio.h>
+
+#include "benchmark.h"
+
+#define NUM_ITEMS 1000000
+#define NUM_CHAINS 256
+#define MAX_THREADS 64
+
+int main(int argc, char** argv)
+{
+    static WORK_BENCHMARK_SETTINGS settings =
+    {
+        .ulItems = NUM_ITEMS,
+        .ulChains = NUM_CHAINS
+    };
+    PLW_THREAD_POOL_ATTRIBUTES pAttrs = NULL;
+    PLW_THREAD_POOL pPool = NULL;
+    ULONG64 ullTime = 0;
+    ULONG64 ullP99 = 0;
+    LONG lThreads = 0;
+
+    for (lThreads = 1; lThreads <= MAX_THREADS; lThreads *= 2)
+    {
+        LwRtlCreateThreadPoolAttributes(&pAttrs);
+        LwRtlSetThreadPoolAttribute(pAttrs, LW_THREAD_POOL_OPTION_WORK_THREADS, lThreads);
+        /* Start every work thread up front */
+        LwRtlSetThreadPoolAttribute(pAttrs, LW_THREAD_POOL_OPTION_WORK_THREAD_TIMEOUT, 0);
+
+        LwRtlCreateThreadPool(&pPool, pAttrs);
+        LwRtlFreeThreadPoolAttributes(&pAttrs);
+
+        BenchmarkWorkItems(
+            pPool,
+            &settings,
+            &ullTime,
+            &ullP99);
+
+        printf("%2ld threads: %.0f items/s, p99 queueing delay %.1f us\n",
+               (long) lThreads,
+               settings.ulItems / (ullTime / 1000000000.0),
+               ullP99 / 1000.0);
+
+        LwRtlFreeThreadPool(&pPool);
+    }
+
+    return 0;
+}
@@ -7,6 +7,7 @@
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 
 #include "benchmark.h"
@@ -286,3 +287,136 @@ BenchmarkThreadPool(
     *pullDuration = ullTime;
     *pullBytesTransferred = ullTotal;
 }
+
+typedef struct _WORK_ITEM_STATE
+{
+    PLW_WORK_ITEM pItem;
+    LONG64 llQueued;
+    LONG64 llDelay;
+    struct _WORK_ITEM_STATE* pNext;
+} WORK_ITEM_STATE, *PWORK_ITEM_STATE;
+
+static pthread_mutex_t gWorkLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gWorkEvent = PTHREAD_COND_INITIALIZER;
+static LONG volatile glChainsRunning = 0;
+
+/*
+ * Each item records how long it sat in the queue and then schedules
+ * the next item in its chain, so both scheduling from outside the
+ * pool (chain heads) and from a work thread (everything else) are
+ * exercised.
+ */
+static
+VOID
+WorkItemChain(
+    PLW_WORK_ITEM pItem,
+    PVOID pContext
+    )
+{
+    PWORK_ITEM_STATE pState = (PWORK_ITEM_STATE) pContext;
+    LONG64 llNow = 0;
+    NTSTATUS status;
+
+    status = TimeNow(&llNow);
+    ASSERT_SUCCESS(status);
+
+    pState->llDelay = llNow - pState->llQueued;
+
+    if (pState->pNext)
+    {
+        pState->pNext->llQueued = llNow;
+        LwRtlScheduleWorkItem(pState->pNext->pItem, 0);
+    }
+    else if (LwInterlockedDecrement(&glChainsRunning) == 0)
+    {
+        pthread_mutex_lock(&gWorkLock);
+        pthread_cond_signal(&gWorkEvent);
+        pthread_mutex_unlock(&gWorkLock);
+    }
+}
+
+static
+int
+CompareDelay(
+    const void* pA,
+    const void* pB
+    )
+{
+    LONG64 llA = *(const LONG64*) pA;
+    LONG64 llB = *(const LONG64*) pB;
+
+    return llA < llB ? -1 : (llA > llB ? 1 : 0);
+}
+
+VOID
+BenchmarkWorkItems(
+    PLW_THREAD_POOL pPool,
+    PWORK_BENCHMARK_SETTINGS pSettings,
+    PULONG64 pullDuration,
+    PULONG64 pullP99Delay
+    )
+{
+    PWORK_ITEM_STATE pStates = NULL;
+    PLONG64 pllDelays = NULL;
+    ULONG ulItems = pSettings->ulItems - pSettings->ulItems % pSettings->ulChains;
+    size_t i = 0;
+    LONG64 llStart = 0;
+    LONG64 llEnd = 0;
+    NTSTATUS status;
+
+    status = LW_RTL_ALLOCATE_ARRAY_AUTO(&pStates, ulItems);
+    ASSERT_SUCCESS(status);
+
+    status = LW_RTL_ALLOCATE_ARRAY_AUTO(&pllDelays, ulItems);
+    ASSERT_SUCCESS(status);
+
+    for (i = 0; i < ulItems; i++)
+    {
+        status = LwRtlCreateWorkItem(
+            pPool,
+            &pStates[i].pItem,
+            WorkItemChain,
+            &pStates[i]);
+        ASSERT_SUCCESS(status);
+
+        if (i + pSettings->ulChains < ulItems)
+        {
+            pStates[i].pNext = &pStates[i + pSettings->ulChains];
+        }
+    }
+
+    glChainsRunning = pSettings->ulChains;
+
+    status = TimeNow(&llStart);
+    ASSERT_SUCCESS(status);
+
+    for (i = 0; i < pSettings->ulChains; i++)
+    {
+        pStates[i].llQueued = llStart;
+        LwRtlScheduleWorkItem(pStates[i].pItem, 0);
+    }
+
+    pthread_mutex_lock(&gWorkLock);
+    while (LwInterlockedRead(&glChainsRunning))
+    {
+        pthread_cond_wait(&gWorkEvent, &gWorkLock);
+    }
+    pthread_mutex_unlock(&gWorkLock);
+
+    status = TimeNow(&llEnd);
+    ASSERT_SUCCESS(status);
+
+    for (i = 0; i < ulItems; i++)
+    {
+        pllDelays[i] = pStates[i].llDelay;
+        LwRtlFreeWorkItem(&pStates[i].pItem);
+    }
+
+    qsort(pllDelays, ulItems, sizeof(*pllDelays), CompareDelay);
+
+    *pullDuration = (ULONG64) (llEnd - llStart);
+    *pullP99Delay = (ULONG64) pllDelays[(ulItems * 99) / 100];
+
+    RTL_FREE(&pStates);
+    RTL_FREE(&pllDelays);
+}
@@ -16,3 +16,19 @@ BenchmarkThreadPool(
     PULONG64 pullDuration,
     PULONG64 pullBytesTransferred
     );
+
+typedef struct _WORK_BENCHMARK_SETTINGS
+{
+    /* Total number of work items to run */
+    ULONG ulItems;
+    /* Number of independent chains of items */
+    ULONG ulChains;
+} WORK_BENCHMARK_SETTINGS, *PWORK_BENCHMARK_SETTINGS;
+
+VOID
+BenchmarkWorkItems(
+    PLW_THREAD_POOL pPool,
+    PWORK_BENCHMARK_SETTINGS pSettings,
+    PULONG64 pullDuration,
+    PULONG64 pullP99Delay
+    );
@@ -355,6 +355,172 @@ MU_TEST(Task, Transceive)
             (ullTotal / 131072.0) / (ullTime / 1000000000.0));
 }
 
+#define NUM_WORK_ITEMS 100000
+#define NUM_WORK_CHAINS 64
+
+MU_TEST(Task, WorkItemThroughput)
+{
+    static WORK_BENCHMARK_SETTINGS settings =
+    {
+        .ulItems = NUM_WORK_ITEMS,
+        .ulChains = NUM_WORK_CHAINS
+    };
+    ULONG64 ullTime = 0;
+    ULONG64 ullP99 = 0;
+
+    BenchmarkWorkItems(
+        gpPool,
+        &settings,
+        &ullTime,
+        &ullP99);
+
+    MU_INFO("Ran %lu work items in %.2f seconds, %.0f items/s, p99 queueing delay %.1f us",
+            (unsigned long) settings.ulItems,
+            ullTime / 1000000000.0,
+            settings.ulItems / (ullTime / 1000000000.0),
+            ullP99 / 1000.0);
+}
+
+#define NUM_BALANCE_TASKS 6
+/* Give up waiting for a rebalance after this many nanoseconds */
+#define BALANCE_TIMEOUT 30000000000ll
+
+static
+VOID
+BusyTask(
+    PLW_TASK pTask,
+    PVOID pContext,
+    LW_TASK_EVENT_MASK WakeMask,
+    PLW_TASK_EVENT_MASK pWaitMask,
+    PLONG64 pllTime
+    )
+{
+    LONG64 llStart = 0;
+    LONG64 llNow = 0;
+
+    if (WakeMask & LW_TASK_EVENT_CANCEL)
+    {
+        *pWaitMask = LW_TASK_EVENT_COMPLETE;
+        return;
+    }
+
+    /* Even-numbered tasks burn 1.5ms of cpu every 10ms */
+    if (((size_t) pContext) % 2 == 0)
+    {
+        MU_ASSERT_STATUS_SUCCESS(TimeNow(&llStart));
+
+        do
+        {
+            MU_ASSERT_STATUS_SUCCESS(TimeNow(&llNow));
+        } while (llNow - llStart < 1500000ll);
+    }
+
+    *pllTime = 10000000ll;
+    *pWaitMask = LW_TASK_EVENT_TIME;
+}
+
+/*
+ * The three busy tasks start on one thread (45% load against 0%).
+ * Half the difference is one busy task, which should move on the
+ * first rebalance; after that the 30% against 15% split is within
+ * the imbalance threshold, so nothing else should move.  Rather
+ * than sleeping for a fixed time, poll the statistics until the
+ * move shows up.
+ */
+MU_TEST(Task, Rebalance)
+{
+    PLW_THREAD_POOL pPool = NULL;
+    PLW_THREAD_POOL_ATTRIBUTES pAttrs = NULL;
+    PLW_TASK_GROUP pGroup = NULL;
+    PLW_TASK_THREAD_STATISTICS pStats = NULL;
+    PLW_TASK pTask = NULL;
+    ULONG ulCount = 0;
+    ULONG ulMigrated = 0;
+    ULONG ulTasks = 0;
+    ULONG ulIndex = 0;
+    LONG64 llStart = 0;
+    LONG64 llNow = 0;
+
+    MU_ASSERT_STATUS_SUCCESS(LwRtlCreateThreadPoolAttributes(&pAttrs));
+    MU_ASSERT_STATUS_SUCCESS(LwRtlSetThreadPoolAttribute(pAttrs, LW_THREAD_POOL_OPTION_DELEGATE_TASKS, FALSE));
+    MU_ASSERT_STATUS_SUCCESS(LwRtlSetThreadPoolAttribute(pAttrs, LW_THREAD_POOL_OPTION_TASK_THREADS, 2));
+    MU_ASSERT_STATUS_SUCCESS(LwRtlCreateThreadPool(&pPool, pAttrs));
+    MU_ASSERT_STATUS_SUCCESS(LwRtlCreateTaskGroup(pPool, &pGroup));
+
+    MU_ASSERT_STATUS_SUCCESS(LwRtlQueryTaskThreadStatistics(pPool, &ulCount, &pStats));
+    LwRtlFreeTaskThreadStatistics(&pStats);
+
+    if (ulCount < 2)
+    {
+        /* Implementation without load balancing */
+        goto cleanup;
+    }
+
+    /* Tasks go to the thread with the fewest, so the busy ones all start on the first */
+    for (ulIndex = 0; ulIndex < NUM_BALANCE_TASKS; ulIndex++)
+    {
+        MU_ASSERT_STATUS_SUCCESS(LwRtlCreateTask(
+                                     pPool,
+                                     &pTask,
+                                     pGroup,
+                                     BusyTask,
+                                     (PVOID) (size_t) ulIndex));
+        LwRtlReleaseTask(&pTask);
+    }
+
+    LwRtlWakeTaskGroup(pGroup);
+
+    MU_ASSERT_STATUS_SUCCESS(TimeNow(&llStart));
+
+    do
+    {
+        usleep(100000);
+
+        MU_ASSERT_STATUS_SUCCESS(LwRtlQueryTaskThreadStatistics(pPool, &ulCount, &pStats));
+
+        for (ulIndex = 0, ulMigrated = 0; ulIndex < ulCount; ulIndex++)
+        {
+            ulMigrated += pStats[ulIndex].ulMigratedOut;
+        }
+
+        if (ulMigrated == 0)
+        {
+            LwRtlFreeTaskThreadStatistics(&pStats);
+        }
+
+        MU_ASSERT_STATUS_SUCCESS(TimeNow(&llNow));
+    } while (ulMigrated == 0 && llNow - llStart < BALANCE_TIMEOUT);
+
+    MU_ASSERT(ulMigrated > 0);
+
+    for (ulIndex = 0; ulIndex < ulCount; ulIndex++)
+    {
+        MU_INFO("Thread %lu: %lu tasks, load %.1f%%, %llu runs, %lu moved in, %lu moved out",
+                (unsigned long) ulIndex,
+                (unsigned long) pStats[ulIndex].ulTasks,
+                pStats[ulIndex].ulLoad / 10.0,
+                (unsigned long long) pStats[ulIndex].ullRunCount,
+                (unsigned long) pStats[ulIndex].ulMigratedIn,
+                (unsigned long) pStats[ulIndex].ulMigratedOut);
+        ulTasks += pStats[ulIndex].ulTasks;
+    }
+
+    /* Only the busy first thread gives tasks away, and none are lost */
+    MU_ASSERT(pStats[0].ulMigratedOut > 0);
+    MU_ASSERT(pStats[1].ulMigratedIn == pStats[0].ulMigratedOut);
+    MU_ASSERT(ulTasks == NUM_BALANCE_TASKS);
+
+    LwRtlFreeTaskThreadStatistics(&pStats);
+
+cleanup:
+
+    LwRtlCancelTaskGroup(pGroup);
+    LwRtlWaitTaskGroup(pGroup);
+    LwRtlFreeTaskGroup(&pGroup);
+    LwRtlFreeThreadPool(&pPool);
+    LwRtlFreeThreadPoolAttributes(&pAttrs);
+}
+
 static
 VOID
 WaitSigTerm(
@@ -261,6 +261,14 @@ LwRtlFreeThreadPoolAttributes(
     RTL_FREE(ppAttrs);
 }
 
+VOID
+LwRtlFreeTaskThreadStatistics(
+    LW_IN LW_OUT PLW_TASK_THREAD_STATISTICS* ppStats
+    )
+{
+    RTL_FREE(ppStats);
+}
+
 VOID
 SetCloseOnExec(
     int Fd
@@ -269,6 +277,39 @@ SetCloseOnExec(
     fcntl(Fd, F_SETFD, FD_CLOEXEC);
 }
 
+static
+NTSTATUS
+InitWorkQueue(
+    PLW_WORK_QUEUE pQueue
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+
+    RingInit(&pQueue->Items);
+    pQueue->lCount = 0;
+
+    status = LwErrnoToNtStatus(pthread_mutex_init(&pQueue->Lock, NULL));
+    GOTO_ERROR_ON_STATUS(status);
+    pQueue->bDestroyLock = TRUE;
+
+error:
+
+    return status;
+}
+
+static
+VOID
+DestroyWorkQueue(
+    PLW_WORK_QUEUE pQueue
+    )
+{
+    if (pQueue->bDestroyLock)
+    {
+        pthread_mutex_destroy(&pQueue->Lock);
+        pQueue->bDestroyLock = FALSE;
+    }
+}
+
 NTSTATUS
 InitWorkThreads(
     PLW_WORK_THREADS pThreads,
@@ -279,7 +320,12 @@ InitWorkThreads(
     NTSTATUS status = STATUS_SUCCESS;
     size_t i = 0;
 
-    RingInit(&pThreads->WorkItems);
+    status = InitWorkQueue(&pThreads->PriorityQueue);
+    GOTO_ERROR_ON_STATUS(status);
+
+    status = LwErrnoToNtStatus(pthread_key_create(&pThreads->CurrentThreadKey, NULL));
+    GOTO_ERROR_ON_STATUS(status);
+    pThreads->bDestroyKey = TRUE;
 
     status = LwErrnoToNtStatus(pthread_mutex_init(&pThreads->Lock, NULL));
     GOTO_ERROR_ON_STATUS(status);
@@ -302,7 +348,11 @@ InitWorkThreads(
 
         for (i = 0; i < pThreads->ulWorkThreadCount; i++)
         {
+            pThreads->pWorkThreads[i].pThreads = pThreads;
             pThreads->pWorkThreads[i].Thread = INVALID_THREAD_HANDLE;
+
+            status = InitWorkQueue(&pThreads->pWorkThreads[i].Queue);
+            GOTO_ERROR_ON_STATUS(status);
         }
     }
 
@@ -347,9 +397,21 @@ DestroyWorkThreads(
         }
         UNLOCK_THREADS(pThreads);
 
+        for (i = 0; i < pThreads->ulWorkThreadCount; i++)
+        {
+            DestroyWorkQueue(&pThreads->pWorkThreads[i].Queue);
+        }
+
         RtlMemoryFree(pThreads->pWorkThreads);
     }
 
+    DestroyWorkQueue(&pThreads->PriorityQueue);
+
+    if (pThreads->bDestroyKey)
+    {
+        pthread_key_delete(pThreads->CurrentThreadKey);
+    }
+
     if (pThreads->bDestroyLock)
     {        
         pthread_mutex_destroy(&pThreads->Lock);
@@ -361,6 +423,14 @@ DestroyWorkThreads(
     }
 }
 
+/*
+ * Called with pThreads->Lock held and pThread counted in lAvailable.
+ *
+ * lAvailable is incremented before lQueued is read here, and
+ * ScheduleWorkItem increments lQueued before reading lAvailable,
+ * so either we see the new item or the scheduler sees us and
+ * takes the lock to signal.
+ */
 static
 NTSTATUS
 WorkWait(
@@ -374,7 +444,7 @@ WorkWait(
     BOOLEAN bLastThread = FALSE;
     PLW_WORK_THREADS pThreads = pThread->pThreads;
     
-    while (pThreads->ulQueued == 0)
+    while (LwInterlockedRead(&pThreads->lQueued) == 0)
     {
         if (pThreads->bShutdown)
         {
@@ -402,7 +472,11 @@ WorkWait(
         switch(err)
         {
         case ETIMEDOUT:
-            if (!bLastThread)
+            /*
+             * Don't exit if an item was queued as we timed out, since it
+             * may be sitting in our own queue
+             */
+            if (!bLastThread && LwInterlockedRead(&pThreads->lQueued) == 0)
             {
                 status = STATUS_TIMEOUT;
                 GOTO_ERROR_ON_STATUS(status);
@@ -419,6 +493,87 @@ error:
     return status;
 }
 
+static
+PLW_WORK_ITEM
+DequeueWorkQueue(
+    PLW_WORK_QUEUE pQueue
+    )
+{
+    PRING pRing = NULL;
+
+    /* Cheap check so idle threads don't bounce every queue lock */
+    if (LwInterlockedRead(&pQueue->lCount) == 0)
+    {
+        return NULL;
+    }
+
+    LOCK_QUEUE(pQueue);
+
+    if (!RingIsEmpty(&pQueue->Items))
+    {
+        RingDequeue(&pQueue->Items, &pRing);
+        pQueue->lCount--;
+    }
+
+    UNLOCK_QUEUE(pQueue);
+
+    return pRing ? LW_STRUCT_FROM_FIELD(pRing, LW_WORK_ITEM, Ring) : NULL;
+}
+
+/*
+ * Take the next item for pThread: high priority items first, then
+ * our own queue, then steal from the other threads' queues starting
+ * with our neighbor.
+ *
+ * An item is claimed by decrementing lQueued before searching for it.
+ * Items are counted only once they are visible in a queue, so a
+ * successful claim guarantees an unclaimed item exists somewhere and
+ * the search cannot come up empty for long.
+ */
+static
+PLW_WORK_ITEM
+DequeueWorkItem(
+    PLW_WORK_THREAD pThread
+    )
+{
+    PLW_WORK_THREADS pThreads = pThread->pThreads;
+    PLW_WORK_ITEM pItem = NULL;
+    size_t index = pThread - pThreads->pWorkThreads;
+    size_t i = 0;
+    LONG lQueued = 0;
+
+    do
+    {
+        lQueued = LwInterlockedRead(&pThreads->lQueued);
+
+        if (lQueued == 0)
+        {
+            return NULL;
+        }
+    } while (LwInterlockedCompareExchange(
+                 &pThreads->lQueued,
+                 lQueued - 1,
+                 lQueued) != lQueued);
+
+    while (!pItem)
+    {
+        pItem = DequeueWorkQueue(&pThreads->PriorityQueue);
+
+        if (!pItem)
+        {
+            pItem = DequeueWorkQueue(&pThread->Queue);
+        }
+
+        for (i = 1; !pItem && i < pThreads->ulWorkThreadCount; i++)
+        {
+            pItem = DequeueWorkQueue(
+                &pThreads->pWorkThreads[(index + i) % pThreads->ulWorkThreadCount].Queue);
+        }
+    }
+
+    return pItem;
+}
+
 static
 NTSTATUS
 WorkLoop(
@@ -426,46 +581,46 @@ WorkLoop(
     )
 {
     NTSTATUS status = STATUS_SUCCESS;
-    PRING pRing = NULL;
+    PLW_WORK_THREADS pThreads = pThread->pThreads;
     PLW_WORK_ITEM pItem = NULL;
 
-    LOCK_THREADS(pThread->pThreads);
+    pthread_setspecific(pThreads->CurrentThreadKey, pThread);
 
     for(;;)
     {
-        pThread->pThreads->ulAvailable++;
-
-        status = WorkWait(pThread);
-        GOTO_ERROR_ON_STATUS(status);
+        pItem = DequeueWorkItem(pThread);
 
-        RingDequeue(&(pThread->pThreads->WorkItems), &pRing);
-        pThread->pThreads->ulQueued--;
-        pThread->pThreads->ulAvailable--;
+        if (pItem)
+        {
+            pItem->pfnFunc(pItem, pItem->pContext);
+            continue;
+        }
 
-        UNLOCK_THREADS(pThread->pThreads);
+        LOCK_THREADS(pThreads);
 
-        pItem = LW_STRUCT_FROM_FIELD(pRing, LW_WORK_ITEM, Ring);
-        pItem->pfnFunc(pItem, pItem->pContext);
+        LwInterlockedIncrement(&pThreads->lAvailable);
+        status = WorkWait(pThread);
+        LwInterlockedDecrement(&pThreads->lAvailable);
+        GOTO_ERROR_ON_STATUS(status);
 
-        LOCK_THREADS(pThread->pThreads);
+        UNLOCK_THREADS(pThreads);
     }
 
 error:
 
-    pThread->pThreads->ulAvailable--;
-    pThread->pThreads->ulStarted--;
+    pThreads->ulStarted--;
     pThread->bStarted = FALSE;
 
     /* If the thread pool is not being shut down, nothing is
        going to call pthread_join() on this thread, so call
        pthread_detach() now */
-    if (!pThread->pThreads->bShutdown)
+    if (!pThreads->bShutdown)
     {
         pthread_detach(pThread->Thread);
         pThread->Thread = INVALID_THREAD_HANDLE;
     }
 
-    UNLOCK_THREADS(pThread->pThreads);
+    UNLOCK_THREADS(pThreads);
 
     return status;
 }
@@ -593,6 +748,34 @@ FreeWorkItem(
     RTL_FREE(ppWorkItem);
 }
 
+/*
+ * Pick a queue for an item scheduled from outside the pool,
+ * preferring threads that are already running
+ */
+static
+PLW_WORK_THREAD
+PickWorkThread(
+    PLW_WORK_THREADS pThreads
+    )
+{
+    PLW_WORK_THREAD pThread = NULL;
+    size_t i = 0;
+
+    for (i = 0; i < pThreads->ulWorkThreadCount; i++)
+    {
+        pThread = &pThreads->pWorkThreads[
+            (ULONG) LwInterlockedIncrement(&pThreads->lNextQueue) %
+            pThreads->ulWorkThreadCount];
+
+        if (pThread->bStarted)
+        {
+            break;
+        }
+    }
+
+    return pThread;
+}
+
 VOID
 ScheduleWorkItem(
     PLW_WORK_THREADS pThreads,
@@ -600,6 +783,8 @@ ScheduleWorkItem(
     LW_SCHEDULE_FLAGS Flags
     )
 {
+    PLW_WORK_THREAD pThread = NULL;
+    PLW_WORK_QUEUE pQueue = NULL;
     size_t i = 0;
 
     if (pThreads == NULL)
@@ -607,28 +792,60 @@ ScheduleWorkItem(
         pThreads = pItem->pThreads;
     }
 
-    LOCK_THREADS(pThreads);
-    
     assert(pThreads->ulStarted > 0);
 
     /* Enqueue work item */
     if (Flags & LW_SCHEDULE_HIGH_PRIORITY)
     {
-        RingEnqueueFront(&pThreads->WorkItems, &pItem->Ring);
+        pQueue = &pThreads->PriorityQueue;
+
+        LOCK_QUEUE(pQueue);
+        RingEnqueueFront(&pQueue->Items, &pItem->Ring);
+        pQueue->lCount++;
+        UNLOCK_QUEUE(pQueue);
     }
     else
     {
-        RingEnqueue(&pThreads->WorkItems, &pItem->Ring);
+        /*
+         * Work threads push onto their own queue so follow-up work
+         * stays on the same cpu unless someone else is idle enough
+         * to steal it
+         */
+        pThread = pthread_getspecific(pThreads->CurrentThreadKey);
+
+        if (!pThread)
+        {
+            pThread = PickWorkThread(pThreads);
+        }
+
+        pQueue = &pThread->Queue;
+
+        LOCK_QUEUE(pQueue);
+        RingEnqueue(&pQueue->Items, &pItem->Ring);
+        pQueue->lCount++;
+        UNLOCK_QUEUE(pQueue);
+    }
+
+    LwInterlockedIncrement(&pThreads->lQueued);
+
+    /*
+     * Nobody is waiting and no more threads can be started, so
+     * a running thread will pick the item up without our help
+     */
+    if (LwInterlockedRead(&pThreads->lAvailable) == 0 &&
+        pThreads->ulStarted >= pThreads->ulWorkThreadCount)
+    {
+        return;
     }
 
-    pThreads->ulQueued++;
+    LOCK_THREADS(pThreads);
 
     /*
      * If there are more pending work items than there
      * are available threads, and not all threads are started,
      * try to start another one to handle the additional load
      */
-    if (pThreads->ulAvailable < pThreads->ulQueued &&
+    if (LwInterlockedRead(&pThreads->lAvailable) < LwInterlockedRead(&pThreads->lQueued) &&
         pThreads->ulStarted < pThreads->ulWorkThreadCount)
     {
         for (i = 0; i < pThreads->ulWorkThreadCount; i++)
@@ -645,13 +862,12 @@ ScheduleWorkItem(
             }
         }
     }
-    else if (pThreads->ulAvailable)
+    else if (LwInterlockedRead(&pThreads->lAvailable))
     {
         /* Signal an existing thread */
         pthread_cond_signal(&pThreads->Event);
     }
 
-
     UNLOCK_THREADS(pThreads);
 }
 
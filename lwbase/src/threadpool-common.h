@@ -103,10 +103,24 @@ struct _LW_THREAD_POOL_ATTRIBUTES
     ULONG ulWorkThreadTimeout;
 };
 
+/*
+ * Work item queue.  Each work thread owns one, and there is
+ * one more shared queue for high priority items.
+ */
+typedef struct _LW_WORK_QUEUE
+{
+    /* Number of items in queue, written under the lock but read without it */
+    LONG volatile lCount;
+    RING Items;
+    pthread_mutex_t Lock;
+    unsigned bDestroyLock:1;
+} LW_WORK_QUEUE, *PLW_WORK_QUEUE;
+
 typedef struct _LW_WORK_THREAD
 {
     struct _LW_WORK_THREADS* pThreads;
     pthread_t Thread;
+    LW_WORK_QUEUE Queue;
     unsigned volatile bStarted:1;
 } LW_WORK_THREAD, *PLW_WORK_THREAD;
 
@@ -118,19 +132,25 @@ typedef struct _LW_WORK_THREADS
     ULONG ulWorkThreadTimeout;
     /* Number of started threads */
     ULONG volatile ulStarted;
-    /* Number of queued items */
-    ULONG volatile ulQueued;
-    /* Number of threads available to process an item */
-    ULONG volatile ulAvailable;
+    /* Number of queued items across all queues (atomic) */
+    LONG volatile lQueued;
+    /* Number of threads available to process an item (atomic) */
+    LONG volatile lAvailable;
+    /* Round-robin cursor for items scheduled from outside the pool (atomic) */
+    LONG volatile lNextQueue;
     /* Number of unreleased work items */
     ULONG volatile ulWorkItemCount;
-    RING WorkItems;
+    /* High priority items, taken before any per-thread queue */
+    LW_WORK_QUEUE PriorityQueue;
+    /* Maps the calling thread to its LW_WORK_THREAD, if any */
+    pthread_key_t CurrentThreadKey;
     BOOLEAN volatile bShutdown;
     BOOLEAN volatile bWaiting;
     pthread_mutex_t Lock;
     pthread_cond_t Event;
     unsigned bDestroyLock:1;
     unsigned bDestroyEvent:1;
+    unsigned bDestroyKey:1;
 } LW_WORK_THREADS, *PLW_WORK_THREADS;
 
 struct _LW_WORK_ITEM
@@ -161,6 +181,8 @@ typedef struct _LW_SIGNAL_MULTIPLEX
 
 #define LOCK_THREADS(m) (pthread_mutex_lock(&((m)->Lock)))
 #define UNLOCK_THREADS(m) (pthread_mutex_unlock(&((m)->Lock)))
+#define LOCK_QUEUE(q) (pthread_mutex_lock(&((q)->Lock)))
+#define UNLOCK_QUEUE(q) (pthread_mutex_unlock(&((q)->Lock)))
 #define LOCK_SIGNAL() (pthread_mutex_lock(&gSignal.Lock))
 #define UNLOCK_SIGNAL() (pthread_mutex_unlock(&gSignal.Lock))
 
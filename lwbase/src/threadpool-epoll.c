@@ -44,6 +44,16 @@
 /* Maximum number of ticks (task function invocations) to
    process each iteration of the event loop */
 #define MAX_TICKS 1000
+/* Length of the load sampling interval in nanoseconds */
+#define LOAD_INTERVAL 1000000000ll
+/* Difference in load (tenths of a percent) between two threads
+   before tasks are moved from the busier to the idler one */
+#define LOAD_IMBALANCE 200
+/* Maximum number of tasks to move each sampling interval */
+#define MAX_MIGRATE 64
+/* Tasks that ran for less than this many nanoseconds over the
+   last interval are not worth moving */
+#define MIN_MIGRATE_TIME 1000000ll
 
 static
 VOID
@@ -103,6 +113,33 @@ UnlockAllThreads(
     }
 }
 
+/*
+ * Locks the thread that owns a task.  A task only changes owner
+ * while both threads are locked, so check that it did not move
+ * while we were waiting for the lock.
+ */
+static
+PEPOLL_THREAD
+LockTaskThread(
+    PEPOLL_TASK pTask
+    )
+{
+    PEPOLL_THREAD pThread = NULL;
+
+    for (;;)
+    {
+        pThread = pTask->pThread;
+        LOCK_THREAD(pThread);
+
+        if (pThread == pTask->pThread)
+        {
+            return pThread;
+        }
+
+        UNLOCK_THREAD(pThread);
+    }
+}
+
 /*
  * Runs one tick of a task.
  */
@@ -148,44 +185,181 @@ RunTask(
     }
 }
 
+/*
+ * Converts the fd events in a task event mask to epoll events.
+ */
+static
+__uint32_t
+EpollEvents(
+    LW_TASK_EVENT_MASK Mask
+    )
+{
+    __uint32_t events = 0;
+
+    if (Mask & LW_TASK_EVENT_FD_READABLE)
+    {
+        events |= EPOLLIN;
+    }
+
+    if (Mask & LW_TASK_EVENT_FD_WRITABLE)
+    {
+        events |= EPOLLOUT;
+    }
+
+    if (Mask & LW_TASK_EVENT_FD_EXCEPTION)
+    {
+        events |= EPOLLERR;
+    }
+
+    return events;
+}
+
+#ifdef LWBASE_THREADPOOL_URING
+/*
+ * io_uring has no persistent registration like an epoll set, so
+ * each task waiting on its fd has a one-shot poll queued on the
+ * ring of its thread.  The poll completes when the fd becomes
+ * ready or the poll is cancelled, and is queued again the next
+ * time the task waits.  epoll event bits have the same values as
+ * the poll(2) bits the ring expects.
+ */
+
+static
+BOOLEAN
+UringDisabled(
+    VOID
+    )
+{
+    PCSTR pszValue = getenv("LW_DISABLE_IO_URING");
+
+    return pszValue && *pszValue && strcmp(pszValue, "0");
+}
+
+/*
+ * Queues a poll for the fd events a task is waiting on, unless
+ * one is already queued.
+ */
+static
+NTSTATUS
+ArmTaskPoll(
+    PEPOLL_THREAD pThread,
+    PEPOLL_TASK pTask
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    ULONG Events = EpollEvents(pTask->EventWait);
+
+    if (pTask->PollEvents == 0 && pTask->Fd >= 0 && Events)
+    {
+        status = UringPollAdd(&pThread->Uring, pTask->Fd, Events, (ULONG64) (size_t) pTask);
+        GOTO_ERROR_ON_STATUS(status);
+
+        pTask->PollEvents = Events;
+        pThread->ulPolls++;
+    }
+
+error:
+
+    return status;
+}
+
+/*
+ * Cancels the poll queued for a task, if any.  The task keeps
+ * its poll until the cancellation completes.
+ */
+static
+NTSTATUS
+CancelTaskPoll(
+    PEPOLL_THREAD pThread,
+    PEPOLL_TASK pTask
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+
+    if (pTask->PollEvents && !pTask->bPollCancel)
+    {
+        status = UringPollRemove(&pThread->Uring, (ULONG64) (size_t) pTask);
+        GOTO_ERROR_ON_STATUS(status);
+
+        pTask->bPollCancel = TRUE;
+    }
+
+error:
+
+    return status;
+}
+#endif
+
+/*
+ * Returns TRUE if a task has a poll queued on its thread's ring.
+ */
+static inline
+BOOLEAN
+TaskPollQueued(
+    PEPOLL_TASK pTask
+    )
+{
+#ifdef LWBASE_THREADPOOL_URING
+    return pTask->PollEvents != 0;
+#else
+    return FALSE;
+#endif
+}
+
+/*
+ * Returns TRUE if any polls queued on a thread's ring have yet to
+ * complete.
+ */
+static inline
+BOOLEAN
+ThreadPollsQueued(
+    PEPOLL_THREAD pThread
+    )
+{
+#ifdef LWBASE_THREADPOOL_URING
+    return pThread->ulPolls != 0;
+#else
+    return FALSE;
+#endif
+}
+
 /*
  * Updates the epoll set with the events a task is waiting on.
  */
 static
 NTSTATUS
 UpdateEventWait(
-    PEPOLL_TASK pTask,
-    int EpollFd
+    PEPOLL_THREAD pThread,
+    PEPOLL_TASK pTask
     )
 {
     NTSTATUS status = STATUS_SUCCESS;
-    __uint32_t events = 0;
     struct epoll_event event;
 
-    if ((pTask->EventWait & FD_EVENTS) != (pTask->EventLastWait & FD_EVENTS) && pTask->Fd >= 0)
+#ifdef LWBASE_THREADPOOL_URING
+    if (pThread->Uring.Fd >= 0)
     {
-        if (pTask->EventWait & LW_TASK_EVENT_FD_READABLE)
+        if (pTask->PollEvents && pTask->PollEvents != EpollEvents(pTask->EventWait))
         {
-            events |= EPOLLIN;
+            /* A new poll is queued once this one is out of the way */
+            status = CancelTaskPoll(pThread, pTask);
         }
-        
-        if (pTask->EventWait & LW_TASK_EVENT_FD_WRITABLE)
-        {
-            events |= EPOLLOUT;
-        }
-        
-        if (pTask->EventWait & LW_TASK_EVENT_FD_EXCEPTION)
+        else
         {
-            events |= EPOLLERR;
+            status = ArmTaskPoll(pThread, pTask);
         }
-        
-
+        GOTO_ERROR_ON_STATUS(status);
+    }
+    else
+#endif
+    if ((pTask->EventWait & FD_EVENTS) != (pTask->EventLastWait & FD_EVENTS) && pTask->Fd >= 0)
+    {
         memset(&event, 0, sizeof(event));
 
-        event.events = events | EPOLLET;
+        event.events = EpollEvents(pTask->EventWait) | EPOLLET;
         event.data.ptr = pTask;
 
-        if (epoll_ctl(EpollFd, EPOLL_CTL_MOD, pTask->Fd, &event) < 0)
+        if (epoll_ctl(pThread->EpollFd, EPOLL_CTL_MOD, pTask->Fd, &event) < 0)
         {
             ABORT_ON_FATAL_ERRNO(errno);
             status = LwErrnoToNtStatus(errno);
@@ -200,6 +374,209 @@ error:
     return status;
 }
 
+static
+VOID
+TimerWheelInit(
+    PTIMER_WHEEL pWheel
+    )
+{
+    ULONG ulLevel = 0;
+    ULONG ulSlot = 0;
+
+    pWheel->llTick = 0;
+
+    for (ulLevel = 0; ulLevel < TIMER_WHEEL_LEVELS; ulLevel++)
+    {
+        pWheel->ulCount[ulLevel] = 0;
+
+        for (ulSlot = 0; ulSlot < TIMER_WHEEL_SLOTS; ulSlot++)
+        {
+            RingInit(&pWheel->Slots[ulLevel][ulSlot]);
+        }
+    }
+}
+
+static
+BOOLEAN
+TimerWheelIsEmpty(
+    PTIMER_WHEEL pWheel
+    )
+{
+    ULONG ulLevel = 0;
+
+    for (ulLevel = 0; ulLevel < TIMER_WHEEL_LEVELS; ulLevel++)
+    {
+        if (pWheel->ulCount[ulLevel])
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/*
+ * Files a task in the wheel by its deadline.  Level n holds tasks
+ * due less than 64^(n+1) ticks from now, in the slot selected by
+ * bits [6n, 6n+6) of their deadline tick.
+ */
+static
+VOID
+TimerWheelInsert(
+    PTIMER_WHEEL pWheel,
+    PEPOLL_TASK pTask
+    )
+{
+    LONG64 llTick = pTask->llDeadline / TIMER_WHEEL_TICK;
+    LONG64 llDelta = 0;
+    ULONG ulLevel = 0;
+
+    /* Deadlines already passed go in the current slot */
+    if (llTick < pWheel->llTick)
+    {
+        llTick = pWheel->llTick;
+    }
+
+    llDelta = llTick - pWheel->llTick;
+
+    if (llDelta >= (1ll << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)))
+    {
+        /* Park it in the furthest slot; it is refiled when that slot cascades */
+        llDelta = (1ll << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) - 1;
+        llTick = pWheel->llTick + llDelta;
+    }
+
+    while (llDelta >= (1ll << ((ulLevel + 1) * TIMER_WHEEL_BITS)))
+    {
+        ulLevel++;
+    }
+
+    RingEnqueue(
+        &pWheel->Slots[ulLevel][(llTick >> (ulLevel * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK],
+        &pTask->QueueRing);
+    pWheel->ulCount[ulLevel]++;
+    pTask->lTimerLevel = ulLevel;
+}
+
+/*
+ * Refiles the tasks in the slot of the given level that
+ * the wheel has just reached.
+ */
+static
+VOID
+TimerWheelCascade(
+    PTIMER_WHEEL pWheel,
+    ULONG ulLevel
+    )
+{
+    RING cascade;
+    PRING pRing = NULL;
+    PEPOLL_TASK pTask = NULL;
+
+    RingInit(&cascade);
+    RingMove(
+        &pWheel->Slots[ulLevel][(pWheel->llTick >> (ulLevel * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK],
+        &cascade);
+
+    while (!RingIsEmpty(&cascade))
+    {
+        RingDequeue(&cascade, &pRing);
+        pTask = LW_STRUCT_FROM_FIELD(pRing, EPOLL_TASK, QueueRing);
+
+        pWheel->ulCount[ulLevel]--;
+        TimerWheelInsert(pWheel, pTask);
+    }
+}
+
+/*
+ * Returns the time at which the wheel next needs attention: the
+ * earliest deadline in level 0, or the next time a higher level
+ * slot with tasks in it cascades, whichever is sooner.
+ */
+static
+LONG64
+TimerWheelNextDeadline(
+    PTIMER_WHEEL pWheel
+    )
+{
+    LONG64 llNext = -1;
+    LONG64 llCandidate = 0;
+    LONG64 llPeriod = 0;
+    ULONG ulLevel = 0;
+    ULONG ulDistance = 0;
+    PRING pSlot = NULL;
+    PRING pRing = NULL;
+    PEPOLL_TASK pTask = NULL;
+
+    for (ulLevel = 0; ulLevel < TIMER_WHEEL_LEVELS; ulLevel++)
+    {
+        if (!pWheel->ulCount[ulLevel])
+        {
+            continue;
+        }
+
+        llPeriod = pWheel->llTick >> (ulLevel * TIMER_WHEEL_BITS);
+
+        /* Level 0 can hold the current tick; higher levels are at least one period out */
+        for (ulDistance = ulLevel ? 1 : 0; ulDistance <= TIMER_WHEEL_SLOTS; ulDistance++)
+        {
+            pSlot = &pWheel->Slots[ulLevel][(llPeriod + ulDistance) & TIMER_WHEEL_MASK];
+
+            if (!RingIsEmpty(pSlot))
+            {
+                break;
+            }
+        }
+
+        assert(ulDistance <= TIMER_WHEEL_SLOTS);
+
+        if (ulLevel == 0)
+        {
+            llCandidate = -1;
+
+            for (pRing = pSlot->pNext; pRing != pSlot; pRing = pRing->pNext)
+            {
+                pTask = LW_STRUCT_FROM_FIELD(pRing, EPOLL_TASK, QueueRing);
+
+                if (llCandidate < 0 || pTask->llDeadline < llCandidate)
+                {
+                    llCandidate = pTask->llDeadline;
+                }
+            }
+        }
+        else
+        {
+            llCandidate = ((llPeriod + ulDistance) << (ulLevel * TIMER_WHEEL_BITS)) * TIMER_WHEEL_TICK;
+        }
+
+        if (llNext < 0 || llCandidate < llNext)
+        {
+            llNext = llCandidate;
+        }
+    }
+
+    return llNext;
+}
+
+/*
+ * Removes a task from whichever scheduler queue it is on,
+ * keeping the timer wheel counts straight
+ */
+static
+VOID
+DequeueTask(
+    PEPOLL_TASK pTask
+    )
+{
+    if (pTask->lTimerLevel >= 0)
+    {
+        pTask->pThread->Timers.ulCount[pTask->lTimerLevel]--;
+        pTask->lTimerLevel = -1;
+    }
+
+    RingRemove(&pTask->QueueRing);
+}
+
 /*
  * Updates the event args on tasks from epoll results and
  * schedules them to run.
@@ -207,6 +584,7 @@ error:
 static
 VOID
 ScheduleWaitingTasks(
+    PEPOLL_THREAD pThread,
     struct epoll_event* pEvents,
     int eventCount,
     LONG64 llNow,
@@ -258,64 +636,98 @@ ScheduleWaitingTasks(
         /* Schedule task to run if it has been triggered */
         if (pTask->EventWait & pTask->EventArgs)
         {
-            RingRemove(&pTask->QueueRing);
+            DequeueTask(pTask);
+            RingEnqueue(pRunnable, &pTask->QueueRing);
+        }
+#ifdef LWBASE_THREADPOOL_URING
+        else if (pThread->Uring.Fd >= 0 &&
+                 !NT_SUCCESS(ArmTaskPoll(pThread, pTask)))
+        {
+            /* The poll was cancelled or fired for events the task no
+               longer waits for, and could not be queued again */
+            LW_RTL_LOG_ERROR("Could not queue poll for fd %d", pTask->Fd);
+            pTask->EventArgs |= LW_TASK_EVENT_FD_EXCEPTION;
+            DequeueTask(pTask);
             RingEnqueue(pRunnable, &pTask->QueueRing);
         }
+#endif
     }
 }
 
 static
 VOID
 ScheduleTimedTasks(
-    PRING pTimed,
+    PTIMER_WHEEL pWheel,
     LONG64 llNow,
     PRING pRunnable
     )
 {
+    LONG64 llNowTick = llNow / TIMER_WHEEL_TICK;
+    LONG64 llNextTick = 0;
     PLW_TASK pTask = NULL;
+    PRING pSlot = NULL;
     PRING pRing = NULL;
     PRING pNext = NULL;
+    ULONG ulLevel = 0;
 
-    for (pRing = pTimed->pNext; pRing != pTimed; pRing = pNext)
+    for (;;)
     {
-        pNext = pRing->pNext;
-        pTask = LW_STRUCT_FROM_FIELD(pRing, EPOLL_TASK, QueueRing);
-        
-        /* No more tasks in the queue are past the deadline
-           since the queue is sorted */
-        if (pTask->llDeadline > llNow)
+        pSlot = &pWheel->Slots[0][pWheel->llTick & TIMER_WHEEL_MASK];
+
+        /* Everything in slots behind the current tick is due; the
+           current slot may still hold tasks due later this tick */
+        for (pRing = pSlot->pNext; pRing != pSlot; pRing = pNext)
         {
-            break;
-        }
+            pNext = pRing->pNext;
+            pTask = LW_STRUCT_FROM_FIELD(pRing, EPOLL_TASK, QueueRing);
 
-        RingRemove(&pTask->QueueRing);
-        RingEnqueue(pRunnable, &pTask->QueueRing);
-        
-        pTask->EventArgs |= LW_TASK_EVENT_TIME;
-    }
-}
+            if (pTask->llDeadline <= llNow)
+            {
+                DequeueTask(pTask);
+                RingEnqueue(pRunnable, &pTask->QueueRing);
 
-static
-VOID
-InsertTimedQueue(
-    PRING pTimed,
-    PLW_TASK pInsert
-    )
-{
-    PLW_TASK pTask = NULL;
-    PRING pRing = NULL;
+                pTask->EventArgs |= LW_TASK_EVENT_TIME;
+            }
+        }
 
-    /* Find the first task in the queue with a later deadline than the task to insert */
-    for (pRing = pTimed->pNext; pRing != pTimed; pRing = pRing->pNext)
-    {
-        pTask = LW_STRUCT_FROM_FIELD(pRing, EPOLL_TASK, QueueRing);
-     
-        if (pTask->llDeadline > pInsert->llDeadline)
+        if (pWheel->llTick >= llNowTick)
+        {
             break;
-    }
+        }
+
+        /* Skip straight to the next tick at which a non-empty level
+           cascades rather than visiting every empty slot on the way */
+        for (ulLevel = 0; ulLevel < TIMER_WHEEL_LEVELS; ulLevel++)
+        {
+            if (pWheel->ulCount[ulLevel])
+            {
+                break;
+            }
+        }
+
+        if (ulLevel == TIMER_WHEEL_LEVELS)
+        {
+            pWheel->llTick = llNowTick;
+            break;
+        }
 
-    /* Insert the task */
-    RingInsertBefore(pRing, &pInsert->QueueRing);
+        llNextTick =
+            ((pWheel->llTick >> (ulLevel * TIMER_WHEEL_BITS)) + 1) <<
+            (ulLevel * TIMER_WHEEL_BITS);
+
+        pWheel->llTick = llNextTick < llNowTick ? llNextTick : llNowTick;
+
+        /* Level n cascades whenever the low 6n bits of the tick wrap to 0 */
+        for (ulLevel = 1; ulLevel < TIMER_WHEEL_LEVELS; ulLevel++)
+        {
+            if (pWheel->llTick & ((1ll << (ulLevel * TIMER_WHEEL_BITS)) - 1))
+            {
+                break;
+            }
+
+            TimerWheelCascade(pWheel, ulLevel);
+        }
+    }
 }
 
 static
@@ -359,141 +771,578 @@ Poll(
         }
     } while (ready < 0 && errno == EINTR);
 
-    if (ready < 0)
+    if (ready < 0)
+    {
+        ABORT_ON_FATAL_ERRNO(errno);
+        status = LwErrnoToNtStatus(errno);
+        GOTO_ERROR_ON_STATUS(status);
+    }
+
+    *pReady = ready;
+
+error:
+
+    return status;
+}
+
+#ifdef LWBASE_THREADPOOL_URING
+/*
+ * Equivalent of Poll() for threads using io_uring.  Submits any
+ * queued polls, waits for completions and converts them into
+ * epoll events.
+ */
+static
+NTSTATUS
+PollRing(
+    IN PEPOLL_THREAD pThread,
+    IN PCLOCK pClock,
+    IN OUT PLONG64 pllNow,
+    OUT struct epoll_event* pEvents,
+    IN int maxEvents,
+    IN LONG64 llNextDeadline,
+    OUT int* pReady
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    struct io_uring_cqe* pCqe = NULL;
+    PEPOLL_TASK pTask = NULL;
+    ULONG64 Data = 0;
+    LONG64 llTimeout = 0;
+    int ready = 0;
+    int res = 0;
+
+    do
+    {
+        if (llNextDeadline >= 0)
+        {
+            llTimeout = llNextDeadline - *pllNow;
+            if (llTimeout < 0)
+            {
+                llTimeout = 0;
+            }
+        }
+        else
+        {
+            llTimeout = -1;
+        }
+
+        res = UringEnter(&pThread->Uring, llTimeout);
+        if (res < 0 && errno == EINTR)
+        {
+            /* Update current time so the next timeout calculation is correct */
+            status = ClockGetMonotonicTime(pClock, pllNow);
+            GOTO_ERROR_ON_STATUS(status);
+        }
+    } while (res < 0 && errno == EINTR);
+
+    if (res < 0)
+    {
+        ABORT_ON_FATAL_ERRNO(errno);
+        status = LwErrnoToNtStatus(errno);
+        GOTO_ERROR_ON_STATUS(status);
+    }
+
+    while (ready < maxEvents && (pCqe = UringPeekCompletion(&pThread->Uring)))
+    {
+        Data = pCqe->user_data;
+        res = pCqe->res;
+        UringAdvanceCompletion(&pThread->Uring);
+
+        if (Data == URING_DATA_IGNORE)
+        {
+            continue;
+        }
+
+        if (Data == 0)
+        {
+            /* Thread signal fd became readable.  The poll for it is
+               submitted again after ScheduleSignalled() has drained it */
+            pEvents[ready].events = EPOLLIN;
+            pEvents[ready].data.ptr = NULL;
+            ready++;
+
+            status = UringPollAdd(&pThread->Uring, pThread->SignalFds[0], EPOLLIN, 0);
+            GOTO_ERROR_ON_STATUS(status);
+            continue;
+        }
+
+        pTask = (PEPOLL_TASK) (size_t) Data;
+
+        pThread->ulPolls--;
+        pTask->PollEvents = 0;
+        pTask->bPollCancel = FALSE;
+
+        if (pTask->EventWait == LW_TASK_EVENT_COMPLETE)
+        {
+            /* The poll was holding the last reference the thread had
+               to a completed task */
+            LwRtlReleaseTask(&pTask);
+            continue;
+        }
+
+        if (res >= 0)
+        {
+            pEvents[ready].events = res;
+        }
+        else if (res == -ECANCELED)
+        {
+            /* No events, but ScheduleWaitingTasks() will queue a
+               new poll if the task still needs one */
+            pEvents[ready].events = 0;
+        }
+        else
+        {
+            /* Report poll failure (e.g. a closed fd) the way epoll
+               reports a broken descriptor */
+            pEvents[ready].events = EPOLLERR | EPOLLHUP;
+        }
+
+        pEvents[ready].data.ptr = pTask;
+        ready++;
+    }
+
+    *pReady = ready;
+
+error:
+
+    return status;
+}
+#endif
+
+static
+VOID
+AccountTask(
+    PEPOLL_THREAD pThread,
+    PEPOLL_TASK pTask,
+    LONG64 llRunTime
+    )
+{
+    if (pTask->ulRunInterval != pThread->ulInterval)
+    {
+        pTask->ulRunInterval = pThread->ulInterval;
+        pTask->llRunTime = 0;
+    }
+
+    pTask->llRunTime += llRunTime;
+    pThread->llIntervalBusy += llRunTime;
+    pThread->ulIntervalRuns++;
+}
+
+static
+NTSTATUS
+ProcessRunnable(
+    PEPOLL_THREAD pThread,
+    PCLOCK pClock,
+    PRING pRunnable,
+    PTIMER_WHEEL pTimers,
+    PRING pWaiting,
+    LONG64 llNow
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    ULONG ulTicks = MAX_TICKS;
+    PLW_TASK pTask = NULL;
+    PLW_TASK_GROUP pGroup = NULL;
+    PRING pRing = NULL;
+    PRING pNext = NULL;
+    LONG64 llRunStart = 0;
+    LONG64 llRunEnd = 0;
+
+    if (!RingIsEmpty(pRunnable))
+    {
+        status = ClockGetMonotonicTime(pClock, &llRunStart);
+        GOTO_ERROR_ON_STATUS(status);
+    }
+    
+    /* We are guaranteed to run each task at least once.  If tasks remain
+       on the runnable list by yielding, we will continue to run them
+       all in a round robin until our ticks are depleted. */
+    while (ulTicks && !RingIsEmpty(pRunnable))
+    {
+        for (pRing = pRunnable->pNext; pRing != pRunnable; pRing = pNext)
+        {
+            pNext = pRing->pNext;
+            
+            pTask = LW_STRUCT_FROM_FIELD(pRing, EPOLL_TASK, QueueRing);
+            
+            RunTask(pTask, llNow);
+
+            /* Charge the time since the last task finished to this one */
+            status = ClockGetMonotonicTime(pClock, &llRunEnd);
+            GOTO_ERROR_ON_STATUS(status);
+
+            AccountTask(pThread, pTask, llRunEnd - llRunStart);
+            llRunStart = llRunEnd;
+
+            if (ulTicks)
+            {
+                ulTicks--;
+            }
+            
+            if (pTask->EventWait != LW_TASK_EVENT_COMPLETE)
+            {
+                /* Task is still waiting to be runnable, update events in epoll set */
+                status = UpdateEventWait(pThread, pTask);
+                GOTO_ERROR_ON_STATUS(status);
+                
+                if (pTask->EventWait & LW_TASK_EVENT_YIELD)
+                {
+                    /* Task is yielding.  Set YIELD in its trigger arguments and
+                       and leave it on the runnable list for the next iteration */
+                    pTask->EventArgs |= LW_TASK_EVENT_YIELD;
+                }                
+                else if (pTask->EventWait & LW_TASK_EVENT_TIME)
+                {
+                    /* If the task is waiting for a timeout, file it in the timer wheel */
+                    RingRemove(&pTask->QueueRing);
+                    TimerWheelInsert(pTimers, pTask);
+                }
+                else
+                {
+                    /* Otherwise, put it in the generic waiting queue */
+                    RingRemove(&pTask->QueueRing);
+                    RingEnqueue(pWaiting, &pTask->QueueRing);
+                }
+            }
+            else
+            {
+                /* Task is complete */
+                RingRemove(&pTask->QueueRing);
+
+                /* Turn off any fd in the epoll set */
+                if (pTask->Fd >= 0)
+                {
+                    status = LwRtlSetTaskFd(pTask, pTask->Fd, 0);
+                    GOTO_ERROR_ON_STATUS(status);
+                }
+
+                /* Unsubscribe task from any UNIX signals */
+                if (pTask->pUnixSignal)
+                {
+                    RegisterTaskUnixSignal(pTask, 0, FALSE);
+                }
+
+                LOCK_POOL(pThread->pPool);
+                pThread->ulLoad--;
+                UNLOCK_POOL(pThread->pPool);
+                
+                pGroup = pTask->pGroup;
+
+                /* If task was in a task group, remove it and notify anyone waiting
+                   on the group */
+                if (pGroup)
+                {
+                    LOCK_GROUP(pGroup);
+                    pTask->pGroup = NULL;
+                    RingRemove(&pTask->GroupRing);
+                    pthread_cond_broadcast(&pGroup->Event);
+                    UNLOCK_GROUP(pGroup);
+                }
+                
+                LOCK_THREAD(pThread);
+                /* A queued poll keeps the task alive until its cancellation
+                   completes, and drops our reference then */
+                if (TaskPollQueued(pTask) || --pTask->ulRefCount)
+                {
+                    /* The task still has a reference, so mark it as completed
+                       and notify anyone waiting on it */
+                    pTask->EventSignal = TASK_COMPLETE_MASK;
+                    pthread_cond_broadcast(&pThread->Event);
+                    UNLOCK_THREAD(pThread);
+                }
+                else
+                {
+                    /* We held the last reference to the task, so delete it */
+                    RingRemove(&pTask->SignalRing);
+                    UNLOCK_THREAD(pThread);
+                    TaskDelete(pTask);
+                }
+            }
+        }
+    }
+
+error:
+
+    return status;
+}
+
+/*
+ * Files a task handed over by another thread in our own queues.
+ * Called with the thread lock held.
+ */
+static
+VOID
+AdoptTask(
+    PEPOLL_THREAD pThread,
+    PEPOLL_TASK pTask,
+    PRING pRunnable,
+    PRING pWaiting,
+    LONG64 llNow
+    )
+{
+    struct epoll_event event;
+
+    /* Deadlines are handed over relative to the old thread's clock */
+    if (pTask->llDeadline != 0)
+    {
+        pTask->llDeadline += llNow;
+    }
+
+#ifdef LWBASE_THREADPOOL_URING
+    if (pTask->Fd >= 0 && pThread->Uring.Fd >= 0)
+    {
+        if (!NT_SUCCESS(ArmTaskPoll(pThread, pTask)))
+        {
+            LW_RTL_LOG_ERROR("Could not queue poll for fd %d of migrated task", pTask->Fd);
+
+            pTask->EventArgs |= LW_TASK_EVENT_FD_EXCEPTION;
+            RingEnqueue(pRunnable, &pTask->QueueRing);
+            return;
+        }
+    }
+    else
+#endif
+    if (pTask->Fd >= 0)
+    {
+        memset(&event, 0, sizeof(event));
+
+        /* Edge-triggered registration reports an fd that is already
+           ready, so nothing that happened in transit is lost */
+        event.events = EpollEvents(pTask->EventLastWait) | EPOLLET;
+        event.data.ptr = pTask;
+
+        if (epoll_ctl(pThread->EpollFd, EPOLL_CTL_ADD, pTask->Fd, &event) < 0)
+        {
+            ABORT_ON_FATAL_ERRNO(errno);
+            LW_RTL_LOG_ERROR("Could not register fd %d of migrated task: %d", pTask->Fd, errno);
+
+            /* Let the task see the failure rather than wait forever */
+            pTask->EventArgs |= LW_TASK_EVENT_FD_EXCEPTION;
+            RingEnqueue(pRunnable, &pTask->QueueRing);
+            return;
+        }
+    }
+
+    if (pTask->EventWait & LW_TASK_EVENT_TIME)
+    {
+        TimerWheelInsert(&pThread->Timers, pTask);
+    }
+    else
+    {
+        RingEnqueue(pWaiting, &pTask->QueueRing);
+    }
+}
+
+/*
+ * Hands a task waiting in one of our queues over to another thread.
+ * Returns FALSE if the task could not be moved and was left in place.
+ */
+static
+BOOLEAN
+MigrateTask(
+    PEPOLL_THREAD pThread,
+    PEPOLL_THREAD pTarget,
+    PEPOLL_TASK pTask,
+    LONG64 llNow
+    )
+{
+    struct epoll_event event;
+    PEPOLL_THREAD pFirst = pThread < pTarget ? pThread : pTarget;
+    PEPOLL_THREAD pSecond = pThread < pTarget ? pTarget : pThread;
+
+    if (TaskPollQueued(pTask))
+    {
+        /* The poll would complete on our ring, not the target's */
+        return FALSE;
+    }
+
+    if (pTask->Fd >= 0 && pThread->EpollFd >= 0)
+    {
+        memset(&event, 0, sizeof(event));
+
+        if (epoll_ctl(pThread->EpollFd, EPOLL_CTL_DEL, pTask->Fd, &event) < 0)
+        {
+            ABORT_ON_FATAL_ERRNO(errno);
+            return FALSE;
+        }
+    }
+
+    DequeueTask(pTask);
+
+    if (pTask->llDeadline != 0)
+    {
+        pTask->llDeadline -= llNow;
+    }
+
+    pTask->llRunTime = 0;
+
+    /* Lock threads at a lower index first */
+    LOCK_THREAD(pFirst);
+    LOCK_THREAD(pSecond);
+
+    pTask->pThread = pTarget;
+
+    /* Carry over any pending signal */
+    if (!RingIsEmpty(&pTask->SignalRing))
+    {
+        RingRemove(&pTask->SignalRing);
+        RingEnqueue(&pTarget->Tasks, &pTask->SignalRing);
+    }
+
+    RingEnqueue(&pTarget->Migrated, &pTask->QueueRing);
+    SignalThread(pTarget);
+
+    /* Anyone waiting on the task must now wait on the new thread */
+    pthread_cond_broadcast(&pThread->Event);
+
+    UNLOCK_THREAD(pSecond);
+    UNLOCK_THREAD(pFirst);
+
+    return TRUE;
+}
+
+/*
+ * Moves tasks from a queue to another thread until their run time
+ * over the last interval adds up to the budget.  Tasks that would
+ * overshoot the budget are skipped so a single busy task does not
+ * bounce between threads.
+ */
+static
+VOID
+MigrateQueue(
+    PEPOLL_THREAD pThread,
+    PEPOLL_THREAD pTarget,
+    PRING pQueue,
+    LONG64 llNow,
+    PLONG64 pllBudget,
+    PULONG pulMoved
+    )
+{
+    PRING pRing = NULL;
+    PRING pNext = NULL;
+    PEPOLL_TASK pTask = NULL;
+
+    for (pRing = pQueue->pNext;
+         pRing != pQueue && *pllBudget > 0 && *pulMoved < MAX_MIGRATE;
+         pRing = pNext)
     {
-        ABORT_ON_FATAL_ERRNO(errno);
-        status = LwErrnoToNtStatus(errno);
-        GOTO_ERROR_ON_STATUS(status);
-    }
+        pNext = pRing->pNext;
+        pTask = LW_STRUCT_FROM_FIELD(pRing, EPOLL_TASK, QueueRing);
 
-    *pReady = ready;
+        if (pTask->ulRunInterval != pThread->ulInterval ||
+            pTask->llRunTime < MIN_MIGRATE_TIME ||
+            pTask->llRunTime > *pllBudget ||
+            /* UNIX signal delivery waits on the owning thread */
+            pTask->pUnixSignal)
+        {
+            continue;
+        }
 
-error:
+        *pllBudget -= pTask->llRunTime;
 
-    return status;
+        if (MigrateTask(pThread, pTarget, pTask, llNow))
+        {
+            (*pulMoved)++;
+        }
+    }
 }
 
+/*
+ * Called at the end of each sampling interval.  Publishes our load
+ * and, if we are much busier than the idlest thread, moves some of
+ * our waiting tasks to it.
+ */
 static
-NTSTATUS
-ProcessRunnable(
+VOID
+BalanceLoad(
     PEPOLL_THREAD pThread,
-    PRING pRunnable,
-    PRING pTimed,
     PRING pWaiting,
     LONG64 llNow
     )
 {
-    NTSTATUS status = STATUS_SUCCESS;
-    ULONG ulTicks = MAX_TICKS;
-    PLW_TASK pTask = NULL;
-    PLW_TASK_GROUP pGroup = NULL;
-    PRING pRing = NULL;
-    PRING pNext = NULL;
-    
-    /* We are guaranteed to run each task at least once.  If tasks remain
-       on the runnable list by yielding, we will continue to run them
-       all in a round robin until our ticks are depleted. */
-    while (ulTicks && !RingIsEmpty(pRunnable))
+    PEPOLL_POOL pPool = pThread->pPool;
+    PEPOLL_THREAD pTarget = NULL;
+    LONG64 llElapsed = llNow - pThread->llIntervalStart;
+    LONG64 llBudget = 0;
+    ULONG ulLoad = 0;
+    ULONG ulMoved = 0;
+    ULONG ulIndex = 0;
+    ULONG ulLevel = 0;
+    ULONG ulSlot = 0;
+
+    ulLoad = (ULONG) (pThread->llIntervalBusy * 1000 / llElapsed);
+
+    if (ulLoad > 1000)
     {
-        for (pRing = pRunnable->pNext; pRing != pRunnable; pRing = pNext)
-        {
-            pNext = pRing->pNext;
-            
-            pTask = LW_STRUCT_FROM_FIELD(pRing, EPOLL_TASK, QueueRing);
-            
-            RunTask(pTask, llNow);
+        ulLoad = 1000;
+    }
 
-            if (ulTicks)
-            {
-                ulTicks--;
-            }
-            
-            if (pTask->EventWait != LW_TASK_EVENT_COMPLETE)
-            {
-                /* Task is still waiting to be runnable, update events in epoll set */
-                status = UpdateEventWait(
-                    pTask,
-                    pThread->EpollFd
-                    );
-                GOTO_ERROR_ON_STATUS(status);
-                
-                if (pTask->EventWait & LW_TASK_EVENT_YIELD)
-                {
-                    /* Task is yielding.  Set YIELD in its trigger arguments and
-                       and leave it on the runnable list for the next iteration */
-                    pTask->EventArgs |= LW_TASK_EVENT_YIELD;
-                }                
-                else if (pTask->EventWait & LW_TASK_EVENT_TIME)
-                {
-                    /* If the task is waiting for a timeout, insert it into the timed queue */
-                    RingRemove(&pTask->QueueRing);
-                    InsertTimedQueue(pTimed, pTask);
-                }
-                else
-                {
-                    /* Otherwise, put it in the generic waiting queue */
-                    RingRemove(&pTask->QueueRing);
-                    RingEnqueue(pWaiting, &pTask->QueueRing);
-                }
-            }
-            else
-            {
-                /* Task is complete */
-                RingRemove(&pTask->QueueRing);
+    LOCK_POOL(pPool);
 
-                /* Turn off any fd in the epoll set */
-                if (pTask->Fd >= 0)
-                {
-                    status = LwRtlSetTaskFd(pTask, pTask->Fd, 0);
-                    GOTO_ERROR_ON_STATUS(status);
-                }
+    pThread->ulRecentLoad = ulLoad;
+    pThread->ullBusyTime += pThread->llIntervalBusy;
+    pThread->ullRunCount += pThread->ulIntervalRuns;
 
-                /* Unsubscribe task from any UNIX signals */
-                if (pTask->pUnixSignal)
-                {
-                    RegisterTaskUnixSignal(pTask, 0, FALSE);
-                }
+    for (ulIndex = 0; ulIndex < pPool->ulEventThreadCount; ulIndex++)
+    {
+        if (&pPool->pEventThreads[ulIndex] != pThread &&
+            !pPool->pEventThreads[ulIndex].bShutdown &&
+            (!pTarget || pPool->pEventThreads[ulIndex].ulRecentLoad < pTarget->ulRecentLoad))
+        {
+            pTarget = &pPool->pEventThreads[ulIndex];
+        }
+    }
 
-                LOCK_POOL(pThread->pPool);
-                pThread->ulLoad--;
-                UNLOCK_POOL(pThread->pPool);
-                
-                pGroup = pTask->pGroup;
+    if (pTarget && !pThread->bShutdown &&
+        ulLoad > pTarget->ulRecentLoad + LOAD_IMBALANCE)
+    {
+        /* Aim to move half the difference */
+        llBudget = (ulLoad - pTarget->ulRecentLoad) * llElapsed / 2000;
+    }
 
-                /* If task was in a task group, remove it and notify anyone waiting
-                   on the group */
-                if (pGroup)
-                {
-                    LOCK_GROUP(pGroup);
-                    pTask->pGroup = NULL;
-                    RingRemove(&pTask->GroupRing);
-                    pthread_cond_broadcast(&pGroup->Event);
-                    UNLOCK_GROUP(pGroup);
-                }
-                
-                LOCK_THREAD(pThread);
-                if (--pTask->ulRefCount)
-                {
-                    /* The task still has a reference, so mark it as completed
-                       and notify anyone waiting on it */
-                    pTask->EventSignal = TASK_COMPLETE_MASK;
-                    pthread_cond_broadcast(&pThread->Event);
-                    UNLOCK_THREAD(pThread);
-                }
-                else
-                {
-                    /* We held the last reference to the task, so delete it */
-                    RingRemove(&pTask->SignalRing);
-                    UNLOCK_THREAD(pThread);
-                    TaskDelete(pTask);
-                }
+    UNLOCK_POOL(pPool);
+
+    if (llBudget > 0)
+    {
+        MigrateQueue(pThread, pTarget, pWaiting, llNow, &llBudget, &ulMoved);
+
+        for (ulLevel = 0; ulLevel < TIMER_WHEEL_LEVELS; ulLevel++)
+        {
+            for (ulSlot = 0; ulSlot < TIMER_WHEEL_SLOTS; ulSlot++)
+            {
+                MigrateQueue(
+                    pThread,
+                    pTarget,
+                    &pThread->Timers.Slots[ulLevel][ulSlot],
+                    llNow,
+                    &llBudget,
+                    &ulMoved);
             }
         }
-    }
 
-error:
+        if (ulMoved)
+        {
+            LOCK_POOL(pPool);
+            pThread->ulLoad -= ulMoved;
+            pThread->ulMigratedOut += ulMoved;
+            pTarget->ulLoad += ulMoved;
+            pTarget->ulMigratedIn += ulMoved;
+            UNLOCK_POOL(pPool);
 
-    return status;
+            LW_RTL_LOG_DEBUG(
+                "Moved %lu tasks from event thread %lu (load %lu) to %lu (load %lu)",
+                (unsigned long) ulMoved,
+                (unsigned long) (pThread - pPool->pEventThreads),
+                (unsigned long) ulLoad,
+                (unsigned long) (pTarget - pPool->pEventThreads),
+                (unsigned long) pTarget->ulRecentLoad);
+        }
+    }
+
+    pThread->llIntervalStart = llNow;
+    pThread->llIntervalBusy = 0;
+    pThread->ulIntervalRuns = 0;
+    pThread->ulInterval++;
 }
 
 static
@@ -501,6 +1350,8 @@ VOID
 ScheduleSignalled(
     PEPOLL_THREAD pThread,
     PRING pRunnable,
+    PRING pWaiting,
+    LONG64 llNow,
     PBOOLEAN pbShutdown
     )
 {
@@ -521,6 +1372,16 @@ ScheduleSignalled(
         
         if (res == sizeof(c)) 
         {
+            /* Take over tasks migrated to us before looking at signals,
+               since a migrated task may also have been signalled */
+            while (!RingIsEmpty(&pThread->Migrated))
+            {
+                RingDequeue(&pThread->Migrated, &pRing);
+                pTask = LW_STRUCT_FROM_FIELD(pRing, EPOLL_TASK, QueueRing);
+
+                AdoptTask(pThread, pTask, pRunnable, pWaiting, llNow);
+            }
+
             /* Add all signalled tasks to the runnable list */
             for (pRing = pThread->Tasks.pNext; pRing != &pThread->Tasks; pRing = pNext)
             {
@@ -528,7 +1389,7 @@ ScheduleSignalled(
                 pTask = LW_STRUCT_FROM_FIELD(pRing, EPOLL_TASK, SignalRing);
 
                 RingRemove(&pTask->SignalRing);
-                RingRemove(&pTask->QueueRing);
+                DequeueTask(pTask);
 
                 if (pTask->EventSignal != TASK_COMPLETE_MASK)
                 {
@@ -557,7 +1418,6 @@ EventLoop(
     )
 {
     NTSTATUS status = STATUS_SUCCESS;
-    RING timed;
     RING runnable;
     RING waiting;
     CLOCK clock = {0};
@@ -569,7 +1429,6 @@ EventLoop(
     BOOLEAN bSignalled = FALSE;
 
     RingInit(&runnable);
-    RingInit(&timed);
     RingInit(&waiting);
 
     for (;;)
@@ -580,13 +1439,14 @@ EventLoop(
 
         /* Schedule any timed tasks that have reached their deadline */
         ScheduleTimedTasks(
-            &timed,
+            &pThread->Timers,
             llNow,
             &runnable);
 
         /* Schedule any waiting tasks that epoll indicated are ready
            and check if the thread received a signal */
         ScheduleWaitingTasks(
+            pThread,
             events,
             ready,
             llNow,
@@ -600,18 +1460,27 @@ EventLoop(
             ScheduleSignalled(
                 pThread,
                 &runnable,
+                &waiting,
+                llNow,
                 &bShutdown);
         }
 
         /* Process runnable tasks */
         status = ProcessRunnable(
             pThread,
+            &clock,
             &runnable,
-            &timed,
+            &pThread->Timers,
             &waiting,
             llNow);
         GOTO_ERROR_ON_STATUS(status);
 
+        if (llNow - pThread->llIntervalStart >= LOAD_INTERVAL)
+        {
+            /* Publish our load and shed tasks if we are overloaded */
+            BalanceLoad(pThread, &waiting, llNow);
+        }
+
         if (!RingIsEmpty(&runnable))
         {
             /* If there are still runnable tasks, set the next deadline
@@ -619,15 +1488,16 @@ EventLoop(
                do not block in Poll() */
             llNextDeadline = llNow;
         }
-        else if (!RingIsEmpty(&timed))
+        else if (!TimerWheelIsEmpty(&pThread->Timers))
         {
             /* There are timed tasks, so set our next deadline to the
-               deadline of the first task in the queue */
-            llNextDeadline = LW_STRUCT_FROM_FIELD(timed.pNext, EPOLL_TASK, QueueRing)->llDeadline;
+               next time the timer wheel needs to be serviced */
+            llNextDeadline = TimerWheelNextDeadline(&pThread->Timers);
         }
-        else if (!RingIsEmpty(&waiting) || !bShutdown)
+        else if (!RingIsEmpty(&waiting) || !bShutdown || ThreadPollsQueued(pThread))
         {
-            /* There are waiting tasks or we are not shutting down, so poll indefinitely */
+            /* There are waiting tasks or polls still to complete, or we are
+               not shutting down, so poll indefinitely */
             llNextDeadline = -1;
         }
         else
@@ -636,15 +1506,39 @@ EventLoop(
             break;
         }
 
+        if (pThread->ulRecentLoad != 0 &&
+            (llNextDeadline < 0 || llNextDeadline > pThread->llIntervalStart + LOAD_INTERVAL))
+        {
+            /* Wake up at the end of the interval so an idle thread
+               does not keep advertising its old load */
+            llNextDeadline = pThread->llIntervalStart + LOAD_INTERVAL;
+        }
+
         /* Wait (or check) for activity */
-        status = Poll(
-            &clock,
-            &llNow,
-            pThread->EpollFd,
-            events,
-            MAX_EVENTS,
-            llNextDeadline,
-            &ready);
+#ifdef LWBASE_THREADPOOL_URING
+        if (pThread->Uring.Fd >= 0)
+        {
+            status = PollRing(
+                pThread,
+                &clock,
+                &llNow,
+                events,
+                MAX_EVENTS,
+                llNextDeadline,
+                &ready);
+        }
+        else
+#endif
+        {
+            status = Poll(
+                &clock,
+                &llNow,
+                pThread->EpollFd,
+                events,
+                MAX_EVENTS,
+                llNextDeadline,
+                &ready);
+        }
         GOTO_ERROR_ON_STATUS(status);
     }
 
@@ -700,6 +1594,7 @@ LwRtlCreateTask(
     RingInit(&pTask->GroupRing);
     RingInit(&pTask->QueueRing);
     RingInit(&pTask->SignalRing);
+    pTask->lTimerLevel = -1;
 
     pTask->pGroup = pGroup;
     pTask->ulRefCount = 2;
@@ -807,17 +1702,18 @@ LwRtlReleaseTask(
     )
 {
     PLW_TASK pTask = *ppTask;
+    PEPOLL_THREAD pThread = NULL;
     int ulRefCount = 0;
 
     if (pTask)
     {
-        LOCK_THREAD(pTask->pThread);
+        pThread = LockTaskThread(pTask);
         ulRefCount = --pTask->ulRefCount;
         if (ulRefCount == 0)
         {
             RingRemove(&pTask->SignalRing);
         }
-        UNLOCK_THREAD(pTask->pThread);
+        UNLOCK_THREAD(pThread);
         
         if (ulRefCount == 0)
         {
@@ -833,11 +1729,13 @@ RetainTask(
     PLW_TASK pTask
     )
 {
+    PEPOLL_THREAD pThread = NULL;
+
     if (pTask)
     {
-        LOCK_THREAD(pTask->pThread);
+        pThread = LockTaskThread(pTask);
         ++pTask->ulRefCount;
-        UNLOCK_THREAD(pTask->pThread);
+        UNLOCK_THREAD(pThread);
     }
 }
 
@@ -890,6 +1788,14 @@ LwRtlSetTaskFd(
         {
             pTask->Fd = -1;
 
+#ifdef LWBASE_THREADPOOL_URING
+            if (pTask->pThread->Uring.Fd >= 0)
+            {
+                status = CancelTaskPoll(pTask->pThread, pTask);
+                GOTO_ERROR_ON_STATUS(status);
+            }
+            else
+#endif
             if (epoll_ctl(pTask->pThread->EpollFd, EPOLL_CTL_DEL, Fd, &event) < 0)
             {
                 ABORT_ON_FATAL_ERRNO(errno);
@@ -907,6 +1813,19 @@ LwRtlSetTaskFd(
             GOTO_ERROR_ON_STATUS(status);
         }
 
+#ifdef LWBASE_THREADPOOL_URING
+        if (pTask->pThread->Uring.Fd >= 0)
+        {
+            /* Nothing to register; a poll is queued when the task
+               waits on the fd.  Still reject invalid descriptors. */
+            if (fcntl(Fd, F_GETFD) < 0)
+            {
+                status = LwErrnoToNtStatus(errno);
+                GOTO_ERROR_ON_STATUS(status);
+            }
+        }
+        else
+#endif
         if (epoll_ctl(pTask->pThread->EpollFd, EPOLL_CTL_ADD, Fd, &event) < 0)
         {
             ABORT_ON_FATAL_ERRNO(errno);
@@ -959,17 +1878,17 @@ LwRtlWakeTask(
     PLW_TASK pTask
     )
 {
-    LOCK_THREAD(pTask->pThread);
+    PEPOLL_THREAD pThread = LockTaskThread(pTask);
 
     if (pTask->EventSignal != TASK_COMPLETE_MASK)
     {
         pTask->EventSignal |= LW_TASK_EVENT_EXPLICIT;
         RingRemove(&pTask->SignalRing);
-        RingEnqueue(&pTask->pThread->Tasks, &pTask->SignalRing);
-        SignalThread(pTask->pThread);
+        RingEnqueue(&pThread->Tasks, &pTask->SignalRing);
+        SignalThread(pThread);
     }
 
-    UNLOCK_THREAD(pTask->pThread);
+    UNLOCK_THREAD(pThread);
 }
 
 LW_NTSTATUS
@@ -1001,13 +1920,19 @@ NotifyTaskUnixSignal(
     siginfo_t* pInfo
     )
 {
-    LOCK_THREAD(pTask->pThread);
+    PEPOLL_THREAD pThread = LockTaskThread(pTask);
 
     if (pTask->EventSignal != TASK_COMPLETE_MASK)
     {
         while (pTask->pUnixSignal->si_signo)
         {
-            pthread_cond_wait(&pTask->pThread->Event, &pTask->pThread->Lock);
+            pthread_cond_wait(&pThread->Event, &pThread->Lock);
+            if (pThread != pTask->pThread)
+            {
+                /* The task moved to another thread while we waited */
+                UNLOCK_THREAD(pThread);
+                pThread = LockTaskThread(pTask);
+            }
             if (pTask->EventSignal == TASK_COMPLETE_MASK)
             {
                 goto cleanup;
@@ -1017,13 +1942,13 @@ NotifyTaskUnixSignal(
         *pTask->pUnixSignal = *pInfo;
         pTask->EventSignal |= LW_TASK_EVENT_UNIX_SIGNAL;
         RingRemove(&pTask->SignalRing);
-        RingEnqueue(&pTask->pThread->Tasks, &pTask->SignalRing);
-        SignalThread(pTask->pThread);
+        RingEnqueue(&pThread->Tasks, &pTask->SignalRing);
+        SignalThread(pThread);
     }
 
 cleanup:
 
-    UNLOCK_THREAD(pTask->pThread);
+    UNLOCK_THREAD(pThread);
 }
 
 LW_BOOLEAN
@@ -1033,8 +1958,7 @@ LwRtlNextTaskUnixSignal(
     )
 {
     BOOLEAN bResult = FALSE;
-
-    LOCK_THREAD(pTask->pThread);
+    PEPOLL_THREAD pThread = LockTaskThread(pTask);
 
     if (pTask->pUnixSignal == NULL || pTask->pUnixSignal->si_signo == 0)
     {
@@ -1047,11 +1971,11 @@ LwRtlNextTaskUnixSignal(
             *pInfo = *pTask->pUnixSignal;
         }
         pTask->pUnixSignal->si_signo = 0;
-        pthread_cond_broadcast(&pTask->pThread->Event);
+        pthread_cond_broadcast(&pThread->Event);
         bResult = TRUE;
     }
 
-    UNLOCK_THREAD(pTask->pThread);
+    UNLOCK_THREAD(pThread);
 
     return bResult;
 }
@@ -1061,17 +1985,17 @@ LwRtlCancelTask(
     PLW_TASK pTask
     )
 {
-    LOCK_THREAD(pTask->pThread);
+    PEPOLL_THREAD pThread = LockTaskThread(pTask);
 
     if (pTask->EventSignal != TASK_COMPLETE_MASK)
     {
         pTask->EventSignal |= LW_TASK_EVENT_EXPLICIT | LW_TASK_EVENT_CANCEL;
         RingRemove(&pTask->SignalRing);
-        RingEnqueue(&pTask->pThread->Tasks, &pTask->SignalRing);
-        SignalThread(pTask->pThread);
+        RingEnqueue(&pThread->Tasks, &pTask->SignalRing);
+        SignalThread(pThread);
     }
 
-    UNLOCK_THREAD(pTask->pThread);
+    UNLOCK_THREAD(pThread);
 }
 
 VOID
@@ -1079,14 +2003,20 @@ LwRtlWaitTask(
     PLW_TASK pTask
     )
 {
-    LOCK_THREAD(pTask->pThread);
+    PEPOLL_THREAD pThread = LockTaskThread(pTask);
 
     while (pTask->EventSignal != TASK_COMPLETE_MASK)
     {
-        pthread_cond_wait(&pTask->pThread->Event, &pTask->pThread->Lock);
+        pthread_cond_wait(&pThread->Event, &pThread->Lock);
+        if (pThread != pTask->pThread)
+        {
+            /* The task moved to another thread while we waited */
+            UNLOCK_THREAD(pThread);
+            pThread = LockTaskThread(pTask);
+        }
     }
 
-    UNLOCK_THREAD(pTask->pThread);
+    UNLOCK_THREAD(pThread);
 }
 
 VOID
@@ -1221,28 +2151,56 @@ InitEventThread(
     SetCloseOnExec(pThread->SignalFds[0]);
     SetCloseOnExec(pThread->SignalFds[1]);
 
-    if ((pThread->EpollFd = epoll_create(MAX_EVENTS)) < 0)
+#ifdef LWBASE_THREADPOOL_URING
+    pThread->EpollFd = -1;
+    pThread->Uring.Fd = -1;
+
+    if (!UringDisabled())
     {
-        status = LwErrnoToNtStatus(errno);
-        GOTO_ERROR_ON_STATUS(status);
+        /* Fall back to epoll if the kernel lacks io_uring or
+           it is forbidden to us */
+        if (NT_SUCCESS(UringInit(&pThread->Uring, URING_ENTRIES)))
+        {
+            SetCloseOnExec(pThread->Uring.Fd);
+
+            /* Queue poll of the signal fd */
+            status = UringPollAdd(&pThread->Uring, pThread->SignalFds[0], EPOLLIN, 0);
+            GOTO_ERROR_ON_STATUS(status);
+        }
+        else
+        {
+            LW_RTL_LOG_DEBUG("io_uring unavailable, falling back to epoll");
+        }
     }
 
-    SetCloseOnExec(pThread->EpollFd);
+    if (pThread->Uring.Fd < 0)
+#endif
+    {
+        if ((pThread->EpollFd = epoll_create(MAX_EVENTS)) < 0)
+        {
+            status = LwErrnoToNtStatus(errno);
+            GOTO_ERROR_ON_STATUS(status);
+        }
 
-    memset(&event, 0, sizeof(event));
+        SetCloseOnExec(pThread->EpollFd);
 
-    /* Add signal fd to epoll set */
-    event.events = EPOLLIN;
-    event.data.ptr = NULL;
-    
-    if (epoll_ctl(pThread->EpollFd, EPOLL_CTL_ADD, pThread->SignalFds[0], &event) < 0)
-    {
-        ABORT_ON_FATAL_ERRNO(errno);
-        status = LwErrnoToNtStatus(errno);
-        GOTO_ERROR_ON_STATUS(status);
+        memset(&event, 0, sizeof(event));
+
+        /* Add signal fd to epoll set */
+        event.events = EPOLLIN;
+        event.data.ptr = NULL;
+
+        if (epoll_ctl(pThread->EpollFd, EPOLL_CTL_ADD, pThread->SignalFds[0], &event) < 0)
+        {
+            ABORT_ON_FATAL_ERRNO(errno);
+            status = LwErrnoToNtStatus(errno);
+            GOTO_ERROR_ON_STATUS(status);
+        }
     }
 
     RingInit(&pThread->Tasks);
+    RingInit(&pThread->Migrated);
+    TimerWheelInit(&pThread->Timers);
 
     if (pAttrs && pAttrs->ulTaskThreadStackSize)
     {
@@ -1283,6 +2241,13 @@ DestroyEventThread(
         close(pThread->EpollFd);
     }
 
+#ifdef LWBASE_THREADPOOL_URING
+    if (pThread->Uring.pSqRing)
+    {
+        UringDestroy(&pThread->Uring);
+    }
+#endif
+
     if (pThread->SignalFds[0] >= 0)
     {
         close(pThread->SignalFds[0]);
@@ -1294,6 +2259,57 @@ DestroyEventThread(
     }
 }
 
+NTSTATUS
+LwRtlQueryTaskThreadStatistics(
+    PLW_THREAD_POOL pPool,
+    PULONG pulCount,
+    PLW_TASK_THREAD_STATISTICS* ppStats
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PLW_TASK_THREAD_STATISTICS pStats = NULL;
+    PEPOLL_THREAD pThread = NULL;
+    ULONG ulIndex = 0;
+
+    if (pPool->pDelegate)
+    {
+        return LwRtlQueryTaskThreadStatistics(pPool->pDelegate, pulCount, ppStats);
+    }
+
+    status = LW_RTL_ALLOCATE_ARRAY_AUTO(&pStats, pPool->ulEventThreadCount);
+    GOTO_ERROR_ON_STATUS(status);
+
+    LOCK_POOL(pPool);
+
+    for (ulIndex = 0; ulIndex < pPool->ulEventThreadCount; ulIndex++)
+    {
+        pThread = &pPool->pEventThreads[ulIndex];
+
+        pStats[ulIndex].ulTasks = pThread->ulLoad;
+        pStats[ulIndex].ulLoad = pThread->ulRecentLoad;
+        pStats[ulIndex].ullBusyTime = pThread->ullBusyTime;
+        pStats[ulIndex].ullRunCount = pThread->ullRunCount;
+        pStats[ulIndex].ulMigratedIn = pThread->ulMigratedIn;
+        pStats[ulIndex].ulMigratedOut = pThread->ulMigratedOut;
+    }
+
+    UNLOCK_POOL(pPool);
+
+    *pulCount = pPool->ulEventThreadCount;
+    *ppStats = pStats;
+
+cleanup:
+
+    return status;
+
+error:
+
+    *pulCount = 0;
+    *ppStats = NULL;
+
+    goto cleanup;
+}
+
 NTSTATUS
 LwRtlCreateThreadPool(
     PLW_THREAD_POOL* ppPool,
@@ -47,8 +47,32 @@
 
 #include "threadpool-common.h"
 
+#ifdef LWBASE_THREADPOOL_URING
+#include "threadpool-uring.h"
+#endif
+
 #define TASK_COMPLETE_MASK 0xFFFFFFFF
 
+/*
+ * Timer wheel geometry.  Four levels of 64 slots with 1ms ticks
+ * cover about 4.6 hours; later deadlines are parked in the last
+ * level and refiled when it cascades.
+ */
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_TICK 1000000ll
+
+typedef struct _TIMER_WHEEL
+{
+    /* Tick (monotonic time / TIMER_WHEEL_TICK) the wheel has reached */
+    LONG64 llTick;
+    /* Number of tasks filed at each level */
+    ULONG ulCount[TIMER_WHEEL_LEVELS];
+    RING Slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+} TIMER_WHEEL, *PTIMER_WHEEL;
+
 typedef struct _EPOLL_THREAD
 {
     PLW_THREAD_POOL pPool;
@@ -56,18 +80,44 @@ typedef struct _EPOLL_THREAD
     pthread_mutex_t Lock;
     pthread_cond_t Event;
     int SignalFds[2];
+    /* Event source, -1 when the thread uses io_uring */
     int EpollFd;
+#ifdef LWBASE_THREADPOOL_URING
+    /* io_uring event source, with Fd -1 when the thread uses epoll (owned by thread) */
+    URING Uring;
+    /* Number of task polls queued on the ring (owned by thread) */
+    ULONG ulPolls;
+#endif
     RING Tasks;
+    /* Tasks waiting for a deadline (owned by thread) */
+    TIMER_WHEEL Timers;
+    /* Tasks handed over by another thread, linked by
+       QueueRing (protected by thread lock) */
+    RING Migrated;
+    /* Start of the current load sampling interval, and time spent
+       in and number of task function calls during it (owned by thread) */
+    LONG64 llIntervalStart;
+    LONG64 llIntervalBusy;
+    ULONG ulIntervalRuns;
+    /* Sampling interval number, used to age task run times (owned by thread) */
+    ULONG ulInterval;
     /* Thread load (protected by thread pool lock) */
     ULONG volatile ulLoad;
+    /* Load statistics, updated at the end of each sampling
+       interval (protected by thread pool lock) */
+    ULONG volatile ulRecentLoad;
+    ULONG64 ullBusyTime;
+    ULONG64 ullRunCount;
+    ULONG ulMigratedIn;
+    ULONG ulMigratedOut;
     BOOLEAN volatile bSignalled;
     BOOLEAN volatile bShutdown;
 } EPOLL_THREAD, *PEPOLL_THREAD;
 
 typedef struct _LW_TASK
 {
-    /* Owning thread */
-    PEPOLL_THREAD pThread;
+    /* Owning thread (changes only with both the old and new thread locked) */
+    PEPOLL_THREAD volatile pThread;
     /* Owning group */
     PLW_TASK_GROUP pGroup;
     /* Ref count (protected by thread lock) */
@@ -83,11 +133,23 @@ typedef struct _LW_TASK
     LW_TASK_EVENT_MASK volatile EventSignal;
     /* Absolute time of next time wake event (owned by thread) */
     LONG64 llDeadline;
+    /* Timer wheel level the task is filed at, or -1 (owned by thread) */
+    LONG lTimerLevel;
+    /* Time spent in the task function during sampling interval
+       ulRunInterval of the owning thread (owned by thread) */
+    LONG64 llRunTime;
+    ULONG ulRunInterval;
     /* Callback function and context (immutable) */
     LW_TASK_FUNCTION pfnFunc;
     PVOID pFuncContext;
     /* File descriptor for fd-based events (owned by thread) */
     int Fd;
+#ifdef LWBASE_THREADPOOL_URING
+    /* Events of the poll queued on the thread's ring, or 0 (owned by thread) */
+    ULONG PollEvents;
+    /* The queued poll is being cancelled (owned by thread) */
+    BOOLEAN bPollCancel;
+#endif
     /* Pending UNIX signal (protected by thread lock) */
     siginfo_t* pUnixSignal;
     /* Link to siblings in task group (protected by group lock) */
@@ -1324,6 +1324,50 @@ DestroyEventThread(
     }
 }
 
+NTSTATUS
+LwRtlQueryTaskThreadStatistics(
+    PLW_THREAD_POOL pPool,
+    PULONG pulCount,
+    PLW_TASK_THREAD_STATISTICS* ppStats
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PLW_TASK_THREAD_STATISTICS pStats = NULL;
+    ULONG ulIndex = 0;
+
+    if (pPool->pDelegate)
+    {
+        return LwRtlQueryTaskThreadStatistics(pPool->pDelegate, pulCount, ppStats);
+    }
+
+    status = LW_RTL_ALLOCATE_ARRAY_AUTO(&pStats, pPool->ulEventThreadCount);
+    GOTO_ERROR_ON_STATUS(status);
+
+    /* This backend only tracks the number of tasks on each thread */
+    LOCK_POOL(pPool);
+
+    for (ulIndex = 0; ulIndex < pPool->ulEventThreadCount; ulIndex++)
+    {
+        pStats[ulIndex].ulTasks = pPool->pEventThreads[ulIndex].ulLoad;
+    }
+
+    UNLOCK_POOL(pPool);
+
+    *pulCount = pPool->ulEventThreadCount;
+    *ppStats = pStats;
+
+cleanup:
+
+    return status;
+
+error:
+
+    *pulCount = 0;
+    *ppStats = NULL;
+
+    goto cleanup;
+}
+
 NTSTATUS
 LwRtlCreateThreadPool(
     PLW_THREAD_POOL* ppPool,
@@ -1088,6 +1088,40 @@ error:
     return status;
 }
 
+NTSTATUS
+LwRtlQueryTaskThreadStatistics(
+    PLW_THREAD_POOL pPool,
+    PULONG pulCount,
+    PLW_TASK_THREAD_STATISTICS* ppStats
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PLW_TASK_THREAD_STATISTICS pStats = NULL;
+
+    if (pPool->pDelegate)
+    {
+        return LwRtlQueryTaskThreadStatistics(pPool->pDelegate, pulCount, ppStats);
+    }
+
+    /* This backend does not keep per-thread statistics */
+    status = LW_RTL_ALLOCATE_ARRAY_AUTO(&pStats, pPool->ulEventThreadCount);
+    GOTO_ERROR_ON_STATUS(status);
+
+    *pulCount = pPool->ulEventThreadCount;
+    *ppStats = pStats;
+
+cleanup:
+
+    return status;
+
+error:
+
+    *pulCount = 0;
+    *ppStats = NULL;
+
+    goto cleanup;
+}
+
 NTSTATUS
 LwRtlCreateThreadPool(
     PLW_THREAD_POOL* ppPool,
@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) Likewise Software.  All rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the license, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.  You should have received a copy
+ * of the GNU Lesser General Public License along with this program.  If
+ * not, see <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * LESSER GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISHTO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Module Name:
+ *
+ *        threadpool-uring.c
+ *
+ * Abstract:
+ *
+ *        Thread pool API (io_uring event source for the epoll backend)
+ *
+ *        A minimal io_uring wrapper using the raw system calls so
+ *        that no additional library is required.  Only the
+ *        operations the event loop needs are provided.
+ *
+ */
+
+#include "includes.h"
+#include "threadpool-uring.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static
+int
+SysUringSetup(
+    unsigned entries,
+    struct io_uring_params* pParams
+    )
+{
+    return (int) syscall(__NR_io_uring_setup, entries, pParams);
+}
+
+static
+int
+SysUringEnter(
+    int Fd,
+    unsigned toSubmit,
+    unsigned minComplete,
+    unsigned flags,
+    PVOID pArg,
+    size_t argSize
+    )
+{
+    return (int) syscall(__NR_io_uring_enter, Fd, toSubmit, minComplete, flags, pArg, argSize);
+}
+
+NTSTATUS
+UringInit(
+    PURING pRing,
+    ULONG ulEntries
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    struct io_uring_params params;
+    PBYTE pSq = NULL;
+    PBYTE pCq = NULL;
+
+    memset(pRing, 0, sizeof(*pRing));
+    memset(&params, 0, sizeof(params));
+
+    pRing->Fd = SysUringSetup(ulEntries, &params);
+    if (pRing->Fd < 0)
+    {
+        status = LwErrnoToNtStatus(errno);
+        GOTO_ERROR_ON_STATUS(status);
+    }
+
+    /* We rely on timed waits (5.11) and on the kernel never
+       dropping completions */
+    if (!(params.features & IORING_FEAT_EXT_ARG) ||
+        !(params.features & IORING_FEAT_NODROP))
+    {
+        status = STATUS_NOT_SUPPORTED;
+        GOTO_ERROR_ON_STATUS(status);
+    }
+
+    pRing->SqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    pRing->CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (pRing->CqRingSize > pRing->SqRingSize)
+        {
+            pRing->SqRingSize = pRing->CqRingSize;
+        }
+        pRing->CqRingSize = pRing->SqRingSize;
+    }
+
+    pRing->pSqRing = mmap(
+        NULL,
+        pRing->SqRingSize,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        pRing->Fd,
+        IORING_OFF_SQ_RING);
+    if (pRing->pSqRing == MAP_FAILED)
+    {
+        pRing->pSqRing = NULL;
+        status = LwErrnoToNtStatus(errno);
+        GOTO_ERROR_ON_STATUS(status);
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        pRing->pCqRing = pRing->pSqRing;
+    }
+    else
+    {
+        pRing->pCqRing = mmap(
+            NULL,
+            pRing->CqRingSize,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            pRing->Fd,
+            IORING_OFF_CQ_RING);
+        if (pRing->pCqRing == MAP_FAILED)
+        {
+            pRing->pCqRing = NULL;
+            status = LwErrnoToNtStatus(errno);
+            GOTO_ERROR_ON_STATUS(status);
+        }
+    }
+
+    pRing->SqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    pRing->pSqes = mmap(
+        NULL,
+        pRing->SqesSize,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        pRing->Fd,
+        IORING_OFF_SQES);
+    if (pRing->pSqes == MAP_FAILED)
+    {
+        pRing->pSqes = NULL;
+        status = LwErrnoToNtStatus(errno);
+        GOTO_ERROR_ON_STATUS(status);
+    }
+
+    pSq = pRing->pSqRing;
+    pRing->pSqHead = (unsigned*) (pSq + params.sq_off.head);
+    pRing->pSqTail = (unsigned*) (pSq + params.sq_off.tail);
+    pRing->pSqArray = (unsigned*) (pSq + params.sq_off.array);
+    pRing->SqMask = *(unsigned*) (pSq + params.sq_off.ring_mask);
+    pRing->SqEntries = params.sq_entries;
+    pRing->SqTail = *pRing->pSqTail;
+
+    pCq = pRing->pCqRing;
+    pRing->pCqHead = (unsigned*) (pCq + params.cq_off.head);
+    pRing->pCqTail = (unsigned*) (pCq + params.cq_off.tail);
+    pRing->CqMask = *(unsigned*) (pCq + params.cq_off.ring_mask);
+    pRing->pCqes = (struct io_uring_cqe*) (pCq + params.cq_off.cqes);
+
+error:
+
+    if (!NT_SUCCESS(status))
+    {
+        UringDestroy(pRing);
+    }
+
+    return status;
+}
+
+VOID
+UringDestroy(
+    PURING pRing
+    )
+{
+    if (pRing->pSqes)
+    {
+        munmap(pRing->pSqes, pRing->SqesSize);
+    }
+
+    if (pRing->pCqRing && pRing->pCqRing != pRing->pSqRing)
+    {
+        munmap(pRing->pCqRing, pRing->CqRingSize);
+    }
+
+    if (pRing->pSqRing)
+    {
+        munmap(pRing->pSqRing, pRing->SqRingSize);
+    }
+
+    if (pRing->Fd >= 0)
+    {
+        close(pRing->Fd);
+    }
+
+    memset(pRing, 0, sizeof(*pRing));
+    pRing->Fd = -1;
+}
+
+/*
+ * Publishes queued submissions to the kernel and, unless llTimeout
+ * is 0, waits up to llTimeout nanoseconds (forever if negative) for
+ * a completion.  Returns -1 and sets errno on failure like the
+ * system calls it replaces; timing out is not a failure.
+ */
+int
+UringEnter(
+    PURING pRing,
+    LONG64 llTimeout
+    )
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned toSubmit = 0;
+    unsigned minComplete = 0;
+    unsigned flags = 0;
+    int res = 0;
+
+    __atomic_store_n(pRing->pSqTail, pRing->SqTail, __ATOMIC_RELEASE);
+    toSubmit = pRing->SqTail - __atomic_load_n(pRing->pSqHead, __ATOMIC_ACQUIRE);
+
+    if (llTimeout != 0 && !UringPeekCompletion(pRing))
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+        minComplete = 1;
+
+        if (llTimeout > 0)
+        {
+            memset(&arg, 0, sizeof(arg));
+            ts.tv_sec = llTimeout / 1000000000ll;
+            ts.tv_nsec = llTimeout % 1000000000ll;
+            arg.ts = (ULONG64) (size_t) &ts;
+            flags |= IORING_ENTER_EXT_ARG;
+        }
+    }
+
+    if (!toSubmit && !flags)
+    {
+        return 0;
+    }
+
+    res = SysUringEnter(
+        pRing->Fd,
+        toSubmit,
+        minComplete,
+        flags,
+        (flags & IORING_ENTER_EXT_ARG) ? &arg : NULL,
+        (flags & IORING_ENTER_EXT_ARG) ? sizeof(arg) : 0);
+
+    if (res < 0 && (errno == ETIME || errno == EBUSY))
+    {
+        /* Timed out, or completions must be reaped before more
+           can be submitted */
+        res = 0;
+    }
+
+    return res < 0 ? -1 : 0;
+}
+
+static
+struct io_uring_sqe*
+UringGetSubmission(
+    PURING pRing
+    )
+{
+    struct io_uring_sqe* pSqe = NULL;
+    unsigned head = __atomic_load_n(pRing->pSqHead, __ATOMIC_ACQUIRE);
+
+    if (pRing->SqTail - head >= pRing->SqEntries)
+    {
+        /* Queue is full, so hand what we have to the kernel */
+        if (UringEnter(pRing, 0) < 0)
+        {
+            return NULL;
+        }
+
+        head = __atomic_load_n(pRing->pSqHead, __ATOMIC_ACQUIRE);
+        if (pRing->SqTail - head >= pRing->SqEntries)
+        {
+            errno = EBUSY;
+            return NULL;
+        }
+    }
+
+    pSqe = &pRing->pSqes[pRing->SqTail & pRing->SqMask];
+    memset(pSqe, 0, sizeof(*pSqe));
+
+    pRing->pSqArray[pRing->SqTail & pRing->SqMask] = pRing->SqTail & pRing->SqMask;
+    pRing->SqTail++;
+
+    return pSqe;
+}
+
+/*
+ * Queues a one-shot poll of Fd for Events (poll(2) bits).  Its
+ * completion carries Data and the events that occurred, or a
+ * negative errno.
+ */
+NTSTATUS
+UringPollAdd(
+    PURING pRing,
+    int Fd,
+    ULONG Events,
+    ULONG64 Data
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    struct io_uring_sqe* pSqe = NULL;
+
+    pSqe = UringGetSubmission(pRing);
+    if (!pSqe)
+    {
+        status = LwErrnoToNtStatus(errno);
+        GOTO_ERROR_ON_STATUS(status);
+    }
+
+#ifdef LW_BIG_ENDIAN
+    /* The kernel reads the mask as two swapped half words */
+    Events = (Events << 16) | (Events >> 16);
+#endif
+
+    pSqe->opcode = IORING_OP_POLL_ADD;
+    pSqe->fd = Fd;
+    pSqe->poll32_events = Events;
+    pSqe->user_data = Data;
+
+error:
+
+    return status;
+}
+
+/*
+ * Queues cancellation of the poll queued with Data.  The poll
+ * still produces a completion, with -ECANCELED unless it had
+ * already fired.
+ */
+NTSTATUS
+UringPollRemove(
+    PURING pRing,
+    ULONG64 Data
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    struct io_uring_sqe* pSqe = NULL;
+
+    pSqe = UringGetSubmission(pRing);
+    if (!pSqe)
+    {
+        status = LwErrnoToNtStatus(errno);
+        GOTO_ERROR_ON_STATUS(status);
+    }
+
+    pSqe->opcode = IORING_OP_POLL_REMOVE;
+    pSqe->fd = -1;
+    pSqe->addr = Data;
+    pSqe->user_data = URING_DATA_IGNORE;
+
+error:
+
+    return status;
+}
+
+struct io_uring_cqe*
+UringPeekCompletion(
+    PURING pRing
+    )
+{
+    unsigned head = *pRing->pCqHead;
+
+    if (head == __atomic_load_n(pRing->pCqTail, __ATOMIC_ACQUIRE))
+    {
+        return NULL;
+    }
+
+    return &pRing->pCqes[head & pRing->CqMask];
+}
+
+VOID
+UringAdvanceCompletion(
+    PURING pRing
+    )
+{
+    __atomic_store_n(pRing->pCqHead, *pRing->pCqHead + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) Likewise Software.  All rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the license, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.  You should have received a copy
+ * of the GNU Lesser General Public License along with this program.  If
+ * not, see <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * LESSER GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISHTO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Module Name:
+ *
+ *        threadpool-uring.h
+ *
+ * Abstract:
+ *
+ *        Thread pool API (io_uring event source for the epoll backend)
+ *
+ */
+
+#ifndef __LWBASE_THREADPOOL_URING_H__
+#define __LWBASE_THREADPOOL_URING_H__
+
+#include <lw/base.h>
+#include <linux/io_uring.h>
+
+/* Number of submission queue entries in each ring */
+#define URING_ENTRIES 256
+/* Completion data for requests whose completion is of no interest */
+#define URING_DATA_IGNORE ((ULONG64) -1)
+
+/*
+ * A single io_uring instance with its submission and completion
+ * queues mapped.  Rings are not thread-safe; each one is used only
+ * by the event thread that owns it.
+ */
+typedef struct _URING
+{
+    int Fd;
+    /* Submission queue */
+    unsigned* pSqHead;
+    unsigned* pSqTail;
+    unsigned* pSqArray;
+    unsigned SqMask;
+    unsigned SqEntries;
+    /* Local tail, published to the kernel on submission */
+    unsigned SqTail;
+    struct io_uring_sqe* pSqes;
+    /* Completion queue */
+    unsigned* pCqHead;
+    unsigned* pCqTail;
+    unsigned CqMask;
+    struct io_uring_cqe* pCqes;
+    /* Mappings */
+    PVOID pSqRing;
+    size_t SqRingSize;
+    PVOID pCqRing;
+    size_t CqRingSize;
+    size_t SqesSize;
+} URING, *PURING;
+
+NTSTATUS
+UringInit(
+    PURING pRing,
+    ULONG ulEntries
+    );
+
+VOID
+UringDestroy(
+    PURING pRing
+    );
+
+NTSTATUS
+UringPollAdd(
+    PURING pRing,
+    int Fd,
+    ULONG Events,
+    ULONG64 Data
+    );
+
+NTSTATUS
+UringPollRemove(
+    PURING pRing,
+    ULONG64 Data
+    );
+
+int
+UringEnter(
+    PURING pRing,
+    LONG64 llTimeout
+    );
+
+struct io_uring_cqe*
+UringPeekCompletion(
+    PURING pRing
+    );
+
+VOID
+UringAdvanceCompletion(
+    PURING pRing
+    );
+
+#endif
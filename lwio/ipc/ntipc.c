@@ -200,7 +200,7 @@ LWMsgTypeSpec gNtIpcTypeSpecMessageGenericFileBufferResult[] =
     LWMSG_STRUCT_BEGIN(NT_IPC_MESSAGE_GENERIC_FILE_BUFFER_RESULT),
     _LWMSG_MEMBER_NTSTATUS(NT_IPC_MESSAGE_GENERIC_FILE_BUFFER_RESULT, Status),
     LWMSG_MEMBER_UINT32(NT_IPC_MESSAGE_GENERIC_FILE_BUFFER_RESULT, BytesTransferred),
-    _LWMSG_MEMBER_BUFFER(NT_IPC_MESSAGE_GENERIC_FILE_BUFFER_RESULT, Buffer, BytesTransferred),
+    LWMSG_MEMBER_SHARED_BUFFER(NT_IPC_MESSAGE_GENERIC_FILE_BUFFER_RESULT, Buffer, BytesTransferred),
     LWMSG_STRUCT_END,
     LWMSG_TYPE_END
 };
@@ -257,7 +257,7 @@ LWMsgTypeSpec gNtIpcTypeSpecMessageWriteFile[] =
     LWMSG_STRUCT_BEGIN(NT_IPC_MESSAGE_WRITE_FILE),
     _LWMSG_MEMBER_IO_FILE_HANDLE_IN(NT_IPC_MESSAGE_WRITE_FILE, FileHandle),
     LWMSG_MEMBER_UINT32(NT_IPC_MESSAGE_WRITE_FILE, Length),
-    _LWMSG_MEMBER_BUFFER(NT_IPC_MESSAGE_WRITE_FILE, Buffer, Length),
+    LWMSG_MEMBER_SHARED_BUFFER(NT_IPC_MESSAGE_WRITE_FILE, Buffer, Length),
     LWMSG_MEMBER_POINTER(NT_IPC_MESSAGE_WRITE_FILE, ByteOffset, LWMSG_INT64(ULONG64)),
     LWMSG_MEMBER_POINTER(NT_IPC_MESSAGE_WRITE_FILE, Key, LWMSG_UINT32(ULONG)),
     LWMSG_STRUCT_END,
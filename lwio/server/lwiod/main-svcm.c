@@ -120,6 +120,9 @@ LwIoSvcmStart(
 {
     NTSTATUS ntStatus = STATUS_SUCCESS;
 
+    ntStatus = NtRegEnableValueCache();
+    BAIL_ON_NT_STATUS(ntStatus);
+
     ntStatus = LwioSrvInitializeConfig(&gLwioServerConfig);
     BAIL_ON_NT_STATUS(ntStatus);
 
@@ -737,6 +737,7 @@ LwioRemoteReadFile(
     BAIL_ON_NT_STATUS(status);
 
     *pdwBytesRead = (int) ioStatus.BytesTransferred;
+    gullLwioCopyBytesRead += ioStatus.BytesTransferred;
 
 cleanup:
 
@@ -774,6 +775,7 @@ LwioRemoteWriteFile(
     BAIL_ON_NT_STATUS(status);
 
     *pdwNumBytesWritten = (int) ioStatus.BytesTransferred;
+    gullLwioCopyBytesWritten += ioStatus.BytesTransferred;
 
 cleanup:
 
@@ -2,6 +2,8 @@
 #define __DEFS_H__
 
 #define BUFF_SIZE 1024
+/* Upper bound for -b, so a typo cannot exhaust memory */
+#define LWIO_COPY_MAX_BUFFER_SIZE (64 * 1024 * 1024)
 #define MAX_BUFFER 4096
 
 #define BAIL_ON_NULL_POINTER(p)                    \
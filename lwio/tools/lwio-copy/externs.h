@@ -2,5 +2,10 @@
 #define __EXTERNS_H__
 
 extern PSTR gpszLwioCopyKrb5CachePath;
+/* Size of each read or write issued through lwio */
+extern ULONG gulLwioCopyBufferSize;
+/* Data moved through lwio, reported by --stats */
+extern ULONG64 gullLwioCopyBytesRead;
+extern ULONG64 gullLwioCopyBytesWritten;
 
 #endif /* __EXTERNS_H__ */
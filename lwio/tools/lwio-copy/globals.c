@@ -1,3 +1,6 @@
 #include "includes.h"
 
 PSTR gpszLwioCopyKrb5CachePath = NULL;
+ULONG gulLwioCopyBufferSize = BUFF_SIZE;
+ULONG64 gullLwioCopyBytesRead = 0;
+ULONG64 gullLwioCopyBytesWritten = 0;
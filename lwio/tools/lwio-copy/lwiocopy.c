@@ -391,6 +391,7 @@ LwioCopyFileFromRemoteToRemote(
     NTSTATUS status = STATUS_SUCCESS;
     IO_FILE_HANDLE hRemSrcFile = NULL;
     IO_FILE_HANDLE hRemDstFile = NULL;
+    PBYTE pBuffer = NULL;
 
     BAIL_ON_NULL_POINTER(pszSourcePath);
     BAIL_ON_NULL_POINTER(pszTargetPath);
@@ -413,16 +414,18 @@ LwioCopyFileFromRemoteToRemote(
                     &hRemDstFile);
     BAIL_ON_NT_STATUS(status);
 
+    status = LwIoAllocateMemory(gulLwioCopyBufferSize, OUT_PPVOID(&pBuffer));
+    BAIL_ON_NT_STATUS(status);
+
     do
     {
-        BYTE  szBuff[BUFF_SIZE];
         DWORD dwRead = 0;
         DWORD dwWrote = 0;
 
         status = LwioRemoteReadFile(
                         hRemSrcFile,
-                        szBuff,
-                        sizeof(szBuff),
+                        pBuffer,
+                        gulLwioCopyBufferSize,
                         &dwRead);
         BAIL_ON_NT_STATUS(status);
 
@@ -433,7 +436,7 @@ LwioCopyFileFromRemoteToRemote(
 
         status  = LwioRemoteWriteFile(
                             hRemDstFile,
-                            szBuff,
+                            pBuffer,
                             dwRead,
                             &dwWrote);
 
@@ -454,6 +457,8 @@ cleanup:
         LwNtCloseFile(hRemDstFile);
     }
 
+    LWIO_SAFE_FREE_MEMORY(pBuffer);
+
     return (status);
 
 error:
@@ -471,6 +476,7 @@ LwioCopyFileFromRemote(
     NTSTATUS status = STATUS_SUCCESS;
     IO_FILE_HANDLE hRemoteFile = NULL;
     int hLocalFile = -1;
+    PBYTE pBuffer = NULL;
 
     BAIL_ON_NULL_POINTER(pszSourcePath);
     BAIL_ON_NULL_POINTER(pszTargetPath);
@@ -491,16 +497,18 @@ LwioCopyFileFromRemote(
                 &hLocalFile);
     BAIL_ON_NT_STATUS(status);
 
+    status = LwIoAllocateMemory(gulLwioCopyBufferSize, OUT_PPVOID(&pBuffer));
+    BAIL_ON_NT_STATUS(status);
+
     do
     {
-        BYTE  szBuff[BUFF_SIZE];
         DWORD dwRead = 0;
         DWORD dwWrote = 0;
 
         status = LwioRemoteReadFile(
                         hRemoteFile,
-                        szBuff,
-                        sizeof(szBuff),
+                        pBuffer,
+                        gulLwioCopyBufferSize,
                         &dwRead);
         BAIL_ON_NT_STATUS(status);
 
@@ -509,7 +517,7 @@ LwioCopyFileFromRemote(
             break;
         }
 
-        if ((dwWrote = write(hLocalFile, szBuff, dwRead)) == -1)
+        if ((dwWrote = write(hLocalFile, pBuffer, dwRead)) == -1)
         {
             status = LwErrnoToNtStatus(errno);
             BAIL_ON_NT_STATUS(status);
@@ -530,6 +538,8 @@ cleanup:
         close(hLocalFile);
     }
 
+    LWIO_SAFE_FREE_MEMORY(pBuffer);
+
     return (status);
 
 error:
@@ -811,7 +821,7 @@ LwioCopyFileToRemote(
     IO_FILE_HANDLE hRemoteFile = NULL;
     int hLocalFile = -1;
     DWORD dwBytesRead = 0;
-    CHAR szBuf[BUFF_SIZE];
+    PBYTE pBuffer = NULL;
 
     BAIL_ON_NULL_POINTER(pszSourcePath);
     BAIL_ON_NULL_POINTER(pszTargetPath);
@@ -833,13 +843,14 @@ LwioCopyFileToRemote(
                     &hRemoteFile);
     BAIL_ON_NT_STATUS(status);
 
+    status = LwIoAllocateMemory(gulLwioCopyBufferSize, OUT_PPVOID(&pBuffer));
+    BAIL_ON_NT_STATUS(status);
+
     do
     {
         DWORD dwWritten = 0;
 
-        memset (szBuf,0,BUFF_SIZE);
-
-        if ((dwBytesRead = read(hLocalFile, szBuf, sizeof(szBuf))) == -1)
+        if ((dwBytesRead = read(hLocalFile, pBuffer, gulLwioCopyBufferSize)) == -1)
         {
             status = LwErrnoToNtStatus(errno);
             BAIL_ON_NT_STATUS(status);
@@ -852,7 +863,7 @@ LwioCopyFileToRemote(
 
         status  = LwioRemoteWriteFile(
                             hRemoteFile,
-                            szBuf,
+                            pBuffer,
                             dwBytesRead,
                             &dwWritten);
 
@@ -872,6 +883,8 @@ cleanup:
         close(hLocalFile);
     }
 
+    LWIO_SAFE_FREE_MEMORY(pBuffer);
+
     return (status);
 
 error:
@@ -59,7 +59,9 @@ ParseArgs(
     PSTR*    ppszDomain,
     PSTR*    ppszPassword,
     PBOOLEAN pbCopyRecursive,
-    PBOOLEAN pbResolve
+    PBOOLEAN pbResolve,
+    PULONG   pulBufferSize,
+    PBOOLEAN pbStats
     );
 
 static
@@ -88,6 +90,13 @@ ShowUsage(
     VOID
     );
 
+static
+VOID
+PrintStats(
+    struct timespec* pStart,
+    struct timespec* pEnd
+    );
+
 static
 NTSTATUS
 GetKrb5PrincipalName(
@@ -131,6 +140,9 @@ main(
     BOOLEAN bDestroyKrb5Cache = FALSE;
     BOOLEAN bCopyRecursive = FALSE;
     BOOLEAN bResolve = FALSE;
+    BOOLEAN bStats = FALSE;
+    struct timespec start = {0};
+    struct timespec end = {0};
 
     if (atexit(LwIoExitHandler) < 0)
     {
@@ -148,7 +160,9 @@ main(
                 &pszDomain,
                 &pszPassword,
                 &bCopyRecursive,
-                &bResolve);
+                &bResolve,
+                &gulLwioCopyBufferSize,
+                &bStats);
     BAIL_ON_NT_STATUS(ntStatus);
 
     if (!IsNullOrEmptyString(pszPrincipal))
@@ -220,8 +234,17 @@ main(
     }
     else
     {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
         ntStatus = CopyFile(pszSourcePath, pszTargetPath, bCopyRecursive);
         BAIL_ON_NT_STATUS(ntStatus);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        if (bStats)
+        {
+            PrintStats(&start, &end);
+        }
     }
 
 cleanup:
@@ -269,7 +292,9 @@ ParseArgs(
     PSTR*    ppszDomain,
     PSTR*    ppszPassword,
     PBOOLEAN pbCopyRecursive,
-    PBOOLEAN pbResolve
+    PBOOLEAN pbResolve,
+    PULONG   pulBufferSize,
+    PBOOLEAN pbStats
     )
 {
     NTSTATUS ntStatus = STATUS_SUCCESS;
@@ -279,7 +304,8 @@ ParseArgs(
         PARSE_MODE_KRB5_CACHE_PATH,
         PARSE_MODE_UPN,
         PARSE_MODE_PASSWORD,
-        PARSE_MODE_DOMAIN
+        PARSE_MODE_DOMAIN,
+        PARSE_MODE_BUFFER_SIZE
     } ParseMode;
     typedef enum
     {
@@ -298,6 +324,8 @@ ParseArgs(
     LwioCopyKrb5Spec krb5Spec = LWIO_COPY_KRB5_NO_SPEC;
     BOOLEAN bCopyRecursive = FALSE;
     BOOLEAN bResolve = FALSE;
+    ULONG ulBufferSize = *pulBufferSize;
+    BOOLEAN bStats = FALSE;
 
     for (iArg = 1; iArg < argc; iArg++)
     {
@@ -320,6 +348,14 @@ ParseArgs(
                 {
                     bResolve = TRUE;
                 }
+                else if (!strcasecmp(pszArg, "-b"))
+                {
+                    parseMode = PARSE_MODE_BUFFER_SIZE;
+                }
+                else if (!strcasecmp(pszArg, "--stats"))
+                {
+                    bStats = TRUE;
+                }
                 else if (!strcasecmp(pszArg, "-k"))
                 {
                     parseMode = PARSE_MODE_KRB5_CACHE_PATH;
@@ -428,6 +464,25 @@ ParseArgs(
 
                 break;
 
+            case PARSE_MODE_BUFFER_SIZE:
+            {
+                PSTR pszEnd = NULL;
+                unsigned long ulValue = strtoul(pszArg, &pszEnd, 10);
+
+                if (!*pszArg || *pszEnd || ulValue == 0 || ulValue > LWIO_COPY_MAX_BUFFER_SIZE)
+                {
+                    fprintf(stderr, "Invalid buffer size '%s'\n", pszArg);
+                    ntStatus = STATUS_INVALID_PARAMETER;
+                    BAIL_ON_NT_STATUS(ntStatus);
+                }
+
+                ulBufferSize = (ULONG) ulValue;
+
+                parseMode = PARSE_MODE_OPEN;
+
+                break;
+            }
+
             default:
 
                 ShowUsage();
@@ -505,6 +560,8 @@ ParseArgs(
     *ppszPassword  = pszPassword;
     *pbCopyRecursive = bCopyRecursive;
     *pbResolve = bResolve;
+    *pulBufferSize = ulBufferSize;
+    *pbStats = bStats;
 
 cleanup:
 
@@ -809,9 +866,34 @@ ShowUsage(
     printf("\t-h Show help\n");
     // printf("\t-r Recurse when copying a directory\n");
     printf("\t-k kerberos cache path\n");
+    printf("\t-b bytes to transfer per read or write (default %d)\n", BUFF_SIZE);
+    printf("\t--stats Report the time taken and throughput when done\n");
     printf("Usage: lwio-copy //imgserver.abc.com/public/apple.jpg ./apple.jpg\n");
 }
 
+static
+VOID
+PrintStats(
+    struct timespec* pStart,
+    struct timespec* pEnd
+    )
+{
+    double dSeconds = (pEnd->tv_sec - pStart->tv_sec) +
+                      (pEnd->tv_nsec - pStart->tv_nsec) / 1000000000.0;
+    ULONG64 ullTotal = gullLwioCopyBytesRead + gullLwioCopyBytesWritten;
+
+    printf("Read %llu and wrote %llu bytes through lwio in %.3f seconds\n",
+           (unsigned long long) gullLwioCopyBytesRead,
+           (unsigned long long) gullLwioCopyBytesWritten,
+           dSeconds);
+
+    if (dSeconds > 0)
+    {
+        printf("Throughput: %.1f MB/s using %lu byte buffers\n",
+               ullTotal / dSeconds / (1024 * 1024),
+               (unsigned long) gulLwioCopyBufferSize);
+    }
+}
 
 static
 VOID
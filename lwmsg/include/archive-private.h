@@ -41,6 +41,7 @@
 #include <lwmsg/data.h>
 #include <lwmsg/archive.h>
 #include "assoc-private.h"
+#include "context-private.h"
 
 #include <inttypes.h>
 #include <sys/types.h>
@@ -63,8 +64,24 @@ struct LWMsgArchive
     uint8_t version_major;
     uint8_t version_minor;
     LWMsgDataContext* data_context;
+    /* Read-ahead for archives read through the file descriptor;
+       the unread bytes are read_buffer[read_cursor..read_end) */
+    unsigned char* read_buffer;
+    size_t read_cursor;
+    size_t read_end;
+    /* File contents when opened with LWMSG_ARCHIVE_MAP */
+    unsigned char* map;
+    size_t map_size;
+    /* Arena that messages read from a mapped archive live in */
+    LWMsgMemoryArena arena;
+    LWMsgDataContext* arena_context;
+    /* Most recently read message and the arena position before it */
+    void* last_data;
+    LWMsgArenaMark last_mark;
 };
 
+#define ARCHIVE_READ_BUFFER_SIZE (64 * 1024)
+
 #define ARCHIVE_VERSION_FLAG_BIG_ENDIAN 0x1
 #define ARCHIVE_VERSION_MAJOR 1
 #define ARCHIVE_VERSION_MINOR 1
@@ -118,6 +135,16 @@ lwmsg_archive_read_header_fd(
     LWMsgArchive* archive
     );
 
+LWMsgStatus
+lwmsg_archive_map_fd(
+    LWMsgArchive* archive
+    );
+
+void
+lwmsg_archive_unmap_fd(
+    LWMsgArchive* archive
+    );
+
 LWMsgStatus
 lwmsg_archive_read_message_fd(
     LWMsgArchive* archive,
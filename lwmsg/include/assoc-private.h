@@ -136,6 +136,23 @@ typedef struct LWMsgAssocClass
     LWMsgStatus (*reset)(LWMsgAssoc* assoc);
     LWMsgStatus (*finish)(LWMsgAssoc* assoc, LWMsgMessage** message);
     LWMsgStatus (*set_nonblock)(LWMsgAssoc* assoc, LWMsgBool nonblock);
+    /**
+     * @ingroup assoc_impl
+     * @brief Cork method
+     *
+     * While corked, an association may hold back messages it has
+     * accepted for sending so that several go out in one write.
+     * This method may be NULL if the association does not coalesce
+     * sends.  See #lwmsg_assoc_set_cork().
+     *
+     * @param[in] assoc the association
+     * @param[in] cork whether to cork or uncork
+     * @lwmsg_status
+     * @lwmsg_success
+     * @lwmsg_etc{implementation-specific failure}
+     * @lwmsg_endstatus
+     */
+    LWMsgStatus (*set_cork)(LWMsgAssoc* assoc, LWMsgBool cork);
 
     /**
      * @ingroup assoc_impl
@@ -240,6 +257,30 @@ lwmsg_assoc_new(
     LWMsgAssoc** assoc
     );
 
+/**
+ * @ingroup assoc_impl
+ * @brief Cork or uncork an association
+ *
+ * Messages sent with #lwmsg_assoc_send_message() while an association
+ * is corked report success once queued, and are transmitted together
+ * when it is uncorked.  A blocking association flushes them before
+ * uncorking returns.  A nonblocking association flushes them on
+ * subsequent calls to #lwmsg_assoc_finish(), which return success
+ * with no message once everything has been written.
+ *
+ * @param[in,out] assoc the association
+ * @param[in] cork whether to cork or uncork
+ * @lwmsg_status
+ * @lwmsg_success
+ * @lwmsg_etc{implementation-specific failure}
+ * @lwmsg_endstatus
+ */
+LWMsgStatus
+lwmsg_assoc_set_cork(
+    LWMsgAssoc* assoc,
+    LWMsgBool cork
+    );
+
 LWMsgStatus
 lwmsg_assoc_call_init(
     AssocCall* call
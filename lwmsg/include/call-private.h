@@ -92,6 +92,24 @@ typedef struct LWMsgCallClass
         LWMsgCompleteFunction complete,
         void* data
         );
+    /**
+     * @brief Dispatch several calls (virtual)
+     *
+     * Implements the exact semantics of #lwmsg_call_dispatch_batch()
+     * for a batch whose calls all share this vtable.
+     *
+     * This function may be NULL, in which case the calls are
+     * dispatched one at a time.
+     */
+    LWMsgStatus (*dispatch_batch)(
+        LWMsgCall** calls,
+        size_t count,
+        const LWMsgParams* in,
+        LWMsgParams* out,
+        LWMsgStatus* results,
+        LWMsgCompleteFunction complete,
+        void* data
+        );
     /**
      * @brief Mark call as pending (virtual)
      *
@@ -57,6 +57,22 @@
 
 #define CONNECTION_PRIVATE(assoc) ((ConnectionPrivate*) (assoc))
 
+/* Shared buffers at least this large are passed in a memfd
+   segment instead of being copied through the packet stream */
+#define CONNECTION_SHARED_BUFFER_THRESHOLD (64 * 1024)
+
+/* Largest shared buffer a receiver will map; bigger buffers
+   are sent inline */
+#define CONNECTION_SHARED_BUFFER_MAX (256 * 1024 * 1024)
+
+/* Most queued fragments gathered into a single sendmsg(), and
+   most fragments a corked connection holds back before flushing */
+#define CONNECTION_MAX_SEND_BATCH 64
+
+/* Size of the buffer incoming bytes are read ahead into, so that
+   several small packets sent together are received in one read */
+#define CONNECTION_RECV_AHEAD_SIZE (16 * 1024)
+
 typedef enum ConnectionState
 {
     /* No state */
@@ -122,9 +138,19 @@ typedef struct ConnectionBuffer
 {
     ConnectionFragment* current;
     LWMsgRing fragments;
+    size_t fragment_count;
     size_t fd_capacity;
     size_t fd_length;
     int* fd;
+    /* Fragments and fds queued by the message being sent, which sit
+       at the tail of the queue behind any earlier (corked) messages
+       (send side) */
+    size_t message_fragments;
+    size_t message_fds;
+    /* Bytes read ahead of the current fragment (receive side) */
+    unsigned char* ahead;
+    unsigned char* ahead_cursor;
+    unsigned char* ahead_end;
 } ConnectionBuffer;
 
 typedef enum ConnectionPacketType
@@ -180,6 +206,8 @@ typedef struct ConnectionPrivate
     LWMsgSession* active_session;
     /* Flag: this connection is nonblocking */
     unsigned is_nonblock:1;
+    /* Flag: complete messages are held back until uncorked */
+    unsigned is_corked:1;
     /* Marshal handle */
     LWMsgDataContext* marshal_context;
     /* Default session */
@@ -246,6 +274,11 @@ lwmsg_connection_buffer_empty(
     ConnectionBuffer* buffer
     );
 
+void
+lwmsg_connection_buffer_drop_message(
+    ConnectionBuffer* buffer
+    );
+
 LWMsgStatus
 lwmsg_connection_buffer_construct(
     ConnectionBuffer* buffer
@@ -64,6 +64,27 @@ typedef struct LWMsgMemoryList
     LWMsgRing blocks;
 } LWMsgMemoryList;
 
+/*
+ * A bump allocator for graphs that are freed all at once.  Freeing
+ * an individual object does nothing; memory is returned by
+ * rewinding to a mark or destroying the arena.
+ */
+typedef struct LWMsgMemoryArena
+{
+    LWMsgContext context;
+    LWMsgContext* parent_context;
+    /* Chunks in use, the last being the one allocated from */
+    LWMsgRing chunks;
+    /* Chunks released by a rewind, kept for reuse */
+    LWMsgRing spare;
+} LWMsgMemoryArena;
+
+typedef struct LWMsgArenaMark
+{
+    LWMsgRing* chunk;
+    size_t used;
+} LWMsgArenaMark;
+
 void
 lwmsg_context_setup(
     LWMsgContext* context,
@@ -140,6 +161,43 @@ lwmsg_memlist_context(
     return &list->context;
 }
 
+void
+lwmsg_arena_init(
+    LWMsgMemoryArena* arena,
+    LWMsgContext* context
+    );
+
+void
+lwmsg_arena_destroy(
+    LWMsgMemoryArena* arena
+    );
+
+void
+lwmsg_arena_mark(
+    LWMsgMemoryArena* arena,
+    LWMsgArenaMark* mark
+    );
+
+void
+lwmsg_arena_rewind(
+    LWMsgMemoryArena* arena,
+    const LWMsgArenaMark* mark
+    );
+
+void
+lwmsg_arena_reset(
+    LWMsgMemoryArena* arena
+    );
+
+static inline
+LWMsgContext*
+lwmsg_arena_context(
+    LWMsgMemoryArena* arena
+    )
+{
+    return &arena->context;
+}
+
 #define LWMSG_LOG(context, level, ...) \
     (lwmsg_context_log_printf((context), (level), __func__, __FILE__, __LINE__, __VA_ARGS__))
 
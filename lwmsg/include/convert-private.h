@@ -42,6 +42,7 @@
 #include <lwmsg/type.h>
 #include <lwmsg/status.h>
 #include <inttypes.h>
+#include <string.h>
 
 #ifdef WORDS_BIGENDIAN
 #    define LWMSG_NATIVE_ENDIAN LWMSG_BIG_ENDIAN
@@ -60,6 +61,76 @@ lwmsg_convert_integer(
     LWMsgSignage signage
     );
 
+/*
+ * Like lwmsg_convert_integer(), but handles the common case of
+ * integers of the same width without a function call or a
+ * byte-at-a-time copy.
+ */
+static inline
+LWMsgStatus
+lwmsg_convert_integer_inline(
+    void* in,
+    size_t in_size,
+    LWMsgByteOrder in_order,
+    void* out,
+    size_t out_size,
+    LWMsgByteOrder out_order,
+    LWMsgSignage signage
+    )
+{
+    uint16_t v16;
+    uint32_t v32;
+    uint64_t v64;
+
+    if (in_size == out_size)
+    {
+        switch (in_size)
+        {
+        case 1:
+            *(unsigned char*) out = *(unsigned char*) in;
+            return LWMSG_STATUS_SUCCESS;
+        case 2:
+            memcpy(&v16, in, sizeof(v16));
+            if (in_order != out_order)
+            {
+                v16 = (uint16_t) ((v16 << 8) | (v16 >> 8));
+            }
+            memcpy(out, &v16, sizeof(v16));
+            return LWMSG_STATUS_SUCCESS;
+        case 4:
+            memcpy(&v32, in, sizeof(v32));
+            if (in_order != out_order)
+            {
+                v32 = ((v32 & 0x000000FFu) << 24) |
+                      ((v32 & 0x0000FF00u) << 8) |
+                      ((v32 & 0x00FF0000u) >> 8) |
+                      ((v32 & 0xFF000000u) >> 24);
+            }
+            memcpy(out, &v32, sizeof(v32));
+            return LWMSG_STATUS_SUCCESS;
+        case 8:
+            memcpy(&v64, in, sizeof(v64));
+            if (in_order != out_order)
+            {
+                v64 = ((v64 & 0x00000000000000FFull) << 56) |
+                      ((v64 & 0x000000000000FF00ull) << 40) |
+                      ((v64 & 0x0000000000FF0000ull) << 24) |
+                      ((v64 & 0x00000000FF000000ull) << 8) |
+                      ((v64 & 0x000000FF00000000ull) >> 8) |
+                      ((v64 & 0x0000FF0000000000ull) >> 24) |
+                      ((v64 & 0x00FF000000000000ull) >> 40) |
+                      ((v64 & 0xFF00000000000000ull) >> 56);
+            }
+            memcpy(out, &v64, sizeof(v64));
+            return LWMSG_STATUS_SUCCESS;
+        default:
+            break;
+        }
+    }
+
+    return lwmsg_convert_integer(in, in_size, in_order, out, out_size, out_order, signage);
+}
+
 uint32_t
 lwmsg_convert_uint32(
     uint32_t in,
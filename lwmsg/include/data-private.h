@@ -61,10 +61,68 @@ typedef struct LWMsgObjectMap
     LWMsgHashTable hash_by_id;
 } LWMsgObjectMap;
 
+/* Kind of step in a compiled plan */
+typedef enum LWMsgDataPlanKind
+{
+    /* Integer without a verify function */
+    LWMSG_PLAN_INTEGER,
+    /* Inline array of single-byte integers, copied as-is */
+    LWMSG_PLAN_BYTES,
+    /* Structure with compiled members */
+    LWMSG_PLAN_STRUCT,
+    /* Unaliasable pointer to compiled elements */
+    LWMSG_PLAN_POINTER,
+    /* Inline array of static length with compiled elements */
+    LWMSG_PLAN_ARRAY,
+    /* Anything else, handed to the interpreter */
+    LWMSG_PLAN_INTERPRET
+} LWMsgDataPlanKind;
+
+/*
+ * A type spec flattened into a tree of steps with offsets, sizes
+ * and attributes decoded up front, so that marshalling does not
+ * need to walk the spec bytecode for every message.  Nested
+ * structures made only of integers are merged into their parent,
+ * and a structure whose members are all integers records its
+ * marshalled size so it can be converted in one pass.
+ */
+typedef struct LWMsgDataPlan
+{
+    LWMsgDataPlanKind kind;
+    /* Iterator the step was compiled from, for diagnostics and
+       for LWMSG_PLAN_INTERPRET */
+    LWMsgTypeIter iter;
+    /* Offset of object within the dominating object */
+    size_t offset;
+    /* Size of object in memory */
+    size_t size;
+    /* Marshalled width of integer or length of byte array */
+    size_t width;
+    LWMsgSignage sign;
+    /* Members of a structure */
+    size_t member_count;
+    struct LWMsgDataPlan* members;
+    /* Marshalled size of a structure of only integers, or 0 */
+    size_t flat_size;
+    /* Element of a pointer or array */
+    struct LWMsgDataPlan* element;
+    /* Elements are single bytes which can be copied directly */
+    LWMsgBool byte_copy;
+} LWMsgDataPlan;
+
+typedef struct LWMsgDataPlanEntry
+{
+    LWMsgTypeSpec* spec;
+    LWMsgDataPlan* plan;
+    LWMsgRing ring;
+} LWMsgDataPlanEntry;
+
 struct LWMsgDataContext
 {
     const LWMsgContext* context;
     LWMsgByteOrder byte_order;
+    /* Do not use compiled plans */
+    LWMsgBool plans_disabled;
 };
 
 typedef struct LWMsgMarshalState
@@ -187,6 +245,27 @@ lwmsg_data_free_graph_internal(
     unsigned char* object
     );
 
+/*
+ * Look up or compile the plan for the (promoted) type spec.
+ * Plans are cached for the life of the process, keyed by the
+ * spec pointer.  Sets *plan to NULL if plans are disabled or
+ * the plan could not be built, in which case the caller should
+ * interpret the spec as usual.
+ */
+void
+lwmsg_data_plan_find(
+    LWMsgDataContext* context,
+    LWMsgTypeSpec* spec,
+    LWMsgDataPlan** plan
+    );
+
+/* Enable or disable compiled plans (enabled by default) */
+void
+lwmsg_data_context_set_plans(
+    LWMsgDataContext* context,
+    LWMsgBool enable
+    );
+
 /**
  * @brief Print textual representation of a data graph
  *
@@ -86,7 +86,18 @@ typedef enum LWMsgArchiveDisposition
      * Use archive schema
      * @hideinitializer
      */
-    LWMSG_ARCHIVE_SCHEMA = 0x4
+    LWMSG_ARCHIVE_SCHEMA = 0x4,
+    /**
+     * Map the archive into memory when reading.  Messages are
+     * unmarshalled straight from the mapping into an arena owned by
+     * the archive rather than being allocated piece by piece.  They
+     * remain valid until the archive is reopened or deleted, and
+     * must not be freed by any other means than
+     * #lwmsg_archive_destroy_message().  Only valid together
+     * with #LWMSG_ARCHIVE_READ.
+     * @hideinitializer
+     */
+    LWMSG_ARCHIVE_MAP = 0x8
 } LWMsgArchiveDisposition;
 
 /**
@@ -270,7 +281,11 @@ lwmsg_archive_read_message(
  * @brief Destroy a message
  *
  * Frees all memory allocated for a message previously read
- * from the given archive.
+ * from the given archive.  For an archive opened with
+ * #LWMSG_ARCHIVE_MAP, destroying the most recently read message
+ * returns its memory to the arena for the next read; destroying
+ * any other message has no effect until the archive is reopened
+ * or deleted.
  *
  * @param[in] archive the archive handle
  * @param[in,out] message the message to destroy
@@ -183,6 +183,48 @@ lwmsg_call_dispatch(
     void* data
     );
 
+/**
+ * @brief Dispatch several calls at once
+ *
+ * Dispatches a batch of calls together.  The i-th call takes its input
+ * parameters from input[i] and places its output parameters in output[i].
+ * Where the transport allows it, the requests are transmitted together
+ * and the replies that are ready at the same time come back together,
+ * which removes most of the per-call overhead when making many small calls.
+ * Peer call handles in a batch must all belong to the same session.
+ *
+ * If complete is NULL, this function waits for every call in the batch
+ * to complete and stores the status each one completed with in results,
+ * which must have room for count entries.  Otherwise results is ignored,
+ * complete is invoked once for each call as it completes, and
+ * #LWMSG_STATUS_PENDING is returned.
+ *
+ * @param[in,out] calls the call handles
+ * @param[in] count the number of calls in the batch
+ * @param[in] input the input parameters of each call
+ * @param[out] output the output parameters of each call
+ * @param[out] results the status of each call, if complete is NULL
+ * @param[in] complete an optional completion callback
+ * @param[in] data a user data pointer to be passed to the completion callback
+ * @lwmsg_status
+ * @lwmsg_success
+ * @lwmsg_code{PENDING, the calls will be completed asynchronously by
+ * invoking the provided completion function}
+ * @lwmsg_code{INVALID_PARAMETER, the calls cannot be dispatched together}
+ * @lwmsg_etc{the batch could not be submitted; no call was dispatched}
+ * @lwmsg_endstatus
+ */
+LWMsgStatus
+lwmsg_call_dispatch_batch(
+    LWMsgCall** calls,
+    size_t count,
+    const LWMsgParams* input,
+    LWMsgParams* output,
+    LWMsgStatus* results,
+    LWMsgCompleteFunction complete,
+    void* data
+    );
+
 /**
  * @brief Mark call as pending
  *
@@ -198,6 +198,22 @@ lwmsg_connection_set_endpoint(
     const char* endpoint
     );
 
+/**
+ * @brief Get connection socket
+ *
+ * Gets the file descriptor of the socket underlying the connection,
+ * e.g. so a caller can poll an idle connection for a hangup before
+ * reusing it.  The descriptor remains owned by the connection and
+ * must not be read from, written to, or closed.
+ *
+ * @param[in] assoc the connection
+ * @return the file descriptor, or -1 if the connection has no socket
+ */
+int
+lwmsg_connection_get_fd(
+    LWMsgAssoc* assoc
+    );
+
 /**
  * @brief Retrieve information from a "local" security token
  *
@@ -243,6 +259,7 @@ lwmsg_local_token_get_pid(
 
 #ifndef DOXYGEN
 extern LWMsgTypeClass lwmsg_fd_type_class;
+extern LWMsgTypeClass lwmsg_shared_buffer_type_class;
 #endif
 
 /**
@@ -276,6 +293,34 @@ extern LWMsgTypeClass lwmsg_fd_type_class;
  */
 #define LWMSG_MEMBER_FD(type, field) LWMSG_MEMBER_CUSTOM(type, field, &lwmsg_fd_type_class, NULL)
 
+/**
+ * @brief Define a byte buffer which may be passed by shared memory
+ *
+ * Defines a pointer to a byte buffer as a member of a containing type,
+ * with its length given by another member.  The corresponding C type
+ * should be a pointer, and the length member a 32-bit unsigned integer.
+ *
+ * When sent over a connection on a platform which supports it, large
+ * buffers are written once into an anonymous shared memory segment
+ * which is passed to the peer as a file descriptor, bypassing the
+ * usual fragmentation and copying of message data.  The receiver maps
+ * the segment instead of copying it out again.  Smaller buffers, and
+ * buffers marshalled outside of a connection, are sent inline.  Either
+ * way the receiver may read and modify the buffer, but must leave it to
+ * be freed along with the rest of the message.
+ *
+ * Both peers must use this type for the field, as it changes the
+ * wire representation.
+ *
+ * @param type the containing type
+ * @param field the buffer field of the containing type
+ * @param length_field the length field of the containing type
+ * @hideinitializer
+ */
+#define LWMSG_MEMBER_SHARED_BUFFER(type, field, length_field)           \
+    LWMSG_MEMBER_CUSTOM(type, field, &lwmsg_shared_buffer_type_class,   \
+        offsetof(type, length_field) - offsetof(type, field))
+
 /* @} */
 
 #endif
@@ -95,6 +95,12 @@ typedef struct LWMsgDataContext LWMsgDataContext;
  * which return allocated memory (e.g. #lwmsg_data_unmarshal()) will use
  * the context's memory management functions.
  *
+ * The first time any data context marshals or unmarshals a given type,
+ * the type specification is compiled into a plan which is cached by
+ * address and shared by every data context in the process.  Type
+ * specifications must therefore remain valid for the life of the
+ * process, or until they are passed to #lwmsg_data_forget_type().
+ *
  * @param[in] context an optional context
  * @param[out] dcontext the created data context
  * @lwmsg_status
@@ -172,6 +178,22 @@ lwmsg_data_context_get_context(
     LWMsgDataContext* context
     );
 
+/**
+ * @brief Forget a type specification
+ *
+ * Drops the compiled plan cached for the specified type, if any.
+ * A type specification which is freed or unloaded before the process
+ * exits, such as one built at runtime or defined in a plugin, must be
+ * forgotten first so a later type at the same address does not reuse
+ * its plan.  No data context may be using the type at the time.
+ *
+ * @param[in] type the type specification
+ */
+void
+lwmsg_data_forget_type(
+    LWMsgTypeSpec* type
+    );
+
 /**
  * @brief Free in-memory data graph
  *
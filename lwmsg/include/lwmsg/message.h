@@ -76,6 +76,8 @@ typedef enum LWMsgMessageFlags
  *
  * A message with this tag is invalid and contains
  * no data.
+ * Tags below this value are reserved for messages
+ * built into lwmsg itself.
  * @hideinitializer
  */
 #define LWMSG_TAG_INVALID ((LWMsgTag) -1)
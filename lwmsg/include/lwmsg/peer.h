@@ -244,6 +244,123 @@ void
     void* data
     );
 
+/**
+ * @brief Number of latency histogram buckets
+ *
+ * The number of buckets in each latency histogram of #LWMsgPeerTagStats.
+ * Bucket 0 counts calls which took less than one microsecond; bucket
+ * <i>n</i> counts calls which took at least 2<sup>n-1</sup> but less
+ * than 2<sup>n</sup> microseconds.  The last bucket also counts all
+ * longer calls.
+ * @hideinitializer
+ */
+#define LWMSG_PEER_STATS_BUCKETS 28
+
+/**
+ * @brief Per-message statistics
+ *
+ * Statistics gathered by a peer for incoming calls
+ * with a particular message tag.  All times are in
+ * microseconds.
+ */
+typedef struct LWMsgPeerTagStats
+{
+    /** Message tag */
+    LWMsgTag tag;
+    /** Message name from the peer's protocol */
+    char* name;
+    /** Number of completed calls */
+    uint64_t calls;
+    /** Number of completed calls which did not succeed */
+    uint64_t failures;
+    /** Number of calls currently in progress */
+    uint32_t in_flight;
+    /** Sum of service times of completed calls */
+    uint64_t service_total;
+    /** Longest service time of any completed call */
+    uint64_t service_max;
+    /** Histogram of time spent waiting for a worker thread */
+    uint64_t queue_histogram[LWMSG_PEER_STATS_BUCKETS];
+    /** Histogram of time from start of dispatch to reply */
+    uint64_t service_histogram[LWMSG_PEER_STATS_BUCKETS];
+} LWMsgPeerTagStats;
+
+/**
+ * @brief Slow call sample
+ *
+ * Describes a recent incoming call which took longer than the
+ * threshold set with #lwmsg_peer_set_slow_call_threshold().
+ */
+typedef struct LWMsgPeerSlowCall
+{
+    /** Message tag */
+    LWMsgTag tag;
+    /** Completion status of call */
+    LWMsgStatus status;
+    /** Completion time in seconds since the epoch */
+    uint64_t time;
+    /** Time spent waiting for a worker thread, in microseconds */
+    uint64_t queue_time;
+    /** Time from start of dispatch to reply, in microseconds */
+    uint64_t service_time;
+} LWMsgPeerSlowCall;
+
+/**
+ * @brief Task thread statistics
+ *
+ * Load statistics for one event thread of the thread pool
+ * running the peer's tasks.  Thread pool implementations
+ * which do not track a statistic report it as 0.
+ */
+typedef struct LWMsgPeerThreadStats
+{
+    /** Number of tasks owned by the thread */
+    uint32_t tasks;
+    /** Time spent running tasks over the last sampling interval, in tenths of a percent */
+    uint32_t load;
+    /** Total time spent running tasks, in microseconds */
+    uint64_t busy_time;
+    /** Total number of task function invocations */
+    uint64_t runs;
+    /** Number of tasks moved to the thread to balance load */
+    uint32_t migrated_in;
+    /** Number of tasks moved away from the thread to balance load */
+    uint32_t migrated_out;
+} LWMsgPeerThreadStats;
+
+/**
+ * @brief Peer statistics
+ *
+ * A snapshot of the statistics a peer gathers about incoming
+ * calls.  Obtained locally with #lwmsg_peer_get_stats() or from
+ * a remote peer with #lwmsg_peer_query_stats().
+ */
+typedef struct LWMsgPeerStats
+{
+    /** Time since the peer was created, in seconds */
+    uint64_t uptime;
+    /** Number of connected clients */
+    uint32_t clients;
+    /** Number of incoming calls currently in progress */
+    uint32_t in_flight;
+    /** Number of incoming calls rejected before dispatch */
+    uint64_t rejected;
+    /** Slow call threshold, in microseconds */
+    uint64_t slow_threshold;
+    /** Number of entries in tags */
+    uint16_t tag_count;
+    /** Statistics for each message tag with a dispatch function */
+    LWMsgPeerTagStats* tags;
+    /** Number of entries in slow_calls */
+    uint16_t slow_call_count;
+    /** Most recent slow calls, oldest first */
+    LWMsgPeerSlowCall* slow_calls;
+    /** Number of entries in threads */
+    uint16_t thread_count;
+    /** Load of each task thread */
+    LWMsgPeerThreadStats* threads;
+} LWMsgPeerStats;
+
 /**
  * @brief Create a new peer object
  *
@@ -553,6 +670,89 @@ lwmsg_peer_set_trace_functions(
     void* data
     );
 
+/**
+ * @brief Set slow call threshold
+ *
+ * Sets the service time above which an incoming call is recorded as
+ * a slow call in the peer statistics and logged at the info level.
+ * The default is one second.
+ *
+ * @param[in,out] peer the peer handle
+ * @param[in] threshold the threshold
+ * @lwmsg_status
+ * @lwmsg_success
+ * @lwmsg_code{INVALID_PARAMETER, threshold was negative}
+ * @lwmsg_endstatus
+ */
+LWMsgStatus
+lwmsg_peer_set_slow_call_threshold(
+    LWMsgPeer* peer,
+    LWMsgTime* threshold
+    );
+
+/**
+ * @brief Get call statistics
+ *
+ * Takes a snapshot of the statistics the peer has gathered about
+ * incoming calls.  Statistics are always gathered; the cost is
+ * two clock reads and a short critical section per call.
+ * The snapshot should be freed with #lwmsg_peer_free_stats().
+ *
+ * @param[in] peer the peer handle
+ * @param[out] stats the statistics snapshot
+ * @lwmsg_status
+ * @lwmsg_success
+ * @lwmsg_memory
+ * @lwmsg_endstatus
+ */
+LWMsgStatus
+lwmsg_peer_get_stats(
+    LWMsgPeer* peer,
+    LWMsgPeerStats** stats
+    );
+
+/**
+ * @brief Query call statistics of a remote peer
+ *
+ * Asks the peer at the other end of an outgoing call handle for a
+ * snapshot of its call statistics.  Every listening peer answers
+ * this request regardless of its protocol or dispatch functions,
+ * but only for callers on a local connection running as root or as
+ * the same user as the remote peer.
+ * The call handle must have been acquired from a peer, and the
+ * snapshot should be freed with #lwmsg_peer_free_stats() on that peer.
+ *
+ * @param[in,out] call an outgoing call handle
+ * @param[out] stats the statistics snapshot
+ * @lwmsg_status
+ * @lwmsg_success
+ * @lwmsg_memory
+ * @lwmsg_code{SECURITY, the caller may not see the remote peer's statistics}
+ * @lwmsg_code{MALFORMED, the remote peer sent an unexpected reply}
+ * @lwmsg_etc{call failure}
+ * @lwmsg_endstatus
+ */
+LWMsgStatus
+lwmsg_peer_query_stats(
+    LWMsgCall* call,
+    LWMsgPeerStats** stats
+    );
+
+/**
+ * @brief Free call statistics
+ *
+ * Frees a snapshot returned by #lwmsg_peer_get_stats() or
+ * #lwmsg_peer_query_stats().
+ *
+ * @param[in] peer the peer handle
+ * @param[in,out] stats the statistics snapshot
+ */
+void
+lwmsg_peer_free_stats(
+    LWMsgPeer* peer,
+    LWMsgPeerStats* stats
+    );
+
 /**
  * @brief Add connection endpoint
  *
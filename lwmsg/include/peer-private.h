@@ -106,6 +106,9 @@ typedef struct PeerCall
             void* dispatch_data;
             LWMsgParams in;
             LWMsgParams out;
+            /* Monotonic times (usec) of receipt and start of dispatch */
+            uint64_t recv_time;
+            uint64_t start_time;
         } incoming;
         struct
         {
@@ -127,6 +130,17 @@ typedef struct PeerListenTask
     int fd;
 } PeerListenTask;
 
+/* Reserved tags of the built-in statistics introspection call */
+#define PEER_TAG_STATS_REQUEST ((LWMsgTag) -2)
+#define PEER_TAG_STATS_REPLY ((LWMsgTag) -3)
+
+/* Number of slow calls remembered for statistics */
+#define PEER_STATS_MAX_SLOW_CALLS 16
+
+/* Most messages a dispatch task receives in one run before
+   sending the replies that are ready */
+#define PEER_TASK_MAX_RECV_BATCH 32
+
 typedef struct PeerAssocTask
 {
     LWMsgTask* event_task;
@@ -145,6 +159,7 @@ typedef struct PeerAssocTask
     unsigned recv_blocked:1;
     unsigned recv_partial:1;
     unsigned destroy_outgoing:1;
+    unsigned unflushed:1;
     LWMsgCookie volatile next_cookie;
     uint32_t volatile refs;
     LWMsgStatus volatile status;
@@ -319,6 +334,23 @@ struct LWMsgPeer
     /* Total number of connected clients */
     size_t num_clients;
 
+    /* Incoming call statistics */
+    struct
+    {
+        pthread_mutex_t lock;
+        unsigned lock_init:1;
+        /* Indexed by tag, same length as dispatch vector */
+        LWMsgPeerTagStats* tags;
+        uint32_t in_flight;
+        uint64_t rejected;
+        uint64_t slow_threshold;
+        uint64_t start_time;
+        /* Ring of most recent slow calls */
+        LWMsgPeerSlowCall slow_calls[PEER_STATS_MAX_SLOW_CALLS];
+        size_t slow_next;
+        size_t slow_count;
+    } stats;
+
     pthread_mutex_t lock;
     unsigned lock_init:1;
     pthread_cond_t event;
@@ -551,4 +583,47 @@ lwmsg_peer_log_state(
     PeerAssocTask* task
     );
 
+LWMsgStatus
+lwmsg_peer_stats_init(
+    LWMsgPeer* peer
+    );
+
+void
+lwmsg_peer_stats_destroy(
+    LWMsgPeer* peer
+    );
+
+LWMsgStatus
+lwmsg_peer_stats_resize(
+    LWMsgPeer* peer,
+    size_t tag_count
+    );
+
+uint64_t
+lwmsg_peer_stats_clock(
+    void
+    );
+
+void
+lwmsg_peer_stats_begin_call(
+    LWMsgPeer* peer,
+    PeerCall* call
+    );
+
+void
+lwmsg_peer_stats_end_call(
+    LWMsgPeer* peer,
+    PeerCall* call
+    );
+
+void
+lwmsg_peer_stats_reject_call(
+    LWMsgPeer* peer
+    );
+
+LWMsgStatus
+lwmsg_peer_stats_dispatch(
+    PeerCall* call
+    );
+
 #endif
@@ -54,6 +54,11 @@ struct LWMsgProtocol
     /* Pointers to protocol spec entries indexed by message tag */
     LWMsgProtocolSpec** types;
     LWMsgMemoryList specmem;
+    /* Message types built from protocol reps, allocated in specmem */
+    size_t num_rep_types;
+    LWMsgTypeSpec** rep_types;
+    /* Built-in messages with reserved (negative) tags */
+    LWMsgProtocolSpec* system_spec;
 };
 
 typedef struct LWMsgProtocolMessageRep
@@ -107,6 +112,12 @@ lwmsg_protocol_print_alloc(
     char** text
     );
 
+void
+lwmsg_protocol_set_system_spec(
+    LWMsgProtocol* prot,
+    LWMsgProtocolSpec* spec
+    );
+
 extern LWMsgTypeSpec* lwmsg_protocol_rep_spec;
 
 #endif
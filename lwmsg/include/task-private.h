@@ -277,6 +277,37 @@ lwmsg_task_release_manager(
     LwRtlFreeThreadPool(&manager);
 }
 
+typedef LW_TASK_THREAD_STATISTICS LWMsgTaskThreadStats;
+
+static inline
+LWMsgStatus
+lwmsg_task_query_thread_stats(
+    LWMsgTaskManager* manager,
+    unsigned long* count,
+    LWMsgTaskThreadStats** stats
+    )
+{
+    LW_ULONG ulCount = 0;
+    LWMsgStatus status = __MAP_NTSTATUS(
+        LwRtlQueryTaskThreadStatistics(
+            manager,
+            &ulCount,
+            stats));
+
+    *count = ulCount;
+
+    return status;
+}
+
+static inline
+void
+lwmsg_task_free_thread_stats(
+    LWMsgTaskThreadStats* stats
+    )
+{
+    LwRtlFreeTaskThreadStatistics(&stats);
+}
+
 /*@}*/
 
 #endif
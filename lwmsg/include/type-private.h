@@ -436,6 +436,11 @@ lwmsg_type_spec_from_rep_internal(
     LWMsgTypeSpecBuffer** buffer
     );
 
+/*
+ * The spec is allocated with the given context.  If it was used to
+ * marshal or unmarshal, pass it to lwmsg_data_forget_type() before
+ * freeing it.
+ */
 LWMsgStatus
 lwmsg_type_spec_from_rep(
     const LWMsgContext* context,
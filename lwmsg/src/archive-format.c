@@ -46,6 +46,8 @@
 
 #include <errno.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 static
@@ -98,13 +100,62 @@ lwmsg_archive_read_fd(
     ssize_t count = 0;
     size_t total = 0;
 
+    if (archive->map)
+    {
+        /* Mapped archives are read straight from memory */
+        if ((size_t) archive->offset >= archive->map_size)
+        {
+            BAIL_ON_ERROR(status = LWMSG_STATUS_EOF);
+        }
+
+        if (remaining > archive->map_size - archive->offset)
+        {
+            remaining = archive->map_size - archive->offset;
+        }
+
+        memcpy(buffer, archive->map + archive->offset, remaining);
+        archive->offset += remaining;
+        total = remaining;
+        remaining = 0;
+    }
+
     while (remaining)
     {
-        do
+        if (archive->read_cursor < archive->read_end)
         {
-            count = read(archive->fd, cursor, remaining);
-        } while (count < 0 && (errno == EINTR || errno == EAGAIN));
-        
+            /* Serve what we can from the read-ahead buffer */
+            count = archive->read_end - archive->read_cursor;
+            if ((size_t) count > remaining)
+            {
+                count = remaining;
+            }
+
+            memcpy(cursor, archive->read_buffer + archive->read_cursor, count);
+            archive->read_cursor += count;
+        }
+        else if (archive->read_buffer && remaining < ARCHIVE_READ_BUFFER_SIZE)
+        {
+            /* Refill the read-ahead buffer rather than making a small read */
+            do
+            {
+                count = read(archive->fd, archive->read_buffer, ARCHIVE_READ_BUFFER_SIZE);
+            } while (count < 0 && (errno == EINTR || errno == EAGAIN));
+
+            if (count > 0)
+            {
+                archive->read_cursor = 0;
+                archive->read_end = count;
+                continue;
+            }
+        }
+        else
+        {
+            do
+            {
+                count = read(archive->fd, cursor, remaining);
+            } while (count < 0 && (errno == EINTR || errno == EAGAIN));
+        }
+
         if (count < 0)
         {
             BAIL_ON_ERROR(status = RAISE_ERRNO(&archive->base.context));
@@ -152,6 +203,7 @@ lwmsg_archive_seek_fd(
     }
 
     archive->offset = new_position;
+    archive->read_cursor = archive->read_end = 0;
 
 error:
 
@@ -326,8 +378,11 @@ lwmsg_archive_write_message_fd(
     /* Leave room to write the header in later */
     BAIL_ON_ERROR(status = lwmsg_archive_seek_fd(archive, header_offset + sizeof(header)));
 
-    /* Write the marshaled data payload */
-    BAIL_ON_ERROR(status = lwmsg_data_marshal(archive->data_context, type, message->data, &buffer));
+    /* Write the marshaled data payload, if the message has one */
+    if (type != NULL)
+    {
+        BAIL_ON_ERROR(status = lwmsg_data_marshal(archive->data_context, type, message->data, &buffer));
+    }
 
     end_offset = archive->offset;
     
@@ -509,6 +564,7 @@ lwmsg_archive_read_header_fd(
     }
 
     lwmsg_data_context_set_byte_order(archive->data_context, archive->byte_order);
+    lwmsg_data_context_set_byte_order(archive->arena_context, archive->byte_order);
 
     BAIL_ON_ERROR(status = lwmsg_archive_read_schema_fd(archive, &header));
 
@@ -567,6 +623,108 @@ error:
     return status;
 }
 
+LWMsgStatus
+lwmsg_archive_map_fd(
+    LWMsgArchive* archive
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    struct stat statbuf;
+    void* map = NULL;
+
+    if (fstat(archive->fd, &statbuf) < 0)
+    {
+        BAIL_ON_ERROR(status = RAISE_ERRNO(&archive->base.context));
+    }
+
+    /* The header has been read, so the file is not empty */
+    map = mmap(NULL, (size_t) statbuf.st_size, PROT_READ, MAP_PRIVATE, archive->fd, 0);
+    if (map == MAP_FAILED)
+    {
+        BAIL_ON_ERROR(status = RAISE_ERRNO(&archive->base.context));
+    }
+
+    archive->map = map;
+    archive->map_size = (size_t) statbuf.st_size;
+
+error:
+
+    return status;
+}
+
+void
+lwmsg_archive_unmap_fd(
+    LWMsgArchive* archive
+    )
+{
+    if (archive->map)
+    {
+        munmap(archive->map, archive->map_size);
+        archive->map = NULL;
+        archive->map_size = 0;
+    }
+}
+
+/*
+ * Unmarshals a message payload in place from the mapped file.
+ * Everything it allocates comes from the archive arena, so a
+ * failure only needs to rewind the arena.
+ */
+static
+LWMsgStatus
+lwmsg_archive_read_message_map(
+    LWMsgArchive* archive,
+    LWMsgTypeSpec* type,
+    size_t message_size,
+    LWMsgMessage* message
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgBuffer buffer = {0};
+    LWMsgArenaMark mark;
+
+    lwmsg_arena_mark(&archive->arena, &mark);
+
+    if (message_size > archive->map_size - archive->offset)
+    {
+        /* The file ends in the middle of the message */
+        BAIL_ON_ERROR(status = LWMSG_STATUS_MALFORMED);
+    }
+
+    buffer.base = archive->map + archive->offset;
+    buffer.end = buffer.base + message_size;
+    buffer.cursor = buffer.base;
+
+    status = lwmsg_data_unmarshal(archive->arena_context, type, &buffer, &message->data);
+    if (status == LWMSG_STATUS_EOF)
+    {
+        /* The message was longer than the length specified in the header */
+        status = LWMSG_STATUS_MALFORMED;
+    }
+    BAIL_ON_ERROR(status);
+
+    if (buffer.cursor != buffer.end)
+    {
+        /* The message was shorter than the length specified in the header */
+        BAIL_ON_ERROR(status = LWMSG_STATUS_MALFORMED);
+    }
+
+    archive->offset += message_size;
+    archive->last_data = message->data;
+    archive->last_mark = mark;
+
+done:
+
+    return status;
+
+error:
+
+    message->data = NULL;
+    lwmsg_arena_rewind(&archive->arena, &mark);
+
+    goto done;
+}
+
 LWMsgStatus
 lwmsg_archive_read_message_fd(
     LWMsgArchive* archive,
@@ -581,17 +739,34 @@ lwmsg_archive_read_message_fd(
 
     BAIL_ON_ERROR(status = lwmsg_archive_read_message_header(archive, message, &message_size));
     BAIL_ON_ERROR(status = lwmsg_protocol_get_message_type(archive->base.prot, message->tag, &type));
-    
-    info.archive = archive;
-    info.remaining = message_size;
-    buffer.base = info.data;
-    buffer.end = buffer.base;
-    buffer.cursor = buffer.base;
-    buffer.wrap = lwmsg_archive_read_message_wrap_fd;
-    buffer.data = &info;
 
-    /* Unmarshal the message payload */
-    BAIL_ON_ERROR(status = lwmsg_data_unmarshal(archive->data_context, type, &buffer, &message->data));
+    if (type == NULL)
+    {
+        /* A message without a payload has nothing after its header */
+        if (message_size != 0)
+        {
+            BAIL_ON_ERROR(status = LWMSG_STATUS_MALFORMED);
+        }
+
+        message->data = NULL;
+    }
+    else if (archive->map)
+    {
+        BAIL_ON_ERROR(status = lwmsg_archive_read_message_map(archive, type, message_size, message));
+    }
+    else
+    {
+        info.archive = archive;
+        info.remaining = message_size;
+        buffer.base = info.data;
+        buffer.end = buffer.base;
+        buffer.cursor = buffer.base;
+        buffer.wrap = lwmsg_archive_read_message_wrap_fd;
+        buffer.data = &info;
+
+        /* Unmarshal the message payload */
+        BAIL_ON_ERROR(status = lwmsg_data_unmarshal(archive->data_context, type, &buffer, &message->data));
+    }
 
 error:
 
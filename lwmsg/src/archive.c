@@ -59,7 +59,12 @@ lwmsg_archive_construct(
     archive->disp = 0;
     archive->byte_order = LWMSG_BIG_ENDIAN;
 
+    lwmsg_arena_init(&archive->arena, &assoc->context);
+
     BAIL_ON_ERROR(status = lwmsg_data_context_new(&assoc->context, &archive->data_context));
+    BAIL_ON_ERROR(status = lwmsg_data_context_new(
+                      lwmsg_arena_context(&archive->arena),
+                      &archive->arena_context));
 
 error:
 
@@ -73,6 +78,8 @@ lwmsg_archive_destruct(
 {
     LWMsgArchive* archive = ARCHIVE_PRIVATE(assoc);
 
+    lwmsg_archive_unmap_fd(archive);
+
     if (archive->fd != -1)
     {
         close(archive->fd);
@@ -83,10 +90,22 @@ lwmsg_archive_destruct(
         free(archive->file);
     }
 
+    if (archive->read_buffer)
+    {
+        free(archive->read_buffer);
+    }
+
     if (archive->data_context)
     {
         lwmsg_data_context_delete(archive->data_context);
     }
+
+    if (archive->arena_context)
+    {
+        lwmsg_data_context_delete(archive->arena_context);
+    }
+
+    lwmsg_arena_destroy(&archive->arena);
 }
 
 
@@ -417,14 +436,38 @@ lwmsg_archive_open(
     }
 
     archive->disp = disp;
+
+    archive->offset = 0;
+    archive->read_cursor = archive->read_end = 0;
+
+    /* Messages from a previous open are no longer valid */
+    lwmsg_arena_reset(&archive->arena);
+    archive->last_data = NULL;
  
     switch (archive->disp & (LWMSG_ARCHIVE_READ | LWMSG_ARCHIVE_WRITE))
     {
     case LWMSG_ARCHIVE_READ:
+        if (!archive->read_buffer && !(archive->disp & LWMSG_ARCHIVE_MAP))
+        {
+            archive->read_buffer = malloc(ARCHIVE_READ_BUFFER_SIZE);
+            if (!archive->read_buffer)
+            {
+                BAIL_ON_ERROR(status = LWMSG_STATUS_MEMORY);
+            }
+        }
         BAIL_ON_ERROR(status = lwmsg_archive_open_fd(archive));
         BAIL_ON_ERROR(status = lwmsg_archive_read_header_fd(archive));
+        if (archive->disp & LWMSG_ARCHIVE_MAP)
+        {
+            BAIL_ON_ERROR(status = lwmsg_archive_map_fd(archive));
+        }
         break;
     case LWMSG_ARCHIVE_WRITE:
+        if (archive->disp & LWMSG_ARCHIVE_MAP)
+        {
+            ARCHIVE_RAISE_ERROR(archive, status = LWMSG_STATUS_INVALID_PARAMETER,
+                                "Only archives opened for reading can be mapped");
+        }
         BAIL_ON_ERROR(status = lwmsg_archive_open_fd(archive));
         BAIL_ON_ERROR(status = lwmsg_archive_write_header_fd(archive));
         break;
@@ -444,6 +487,8 @@ lwmsg_archive_close(
 {
     LWMsgStatus status = LWMSG_STATUS_SUCCESS;
 
+    lwmsg_archive_unmap_fd(archive);
+
     if (archive->fd != -1)
     {
         close(archive->fd);
@@ -504,7 +549,19 @@ lwmsg_archive_destroy_message(
     LWMsgStatus status = LWMSG_STATUS_SUCCESS;
     LWMsgTypeSpec* type = NULL;
 
-    if (message->tag >= 0)
+    if (message->tag >= 0 && (archive->disp & LWMSG_ARCHIVE_MAP))
+    {
+        /* Arena memory can only be handed back in order */
+        if (message->data && message->data == archive->last_data)
+        {
+            lwmsg_arena_rewind(&archive->arena, &archive->last_mark);
+            archive->last_data = NULL;
+        }
+
+        message->tag = -1;
+        message->data = NULL;
+    }
+    else if (message->tag >= 0)
     {
         BAIL_ON_ERROR(status = lwmsg_protocol_get_message_type(archive->base.prot, message->tag, &type));
 
@@ -336,6 +336,20 @@ lwmsg_assoc_set_nonblock(
     return assoc->aclass->set_nonblock(assoc, nonblock);
 }
 
+LWMsgStatus
+lwmsg_assoc_set_cork(
+    LWMsgAssoc* assoc,
+    LWMsgBool cork
+    )
+{
+    if (!assoc->aclass->set_cork)
+    {
+        return LWMSG_STATUS_SUCCESS;
+    }
+
+    return assoc->aclass->set_cork(assoc, cork);
+}
+
 static
 LWMsgStatus
 realloc_wrap(
@@ -52,6 +52,55 @@ lwmsg_call_dispatch(
     return call->vtbl->dispatch(call, in, out, complete, data);
 }
 
+LWMsgStatus
+lwmsg_call_dispatch_batch(
+    LWMsgCall** calls,
+    size_t count,
+    const LWMsgParams* in,
+    LWMsgParams* out,
+    LWMsgStatus* results,
+    LWMsgCompleteFunction complete,
+    void* data
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    size_t i = 0;
+
+    if (count == 0)
+    {
+        return complete ? LWMSG_STATUS_PENDING : LWMSG_STATUS_SUCCESS;
+    }
+
+    for (i = 1; i < count; i++)
+    {
+        if (calls[i]->vtbl != calls[0]->vtbl)
+        {
+            return LWMSG_STATUS_INVALID_PARAMETER;
+        }
+    }
+
+    if (calls[0]->vtbl->dispatch_batch)
+    {
+        return calls[0]->vtbl->dispatch_batch(calls, count, in, out, results, complete, data);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        status = calls[i]->vtbl->dispatch(calls[i], &in[i], &out[i], complete, data);
+
+        if (!complete)
+        {
+            results[i] = status;
+        }
+        else if (status != LWMSG_STATUS_PENDING)
+        {
+            complete(calls[i], status, data);
+        }
+    }
+
+    return complete ? LWMSG_STATUS_PENDING : LWMSG_STATUS_SUCCESS;
+}
+
 void
 lwmsg_call_pend(
     LWMsgCall* call,
@@ -93,6 +93,11 @@ lwmsg_connection_buffer_empty(ConnectionBuffer* buffer)
         free(LWMSG_OBJECT_FROM_MEMBER(ring, ConnectionFragment, ring));
     }
 
+    buffer->fragment_count = 0;
+    buffer->fd_length = 0;
+    buffer->message_fragments = 0;
+    buffer->message_fds = 0;
+
     if (buffer->current)
     {
         free(buffer->current);
@@ -100,6 +105,52 @@ lwmsg_connection_buffer_empty(ConnectionBuffer* buffer)
     }
 }
 
+/*
+ * Removes what the message being sent has queued so far, leaving any
+ * earlier messages intact.  A fragment that has partly gone out
+ * already has to stay so that the packet framing on the wire holds.
+ */
+void
+lwmsg_connection_buffer_drop_message(ConnectionBuffer* buffer)
+{
+    ConnectionFragment* fragment = NULL;
+    size_t count = buffer->message_fragments;
+
+    if (count > buffer->fragment_count)
+    {
+        count = buffer->fragment_count;
+    }
+
+    for (; count; count--)
+    {
+        fragment = LWMSG_OBJECT_FROM_MEMBER(buffer->fragments.prev, ConnectionFragment, ring);
+
+        if (fragment->cursor != fragment->data)
+        {
+            break;
+        }
+
+        lwmsg_ring_remove(&fragment->ring);
+        buffer->fragment_count--;
+        free(fragment);
+    }
+
+    count = buffer->message_fds;
+
+    if (count > buffer->fd_length)
+    {
+        count = buffer->fd_length;
+    }
+
+    for (; count; count--)
+    {
+        close(buffer->fd[--buffer->fd_length]);
+        buffer->fd[buffer->fd_length] = -1;
+    }
+
+    buffer->message_fragments = 0;
+    buffer->message_fds = 0;
+}
 
 void
 lwmsg_connection_buffer_destruct(ConnectionBuffer* buffer)
@@ -111,6 +162,11 @@ lwmsg_connection_buffer_destruct(ConnectionBuffer* buffer)
         free(buffer->fd);
     }
 
+    if (buffer->ahead)
+    {
+        free(buffer->ahead);
+    }
+
     memset(buffer, 0, sizeof(*buffer));
 }
 
@@ -149,6 +205,7 @@ lwmsg_connection_buffer_queue_fragment(
     )
 {
     lwmsg_ring_insert_before(&buffer->fragments, &fragment->ring);
+    buffer->fragment_count++;
 }
 
 ConnectionFragment*
@@ -166,6 +223,7 @@ lwmsg_connection_buffer_dequeue_fragment(
     {
         ring = buffer->fragments.next;
         lwmsg_ring_remove(ring);
+        buffer->fragment_count--;
         return LWMSG_OBJECT_FROM_MEMBER(ring, ConnectionFragment, ring);
     }
 }
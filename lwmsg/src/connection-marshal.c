@@ -43,10 +43,18 @@
 #include "convert-private.h"
 #include "util-private.h"
 #include "connection-private.h"
+#include "type-private.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef HAVE_MEMFD_CREATE
+#  include <sys/mman.h>
+#  include <pthread.h>
+#endif
 
 static LWMsgStatus
 lwmsg_connection_marshal_fd(
@@ -167,3 +175,435 @@ LWMsgTypeClass lwmsg_fd_type_class =
     .destroy_presented = lwmsg_connection_free_fd,
     .destroy_transmitted = NULL /* Nothing to free in transmitted form */
 };
+
+/* Transmitted form of a shared buffer.  When shared is set,
+   the contents travel in the next queued descriptor rather
+   than inline in the message. */
+typedef struct SharedBufferTransmit
+{
+    uint32_t length;
+    uint8_t shared;
+    unsigned char* data;
+} SharedBufferTransmit;
+
+static LWMsgTypeSpec shared_buffer_transmit_spec[] =
+{
+    LWMSG_STRUCT_BEGIN(SharedBufferTransmit),
+    LWMSG_MEMBER_UINT32(SharedBufferTransmit, length),
+    LWMSG_MEMBER_UINT8(SharedBufferTransmit, shared),
+    LWMSG_MEMBER_POINTER_BEGIN(SharedBufferTransmit, data),
+    LWMSG_UINT8(unsigned char),
+    LWMSG_POINTER_END,
+    LWMSG_ATTR_LENGTH_MEMBER(SharedBufferTransmit, length),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+#ifdef HAVE_MEMFD_CREATE
+#define SHARED_BUFFER_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE)
+
+static
+LWMsgStatus
+lwmsg_connection_create_segment(
+    const unsigned char* data,
+    size_t length,
+    int* out_fd
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    size_t offset = 0;
+    ssize_t count = 0;
+    int fd = -1;
+
+    fd = memfd_create("lwmsg-buffer", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0)
+    {
+        BAIL_ON_ERROR(status = lwmsg_status_map_errno(errno));
+    }
+
+    while (offset < length)
+    {
+        count = write(fd, data + offset, length - offset);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            BAIL_ON_ERROR(status = lwmsg_status_map_errno(errno));
+        }
+        offset += count;
+    }
+
+    /* Freeze the segment so the receiver can trust its size */
+    if (fcntl(fd, F_ADD_SEALS, SHARED_BUFFER_SEALS | F_SEAL_SEAL) < 0)
+    {
+        BAIL_ON_ERROR(status = lwmsg_status_map_errno(errno));
+    }
+
+    *out_fd = fd;
+    fd = -1;
+
+error:
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    return status;
+}
+
+/* Segments mapped into received messages, so that freeing a
+   message can tell them apart from buffers the caller allocated */
+typedef struct SharedMapping
+{
+    LWMsgRing ring;
+    void* base;
+    size_t length;
+} SharedMapping;
+
+static pthread_mutex_t shared_mapping_lock = PTHREAD_MUTEX_INITIALIZER;
+static LWMsgHashTable shared_mappings;
+
+static
+void*
+lwmsg_shared_mapping_get_key(
+    const void* entry
+    )
+{
+    return ((SharedMapping*) entry)->base;
+}
+
+static
+size_t
+lwmsg_shared_mapping_digest(
+    const void* key
+    )
+{
+    /* Mappings are page aligned */
+    return ((size_t) key) >> 12;
+}
+
+static
+LWMsgBool
+lwmsg_shared_mapping_equal(
+    const void* key1,
+    const void* key2
+    )
+{
+    return key1 == key2;
+}
+
+static
+LWMsgStatus
+lwmsg_connection_map_segment(
+    int fd,
+    size_t length,
+    size_t max_length,
+    unsigned char** out_data
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    struct stat statbuf;
+    SharedMapping* mapping = NULL;
+    void* base = MAP_FAILED;
+    int seals = 0;
+
+    /* Check the segment before trusting the advertised length for
+       anything: it must be a sealed memfd of exactly that size, so
+       a misbehaving peer cannot make us fault or grow the mapping */
+    seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & SHARED_BUFFER_SEALS) != SHARED_BUFFER_SEALS)
+    {
+        BAIL_ON_ERROR(status = LWMSG_STATUS_MALFORMED);
+    }
+
+    if (fstat(fd, &statbuf) < 0)
+    {
+        BAIL_ON_ERROR(status = lwmsg_status_map_errno(errno));
+    }
+
+    if (!S_ISREG(statbuf.st_mode) ||
+        length == 0 ||
+        statbuf.st_size != (off_t) length)
+    {
+        BAIL_ON_ERROR(status = LWMSG_STATUS_MALFORMED);
+    }
+
+    if (length > max_length)
+    {
+        BAIL_ON_ERROR(status = LWMSG_STATUS_OVERFLOW);
+    }
+
+    BAIL_ON_ERROR(status = LWMSG_ALLOC(&mapping));
+
+    /* A private mapping lets the receiver scribble on the buffer
+       (copy on write) even though the segment itself is sealed */
+    base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        BAIL_ON_ERROR(status = lwmsg_status_map_errno(errno));
+    }
+
+    mapping->base = base;
+    mapping->length = length;
+    lwmsg_ring_init(&mapping->ring);
+
+    pthread_mutex_lock(&shared_mapping_lock);
+    if (!shared_mappings.buckets)
+    {
+        status = lwmsg_hash_init(
+            &shared_mappings,
+            31,
+            lwmsg_shared_mapping_get_key,
+            lwmsg_shared_mapping_digest,
+            lwmsg_shared_mapping_equal,
+            offsetof(SharedMapping, ring));
+    }
+    if (!status)
+    {
+        lwmsg_hash_insert_entry(&shared_mappings, mapping);
+    }
+    pthread_mutex_unlock(&shared_mapping_lock);
+    BAIL_ON_ERROR(status);
+
+    *out_data = base;
+    base = MAP_FAILED;
+    mapping = NULL;
+
+error:
+
+    if (base != MAP_FAILED)
+    {
+        munmap(base, length);
+    }
+
+    free(mapping);
+
+    return status;
+}
+
+static
+LWMsgBool
+lwmsg_connection_unmap_segment(
+    unsigned char* data
+    )
+{
+    SharedMapping* mapping = NULL;
+
+    pthread_mutex_lock(&shared_mapping_lock);
+    if (shared_mappings.buckets)
+    {
+        mapping = lwmsg_hash_find_key(&shared_mappings, data);
+        if (mapping)
+        {
+            lwmsg_hash_remove_entry(&shared_mappings, mapping);
+        }
+    }
+    pthread_mutex_unlock(&shared_mapping_lock);
+
+    if (!mapping)
+    {
+        return LWMSG_FALSE;
+    }
+
+    munmap(mapping->base, mapping->length);
+    free(mapping);
+
+    return LWMSG_TRUE;
+}
+#endif
+
+static LWMsgStatus
+lwmsg_connection_marshal_shared_buffer(
+    LWMsgDataContext* context,
+    LWMsgTypeAttrs* attrs,
+    void* object,
+    void* transmit_object,
+    void* data
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    unsigned char* buffer = *(unsigned char**) object;
+    uint32_t length = *(uint32_t*) ((unsigned char*) object + (ptrdiff_t) (size_t) data);
+    SharedBufferTransmit* transmit = transmit_object;
+    LWMsgAssoc* assoc = NULL;
+#ifdef HAVE_MEMFD_CREATE
+    int fd = -1;
+#endif
+
+    BAIL_ON_ERROR(status = lwmsg_context_get_data(
+                      lwmsg_data_context_get_context(context),
+                      "assoc",
+                      (void**) (void*) &assoc));
+
+    transmit->length = buffer ? length : 0;
+    transmit->shared = 0;
+    transmit->data = buffer;
+
+#ifdef HAVE_MEMFD_CREATE
+    if (assoc && buffer &&
+        length >= CONNECTION_SHARED_BUFFER_THRESHOLD &&
+        length <= CONNECTION_SHARED_BUFFER_MAX)
+    {
+        status = lwmsg_connection_create_segment(buffer, length, &fd);
+        if (status == LWMSG_STATUS_SUCCESS)
+        {
+            BAIL_ON_ERROR(status = lwmsg_connection_queue_fd(assoc, fd));
+            transmit->shared = 1;
+            transmit->data = NULL;
+        }
+        else
+        {
+            /* No memfd support on this kernel, send it inline */
+            status = LWMSG_STATUS_SUCCESS;
+        }
+    }
+#endif
+
+error:
+
+#ifdef HAVE_MEMFD_CREATE
+    if (fd >= 0)
+    {
+        /* The queue holds its own duplicate */
+        close(fd);
+    }
+#endif
+
+    return status;
+}
+
+static LWMsgStatus
+lwmsg_connection_unmarshal_shared_buffer(
+    LWMsgDataContext* context,
+    LWMsgTypeAttrs* attrs,
+    void* transmit_object,
+    void* natural_object,
+    void* data
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    SharedBufferTransmit* transmit = transmit_object;
+    unsigned char* buffer = NULL;
+    LWMsgAssoc* assoc = NULL;
+    int fd = -1;
+#ifdef HAVE_MEMFD_CREATE
+    size_t max_length = 0;
+#endif
+
+    if (transmit->shared)
+    {
+        BAIL_ON_ERROR(status = lwmsg_context_get_data(
+                          lwmsg_data_context_get_context(context),
+                          "assoc",
+                          (void**) (void*) &assoc));
+
+        if (!assoc)
+        {
+            BAIL_ON_ERROR(status = LWMSG_STATUS_MALFORMED);
+        }
+
+        BAIL_ON_ERROR(status = lwmsg_connection_dequeue_fd(assoc, &fd));
+
+#ifdef HAVE_MEMFD_CREATE
+        max_length = CONNECTION_SHARED_BUFFER_MAX;
+        if (attrs->max_alloc && attrs->max_alloc < max_length)
+        {
+            max_length = attrs->max_alloc;
+        }
+
+        /* Map the segment rather than copying out of it */
+        BAIL_ON_ERROR(status = lwmsg_connection_map_segment(
+                          fd,
+                          transmit->length,
+                          max_length,
+                          &buffer));
+#else
+        BAIL_ON_ERROR(status = LWMSG_STATUS_UNSUPPORTED);
+#endif
+    }
+    else
+    {
+        /* Take ownership of the inline copy */
+        buffer = transmit->data;
+        transmit->data = NULL;
+    }
+
+    *(unsigned char**) natural_object = buffer;
+    buffer = NULL;
+
+error:
+
+    if (buffer)
+    {
+        lwmsg_data_free_memory(context, buffer);
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    return status;
+}
+
+static
+void
+lwmsg_connection_free_shared_buffer(
+    LWMsgDataContext* context,
+    LWMsgTypeAttrs* attrs,
+    void* object,
+    void* data
+    )
+{
+    unsigned char* buffer = *(unsigned char**) object;
+
+    if (buffer)
+    {
+#ifdef HAVE_MEMFD_CREATE
+        if (lwmsg_connection_unmap_segment(buffer))
+        {
+            return;
+        }
+#endif
+        lwmsg_data_free_memory(context, buffer);
+    }
+}
+
+static
+LWMsgStatus
+lwmsg_connection_print_shared_buffer(
+    LWMsgDataContext* context,
+    LWMsgTypeAttrs* attrs,
+    void* object,
+    void* data,
+    LWMsgBuffer* buffer
+    )
+{
+    unsigned char* contents = *(unsigned char**) object;
+    uint32_t length = *(uint32_t*) ((unsigned char*) object + (ptrdiff_t) (size_t) data);
+
+    /* Printing must not go through the marshaller, which
+       would queue a descriptor on the connection */
+    if (contents)
+    {
+        return lwmsg_buffer_print(buffer, "<%lu bytes>", (unsigned long) length);
+    }
+    else
+    {
+        return lwmsg_buffer_print(buffer, "<null>");
+    }
+}
+
+LWMsgTypeClass lwmsg_shared_buffer_type_class =
+{
+    .is_pointer = LWMSG_TRUE,
+    .transmit_type = shared_buffer_transmit_spec,
+    .marshal = lwmsg_connection_marshal_shared_buffer,
+    .unmarshal = lwmsg_connection_unmarshal_shared_buffer,
+    .destroy_presented = lwmsg_connection_free_shared_buffer,
+    .destroy_transmitted = NULL, /* Transmitted form only borrows the buffer */
+    .print = lwmsg_connection_print_shared_buffer
+};
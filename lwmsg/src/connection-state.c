@@ -751,6 +751,14 @@ lwmsg_connection_state_established(
             priv->params.message = priv->outgoing;
             priv->outgoing = NULL;
         }
+        else if (!priv->outgoing && !priv->is_corked &&
+                 !lwmsg_ring_is_empty(&priv->sendbuffer.fragments) &&
+                 (status = lwmsg_connection_finish_send_message(assoc)) == LWMSG_STATUS_SUCCESS)
+        {
+            /* Flushed messages held back while corked; there is
+               no message to hand back */
+            priv->params.message = NULL;
+        }
         else if (priv->incoming)
         {
             /* If we are still pending on a send, try a receive before giving up */
@@ -786,7 +794,11 @@ lwmsg_connection_state_established(
         default:
             BAIL_ON_ERROR(status);
         }
-        BAIL_ON_ERROR(status = lwmsg_connection_finish_send_message(assoc));
+        /* A corked connection sends the message when uncorked */
+        if (!priv->is_corked)
+        {
+            BAIL_ON_ERROR(status = lwmsg_connection_finish_send_message(assoc));
+        }
         priv->outgoing = NULL;
         break;
     case CONNECTION_EVENT_RECV:
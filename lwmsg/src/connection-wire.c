@@ -50,6 +50,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <limits.h>
 
 #include "connection-private.h"
 #include "assoc-private.h"
@@ -78,6 +79,12 @@
 #    define CMSG_LEN(len) (CMSG_ALIGN(sizeof(struct cmsghdr)) + (len))
 #endif
 
+#if defined(IOV_MAX) && IOV_MAX < CONNECTION_MAX_SEND_BATCH
+#    define SEND_BATCH IOV_MAX
+#else
+#    define SEND_BATCH CONNECTION_MAX_SEND_BATCH
+#endif
+
 static void
 lwmsg_connection_packet_ntoh(ConnectionPacket* packet)
 {
@@ -203,6 +210,15 @@ error:
     return status;
 }
 
+/*
+ * Reads the rest of the packet in fragment.  Bytes are taken from
+ * the read-ahead buffer first.  When it runs dry, the next read goes
+ * into the read-ahead buffer as well, picking up any packets queued
+ * behind this one, unless only the packet body is left to read, in
+ * which case it goes straight into the fragment.  Since a read is
+ * only issued once the read-ahead buffer is empty, a pending status
+ * always means the socket has been drained.
+ */
 static
 LWMsgStatus
 lwmsg_connection_recv_fragment(
@@ -214,6 +230,18 @@ lwmsg_connection_recv_fragment(
     ConnectionPrivate* priv = CONNECTION_PRIVATE(assoc);
     ConnectionBuffer* buffer = &priv->recvbuffer;
     size_t length = 0;
+    size_t wanted = 0;
+    LWMsgBool direct = LWMSG_FALSE;
+
+    if (!buffer->ahead)
+    {
+        buffer->ahead = malloc(CONNECTION_RECV_AHEAD_SIZE);
+        if (!buffer->ahead)
+        {
+            BAIL_ON_ERROR(status = LWMSG_STATUS_MEMORY);
+        }
+        buffer->ahead_cursor = buffer->ahead_end = buffer->ahead;
+    }
 
     /* While we do not have an entire packet, repeat */
     while (!lwmsg_connection_fragment_is_complete(fragment))
@@ -228,12 +256,11 @@ lwmsg_connection_recv_fragment(
         struct cmsghdr *cmsg = NULL;
         size_t received = 0;
         
-        iovec.iov_base = fragment->cursor;
-        
         if ((fragment->cursor - fragment->data) < CONNECTION_PACKET_SIZE(ConnectionPacketBase))
         {
             /* If we have not received a full packet header, ask for the remainder */
-            iovec.iov_len = CONNECTION_PACKET_SIZE(ConnectionPacketBase) - (fragment->cursor - fragment->data);
+            wanted = CONNECTION_PACKET_SIZE(ConnectionPacketBase) - (fragment->cursor - fragment->data);
+            direct = LWMSG_FALSE;
         }
         else
         {
@@ -244,7 +271,32 @@ lwmsg_connection_recv_fragment(
                 BAIL_ON_ERROR(status = LWMSG_STATUS_MALFORMED);
             }
 
-            iovec.iov_len = length - (fragment->cursor - fragment->data);
+            wanted = length - (fragment->cursor - fragment->data);
+            direct = LWMSG_TRUE;
+        }
+
+        if (buffer->ahead_cursor < buffer->ahead_end)
+        {
+            if (wanted > (size_t) (buffer->ahead_end - buffer->ahead_cursor))
+            {
+                wanted = buffer->ahead_end - buffer->ahead_cursor;
+            }
+
+            memcpy(fragment->cursor, buffer->ahead_cursor, wanted);
+            fragment->cursor += wanted;
+            buffer->ahead_cursor += wanted;
+            continue;
+        }
+
+        if (direct)
+        {
+            iovec.iov_base = fragment->cursor;
+            iovec.iov_len = wanted;
+        }
+        else
+        {
+            iovec.iov_base = buffer->ahead;
+            iovec.iov_len = CONNECTION_RECV_AHEAD_SIZE;
         }
         
         msghdr.msg_iov = &iovec;
@@ -255,7 +307,15 @@ lwmsg_connection_recv_fragment(
         
         BAIL_ON_ERROR(status = lwmsg_connection_recvmsg(assoc, priv->fd, &msghdr, 0, &received));
         
-        fragment->cursor += received;
+        if (direct)
+        {
+            fragment->cursor += received;
+        }
+        else
+        {
+            buffer->ahead_cursor = buffer->ahead;
+            buffer->ahead_end = buffer->ahead + received;
+        }
         
         if (msghdr.msg_controllen > 0 &&
             /* Work around bizarre behavior of X/Open recvmsg on HP-UX 11.11 */
@@ -348,45 +408,81 @@ error:
     return status;
 }
 
+/*
+ * Queues a complete outgoing fragment.  The packet header is
+ * converted to wire order right away so that the send path
+ * can hand any run of queued fragments to the kernel as is.
+ */
 static
-LWMsgStatus
-lwmsg_connection_send_fragment(
+void
+lwmsg_connection_queue_send_fragment(
     LWMsgAssoc* assoc,
     ConnectionFragment* fragment
     )
+{
+    ConnectionPrivate* priv = CONNECTION_PRIVATE(assoc);
+
+    lwmsg_connection_packet_ntoh((ConnectionPacket*) fragment->data);
+    lwmsg_connection_buffer_queue_fragment(&priv->sendbuffer, fragment);
+    priv->sendbuffer.message_fragments++;
+}
+
+/*
+ * Sends as much of the queued fragments as the socket will take,
+ * gathering up to CONNECTION_MAX_SEND_BATCH of them (and any queued
+ * fds) into each sendmsg().  Fully sent fragments are freed; the
+ * first partially sent fragment stays at the head of the queue with
+ * its cursor advanced.
+ */
+LWMsgStatus
+lwmsg_connection_send_all_fragments(
+    LWMsgAssoc* assoc
+    )
 {
     LWMsgStatus status = LWMSG_STATUS_SUCCESS;
     ConnectionPrivate* priv = CONNECTION_PRIVATE(assoc);
     ConnectionBuffer* buffer = &priv->sendbuffer;
+    ConnectionFragment* fragment = NULL;
     struct msghdr msghdr = {0};
-    struct iovec iovec = {0};
+    struct iovec iovec[SEND_BATCH];
     union
     {
         struct cmsghdr cm;
         char buf[CMSG_SPACE(sizeof(int) * MAX_FD_PAYLOAD)];
     } buf_un;
     struct cmsghdr *cmsg = NULL;
+    LWMsgRing* ring = NULL;
     size_t sent = 0;
     size_t fds_to_send = 0;
+    size_t count = 0;
     size_t i;
 
-    while (!lwmsg_connection_fragment_is_complete(fragment))
+    while (!lwmsg_ring_is_empty(&buffer->fragments))
     {
+        memset(&msghdr, 0, sizeof(msghdr));
+
+        for (ring = buffer->fragments.next, count = 0;
+             ring != &buffer->fragments && count < SEND_BATCH;
+             ring = ring->next, count++)
+        {
+            fragment = LWMSG_OBJECT_FROM_MEMBER(ring, ConnectionFragment, ring);
+
+            iovec[count].iov_base = fragment->cursor;
+            iovec[count].iov_len =
+                lwmsg_connection_packet_length((ConnectionPacket*) fragment->data)
+                - (fragment->cursor - fragment->data);
+        }
+
+        msghdr.msg_iov = iovec;
+        msghdr.msg_iovlen = count;
+
         fds_to_send = buffer->fd_length;
 
         if (fds_to_send > MAX_FD_PAYLOAD)
         {
             fds_to_send = MAX_FD_PAYLOAD;
         }
-        
-        iovec.iov_base = fragment->cursor;
-        iovec.iov_len = 
-            lwmsg_connection_packet_length((ConnectionPacket*) fragment->data)
-            - (fragment->cursor - fragment->data);
 
-        msghdr.msg_iov = &iovec;
-        msghdr.msg_iovlen = 1;
-        
         if (fds_to_send)
         {
             msghdr.msg_control = buf_un.buf;
@@ -402,8 +498,6 @@ lwmsg_connection_send_fragment(
         }
 
         BAIL_ON_ERROR(status = lwmsg_connection_sendmsg(assoc, priv->fd, &msghdr, 0, &sent));
-        
-        fragment->cursor += sent;
 
         /* Close sent fds since they were copies */
         for (i = 0; i < fds_to_send; i++)
@@ -414,6 +508,22 @@ lwmsg_connection_send_fragment(
         /* Remove sent fds from queue */
         memmove(buffer->fd, buffer->fd + fds_to_send, (buffer->fd_length - fds_to_send) * sizeof(int));
         buffer->fd_length -= fds_to_send;
+
+        /* Retire the fragments that went out and advance into the next one */
+        for (i = 0; i < count && sent; i++)
+        {
+            if (sent < iovec[i].iov_len)
+            {
+                fragment = lwmsg_connection_buffer_get_first_fragment(buffer);
+                fragment->cursor += sent;
+                break;
+            }
+
+            sent -= iovec[i].iov_len;
+            lwmsg_connection_buffer_free_fragment(
+                buffer,
+                lwmsg_connection_buffer_dequeue_fragment(buffer));
+        }
     }
 
 error:
@@ -431,6 +541,7 @@ lwmsg_connection_queue_fd(LWMsgAssoc* assoc, int fd)
     BAIL_ON_ERROR(status = lwmsg_connection_buffer_ensure_fd_capacity(buffer, 1));
     buffer->fd[buffer->fd_length] = dup(fd);
     buffer->fd_length++;
+    buffer->message_fds++;
     
 error:
 
@@ -633,17 +744,21 @@ lwmsg_connection_send_wrap(LWMsgBuffer* buffer, size_t needed)
     }
 
     /* Now that the packet is complete, send it */
-    lwmsg_connection_buffer_queue_fragment(
-                      &priv->sendbuffer,
-                      fragment);
+    lwmsg_connection_queue_send_fragment(assoc, fragment);
     fragment = NULL;
 
-    /* Flush the send buffer */
-    status = lwmsg_connection_send_all_fragments(assoc);
+    /* Flush the send buffer.  A corked connection holds complete
+       messages back so they go out together when it is uncorked,
+       but still streams messages spanning several fragments */
+    if (!priv->is_corked || needed ||
+        priv->sendbuffer.fragment_count >= CONNECTION_MAX_SEND_BATCH)
+    {
+        status = lwmsg_connection_send_all_fragments(assoc);
+    }
 
-    if (needed && status == LWMSG_STATUS_PENDING)
+    if ((needed || priv->is_corked) && status == LWMSG_STATUS_PENDING)
     {
-        /* If we have more to marshal but we can't send,
+        /* If we have more to marshal (or are corked) but we can't send,
            ignore it for now and continue to queue up packets */
         status = LWMSG_STATUS_SUCCESS;
     }
@@ -701,33 +816,6 @@ lwmsg_connection_begin_timeout(
     return status;
 }
 
-LWMsgStatus
-lwmsg_connection_send_all_fragments(
-    LWMsgAssoc* assoc
-    )
-{
-    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
-    ConnectionPrivate* priv = CONNECTION_PRIVATE(assoc);
-    
-    while (priv->sendbuffer.current ||
-           !lwmsg_ring_is_empty(&priv->sendbuffer.fragments))
-    {
-        if (!priv->sendbuffer.current)
-        {
-            priv->sendbuffer.current = lwmsg_connection_buffer_dequeue_fragment(&priv->sendbuffer);
-            lwmsg_connection_packet_ntoh((ConnectionPacket*) priv->sendbuffer.current->data);
-        }
-
-        BAIL_ON_ERROR(status = lwmsg_connection_send_fragment(assoc, priv->sendbuffer.current));
-        free(priv->sendbuffer.current);
-        priv->sendbuffer.current = NULL;
-    }
-
-error:
-
-    return status;
-}
-
 LWMsgStatus
 lwmsg_connection_recv_next_fragment(
     LWMsgAssoc* assoc,
@@ -1079,7 +1167,7 @@ lwmsg_connection_begin_send_connect(
     }
 #endif
 
-    lwmsg_connection_buffer_queue_fragment(&priv->sendbuffer, fragment);
+    lwmsg_connection_queue_send_fragment(assoc, fragment);
     fragment = NULL;
 
 error:
@@ -1211,9 +1299,10 @@ lwmsg_connection_finish_recv_connect(
                       token));
     token = NULL;
 
-    /* Reconstruct buffers in case our packet size changed */
-    lwmsg_connection_buffer_destruct(&priv->recvbuffer);
-    BAIL_ON_ERROR(status = lwmsg_connection_buffer_construct(&priv->recvbuffer));
+    /* Reconstruct buffers in case our packet size changed.  The
+       receive buffer is only emptied since the peer's first
+       messages may already be sitting in its read-ahead bytes */
+    lwmsg_connection_buffer_empty(&priv->recvbuffer);
     lwmsg_connection_buffer_destruct(&priv->sendbuffer);
     BAIL_ON_ERROR(status = lwmsg_connection_buffer_construct(&priv->sendbuffer));
 
@@ -1311,7 +1400,7 @@ lwmsg_connection_begin_send_accept(
     }
 #endif
 
-    lwmsg_connection_buffer_queue_fragment(&priv->sendbuffer, fragment);
+    lwmsg_connection_queue_send_fragment(assoc, fragment);
     fragment = NULL;
 
 error:
@@ -1443,9 +1532,10 @@ lwmsg_connection_finish_recv_accept(
                       token));
     token = NULL;    
 
-    /* Reconstruct buffers in case our packet size changed */
-    lwmsg_connection_buffer_destruct(&priv->recvbuffer);
-    BAIL_ON_ERROR(status = lwmsg_connection_buffer_construct(&priv->recvbuffer));
+    /* Reconstruct buffers in case our packet size changed.  The
+       receive buffer is only emptied since the peer's first
+       messages may already be sitting in its read-ahead bytes */
+    lwmsg_connection_buffer_empty(&priv->recvbuffer);
     lwmsg_connection_buffer_destruct(&priv->sendbuffer);
     BAIL_ON_ERROR(status = lwmsg_connection_buffer_construct(&priv->sendbuffer));
 
@@ -1495,6 +1585,10 @@ lwmsg_connection_begin_send_message(
     
     memset(&buffer, 0, sizeof(buffer));
 
+    /* Anything queued from here on belongs to this message */
+    priv->sendbuffer.message_fragments = 0;
+    priv->sendbuffer.message_fds = 0;
+
     if (message->tag != LWMSG_TAG_INVALID)
     {
         status = lwmsg_protocol_get_message_type(prot, message->tag, &type);
@@ -1535,7 +1629,7 @@ lwmsg_connection_begin_send_message(
         packet->length = CONNECTION_PACKET_SIZE(ConnectionPacketMsg);
         packet->flags |= CONNECTION_PACKET_FLAG_LAST_FRAGMENT;
 
-        lwmsg_connection_buffer_queue_fragment(&priv->sendbuffer, fragment);
+        lwmsg_connection_queue_send_fragment(assoc, fragment);
         fragment = NULL;
     }
     else
@@ -1565,10 +1659,11 @@ error:
         lwmsg_connection_buffer_free_fragment(&priv->sendbuffer, (ConnectionFragment*) buffer.base);
     }
 
-    /* On error, empty out remaining fragments in send buffer */
+    /* On error, drop what is left of this message but keep any
+       earlier messages still held back by a cork */
     if (status && status != LWMSG_STATUS_PENDING)
     {
-        lwmsg_connection_buffer_empty(&priv->sendbuffer);
+        lwmsg_connection_buffer_drop_message(&priv->sendbuffer);
     }
 
     return status;
@@ -1586,10 +1681,11 @@ lwmsg_connection_finish_send_message(
 
 error:
 
-    /* On error, empty out remaining fragments in send buffer */
+    /* On error, drop what is left of this message but keep any
+       earlier messages still held back by a cork */
     if (status && status != LWMSG_STATUS_PENDING)
     {
-        lwmsg_connection_buffer_empty(&priv->sendbuffer);
+        lwmsg_connection_buffer_drop_message(&priv->sendbuffer);
     }
 
     return status;
@@ -1748,7 +1844,7 @@ lwmsg_connection_begin_send_shutdown(
     packet->flags = CONNECTION_PACKET_FLAG_SINGLE;
     packet->contents.shutdown.status = reason;
     
-    lwmsg_connection_buffer_queue_fragment(&priv->sendbuffer, fragment);
+    lwmsg_connection_queue_send_fragment(assoc, fragment);
 
 done:
 
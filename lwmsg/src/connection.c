@@ -228,6 +228,30 @@ error:
     return status;
 }
 
+static LWMsgStatus
+lwmsg_connection_set_cork(
+    LWMsgAssoc* assoc,
+    LWMsgBool cork
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    ConnectionPrivate* priv = CONNECTION_PRIVATE(assoc);
+
+    priv->is_corked = cork;
+
+    /* A blocking connection has no later finish call to
+       flush what was held back, so do it now */
+    if (!cork && !priv->is_nonblock && priv->state == CONNECTION_STATE_ESTABLISHED)
+    {
+        BAIL_ON_ERROR(status = lwmsg_connection_begin_timeout(assoc, &priv->timeout.message));
+        BAIL_ON_ERROR(status = lwmsg_connection_run(assoc, CONNECTION_EVENT_FINISH));
+    }
+
+error:
+
+    return status;
+}
+
 static LWMsgStatus
 lwmsg_connection_get_session(
     LWMsgAssoc* assoc,
@@ -418,6 +442,7 @@ static LWMsgAssocClass connection_class =
     .connect_peer = lwmsg_connection_connect,
     .accept_peer = lwmsg_connection_accept,
     .set_nonblock = lwmsg_connection_set_nonblock,
+    .set_cork = lwmsg_connection_set_cork,
     .finish = lwmsg_connection_finish
 };
 
@@ -525,3 +550,13 @@ error:
 
     return status;
 }
+
+int
+lwmsg_connection_get_fd(
+    LWMsgAssoc* assoc
+    )
+{
+    ConnectionPrivate* priv = CONNECTION_PRIVATE(assoc);
+
+    return priv->fd;
+}
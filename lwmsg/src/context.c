@@ -623,3 +623,256 @@ lwmsg_memlist_destroy(
 
     lwmsg_context_cleanup(&list->context);
 }
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT (2 * sizeof(void*))
+
+typedef struct ArenaChunk
+{
+    LWMsgRing ring;
+    size_t size;
+    size_t used;
+} ArenaChunk;
+
+#define ARENA_HEADER_SIZE (MEMLIST_ALIGN(sizeof(ArenaChunk), ARENA_ALIGNMENT))
+#define ARENA_CHUNK_DATA(chunk) (((unsigned char*) (chunk)) + ARENA_HEADER_SIZE)
+
+static
+ArenaChunk*
+lwmsg_arena_current(
+    LWMsgMemoryArena* arena
+    )
+{
+    if (lwmsg_ring_is_empty(&arena->chunks))
+    {
+        return NULL;
+    }
+
+    return LWMSG_OBJECT_FROM_MEMBER(arena->chunks.prev, ArenaChunk, ring);
+}
+
+static
+LWMsgStatus
+lwmsg_arena_add_chunk(
+    LWMsgMemoryArena* arena,
+    size_t size,
+    ArenaChunk** out
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    ArenaChunk* chunk = NULL;
+
+    if (!lwmsg_ring_is_empty(&arena->spare))
+    {
+        chunk = LWMSG_OBJECT_FROM_MEMBER(arena->spare.next, ArenaChunk, ring);
+
+        if (chunk->size >= size)
+        {
+            lwmsg_ring_remove(&chunk->ring);
+            goto done;
+        }
+    }
+
+    if (size < ARENA_CHUNK_SIZE)
+    {
+        size = ARENA_CHUNK_SIZE;
+    }
+
+    BAIL_ON_ERROR(status = lwmsg_context_alloc(
+                      arena->parent_context,
+                      ARENA_HEADER_SIZE + size,
+                      (void**) (void*) &chunk));
+
+    lwmsg_ring_init(&chunk->ring);
+    chunk->size = size;
+
+done:
+
+    chunk->used = 0;
+    lwmsg_ring_enqueue(&arena->chunks, &chunk->ring);
+    *out = chunk;
+
+error:
+
+    return status;
+}
+
+static
+LWMsgStatus
+lwmsg_arena_alloc(
+    size_t size,
+    void** out,
+    void* data
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgMemoryArena* arena = data;
+    ArenaChunk* chunk = lwmsg_arena_current(arena);
+    size_t aligned = MEMLIST_ALIGN(size ? size : 1, ARENA_ALIGNMENT);
+    unsigned char* object = NULL;
+
+    if (!chunk || chunk->size - chunk->used < aligned)
+    {
+        BAIL_ON_ERROR(status = lwmsg_arena_add_chunk(arena, aligned, &chunk));
+    }
+
+    object = ARENA_CHUNK_DATA(chunk) + chunk->used;
+    chunk->used += aligned;
+
+    /* Memory may be reused after a rewind */
+    memset(object, 0, size);
+
+    *out = object;
+
+error:
+
+    return status;
+}
+
+static
+void
+lwmsg_arena_free(
+    void* object,
+    void* data
+    )
+{
+    /* Objects live until the arena is rewound or destroyed */
+}
+
+static
+LWMsgStatus
+lwmsg_arena_realloc(
+    void* object,
+    size_t old_size,
+    size_t new_size,
+    void** new_object,
+    void* data
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgMemoryArena* arena = data;
+    ArenaChunk* chunk = lwmsg_arena_current(arena);
+    size_t old_aligned = MEMLIST_ALIGN(old_size ? old_size : 1, ARENA_ALIGNMENT);
+    size_t new_aligned = MEMLIST_ALIGN(new_size ? new_size : 1, ARENA_ALIGNMENT);
+    unsigned char* start = NULL;
+
+    if (!object)
+    {
+        BAIL_ON_ERROR(status = lwmsg_arena_alloc(new_size, new_object, data));
+    }
+    else if (chunk &&
+        (unsigned char*) object + old_aligned == ARENA_CHUNK_DATA(chunk) + chunk->used &&
+        chunk->size - chunk->used + old_aligned >= new_aligned)
+    {
+        /* Grow or shrink the most recent allocation in place */
+        start = object;
+        chunk->used = start - ARENA_CHUNK_DATA(chunk) + new_aligned;
+
+        if (new_size > old_size)
+        {
+            memset(start + old_size, 0, new_size - old_size);
+        }
+
+        *new_object = object;
+    }
+    else
+    {
+        BAIL_ON_ERROR(status = lwmsg_arena_alloc(new_size, new_object, data));
+        memcpy(*new_object, object, old_size < new_size ? old_size : new_size);
+    }
+
+error:
+
+    return status;
+}
+
+void
+lwmsg_arena_init(
+    LWMsgMemoryArena* arena,
+    LWMsgContext* context
+    )
+{
+    arena->parent_context = context;
+
+    lwmsg_context_setup(&arena->context, context);
+    lwmsg_context_set_memory_functions(
+        &arena->context,
+        lwmsg_arena_alloc,
+        lwmsg_arena_free,
+        lwmsg_arena_realloc,
+        arena);
+    lwmsg_ring_init(&arena->chunks);
+    lwmsg_ring_init(&arena->spare);
+}
+
+void
+lwmsg_arena_mark(
+    LWMsgMemoryArena* arena,
+    LWMsgArenaMark* mark
+    )
+{
+    ArenaChunk* chunk = lwmsg_arena_current(arena);
+
+    mark->chunk = chunk ? &chunk->ring : NULL;
+    mark->used = chunk ? chunk->used : 0;
+}
+
+/*
+ * Releases everything allocated since mark was taken.  Chunks past
+ * the marked one are kept aside for reuse rather than freed, so a
+ * caller that repeatedly allocates and rewinds settles into a fixed
+ * set of chunks.
+ */
+void
+lwmsg_arena_rewind(
+    LWMsgMemoryArena* arena,
+    const LWMsgArenaMark* mark
+    )
+{
+    LWMsgRing* stop = mark->chunk ? mark->chunk : &arena->chunks;
+    ArenaChunk* chunk = NULL;
+
+    while (arena->chunks.prev != stop)
+    {
+        chunk = LWMSG_OBJECT_FROM_MEMBER(arena->chunks.prev, ArenaChunk, ring);
+        lwmsg_ring_remove(&chunk->ring);
+        lwmsg_ring_insert_after(&arena->spare, &chunk->ring);
+    }
+
+    if (mark->chunk)
+    {
+        LWMSG_OBJECT_FROM_MEMBER(mark->chunk, ArenaChunk, ring)->used = mark->used;
+    }
+}
+
+void
+lwmsg_arena_reset(
+    LWMsgMemoryArena* arena
+    )
+{
+    LWMsgArenaMark mark = {NULL, 0};
+
+    lwmsg_arena_rewind(arena, &mark);
+}
+
+void
+lwmsg_arena_destroy(
+    LWMsgMemoryArena* arena
+    )
+{
+    LWMsgRing* ring = NULL;
+    LWMsgRing* next = NULL;
+
+    lwmsg_arena_reset(arena);
+
+    for (ring = arena->spare.next; ring != &arena->spare; ring = next)
+    {
+        next = ring->next;
+
+        lwmsg_context_free(
+            arena->parent_context,
+            LWMSG_OBJECT_FROM_MEMBER(ring, ArenaChunk, ring));
+    }
+
+    lwmsg_context_cleanup(&arena->context);
+}
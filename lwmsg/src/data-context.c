@@ -85,7 +85,10 @@ lwmsg_data_context_delete(
     LWMsgDataContext* context
     )
 {
-    free(context);
+    if (context)
+    {
+        free(context);
+    }
 }
 
 void
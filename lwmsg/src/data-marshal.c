@@ -710,6 +710,307 @@ error:
     return status;
 }
 
+static LWMsgStatus
+lwmsg_data_marshal_plan(
+    LWMsgDataContext* context,
+    LWMsgMarshalState* state,
+    LWMsgDataPlan* plan,
+    unsigned char* object,
+    LWMsgBuffer* buffer
+    );
+
+static inline
+LWMsgStatus
+lwmsg_data_marshal_plan_integer(
+    LWMsgDataContext* context,
+    LWMsgDataPlan* plan,
+    unsigned char* object,
+    unsigned char* out
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+
+    if (plan->iter.attrs.flags & LWMSG_TYPE_FLAG_RANGE)
+    {
+        BAIL_ON_ERROR(status = lwmsg_data_verify_range(
+                          context,
+                          &plan->iter,
+                          object,
+                          plan->size));
+    }
+
+    status = lwmsg_convert_integer_inline(
+        object,
+        plan->size,
+        LWMSG_NATIVE_ENDIAN,
+        out,
+        plan->width,
+        context->byte_order,
+        plan->sign);
+    if (status)
+    {
+        BAIL_ON_ERROR(status = DATA_RAISE(
+            context,
+            &plan->iter,
+            status,
+            "Integer overflow converting from %s %lu-bit to %lu-bit",
+            plan->sign == LWMSG_UNSIGNED ? "unsigned" : "signed",
+            (unsigned long) plan->size * 8,
+            (unsigned long) plan->width * 8));
+    }
+
+error:
+
+    return status;
+}
+
+static LWMsgStatus
+lwmsg_data_marshal_plan_struct(
+    LWMsgDataContext* context,
+    LWMsgMarshalState* state,
+    LWMsgDataPlan* plan,
+    unsigned char* object,
+    LWMsgBuffer* buffer
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgMarshalState my_state = {object, state->map};
+    LWMsgDataPlan* member = NULL;
+    unsigned char* out = NULL;
+    size_t i;
+
+    if (plan->flat_size && (size_t) (buffer->end - buffer->cursor) >= plan->flat_size)
+    {
+        /* Everything fits, so convert straight into the buffer */
+        out = buffer->cursor;
+
+        for (i = 0; i < plan->member_count; i++)
+        {
+            member = &plan->members[i];
+
+            if (member->kind == LWMSG_PLAN_INTEGER)
+            {
+                BAIL_ON_ERROR(status = lwmsg_data_marshal_plan_integer(
+                                  context,
+                                  member,
+                                  object + member->offset,
+                                  out));
+            }
+            else
+            {
+                memcpy(out, object + member->offset, member->width);
+            }
+
+            out += member->width;
+        }
+
+        buffer->cursor = out;
+    }
+    else
+    {
+        for (i = 0; i < plan->member_count; i++)
+        {
+            member = &plan->members[i];
+
+            BAIL_ON_ERROR(status = lwmsg_data_marshal_plan(
+                              context,
+                              &my_state,
+                              member,
+                              object + member->offset,
+                              buffer));
+        }
+    }
+
+error:
+
+    return status;
+}
+
+static LWMsgStatus
+lwmsg_data_marshal_plan_indirect(
+    LWMsgDataContext* context,
+    LWMsgMarshalState* state,
+    LWMsgDataPlan* plan,
+    unsigned char* object,
+    LWMsgBuffer* buffer
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgDataPlan* element = plan->element;
+    unsigned char implicit_length[4];
+    size_t count = 0;
+    size_t i;
+
+    switch (plan->iter.info.kind_indirect.term)
+    {
+    case LWMSG_TERM_STATIC:
+        count = plan->iter.info.kind_indirect.term_info.static_length;
+        break;
+    case LWMSG_TERM_MEMBER:
+        BAIL_ON_ERROR(status = lwmsg_data_extract_length(
+                          &plan->iter,
+                          state->dominating_object,
+                          &count));
+        break;
+    case LWMSG_TERM_ZERO:
+        if (!object)
+        {
+            if (plan->iter.attrs.flags & LWMSG_TYPE_FLAG_NOT_NULL)
+            {
+                BAIL_ON_ERROR(status = DATA_RAISE(
+                    context,
+                    &plan->iter,
+                    LWMSG_STATUS_MALFORMED,
+                    "NULL passed for non-nullable pointer"));
+            }
+            count = 0;
+        }
+        else
+        {
+            if (element->size == 1)
+            {
+                count = strlen((const char*) object);
+            }
+            else
+            {
+                for (count = 0; ; count++)
+                {
+                    for (i = 0; i < element->size; i++)
+                    {
+                        if (object[count * element->size + i])
+                        {
+                            break;
+                        }
+                    }
+
+                    if (i == element->size)
+                    {
+                        break;
+                    }
+                }
+            }
+
+            BAIL_ON_ERROR(status = lwmsg_convert_integer(
+                              &count,
+                              sizeof(count),
+                              LWMSG_NATIVE_ENDIAN,
+                              implicit_length,
+                              sizeof(implicit_length),
+                              context->byte_order,
+                              LWMSG_UNSIGNED));
+
+            BAIL_ON_ERROR(status = lwmsg_buffer_write(buffer, implicit_length, sizeof(implicit_length)));
+        }
+        break;
+    }
+
+    if (plan->iter.attrs.flags & LWMSG_TYPE_FLAG_NOT_NULL && !object && count != 0)
+    {
+        BAIL_ON_ERROR(status = DATA_RAISE(
+            context,
+            &plan->iter,
+            LWMSG_STATUS_MALFORMED,
+            "NULL passed for non-nullable pointer"));
+    }
+
+    if (plan->byte_copy)
+    {
+        BAIL_ON_ERROR(status = lwmsg_buffer_write(buffer, object, count));
+    }
+    else
+    {
+        for (i = 0; i < count; i++)
+        {
+            BAIL_ON_ERROR(status = lwmsg_data_marshal_plan(
+                              context,
+                              state,
+                              element,
+                              object + i * element->size,
+                              buffer));
+        }
+    }
+
+error:
+
+    return status;
+}
+
+static LWMsgStatus
+lwmsg_data_marshal_plan_pointer(
+    LWMsgDataContext* context,
+    LWMsgMarshalState* state,
+    LWMsgDataPlan* plan,
+    unsigned char* object,
+    LWMsgBuffer* buffer
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    unsigned char* pointee = *(unsigned char**) object;
+    unsigned char ptr_flag = pointee ? 0xFF : 0x00;
+
+    if (!(plan->iter.attrs.flags & LWMSG_TYPE_FLAG_NOT_NULL))
+    {
+        BAIL_ON_ERROR(status = lwmsg_buffer_write(buffer, &ptr_flag, 1));
+    }
+
+    if (ptr_flag || (plan->iter.attrs.flags & LWMSG_TYPE_FLAG_NOT_NULL))
+    {
+        BAIL_ON_ERROR(status = lwmsg_data_marshal_plan_indirect(
+                          context,
+                          state,
+                          plan,
+                          pointee,
+                          buffer));
+    }
+
+error:
+
+    return status;
+}
+
+static LWMsgStatus
+lwmsg_data_marshal_plan(
+    LWMsgDataContext* context,
+    LWMsgMarshalState* state,
+    LWMsgDataPlan* plan,
+    unsigned char* object,
+    LWMsgBuffer* buffer
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    unsigned char out[MAX_INTEGER_SIZE];
+    LWMsgTypeIter iter;
+
+    switch (plan->kind)
+    {
+    case LWMSG_PLAN_INTEGER:
+        BAIL_ON_ERROR(status = lwmsg_data_marshal_plan_integer(context, plan, object, out));
+        BAIL_ON_ERROR(status = lwmsg_buffer_write(buffer, out, plan->width));
+        break;
+    case LWMSG_PLAN_BYTES:
+        BAIL_ON_ERROR(status = lwmsg_buffer_write(buffer, object, plan->width));
+        break;
+    case LWMSG_PLAN_STRUCT:
+        BAIL_ON_ERROR(status = lwmsg_data_marshal_plan_struct(context, state, plan, object, buffer));
+        break;
+    case LWMSG_PLAN_POINTER:
+        BAIL_ON_ERROR(status = lwmsg_data_marshal_plan_pointer(context, state, plan, object, buffer));
+        break;
+    case LWMSG_PLAN_ARRAY:
+        BAIL_ON_ERROR(status = lwmsg_data_marshal_plan_indirect(context, state, plan, object, buffer));
+        break;
+    case LWMSG_PLAN_INTERPRET:
+        iter = plan->iter;
+        iter.dom_object = state->dominating_object;
+        BAIL_ON_ERROR(status = lwmsg_data_marshal_internal(context, state, &iter, object, buffer));
+        break;
+    }
+
+error:
+
+    return status;
+}
+
 LWMsgStatus
 lwmsg_data_marshal(LWMsgDataContext* context, LWMsgTypeSpec* type, void* object, LWMsgBuffer* buffer)
 {
@@ -717,12 +1018,22 @@ lwmsg_data_marshal(LWMsgDataContext* context, LWMsgTypeSpec* type, void* object,
     LWMsgObjectMap map;
     LWMsgMarshalState state = {NULL, &map};
     LWMsgTypeIter iter;
+    LWMsgDataPlan* plan = NULL;
 
     memset(&map, 0, sizeof(map));
 
-    lwmsg_type_iterate_promoted(type, &iter);
+    lwmsg_data_plan_find(context, type, &plan);
 
-    BAIL_ON_ERROR(status = lwmsg_data_marshal_internal(context, &state, &iter, (unsigned char*) &object, buffer));
+    if (plan)
+    {
+        BAIL_ON_ERROR(status = lwmsg_data_marshal_plan(context, &state, plan, (unsigned char*) &object, buffer));
+    }
+    else
+    {
+        lwmsg_type_iterate_promoted(type, &iter);
+
+        BAIL_ON_ERROR(status = lwmsg_data_marshal_internal(context, &state, &iter, (unsigned char*) &object, buffer));
+    }
 
     if (buffer->wrap)
     {
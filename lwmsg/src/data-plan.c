@@ -0,0 +1,463 @@
+/*
+ * Copyright (c) Likewise Software.  All rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the license, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.  You should have received a copy
+ * of the GNU Lesser General Public License along with this program.  If
+ * not, see <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * LESSER GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Module Name:
+ *
+ *        data-plan.c
+ *
+ * Abstract:
+ *
+ *        Marshalling API
+ *        Compiled marshalling plans
+ *
+ */
+
+#include <config.h>
+
+#include "data-private.h"
+#include "util-private.h"
+#include "type-private.h"
+
+#include <string.h>
+#include <pthread.h>
+
+/* Inline arrays of integers up to this length are unrolled
+   into the containing structure */
+#define MAX_UNROLL_LENGTH 16
+
+/* Compiled plans by type spec, shared by every data context in the
+   process since most callers create a data context per message */
+static pthread_mutex_t plan_lock = PTHREAD_MUTEX_INITIALIZER;
+static LWMsgHashTable plans;
+
+static
+LWMsgStatus
+lwmsg_data_plan_compile(
+    LWMsgTypeIter* iter,
+    LWMsgDataPlan* plan
+    );
+
+static
+void
+lwmsg_data_plan_free_contents(
+    LWMsgDataPlan* plan
+    )
+{
+    size_t i;
+
+    if (plan->members)
+    {
+        for (i = 0; i < plan->member_count; i++)
+        {
+            lwmsg_data_plan_free_contents(&plan->members[i]);
+        }
+        free(plan->members);
+        plan->members = NULL;
+    }
+
+    if (plan->element)
+    {
+        lwmsg_data_plan_free_contents(plan->element);
+        free(plan->element);
+        plan->element = NULL;
+    }
+}
+
+static
+LWMsgBool
+lwmsg_data_plan_is_flat(
+    LWMsgDataPlan* plan
+    )
+{
+    return plan->kind == LWMSG_PLAN_INTEGER || plan->kind == LWMSG_PLAN_BYTES;
+}
+
+static
+LWMsgStatus
+lwmsg_data_plan_append(
+    LWMsgDataPlan* plan,
+    size_t* capacity,
+    LWMsgDataPlan* member,
+    size_t offset
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgDataPlan* members = NULL;
+    size_t new_capacity = 0;
+
+    if (plan->member_count == *capacity)
+    {
+        new_capacity = *capacity ? *capacity * 2 : 8;
+        members = realloc(plan->members, new_capacity * sizeof(*members));
+        if (!members)
+        {
+            BAIL_ON_ERROR(status = LWMSG_STATUS_MEMORY);
+        }
+        plan->members = members;
+        *capacity = new_capacity;
+    }
+
+    plan->members[plan->member_count] = *member;
+    plan->members[plan->member_count].offset += offset;
+    plan->member_count++;
+
+error:
+
+    return status;
+}
+
+static
+LWMsgStatus
+lwmsg_data_plan_compile_struct(
+    LWMsgTypeIter* iter,
+    LWMsgDataPlan* plan
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgTypeIter member_iter;
+    LWMsgDataPlan member;
+    size_t capacity = 0;
+    size_t i;
+    LWMsgBool flat = LWMSG_TRUE;
+
+    memset(&member, 0, sizeof(member));
+
+    for (lwmsg_type_enter(iter, &member_iter);
+         lwmsg_type_valid(&member_iter);
+         lwmsg_type_next(&member_iter))
+    {
+        if (member_iter.kind == LWMSG_KIND_ARRAY &&
+            member_iter.info.kind_indirect.term != LWMSG_TERM_STATIC)
+        {
+            /* Flexible array members need the allocation tricks
+               in the interpreter, so leave the whole structure to it */
+            lwmsg_data_plan_free_contents(plan);
+            plan->member_count = 0;
+            plan->kind = LWMSG_PLAN_INTERPRET;
+            goto error;
+        }
+
+        BAIL_ON_ERROR(status = lwmsg_data_plan_compile(&member_iter, &member));
+
+        if (member.kind == LWMSG_PLAN_STRUCT && member.flat_size)
+        {
+            /* Merge nested structure of integers into our own member list */
+            for (i = 0; i < member.member_count; i++)
+            {
+                BAIL_ON_ERROR(status = lwmsg_data_plan_append(
+                                  plan,
+                                  &capacity,
+                                  &member.members[i],
+                                  member.offset));
+            }
+            free(member.members);
+        }
+        else if (member.kind == LWMSG_PLAN_ARRAY &&
+                 lwmsg_data_plan_is_flat(member.element) &&
+                 member.iter.info.kind_indirect.term_info.static_length <= MAX_UNROLL_LENGTH)
+        {
+            /* Unroll short inline array of integers */
+            for (i = 0; i < member.iter.info.kind_indirect.term_info.static_length; i++)
+            {
+                BAIL_ON_ERROR(status = lwmsg_data_plan_append(
+                                  plan,
+                                  &capacity,
+                                  member.element,
+                                  member.offset + i * member.element->size));
+            }
+            lwmsg_data_plan_free_contents(&member);
+        }
+        else
+        {
+            BAIL_ON_ERROR(status = lwmsg_data_plan_append(plan, &capacity, &member, 0));
+        }
+
+        memset(&member, 0, sizeof(member));
+    }
+
+    for (i = 0; i < plan->member_count; i++)
+    {
+        if (!lwmsg_data_plan_is_flat(&plan->members[i]))
+        {
+            flat = LWMSG_FALSE;
+            break;
+        }
+    }
+
+    if (flat)
+    {
+        for (i = 0; i < plan->member_count; i++)
+        {
+            plan->flat_size += plan->members[i].width;
+        }
+    }
+
+error:
+
+    lwmsg_data_plan_free_contents(&member);
+
+    return status;
+}
+
+static
+LWMsgStatus
+lwmsg_data_plan_compile_indirect(
+    LWMsgTypeIter* iter,
+    LWMsgDataPlan* plan
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgTypeIter inner;
+
+    lwmsg_type_enter(iter, &inner);
+
+    BAIL_ON_ERROR(status = LWMSG_ALLOC(&plan->element));
+    BAIL_ON_ERROR(status = lwmsg_data_plan_compile(&inner, plan->element));
+
+    /* Same test as the interpreter for copying strings directly */
+    plan->byte_copy =
+        (inner.kind == LWMSG_KIND_INTEGER || inner.kind == LWMSG_KIND_ENUM) &&
+        inner.info.kind_integer.width == 1 &&
+        inner.size == 1;
+
+error:
+
+    return status;
+}
+
+static
+LWMsgStatus
+lwmsg_data_plan_compile(
+    LWMsgTypeIter* iter,
+    LWMsgDataPlan* plan
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+
+    memset(plan, 0, sizeof(*plan));
+
+    plan->kind = LWMSG_PLAN_INTERPRET;
+    plan->iter = *iter;
+    plan->offset = iter->offset;
+    plan->size = iter->size;
+
+    if (iter->verify)
+    {
+        /* The interpreter takes care of verify functions */
+        goto error;
+    }
+
+    switch (iter->kind)
+    {
+    case LWMSG_KIND_INTEGER:
+        plan->kind = LWMSG_PLAN_INTEGER;
+        plan->width = iter->info.kind_integer.width;
+        plan->sign = iter->info.kind_integer.sign;
+        break;
+    case LWMSG_KIND_STRUCT:
+        plan->kind = LWMSG_PLAN_STRUCT;
+        BAIL_ON_ERROR(status = lwmsg_data_plan_compile_struct(iter, plan));
+        break;
+    case LWMSG_KIND_POINTER:
+        if (iter->attrs.flags & LWMSG_TYPE_FLAG_ALIASABLE)
+        {
+            break;
+        }
+
+        BAIL_ON_ERROR(status = lwmsg_data_plan_compile_indirect(iter, plan));
+
+        if (plan->element->iter.kind == LWMSG_KIND_STRUCT &&
+            plan->element->kind != LWMSG_PLAN_STRUCT)
+        {
+            /* Structure pointee with a flexible member */
+            lwmsg_data_plan_free_contents(plan);
+            break;
+        }
+
+        plan->kind = LWMSG_PLAN_POINTER;
+        break;
+    case LWMSG_KIND_ARRAY:
+        if (iter->info.kind_indirect.term != LWMSG_TERM_STATIC)
+        {
+            break;
+        }
+
+        BAIL_ON_ERROR(status = lwmsg_data_plan_compile_indirect(iter, plan));
+
+        if (plan->byte_copy)
+        {
+            plan->kind = LWMSG_PLAN_BYTES;
+            plan->width = iter->info.kind_indirect.term_info.static_length;
+            lwmsg_data_plan_free_contents(plan);
+        }
+        else
+        {
+            plan->kind = LWMSG_PLAN_ARRAY;
+        }
+        break;
+    default:
+        break;
+    }
+
+error:
+
+    return status;
+}
+
+static
+void
+lwmsg_data_plan_free(
+    LWMsgDataPlan* plan
+    )
+{
+    if (plan)
+    {
+        lwmsg_data_plan_free_contents(plan);
+        free(plan);
+    }
+}
+
+static
+void*
+lwmsg_data_plan_get_key(
+    const void* entry
+    )
+{
+    return (void*) ((LWMsgDataPlanEntry*) entry)->spec;
+}
+
+static
+size_t
+lwmsg_data_plan_digest(
+    const void* key
+    )
+{
+    return ((size_t) key) >> 3;
+}
+
+static
+LWMsgBool
+lwmsg_data_plan_equal(
+    const void* key1,
+    const void* key2
+    )
+{
+    return key1 == key2;
+}
+
+void
+lwmsg_data_plan_find(
+    LWMsgDataContext* context,
+    LWMsgTypeSpec* spec,
+    LWMsgDataPlan** plan
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgDataPlanEntry* entry = NULL;
+    LWMsgTypeIter iter;
+
+    *plan = NULL;
+
+    if (context->plans_disabled)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&plan_lock);
+
+    if (!plans.buckets)
+    {
+        BAIL_ON_ERROR(status = lwmsg_hash_init(
+                          &plans,
+                          257,
+                          lwmsg_data_plan_get_key,
+                          lwmsg_data_plan_digest,
+                          lwmsg_data_plan_equal,
+                          offsetof(LWMsgDataPlanEntry, ring)));
+    }
+
+    entry = lwmsg_hash_find_key(&plans, spec);
+
+    if (!entry)
+    {
+        BAIL_ON_ERROR(status = LWMSG_ALLOC(&entry));
+        lwmsg_ring_init(&entry->ring);
+        entry->spec = spec;
+
+        BAIL_ON_ERROR(status = LWMSG_ALLOC(&entry->plan));
+
+        lwmsg_type_iterate_promoted(spec, &iter);
+        BAIL_ON_ERROR(status = lwmsg_data_plan_compile(&iter, entry->plan));
+
+        lwmsg_hash_insert_entry(&plans, entry);
+    }
+
+    *plan = entry->plan;
+
+done:
+
+    pthread_mutex_unlock(&plan_lock);
+
+    return;
+
+error:
+
+    if (entry)
+    {
+        lwmsg_data_plan_free(entry->plan);
+        free(entry);
+    }
+
+    goto done;
+}
+
+void
+lwmsg_data_forget_type(
+    LWMsgTypeSpec* spec
+    )
+{
+    LWMsgDataPlanEntry* entry = NULL;
+
+    pthread_mutex_lock(&plan_lock);
+
+    if (plans.buckets && (entry = lwmsg_hash_find_key(&plans, spec)))
+    {
+        lwmsg_hash_remove_entry(&plans, entry);
+        lwmsg_data_plan_free(entry->plan);
+        free(entry);
+    }
+
+    pthread_mutex_unlock(&plan_lock);
+}
+
+void
+lwmsg_data_context_set_plans(
+    LWMsgDataContext* context,
+    LWMsgBool enable
+    )
+{
+    context->plans_disabled = !enable;
+}
@@ -1102,6 +1102,360 @@ error:
 
 }
 
+static LWMsgStatus
+lwmsg_data_unmarshal_plan(
+    LWMsgDataContext* context,
+    LWMsgUnmarshalState* state,
+    LWMsgDataPlan* plan,
+    LWMsgBuffer* buffer,
+    unsigned char* object
+    );
+
+static inline
+LWMsgStatus
+lwmsg_data_unmarshal_plan_integer(
+    LWMsgDataContext* context,
+    LWMsgDataPlan* plan,
+    unsigned char* in,
+    unsigned char* object
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+
+    status = lwmsg_convert_integer_inline(
+        in,
+        plan->width,
+        context->byte_order,
+        object,
+        plan->size,
+        LWMSG_NATIVE_ENDIAN,
+        plan->sign);
+    if (status)
+    {
+        BAIL_ON_ERROR(status = DATA_RAISE(
+            context,
+            &plan->iter,
+            status,
+            "Integer overflow converting from %s %lu-bit to %lu-bit",
+            plan->sign == LWMSG_UNSIGNED ? "unsigned" : "signed",
+            (unsigned long) plan->width * 8,
+            (unsigned long) plan->size * 8));
+    }
+
+    if (plan->iter.attrs.flags & LWMSG_TYPE_FLAG_RANGE)
+    {
+        BAIL_ON_ERROR(status = lwmsg_data_verify_range(
+                          context,
+                          &plan->iter,
+                          object,
+                          plan->size));
+    }
+
+error:
+
+    return status;
+}
+
+static LWMsgStatus
+lwmsg_data_unmarshal_plan_struct(
+    LWMsgDataContext* context,
+    LWMsgUnmarshalState* state,
+    LWMsgDataPlan* plan,
+    LWMsgBuffer* buffer,
+    unsigned char* object
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgUnmarshalState my_state = {object, state->map};
+    LWMsgDataPlan* member = NULL;
+    unsigned char* in = NULL;
+    size_t i;
+
+    if (plan->flat_size && (size_t) (buffer->end - buffer->cursor) >= plan->flat_size)
+    {
+        /* Everything is present, so convert straight out of the buffer */
+        in = buffer->cursor;
+
+        for (i = 0; i < plan->member_count; i++)
+        {
+            member = &plan->members[i];
+
+            if (member->kind == LWMSG_PLAN_INTEGER)
+            {
+                BAIL_ON_ERROR(status = lwmsg_data_unmarshal_plan_integer(
+                                  context,
+                                  member,
+                                  in,
+                                  object + member->offset));
+            }
+            else
+            {
+                memcpy(object + member->offset, in, member->width);
+            }
+
+            in += member->width;
+        }
+
+        buffer->cursor = in;
+    }
+    else
+    {
+        for (i = 0; i < plan->member_count; i++)
+        {
+            member = &plan->members[i];
+
+            BAIL_ON_ERROR(status = lwmsg_data_unmarshal_plan(
+                              context,
+                              &my_state,
+                              member,
+                              buffer,
+                              object + member->offset));
+        }
+    }
+
+error:
+
+    return status;
+}
+
+static LWMsgStatus
+lwmsg_data_unmarshal_plan_elements(
+    LWMsgDataContext* context,
+    LWMsgUnmarshalState* state,
+    LWMsgDataPlan* plan,
+    LWMsgBuffer* buffer,
+    unsigned char* object,
+    size_t count
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    size_t i;
+
+    if (plan->byte_copy)
+    {
+        BAIL_ON_ERROR(status = lwmsg_buffer_read(buffer, object, count));
+    }
+    else
+    {
+        for (i = 0; i < count; i++)
+        {
+            BAIL_ON_ERROR(status = lwmsg_data_unmarshal_plan(
+                              context,
+                              state,
+                              plan->element,
+                              buffer,
+                              object + i * plan->element->size));
+        }
+    }
+
+error:
+
+    return status;
+}
+
+static LWMsgStatus
+lwmsg_data_unmarshal_plan_pointees(
+    LWMsgDataContext* context,
+    LWMsgUnmarshalState* state,
+    LWMsgDataPlan* plan,
+    LWMsgBuffer* buffer,
+    unsigned char** out
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgDataPlan* element = plan->element;
+    LWMsgBool is_struct = element->kind == LWMSG_PLAN_STRUCT;
+    unsigned char* object = NULL;
+    unsigned char temp[4];
+    size_t count = 0;
+    size_t full_count = 0;
+    size_t referent_size = 0;
+    LWMsgTypeIter iter;
+
+    switch (plan->iter.info.kind_indirect.term)
+    {
+    case LWMSG_TERM_STATIC:
+        count = plan->iter.info.kind_indirect.term_info.static_length;
+        break;
+    case LWMSG_TERM_MEMBER:
+        BAIL_ON_ERROR(status = lwmsg_data_extract_length(
+                          &plan->iter,
+                          state->dominating_object,
+                          &count));
+        break;
+    case LWMSG_TERM_ZERO:
+        BAIL_ON_ERROR(status = lwmsg_buffer_read(buffer, temp, sizeof(temp)));
+        BAIL_ON_ERROR(status = lwmsg_convert_integer(
+                          temp,
+                          sizeof(temp),
+                          context->byte_order,
+                          &count,
+                          sizeof(count),
+                          LWMSG_NATIVE_ENDIAN,
+                          LWMSG_UNSIGNED));
+        break;
+    }
+
+    if (is_struct && count == 1)
+    {
+        /* A single structure is allocated without a terminator,
+           as in lwmsg_data_unmarshal_struct_pointee() */
+        full_count = 1;
+    }
+    else if (plan->iter.info.kind_indirect.term == LWMSG_TERM_ZERO)
+    {
+        BAIL_ON_ERROR(status = DATA_RAISE(
+            context,
+            &plan->iter,
+            lwmsg_add_unsigned(count, 1, &full_count),
+            "Integer overflow in pointer referent length"));
+    }
+    else
+    {
+        full_count = count;
+    }
+
+    BAIL_ON_ERROR(status = DATA_RAISE(
+        context,
+        &plan->iter,
+        lwmsg_multiply_unsigned(full_count, element->size, &referent_size),
+        "Integer overflow in referent size"));
+
+    if (plan->iter.attrs.max_alloc && referent_size > plan->iter.attrs.max_alloc)
+    {
+        BAIL_ON_ERROR(status = DATA_RAISE(
+            context,
+            &plan->iter,
+            LWMSG_STATUS_OVERFLOW,
+            "Pointer referent exceeded max allocation size of %lu",
+            (unsigned long) plan->iter.attrs.max_alloc));
+    }
+
+    BAIL_ON_ERROR(status = lwmsg_object_alloc(context, referent_size, &object));
+
+    BAIL_ON_ERROR(status = lwmsg_data_unmarshal_plan_elements(
+                      context,
+                      state,
+                      plan,
+                      buffer,
+                      object,
+                      count));
+
+    *out = object;
+
+done:
+
+    return status;
+
+error:
+
+    *out = NULL;
+
+    if (object)
+    {
+        if (is_struct && count == 1)
+        {
+            iter = element->iter;
+            iter.dom_object = object;
+            lwmsg_data_unmarshal_free_partial_struct(context, &iter, object);
+        }
+        else
+        {
+            iter = plan->iter;
+            iter.dom_object = state->dominating_object;
+            lwmsg_data_free_graph_internal(context, &iter, (unsigned char*) &object);
+        }
+    }
+
+    goto done;
+}
+
+static LWMsgStatus
+lwmsg_data_unmarshal_plan_pointer(
+    LWMsgDataContext* context,
+    LWMsgUnmarshalState* state,
+    LWMsgDataPlan* plan,
+    LWMsgBuffer* buffer,
+    unsigned char** out
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    unsigned char ptr_flag = 0xFF;
+
+    if (!(plan->iter.attrs.flags & LWMSG_TYPE_FLAG_NOT_NULL))
+    {
+        BAIL_ON_ERROR(status = lwmsg_buffer_read(buffer, &ptr_flag, sizeof(ptr_flag)));
+    }
+
+    if (ptr_flag)
+    {
+        BAIL_ON_ERROR(status = lwmsg_data_unmarshal_plan_pointees(
+                          context,
+                          state,
+                          plan,
+                          buffer,
+                          out));
+    }
+
+error:
+
+    return status;
+}
+
+static LWMsgStatus
+lwmsg_data_unmarshal_plan(
+    LWMsgDataContext* context,
+    LWMsgUnmarshalState* state,
+    LWMsgDataPlan* plan,
+    LWMsgBuffer* buffer,
+    unsigned char* object
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    unsigned char temp[MAX_INTEGER_SIZE];
+    LWMsgTypeIter iter;
+
+    switch (plan->kind)
+    {
+    case LWMSG_PLAN_INTEGER:
+        BAIL_ON_ERROR(status = lwmsg_buffer_read(buffer, temp, plan->width));
+        BAIL_ON_ERROR(status = lwmsg_data_unmarshal_plan_integer(context, plan, temp, object));
+        break;
+    case LWMSG_PLAN_BYTES:
+        BAIL_ON_ERROR(status = lwmsg_buffer_read(buffer, object, plan->width));
+        break;
+    case LWMSG_PLAN_STRUCT:
+        BAIL_ON_ERROR(status = lwmsg_data_unmarshal_plan_struct(context, state, plan, buffer, object));
+        break;
+    case LWMSG_PLAN_POINTER:
+        BAIL_ON_ERROR(status = lwmsg_data_unmarshal_plan_pointer(
+                          context,
+                          state,
+                          plan,
+                          buffer,
+                          (unsigned char**) object));
+        break;
+    case LWMSG_PLAN_ARRAY:
+        BAIL_ON_ERROR(status = lwmsg_data_unmarshal_plan_elements(
+                          context,
+                          state,
+                          plan,
+                          buffer,
+                          object,
+                          plan->iter.info.kind_indirect.term_info.static_length));
+        break;
+    case LWMSG_PLAN_INTERPRET:
+        iter = plan->iter;
+        iter.dom_object = state->dominating_object;
+        BAIL_ON_ERROR(status = lwmsg_data_unmarshal_internal(context, state, &iter, buffer, object));
+        break;
+    }
+
+error:
+
+    return status;
+}
+
 LWMsgStatus
 lwmsg_data_unmarshal(LWMsgDataContext* context, LWMsgTypeSpec* type, LWMsgBuffer* buffer, void** out)
 {
@@ -1109,12 +1463,22 @@ lwmsg_data_unmarshal(LWMsgDataContext* context, LWMsgTypeSpec* type, LWMsgBuffer
     LWMsgObjectMap map;
     LWMsgUnmarshalState my_state = {NULL, &map};
     LWMsgTypeIter iter;
+    LWMsgDataPlan* plan = NULL;
 
     memset(&map, 0, sizeof(map));
 
-    lwmsg_type_iterate_promoted(type, &iter);
+    lwmsg_data_plan_find(context, type, &plan);
 
-    BAIL_ON_ERROR(status = lwmsg_data_unmarshal_internal(context, &my_state, &iter, buffer, (unsigned char*) out));
+    if (plan)
+    {
+        BAIL_ON_ERROR(status = lwmsg_data_unmarshal_plan(context, &my_state, plan, buffer, (unsigned char*) out));
+    }
+    else
+    {
+        lwmsg_type_iterate_promoted(type, &iter);
+
+        BAIL_ON_ERROR(status = lwmsg_data_unmarshal_internal(context, &my_state, &iter, buffer, (unsigned char*) out));
+    }
 
     if (buffer->wrap)
     {
@@ -1141,6 +1505,7 @@ lwmsg_data_unmarshal_into(
     LWMsgObjectMap map;
     LWMsgUnmarshalState my_state = {NULL, &map};
     LWMsgTypeIter iter;
+    LWMsgDataPlan* plan = NULL;
 
     memset(&map, 0, sizeof(map));
 
@@ -1151,7 +1516,22 @@ lwmsg_data_unmarshal_into(
         BAIL_ON_ERROR(status = LWMSG_STATUS_BUFFER_TOO_SMALL);
     }
 
-    BAIL_ON_ERROR(status = lwmsg_data_unmarshal_internal(context, &my_state, &iter, buffer, object));
+    lwmsg_data_plan_find(context, type, &plan);
+
+    if (plan && (plan->iter.attrs.flags & LWMSG_TYPE_FLAG_PROMOTED))
+    {
+        /* Unmarshal into the object the promoted pointer would refer to */
+        plan = plan->element;
+    }
+
+    if (plan)
+    {
+        BAIL_ON_ERROR(status = lwmsg_data_unmarshal_plan(context, &my_state, plan, buffer, object));
+    }
+    else
+    {
+        BAIL_ON_ERROR(status = lwmsg_data_unmarshal_internal(context, &my_state, &iter, buffer, object));
+    }
 
     if (buffer->wrap)
     {
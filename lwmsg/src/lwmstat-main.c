@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) Likewise Software.  All rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the license, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.  You should have received a copy
+ * of the GNU Lesser General Public License along with this program.  If
+ * not, see <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * LESSER GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Module Name:
+ *
+ *        lwmstat-main.c
+ *
+ * Abstract:
+ *
+ *        Likewise Message peer statistics tool
+ *
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <lwmsg/lwmsg.h>
+#include "util-private.h"
+#include "status-private.h"
+
+/* Upper bound in microseconds of a histogram bucket */
+static
+uint64_t
+bucket_limit(
+    unsigned int bucket
+    )
+{
+    return bucket ? ((uint64_t) 1 << bucket) : 1;
+}
+
+/* Estimates a percentile as the upper bound of the bucket containing it */
+static
+uint64_t
+histogram_percentile(
+    const uint64_t* histogram,
+    uint64_t count,
+    unsigned int percent
+    )
+{
+    uint64_t target = (count * percent + 99) / 100;
+    uint64_t seen = 0;
+    unsigned int i = 0;
+
+    for (i = 0; i < LWMSG_PEER_STATS_BUCKETS; i++)
+    {
+        seen += histogram[i];
+        if (seen && seen >= target)
+        {
+            break;
+        }
+    }
+
+    return bucket_limit(i < LWMSG_PEER_STATS_BUCKETS ? i : LWMSG_PEER_STATS_BUCKETS - 1);
+}
+
+static
+void
+print_histogram(
+    const char* label,
+    const uint64_t* histogram
+    )
+{
+    unsigned int i = 0;
+
+    printf("    %s:", label);
+
+    for (i = 0; i < LWMSG_PEER_STATS_BUCKETS; i++)
+    {
+        if (histogram[i])
+        {
+            if (i == LWMSG_PEER_STATS_BUCKETS - 1)
+            {
+                printf(" >=%llu:%llu",
+                       (unsigned long long) bucket_limit(i - 1),
+                       (unsigned long long) histogram[i]);
+            }
+            else
+            {
+                printf(" <%llu:%llu",
+                       (unsigned long long) bucket_limit(i),
+                       (unsigned long long) histogram[i]);
+            }
+        }
+    }
+
+    printf("\n");
+}
+
+static
+void
+print_stats(
+    LWMsgPeerStats* stats,
+    LWMsgBool verbose
+    )
+{
+    LWMsgPeerTagStats* tag = NULL;
+    LWMsgPeerSlowCall* slow = NULL;
+    LWMsgPeerThreadStats* thread = NULL;
+    char when[64];
+    time_t time = 0;
+    struct tm tm;
+    unsigned int i = 0;
+
+    printf("Uptime:         %llu s\n", (unsigned long long) stats->uptime);
+    printf("Clients:        %lu\n", (unsigned long) stats->clients);
+    printf("In flight:      %lu\n", (unsigned long) stats->in_flight);
+    printf("Rejected:       %llu\n", (unsigned long long) stats->rejected);
+    printf("Slow threshold: %llu us\n\n", (unsigned long long) stats->slow_threshold);
+
+    printf("%-32s %10s %8s %6s %10s %10s %10s %10s\n",
+           "Message", "Calls", "Failed", "Active", "Avg(us)", "p50(us)", "p99(us)", "Max(us)");
+
+    for (i = 0; i < stats->tag_count; i++)
+    {
+        tag = &stats->tags[i];
+
+        printf("%-32s %10llu %8llu %6lu %10llu %10llu %10llu %10llu\n",
+               tag->name ? tag->name : "<unnamed>",
+               (unsigned long long) tag->calls,
+               (unsigned long long) tag->failures,
+               (unsigned long) tag->in_flight,
+               (unsigned long long) (tag->calls ? tag->service_total / tag->calls : 0),
+               (unsigned long long) (tag->calls ? histogram_percentile(tag->service_histogram, tag->calls, 50) : 0),
+               (unsigned long long) (tag->calls ? histogram_percentile(tag->service_histogram, tag->calls, 99) : 0),
+               (unsigned long long) tag->service_max);
+
+        if (verbose && tag->calls)
+        {
+            print_histogram("queue", tag->queue_histogram);
+            print_histogram("service", tag->service_histogram);
+        }
+    }
+
+    if (stats->thread_count)
+    {
+        printf("\n%-8s %6s %8s %12s %12s %8s %8s\n",
+               "Thread", "Tasks", "Load(%)", "Runs", "Busy(ms)", "MovedIn", "MovedOut");
+
+        for (i = 0; i < stats->thread_count; i++)
+        {
+            thread = &stats->threads[i];
+
+            printf("%-8u %6lu %8.1f %12llu %12llu %8lu %8lu\n",
+                   i,
+                   (unsigned long) thread->tasks,
+                   thread->load / 10.0,
+                   (unsigned long long) thread->runs,
+                   (unsigned long long) (thread->busy_time / 1000),
+                   (unsigned long) thread->migrated_in,
+                   (unsigned long) thread->migrated_out);
+        }
+    }
+
+    if (stats->slow_call_count)
+    {
+        printf("\nRecent slow calls:\n");
+
+        for (i = 0; i < stats->slow_call_count; i++)
+        {
+            slow = &stats->slow_calls[i];
+            time = (time_t) slow->time;
+            localtime_r(&time, &tm);
+            strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+
+            printf("  %s tag %i: queued %llu us, serviced %llu us, %s\n",
+                   when,
+                   (int) slow->tag,
+                   (unsigned long long) slow->queue_time,
+                   (unsigned long long) slow->service_time,
+                   lwmsg_status_name(slow->status));
+        }
+    }
+}
+
+static
+LWMsgStatus
+peer_stats(
+    const char* endpoint,
+    LWMsgBool verbose
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgProtocol* protocol = NULL;
+    LWMsgPeer* peer = NULL;
+    LWMsgSession* session = NULL;
+    LWMsgCall* call = NULL;
+    LWMsgPeerStats* stats = NULL;
+
+    /* The statistics call is built in, so an empty protocol suffices */
+    BAIL_ON_ERROR(status = lwmsg_protocol_new(NULL, &protocol));
+    BAIL_ON_ERROR(status = lwmsg_peer_new(NULL, protocol, &peer));
+    BAIL_ON_ERROR(status = lwmsg_peer_add_connect_endpoint(peer, LWMSG_ENDPOINT_LOCAL, endpoint));
+    BAIL_ON_ERROR(status = lwmsg_peer_connect(peer, &session));
+    BAIL_ON_ERROR(status = lwmsg_session_acquire_call(session, &call));
+    BAIL_ON_ERROR(status = lwmsg_peer_query_stats(call, &stats));
+
+    print_stats(stats, verbose);
+
+error:
+
+    if (stats)
+    {
+        lwmsg_peer_free_stats(peer, stats);
+    }
+
+    if (call)
+    {
+        lwmsg_call_release(call);
+    }
+
+    if (peer)
+    {
+        lwmsg_peer_disconnect(peer);
+        lwmsg_peer_delete(peer);
+    }
+
+    if (protocol)
+    {
+        lwmsg_protocol_delete(protocol);
+    }
+
+    return status;
+}
+
+static
+void
+help()
+{
+    printf(
+        "Usage: lwmstat [-v] <endpoint>\n\n"
+        "Print call and task thread statistics of the lwmsg server listening\n"
+        "on <endpoint>.\n\n"
+        "Options:\n"
+        "  -v                  Also print latency histograms\n\n");
+}
+
+int
+main(
+    int argc,
+    char** argv
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgBool verbose = LWMSG_FALSE;
+    int i = 1;
+
+    if (i < argc && !strcmp(argv[i], "-v"))
+    {
+        verbose = LWMSG_TRUE;
+        i++;
+    }
+
+    if (i != argc - 1)
+    {
+        help();
+        exit(1);
+    }
+
+    BAIL_ON_ERROR(status = peer_stats(argv[i], verbose));
+
+error:
+
+    if (status)
+    {
+        fprintf(stderr, "Error: %s\n", lwmsg_status_name(status));
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
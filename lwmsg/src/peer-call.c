@@ -79,6 +79,8 @@ lwmsg_peer_call_worker(
     LWMsgStatus status = LWMSG_STATUS_SUCCESS;
     PeerCall* call = (PeerCall*) data;
 
+    call->params.incoming.start_time = lwmsg_peer_stats_clock();
+
     status = ((LWMsgPeerCallFunction) call->params.incoming.spec->data) (
         LWMSG_CALL(call),
         &call->params.incoming.in,
@@ -142,6 +144,8 @@ lwmsg_peer_call_dispatch_incoming(
 
     lwmsg_message_init(incoming_message);
 
+    lwmsg_peer_stats_begin_call(call->task->session->peer, call);
+
     if (call->task->session->peer->trace_begin)
     {
         call->task->session->peer->trace_begin(
@@ -196,29 +200,21 @@ error:
     return status;
 }
 
+/*
+ * Registers an outgoing call with its task and queues it for
+ * sending.  The session lock must be held, and the caller is
+ * responsible for waking the task.
+ */
 static
-LWMsgStatus
-lwmsg_peer_call_dispatch_outgoing(
-    LWMsgCall* call,
+void
+lwmsg_peer_call_queue_outgoing(
+    PeerCall* pcall,
     const LWMsgParams* input,
     LWMsgParams* output,
     LWMsgCompleteFunction complete,
     void* data
     )
 {
-    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
-    PeerCall* pcall = PEER_CALL(call);
-
-    pthread_mutex_lock(&pcall->task->session->lock);
-
-    BAIL_ON_ERROR(status = pcall->task->status);
-
-    /* Are we out of cookie slots? */
-    if (lwmsg_hash_get_count(&pcall->task->outgoing_calls) == ((LWMsgCookie) -1) + 1)
-    {
-        BAIL_ON_ERROR(status = LWMSG_STATUS_BUSY);
-    }
-
     pcall->state = PEER_CALL_NONE;
     pcall->params.outgoing.complete = complete;
     pcall->params.outgoing.complete_data = data;
@@ -234,17 +230,43 @@ lwmsg_peer_call_dispatch_outgoing(
 
     lwmsg_hash_insert_entry(&pcall->task->outgoing_calls, pcall);
     lwmsg_peer_call_activate_outgoing(pcall);
-    lwmsg_task_wake(pcall->task->event_task);
 
     /* Trace call start */
     if (pcall->task->session->peer->trace_begin)
     {
         pcall->task->session->peer->trace_begin(
-            LWMSG_CALL(call),
+            LWMSG_CALL(pcall),
             pcall->params.outgoing.in,
             LWMSG_STATUS_SUCCESS,
             pcall->task->session->peer->trace_data);
     }
+}
+
+static
+LWMsgStatus
+lwmsg_peer_call_dispatch_outgoing(
+    LWMsgCall* call,
+    const LWMsgParams* input,
+    LWMsgParams* output,
+    LWMsgCompleteFunction complete,
+    void* data
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    PeerCall* pcall = PEER_CALL(call);
+
+    pthread_mutex_lock(&pcall->task->session->lock);
+
+    BAIL_ON_ERROR(status = pcall->task->status);
+
+    /* Are we out of cookie slots? */
+    if (lwmsg_hash_get_count(&pcall->task->outgoing_calls) == ((LWMsgCookie) -1) + 1)
+    {
+        BAIL_ON_ERROR(status = LWMSG_STATUS_BUSY);
+    }
+
+    lwmsg_peer_call_queue_outgoing(pcall, input, output, complete, data);
+    lwmsg_task_wake(pcall->task->event_task);
 
     if (!complete)
     {
@@ -269,6 +291,77 @@ error:
     return status;
 }
 
+static
+LWMsgStatus
+lwmsg_peer_call_dispatch_batch_outgoing(
+    LWMsgCall** calls,
+    size_t count,
+    const LWMsgParams* input,
+    LWMsgParams* output,
+    LWMsgStatus* results,
+    LWMsgCompleteFunction complete,
+    void* data
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    PeerAssocTask* task = PEER_CALL(calls[0])->task;
+    PeerCall* pcall = NULL;
+    size_t i = 0;
+
+    for (i = 1; i < count; i++)
+    {
+        if (PEER_CALL(calls[i])->task != task)
+        {
+            return LWMSG_STATUS_INVALID_PARAMETER;
+        }
+    }
+
+    pthread_mutex_lock(&task->session->lock);
+
+    BAIL_ON_ERROR(status = task->status);
+
+    /* Are there enough cookie slots for the whole batch? */
+    if (lwmsg_hash_get_count(&task->outgoing_calls) + count > ((LWMsgCookie) -1) + 1)
+    {
+        BAIL_ON_ERROR(status = LWMSG_STATUS_BUSY);
+    }
+
+    /* Queue everything before waking the task once, so that
+       it sends the whole batch in one go */
+    for (i = 0; i < count; i++)
+    {
+        lwmsg_peer_call_queue_outgoing(PEER_CALL(calls[i]), &input[i], &output[i], complete, data);
+    }
+
+    lwmsg_task_wake(task->event_task);
+
+    if (!complete)
+    {
+        for (i = 0; i < count; i++)
+        {
+            pcall = PEER_CALL(calls[i]);
+            pcall->state |= PEER_CALL_WAITING;
+
+            while (!(pcall->state & PEER_CALL_COMPLETED))
+            {
+                pthread_cond_wait(&task->session->event, &task->session->lock);
+            }
+
+            results[i] = pcall->status;
+        }
+    }
+    else
+    {
+        status = LWMSG_STATUS_PENDING;
+    }
+
+error:
+
+    pthread_mutex_unlock(&task->session->lock);
+
+    return status;
+}
+
 static
 LWMsgStatus
 lwmsg_peer_call_pend_incoming(
@@ -529,6 +622,7 @@ static LWMsgCallClass peer_call_class =
 {
     .release = lwmsg_peer_call_release_outgoing,
     .dispatch = lwmsg_peer_call_dispatch_outgoing,
+    .dispatch_batch = lwmsg_peer_call_dispatch_batch_outgoing,
     .pend = lwmsg_peer_call_pend_incoming,
     .complete = lwmsg_peer_call_complete_incoming,
     .cancel = lwmsg_peer_call_cancel_outgoing,
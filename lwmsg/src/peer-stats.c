@@ -0,0 +1,581 @@
+/*
+ * Copyright (c) Likewise Software.  All rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the license, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.  You should have received a copy
+ * of the GNU Lesser General Public License along with this program.  If
+ * not, see <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * LESSER GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Module Name:
+ *
+ *        peer-stats.c
+ *
+ * Abstract:
+ *
+ *        Multi-threaded peer API (call statistics)
+ *
+ */
+
+#include <config.h>
+#include <time.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "peer-private.h"
+#include "protocol-private.h"
+#include "util-private.h"
+
+static LWMsgTypeSpec peer_tag_stats_spec[] =
+{
+    LWMSG_STRUCT_BEGIN(LWMsgPeerTagStats),
+    LWMSG_MEMBER_INT16(LWMsgPeerTagStats, tag),
+    LWMSG_MEMBER_PSTR(LWMsgPeerTagStats, name),
+    LWMSG_MEMBER_UINT64(LWMsgPeerTagStats, calls),
+    LWMSG_MEMBER_UINT64(LWMsgPeerTagStats, failures),
+    LWMSG_MEMBER_UINT32(LWMsgPeerTagStats, in_flight),
+    LWMSG_MEMBER_UINT64(LWMsgPeerTagStats, service_total),
+    LWMSG_MEMBER_UINT64(LWMsgPeerTagStats, service_max),
+    LWMSG_MEMBER_ARRAY_BEGIN(LWMsgPeerTagStats, queue_histogram),
+    LWMSG_UINT64(uint64_t),
+    LWMSG_ARRAY_END,
+    LWMSG_ATTR_LENGTH_STATIC(LWMSG_PEER_STATS_BUCKETS),
+    LWMSG_MEMBER_ARRAY_BEGIN(LWMsgPeerTagStats, service_histogram),
+    LWMSG_UINT64(uint64_t),
+    LWMSG_ARRAY_END,
+    LWMSG_ATTR_LENGTH_STATIC(LWMSG_PEER_STATS_BUCKETS),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec peer_slow_call_spec[] =
+{
+    LWMSG_STRUCT_BEGIN(LWMsgPeerSlowCall),
+    LWMSG_MEMBER_INT16(LWMsgPeerSlowCall, tag),
+    LWMSG_MEMBER_UINT32(LWMsgPeerSlowCall, status),
+    LWMSG_MEMBER_UINT64(LWMsgPeerSlowCall, time),
+    LWMSG_MEMBER_UINT64(LWMsgPeerSlowCall, queue_time),
+    LWMSG_MEMBER_UINT64(LWMsgPeerSlowCall, service_time),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec peer_thread_stats_spec[] =
+{
+    LWMSG_STRUCT_BEGIN(LWMsgPeerThreadStats),
+    LWMSG_MEMBER_UINT32(LWMsgPeerThreadStats, tasks),
+    LWMSG_MEMBER_UINT32(LWMsgPeerThreadStats, load),
+    LWMSG_MEMBER_UINT64(LWMsgPeerThreadStats, busy_time),
+    LWMSG_MEMBER_UINT64(LWMsgPeerThreadStats, runs),
+    LWMSG_MEMBER_UINT32(LWMsgPeerThreadStats, migrated_in),
+    LWMSG_MEMBER_UINT32(LWMsgPeerThreadStats, migrated_out),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec peer_stats_spec[] =
+{
+    LWMSG_STRUCT_BEGIN(LWMsgPeerStats),
+    LWMSG_MEMBER_UINT64(LWMsgPeerStats, uptime),
+    LWMSG_MEMBER_UINT32(LWMsgPeerStats, clients),
+    LWMSG_MEMBER_UINT32(LWMsgPeerStats, in_flight),
+    LWMSG_MEMBER_UINT64(LWMsgPeerStats, rejected),
+    LWMSG_MEMBER_UINT64(LWMsgPeerStats, slow_threshold),
+    LWMSG_MEMBER_UINT16(LWMsgPeerStats, tag_count),
+    LWMSG_MEMBER_POINTER(LWMsgPeerStats, tags, LWMSG_TYPESPEC(peer_tag_stats_spec)),
+    LWMSG_ATTR_LENGTH_MEMBER(LWMsgPeerStats, tag_count),
+    LWMSG_MEMBER_UINT16(LWMsgPeerStats, slow_call_count),
+    LWMSG_MEMBER_POINTER(LWMsgPeerStats, slow_calls, LWMSG_TYPESPEC(peer_slow_call_spec)),
+    LWMSG_ATTR_LENGTH_MEMBER(LWMsgPeerStats, slow_call_count),
+    LWMSG_MEMBER_UINT16(LWMsgPeerStats, thread_count),
+    LWMSG_MEMBER_POINTER(LWMsgPeerStats, threads, LWMSG_TYPESPEC(peer_thread_stats_spec)),
+    LWMSG_ATTR_LENGTH_MEMBER(LWMsgPeerStats, thread_count),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+/* Messages every peer understands regardless of its protocol */
+static LWMsgProtocolSpec peer_system_spec[] =
+{
+    LWMSG_MESSAGE(PEER_TAG_STATS_REQUEST, NULL),
+    LWMSG_MESSAGE(PEER_TAG_STATS_REPLY, peer_stats_spec),
+    LWMSG_PROTOCOL_END
+};
+
+uint64_t
+lwmsg_peer_stats_clock(
+    void
+    )
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static
+unsigned int
+lwmsg_peer_stats_bucket(
+    uint64_t usec
+    )
+{
+    unsigned int bucket = 0;
+
+    while (usec && bucket < LWMSG_PEER_STATS_BUCKETS - 1)
+    {
+        usec >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+LWMsgStatus
+lwmsg_peer_stats_init(
+    LWMsgPeer* peer
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+
+    BAIL_ON_ERROR(status = lwmsg_status_map_errno(pthread_mutex_init(&peer->stats.lock, NULL)));
+    peer->stats.lock_init = LWMSG_TRUE;
+
+    peer->stats.slow_threshold = 1000000;
+    peer->stats.start_time = lwmsg_peer_stats_clock();
+
+    if (peer->protocol)
+    {
+        lwmsg_protocol_set_system_spec(peer->protocol, peer_system_spec);
+    }
+
+error:
+
+    return status;
+}
+
+void
+lwmsg_peer_stats_destroy(
+    LWMsgPeer* peer
+    )
+{
+    if (peer->stats.lock_init)
+    {
+        pthread_mutex_destroy(&peer->stats.lock);
+    }
+
+    if (peer->stats.tags)
+    {
+        free(peer->stats.tags);
+    }
+}
+
+/*
+ * Grows the per-tag statistics along with the dispatch vector.
+ * Called with the peer lock held.
+ */
+LWMsgStatus
+lwmsg_peer_stats_resize(
+    LWMsgPeer* peer,
+    size_t tag_count
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgPeerTagStats* new_tags = NULL;
+    size_t old_count = peer->dispatch.vector_length;
+
+    pthread_mutex_lock(&peer->stats.lock);
+
+    new_tags = realloc(peer->stats.tags, sizeof(*new_tags) * tag_count);
+
+    if (!new_tags)
+    {
+        BAIL_ON_ERROR(status = LWMSG_STATUS_MEMORY);
+    }
+
+    memset(new_tags + old_count, 0, (tag_count - old_count) * sizeof(*new_tags));
+
+    peer->stats.tags = new_tags;
+
+error:
+
+    pthread_mutex_unlock(&peer->stats.lock);
+
+    return status;
+}
+
+void
+lwmsg_peer_stats_begin_call(
+    LWMsgPeer* peer,
+    PeerCall* call
+    )
+{
+    LWMsgTag tag = call->params.incoming.in.tag;
+
+    call->params.incoming.recv_time = lwmsg_peer_stats_clock();
+    call->params.incoming.start_time = call->params.incoming.recv_time;
+
+    pthread_mutex_lock(&peer->stats.lock);
+
+    peer->stats.in_flight++;
+
+    if (tag >= 0 && tag < peer->dispatch.vector_length)
+    {
+        peer->stats.tags[tag].in_flight++;
+    }
+
+    pthread_mutex_unlock(&peer->stats.lock);
+}
+
+void
+lwmsg_peer_stats_end_call(
+    LWMsgPeer* peer,
+    PeerCall* call
+    )
+{
+    LWMsgTag tag = call->params.incoming.in.tag;
+    LWMsgPeerTagStats* stats = NULL;
+    LWMsgPeerSlowCall* slow = NULL;
+    uint64_t now = 0;
+    uint64_t queue_time = 0;
+    uint64_t service_time = 0;
+    const char* name = NULL;
+
+    /* Calls rejected before dispatch were never counted as begun */
+    if (!call->params.incoming.recv_time)
+    {
+        return;
+    }
+
+    now = lwmsg_peer_stats_clock();
+    queue_time = call->params.incoming.start_time - call->params.incoming.recv_time;
+    service_time = now - call->params.incoming.start_time;
+
+    pthread_mutex_lock(&peer->stats.lock);
+
+    peer->stats.in_flight--;
+
+    if (tag >= 0 && tag < peer->dispatch.vector_length)
+    {
+        stats = &peer->stats.tags[tag];
+
+        stats->in_flight--;
+        stats->calls++;
+        if (call->status != LWMSG_STATUS_SUCCESS)
+        {
+            stats->failures++;
+        }
+        stats->service_total += service_time;
+        if (service_time > stats->service_max)
+        {
+            stats->service_max = service_time;
+        }
+        stats->queue_histogram[lwmsg_peer_stats_bucket(queue_time)]++;
+        stats->service_histogram[lwmsg_peer_stats_bucket(service_time)]++;
+    }
+
+    if (service_time < peer->stats.slow_threshold)
+    {
+        pthread_mutex_unlock(&peer->stats.lock);
+        goto done;
+    }
+
+    slow = &peer->stats.slow_calls[peer->stats.slow_next];
+    slow->tag = tag;
+    slow->status = call->status;
+    slow->time = (uint64_t) time(NULL);
+    slow->queue_time = queue_time;
+    slow->service_time = service_time;
+
+    peer->stats.slow_next = (peer->stats.slow_next + 1) % PEER_STATS_MAX_SLOW_CALLS;
+    if (peer->stats.slow_count < PEER_STATS_MAX_SLOW_CALLS)
+    {
+        peer->stats.slow_count++;
+    }
+
+    pthread_mutex_unlock(&peer->stats.lock);
+
+    if (lwmsg_protocol_get_message_name(peer->protocol, tag, &name))
+    {
+        name = "<unknown>";
+    }
+
+    LWMSG_LOG_INFO(
+        peer->context,
+        "Slow call %s: queued %llu us, serviced %llu us, status %s",
+        name,
+        (unsigned long long) queue_time,
+        (unsigned long long) service_time,
+        lwmsg_status_name(call->status));
+
+done:
+
+    return;
+}
+
+void
+lwmsg_peer_stats_reject_call(
+    LWMsgPeer* peer
+    )
+{
+    pthread_mutex_lock(&peer->stats.lock);
+    peer->stats.rejected++;
+    pthread_mutex_unlock(&peer->stats.lock);
+}
+
+LWMsgStatus
+lwmsg_peer_set_slow_call_threshold(
+    LWMsgPeer* peer,
+    LWMsgTime* threshold
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+
+    if (threshold->seconds < 0 || threshold->microseconds < 0)
+    {
+        PEER_RAISE_ERROR(peer->context, status = LWMSG_STATUS_INVALID_PARAMETER,
+                         "Negative slow call threshold");
+    }
+
+    pthread_mutex_lock(&peer->stats.lock);
+    peer->stats.slow_threshold =
+        (uint64_t) threshold->seconds * 1000000 + threshold->microseconds;
+    pthread_mutex_unlock(&peer->stats.lock);
+
+error:
+
+    return status;
+}
+
+static
+LWMsgStatus
+lwmsg_peer_get_thread_stats(
+    LWMsgPeer* peer,
+    LWMsgPeerStats* stats
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgTaskThreadStats* threads = NULL;
+    unsigned long count = 0;
+    unsigned long i = 0;
+
+    BAIL_ON_ERROR(status = lwmsg_task_query_thread_stats(peer->task_manager, &count, &threads));
+
+    if (count)
+    {
+        BAIL_ON_ERROR(status = LWMSG_CONTEXT_ALLOC_ARRAY(peer->context, count, &stats->threads));
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        stats->threads[i].tasks = threads[i].ulTasks;
+        stats->threads[i].load = threads[i].ulLoad;
+        stats->threads[i].busy_time = threads[i].ullBusyTime / 1000;
+        stats->threads[i].runs = threads[i].ullRunCount;
+        stats->threads[i].migrated_in = threads[i].ulMigratedIn;
+        stats->threads[i].migrated_out = threads[i].ulMigratedOut;
+    }
+
+    stats->thread_count = (uint16_t) count;
+
+error:
+
+    if (threads)
+    {
+        lwmsg_task_free_thread_stats(threads);
+    }
+
+    return status;
+}
+
+LWMsgStatus
+lwmsg_peer_get_stats(
+    LWMsgPeer* peer,
+    LWMsgPeerStats** stats
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgPeerStats* my_stats = NULL;
+    LWMsgPeerTagStats* tags = NULL;
+    const char* name = NULL;
+    size_t count = 0;
+    size_t i = 0;
+    size_t j = 0;
+    LWMsgBool locked = LWMSG_FALSE;
+
+    BAIL_ON_ERROR(status = LWMSG_CONTEXT_ALLOC(peer->context, &my_stats));
+
+    /* The dispatch vector does not change once the peer is running,
+       so it can be sized without holding the statistics lock */
+    for (i = 0; i < peer->dispatch.vector_length; i++)
+    {
+        if (peer->dispatch.vector[i])
+        {
+            count++;
+        }
+    }
+
+    if (count)
+    {
+        BAIL_ON_ERROR(status = LWMSG_CONTEXT_ALLOC_ARRAY(peer->context, count, &my_stats->tags));
+    }
+
+    BAIL_ON_ERROR(status = LWMSG_CONTEXT_ALLOC_ARRAY(
+                      peer->context,
+                      PEER_STATS_MAX_SLOW_CALLS,
+                      &my_stats->slow_calls));
+
+    pthread_mutex_lock(&peer->stats.lock);
+    locked = LWMSG_TRUE;
+
+    my_stats->uptime = (lwmsg_peer_stats_clock() - peer->stats.start_time) / 1000000;
+    my_stats->in_flight = peer->stats.in_flight;
+    my_stats->rejected = peer->stats.rejected;
+    my_stats->slow_threshold = peer->stats.slow_threshold;
+
+    for (i = 0, j = 0; i < peer->dispatch.vector_length; i++)
+    {
+        if (peer->dispatch.vector[i])
+        {
+            my_stats->tags[j] = peer->stats.tags[i];
+            my_stats->tags[j].tag = (LWMsgTag) i;
+            my_stats->tags[j].name = NULL;
+            j++;
+        }
+    }
+    my_stats->tag_count = (uint16_t) j;
+
+    /* Copy slow calls oldest first */
+    for (i = 0; i < peer->stats.slow_count; i++)
+    {
+        j = (peer->stats.slow_next + PEER_STATS_MAX_SLOW_CALLS - peer->stats.slow_count + i) %
+            PEER_STATS_MAX_SLOW_CALLS;
+        my_stats->slow_calls[i] = peer->stats.slow_calls[j];
+    }
+    my_stats->slow_call_count = (uint16_t) peer->stats.slow_count;
+
+    pthread_mutex_unlock(&peer->stats.lock);
+    locked = LWMSG_FALSE;
+
+    my_stats->clients = (uint32_t) lwmsg_peer_get_num_clients(peer);
+
+    BAIL_ON_ERROR(status = lwmsg_peer_get_thread_stats(peer, my_stats));
+
+    tags = my_stats->tags;
+    for (i = 0; i < my_stats->tag_count; i++)
+    {
+        if (lwmsg_protocol_get_message_name(peer->protocol, tags[i].tag, &name) == LWMSG_STATUS_SUCCESS)
+        {
+            BAIL_ON_ERROR(status = lwmsg_strdup(peer->context, name, &tags[i].name));
+        }
+    }
+
+    *stats = my_stats;
+
+done:
+
+    return status;
+
+error:
+
+    if (locked)
+    {
+        pthread_mutex_unlock(&peer->stats.lock);
+    }
+
+    if (my_stats)
+    {
+        lwmsg_peer_free_stats(peer, my_stats);
+    }
+
+    goto done;
+}
+
+/*
+ * Answers a built-in statistics request.  Called in place of
+ * a dispatch function with the session lock held.  Statistics
+ * describe every client's calls, so only root and the user the
+ * server runs as may see them.
+ */
+LWMsgStatus
+lwmsg_peer_stats_dispatch(
+    PeerCall* call
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgPeerStats* stats = NULL;
+    LWMsgSecurityToken* token = call->task->session->sec_token;
+    uid_t euid = (uid_t) -1;
+
+    if (!token ||
+        lwmsg_local_token_get_eid(token, &euid, NULL) ||
+        (euid != 0 && euid != geteuid()))
+    {
+        BAIL_ON_ERROR(status = LWMSG_STATUS_SECURITY);
+    }
+
+    BAIL_ON_ERROR(status = lwmsg_peer_get_stats(call->task->session->peer, &stats));
+
+    call->params.incoming.out.tag = PEER_TAG_STATS_REPLY;
+    call->params.incoming.out.data = stats;
+
+error:
+
+    return status;
+}
+
+LWMsgStatus
+lwmsg_peer_query_stats(
+    LWMsgCall* call,
+    LWMsgPeerStats** stats
+    )
+{
+    LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgParams in = LWMSG_PARAMS_INITIALIZER;
+    LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
+
+    in.tag = PEER_TAG_STATS_REQUEST;
+
+    BAIL_ON_ERROR(status = lwmsg_call_dispatch(call, &in, &out, NULL, NULL));
+
+    if (out.tag != PEER_TAG_STATS_REPLY)
+    {
+        lwmsg_call_destroy_params(call, &out);
+        BAIL_ON_ERROR(status = LWMSG_STATUS_MALFORMED);
+    }
+
+    *stats = out.data;
+
+error:
+
+    return status;
+}
+
+void
+lwmsg_peer_free_stats(
+    LWMsgPeer* peer,
+    LWMsgPeerStats* stats
+    )
+{
+    if (stats)
+    {
+        lwmsg_data_free_graph_cleanup(peer->context, peer_stats_spec, stats);
+    }
+}
@@ -1135,9 +1135,20 @@ lwmsg_peer_task_dispatch_incoming_message(
         goto error;
     }
 
+    /* Answer statistics requests without consulting the dispatch vector */
+    if (tag == PEER_TAG_STATS_REQUEST)
+    {
+        lwmsg_assoc_destroy_message(task->assoc, &task->incoming_message);
+        call->status = lwmsg_peer_stats_dispatch(call);
+        call->state = PEER_CALL_DISPATCHED | PEER_CALL_COMPLETED;
+        lwmsg_ring_enqueue(&task->active_incoming_calls, &call->queue_ring);
+        goto error;
+    }
+
     /* Make sure the tag is within the bounds of the dispatch vector */
     if (tag < 0 || tag >= peer->dispatch.vector_length)
     {
+        lwmsg_peer_stats_reject_call(peer);
         status = lwmsg_peer_task_handle_call_error(
             task,
             call,
@@ -1150,6 +1161,7 @@ lwmsg_peer_task_dispatch_incoming_message(
     spec = peer->dispatch.vector[tag];
     if (spec == NULL)
     {
+        lwmsg_peer_stats_reject_call(peer);
         status = lwmsg_peer_task_handle_call_error(
             task,
             call,
@@ -1307,7 +1319,7 @@ lwmsg_peer_task_finish_transceive(
     LWMsgMessage* message = NULL;
 
     while ((!task->recv_blocked && task->incoming) ||
-           (!task->send_blocked && task->outgoing))
+           (!task->send_blocked && (task->outgoing || task->unflushed)))
     {
         status = lwmsg_assoc_finish(task->assoc, &message);
         switch (status)
@@ -1329,6 +1341,11 @@ lwmsg_peer_task_finish_transceive(
                     task->destroy_outgoing = LWMSG_FALSE;
                 }
             }
+            else if (!message)
+            {
+                /* Coalesced sends have been flushed */
+                task->unflushed = LWMSG_FALSE;
+            }
             break;
         case LWMSG_STATUS_PENDING:
             lwmsg_peer_task_update_blocked(task);
@@ -1442,6 +1459,8 @@ lwmsg_peer_task_dispatch_calls(
         if ((call->state & PEER_CALL_COMPLETED) &&
             (call->state & PEER_CALL_DISPATCHED))
         {
+            lwmsg_peer_stats_end_call(call->task->session->peer, call);
+
             /* Trace call completion */
             if (call->task->session->peer->trace_end)
             {
@@ -1530,7 +1549,9 @@ lwmsg_peer_task_run_dispatch(
     LWMsgStatus finish_status = LWMSG_STATUS_PENDING;
     LWMsgStatus recv_status = LWMSG_STATUS_PENDING;
     LWMsgStatus send_status = LWMSG_STATUS_PENDING;
+    LWMsgStatus flush_status = LWMSG_STATUS_PENDING;
     LWMsgTime* timeout = NULL;
+    unsigned int received = 0;
 
     pthread_mutex_lock(&task->session->lock);
 
@@ -1562,29 +1583,41 @@ lwmsg_peer_task_run_dispatch(
             BAIL_ON_ERROR(status = finish_status);
         }
 
-        /* Try to receive and dispatch the next message */
-        if (!task->incoming && !task->recv_blocked)
+        /* Try to receive and dispatch the messages that are ready,
+           so that the replies to them can be sent together */
+        while (!task->incoming && !task->recv_blocked && received < PEER_TASK_MAX_RECV_BATCH)
         {
             recv_status = lwmsg_assoc_recv_message(task->assoc, &task->incoming_message);
             
             switch (recv_status)
             {
             case LWMSG_STATUS_SUCCESS:
+                received++;
                 task->recv_partial = LWMSG_FALSE;
                 BAIL_ON_ERROR(status = lwmsg_peer_task_dispatch_incoming_message(task));
                 break;
             case LWMSG_STATUS_PENDING:
                 task->incoming = LWMSG_TRUE;
+                lwmsg_peer_task_update_blocked(task);
                 break;
             default:
                 BAIL_ON_ERROR(status = recv_status);
             }
         }
 
-        /* Try to send any outgoing call requests or incoming call replies */
-        if (!task->outgoing && !task->send_blocked)
+        if (received)
+        {
+            recv_status = LWMSG_STATUS_SUCCESS;
+        }
+
+        /* Try to send any outgoing call requests or incoming call replies.
+           The association is corked meanwhile so that they are coalesced
+           into as few writes as possible, then flushed */
+        if (!task->outgoing && !task->unflushed && !task->send_blocked)
         {           
+            BAIL_ON_ERROR(status = lwmsg_assoc_set_cork(task->assoc, LWMSG_TRUE));
             send_status = lwmsg_peer_task_dispatch_calls(task);
+            BAIL_ON_ERROR(status = lwmsg_assoc_set_cork(task->assoc, LWMSG_FALSE));
             switch (send_status)
             {
             case LWMSG_STATUS_SUCCESS:
@@ -1593,6 +1626,26 @@ lwmsg_peer_task_run_dispatch(
             default:
                 BAIL_ON_ERROR(status = send_status);
             }
+
+            switch (lwmsg_assoc_get_state(task->assoc))
+            {
+            case LWMSG_ASSOC_STATE_BLOCKED_SEND:
+            case LWMSG_ASSOC_STATE_BLOCKED_SEND_RECV:
+                task->unflushed = !task->outgoing;
+                break;
+            default:
+                break;
+            }
+
+            flush_status = lwmsg_peer_task_finish_transceive(peer, task);
+            switch (flush_status)
+            {
+            case LWMSG_STATUS_SUCCESS:
+            case LWMSG_STATUS_PENDING:
+                break;
+            default:
+                BAIL_ON_ERROR(status = flush_status);
+            }
         }
 
         /* If we could not make any progress finishing pended I/O,
@@ -1602,7 +1655,7 @@ lwmsg_peer_task_run_dispatch(
             send_status == LWMSG_STATUS_PENDING &&
             recv_status == LWMSG_STATUS_PENDING)
         {
-            if ((!task->incoming || !task->recv_partial) && !task->outgoing)
+            if ((!task->incoming || !task->recv_partial) && !task->outgoing && !task->unflushed)
             {
                 timeout = &peer->timeout.idle;
             }
@@ -102,6 +102,8 @@ lwmsg_peer_new(
     peer->max_backlog = 8;
     peer->protocol = protocol;
 
+    BAIL_ON_ERROR(status = lwmsg_peer_stats_init(peer));
+
     *out_peer = peer;
 
 done:
@@ -186,6 +188,8 @@ lwmsg_peer_delete(
         free(peer->dispatch.vector);
     }
 
+    lwmsg_peer_stats_destroy(peer);
+
     lwmsg_peer_destroy_endpoint_list(&peer->connect_endpoints);
     lwmsg_peer_destroy_endpoint_list(&peer->listen_endpoints);
 
@@ -330,8 +334,11 @@ lwmsg_peer_add_dispatch_spec(
         memset(new_vector + peer->dispatch.vector_length, 0, 
                (max_message_tag + 1 - peer->dispatch.vector_length) * sizeof(*new_vector));
 
-        peer->dispatch.vector_length = max_message_tag + 1;
         peer->dispatch.vector = new_vector;
+
+        BAIL_ON_ERROR(status = lwmsg_peer_stats_resize(peer, max_message_tag + 1));
+
+        peer->dispatch.vector_length = max_message_tag + 1;
     }
 
     for (i = 0; table[i].type != LWMSG_DISPATCH_TYPE_END; i++)
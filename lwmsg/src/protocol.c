@@ -107,12 +107,52 @@ error:
 void
 lwmsg_protocol_delete(LWMsgProtocol* prot)
 {
+    size_t i;
+
+    for (i = 0; i < prot->num_rep_types; i++)
+    {
+        lwmsg_data_forget_type(prot->rep_types[i]);
+    }
+
     lwmsg_memlist_destroy(&prot->specmem);
     
+    free(prot->rep_types);
     free(prot->types);
     free(prot);
 }
 
+static
+LWMsgProtocolSpec*
+lwmsg_protocol_find_system(
+    LWMsgProtocol* prot,
+    LWMsgTag tag
+    )
+{
+    size_t i = 0;
+
+    if (prot->system_spec)
+    {
+        for (i = 0; prot->system_spec[i].tag != -1; i++)
+        {
+            if ((LWMsgTag) prot->system_spec[i].tag == tag)
+            {
+                return &prot->system_spec[i];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+void
+lwmsg_protocol_set_system_spec(
+    LWMsgProtocol* prot,
+    LWMsgProtocolSpec* spec
+    )
+{
+    prot->system_spec = spec;
+}
+
 LWMsgStatus
 lwmsg_protocol_get_message_type(
     LWMsgProtocol* prot,
@@ -120,6 +160,14 @@ lwmsg_protocol_get_message_type(
     LWMsgTypeSpec** out_type)
 {
     LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgProtocolSpec* system = NULL;
+
+    if (tag < LWMSG_TAG_INVALID &&
+        (system = lwmsg_protocol_find_system(prot, tag)))
+    {
+        *out_type = system->type;
+        goto error;
+    }
 
     if (tag >= prot->num_types)
     {
@@ -141,6 +189,14 @@ lwmsg_protocol_get_message_name(
     )
 {
     LWMsgStatus status = LWMSG_STATUS_SUCCESS;
+    LWMsgProtocolSpec* system = NULL;
+
+    if (tag < LWMSG_TAG_INVALID &&
+        (system = lwmsg_protocol_find_system(prot, tag)))
+    {
+        *name = system->tag_name;
+        goto error;
+    }
 
     if (tag >= prot->num_types)
     {
@@ -270,6 +326,7 @@ lwmsg_protocol_add_protocol_rep(
     struct LWMsgProtocolSpec *spec = NULL;
     LWMsgTypeSpec* existing_type = NULL;
     LWMsgTypeRep* existing_rep = NULL;
+    LWMsgTypeSpec** rep_types = NULL;
     size_t i = 0;
     size_t next = 0;
 
@@ -283,13 +340,28 @@ lwmsg_protocol_add_protocol_rep(
         if (status == LWMSG_STATUS_NOT_FOUND)
         {
             /* Unknown tag -- convert type rep to a spec for addition to the protocol */
-            BAIL_ON_ERROR(status = lwmsg_type_spec_from_rep_internal(
-                              &specmap,
-                              rep->messages[i].type,
-                              &buffer));
-            
             spec[next].tag = rep->messages[i].tag;
-            spec[next].type = buffer->buffer;
+            spec[next].type = NULL;
+
+            if (rep->messages[i].type)
+            {
+                BAIL_ON_ERROR(status = lwmsg_type_spec_from_rep_internal(
+                                  &specmap,
+                                  rep->messages[i].type,
+                                  &buffer));
+                spec[next].type = buffer->buffer;
+
+                rep_types = realloc(
+                    prot->rep_types,
+                    sizeof(*rep_types) * (prot->num_rep_types + 1));
+                if (!rep_types)
+                {
+                    BAIL_ON_ERROR(status = LWMSG_STATUS_MEMORY);
+                }
+                prot->rep_types = rep_types;
+                prot->rep_types[prot->num_rep_types++] = buffer->buffer;
+            }
+
             BAIL_ON_ERROR(status = lwmsg_strdup(
                               specmap.context,
                               rep->messages[i].name,
@@ -300,7 +372,17 @@ lwmsg_protocol_add_protocol_rep(
         {
             BAIL_ON_ERROR(status);
             /* Known tag -- check for assignability with existing type */
-            
+
+            if (!existing_type || !rep->messages[i].type)
+            {
+                /* A message without a payload only matches another one */
+                if (existing_type || rep->messages[i].type)
+                {
+                    BAIL_ON_ERROR(status = LWMSG_STATUS_MALFORMED);
+                }
+                continue;
+            }
+
             BAIL_ON_ERROR(status = lwmsg_type_rep_from_spec(
                               prot->context,
                               existing_type,
@@ -356,7 +438,17 @@ lwmsg_protocol_is_protocol_rep_compatible(
         {
             BAIL_ON_ERROR(status);
             /* Known tag -- check for assignability with existing type */
-            
+
+            if (!existing_type || !rep->messages[i].type)
+            {
+                /* A message without a payload only matches another one */
+                if (existing_type || rep->messages[i].type)
+                {
+                    BAIL_ON_ERROR(status = LWMSG_STATUS_MALFORMED);
+                }
+                continue;
+            }
+
             BAIL_ON_ERROR(status = lwmsg_type_rep_from_spec(
                               prot->context,
                               existing_type,
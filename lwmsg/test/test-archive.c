@@ -40,6 +40,9 @@
 #include <lwmsg/lwmsg.h>
 #include <moonunit/interface.h>
 #include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "test-private.h"
 
@@ -52,7 +55,8 @@ typedef struct message_struct
 typedef enum message_tag
 {
     MESSAGE_NORMAL,
-    MESSAGE_EXTRA
+    MESSAGE_EXTRA,
+    MESSAGE_EMPTY
 } message_tag;
 
 static LWMsgTypeSpec message_struct_spec[] =
@@ -77,8 +81,16 @@ static LWMsgProtocolSpec archive_extra_spec[] =
     LWMSG_PROTOCOL_END
 };
 
+static LWMsgProtocolSpec archive_empty_spec[] =
+{
+    LWMSG_MESSAGE(MESSAGE_NORMAL, message_struct_spec),
+    LWMSG_MESSAGE(MESSAGE_EMPTY, NULL),
+    LWMSG_PROTOCOL_END
+};
+
 static LWMsgProtocol* archive_protocol = NULL;
 static LWMsgProtocol* archive_extra_protocol = NULL;
+static LWMsgProtocol* archive_empty_protocol = NULL;
 static LWMsgDataContext* dcontext = NULL;
 
 MU_FIXTURE_SETUP(archive)
@@ -87,6 +99,8 @@ MU_FIXTURE_SETUP(archive)
     MU_TRY(lwmsg_protocol_add_protocol_spec(archive_protocol, archive_spec));
     MU_TRY(lwmsg_protocol_new(NULL, &archive_extra_protocol));
     MU_TRY(lwmsg_protocol_add_protocol_spec(archive_extra_protocol, archive_extra_spec));
+    MU_TRY(lwmsg_protocol_new(NULL, &archive_empty_protocol));
+    MU_TRY(lwmsg_protocol_add_protocol_spec(archive_empty_protocol, archive_empty_spec));
     MU_TRY(lwmsg_data_context_new(NULL, &dcontext));
 }
 
@@ -312,3 +326,205 @@ MU_TEST(archive, write_extra_schema_read_schema_check_fails)
     lwmsg_archive_delete(archive);
 }
 
+MU_TEST(archive, write_empty_schema_read_schema)
+{
+    LWMsgArchive* archive = NULL;
+    LWMsgMessage in = LWMSG_MESSAGE_INITIALIZER;
+    LWMsgMessage out = LWMSG_MESSAGE_INITIALIZER;
+
+    in.tag = MESSAGE_EMPTY;
+
+    MU_TRY(lwmsg_archive_new(NULL, archive_empty_protocol, &archive));
+
+    /* Open, write message with no payload, close, delete */
+    MU_TRY(lwmsg_archive_set_file(archive, TEST_ARCHIVE, 0600));
+    MU_TRY(lwmsg_archive_open(archive, LWMSG_ARCHIVE_WRITE | LWMSG_ARCHIVE_SCHEMA));
+    MU_TRY(lwmsg_archive_write_message(archive, &in));
+    MU_TRY(lwmsg_archive_close(archive));
+    lwmsg_archive_delete(archive);
+
+    /* Read back with the schema checked against the same protocol */
+    MU_TRY(lwmsg_archive_new(NULL, archive_empty_protocol, &archive));
+    MU_TRY(lwmsg_archive_set_file(archive, TEST_ARCHIVE, 0));
+    MU_TRY(lwmsg_archive_open(archive, LWMSG_ARCHIVE_READ | LWMSG_ARCHIVE_SCHEMA));
+    MU_TRY(lwmsg_archive_read_message(archive, &out));
+    MU_TRY(lwmsg_archive_close(archive));
+
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, out.tag, MESSAGE_EMPTY);
+    MU_ASSERT(out.data == NULL);
+
+    MU_TRY(lwmsg_archive_destroy_message(archive, &out));
+    lwmsg_archive_delete(archive);
+
+    /* Read back into a protocol that learns the message from the schema */
+    MU_TRY(lwmsg_archive_new(NULL, archive_protocol, &archive));
+    lwmsg_archive_set_protocol_update(archive, LWMSG_TRUE);
+    MU_TRY(lwmsg_archive_set_file(archive, TEST_ARCHIVE, 0));
+    MU_TRY(lwmsg_archive_open(archive, LWMSG_ARCHIVE_READ | LWMSG_ARCHIVE_SCHEMA));
+    MU_TRY(lwmsg_archive_read_message(archive, &out));
+    MU_TRY(lwmsg_archive_close(archive));
+
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, out.tag, MESSAGE_EMPTY);
+    MU_ASSERT(out.data == NULL);
+
+    MU_TRY(lwmsg_archive_destroy_message(archive, &out));
+    lwmsg_archive_delete(archive);
+}
+
+#define READ_MESSAGE_COUNT 5000
+
+MU_TEST(archive, write_schema_read_many)
+{
+    LWMsgArchive* archive = NULL;
+    message_struct payload;
+    message_struct* result = NULL;
+    LWMsgMessage in = LWMSG_MESSAGE_INITIALIZER;
+    LWMsgMessage out = LWMSG_MESSAGE_INITIALIZER;
+    char string[32];
+    int i = 0;
+
+    unlink(TEST_ARCHIVE);
+
+    MU_TRY(lwmsg_archive_new(NULL, archive_protocol, &archive));
+    MU_TRY(lwmsg_archive_set_file(archive, TEST_ARCHIVE, 0600));
+    MU_TRY(lwmsg_archive_open(archive, LWMSG_ARCHIVE_WRITE | LWMSG_ARCHIVE_SCHEMA));
+
+    for (i = 0; i < READ_MESSAGE_COUNT; i++)
+    {
+        snprintf(string, sizeof(string), "Message %i", i);
+        payload.number = i;
+        payload.string = string;
+        in.tag = MESSAGE_NORMAL;
+        in.data = &payload;
+
+        MU_TRY(lwmsg_archive_write_message(archive, &in));
+    }
+
+    MU_TRY(lwmsg_archive_close(archive));
+
+    /*
+     * Read back without checking the schema, which seeks over it, so
+     * the messages span several refills of the read-ahead buffer
+     */
+    MU_TRY(lwmsg_archive_open(archive, LWMSG_ARCHIVE_READ));
+
+    for (i = 0; i < READ_MESSAGE_COUNT; i++)
+    {
+        MU_TRY(lwmsg_archive_read_message(archive, &out));
+
+        snprintf(string, sizeof(string), "Message %i", i);
+        MU_ASSERT_EQUAL(MU_TYPE_INTEGER, out.tag, MESSAGE_NORMAL);
+        result = out.data;
+        MU_ASSERT_EQUAL(MU_TYPE_INTEGER, result->number, i);
+        MU_ASSERT_EQUAL(MU_TYPE_STRING, result->string, string);
+
+        MU_TRY(lwmsg_archive_destroy_message(archive, &out));
+    }
+
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, lwmsg_archive_read_message(archive, &out), LWMSG_STATUS_EOF);
+    MU_TRY(lwmsg_archive_close(archive));
+    lwmsg_archive_delete(archive);
+}
+
+#define MAP_MESSAGE_COUNT 1000
+
+MU_TEST(archive, write_read_map)
+{
+    LWMsgArchive* archive = NULL;
+    message_struct payload;
+    message_struct* first = NULL;
+    message_struct* result = NULL;
+    LWMsgMessage in = LWMSG_MESSAGE_INITIALIZER;
+    LWMsgMessage out = LWMSG_MESSAGE_INITIALIZER;
+    LWMsgMessage held = LWMSG_MESSAGE_INITIALIZER;
+    char string[32];
+    int i = 0;
+
+    unlink(TEST_ARCHIVE);
+
+    MU_TRY(lwmsg_archive_new(NULL, archive_protocol, &archive));
+    MU_TRY(lwmsg_archive_set_file(archive, TEST_ARCHIVE, 0600));
+    MU_TRY(lwmsg_archive_open(archive, LWMSG_ARCHIVE_WRITE));
+
+    for (i = 0; i < MAP_MESSAGE_COUNT; i++)
+    {
+        snprintf(string, sizeof(string), "Message %i", i);
+        payload.number = i;
+        payload.string = string;
+        in.tag = MESSAGE_NORMAL;
+        in.data = &payload;
+
+        MU_TRY(lwmsg_archive_write_message(archive, &in));
+    }
+
+    MU_TRY(lwmsg_archive_close(archive));
+
+    /* Mapping is only meaningful for reading */
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER,
+                    lwmsg_archive_open(archive, LWMSG_ARCHIVE_WRITE | LWMSG_ARCHIVE_MAP),
+                    LWMSG_STATUS_INVALID_PARAMETER);
+
+    MU_TRY(lwmsg_archive_open(archive, LWMSG_ARCHIVE_READ | LWMSG_ARCHIVE_MAP));
+
+    /* Keep the first message around while the rest are read */
+    MU_TRY(lwmsg_archive_read_message(archive, &held));
+    first = held.data;
+
+    for (i = 1; i < MAP_MESSAGE_COUNT; i++)
+    {
+        MU_TRY(lwmsg_archive_read_message(archive, &out));
+
+        snprintf(string, sizeof(string), "Message %i", i);
+        MU_ASSERT_EQUAL(MU_TYPE_INTEGER, out.tag, MESSAGE_NORMAL);
+        result = out.data;
+        MU_ASSERT_EQUAL(MU_TYPE_INTEGER, result->number, i);
+        MU_ASSERT_EQUAL(MU_TYPE_STRING, result->string, string);
+
+        MU_TRY(lwmsg_archive_destroy_message(archive, &out));
+    }
+
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, lwmsg_archive_read_message(archive, &out), LWMSG_STATUS_EOF);
+    MU_TRY(lwmsg_archive_close(archive));
+
+    /* Messages outlive the mapping */
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, first->number, 0);
+    MU_ASSERT_EQUAL(MU_TYPE_STRING, first->string, "Message 0");
+
+    MU_TRY(lwmsg_archive_destroy_message(archive, &held));
+    lwmsg_archive_delete(archive);
+}
+
+MU_TEST(archive, read_map_truncated)
+{
+    LWMsgArchive* archive = NULL;
+    message_struct payload;
+    LWMsgMessage in = LWMSG_MESSAGE_INITIALIZER;
+    LWMsgMessage out = LWMSG_MESSAGE_INITIALIZER;
+    struct stat statbuf;
+
+    payload.number = 42;
+    payload.string = (char*) "Hello, world!";
+    in.tag = MESSAGE_NORMAL;
+    in.data = &payload;
+
+    unlink(TEST_ARCHIVE);
+
+    MU_TRY(lwmsg_archive_new(NULL, archive_protocol, &archive));
+    MU_TRY(lwmsg_archive_set_file(archive, TEST_ARCHIVE, 0600));
+    MU_TRY(lwmsg_archive_open(archive, LWMSG_ARCHIVE_WRITE));
+    MU_TRY(lwmsg_archive_write_message(archive, &in));
+    MU_TRY(lwmsg_archive_write_message(archive, &in));
+    MU_TRY(lwmsg_archive_close(archive));
+
+    /* Cut the second message short */
+    MU_ASSERT(stat(TEST_ARCHIVE, &statbuf) == 0);
+    MU_ASSERT(truncate(TEST_ARCHIVE, statbuf.st_size - 1) == 0);
+
+    MU_TRY(lwmsg_archive_open(archive, LWMSG_ARCHIVE_READ | LWMSG_ARCHIVE_MAP));
+    MU_TRY(lwmsg_archive_read_message(archive, &out));
+    MU_TRY(lwmsg_archive_destroy_message(archive, &out));
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, lwmsg_archive_read_message(archive, &out), LWMSG_STATUS_MALFORMED);
+    MU_TRY(lwmsg_archive_close(archive));
+
+    lwmsg_archive_delete(archive);
+}
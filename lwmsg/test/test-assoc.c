@@ -45,6 +45,7 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -1235,6 +1236,383 @@ MU_TEST(assoc, fd_send_recv)
     }
 }
 
+typedef struct BulkRequest
+{
+    uint32_t small_length;
+    unsigned char* small;
+    uint32_t large_length;
+    unsigned char* large;
+} BulkRequest;
+
+typedef struct BulkReply
+{
+    uint32_t length;
+    unsigned char* data;
+} BulkReply;
+
+typedef enum BulkType
+{
+    BULK_REQUEST = 1,
+    BULK_REPLY = 2
+} BulkType;
+
+#define BULK_SMALL_LENGTH 100
+#define BULK_LARGE_LENGTH (1024 * 1024 + 3)
+
+static LWMsgTypeSpec BulkRequest_spec[] =
+{
+    LWMSG_STRUCT_BEGIN(BulkRequest),
+    LWMSG_MEMBER_UINT32(BulkRequest, small_length),
+    LWMSG_MEMBER_SHARED_BUFFER(BulkRequest, small, small_length),
+    LWMSG_MEMBER_UINT32(BulkRequest, large_length),
+    LWMSG_MEMBER_SHARED_BUFFER(BulkRequest, large, large_length),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec BulkReply_spec[] =
+{
+    LWMSG_STRUCT_BEGIN(BulkReply),
+    LWMSG_MEMBER_UINT32(BulkReply, length),
+    LWMSG_MEMBER_SHARED_BUFFER(BulkReply, data, length),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgProtocolSpec BulkProtocol_spec[] =
+{
+    LWMSG_MESSAGE(BULK_REQUEST, BulkRequest_spec),
+    LWMSG_MESSAGE(BULK_REPLY, BulkReply_spec),
+    LWMSG_PROTOCOL_END
+};
+
+static void
+bulk_fill(unsigned char* data, size_t length, unsigned char seed)
+{
+    size_t i = 0;
+
+    for (i = 0; i < length; i++)
+    {
+        data[i] = (unsigned char) (i * 7 + seed);
+    }
+}
+
+static void
+bulk_check(unsigned char* data, size_t length, unsigned char seed)
+{
+    size_t i = 0;
+
+    for (i = 0; i < length; i++)
+    {
+        if (data[i] != (unsigned char) (i * 7 + seed))
+        {
+            MU_FAILURE("byte %lu differs", (unsigned long) i);
+        }
+    }
+}
+
+static void*
+bulk_sender(void* _assoc)
+{
+    LWMsgAssoc* assoc = (LWMsgAssoc*) _assoc;
+    LWMsgMessage request_msg = LWMSG_MESSAGE_INITIALIZER;
+    LWMsgMessage reply_msg = LWMSG_MESSAGE_INITIALIZER;
+    BulkRequest request = {0};
+    BulkReply* reply = NULL;
+    unsigned char small[BULK_SMALL_LENGTH];
+    unsigned char* large = malloc(BULK_LARGE_LENGTH);
+
+    MU_ASSERT(large != NULL);
+
+    bulk_fill(small, sizeof(small), 1);
+    bulk_fill(large, BULK_LARGE_LENGTH, 2);
+
+    request.small_length = sizeof(small);
+    request.small = small;
+    request.large_length = BULK_LARGE_LENGTH;
+    request.large = large;
+
+    MU_TRY_ASSOC(assoc, lwmsg_assoc_connect(assoc, NULL));
+
+    request_msg.tag = BULK_REQUEST;
+    request_msg.data = &request;
+
+    MU_TRY_ASSOC(assoc, lwmsg_assoc_send_message(assoc, &request_msg));
+    MU_TRY_ASSOC(assoc, lwmsg_assoc_recv_message(assoc, &reply_msg));
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, reply_msg.tag, BULK_REPLY);
+
+    reply = reply_msg.data;
+
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, reply->length, BULK_LARGE_LENGTH);
+    bulk_check(reply->data, reply->length, 3);
+
+    lwmsg_assoc_destroy_message(assoc, &reply_msg);
+    MU_TRY_ASSOC(assoc, lwmsg_assoc_close(assoc));
+    lwmsg_assoc_delete(assoc);
+
+    free(large);
+
+    return NULL;
+}
+
+static void*
+bulk_receiver(void* _assoc)
+{
+    LWMsgAssoc* assoc = (LWMsgAssoc*) _assoc;
+    LWMsgMessage request_msg = LWMSG_MESSAGE_INITIALIZER;
+    LWMsgMessage reply_msg = LWMSG_MESSAGE_INITIALIZER;
+    BulkRequest* request = NULL;
+    BulkReply reply;
+
+    MU_TRY_ASSOC(assoc, lwmsg_assoc_accept(assoc, NULL));
+
+    MU_TRY_ASSOC(assoc, lwmsg_assoc_recv_message(assoc, &request_msg));
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, request_msg.tag, BULK_REQUEST);
+    request = request_msg.data;
+
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, request->small_length, BULK_SMALL_LENGTH);
+    bulk_check(request->small, request->small_length, 1);
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, request->large_length, BULK_LARGE_LENGTH);
+    bulk_check(request->large, request->large_length, 2);
+
+    /* Send back a modified copy of the large buffer */
+    bulk_fill(request->large, request->large_length, 3);
+
+    reply.length = request->large_length;
+    reply.data = request->large;
+    reply_msg.tag = BULK_REPLY;
+    reply_msg.data = &reply;
+
+    MU_TRY_ASSOC(assoc, lwmsg_assoc_send_message(assoc, &reply_msg));
+
+    lwmsg_assoc_destroy_message(assoc, &request_msg);
+
+    MU_TRY_ASSOC(assoc, lwmsg_assoc_close(assoc));
+    lwmsg_assoc_delete(assoc);
+
+    return NULL;
+}
+
+MU_TEST(assoc, shared_buffer_send_recv)
+{
+    int err = 0;
+    int sockets[2];
+    LWMsgAssoc* send_assoc = NULL;
+    LWMsgAssoc* recv_assoc = NULL;
+    pthread_t sender;
+    pthread_t receiver;
+    LWMsgProtocol* bulk_protocol = NULL;
+
+    MU_TRY(lwmsg_protocol_new(NULL, &bulk_protocol));
+    MU_TRY_PROTOCOL(bulk_protocol, lwmsg_protocol_add_protocol_spec(bulk_protocol, BulkProtocol_spec));
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets))
+    {
+        MU_FAILURE("socketpair(): %s", strerror(errno));
+    }
+
+    MU_TRY(lwmsg_connection_new(NULL,
+               bulk_protocol,
+               &send_assoc));
+
+    MU_TRY(lwmsg_connection_set_fd(
+               send_assoc,
+               LWMSG_CONNECTION_MODE_PAIR,
+               sockets[0]));
+
+    MU_TRY(lwmsg_connection_new(NULL,
+               bulk_protocol,
+               &recv_assoc));
+
+    MU_TRY(lwmsg_connection_set_fd(
+               recv_assoc,
+               LWMSG_CONNECTION_MODE_PAIR,
+               sockets[1]));
+
+    if ((err = pthread_create(&sender, NULL, bulk_sender, send_assoc)))
+    {
+        MU_FAILURE("pthread_create(): %s", strerror(err));
+    }
+
+    if ((err = pthread_create(&receiver, NULL, bulk_receiver, recv_assoc)))
+    {
+        MU_FAILURE("pthread_create(): %s", strerror(err));
+    }
+
+    if ((err = pthread_join(sender, NULL)))
+    {
+        MU_FAILURE("pthread_join(): %s", strerror(err));
+    }
+
+    if ((err = pthread_join(receiver, NULL)))
+    {
+        MU_FAILURE("pthread_join(): %s", strerror(err));
+    }
+}
+
+typedef enum RateTag
+{
+    RATE_REQUEST,
+    RATE_REPLY
+} RateTag;
+
+typedef struct RateMessage
+{
+    uint32_t value;
+} RateMessage;
+
+static LWMsgTypeSpec RateMessage_spec[] =
+{
+    LWMSG_STRUCT_BEGIN(RateMessage),
+    LWMSG_MEMBER_UINT32(RateMessage, value),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgProtocolSpec RateProtocol_spec[] =
+{
+    LWMSG_MESSAGE(RATE_REQUEST, RateMessage_spec),
+    LWMSG_MESSAGE(RATE_REPLY, RateMessage_spec),
+    LWMSG_PROTOCOL_END
+};
+
+static LWMsgStatus
+rate_srv_echo(LWMsgCall* call, const LWMsgParams* in, LWMsgParams* out, void* data)
+{
+    RateMessage* reply = malloc(sizeof(*reply));
+
+    if (!reply)
+    {
+        return LWMSG_STATUS_MEMORY;
+    }
+
+    reply->value = ((RateMessage*) in->data)->value;
+    out->tag = RATE_REPLY;
+    out->data = reply;
+
+    return LWMSG_STATUS_SUCCESS;
+}
+
+static LWMsgDispatchSpec rate_dispatch[] =
+{
+    LWMSG_DISPATCH_NONBLOCK(RATE_REQUEST, rate_srv_echo),
+    LWMSG_DISPATCH_END
+};
+
+#define RATE_CALLS 20000
+#define RATE_MAX_BATCH 32
+
+/*
+ * Makes RATE_CALLS small calls between peers over a socket pair,
+ * batch_size at a time, and reports the calls per second achieved.
+ * A batch size of 1 dispatches each call on its own.
+ */
+static void
+rate_run(
+    int batch_size
+    )
+{
+    int sockets[2];
+    LWMsgProtocol* protocol = NULL;
+    LWMsgPeer* server = NULL;
+    LWMsgPeer* client = NULL;
+    LWMsgSession* session = NULL;
+    LWMsgCall* calls[RATE_MAX_BATCH] = {NULL};
+    RateMessage requests[RATE_MAX_BATCH];
+    LWMsgParams in[RATE_MAX_BATCH];
+    LWMsgParams out[RATE_MAX_BATCH];
+    LWMsgStatus results[RATE_MAX_BATCH];
+    LWMsgTime start;
+    LWMsgTime end;
+    LWMsgTime elapsed;
+    double seconds = 0;
+    int done = 0;
+    int i = 0;
+
+    MU_ASSERT(batch_size > 0 && batch_size <= RATE_MAX_BATCH);
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets))
+    {
+        MU_FAILURE("socketpair(): %s", strerror(errno));
+    }
+
+    MU_TRY(lwmsg_protocol_new(NULL, &protocol));
+    MU_TRY_PROTOCOL(protocol, lwmsg_protocol_add_protocol_spec(protocol, RateProtocol_spec));
+
+    MU_TRY(lwmsg_peer_new(NULL, protocol, &server));
+    MU_TRY(lwmsg_peer_add_dispatch_spec(server, rate_dispatch));
+    MU_TRY(lwmsg_peer_accept_fd(server, LWMSG_ENDPOINT_PAIR, sockets[0]));
+
+    MU_TRY(lwmsg_peer_new(NULL, protocol, &client));
+    MU_TRY(lwmsg_peer_connect_fd(client, LWMSG_ENDPOINT_PAIR, sockets[1], &session));
+
+    for (i = 0; i < batch_size; i++)
+    {
+        MU_TRY(lwmsg_session_acquire_call(session, &calls[i]));
+        in[i].tag = RATE_REQUEST;
+        in[i].data = &requests[i];
+    }
+
+    MU_TRY(lwmsg_time_now(&start));
+
+    for (done = 0; done < RATE_CALLS; done += batch_size)
+    {
+        for (i = 0; i < batch_size; i++)
+        {
+            requests[i].value = done + i;
+        }
+
+        if (batch_size == 1)
+        {
+            results[0] = lwmsg_call_dispatch(calls[0], &in[0], &out[0], NULL, NULL);
+        }
+        else
+        {
+            MU_TRY(lwmsg_call_dispatch_batch(calls, batch_size, in, out, results, NULL, NULL));
+        }
+
+        for (i = 0; i < batch_size; i++)
+        {
+            MU_TRY(results[i]);
+            MU_ASSERT_EQUAL(MU_TYPE_INTEGER, out[i].tag, RATE_REPLY);
+            MU_ASSERT_EQUAL(MU_TYPE_INTEGER, ((RateMessage*) out[i].data)->value, done + i);
+            MU_TRY(lwmsg_call_destroy_params(calls[i], &out[i]));
+        }
+    }
+
+    MU_TRY(lwmsg_time_now(&end));
+    lwmsg_time_difference(&start, &end, &elapsed);
+
+    seconds = elapsed.seconds + elapsed.microseconds / 1000000.0;
+
+    MU_INFO("batch size %i: %i calls in %.2f seconds, %.0f calls/s",
+            batch_size,
+            done,
+            seconds,
+            done / seconds);
+
+    for (i = 0; i < batch_size; i++)
+    {
+        lwmsg_call_release(calls[i]);
+    }
+
+    MU_TRY(lwmsg_peer_disconnect(client));
+    lwmsg_peer_delete(client);
+    MU_TRY(lwmsg_peer_stop_listen(server));
+    lwmsg_peer_delete(server);
+    lwmsg_protocol_delete(protocol);
+}
+
+MU_TEST(assoc, call_rate_single)
+{
+    rate_run(1);
+}
+
+MU_TEST(assoc, call_rate_batch)
+{
+    rate_run(RATE_MAX_BATCH);
+}
+
 typedef struct AHandle AHandle;
 
 static LWMsgTypeSpec local_handle_spec[] =
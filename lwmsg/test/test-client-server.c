@@ -44,9 +44,11 @@
 #include <sys/stat.h>
 #include <sys/un.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <stdlib.h>
 
 #include "util-private.h"
 #include "test-private.h"
@@ -289,7 +291,16 @@ add_thread(void* _data)
 #define NUM_THREADS 16
 #define NUM_ITERS 10
 
-MU_TEST(stress, parallel)
+/*
+ * Hammers a counter server with num_threads client threads, each
+ * making iters calls, and returns the time the calls took.
+ */
+static void
+counter_stress(
+    int num_threads,
+    int iters,
+    LWMsgTime* elapsed
+    )
 {
     Data data;
     pthread_t threads[NUM_THREADS];
@@ -304,6 +315,10 @@ MU_TEST(stress, parallel)
     LWMsgParams in = LWMSG_PARAMS_INITIALIZER;
     LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
     LWMsgTime timeout = {1, 0};
+    LWMsgTime start;
+    LWMsgTime end;
+
+    MU_ASSERT(num_threads <= NUM_THREADS);
 
     MU_TRY(lwmsg_context_new(NULL, &context));
     lwmsg_context_set_log_function(context, lwmsg_test_log_function, NULL);
@@ -335,25 +350,28 @@ MU_TEST(stress, parallel)
 
     data.client = client;
     data.handle = out.data;
-    data.iters = NUM_ITERS;
+    data.iters = iters;
     data.go = 0;
     
     pthread_mutex_init(&data.lock, NULL);
     pthread_cond_init(&data.event, NULL);
 
     pthread_mutex_lock(&data.lock);
-    for (i = 0; i < NUM_THREADS; i++)
+    for (i = 0; i < num_threads; i++)
     {
         pthread_create(&threads[i], NULL, add_thread, &data);
     }
+    MU_TRY(lwmsg_time_now(&start));
     data.go = 1;
     pthread_cond_broadcast(&data.event);
     pthread_mutex_unlock(&data.lock);
 
-    for (i = 0; i < NUM_THREADS; i++)
+    for (i = 0; i < num_threads; i++)
     {
         pthread_join(threads[i], NULL);
     }
+    MU_TRY(lwmsg_time_now(&end));
+    lwmsg_time_difference(&start, &end, elapsed);
 
     MU_TRY(lwmsg_peer_acquire_call(client, &call));
     in.tag = COUNTER_READ;
@@ -364,7 +382,7 @@ MU_TEST(stress, parallel)
     MU_ASSERT_EQUAL(MU_TYPE_INTEGER, out.tag, COUNTER_READ_SUCCESS);
     reply = out.data;
 
-    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, reply->counter, NUM_THREADS * NUM_ITERS);
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, reply->counter, num_threads * iters);
 
     lwmsg_call_destroy_params(call, &out);
     lwmsg_call_release(call);
@@ -390,6 +408,65 @@ MU_TEST(stress, parallel)
     pthread_cond_destroy(&data.event);
 }
 
+MU_TEST(stress, parallel)
+{
+    LWMsgTime elapsed;
+
+    counter_stress(NUM_THREADS, NUM_ITERS, &elapsed);
+}
+
+#define THROUGHPUT_ITERS 2000
+
+static void
+counter_throughput(
+    const char* label
+    )
+{
+    LWMsgTime elapsed;
+    double seconds = 0;
+    int calls = NUM_THREADS * THROUGHPUT_ITERS;
+
+    counter_stress(NUM_THREADS, THROUGHPUT_ITERS, &elapsed);
+
+    seconds = elapsed.seconds + elapsed.microseconds / 1000000.0;
+
+    MU_INFO("%s: %i calls in %.2f seconds, %.0f calls/s",
+            label,
+            calls,
+            seconds,
+            calls / seconds);
+}
+
+/*
+ * Compares call throughput of the lwbase task backend with
+ * io_uring allowed and disabled.  Each run creates and deletes its
+ * own peers, and with them the shared task thread pool, so the
+ * second run sees the environment change.  When lwbase is built
+ * without the io_uring backend both runs use the same backend.
+ */
+MU_TEST(stress, throughput)
+{
+    char* saved = getenv("LW_DISABLE_IO_URING");
+
+    saved = saved ? strdup(saved) : NULL;
+
+    unsetenv("LW_DISABLE_IO_URING");
+    counter_throughput("default task backend");
+
+    setenv("LW_DISABLE_IO_URING", "1", 1);
+    counter_throughput("io_uring disabled");
+
+    if (saved)
+    {
+        setenv("LW_DISABLE_IO_URING", saved, 1);
+        free(saved);
+    }
+    else
+    {
+        unsetenv("LW_DISABLE_IO_URING");
+    }
+}
+
 MU_TEST(stress, parallel_print_protocol)
 {
     LWMsgContext* context = NULL;
@@ -469,6 +546,198 @@ MU_TEST(client_server, handle_invalidation)
     lwmsg_peer_delete(server);
 }
 
+MU_TEST(client_server, stats)
+{
+    static const int adds = 20;
+    LWMsgContext* context = NULL;
+    LWMsgProtocol* protocol = NULL;
+    LWMsgProtocol* empty_protocol = NULL;
+    LWMsgPeer* client = NULL;
+    LWMsgPeer* server = NULL;
+    LWMsgPeer* monitor = NULL;
+    LWMsgHandle* handle = NULL;
+    CounterRequest request;
+    CounterAdd add;
+    LWMsgCall* call;
+    LWMsgParams in = LWMSG_PARAMS_INITIALIZER;
+    LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
+    LWMsgPeerStats* local = NULL;
+    LWMsgPeerStats* remote = NULL;
+    LWMsgTime threshold = {0, 0};
+    uint64_t total = 0;
+    int i = 0;
+    int j = 0;
+
+    MU_TRY(lwmsg_context_new(NULL, &context));
+    MU_TRY(lwmsg_protocol_new(context, &protocol));
+    MU_TRY(lwmsg_protocol_add_protocol_spec(protocol, counterprotocol_spec));
+
+    MU_TRY(lwmsg_peer_new(context, protocol, &server));
+    MU_TRY(lwmsg_peer_add_dispatch_spec(server, counter_dispatch));
+    MU_TRY(lwmsg_peer_add_listen_endpoint(server, LWMSG_CONNECTION_MODE_LOCAL, TEST_ENDPOINT, 0600));
+    /* Record every call as slow */
+    MU_TRY(lwmsg_peer_set_slow_call_threshold(server, &threshold));
+    MU_TRY(lwmsg_peer_start_listen(server));
+
+    MU_TRY(lwmsg_peer_new(context, protocol, &client));
+    MU_TRY(lwmsg_peer_add_connect_endpoint(client, LWMSG_CONNECTION_MODE_LOCAL, TEST_ENDPOINT));
+    MU_TRY(lwmsg_peer_connect(client, NULL));
+
+    request.counter = 0;
+    in.tag = COUNTER_OPEN;
+    in.data = &request;
+
+    MU_TRY(lwmsg_peer_acquire_call(client, &call));
+    MU_TRY(lwmsg_call_dispatch(call, &in, &out, NULL, NULL));
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, out.tag, COUNTER_OPEN_SUCCESS);
+    handle = out.data;
+    lwmsg_call_release(call);
+
+    for (i = 0; i < adds; i++)
+    {
+        add.handle = handle;
+        add.delta = 1;
+        in.tag = COUNTER_ADD;
+        in.data = &add;
+
+        MU_TRY(lwmsg_peer_acquire_call(client, &call));
+        MU_TRY(lwmsg_call_dispatch(call, &in, &out, NULL, NULL));
+        MU_ASSERT_EQUAL(MU_TYPE_INTEGER, out.tag, COUNTER_ADD_SUCCESS);
+        lwmsg_call_destroy_params(call, &out);
+        lwmsg_call_release(call);
+    }
+
+    /* A peer which knows nothing of the counter protocol can still ask */
+    MU_TRY(lwmsg_protocol_new(context, &empty_protocol));
+    MU_TRY(lwmsg_peer_new(context, empty_protocol, &monitor));
+    MU_TRY(lwmsg_peer_add_connect_endpoint(monitor, LWMSG_CONNECTION_MODE_LOCAL, TEST_ENDPOINT));
+    MU_TRY(lwmsg_peer_connect(monitor, NULL));
+    MU_TRY(lwmsg_peer_acquire_call(monitor, &call));
+    MU_TRY(lwmsg_peer_query_stats(call, &remote));
+    lwmsg_call_release(call);
+
+    MU_TRY(lwmsg_peer_get_stats(server, &local));
+
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, remote->tag_count, 4);
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, remote->in_flight, 0);
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, remote->rejected, 0);
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, remote->clients, 2);
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, remote->slow_call_count, 16);
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, local->tag_count, remote->tag_count);
+
+    for (i = 0; i < remote->tag_count; i++)
+    {
+        switch (remote->tags[i].tag)
+        {
+        case COUNTER_OPEN:
+            MU_ASSERT_EQUAL(MU_TYPE_STRING, remote->tags[i].name, "COUNTER_OPEN");
+            MU_ASSERT_EQUAL(MU_TYPE_INTEGER, remote->tags[i].calls, 1);
+            break;
+        case COUNTER_ADD:
+            MU_ASSERT_EQUAL(MU_TYPE_STRING, remote->tags[i].name, "COUNTER_ADD");
+            MU_ASSERT_EQUAL(MU_TYPE_INTEGER, remote->tags[i].calls, adds);
+            break;
+        default:
+            MU_ASSERT_EQUAL(MU_TYPE_INTEGER, remote->tags[i].calls, 0);
+            break;
+        }
+
+        MU_ASSERT_EQUAL(MU_TYPE_INTEGER, remote->tags[i].failures, 0);
+        MU_ASSERT_EQUAL(MU_TYPE_INTEGER, remote->tags[i].calls, local->tags[i].calls);
+
+        for (j = 0, total = 0; j < LWMSG_PEER_STATS_BUCKETS; j++)
+        {
+            total += remote->tags[i].service_histogram[j];
+        }
+
+        MU_ASSERT_EQUAL(MU_TYPE_INTEGER, total, remote->tags[i].calls);
+    }
+
+    for (i = 0; i < remote->slow_call_count; i++)
+    {
+        MU_ASSERT_EQUAL(MU_TYPE_INTEGER, remote->slow_calls[i].tag, COUNTER_ADD);
+    }
+
+    /* The server's listen and session tasks run on its task threads */
+    MU_ASSERT(remote->thread_count > 0);
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, remote->thread_count, local->thread_count);
+
+    for (i = 0, total = 0; i < remote->thread_count; i++)
+    {
+        total += remote->threads[i].tasks;
+    }
+
+    MU_ASSERT(total > 0);
+
+    lwmsg_peer_free_stats(monitor, remote);
+    lwmsg_peer_free_stats(server, local);
+
+    MU_TRY(lwmsg_peer_disconnect(monitor));
+    lwmsg_peer_delete(monitor);
+
+    MU_TRY(lwmsg_peer_disconnect(client));
+    lwmsg_peer_delete(client);
+
+    MU_TRY(lwmsg_peer_stop_listen(server));
+    lwmsg_peer_delete(server);
+
+    lwmsg_protocol_delete(empty_protocol);
+    lwmsg_protocol_delete(protocol);
+    lwmsg_context_delete(context);
+}
+
+MU_TEST(client_server, stats_other_user)
+{
+    LWMsgContext* context = NULL;
+    LWMsgProtocol* protocol = NULL;
+    LWMsgPeer* server = NULL;
+    LWMsgAssoc* assoc = NULL;
+    LWMsgSession* session = NULL;
+    LWMsgCall* call = NULL;
+    LWMsgPeerStats* remote = NULL;
+
+    /* Only root can become another user to ask */
+    if (geteuid() != 0)
+    {
+        return;
+    }
+
+    MU_TRY(lwmsg_context_new(NULL, &context));
+    MU_TRY(lwmsg_protocol_new(context, &protocol));
+    MU_TRY(lwmsg_protocol_add_protocol_spec(protocol, counterprotocol_spec));
+
+    MU_TRY(lwmsg_peer_new(context, protocol, &server));
+    MU_TRY(lwmsg_peer_add_dispatch_spec(server, counter_dispatch));
+    MU_TRY(lwmsg_peer_add_listen_endpoint(server, LWMSG_CONNECTION_MODE_LOCAL, TEST_ENDPOINT, 0666));
+    MU_TRY(lwmsg_peer_start_listen(server));
+
+    MU_TRY(lwmsg_connection_new(context, protocol, &assoc));
+    MU_TRY(lwmsg_connection_set_endpoint(assoc, LWMSG_CONNECTION_MODE_LOCAL, TEST_ENDPOINT));
+
+    /*
+     * The raw system call changes the effective user of this thread
+     * only, leaving the server's threads alone.  The server sees the
+     * user that was in effect at connect time.
+     */
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, syscall(SYS_setresuid, -1, 65534, -1), 0);
+    MU_TRY(lwmsg_assoc_connect(assoc, NULL));
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, syscall(SYS_setresuid, -1, 0, -1), 0);
+
+    MU_TRY(lwmsg_assoc_get_session(assoc, &session));
+    MU_TRY(lwmsg_session_acquire_call(session, &call));
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, lwmsg_peer_query_stats(call, &remote), LWMSG_STATUS_SECURITY);
+    lwmsg_call_release(call);
+
+    MU_TRY(lwmsg_assoc_close(assoc));
+    lwmsg_assoc_delete(assoc);
+
+    MU_TRY(lwmsg_peer_stop_listen(server));
+    lwmsg_peer_delete(server);
+
+    lwmsg_protocol_delete(protocol);
+    lwmsg_context_delete(context);
+}
+
 
 typedef int (*IntFunction) (int value);
 
@@ -44,6 +44,7 @@
 #include "test-private.h"
 #include "type-private.h"
 #include "context-private.h"
+#include "data-private.h"
 
 static LWMsgContext* context = NULL;
 static LWMsgDataContext* dcontext = NULL;
@@ -1869,3 +1870,375 @@ MU_TEST(marshal, mask_enum_zero)
     lwmsg_context_free(context, buffer);
     MU_TRY_DCONTEXT(dcontext, lwmsg_data_free_graph(dcontext, type, out));
 }
+
+/*
+ * Throughput benchmarks.  The structures below are modeled on
+ * the lsass security object and enumeration responses, which make
+ * up most of the IPC traffic on a domain-joined system.
+ */
+
+typedef struct bench_version
+{
+    uint64_t qwDbId;
+    uint64_t tLastUpdated;
+    uint32_t dwObjectSize;
+    uint32_t dwWeight;
+} bench_version;
+
+typedef struct bench_user_info
+{
+    uint32_t uid;
+    uint32_t gid;
+    char* pszUPN;
+    char* pszAliasName;
+    char* pszPasswd;
+    char* pszGecos;
+    char* pszShell;
+    char* pszHomedir;
+    uint64_t qwPwdLastSet;
+    uint64_t qwMaxPwdAge;
+    uint64_t qwPwdExpires;
+    uint64_t qwAccountExpires;
+    uint8_t bIsGeneratedUPN;
+    uint8_t bPasswordExpired;
+    uint8_t bPasswordNeverExpires;
+    uint8_t bAccountDisabled;
+    uint8_t bAccountLocked;
+} bench_user_info;
+
+typedef struct bench_object
+{
+    bench_version version;
+    char* pszDN;
+    char* pszObjectSid;
+    uint8_t enabled;
+    char* pszNetbiosDomainName;
+    char* pszSamAccountName;
+    uint32_t type;
+    bench_user_info userInfo;
+} bench_object;
+
+typedef struct bench_object_list
+{
+    uint32_t dwCount;
+    bench_object** ppObjects;
+} bench_object_list;
+
+typedef struct bench_status
+{
+    uint32_t dwUptime;
+    bench_version version;
+    uint32_t dwNumProviders;
+    uint64_t qwCacheHits;
+    uint64_t qwCacheMisses;
+    uint8_t guid[16];
+    int16_t counters[4];
+} bench_status;
+
+static LWMsgTypeSpec bench_version_spec[] =
+{
+    LWMSG_STRUCT_BEGIN(bench_version),
+    LWMSG_MEMBER_UINT64(bench_version, qwDbId),
+    LWMSG_MEMBER_UINT64(bench_version, tLastUpdated),
+    LWMSG_MEMBER_UINT32(bench_version, dwObjectSize),
+    LWMSG_MEMBER_UINT32(bench_version, dwWeight),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec bench_user_info_spec[] =
+{
+    LWMSG_STRUCT_BEGIN(bench_user_info),
+    LWMSG_MEMBER_UINT32(bench_user_info, uid),
+    LWMSG_MEMBER_UINT32(bench_user_info, gid),
+    LWMSG_MEMBER_PSTR(bench_user_info, pszUPN),
+    LWMSG_MEMBER_PSTR(bench_user_info, pszAliasName),
+    LWMSG_MEMBER_PSTR(bench_user_info, pszPasswd),
+    LWMSG_MEMBER_PSTR(bench_user_info, pszGecos),
+    LWMSG_MEMBER_PSTR(bench_user_info, pszShell),
+    LWMSG_MEMBER_PSTR(bench_user_info, pszHomedir),
+    LWMSG_MEMBER_UINT64(bench_user_info, qwPwdLastSet),
+    LWMSG_MEMBER_UINT64(bench_user_info, qwMaxPwdAge),
+    LWMSG_MEMBER_UINT64(bench_user_info, qwPwdExpires),
+    LWMSG_MEMBER_UINT64(bench_user_info, qwAccountExpires),
+    LWMSG_MEMBER_UINT8(bench_user_info, bIsGeneratedUPN),
+    LWMSG_MEMBER_UINT8(bench_user_info, bPasswordExpired),
+    LWMSG_MEMBER_UINT8(bench_user_info, bPasswordNeverExpires),
+    LWMSG_MEMBER_UINT8(bench_user_info, bAccountDisabled),
+    LWMSG_MEMBER_UINT8(bench_user_info, bAccountLocked),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec bench_object_spec[] =
+{
+    LWMSG_STRUCT_BEGIN(bench_object),
+    LWMSG_MEMBER_TYPESPEC(bench_object, version, bench_version_spec),
+    LWMSG_MEMBER_PSTR(bench_object, pszDN),
+    LWMSG_MEMBER_PSTR(bench_object, pszObjectSid),
+    LWMSG_MEMBER_UINT8(bench_object, enabled),
+    LWMSG_MEMBER_PSTR(bench_object, pszNetbiosDomainName),
+    LWMSG_MEMBER_PSTR(bench_object, pszSamAccountName),
+    LWMSG_MEMBER_UINT32(bench_object, type),
+    LWMSG_MEMBER_TYPESPEC(bench_object, userInfo, bench_user_info_spec),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec bench_object_list_spec[] =
+{
+    LWMSG_STRUCT_BEGIN(bench_object_list),
+    LWMSG_MEMBER_UINT32(bench_object_list, dwCount),
+    LWMSG_MEMBER_POINTER_BEGIN(bench_object_list, ppObjects),
+    LWMSG_POINTER(LWMSG_TYPESPEC(bench_object_spec)),
+    LWMSG_POINTER_END,
+    LWMSG_ATTR_LENGTH_MEMBER(bench_object_list, dwCount),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec bench_status_spec[] =
+{
+    LWMSG_STRUCT_BEGIN(bench_status),
+    LWMSG_MEMBER_UINT32(bench_status, dwUptime),
+    LWMSG_MEMBER_TYPESPEC(bench_status, version, bench_version_spec),
+    LWMSG_MEMBER_UINT32(bench_status, dwNumProviders),
+    LWMSG_MEMBER_UINT64(bench_status, qwCacheHits),
+    LWMSG_MEMBER_UINT64(bench_status, qwCacheMisses),
+    LWMSG_MEMBER_ARRAY_BEGIN(bench_status, guid),
+    LWMSG_UINT8(uint8_t),
+    LWMSG_ARRAY_END,
+    LWMSG_ATTR_LENGTH_STATIC(16),
+    LWMSG_MEMBER_ARRAY_BEGIN(bench_status, counters),
+    LWMSG_INT16(int16_t),
+    LWMSG_ARRAY_END,
+    LWMSG_ATTR_LENGTH_STATIC(4),
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+#define BENCH_LIST_COUNT 16
+
+static
+void
+bench_fill_object(
+    bench_object* object,
+    int index
+    )
+{
+    memset(object, 0, sizeof(*object));
+
+    object->version.qwDbId = index;
+    object->version.tLastUpdated = 1262304000 + index;
+    object->version.dwObjectSize = 512;
+    object->version.dwWeight = 1;
+    object->pszDN = "CN=Test User,CN=Users,DC=corp,DC=example,DC=com";
+    object->pszObjectSid = "S-1-5-21-3623811015-3361044348-30300820-1013";
+    object->enabled = 1;
+    object->pszNetbiosDomainName = "CORP";
+    object->pszSamAccountName = "testuser";
+    object->type = 1;
+    object->userInfo.uid = 1000000 + index;
+    object->userInfo.gid = 1000513;
+    object->userInfo.pszUPN = "testuser@CORP.EXAMPLE.COM";
+    object->userInfo.pszAliasName = NULL;
+    object->userInfo.pszPasswd = "x";
+    object->userInfo.pszGecos = "Test User";
+    object->userInfo.pszShell = "/bin/sh";
+    object->userInfo.pszHomedir = "/home/CORP/testuser";
+    object->userInfo.qwPwdLastSet = 129000000000000000ull;
+    object->userInfo.qwMaxPwdAge = 36288000000000ull;
+    object->userInfo.qwPwdExpires = 129036288000000000ull;
+    object->userInfo.qwAccountExpires = 0x7FFFFFFFFFFFFFFFull;
+    object->userInfo.bPasswordNeverExpires = 1;
+}
+
+/*
+ * Marshals and unmarshals the object repeatedly, first with compiled
+ * plans and then with plans disabled so the spec is interpreted.
+ * Both must produce the same bytes.
+ */
+static
+void
+bench_round_trip(
+    const char* label,
+    LWMsgTypeSpec* type,
+    void* object,
+    int iters
+    )
+{
+    static const size_t length = 65536;
+    unsigned char* expected = NULL;
+    size_t expected_length = 0;
+    LWMsgBuffer buffer = {0};
+    LWMsgTime start;
+    LWMsgTime end;
+    LWMsgTime elapsed;
+    double seconds = 0;
+    void* out = NULL;
+    int pass;
+    int i;
+
+    buffer.base = malloc(length);
+    buffer.end = buffer.base + length;
+    MU_ASSERT(buffer.base);
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        lwmsg_data_context_set_plans(dcontext, pass == 0);
+
+        MU_TRY(lwmsg_time_now(&start));
+
+        for (i = 0; i < iters; i++)
+        {
+            buffer.cursor = buffer.base;
+            MU_TRY_DCONTEXT(dcontext, lwmsg_data_marshal(dcontext, type, object, &buffer));
+
+            if (i == 0)
+            {
+                if (pass == 0)
+                {
+                    expected_length = buffer.cursor - buffer.base;
+                    expected = malloc(expected_length);
+                    MU_ASSERT(expected);
+                    memcpy(expected, buffer.base, expected_length);
+                }
+                else
+                {
+                    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, buffer.cursor - buffer.base, expected_length);
+                    MU_ASSERT(!memcmp(buffer.base, expected, expected_length));
+                }
+            }
+
+            buffer.end = buffer.cursor;
+            buffer.cursor = buffer.base;
+            MU_TRY_DCONTEXT(dcontext, lwmsg_data_unmarshal(dcontext, type, &buffer, &out));
+            buffer.end = buffer.base + length;
+
+            MU_TRY_DCONTEXT(dcontext, lwmsg_data_free_graph(dcontext, type, out));
+        }
+
+        MU_TRY(lwmsg_time_now(&end));
+        lwmsg_time_difference(&start, &end, &elapsed);
+        seconds = elapsed.seconds + elapsed.microseconds / 1000000.0;
+
+        MU_INFO("%s (%s): %i round trips in %.2f seconds, %.0f/s",
+                label,
+                pass == 0 ? "compiled" : "interpreted",
+                iters,
+                seconds,
+                iters / seconds);
+    }
+
+    lwmsg_data_context_set_plans(dcontext, LWMSG_TRUE);
+
+    free(expected);
+    free(buffer.base);
+}
+
+MU_TEST(marshal, bench_status)
+{
+    bench_status status;
+    int i;
+
+    memset(&status, 0, sizeof(status));
+    status.dwUptime = 86400;
+    status.version.qwDbId = 42;
+    status.dwNumProviders = 2;
+    status.qwCacheHits = 1000000;
+    status.qwCacheMisses = 1234;
+    for (i = 0; i < 16; i++)
+    {
+        status.guid[i] = (uint8_t) i;
+    }
+    for (i = 0; i < 4; i++)
+    {
+        status.counters[i] = (int16_t) -i;
+    }
+
+    bench_round_trip("status", bench_status_spec, &status, 200000);
+}
+
+MU_TEST(marshal, bench_object)
+{
+    bench_object object;
+
+    bench_fill_object(&object, 0);
+
+    bench_round_trip("security object", bench_object_spec, &object, 100000);
+}
+
+MU_TEST(marshal, bench_object_list)
+{
+    bench_object objects[BENCH_LIST_COUNT];
+    bench_object* pointers[BENCH_LIST_COUNT];
+    bench_object_list list;
+    int i;
+
+    for (i = 0; i < BENCH_LIST_COUNT; i++)
+    {
+        bench_fill_object(&objects[i], i);
+        pointers[i] = &objects[i];
+    }
+
+    list.dwCount = BENCH_LIST_COUNT;
+    list.ppObjects = pointers;
+
+    bench_round_trip("security object list", bench_object_list_spec, &list, 10000);
+}
+
+MU_TEST(marshal, plan_shared_across_contexts)
+{
+    LWMsgDataContext* first = NULL;
+    LWMsgDataContext* second = NULL;
+    LWMsgDataPlan* plan1 = NULL;
+    LWMsgDataPlan* plan2 = NULL;
+    bench_object object;
+    unsigned char* buffer = NULL;
+    size_t length = 0;
+
+    bench_fill_object(&object, 0);
+
+    MU_TRY(lwmsg_data_context_new(context, &first));
+    lwmsg_data_plan_find(first, bench_object_spec, &plan1);
+    MU_ASSERT(plan1 != NULL);
+    MU_TRY_DCONTEXT(first, lwmsg_data_marshal_flat_alloc(first, bench_object_spec, &object, (void**) (void*) &buffer, &length));
+    lwmsg_context_free(context, buffer);
+    lwmsg_data_context_delete(first);
+
+    /* A data context created later uses the plan compiled for the first */
+    MU_TRY(lwmsg_data_context_new(context, &second));
+    lwmsg_data_plan_find(second, bench_object_spec, &plan2);
+    MU_ASSERT(plan1 == plan2);
+    lwmsg_data_context_delete(second);
+}
+
+MU_TEST(marshal, plan_forgotten_with_type)
+{
+    size_t spec[sizeof(bench_object_spec) / sizeof(bench_object_spec[0])];
+    LWMsgTypeSpec* type = (LWMsgTypeSpec*) spec;
+    bench_object object;
+    unsigned char* expected = NULL;
+    unsigned char* buffer = NULL;
+    size_t expected_length = 0;
+    size_t length = 0;
+
+    bench_fill_object(&object, 0);
+
+    /* Compile a plan for a spec at this address, then reuse it for another type */
+    memcpy(spec, bench_object_spec, sizeof(bench_object_spec));
+    MU_TRY_DCONTEXT(dcontext, lwmsg_data_marshal_flat_alloc(dcontext, type, &object, (void**) (void*) &buffer, &length));
+    lwmsg_context_free(context, buffer);
+    lwmsg_data_forget_type(type);
+
+    memcpy(spec, bench_version_spec, sizeof(bench_version_spec));
+    MU_TRY_DCONTEXT(dcontext, lwmsg_data_marshal_flat_alloc(dcontext, bench_version_spec, &object.version, (void**) (void*) &expected, &expected_length));
+    MU_TRY_DCONTEXT(dcontext, lwmsg_data_marshal_flat_alloc(dcontext, type, &object.version, (void**) (void*) &buffer, &length));
+    lwmsg_data_forget_type(type);
+
+    MU_ASSERT_EQUAL(MU_TYPE_INTEGER, length, expected_length);
+    MU_ASSERT(!memcmp(buffer, expected, length));
+
+    lwmsg_context_free(context, expected);
+    lwmsg_context_free(context, buffer);
+}
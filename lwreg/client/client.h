@@ -64,3 +64,4 @@
 #include "regipc.h"
 
 #include "clientipc_p.h"
+#include "clientcache_p.h"
@@ -0,0 +1,932 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ */
+
+/*
+ * Copyright Likewise Software    2004-2008
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the license, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.  You should have received a copy
+ * of the GNU Lesser General Public License along with this program.  If
+ * not, see <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * LESSER GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        clientcache.c
+ *
+ * Abstract:
+ *
+ *        Registry Subsystem
+ *
+ *        Client-side value cache
+ *
+ *        Values read through handles whose path is known are kept by
+ *        (key path, value name, type flags), along with "not found"
+ *        answers.  While entries exist, a REG_Q_WAIT_CHANGE call is kept
+ *        pending on the server, which completes it after the next write
+ *        from any client; the whole cache is then dropped.  Writes made
+ *        through this library drop it as soon as they return, so a
+ *        process always reads back its own writes.
+ *
+ *        Config values read in bulk are kept the same way.  When a
+ *        policy key may override one, the policy key path is part of
+ *        its entry.
+ */
+#include "client.h"
+#include <lw/hash.h>
+
+typedef struct _REG_CLIENT_CACHE_KEY
+{
+    LW_HASHTABLE_NODE Node;
+    HKEY hKey;
+    PWSTR pwszPath;
+    BOOLEAN bQueryValue;
+} REG_CLIENT_CACHE_KEY, *PREG_CLIENT_CACHE_KEY;
+
+typedef struct _REG_CLIENT_CACHE_VALUE_ID
+{
+    PWSTR pwszPath;
+    // Set for config values, which a value under this key overrides
+    PWSTR pwszPolicyPath;
+    PWSTR pwszValueName;
+    REG_DATA_TYPE_FLAGS Flags;
+} REG_CLIENT_CACHE_VALUE_ID, *PREG_CLIENT_CACHE_VALUE_ID;
+
+typedef struct _REG_CLIENT_CACHE_VALUE
+{
+    LW_HASHTABLE_NODE Node;
+    REG_CLIENT_CACHE_VALUE_ID Id;
+    NTSTATUS status;
+    DWORD dwType;
+    DWORD cbData;
+    PBYTE pData;
+} REG_CLIENT_CACHE_VALUE, *PREG_CLIENT_CACHE_VALUE;
+
+typedef struct _REG_CLIENT_CACHE
+{
+    pthread_mutex_t Lock;
+    PLW_HASHTABLE pKeys;
+    PLW_HASHTABLE pValues;
+    // Bumped by every flush.  A lookup only stores what the server
+    // returned if no flush happened while the call was in flight.
+    ULONG64 Generation;
+    // Last change count reported by the server, 0 if unknown
+    ULONG64 ServerGeneration;
+    // Nothing is cached unless a wait call is outstanding
+    BOOLEAN bWatching;
+    // Set while one thread fetches the change count and dispatches
+    // the wait call
+    BOOLEAN bArming;
+    REG_IPC_WAIT_CHANGE_REQ WatchReq;
+    LWMsgParams WatchIn;
+    LWMsgParams WatchOut;
+} REG_CLIENT_CACHE;
+
+static
+PCVOID
+RegClientCacheGetKeyHandle(
+    PLW_HASHTABLE_NODE pNode,
+    PVOID pUnused
+    )
+{
+    return LW_STRUCT_FROM_FIELD(pNode, REG_CLIENT_CACHE_KEY, Node)->hKey;
+}
+
+static
+PCVOID
+RegClientCacheGetValueId(
+    PLW_HASHTABLE_NODE pNode,
+    PVOID pUnused
+    )
+{
+    return &LW_STRUCT_FROM_FIELD(pNode, REG_CLIENT_CACHE_VALUE, Node)->Id;
+}
+
+static const WCHAR gwszEmpty[] = {0};
+
+static
+ULONG
+RegClientCacheDigestValueId(
+    PCVOID pKey,
+    PVOID pUnused
+    )
+{
+    PREG_CLIENT_CACHE_VALUE_ID pId = (PREG_CLIENT_CACHE_VALUE_ID) pKey;
+
+    return ((LwRtlHashDigestPwstrCaseless(pId->pwszPath, NULL) * 31 +
+             (pId->pwszPolicyPath ?
+                  LwRtlHashDigestPwstrCaseless(pId->pwszPolicyPath, NULL) : 0)) * 31 +
+            LwRtlHashDigestPwstrCaseless(pId->pwszValueName, NULL)) * 31 +
+           pId->Flags;
+}
+
+static
+BOOLEAN
+RegClientCacheEqualValueId(
+    PCVOID pKey1,
+    PCVOID pKey2,
+    PVOID pUnused
+    )
+{
+    PREG_CLIENT_CACHE_VALUE_ID pId1 = (PREG_CLIENT_CACHE_VALUE_ID) pKey1;
+    PREG_CLIENT_CACHE_VALUE_ID pId2 = (PREG_CLIENT_CACHE_VALUE_ID) pKey2;
+
+    return pId1->Flags == pId2->Flags &&
+           LwRtlHashEqualPwstrCaseless(pId1->pwszPath, pId2->pwszPath, NULL) &&
+           (pId1->pwszPolicyPath && pId2->pwszPolicyPath ?
+                LwRtlHashEqualPwstrCaseless(pId1->pwszPolicyPath, pId2->pwszPolicyPath, NULL) :
+                pId1->pwszPolicyPath == pId2->pwszPolicyPath) &&
+           LwRtlHashEqualPwstrCaseless(pId1->pwszValueName, pId2->pwszValueName, NULL);
+}
+
+static
+VOID
+RegClientCacheFreeKey(
+    PLW_HASHTABLE_NODE pNode,
+    PVOID pUnused
+    )
+{
+    PREG_CLIENT_CACHE_KEY pKey = LW_STRUCT_FROM_FIELD(pNode, REG_CLIENT_CACHE_KEY, Node);
+
+    LWREG_SAFE_FREE_MEMORY(pKey->pwszPath);
+    LWREG_SAFE_FREE_MEMORY(pKey);
+}
+
+static
+VOID
+RegClientCacheFreeValue(
+    PLW_HASHTABLE_NODE pNode,
+    PVOID pUnused
+    )
+{
+    PREG_CLIENT_CACHE_VALUE pValue = LW_STRUCT_FROM_FIELD(pNode, REG_CLIENT_CACHE_VALUE, Node);
+
+    LWREG_SAFE_FREE_MEMORY(pValue->Id.pwszPath);
+    LWREG_SAFE_FREE_MEMORY(pValue->Id.pwszPolicyPath);
+    LWREG_SAFE_FREE_MEMORY(pValue->Id.pwszValueName);
+    LWREG_SAFE_FREE_MEMORY(pValue->pData);
+    LWREG_SAFE_FREE_MEMORY(pValue);
+}
+
+/* Caller holds pCache->Lock */
+static
+VOID
+RegClientCacheFlushLocked(
+    PREG_CLIENT_CACHE pCache
+    )
+{
+    LwRtlHashTableClear(pCache->pValues, RegClientCacheFreeValue, NULL);
+    pCache->Generation++;
+}
+
+/*
+ * Builds the path of hKey\pSubKey, or just pSubKey when hKey is not
+ * given.  Caller holds pCache->Lock.  Returns FALSE if the path of
+ * hKey is unknown or the handle may not query values.
+ */
+static
+BOOLEAN
+RegClientCacheBuildPath(
+    PREG_CLIENT_CACHE pCache,
+    HKEY hKey,
+    PCWSTR pSubKey,
+    BOOLEAN bQueryValue,
+    PWSTR* ppwszPath
+    )
+{
+    NTSTATUS status = 0;
+    PLW_HASHTABLE_NODE pNode = NULL;
+    PREG_CLIENT_CACHE_KEY pKey = NULL;
+    PCWSTR pwszParent = NULL;
+    size_t sParentLen = 0;
+    size_t sSubKeyLen = 0;
+    PWSTR pwszPath = NULL;
+
+    if (hKey)
+    {
+        if (LwRtlHashTableFindKey(pCache->pKeys, &pNode, hKey))
+        {
+            return FALSE;
+        }
+
+        pKey = LW_STRUCT_FROM_FIELD(pNode, REG_CLIENT_CACHE_KEY, Node);
+        if (bQueryValue && !pKey->bQueryValue)
+        {
+            return FALSE;
+        }
+
+        pwszParent = pKey->pwszPath;
+        sParentLen = LwRtlWC16StringNumChars(pwszParent);
+    }
+
+    if (!LW_IS_NULL_OR_EMPTY_STR(pSubKey))
+    {
+        sSubKeyLen = LwRtlWC16StringNumChars(pSubKey);
+    }
+
+    if (!sParentLen && !sSubKeyLen)
+    {
+        return FALSE;
+    }
+
+    status = LW_RTL_ALLOCATE(
+                 &pwszPath,
+                 WCHAR,
+                 (sParentLen + 1 + sSubKeyLen + 1) * sizeof(WCHAR));
+    if (status)
+    {
+        return FALSE;
+    }
+
+    memcpy(pwszPath, pwszParent, sParentLen * sizeof(WCHAR));
+    if (sParentLen && sSubKeyLen)
+    {
+        pwszPath[sParentLen++] = '\\';
+    }
+    memcpy(pwszPath + sParentLen, pSubKey, sSubKeyLen * sizeof(WCHAR));
+
+    *ppwszPath = pwszPath;
+
+    return TRUE;
+}
+
+static
+VOID
+RegClientCacheWatchComplete(
+    LWMsgCall* pCall,
+    LWMsgStatus status,
+    PVOID pData
+    )
+{
+    PREG_CLIENT_CACHE pCache = pData;
+    PREG_IPC_WAIT_CHANGE_RESPONSE pResp = NULL;
+    LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
+
+    pthread_mutex_lock(&pCache->Lock);
+
+    out = pCache->WatchOut;
+    pCache->WatchOut.tag = LWMSG_TAG_INVALID;
+    pCache->WatchOut.data = NULL;
+
+    if (status == LWMSG_STATUS_SUCCESS && out.tag == REG_R_WAIT_CHANGE)
+    {
+        pResp = out.data;
+        pCache->ServerGeneration = pResp->Generation;
+    }
+    else
+    {
+        // Lost the server or the call; start over once it is back
+        pCache->ServerGeneration = 0;
+    }
+
+    RegClientCacheFlushLocked(pCache);
+    pCache->bWatching = FALSE;
+
+    pthread_mutex_unlock(&pCache->Lock);
+
+    lwmsg_call_destroy_params(pCall, &out);
+    lwmsg_call_release(pCall);
+}
+
+/*
+ * Makes sure a wait call is outstanding, fetching the server change
+ * count first if it is not known.  Returns FALSE when that is not
+ * possible, in which case nothing may be looked up or stored.
+ */
+static
+BOOLEAN
+RegClientCacheWatch(
+    PREG_CLIENT_CONNECTION_CONTEXT pContext
+    )
+{
+    NTSTATUS status = 0;
+    LWMsgStatus callStatus = LWMSG_STATUS_SUCCESS;
+    PREG_CLIENT_CACHE pCache = pContext->pCache;
+    REG_IPC_WAIT_CHANGE_REQ req = {0};
+    LWMsgParams in = LWMSG_PARAMS_INITIALIZER;
+    LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
+    LWMsgCall* pCall = NULL;
+    ULONG64 Generation = 0;
+
+    pthread_mutex_lock(&pCache->Lock);
+
+    if (pCache->bWatching || pCache->bArming)
+    {
+        pthread_mutex_unlock(&pCache->Lock);
+        return pCache->bWatching;
+    }
+
+    pCache->bArming = TRUE;
+    Generation = pCache->ServerGeneration;
+
+    pthread_mutex_unlock(&pCache->Lock);
+
+    if (!Generation)
+    {
+        // Generation 0 never matches, so this returns right away
+        status = RegIpcAcquireCall(pContext, &pCall);
+        BAIL_ON_NT_STATUS(status);
+
+        req.Generation = 0;
+        in.tag = REG_Q_WAIT_CHANGE;
+        in.data = &req;
+
+        status = MAP_LWMSG_ERROR(lwmsg_call_dispatch(pCall, &in, &out, NULL, NULL));
+        BAIL_ON_NT_STATUS(status);
+
+        if (out.tag != REG_R_WAIT_CHANGE)
+        {
+            status = STATUS_NOT_SUPPORTED;
+            BAIL_ON_NT_STATUS(status);
+        }
+
+        Generation = ((PREG_IPC_WAIT_CHANGE_RESPONSE) out.data)->Generation;
+
+        lwmsg_call_destroy_params(pCall, &out);
+        lwmsg_call_release(pCall);
+        pCall = NULL;
+    }
+
+    status = RegIpcAcquireCall(pContext, &pCall);
+    BAIL_ON_NT_STATUS(status);
+
+    /*
+     * Reads issued from here on are answered after the server counted
+     * Generation, so any write they miss completes the wait call.
+     * Only this thread touches the watch parameters until it does.
+     */
+    pthread_mutex_lock(&pCache->Lock);
+
+    pCache->bArming = FALSE;
+    pCache->bWatching = TRUE;
+    pCache->ServerGeneration = Generation;
+    pCache->WatchReq.Generation = Generation;
+    pCache->WatchIn.tag = REG_Q_WAIT_CHANGE;
+    pCache->WatchIn.data = &pCache->WatchReq;
+
+    pthread_mutex_unlock(&pCache->Lock);
+
+    callStatus = lwmsg_call_dispatch(
+                     pCall,
+                     &pCache->WatchIn,
+                     &pCache->WatchOut,
+                     RegClientCacheWatchComplete,
+                     pCache);
+    if (callStatus != LWMSG_STATUS_PENDING)
+    {
+        // Something changed already, or the call failed
+        RegClientCacheWatchComplete(pCall, callStatus, pCache);
+        return FALSE;
+    }
+
+    return TRUE;
+
+error:
+    if (pCall)
+    {
+        lwmsg_call_destroy_params(pCall, &out);
+        lwmsg_call_release(pCall);
+    }
+
+    pthread_mutex_lock(&pCache->Lock);
+    pCache->bArming = FALSE;
+    pthread_mutex_unlock(&pCache->Lock);
+
+    return FALSE;
+}
+
+NTSTATUS
+RegClientCacheCreate(
+    OUT PREG_CLIENT_CACHE* ppCache
+    )
+{
+    NTSTATUS status = 0;
+    PREG_CLIENT_CACHE pCache = NULL;
+
+    status = LW_RTL_ALLOCATE(&pCache, REG_CLIENT_CACHE, sizeof(*pCache));
+    BAIL_ON_NT_STATUS(status);
+
+    pthread_mutex_init(&pCache->Lock, NULL);
+    pCache->WatchOut.tag = LWMSG_TAG_INVALID;
+
+    status = LwRtlCreateHashTable(
+                 &pCache->pKeys,
+                 RegClientCacheGetKeyHandle,
+                 LwRtlHashDigestPointer,
+                 LwRtlHashEqualPointer,
+                 NULL,
+                 31);
+    BAIL_ON_NT_STATUS(status);
+
+    status = LwRtlCreateHashTable(
+                 &pCache->pValues,
+                 RegClientCacheGetValueId,
+                 RegClientCacheDigestValueId,
+                 RegClientCacheEqualValueId,
+                 NULL,
+                 127);
+    BAIL_ON_NT_STATUS(status);
+
+    *ppCache = pCache;
+
+cleanup:
+    return status;
+
+error:
+    RegClientCacheFree(&pCache);
+    *ppCache = NULL;
+
+    goto cleanup;
+}
+
+VOID
+RegClientCacheFree(
+    IN OUT PREG_CLIENT_CACHE* ppCache
+    )
+{
+    PREG_CLIENT_CACHE pCache = *ppCache;
+
+    if (pCache)
+    {
+        if (pCache->pKeys)
+        {
+            LwRtlHashTableClear(pCache->pKeys, RegClientCacheFreeKey, NULL);
+            LwRtlFreeHashTable(&pCache->pKeys);
+        }
+
+        if (pCache->pValues)
+        {
+            LwRtlHashTableClear(pCache->pValues, RegClientCacheFreeValue, NULL);
+            LwRtlFreeHashTable(&pCache->pValues);
+        }
+
+        pthread_mutex_destroy(&pCache->Lock);
+        LWREG_SAFE_FREE_MEMORY(pCache);
+        *ppCache = NULL;
+    }
+}
+
+VOID
+RegClientCacheAddKey(
+    IN HANDLE hConnection,
+    IN OPTIONAL HKEY hParentKey,
+    IN OPTIONAL PCWSTR pSubKey,
+    IN ACCESS_MASK AccessDesired,
+    IN HKEY hKey
+    )
+{
+    NTSTATUS status = 0;
+    PREG_CLIENT_CACHE pCache = ((PREG_CLIENT_CONNECTION_CONTEXT) hConnection)->pCache;
+    PREG_CLIENT_CACHE_KEY pKey = NULL;
+    PLW_HASHTABLE_NODE pPrevNode = NULL;
+
+    if (!pCache)
+    {
+        return;
+    }
+
+    status = LW_RTL_ALLOCATE(&pKey, REG_CLIENT_CACHE_KEY, sizeof(*pKey));
+    if (status)
+    {
+        return;
+    }
+
+    pKey->hKey = hKey;
+    pKey->bQueryValue =
+        (AccessDesired & (KEY_QUERY_VALUE | GENERIC_READ | GENERIC_ALL)) != 0;
+
+    pthread_mutex_lock(&pCache->Lock);
+
+    if (RegClientCacheBuildPath(pCache, hParentKey, pSubKey, FALSE, &pKey->pwszPath))
+    {
+        LwRtlHashTableResizeAndInsert(pCache->pKeys, &pKey->Node, &pPrevNode);
+        pKey = NULL;
+    }
+
+    pthread_mutex_unlock(&pCache->Lock);
+
+    if (pPrevNode)
+    {
+        RegClientCacheFreeKey(pPrevNode, NULL);
+    }
+
+    LWREG_SAFE_FREE_MEMORY(pKey);
+}
+
+VOID
+RegClientCacheRemoveKey(
+    IN HANDLE hConnection,
+    IN HKEY hKey
+    )
+{
+    PREG_CLIENT_CACHE pCache = ((PREG_CLIENT_CONNECTION_CONTEXT) hConnection)->pCache;
+    PLW_HASHTABLE_NODE pNode = NULL;
+
+    if (!pCache)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pCache->Lock);
+
+    if (!LwRtlHashTableFindKey(pCache->pKeys, &pNode, hKey))
+    {
+        LwRtlHashTableRemove(pCache->pKeys, pNode);
+    }
+    else
+    {
+        pNode = NULL;
+    }
+
+    pthread_mutex_unlock(&pCache->Lock);
+
+    if (pNode)
+    {
+        RegClientCacheFreeKey(pNode, NULL);
+    }
+}
+
+/*
+ * Finds the entry for a value of hKey\pSubKey.  With pPolicySubKey it
+ * is the entry for a config value, which hKey\pPolicySubKey overrides
+ * when set.  Caller holds pCache->Lock.
+ */
+static
+PREG_CLIENT_CACHE_VALUE
+RegClientCacheLookupLocked(
+    PREG_CLIENT_CACHE pCache,
+    HKEY hKey,
+    PCWSTR pSubKey,
+    PCWSTR pPolicySubKey,
+    PCWSTR pValueName,
+    REG_DATA_TYPE_FLAGS Flags
+    )
+{
+    REG_CLIENT_CACHE_VALUE_ID id = {0};
+    PLW_HASHTABLE_NODE pNode = NULL;
+
+    if (!RegClientCacheBuildPath(pCache, hKey, pSubKey, TRUE, &id.pwszPath) ||
+        (pPolicySubKey &&
+         !RegClientCacheBuildPath(pCache, hKey, pPolicySubKey, TRUE, &id.pwszPolicyPath)))
+    {
+        goto cleanup;
+    }
+
+    id.pwszValueName = (PWSTR) (pValueName ? pValueName : gwszEmpty);
+    id.Flags = Flags;
+
+    if (LwRtlHashTableFindKey(pCache->pValues, &pNode, &id))
+    {
+        pNode = NULL;
+    }
+
+cleanup:
+    LWREG_SAFE_FREE_MEMORY(id.pwszPath);
+    LWREG_SAFE_FREE_MEMORY(id.pwszPolicyPath);
+
+    return pNode ? LW_STRUCT_FROM_FIELD(pNode, REG_CLIENT_CACHE_VALUE, Node) : NULL;
+}
+
+/*
+ * Stores a lookup result unless the cache was flushed since Generation
+ * was handed out.  pvData may only be NULL when cbData is 0.
+ */
+static
+VOID
+RegClientCacheStore(
+    PREG_CLIENT_CACHE pCache,
+    ULONG64 Generation,
+    HKEY hKey,
+    PCWSTR pSubKey,
+    PCWSTR pPolicySubKey,
+    PCWSTR pValueName,
+    REG_DATA_TYPE_FLAGS Flags,
+    NTSTATUS status,
+    DWORD dwType,
+    const VOID* pvData,
+    DWORD cbData
+    )
+{
+    NTSTATUS allocStatus = 0;
+    PREG_CLIENT_CACHE_VALUE pValue = NULL;
+    PLW_HASHTABLE_NODE pPrevNode = NULL;
+
+    if (!Generation)
+    {
+        return;
+    }
+
+    if (status)
+    {
+        // Errors such as access denied or a full buffer are not kept
+        if (status != STATUS_OBJECT_NAME_NOT_FOUND)
+        {
+            return;
+        }
+
+        dwType = REG_NONE;
+        cbData = 0;
+    }
+    else if (cbData > REG_CLIENT_CACHE_MAX_DATA)
+    {
+        return;
+    }
+
+    allocStatus = LW_RTL_ALLOCATE(&pValue, REG_CLIENT_CACHE_VALUE, sizeof(*pValue));
+    BAIL_ON_NT_STATUS(allocStatus);
+
+    allocStatus = LwRtlWC16StringDuplicate(
+                      &pValue->Id.pwszValueName,
+                      pValueName ? pValueName : gwszEmpty);
+    BAIL_ON_NT_STATUS(allocStatus);
+
+    if (cbData)
+    {
+        allocStatus = LW_RTL_ALLOCATE(&pValue->pData, BYTE, cbData);
+        BAIL_ON_NT_STATUS(allocStatus);
+
+        memcpy(pValue->pData, pvData, cbData);
+    }
+
+    pValue->Id.Flags = Flags;
+    pValue->status = status;
+    pValue->dwType = dwType;
+    pValue->cbData = cbData;
+
+    pthread_mutex_lock(&pCache->Lock);
+
+    if (pCache->bWatching &&
+        Generation == pCache->Generation &&
+        RegClientCacheBuildPath(pCache, hKey, pSubKey, TRUE, &pValue->Id.pwszPath) &&
+        (!pPolicySubKey ||
+         RegClientCacheBuildPath(pCache, hKey, pPolicySubKey, TRUE, &pValue->Id.pwszPolicyPath)))
+    {
+        if (LwRtlHashTableGetCount(pCache->pValues) >= REG_CLIENT_CACHE_MAX_VALUES)
+        {
+            LwRtlHashTableClear(pCache->pValues, RegClientCacheFreeValue, NULL);
+        }
+
+        LwRtlHashTableResizeAndInsert(pCache->pValues, &pValue->Node, &pPrevNode);
+        pValue = NULL;
+    }
+
+    pthread_mutex_unlock(&pCache->Lock);
+
+    if (pPrevNode)
+    {
+        RegClientCacheFreeValue(pPrevNode, NULL);
+    }
+
+error:
+    if (pValue)
+    {
+        RegClientCacheFreeValue(&pValue->Node, NULL);
+    }
+}
+
+BOOLEAN
+RegClientCacheGetValue(
+    IN HANDLE hConnection,
+    IN HKEY hKey,
+    IN OPTIONAL PCWSTR pSubKey,
+    IN OPTIONAL PCWSTR pValueName,
+    IN REG_DATA_TYPE_FLAGS Flags,
+    OUT OPTIONAL PDWORD pdwType,
+    OUT OPTIONAL PVOID pvData,
+    IN OUT OPTIONAL PDWORD pcbData,
+    OUT PNTSTATUS pStatus,
+    OUT PULONG64 pGeneration
+    )
+{
+    PREG_CLIENT_CONNECTION_CONTEXT pContext = hConnection;
+    PREG_CLIENT_CACHE pCache = pContext->pCache;
+    PREG_CLIENT_CACHE_VALUE pValue = NULL;
+    BOOLEAN bHit = FALSE;
+
+    *pGeneration = 0;
+
+    if (!pCache || (pvData && !pcbData) || !RegClientCacheWatch(pContext))
+    {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&pCache->Lock);
+
+    if (!pCache->bWatching)
+    {
+        goto cleanup;
+    }
+
+    *pGeneration = pCache->Generation;
+
+    pValue = RegClientCacheLookupLocked(
+                 pCache,
+                 hKey,
+                 pSubKey,
+                 NULL,
+                 pValueName,
+                 Flags);
+    if (!pValue)
+    {
+        goto cleanup;
+    }
+
+    if (pValue->status)
+    {
+        *pStatus = pValue->status;
+        bHit = TRUE;
+    }
+    else if (!pvData || *pcbData >= pValue->cbData)
+    {
+        if (pdwType)
+        {
+            *pdwType = pValue->dwType;
+        }
+
+        if (pvData)
+        {
+            memcpy(pvData, pValue->pData, pValue->cbData);
+        }
+
+        if (pcbData)
+        {
+            *pcbData = pValue->cbData;
+        }
+
+        *pStatus = STATUS_SUCCESS;
+        bHit = TRUE;
+    }
+
+cleanup:
+    pthread_mutex_unlock(&pCache->Lock);
+
+    return bHit;
+}
+
+VOID
+RegClientCachePutValue(
+    IN HANDLE hConnection,
+    IN ULONG64 Generation,
+    IN HKEY hKey,
+    IN OPTIONAL PCWSTR pSubKey,
+    IN OPTIONAL PCWSTR pValueName,
+    IN REG_DATA_TYPE_FLAGS Flags,
+    IN NTSTATUS status,
+    IN DWORD dwType,
+    IN OPTIONAL const VOID* pvData,
+    IN DWORD cbData
+    )
+{
+    PREG_CLIENT_CACHE pCache = ((PREG_CLIENT_CONNECTION_CONTEXT) hConnection)->pCache;
+
+    // Without the data only the size is known
+    if (!pCache || (!status && !pvData))
+    {
+        return;
+    }
+
+    RegClientCacheStore(
+        pCache,
+        Generation,
+        hKey,
+        pSubKey,
+        NULL,
+        pValueName,
+        Flags,
+        status,
+        dwType,
+        pvData,
+        cbData);
+}
+
+BOOLEAN
+RegClientCacheGetConfigValue(
+    IN HANDLE hConnection,
+    IN HKEY hKey,
+    IN PCWSTR pConfigKey,
+    IN OPTIONAL PCWSTR pPolicyKey,
+    IN PREG_IPC_CONFIG_VALUE_NAME pName,
+    OUT PREG_IPC_CONFIG_VALUE pValue,
+    OUT PULONG64 pGeneration
+    )
+{
+    PREG_CLIENT_CONNECTION_CONTEXT pContext = hConnection;
+    PREG_CLIENT_CACHE pCache = pContext->pCache;
+    PREG_CLIENT_CACHE_VALUE pCached = NULL;
+    PBYTE pData = NULL;
+    BOOLEAN bHit = FALSE;
+
+    *pGeneration = 0;
+
+    if (!pCache || !RegClientCacheWatch(pContext))
+    {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&pCache->Lock);
+
+    if (!pCache->bWatching)
+    {
+        goto cleanup;
+    }
+
+    *pGeneration = pCache->Generation;
+
+    pCached = RegClientCacheLookupLocked(
+                  pCache,
+                  hKey,
+                  pConfigKey,
+                  pName->bUsePolicy ? pPolicyKey : NULL,
+                  pName->pValueName,
+                  pName->Flags);
+    if (!pCached ||
+        (pCached->cbData &&
+         LW_RTL_ALLOCATE(&pData, BYTE, pCached->cbData)))
+    {
+        goto cleanup;
+    }
+
+    if (pCached->cbData)
+    {
+        memcpy(pData, pCached->pData, pCached->cbData);
+    }
+
+    pValue->status = pCached->status;
+    pValue->dwType = pCached->dwType;
+    pValue->cbData = pCached->cbData;
+    pValue->pvData = pData;
+    bHit = TRUE;
+
+cleanup:
+    pthread_mutex_unlock(&pCache->Lock);
+
+    return bHit;
+}
+
+VOID
+RegClientCachePutConfigValue(
+    IN HANDLE hConnection,
+    IN ULONG64 Generation,
+    IN HKEY hKey,
+    IN PCWSTR pConfigKey,
+    IN OPTIONAL PCWSTR pPolicyKey,
+    IN PREG_IPC_CONFIG_VALUE_NAME pName,
+    IN const REG_IPC_CONFIG_VALUE* pValue
+    )
+{
+    PREG_CLIENT_CACHE pCache = ((PREG_CLIENT_CONNECTION_CONTEXT) hConnection)->pCache;
+
+    if (!pCache)
+    {
+        return;
+    }
+
+    RegClientCacheStore(
+        pCache,
+        Generation,
+        hKey,
+        pConfigKey,
+        pName->bUsePolicy ? pPolicyKey : NULL,
+        pName->pValueName,
+        pName->Flags,
+        pValue->status,
+        pValue->dwType,
+        pValue->pvData,
+        pValue->cbData);
+}
+
+VOID
+RegClientCacheFlush(
+    IN HANDLE hConnection
+    )
+{
+    PREG_CLIENT_CACHE pCache = ((PREG_CLIENT_CONNECTION_CONTEXT) hConnection)->pCache;
+
+    if (pCache)
+    {
+        pthread_mutex_lock(&pCache->Lock);
+        RegClientCacheFlushLocked(pCache);
+        pthread_mutex_unlock(&pCache->Lock);
+    }
+}
@@ -0,0 +1,135 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ * -*- mode: c, c-basic-offset: 4 -*- */
+
+/*
+ * Copyright Likewise Software    2004-2008
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the license, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.  You should have received a copy
+ * of the GNU Lesser General Public License along with this program.  If
+ * not, see <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * LESSER GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        clientcache_p.h
+ *
+ * Abstract:
+ *
+ *        Registry Subsystem
+ *
+ *        Private Header (Library)
+ *
+ *        Client-side value cache
+ */
+#ifndef __CLIENTCACHE_P_H__
+#define __CLIENTCACHE_P_H__
+
+/* Flushed wholesale when full */
+#define REG_CLIENT_CACHE_MAX_VALUES 1024
+
+/* Larger values are always fetched from the server */
+#define REG_CLIENT_CACHE_MAX_DATA 4096
+
+NTSTATUS
+RegClientCacheCreate(
+    OUT PREG_CLIENT_CACHE* ppCache
+    );
+
+VOID
+RegClientCacheFree(
+    IN OUT PREG_CLIENT_CACHE* ppCache
+    );
+
+VOID
+RegClientCacheAddKey(
+    IN HANDLE hConnection,
+    IN OPTIONAL HKEY hParentKey,
+    IN OPTIONAL PCWSTR pSubKey,
+    IN ACCESS_MASK AccessDesired,
+    IN HKEY hKey
+    );
+
+VOID
+RegClientCacheRemoveKey(
+    IN HANDLE hConnection,
+    IN HKEY hKey
+    );
+
+BOOLEAN
+RegClientCacheGetValue(
+    IN HANDLE hConnection,
+    IN HKEY hKey,
+    IN OPTIONAL PCWSTR pSubKey,
+    IN OPTIONAL PCWSTR pValueName,
+    IN REG_DATA_TYPE_FLAGS Flags,
+    OUT OPTIONAL PDWORD pdwType,
+    OUT OPTIONAL PVOID pvData,
+    IN OUT OPTIONAL PDWORD pcbData,
+    OUT PNTSTATUS pStatus,
+    OUT PULONG64 pGeneration
+    );
+
+VOID
+RegClientCachePutValue(
+    IN HANDLE hConnection,
+    IN ULONG64 Generation,
+    IN HKEY hKey,
+    IN OPTIONAL PCWSTR pSubKey,
+    IN OPTIONAL PCWSTR pValueName,
+    IN REG_DATA_TYPE_FLAGS Flags,
+    IN NTSTATUS status,
+    IN DWORD dwType,
+    IN OPTIONAL const VOID* pvData,
+    IN DWORD cbData
+    );
+
+BOOLEAN
+RegClientCacheGetConfigValue(
+    IN HANDLE hConnection,
+    IN HKEY hKey,
+    IN PCWSTR pConfigKey,
+    IN OPTIONAL PCWSTR pPolicyKey,
+    IN PREG_IPC_CONFIG_VALUE_NAME pName,
+    OUT PREG_IPC_CONFIG_VALUE pValue,
+    OUT PULONG64 pGeneration
+    );
+
+VOID
+RegClientCachePutConfigValue(
+    IN HANDLE hConnection,
+    IN ULONG64 Generation,
+    IN HKEY hKey,
+    IN PCWSTR pConfigKey,
+    IN OPTIONAL PCWSTR pPolicyKey,
+    IN PREG_IPC_CONFIG_VALUE_NAME pName,
+    IN const REG_IPC_CONFIG_VALUE* pValue
+    );
+
+VOID
+RegClientCacheFlush(
+    IN HANDLE hConnection
+    );
+
+#endif /* __CLIENTCACHE_P_H__ */
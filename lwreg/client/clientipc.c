@@ -170,6 +170,41 @@ NtRegCloseServer(
     return;
 }
 
+DWORD
+RegEnableValueCache(
+    VOID
+    )
+{
+    return RegNtStatusToWin32Error(
+    		NtRegEnableValueCache());
+}
+
+NTSTATUS
+NtRegEnableValueCache(
+    VOID
+    )
+{
+    NTSTATUS status = 0;
+
+    pthread_mutex_lock(&gLock);
+
+    if (!gContext.pCache)
+    {
+        status = RegClientCacheCreate(&gContext.pCache);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+cleanup:
+
+    pthread_mutex_unlock(&gLock);
+
+    return status;
+
+error:
+
+    goto cleanup;
+}
+
 static
 __attribute__((constructor))
 VOID
@@ -199,6 +234,8 @@ NtRegCloseServerOnce(
             lwmsg_protocol_delete(gContext.pProtocol);
         }
 
+        RegClientCacheFree(&gContext.pCache);
+
         memset(&gContext, 0, sizeof(gContext));
     }
 }
@@ -364,6 +401,13 @@ RegTransactCreateKeyExW(
                 *pdwDisposition = pCreateKeyExResp->dwDisposition;
             }
 
+            if (pCreateKeyExResp->dwDisposition == REG_CREATED_NEW_KEY)
+            {
+                RegClientCacheFlush(hConnection);
+            }
+
+            RegClientCacheAddKey(hConnection, hKey, pSubKey, AccessDesired, *phkResult);
+
             break;
         case REG_R_ERROR:
             pStatus = (PREG_IPC_STATUS) out.data;
@@ -431,6 +475,8 @@ RegTransactOpenKeyExW(
             *phkResult = (HKEY) pOpenKeyExResp->hkResult;
             pOpenKeyExResp->hkResult = NULL;
 
+            RegClientCacheAddKey(hConnection, hKey, pwszSubKey, AccessDesired, *phkResult);
+
             break;
         case REG_R_ERROR:
             pStatus = (PREG_IPC_STATUS) out.data;
@@ -470,6 +516,9 @@ RegTransactCloseKey(
     LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
     LWMsgCall* pCall = NULL;
 
+    // The handle may be reused as soon as the server closes it
+    RegClientCacheRemoveKey(hConnection, hKey);
+
     status = RegIpcAcquireCall(hConnection, &pCall);
     BAIL_ON_NT_STATUS(status);
 
@@ -559,6 +608,8 @@ RegTransactDeleteKeyW(
     }
 
 cleanup:
+    RegClientCacheFlush(hConnection);
+
     if (pCall)
     {
         lwmsg_call_destroy_params(pCall, &out);
@@ -765,6 +816,22 @@ RegTransactGetValueW(
     LWMsgParams in = LWMSG_PARAMS_INITIALIZER;
     LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
     LWMsgCall* pCall = NULL;
+    ULONG64 CacheGeneration = 0;
+
+    if (RegClientCacheGetValue(
+            hConnection,
+            hKey,
+            pSubKey,
+            pValue,
+            Flags,
+            pdwType,
+            pvData,
+            pcbData,
+            &status,
+            &CacheGeneration))
+    {
+        return status;
+    }
 
     status = RegIpcAcquireCall(hConnection, &pCall);
     BAIL_ON_NT_STATUS(status);
@@ -801,11 +868,36 @@ RegTransactGetValueW(
                 *pcbData = pGetValueResp->cbData;
             }
 
+            RegClientCachePutValue(
+                hConnection,
+                CacheGeneration,
+                hKey,
+                pSubKey,
+                pValue,
+                Flags,
+                STATUS_SUCCESS,
+                pGetValueResp->dwType,
+                pvData ? pGetValueResp->pvData : NULL,
+                pGetValueResp->cbData);
+
             break;
 
         case REG_R_ERROR:
             pStatus = (PREG_IPC_STATUS) out.data;
             status = pStatus->status;
+
+            RegClientCachePutValue(
+                hConnection,
+                CacheGeneration,
+                hKey,
+                pSubKey,
+                pValue,
+                Flags,
+                status,
+                REG_NONE,
+                NULL,
+                0);
+
             BAIL_ON_NT_STATUS(status);
             break;
 
@@ -874,6 +966,8 @@ RegTransactDeleteKeyValueW(
     }
 
 cleanup:
+    RegClientCacheFlush(hConnection);
+
     if (pCall)
     {
         lwmsg_call_destroy_params(pCall, &out);
@@ -930,6 +1024,8 @@ RegTransactDeleteTreeW(
     }
 
 cleanup:
+    RegClientCacheFlush(hConnection);
+
     if (pCall)
     {
         lwmsg_call_destroy_params(pCall, &out);
@@ -986,6 +1082,8 @@ RegTransactDeleteValueW(
     }
 
 cleanup:
+    RegClientCacheFlush(hConnection);
+
     if (pCall)
     {
         lwmsg_call_destroy_params(pCall, &out);
@@ -1235,6 +1333,8 @@ RegTransactSetValueExW(
     }
 
 cleanup:
+    RegClientCacheFlush(hConnection);
+
 	if (pCall)
 	{
 		lwmsg_call_destroy_params(pCall, &out);
@@ -1296,6 +1396,8 @@ RegTransactSetKeySecurity(
     }
 
 cleanup:
+    RegClientCacheFlush(hConnection);
+
 	if (pCall)
 	{
 		lwmsg_call_destroy_params(pCall, &out);
@@ -1431,6 +1533,8 @@ RegTransactSetValueAttributesW(
     }
 
 cleanup:
+    RegClientCacheFlush(hRegConnection);
+
     if (pCall)
     {
         lwmsg_call_destroy_params(pCall, &out);
@@ -1574,6 +1678,164 @@ RegTransactDeleteValueAttributesW(
             BAIL_ON_NT_STATUS(status);
     }
 
+cleanup:
+    RegClientCacheFlush(hRegConnection);
+
+    if (pCall)
+    {
+        lwmsg_call_destroy_params(pCall, &out);
+        lwmsg_call_release(pCall);
+    }
+
+    return status;
+
+error:
+    goto cleanup;
+}
+
+/*
+ * Values found in the client cache are not requested again; only the
+ * rest go to the server, and its answers are added to the cache.
+ */
+NTSTATUS
+RegTransactGetConfigValuesW(
+    IN HANDLE hRegConnection,
+    IN HKEY hKey,
+    IN PCWSTR pwszConfigKey,
+    IN OPTIONAL PCWSTR pwszPolicyKey,
+    IN DWORD dwValueCount,
+    IN PREG_IPC_CONFIG_VALUE_NAME pValueNames,
+    OUT PREG_IPC_CONFIG_VALUE* ppValues
+    )
+{
+    NTSTATUS status = 0;
+    REG_IPC_GET_CONFIG_VALUES_REQ GetConfigValuesReq = {0};
+    PREG_IPC_GET_CONFIG_VALUES_RESPONSE pGetConfigValuesResp = NULL;
+    // Do not free pStatus
+    PREG_IPC_STATUS pStatus = NULL;
+    PREG_IPC_CONFIG_VALUE pValues = NULL;
+    PREG_IPC_CONFIG_VALUE_NAME pMissedNames = NULL;
+    PDWORD pdwMissedIndexes = NULL;
+    DWORD dwMissedCount = 0;
+    DWORD dwIndex = 0;
+    ULONG64 CacheGeneration = 0;
+    ULONG64 EntryGeneration = 0;
+
+    LWMsgParams in = LWMSG_PARAMS_INITIALIZER;
+    LWMsgParams out = LWMSG_PARAMS_INITIALIZER;
+    LWMsgCall* pCall = NULL;
+
+    if (dwValueCount)
+    {
+        status = LW_RTL_ALLOCATE(
+                     &pValues,
+                     REG_IPC_CONFIG_VALUE,
+                     sizeof(*pValues) * dwValueCount);
+        BAIL_ON_NT_STATUS(status);
+
+        status = LW_RTL_ALLOCATE(
+                     &pMissedNames,
+                     REG_IPC_CONFIG_VALUE_NAME,
+                     sizeof(*pMissedNames) * dwValueCount);
+        BAIL_ON_NT_STATUS(status);
+
+        status = LW_RTL_ALLOCATE(
+                     &pdwMissedIndexes,
+                     DWORD,
+                     sizeof(*pdwMissedIndexes) * dwValueCount);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    for (dwIndex = 0; dwIndex < dwValueCount; dwIndex++)
+    {
+        BOOLEAN bHit = RegClientCacheGetConfigValue(
+                           hRegConnection,
+                           hKey,
+                           pwszConfigKey,
+                           pwszPolicyKey,
+                           &pValueNames[dwIndex],
+                           &pValues[dwIndex],
+                           &EntryGeneration);
+
+        // Answers are only stored if nothing was flushed meanwhile
+        if (EntryGeneration != CacheGeneration)
+        {
+            CacheGeneration = dwIndex ? 0 : EntryGeneration;
+        }
+
+        if (!bHit)
+        {
+            pMissedNames[dwMissedCount] = pValueNames[dwIndex];
+            pdwMissedIndexes[dwMissedCount] = dwIndex;
+            dwMissedCount++;
+        }
+    }
+
+    if (!dwMissedCount)
+    {
+        *ppValues = pValues;
+        pValues = NULL;
+        goto cleanup;
+    }
+
+    status = RegIpcAcquireCall(hRegConnection, &pCall);
+    BAIL_ON_NT_STATUS(status);
+
+    GetConfigValuesReq.hKey = (LWMsgHandle*) hKey;
+    GetConfigValuesReq.pConfigKey = pwszConfigKey;
+    GetConfigValuesReq.pPolicyKey = pwszPolicyKey;
+    GetConfigValuesReq.dwValueCount = dwMissedCount;
+    GetConfigValuesReq.pValueNames = pMissedNames;
+
+    in.tag = REG_Q_GET_CONFIG_VALUESW;
+    in.data = &GetConfigValuesReq;
+
+    status = MAP_LWMSG_ERROR(lwmsg_call_dispatch(pCall, &in, &out, NULL, NULL));
+    BAIL_ON_NT_STATUS(status);
+
+    switch (out.tag)
+    {
+        case REG_R_GET_CONFIG_VALUESW:
+            pGetConfigValuesResp = (PREG_IPC_GET_CONFIG_VALUES_RESPONSE) out.data;
+
+            if (pGetConfigValuesResp->dwValueCount != dwMissedCount)
+            {
+                status = STATUS_INVALID_NETWORK_RESPONSE;
+                BAIL_ON_NT_STATUS(status);
+            }
+
+            for (dwIndex = 0; dwIndex < dwMissedCount; dwIndex++)
+            {
+                PREG_IPC_CONFIG_VALUE pValue = &pValues[pdwMissedIndexes[dwIndex]];
+
+                *pValue = pGetConfigValuesResp->pValues[dwIndex];
+                pGetConfigValuesResp->pValues[dwIndex].pvData = NULL;
+
+                RegClientCachePutConfigValue(
+                    hRegConnection,
+                    CacheGeneration,
+                    hKey,
+                    pwszConfigKey,
+                    pwszPolicyKey,
+                    &pMissedNames[dwIndex],
+                    pValue);
+            }
+            break;
+
+        case REG_R_ERROR:
+            pStatus = (PREG_IPC_STATUS) out.data;
+            status = pStatus->status;
+            BAIL_ON_NT_STATUS(status);
+            break;
+
+        default:
+            status = STATUS_INVALID_PARAMETER;
+            BAIL_ON_NT_STATUS(status);
+    }
+
+    *ppValues = pValues;
+    pValues = NULL;
+
 cleanup:
     if (pCall)
     {
@@ -1581,11 +1843,33 @@ cleanup:
         lwmsg_call_release(pCall);
     }
 
+    RegTransactFreeConfigValues(dwValueCount, &pValues);
+    LWREG_SAFE_FREE_MEMORY(pMissedNames);
+    LWREG_SAFE_FREE_MEMORY(pdwMissedIndexes);
+
     return status;
 
 error:
     goto cleanup;
 }
+
+VOID
+RegTransactFreeConfigValues(
+    IN DWORD dwValueCount,
+    IN OUT PREG_IPC_CONFIG_VALUE* ppValues
+    )
+{
+    DWORD dwIndex = 0;
+
+    if (*ppValues)
+    {
+        for (dwIndex = 0; dwIndex < dwValueCount; dwIndex++)
+        {
+            LWREG_SAFE_FREE_MEMORY((*ppValues)[dwIndex].pvData);
+        }
+        LWREG_SAFE_FREE_MEMORY(*ppValues);
+    }
+}
 /*
 local variables:
 mode: c
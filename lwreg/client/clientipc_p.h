@@ -52,11 +52,15 @@
 
 #include <lwmsg/lwmsg.h>
 
+typedef struct _REG_CLIENT_CACHE *PREG_CLIENT_CACHE;
+
 typedef struct __REG_CLIENT_CONNECTION_CONTEXT
 {
     LWMsgProtocol* pProtocol;
     LWMsgPeer* pClient;
     LWMsgSession* pSession;
+    // Set once by NtRegEnableValueCache, NULL while caching is off
+    PREG_CLIENT_CACHE pCache;
 } REG_CLIENT_CONNECTION_CONTEXT, *PREG_CLIENT_CONNECTION_CONTEXT;
 
 NTSTATUS
@@ -246,5 +250,22 @@ RegTransactDeleteValueAttributesW(
     IN PCWSTR pwszValueName
     );
 
+NTSTATUS
+RegTransactGetConfigValuesW(
+    IN HANDLE hRegConnection,
+    IN HKEY hKey,
+    IN PCWSTR pwszConfigKey,
+    IN OPTIONAL PCWSTR pwszPolicyKey,
+    IN DWORD dwValueCount,
+    IN PREG_IPC_CONFIG_VALUE_NAME pValueNames,
+    OUT PREG_IPC_CONFIG_VALUE* ppValues
+    );
+
+VOID
+RegTransactFreeConfigValues(
+    IN DWORD dwValueCount,
+    IN OUT PREG_IPC_CONFIG_VALUE* ppValues
+    );
+
 #endif /* __CLIENTIPC_P_H__ */
 
@@ -211,6 +211,316 @@ error:
     goto cleanup;
 }
 
+static
+REG_DATA_TYPE_FLAGS
+NtRegConfigTypeFlags(
+    LWREG_CONFIG_TYPE Type
+    )
+{
+    switch (Type)
+    {
+        case LwRegTypeString:
+        case LwRegTypeEnum:
+            return RRF_RT_REG_SZ;
+
+        case LwRegTypeMultiString:
+            return RRF_RT_REG_MULTI_SZ;
+
+        case LwRegTypeDword:
+        case LwRegTypeBoolean:
+            return RRF_RT_REG_DWORD;
+
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Converts a REG_SZ or REG_MULTI_SZ value returned by the server to
+ * its ANSI form, mirroring what NtRegGetValueA would have returned.
+ */
+static
+NTSTATUS
+NtRegConvertConfigString(
+    PREG_IPC_CONFIG_VALUE pValue,
+    PSTR* ppszValue,
+    PDWORD pdwSize
+    )
+{
+    NTSTATUS ntStatus = STATUS_SUCCESS;
+    PWSTR pwszValue = NULL;
+    PSTR pszValue = NULL;
+    DWORD dwSize = 0;
+
+    if (pValue->dwType == REG_MULTI_SZ)
+    {
+        ntStatus = NtRegConvertByteStreamW2A(
+                       pValue->pvData,
+                       pValue->cbData,
+                       (PBYTE*)&pszValue,
+                       &dwSize);
+        BAIL_ON_NT_STATUS(ntStatus);
+    }
+    else
+    {
+        // The server does not guarantee termination
+        ntStatus = LW_RTL_ALLOCATE(
+                       &pwszValue,
+                       WCHAR,
+                       pValue->cbData + sizeof(WCHAR));
+        BAIL_ON_NT_STATUS(ntStatus);
+
+        memcpy(pwszValue, pValue->pvData, pValue->cbData);
+
+        ntStatus = LwRtlCStringAllocateFromWC16String(&pszValue, pwszValue);
+        BAIL_ON_NT_STATUS(ntStatus);
+
+        dwSize = strlen(pszValue) + 1;
+    }
+
+    *ppszValue = pszValue;
+    pszValue = NULL;
+    *pdwSize = dwSize;
+
+cleanup:
+    LW_RTL_FREE(&pwszValue);
+    LW_RTL_FREE(&pszValue);
+
+    return ntStatus;
+
+error:
+    goto cleanup;
+}
+
+static
+NTSTATUS
+NtRegApplyConfigString(
+    PREG_IPC_CONFIG_VALUE pValue,
+    DWORD dwType,
+    PSTR* ppszValue,
+    PDWORD pdwSize
+    )
+{
+    NTSTATUS ntStatus = STATUS_SUCCESS;
+    PSTR pszValue = NULL;
+    DWORD dwSize = 0;
+
+    // Missing, empty and mistyped values leave the default in place
+    if (pValue->status || !pValue->cbData || pValue->dwType != dwType)
+    {
+        goto cleanup;
+    }
+
+    ntStatus = NtRegConvertConfigString(pValue, &pszValue, &dwSize);
+    BAIL_ON_NT_STATUS(ntStatus);
+
+    LwRtlCStringFree(ppszValue);
+    *ppszValue = pszValue;
+    pszValue = NULL;
+
+    if (pdwSize)
+    {
+        *pdwSize = dwSize;
+    }
+
+cleanup:
+    LwRtlCStringFree(&pszValue);
+
+    return ntStatus;
+
+error:
+    goto cleanup;
+}
+
+static
+NTSTATUS
+NtRegApplyConfigDword(
+    PREG_IPC_CONFIG_VALUE pValue,
+    DWORD dwMin,
+    DWORD dwMax,
+    PDWORD pdwValue
+    )
+{
+    NTSTATUS ntStatus = pValue->status;
+    DWORD dwValue = 0;
+
+    if (ntStatus == STATUS_OBJECT_NAME_NOT_FOUND)
+    {
+        ntStatus = STATUS_SUCCESS;
+        goto cleanup;
+    }
+    BAIL_ON_NT_STATUS(ntStatus);
+
+    if (pValue->dwType != REG_DWORD || pValue->cbData != sizeof(dwValue))
+    {
+        ntStatus = STATUS_OBJECT_TYPE_MISMATCH;
+        BAIL_ON_NT_STATUS(ntStatus);
+    }
+
+    memcpy(&dwValue, pValue->pvData, sizeof(dwValue));
+
+    /* clamp the value to the specified range */
+    if (dwMin > dwValue) {
+        dwValue = dwMin;
+    }
+
+    if (dwMax < dwValue) {
+        dwValue = dwMax;
+    }
+
+    *pdwValue = dwValue;
+
+cleanup:
+    return ntStatus;
+
+error:
+    goto cleanup;
+}
+
+static
+NTSTATUS
+NtRegApplyConfigEnum(
+    PREG_IPC_CONFIG_VALUE pValue,
+    DWORD   dwMin,
+    DWORD   dwMax,
+    const PCSTR   *ppszEnumNames,
+    PDWORD  pdwValue
+    )
+{
+    NTSTATUS ntStatus = STATUS_SUCCESS;
+    PSTR pszValue = NULL;
+    DWORD dwEnumIndex = 0;
+
+    ntStatus = NtRegApplyConfigString(pValue, REG_SZ, &pszValue, NULL);
+    BAIL_ON_NT_STATUS(ntStatus);
+
+    if (pszValue != NULL )
+    {
+        for (dwEnumIndex = 0;
+             dwEnumIndex <= dwMax - dwMin;
+             dwEnumIndex++)
+        {
+            if(LwRtlCStringCompare(
+                   pszValue,
+                   ppszEnumNames[dwEnumIndex], FALSE) == 0)
+            {
+                *pdwValue = dwEnumIndex + dwMin;
+                break;
+            }
+        }
+    }
+
+cleanup:
+    LwRtlCStringFree(&pszValue);
+
+    return ntStatus;
+
+error:
+    goto cleanup;
+}
+
+/*
+ * Fetches every value of a config table, with the policy overlay
+ * applied by the server, in a single round trip.  Entries of
+ * unknown type are skipped; the returned values are in table order
+ * for the remaining ones.
+ */
+static
+NTSTATUS
+NtRegReadConfigValues(
+    PLWREG_CONFIG_REG pReg,
+    PLWREG_CONFIG_ITEM pConfig,
+    DWORD dwConfigEntries,
+    PDWORD pdwValueCount,
+    PREG_IPC_CONFIG_VALUE* ppValues
+    )
+{
+    NTSTATUS ntStatus = STATUS_SUCCESS;
+    PWSTR pwszConfigKey = NULL;
+    PWSTR pwszPolicyKey = NULL;
+    PREG_IPC_CONFIG_VALUE_NAME pNames = NULL;
+    PREG_IPC_CONFIG_VALUE pValues = NULL;
+    DWORD dwValueCount = 0;
+    DWORD dwEntry = 0;
+
+    ntStatus = LwRtlWC16StringAllocateFromCString(&pwszConfigKey, pReg->pszConfigKey);
+    BAIL_ON_NT_STATUS(ntStatus);
+
+    if (pReg->pszPolicyKey)
+    {
+        ntStatus = LwRtlWC16StringAllocateFromCString(&pwszPolicyKey, pReg->pszPolicyKey);
+        BAIL_ON_NT_STATUS(ntStatus);
+    }
+
+    if (dwConfigEntries)
+    {
+        ntStatus = LW_RTL_ALLOCATE(
+                       &pNames,
+                       REG_IPC_CONFIG_VALUE_NAME,
+                       sizeof(*pNames) * dwConfigEntries);
+        BAIL_ON_NT_STATUS(ntStatus);
+    }
+
+    for (dwEntry = 0; dwEntry < dwConfigEntries; dwEntry++)
+    {
+        if (!NtRegConfigTypeFlags(pConfig[dwEntry].Type))
+        {
+            continue;
+        }
+
+        if (pConfig[dwEntry].bUsePolicy && !pReg->pszPolicyKey)
+        {
+            ntStatus = STATUS_INVALID_PARAMETER;
+            BAIL_ON_NT_STATUS(ntStatus);
+        }
+
+        ntStatus = LwRtlWC16StringAllocateFromCString(
+                       (PWSTR*)&pNames[dwValueCount].pValueName,
+                       pConfig[dwEntry].pszName);
+        BAIL_ON_NT_STATUS(ntStatus);
+
+        pNames[dwValueCount].Flags = NtRegConfigTypeFlags(pConfig[dwEntry].Type);
+        pNames[dwValueCount].bUsePolicy = pConfig[dwEntry].bUsePolicy;
+        dwValueCount++;
+    }
+
+    if (dwValueCount)
+    {
+        ntStatus = RegTransactGetConfigValuesW(
+                       pReg->hConnection,
+                       pReg->hKey,
+                       pwszConfigKey,
+                       pwszPolicyKey,
+                       dwValueCount,
+                       pNames,
+                       &pValues);
+        BAIL_ON_NT_STATUS(ntStatus);
+    }
+
+    *pdwValueCount = dwValueCount;
+    *ppValues = pValues;
+
+cleanup:
+    if (pNames)
+    {
+        for (dwEntry = 0; dwEntry < dwValueCount; dwEntry++)
+        {
+            LW_RTL_FREE((PWSTR*)&pNames[dwEntry].pValueName);
+        }
+        LW_RTL_FREE(&pNames);
+    }
+    LW_RTL_FREE(&pwszConfigKey);
+    LW_RTL_FREE(&pwszPolicyKey);
+
+    return ntStatus;
+
+error:
+    *pdwValueCount = 0;
+    *ppValues = NULL;
+
+    goto cleanup;
+}
+
 NTSTATUS
 NtRegProcessConfig(
     PCSTR pszConfigKey,
@@ -222,6 +532,10 @@ NtRegProcessConfig(
     NTSTATUS ntStatus = STATUS_SUCCESS;
     DWORD dwEntry = 0;
     PLWREG_CONFIG_REG pReg = NULL;
+    PREG_IPC_CONFIG_VALUE pValues = NULL;
+    PREG_IPC_CONFIG_VALUE pValue = NULL;
+    DWORD dwValueCount = 0;
+    DWORD dwDwordValue = 0;
 
     ntStatus = NtRegOpenConfig(pszConfigKey, pszPolicyKey, &pReg);
     BAIL_ON_NT_STATUS(ntStatus);
@@ -231,52 +545,58 @@ NtRegProcessConfig(
         goto error;
     }
 
-    for (dwEntry = 0; dwEntry < dwConfigEntries; dwEntry++)
+    ntStatus = NtRegReadConfigValues(
+                   pReg,
+                   pConfig,
+                   dwConfigEntries,
+                   &dwValueCount,
+                   &pValues);
+    BAIL_ON_NT_STATUS(ntStatus);
+
+    for (dwEntry = 0, pValue = pValues; dwEntry < dwConfigEntries; dwEntry++)
     {
-        ntStatus = STATUS_SUCCESS;
         switch (pConfig[dwEntry].Type)
         {
             case LwRegTypeString:
-                ntStatus = NtRegReadConfigString(
-                            pReg,
-                            pConfig[dwEntry].pszName,
-                            pConfig[dwEntry].bUsePolicy,
+                ntStatus = NtRegApplyConfigString(
+                            pValue++,
+                            REG_SZ,
                             pConfig[dwEntry].pValue,
                             pConfig[dwEntry].pdwSize);
                 break;
 
             case LwRegTypeMultiString:
-                ntStatus = NtRegReadConfigMultiString(
-                            pReg,
-                            pConfig[dwEntry].pszName,
-                            pConfig[dwEntry].bUsePolicy,
+                ntStatus = NtRegApplyConfigString(
+                            pValue++,
+                            REG_MULTI_SZ,
                             pConfig[dwEntry].pValue,
                             pConfig[dwEntry].pdwSize);
                 break;
 
             case LwRegTypeDword:
-                ntStatus = NtRegReadConfigDword(
-                            pReg,
-                            pConfig[dwEntry].pszName,
-                            pConfig[dwEntry].bUsePolicy,
+                ntStatus = NtRegApplyConfigDword(
+                            pValue++,
                             pConfig[dwEntry].dwMin,
                             pConfig[dwEntry].dwMax,
                             pConfig[dwEntry].pValue);
                 break;
 
             case LwRegTypeBoolean:
-                ntStatus = NtRegReadConfigBoolean(
-                            pReg,
-                            pConfig[dwEntry].pszName,
-                            pConfig[dwEntry].bUsePolicy,
-                            pConfig[dwEntry].pValue);
+                dwDwordValue = *(PBOOLEAN)pConfig[dwEntry].pValue;
+                ntStatus = NtRegApplyConfigDword(
+                            pValue++,
+                            0,
+                            -1,
+                            &dwDwordValue);
+                if (!ntStatus)
+                {
+                    *(PBOOLEAN)pConfig[dwEntry].pValue = dwDwordValue ? TRUE : FALSE;
+                }
                 break;
 
             case LwRegTypeEnum:
-                ntStatus = NtRegReadConfigEnum(
-                            pReg,
-                            pConfig[dwEntry].pszName,
-                            pConfig[dwEntry].bUsePolicy,
+                ntStatus = NtRegApplyConfigEnum(
+                            pValue++,
                             pConfig[dwEntry].dwMin,
                             pConfig[dwEntry].dwMax,
                             pConfig[dwEntry].ppszEnumNames,
@@ -286,14 +606,12 @@ NtRegProcessConfig(
             default:
                 break;
         }
-        if (ntStatus == STATUS_OBJECT_NAME_NOT_FOUND)
-        {
-            ntStatus = STATUS_SUCCESS;
-        }
         BAIL_ON_NT_STATUS(ntStatus);
     }
 
 cleanup:
+    RegTransactFreeConfigValues(dwValueCount, &pValues);
+
     NtRegCloseConfig(pReg);
     pReg = NULL;
 
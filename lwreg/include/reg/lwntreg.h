@@ -60,6 +60,22 @@ LwNtRegCloseServer(
     IN HANDLE hConnection
     );
 
+/**
+ * Cache value reads made by this process
+ *
+ * Once enabled, values read through any connection of this process are
+ * kept in memory until the registry server reports a change to the
+ * tree.  Writes made by this process invalidate the cache as soon as
+ * they return, so they are always visible to subsequent reads.
+ * Enabling the cache more than once has no further effect.
+ *
+ * @return STATUS_SUCCESS, or appropriate error.
+ */
+NTSTATUS
+LwNtRegEnableValueCache(
+    VOID
+    );
+
 NTSTATUS
 LwNtRegEnumRootKeysA(
     IN HANDLE hNtRegConnection,
@@ -558,6 +574,7 @@ LwNtRegProcessConfigUsingAttributeRanges(
 #ifndef LW_STRICT_NAMESPACE
 #define NtRegOpenServer LwNtRegOpenServer
 #define NtRegCloseServer LwNtRegCloseServer
+#define NtRegEnableValueCache LwNtRegEnableValueCache
 #define NtRegEnumRootKeysA LwNtRegEnumRootKeysA
 #define NtRegEnumRootKeysW LwNtRegEnumRootKeysW
 #define NtRegEnumRootKeys LwNtRegEnumRootKeys
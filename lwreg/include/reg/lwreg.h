@@ -87,6 +87,22 @@ LwRegCloseServer(
     IN HANDLE hConnection
     );
 
+/**
+ * Cache value reads made by this process
+ *
+ * Once enabled, values read through any connection of this process are
+ * kept in memory until the registry server reports a change to the
+ * tree.  Writes made by this process invalidate the cache as soon as
+ * they return, so they are always visible to subsequent reads.
+ * Enabling the cache more than once has no further effect.
+ *
+ * @return LWREG_ERROR_SUCCESS, or appropriate error.
+ */
+DWORD
+LwRegEnableValueCache(
+    VOID
+    );
+
 DWORD
 LwRegEnumRootKeysA(
     IN HANDLE hRegConnection,
@@ -590,6 +606,7 @@ LwRegProcessConfigUsingAttributeRanges(
 #ifndef LW_STRICT_NAMESPACE
 #define RegOpenServer LwRegOpenServer
 #define RegCloseServer LwRegCloseServer
+#define RegEnableValueCache LwRegEnableValueCache
 #define RegEnumRootKeysA LwRegEnumRootKeysA
 #define RegEnumRootKeysW LwRegEnumRootKeysW
 #define RegEnumRootKeys LwRegEnumRootKeys
@@ -94,7 +94,11 @@ typedef enum __REG_IPC_TAG
     REG_Q_GET_VALUEW_ATTRIBUTES,
     REG_R_GET_VALUEW_ATTRIBUTES,
     REG_Q_DELETE_VALUEW_ATTRIBUTES,
-    REG_R_DELETE_VALUEW_ATTRIBUTES
+    REG_R_DELETE_VALUEW_ATTRIBUTES,
+    REG_Q_GET_CONFIG_VALUESW,
+    REG_R_GET_CONFIG_VALUESW,
+    REG_Q_WAIT_CHANGE,
+    REG_R_WAIT_CHANGE
 } REG_IPC_TAG;
 
 /* Opaque type -- actual definition in state_p.h - LSA_SRV_ENUM_STATE */
@@ -513,6 +517,66 @@ typedef struct __REG_IPC_GET_VALUE_ATTRS_RESPONSE
     PLWREG_VALUE_ATTRIBUTES pValueAttributes;
 } REG_IPC_GET_VALUE_ATTRS_RESPONSE, *PREG_IPC_GET_VALUE_ATTRS_RESPONSE;
 
+/******************************************************************************/
+
+// IN HKEY hKey,
+// IN PCWSTR pConfigKey,
+// IN OPTIONAL PCWSTR pPolicyKey,
+// IN DWORD dwValueCount,
+// IN PREG_IPC_CONFIG_VALUE_NAME pValueNames
+
+typedef struct __REG_IPC_CONFIG_VALUE_NAME
+{
+    PCWSTR pValueName;
+    REG_DATA_TYPE_FLAGS Flags;
+    BOOLEAN bUsePolicy;
+} REG_IPC_CONFIG_VALUE_NAME, *PREG_IPC_CONFIG_VALUE_NAME;
+
+typedef struct __REG_IPC_GET_CONFIG_VALUES_REQ
+{
+    LWMsgHandle* hKey;
+    PCWSTR pConfigKey;
+    PCWSTR pPolicyKey;
+    DWORD dwValueCount;
+    PREG_IPC_CONFIG_VALUE_NAME pValueNames;
+} REG_IPC_GET_CONFIG_VALUES_REQ, *PREG_IPC_GET_CONFIG_VALUES_REQ;
+
+// One entry per requested name, in request order.  The policy key
+// value is returned when bUsePolicy was set and it exists and is not
+// empty, otherwise the config key value.  status is the result of the
+// final lookup, e.g. STATUS_OBJECT_NAME_NOT_FOUND.
+
+typedef struct __REG_IPC_CONFIG_VALUE
+{
+    NTSTATUS status;
+    DWORD dwType;
+    DWORD cbData;
+    PBYTE pvData;
+} REG_IPC_CONFIG_VALUE, *PREG_IPC_CONFIG_VALUE;
+
+typedef struct __REG_IPC_GET_CONFIG_VALUES_RESPONSE
+{
+    DWORD dwValueCount;
+    PREG_IPC_CONFIG_VALUE pValues;
+} REG_IPC_GET_CONFIG_VALUES_RESPONSE, *PREG_IPC_GET_CONFIG_VALUES_RESPONSE;
+
+/******************************************************************************/
+
+// The server counts successful writes.  A wait request completes as
+// soon as the count differs from Generation, which may be right away,
+// and returns the count at that time.  Clients that do not know the
+// count yet pass 0, which never matches.
+
+typedef struct __REG_IPC_WAIT_CHANGE_REQ
+{
+    ULONG64 Generation;
+} REG_IPC_WAIT_CHANGE_REQ, *PREG_IPC_WAIT_CHANGE_REQ;
+
+typedef struct __REG_IPC_WAIT_CHANGE_RESPONSE
+{
+    ULONG64 Generation;
+} REG_IPC_WAIT_CHANGE_RESPONSE, *PREG_IPC_WAIT_CHANGE_RESPONSE;
+
 
 
 
@@ -807,6 +807,112 @@ static LWMsgTypeSpec gRegGetValueAttrsResp[] =
 };
 
 
+/******************************************************************************/
+
+static LWMsgTypeSpec gRegConfigValueNameSpec[] =
+{
+    // PCWSTR pValueName;
+    // REG_DATA_TYPE_FLAGS Flags;
+    // BOOLEAN bUsePolicy;
+
+    LWMSG_STRUCT_BEGIN(REG_IPC_CONFIG_VALUE_NAME),
+
+    LWMSG_MEMBER_PWSTR(REG_IPC_CONFIG_VALUE_NAME, pValueName),
+    LWMSG_ATTR_NOT_NULL,
+    LWMSG_MEMBER_UINT32(REG_IPC_CONFIG_VALUE_NAME, Flags),
+    LWMSG_MEMBER_UINT8(REG_IPC_CONFIG_VALUE_NAME, bUsePolicy),
+
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec gRegGetConfigValuesSpec[] =
+{
+    // HKEY hKey;
+    // PCWSTR pConfigKey;
+    // PCWSTR pPolicyKey;
+    // DWORD dwValueCount;
+    // PREG_IPC_CONFIG_VALUE_NAME pValueNames;
+
+    LWMSG_STRUCT_BEGIN(REG_IPC_GET_CONFIG_VALUES_REQ),
+
+    LWMSG_MEMBER_HANDLE(REG_IPC_GET_CONFIG_VALUES_REQ, hKey, HKEY),
+    LWMSG_ATTR_HANDLE_LOCAL_FOR_RECEIVER,
+
+    LWMSG_MEMBER_PWSTR(REG_IPC_GET_CONFIG_VALUES_REQ, pConfigKey),
+    LWMSG_MEMBER_PWSTR(REG_IPC_GET_CONFIG_VALUES_REQ, pPolicyKey),
+
+    LWMSG_MEMBER_UINT32(REG_IPC_GET_CONFIG_VALUES_REQ, dwValueCount),
+    LWMSG_MEMBER_POINTER_BEGIN(REG_IPC_GET_CONFIG_VALUES_REQ, pValueNames),
+    LWMSG_TYPESPEC(gRegConfigValueNameSpec),
+    LWMSG_POINTER_END,
+    LWMSG_ATTR_LENGTH_MEMBER(REG_IPC_GET_CONFIG_VALUES_REQ, dwValueCount),
+
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec gRegConfigValueSpec[] =
+{
+    // NTSTATUS status;
+    // DWORD dwType;
+    // DWORD cbData;
+    // PBYTE pvData;
+
+    LWMSG_STRUCT_BEGIN(REG_IPC_CONFIG_VALUE),
+
+    LWMSG_MEMBER_UINT32(REG_IPC_CONFIG_VALUE, status),
+    LWMSG_MEMBER_UINT32(REG_IPC_CONFIG_VALUE, dwType),
+    LWMSG_MEMBER_UINT32(REG_IPC_CONFIG_VALUE, cbData),
+    LWMSG_MEMBER_PBYTE(REG_IPC_CONFIG_VALUE, pvData),
+    LWMSG_ATTR_LENGTH_MEMBER(REG_IPC_CONFIG_VALUE, cbData),
+
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec gRegGetConfigValuesRespSpec[] =
+{
+    // DWORD dwValueCount;
+    // PREG_IPC_CONFIG_VALUE pValues;
+
+    LWMSG_STRUCT_BEGIN(REG_IPC_GET_CONFIG_VALUES_RESPONSE),
+
+    LWMSG_MEMBER_UINT32(REG_IPC_GET_CONFIG_VALUES_RESPONSE, dwValueCount),
+    LWMSG_MEMBER_POINTER_BEGIN(REG_IPC_GET_CONFIG_VALUES_RESPONSE, pValues),
+    LWMSG_TYPESPEC(gRegConfigValueSpec),
+    LWMSG_POINTER_END,
+    LWMSG_ATTR_LENGTH_MEMBER(REG_IPC_GET_CONFIG_VALUES_RESPONSE, dwValueCount),
+
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec gRegWaitChangeSpec[] =
+{
+    // ULONG64 Generation;
+
+    LWMSG_STRUCT_BEGIN(REG_IPC_WAIT_CHANGE_REQ),
+
+    LWMSG_MEMBER_UINT64(REG_IPC_WAIT_CHANGE_REQ, Generation),
+
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+static LWMsgTypeSpec gRegWaitChangeRespSpec[] =
+{
+    // ULONG64 Generation;
+
+    LWMSG_STRUCT_BEGIN(REG_IPC_WAIT_CHANGE_RESPONSE),
+
+    LWMSG_MEMBER_UINT64(REG_IPC_WAIT_CHANGE_RESPONSE, Generation),
+
+    LWMSG_STRUCT_END,
+    LWMSG_TYPE_END
+};
+
+
 /******************************************************************************/
 
 static LWMsgProtocolSpec gRegIPCSpec[] =
@@ -856,6 +962,12 @@ static LWMsgProtocolSpec gRegIPCSpec[] =
     LWMSG_MESSAGE(REG_R_GET_VALUEW_ATTRIBUTES, gRegGetValueAttrsResp),
     LWMSG_MESSAGE(REG_Q_DELETE_VALUEW_ATTRIBUTES, gRegDeleteValueAttrsSpec),
     LWMSG_MESSAGE(REG_R_DELETE_VALUEW_ATTRIBUTES, NULL),
+    /*Configuration APIs*/
+    LWMSG_MESSAGE(REG_Q_GET_CONFIG_VALUESW, gRegGetConfigValuesSpec),
+    LWMSG_MESSAGE(REG_R_GET_CONFIG_VALUESW, gRegGetConfigValuesRespSpec),
+    /*Change notification*/
+    LWMSG_MESSAGE(REG_Q_WAIT_CHANGE, gRegWaitChangeSpec),
+    LWMSG_MESSAGE(REG_R_WAIT_CHANGE, gRegWaitChangeRespSpec),
 
     LWMSG_PROTOCOL_END
 };
@@ -1341,3 +1341,328 @@ error:
     goto cleanup;
 }
 
+static
+VOID
+RegSrvIpcFreeConfigValues(
+    PREG_IPC_GET_CONFIG_VALUES_RESPONSE pRegResp
+    )
+{
+    DWORD dwIndex = 0;
+
+    if (pRegResp)
+    {
+        for (dwIndex = 0; dwIndex < pRegResp->dwValueCount; dwIndex++)
+        {
+            LWREG_SAFE_FREE_MEMORY(pRegResp->pValues[dwIndex].pvData);
+        }
+        LWREG_SAFE_FREE_MEMORY(pRegResp->pValues);
+        LWREG_SAFE_FREE_MEMORY(pRegResp);
+    }
+}
+
+/*
+ * Reads one value in two steps, size then data, so the
+ * buffer always fits whatever the provider returns.
+ */
+static
+NTSTATUS
+RegSrvIpcReadConfigValue(
+    HANDLE hSession,
+    HKEY hKey,
+    PCWSTR pSubKey,
+    PREG_IPC_CONFIG_VALUE_NAME pName,
+    PREG_IPC_CONFIG_VALUE pValue
+    )
+{
+    NTSTATUS status = 0;
+    DWORD dwType = REG_NONE;
+    DWORD cbData = 0;
+    PBYTE pData = NULL;
+
+    status = RegSrvGetValueW(
+        hSession,
+        hKey,
+        pSubKey,
+        pName->pValueName,
+        pName->Flags,
+        &dwType,
+        NULL,
+        &cbData);
+    BAIL_ON_NT_STATUS(status);
+
+    if (cbData)
+    {
+        status = LW_RTL_ALLOCATE((PVOID*)&pData, BYTE, cbData);
+        BAIL_ON_NT_STATUS(status);
+
+        status = RegSrvGetValueW(
+            hSession,
+            hKey,
+            pSubKey,
+            pName->pValueName,
+            pName->Flags,
+            &dwType,
+            pData,
+            &cbData);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    LWREG_SAFE_FREE_MEMORY(pValue->pvData);
+    pValue->dwType = dwType;
+    pValue->cbData = cbData;
+    pValue->pvData = pData;
+    pData = NULL;
+
+cleanup:
+    LWREG_SAFE_FREE_MEMORY(pData);
+
+    return status;
+
+error:
+    goto cleanup;
+}
+
+LWMsgStatus
+RegSrvIpcGetConfigValuesW(
+    LWMsgCall* pCall,
+    const LWMsgParams* pIn,
+    LWMsgParams* pOut,
+    void* data
+    )
+{
+    NTSTATUS status = 0;
+    PREG_IPC_GET_CONFIG_VALUES_REQ pReq = pIn->data;
+    PREG_IPC_GET_CONFIG_VALUES_RESPONSE pRegResp = NULL;
+    PREG_IPC_CONFIG_VALUE pValue = NULL;
+    HANDLE hSession = RegSrvIpcGetSessionData(pCall);
+    HKEY hKey = NULL;
+    DWORD dwIndex = 0;
+
+    status = RegSrvIpcGetHandleData(pCall, pReq->hKey, &hKey);
+    BAIL_ON_NT_STATUS(status);
+
+    status = LW_RTL_ALLOCATE((PVOID*)&pRegResp,
+                             REG_IPC_GET_CONFIG_VALUES_RESPONSE,
+                             sizeof(*pRegResp));
+    BAIL_ON_NT_STATUS(status);
+
+    if (pReq->dwValueCount)
+    {
+        status = LW_RTL_ALLOCATE((PVOID*)&pRegResp->pValues,
+                                 REG_IPC_CONFIG_VALUE,
+                                 sizeof(*pRegResp->pValues) * pReq->dwValueCount);
+        BAIL_ON_NT_STATUS(status);
+    }
+    pRegResp->dwValueCount = pReq->dwValueCount;
+
+    for (dwIndex = 0; dwIndex < pReq->dwValueCount; dwIndex++)
+    {
+        pValue = &pRegResp->pValues[dwIndex];
+
+        // An empty policy value does not override the configuration
+        if (pReq->pValueNames[dwIndex].bUsePolicy && pReq->pPolicyKey)
+        {
+            pValue->status = RegSrvIpcReadConfigValue(
+                                 hSession,
+                                 hKey,
+                                 pReq->pPolicyKey,
+                                 &pReq->pValueNames[dwIndex],
+                                 pValue);
+            if (!pValue->status && pValue->cbData)
+            {
+                continue;
+            }
+        }
+
+        pValue->status = RegSrvIpcReadConfigValue(
+                             hSession,
+                             hKey,
+                             pReq->pConfigKey,
+                             &pReq->pValueNames[dwIndex],
+                             pValue);
+        if (pValue->status == STATUS_INSUFFICIENT_RESOURCES)
+        {
+            status = pValue->status;
+            BAIL_ON_NT_STATUS(status);
+        }
+    }
+
+    pOut->tag = REG_R_GET_CONFIG_VALUESW;
+    pOut->data = pRegResp;
+    pRegResp = NULL;
+
+cleanup:
+    RegSrvIpcFreeConfigValues(pRegResp);
+
+    return MAP_REG_ERROR_IPC(status);
+
+error:
+    goto cleanup;
+}
+
+typedef struct _REG_SRV_CHANGE_WAITER
+{
+    LWMsgCall* pCall;
+    LWMsgParams* pOut;
+    PREG_IPC_WAIT_CHANGE_RESPONSE pRegResp;
+    struct _REG_SRV_CHANGE_WAITER* pNext;
+} REG_SRV_CHANGE_WAITER, *PREG_SRV_CHANGE_WAITER;
+
+static pthread_mutex_t gRegSrvChangeLock = PTHREAD_MUTEX_INITIALIZER;
+static ULONG64 gRegSrvChangeGeneration = 1;
+static PREG_SRV_CHANGE_WAITER gpRegSrvChangeWaiters = NULL;
+
+static
+VOID
+RegSrvIpcCompleteWaiter(
+    PREG_SRV_CHANGE_WAITER pWaiter,
+    ULONG64 Generation,
+    LWMsgStatus status
+    )
+{
+    if (status == LWMSG_STATUS_SUCCESS)
+    {
+        pWaiter->pRegResp->Generation = Generation;
+        pWaiter->pOut->tag = REG_R_WAIT_CHANGE;
+        pWaiter->pOut->data = pWaiter->pRegResp;
+        pWaiter->pRegResp = NULL;
+    }
+
+    lwmsg_call_complete(pWaiter->pCall, status);
+
+    LWREG_SAFE_FREE_MEMORY(pWaiter->pRegResp);
+    LWREG_SAFE_FREE_MEMORY(pWaiter);
+}
+
+/*
+ * Called by lwmsg with the session lock held, which is why waiters
+ * are always pended before gRegSrvChangeLock is taken.
+ */
+static
+VOID
+RegSrvIpcWaitChangeCancel(
+    LWMsgCall* pCall,
+    PVOID pData
+    )
+{
+    PREG_SRV_CHANGE_WAITER pWaiter = pData;
+    PREG_SRV_CHANGE_WAITER* ppLink = NULL;
+    BOOLEAN bFound = FALSE;
+
+    pthread_mutex_lock(&gRegSrvChangeLock);
+
+    for (ppLink = &gpRegSrvChangeWaiters; *ppLink; ppLink = &(*ppLink)->pNext)
+    {
+        if (*ppLink == pWaiter)
+        {
+            *ppLink = pWaiter->pNext;
+            bFound = TRUE;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&gRegSrvChangeLock);
+
+    /* Otherwise RegSrvNotifyChange has taken it and completes it */
+    if (bFound)
+    {
+        RegSrvIpcCompleteWaiter(pWaiter, 0, LWMSG_STATUS_CANCELLED);
+    }
+}
+
+LWMsgStatus
+RegSrvIpcWaitChange(
+    LWMsgCall* pCall,
+    const LWMsgParams* pIn,
+    LWMsgParams* pOut,
+    void* data
+    )
+{
+    NTSTATUS status = 0;
+    PREG_IPC_WAIT_CHANGE_REQ pReq = pIn->data;
+    PREG_IPC_WAIT_CHANGE_RESPONSE pRegResp = NULL;
+    PREG_SRV_CHANGE_WAITER pWaiter = NULL;
+    ULONG64 Generation = 0;
+
+    status = LW_RTL_ALLOCATE((PVOID*)&pRegResp, REG_IPC_WAIT_CHANGE_RESPONSE, sizeof(*pRegResp));
+    BAIL_ON_NT_STATUS(status);
+
+    pthread_mutex_lock(&gRegSrvChangeLock);
+    Generation = gRegSrvChangeGeneration;
+    pthread_mutex_unlock(&gRegSrvChangeLock);
+
+    if (Generation != pReq->Generation)
+    {
+        pRegResp->Generation = Generation;
+
+        pOut->tag = REG_R_WAIT_CHANGE;
+        pOut->data = pRegResp;
+        pRegResp = NULL;
+
+        goto cleanup;
+    }
+
+    status = LW_RTL_ALLOCATE((PVOID*)&pWaiter, REG_SRV_CHANGE_WAITER, sizeof(*pWaiter));
+    BAIL_ON_NT_STATUS(status);
+
+    pWaiter->pCall = pCall;
+    pWaiter->pOut = pOut;
+    pWaiter->pRegResp = pRegResp;
+    pRegResp = NULL;
+
+    lwmsg_call_pend(pCall, RegSrvIpcWaitChangeCancel, pWaiter);
+
+    pthread_mutex_lock(&gRegSrvChangeLock);
+
+    Generation = gRegSrvChangeGeneration;
+    if (Generation == pReq->Generation)
+    {
+        pWaiter->pNext = gpRegSrvChangeWaiters;
+        gpRegSrvChangeWaiters = pWaiter;
+        pWaiter = NULL;
+    }
+
+    pthread_mutex_unlock(&gRegSrvChangeLock);
+
+    /* A write slipped in before the waiter was queued */
+    if (pWaiter)
+    {
+        RegSrvIpcCompleteWaiter(pWaiter, Generation, LWMSG_STATUS_SUCCESS);
+    }
+
+    return LWMSG_STATUS_PENDING;
+
+cleanup:
+    LWREG_SAFE_FREE_MEMORY(pRegResp);
+
+    return MAP_REG_ERROR_IPC(status);
+
+error:
+    goto cleanup;
+}
+
+VOID
+RegSrvNotifyChange(
+    VOID
+    )
+{
+    PREG_SRV_CHANGE_WAITER pWaiters = NULL;
+    PREG_SRV_CHANGE_WAITER pWaiter = NULL;
+    ULONG64 Generation = 0;
+
+    pthread_mutex_lock(&gRegSrvChangeLock);
+
+    Generation = ++gRegSrvChangeGeneration;
+    pWaiters = gpRegSrvChangeWaiters;
+    gpRegSrvChangeWaiters = NULL;
+
+    pthread_mutex_unlock(&gRegSrvChangeLock);
+
+    while (pWaiters)
+    {
+        pWaiter = pWaiters;
+        pWaiters = pWaiter->pNext;
+
+        RegSrvIpcCompleteWaiter(pWaiter, Generation, LWMSG_STATUS_SUCCESS);
+    }
+}
@@ -200,6 +200,31 @@ RegSrvIpcDeleteValueAttibutesW(
     void* data
     );
 
+LWMsgStatus
+RegSrvIpcGetConfigValuesW(
+    LWMsgCall* pCall,
+    const LWMsgParams* pIn,
+    LWMsgParams* pOut,
+    void* data
+    );
+
+LWMsgStatus
+RegSrvIpcWaitChange(
+    LWMsgCall* pCall,
+    const LWMsgParams* pIn,
+    LWMsgParams* pOut,
+    void* data
+    );
+
+/*
+ * Wakes the clients waiting in RegSrvIpcWaitChange.  Called after
+ * every successful write so they can drop what they have cached.
+ */
+VOID
+RegSrvNotifyChange(
+    VOID
+    );
+
 VOID
 RegSrvFreeHandle(
     PVOID pData
@@ -69,6 +69,8 @@ static LWMsgDispatchSpec gMessageHandlers[] =
     LWMSG_DISPATCH_BLOCK(REG_Q_SET_VALUEW_ATTRIBUTES, RegSrvIpcSetValueAttibutesW),
     LWMSG_DISPATCH_BLOCK(REG_Q_GET_VALUEW_ATTRIBUTES, RegSrvIpcGetValueAttibutesW),
     LWMSG_DISPATCH_BLOCK(REG_Q_DELETE_VALUEW_ATTRIBUTES, RegSrvIpcDeleteValueAttibutesW),
+    LWMSG_DISPATCH_BLOCK(REG_Q_GET_CONFIG_VALUESW, RegSrvIpcGetConfigValuesW),
+    LWMSG_DISPATCH_NONBLOCK(REG_Q_WAIT_CHANGE, RegSrvIpcWaitChange),
     LWMSG_DISPATCH_END
 };
 
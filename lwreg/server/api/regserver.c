@@ -126,7 +126,10 @@ RegSrvCreateKeyEx(
     OUT OPTIONAL PDWORD pdwDisposition
     )
 {
-    return gpRegProvider->pfnRegSrvCreateKeyEx(
+    NTSTATUS status = 0;
+    DWORD dwDisposition = 0;
+
+    status = gpRegProvider->pfnRegSrvCreateKeyEx(
                                            Handle,
                                            hKey,
                                            pSubKey,
@@ -137,7 +140,20 @@ RegSrvCreateKeyEx(
                                            pSecurityDescriptor,
                                            ulSecDescLen,
                                            phkResult,
-                                           pdwDisposition);
+                                           &dwDisposition);
+
+    /* Opening an existing key changes nothing a client could cache */
+    if (!status && dwDisposition == REG_CREATED_NEW_KEY)
+    {
+        RegSrvNotifyChange();
+    }
+
+    if (pdwDisposition)
+    {
+        *pdwDisposition = dwDisposition;
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -174,9 +190,18 @@ RegSrvDeleteKey(
     PCWSTR pSubKey
     )
 {
-	return gpRegProvider->pfnRegSrvDeleteKey(Handle,
+    NTSTATUS status = 0;
+
+    status = gpRegProvider->pfnRegSrvDeleteKey(Handle,
 											 hKey,
 											 pSubKey);
+
+    if (!status)
+    {
+        RegSrvNotifyChange();
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -187,10 +212,19 @@ RegSrvDeleteKeyValue(
     PCWSTR pValueName
     )
 {
-	return gpRegProvider->pfnRegSrvDeleteKeyValue(Handle,
+    NTSTATUS status = 0;
+
+    status = gpRegProvider->pfnRegSrvDeleteKeyValue(Handle,
 												  hKey,
 												  pSubKey,
 												  pValueName);
+
+    if (!status)
+    {
+        RegSrvNotifyChange();
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -200,9 +234,18 @@ RegSrvDeleteValue(
     PCWSTR pValueName
     )
 {
-	return gpRegProvider->pfnRegSrvDeleteValue(Handle,
+    NTSTATUS status = 0;
+
+    status = gpRegProvider->pfnRegSrvDeleteValue(Handle,
                                                hKey,
                                                pValueName);
+
+    if (!status)
+    {
+        RegSrvNotifyChange();
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -241,7 +284,9 @@ RegSrvSetValueExW(
     DWORD cbData
     )
 {
-   return gpRegProvider->pfnRegSrvSetValueExW(
+    NTSTATUS status = 0;
+
+    status = gpRegProvider->pfnRegSrvSetValueExW(
             Handle,
             hKey,
             pValueName,
@@ -249,6 +294,13 @@ RegSrvSetValueExW(
             dwType,
             pData,
             cbData);
+
+    if (!status)
+    {
+        RegSrvNotifyChange();
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -339,10 +391,19 @@ RegSrvDeleteTree(
     PCWSTR pSubKey
     )
 {
-	return gpRegProvider->pfnRegSrvDeleteTree(
+    NTSTATUS status = 0;
+
+    status = gpRegProvider->pfnRegSrvDeleteTree(
             Handle,
             hKey,
             pSubKey);
+
+    if (!status)
+    {
+        RegSrvNotifyChange();
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -374,12 +435,21 @@ RegSrvSetKeySecurity(
     IN ULONG ulSecDescLength
     )
 {
-    return gpRegProvider->pfnRegSrvSetKeySecurity(
+    NTSTATUS status = 0;
+
+    status = gpRegProvider->pfnRegSrvSetKeySecurity(
     		Handle,
     		hKey,
     		SecurityInformation,
     		pSecurityDescriptor,
     		ulSecDescLength);
+
+    if (!status)
+    {
+        RegSrvNotifyChange();
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -411,12 +481,21 @@ RegSrvSetValueAttributesW(
     IN PLWREG_VALUE_ATTRIBUTES pValueAttributes
     )
 {
-   return gpRegProvider->pfnRegSrvSetValueAttributes(
+    NTSTATUS status = 0;
+
+    status = gpRegProvider->pfnRegSrvSetValueAttributes(
            hRegConnection,
             hKey,
             pSubKey,
             pValueName,
             pValueAttributes);
+
+    if (!status)
+    {
+        RegSrvNotifyChange();
+    }
+
+    return status;
 }
 
 NTSTATUS
@@ -446,10 +525,19 @@ RegSrvDeleteValueAttributesW(
     IN PCWSTR pwszValueName
     )
 {
-    return gpRegProvider->pfnRegSrvDeleteValueAttributes(
+    NTSTATUS status = 0;
+
+    status = gpRegProvider->pfnRegSrvDeleteValueAttributes(
             hRegConnection,
              hKey,
              pwszSubKey,
              pwszValueName);
+
+    if (!status)
+    {
+        RegSrvNotifyChange();
+    }
+
+    return status;
 }
 
@@ -70,6 +70,7 @@
 
 #include "memstore_p.h"
 #include "memdb_p.h"
+#include "memjournal.h"
 #include "memstore.h"
 
 #include "memapi.h"
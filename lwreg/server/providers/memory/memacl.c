@@ -55,6 +55,7 @@ MemSetKeySecurity(
     ACCESS_MASK accessRequired = KEY_ALL_ACCESS;
     REG_DB_CONNECTION regDbConn = {0};
     PREG_SRV_API_STATE pServerState = (PREG_SRV_API_STATE)hNtRegConnection;
+    BOOLEAN bInLock = FALSE;
 
     regDbConn.pMemReg = pKeyHandle->pKey->hNode;
 
@@ -103,6 +104,7 @@ MemSetKeySecurity(
         BAIL_ON_NT_STATUS(status);
     }
 
+    LWREG_LOCK_RWMUTEX_EXCLUSIVE(bInLock, &MemRegRoot()->lock);
     status = MemDbSetKeyAcl(
                  hNtRegConnection,
                  &regDbConn,
@@ -110,8 +112,11 @@ MemSetKeySecurity(
                  ulSecDescRel);
     BAIL_ON_NT_STATUS(status);
 
+    MemJournalLogKey(regDbConn.pMemReg);
+    MemDbExportEntryChanged();
 
 cleanup:
+    LWREG_UNLOCK_RWMUTEX(bInLock, &MemRegRoot()->lock);
     return status;
 
 error:
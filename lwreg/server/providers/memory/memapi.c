@@ -77,6 +77,23 @@ error:
     goto cleanup;
 }
 
+/*
+ * Journals the keys from below hParentKey down to hKey, top first, so
+ * intermediate keys created along with hKey keep their descriptors.
+ */
+static VOID
+_MemJournalLogCreatedKeys(
+    IN PMEMREG_NODE hParentKey,
+    IN PMEMREG_NODE hKey)
+{
+    if (hKey && hKey != hParentKey && hKey->ParentNode)
+    {
+        _MemJournalLogCreatedKeys(hParentKey, hKey->ParentNode);
+        MemJournalLogKey(hKey);
+    }
+}
+
+
 NTSTATUS
 MemProvider_Initialize(
     PREGPROV_PROVIDER_FUNCTION_TABLE* ppFnTable,
@@ -87,6 +104,7 @@ MemProvider_Initialize(
     MEMDB_IMPORT_FILE_CTX importCtx = {0};
     PREG_DB_CONNECTION pConn = NULL;
     PMEMREG_NODE pDbRoot = NULL;
+    BOOLEAN bLoaded = FALSE;
 
     setlocale(LC_ALL, "");
     status = LW_RTL_ALLOCATE(
@@ -120,14 +138,32 @@ MemProvider_Initialize(
     /* Must initialize database root here; used by following import/export */
     MemRegRootInit(pConn);
 
-    /* Initialize memory registry from data previously saved to file */
-    importCtx.fileName = MEMDB_EXPORT_FILE;
-    status = MemDbImportFromFile(
-                 MEMDB_EXPORT_FILE,
-                 pfImportFile,
-                 &importCtx);
+    /* Load the last snapshot and replay the changes journaled since */
+    status = MemJournalOpen(&bLoaded);
+    if (status == STATUS_FILE_CORRUPT_ERROR)
+    {
+        /* The text export is older but still a consistent registry */
+        REG_LOG_ERROR("Falling back to registry export %s",
+                      MEMDB_EXPORT_FILE);
+        status = MemJournalDiscard();
+        bLoaded = FALSE;
+    }
     BAIL_ON_NT_STATUS(status);
 
+    if (!bLoaded)
+    {
+        /* Initialize memory registry from data previously saved to file */
+        importCtx.fileName = MEMDB_EXPORT_FILE;
+        status = MemDbImportFromFile(
+                     MEMDB_EXPORT_FILE,
+                     pfImportFile,
+                     &importCtx);
+        BAIL_ON_NT_STATUS(status);
+
+        /* Journal from here on; on failure the export thread retries */
+        MemJournalCompact();
+    }
+
     /*
      * Start export to save file thread
      */
@@ -179,6 +215,7 @@ static void *pfDeleteNodeCallback(
         *pStatus = STATUS_RESOURCE_IN_USE;
         BAIL_ON_REG_ERROR(*pStatus);
     }
+    MemJournalLogKeyDelete(pEntry);
     *pStatus = MemRegStoreDeleteNode(pEntry);
 
 cleanup:
@@ -202,7 +239,15 @@ MemProvider_Shutdown(
 
     exportCtx.hNode = pMemRegRoot->pMemReg;
 
+    /* Stop the export thread before it can wait on the lock below */
+    MemDbStopExportToFileThread();
+
     LWREG_LOCK_RWMUTEX_EXCLUSIVE(bInLock, &pMemRegRoot->lock);
+
+    /* Fold the journal in, so the next start loads only the snapshot */
+    MemJournalCompact();
+
+    /* The text export stays readable and is what older releases load */
     status = MemDbExportToFile(&exportCtx);
     BAIL_ON_REG_ERROR(status);
 
@@ -259,6 +304,7 @@ MemCreateKeyEx(
     ACCESS_MASK AccessGranted = 0;
     PSECURITY_DESCRIPTOR_RELATIVE SecurityDescriptor = NULL;
     DWORD SecurityDescriptorLen = 0;
+    DWORD dwDisposition = 0;
     BOOLEAN bInLock = FALSE;
 
     LWREG_LOCK_RWMUTEX_EXCLUSIVE(bInLock, &MemRegRoot()->lock);
@@ -332,9 +378,18 @@ MemCreateKeyEx(
                  pSecDescRel, // IN OPTIONAL 
                  ulSecDescLength, // IN ULONG
                  &hSubKey,
-                 pdwDisposition);
+                 &dwDisposition);
     BAIL_ON_NT_STATUS(status);
 
+    if (dwDisposition == REG_CREATED_NEW_KEY)
+    {
+        _MemJournalLogCreatedKeys(regDbConn.pMemReg, hSubKey);
+    }
+    if (pdwDisposition)
+    {
+        *pdwDisposition = dwDisposition;
+    }
+
     status = _MemCreateHkeyReply(hSubKey, phkResult);
     BAIL_ON_NT_STATUS(status);
 
@@ -513,6 +568,7 @@ MemDeleteKey(
         BAIL_ON_NT_STATUS(status);
     }
 
+    MemJournalLogKeyDelete(hRegKey);
     status = MemRegStoreDeleteNode(hRegKey);
     BAIL_ON_NT_STATUS(status);
 
@@ -655,6 +711,7 @@ MemSetValueEx(
                  cbData);
     BAIL_ON_NT_STATUS(status);
 
+    MemJournalLogValue(regDbConn.pMemReg, pValueName);
     MemDbExportEntryChanged();
 cleanup:
     LWREG_UNLOCK_RWMUTEX(bInLock, &MemRegRoot()->lock);
@@ -732,6 +789,10 @@ MemDeleteKeyValue(
     status = MemRegStoreDeleteNodeValue(
                  hSubKey,
                  pValueName);
+    if (status == 0)
+    {
+        MemJournalLogValue(hSubKey, pValueName);
+    }
     MemDbExportEntryChanged();
 error:
     LWREG_UNLOCK_RWMUTEX(bInLock, &MemRegRoot()->lock);
@@ -766,6 +827,7 @@ MemDeleteValue(
     LWREG_SAFE_FREE_MEMORY(pRegValue->Data);
     pRegValue->DataLen = 0;
    
+    MemJournalLogValue(pKeyHandle->pKey->hNode, pValueName);
     MemDbExportEntryChanged();
 
 cleanup:
@@ -391,6 +391,7 @@ MemDbStopExportToFileThread(
     pthread_mutex_unlock(&MemRegRoot()->ExportMutexStop);
 
     pthread_join(MemRegRoot()->hThread, NULL);
+    LWREG_SAFE_FREE_MEMORY(MemRegRoot()->ExportCtx);
 }
 
 
@@ -562,26 +563,34 @@ MemDbExportToFileThread(
                 break;
 
             case MEMDB_EXPORT_WRITE_CHANGES:
+                /*
+                 * Changes are already in the journal; make them durable,
+                 * or fold them into a new snapshot. ExportMutex is not
+                 * held across the registry lock, as mutators take them
+                 * in the opposite order.
+                 */
                 pthread_mutex_lock(&MemRegRoot()->ExportMutex);
-                pthread_rwlock_rdlock(&MemRegRoot()->lock);
+                changeCountInit = MemRegRoot()->valueChangeCount;
+                pthread_mutex_unlock(&MemRegRoot()->ExportMutex);
+
                 status = 0;
                 if (changeCountInit > 0)
                 {
                     REG_LOG_DEBUG("MemDbExportToFileThread: "
-                                  "Exporting registry to save file...");
-                    status = MemDbExportToFile(exportCtx);
-                    REG_LOG_ERROR("MemDbExportToFileThread: "
-                                  "Exporting registry to save file completed.");
+                                  "Syncing registry journal...");
+                    pthread_rwlock_rdlock(&MemRegRoot()->lock);
+                    status = MemJournalSync();
+                    pthread_rwlock_unlock(&MemRegRoot()->lock);
                 }
-                pthread_rwlock_unlock(&MemRegRoot()->lock);
                 if (status)
                 {
-                    REG_LOG_DEBUG("Failed exporting registry to %s",
-                                  MEMDB_EXPORT_FILE);
+                    REG_LOG_ERROR("Failed saving registry to %s",
+                                  MEMDB_JOURNAL_FILE);
                 }
 
+                pthread_mutex_lock(&MemRegRoot()->ExportMutex);
+                MemRegRoot()->valueChangeCount -= changeCountInit;
                 changeCountInit = 0;
-                MemRegRoot()->valueChangeCount = 0;
                 pthread_mutex_unlock(&MemRegRoot()->ExportMutex);
             
                 state = MEMDB_EXPORT_START;
@@ -976,6 +985,7 @@ MemDbClose(
     BAIL_ON_NT_STATUS(status);
 
     MemDbStopExportToFileThread();
+    MemJournalClose();
 
     MemRegStoreClose(hDb->pMemReg);
 cleanup:
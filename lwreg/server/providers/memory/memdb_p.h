@@ -3,10 +3,16 @@
 #define MEMDB_MAX_EXPORT_TIMEOUT (60*10) // 10 Minutes
 #define MEMDB_CHANGED_EXPORT_TIMEOUT 5 // 5 seconds
 #define MEMDB_FOREVER_EXPORT_TIMEOUT (30 * 24 * 3600) // 1 month
+#ifdef REG_MEMDB_TEST
+/* Scratch location used by test_memjournal */
+#define MEMDB_EXPORT_DIR "/tmp/lwreg-test-memjournal"
+#else
 #define MEMDB_EXPORT_DIR "/var/lib/pbis/db"
+#endif
 #define MEMDB_EXPORT_FILE MEMDB_EXPORT_DIR "/memprovider.exp"
 
 typedef struct _MEMREG_NODE *PMEMREG_NODE;
+typedef struct _MEMDB_JOURNAL *PMEMDB_JOURNAL;
 
 typedef struct _MEMDB_FILE_EXPORT_CTX
 {
@@ -27,6 +33,7 @@ typedef struct _REG_DB_CONNECTION
     pthread_cond_t ExportCondStop;
     DWORD valueChangeCount;
     PMEMDB_FILE_EXPORT_CTX ExportCtx;
+    PMEMDB_JOURNAL pJournal;
 } REG_DB_CONNECTION, *PREG_DB_CONNECTION;
 
 typedef struct _MEMDB_IMPORT_FILE_CTX
@@ -271,6 +278,11 @@ MemDbStartExportToFileThread(
     VOID);
 
 
+VOID
+MemDbStopExportToFileThread(
+    VOID);
+
+
 NTSTATUS
 MemDbImportFromFile(
     IN PSTR pszImportFile,
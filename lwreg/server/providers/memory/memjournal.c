@@ -0,0 +1,1701 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ */
+
+/*
+ * Copyright Likewise Software
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.  You should have received a copy of the GNU General
+ * Public License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *        memjournal.c
+ *
+ * Abstract:
+ *        Binary snapshot and change journal for the registry memory
+ *        provider backend
+ *
+ *        Every mutation appends one record to the journal. The export
+ *        thread syncs the journal once changes go quiet, and folds it
+ *        into a new snapshot once it outgrows the last one. Snapshots
+ *        are written with the same records as the journal, so loading
+ *        either one is a replay of its records over the tree.
+ */
+#include "includes.h"
+
+/* Snapshot records are written out in chunks of about this size */
+#define MEMDB_JOURNAL_FLUSH_SIZE (64 * 1024)
+
+#define MEMDB_JOURNAL_PAD(len) (((len) + 3) & ~((DWORD) 3))
+
+typedef struct _MEMDB_JOURNAL_READER
+{
+    PBYTE pData;
+    DWORD dwLen;
+    DWORD dwOffset;
+} MEMDB_JOURNAL_READER, *PMEMDB_JOURNAL_READER;
+
+typedef struct _MEMDB_JOURNAL_SNAPSHOT_CTX
+{
+    int fd;
+    ULONG64 Size;
+    MEMDB_JOURNAL_BUFFER Buffer;
+    PWSTR pwszPath;
+    DWORD dwPathLen;
+    DWORD dwPathSize;
+} MEMDB_JOURNAL_SNAPSHOT_CTX, *PMEMDB_JOURNAL_SNAPSHOT_CTX;
+
+
+static PMEMDB_JOURNAL
+_MemJournal(
+    VOID)
+{
+    return MemRegRoot() ? MemRegRoot()->pJournal : NULL;
+}
+
+
+static DWORD
+_MemJournalChecksum(
+    IN const BYTE *pData,
+    IN DWORD dwLen)
+{
+    DWORD hash = 2166136261U;
+    DWORD index = 0;
+
+    for (index=0; index < dwLen; index++)
+    {
+        hash ^= pData[index];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+
+static NTSTATUS
+_MemJournalReserve(
+    IN PMEMDB_JOURNAL_BUFFER pBuffer,
+    IN DWORD dwMore)
+{
+    NTSTATUS status = 0;
+    PBYTE pData = NULL;
+    DWORD dwSize = 0;
+
+    if (pBuffer->dwLen + dwMore <= pBuffer->dwSize)
+    {
+        goto cleanup;
+    }
+
+    dwSize = pBuffer->dwSize ? pBuffer->dwSize : 256;
+    while (dwSize < pBuffer->dwLen + dwMore)
+    {
+        dwSize *= 2;
+    }
+
+    status = NtRegReallocMemory(pBuffer->pData, (PVOID) &pData, dwSize);
+    BAIL_ON_NT_STATUS(status);
+    pBuffer->pData = pData;
+    pBuffer->dwSize = dwSize;
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+static NTSTATUS
+_MemJournalPutDword(
+    IN PMEMDB_JOURNAL_BUFFER pBuffer,
+    IN DWORD dwValue)
+{
+    NTSTATUS status = 0;
+
+    status = _MemJournalReserve(pBuffer, sizeof(dwValue));
+    BAIL_ON_NT_STATUS(status);
+
+    memcpy(pBuffer->pData + pBuffer->dwLen, &dwValue, sizeof(dwValue));
+    pBuffer->dwLen += sizeof(dwValue);
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+/*
+ * Byte strings are a length followed by the bytes, padded to 4 bytes
+ */
+static NTSTATUS
+_MemJournalPutBytes(
+    IN PMEMDB_JOURNAL_BUFFER pBuffer,
+    IN OPTIONAL const VOID *pData,
+    IN DWORD dwLen)
+{
+    NTSTATUS status = 0;
+
+    if (!pData)
+    {
+        dwLen = 0;
+    }
+
+    status = _MemJournalPutDword(pBuffer, dwLen);
+    BAIL_ON_NT_STATUS(status);
+
+    status = _MemJournalReserve(pBuffer, MEMDB_JOURNAL_PAD(dwLen));
+    BAIL_ON_NT_STATUS(status);
+
+    if (dwLen)
+    {
+        memcpy(pBuffer->pData + pBuffer->dwLen, pData, dwLen);
+    }
+    memset(pBuffer->pData + pBuffer->dwLen + dwLen,
+           0,
+           MEMDB_JOURNAL_PAD(dwLen) - dwLen);
+    pBuffer->dwLen += MEMDB_JOURNAL_PAD(dwLen);
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+/*
+ * Wide strings are stored with their terminator; NULL is stored empty.
+ */
+static NTSTATUS
+_MemJournalPutString(
+    IN PMEMDB_JOURNAL_BUFFER pBuffer,
+    IN OPTIONAL PCWSTR pwszValue)
+{
+    return _MemJournalPutBytes(
+               pBuffer,
+               pwszValue,
+               pwszValue ?
+                   (RtlWC16StringNumChars(pwszValue) + 1) * sizeof(WCHAR) :
+                   0);
+}
+
+
+static NTSTATUS
+_MemJournalBeginRecord(
+    IN PMEMDB_JOURNAL_BUFFER pBuffer,
+    IN MEMDB_JOURNAL_RECORD_TYPE Type,
+    OUT PDWORD pdwOffset)
+{
+    NTSTATUS status = 0;
+
+    status = _MemJournalReserve(pBuffer, sizeof(MEMDB_JOURNAL_RECORD_HEADER));
+    BAIL_ON_NT_STATUS(status);
+
+    *pdwOffset = pBuffer->dwLen;
+    pBuffer->dwLen += sizeof(MEMDB_JOURNAL_RECORD_HEADER);
+
+    status = _MemJournalPutDword(pBuffer, Type);
+    BAIL_ON_NT_STATUS(status);
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+static VOID
+_MemJournalEndRecord(
+    IN PMEMDB_JOURNAL_BUFFER pBuffer,
+    IN DWORD dwOffset)
+{
+    MEMDB_JOURNAL_RECORD_HEADER header = {0};
+    PBYTE pPayload = pBuffer->pData + dwOffset + sizeof(header);
+
+    header.dwLength = pBuffer->dwLen - dwOffset - sizeof(header);
+    header.dwChecksum = _MemJournalChecksum(pPayload, header.dwLength);
+    memcpy(pBuffer->pData + dwOffset, &header, sizeof(header));
+}
+
+
+static NTSTATUS
+_MemJournalPutKey(
+    IN PMEMDB_JOURNAL_BUFFER pBuffer,
+    IN PCWSTR pwszPath,
+    IN PMEMREG_NODE hNode)
+{
+    NTSTATUS status = 0;
+    DWORD dwOffset = 0;
+    PMEMREG_NODE_SD pNodeSd = hNode->pNodeSd;
+
+    status = _MemJournalBeginRecord(
+                 pBuffer,
+                 MEMDB_JOURNAL_RECORD_KEY,
+                 &dwOffset);
+    BAIL_ON_NT_STATUS(status);
+
+    status = _MemJournalPutString(pBuffer, pwszPath);
+    BAIL_ON_NT_STATUS(status);
+
+    /* An inherited descriptor is picked up again from the parent */
+    if (pNodeSd && pNodeSd->SecurityDescriptorAllocated)
+    {
+        status = _MemJournalPutBytes(
+                     pBuffer,
+                     pNodeSd->SecurityDescriptor,
+                     pNodeSd->SecurityDescriptorLen);
+    }
+    else
+    {
+        status = _MemJournalPutBytes(pBuffer, NULL, 0);
+    }
+    BAIL_ON_NT_STATUS(status);
+
+    _MemJournalEndRecord(pBuffer, dwOffset);
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+static NTSTATUS
+_MemJournalPutValue(
+    IN PMEMDB_JOURNAL_BUFFER pBuffer,
+    IN PCWSTR pwszPath,
+    IN PMEMREG_VALUE hValue)
+{
+    NTSTATUS status = 0;
+    DWORD dwOffset = 0;
+    DWORD dwCount = 0;
+    DWORD index = 0;
+    PLWREG_VALUE_ATTRIBUTES pAttr = &hValue->Attributes;
+
+    status = _MemJournalBeginRecord(
+                 pBuffer,
+                 MEMDB_JOURNAL_RECORD_VALUE,
+                 &dwOffset);
+    BAIL_ON_NT_STATUS(status);
+
+    status = _MemJournalPutString(pBuffer, pwszPath);
+    BAIL_ON_NT_STATUS(status);
+    status = _MemJournalPutString(pBuffer, hValue->Name);
+    BAIL_ON_NT_STATUS(status);
+    status = _MemJournalPutDword(pBuffer, hValue->Type);
+    BAIL_ON_NT_STATUS(status);
+    status = _MemJournalPutBytes(pBuffer, hValue->Data, hValue->DataLen);
+    BAIL_ON_NT_STATUS(status);
+
+    /* A value type of 0 means the value has no schema attributes */
+    status = _MemJournalPutDword(pBuffer, pAttr->ValueType);
+    BAIL_ON_NT_STATUS(status);
+
+    if (pAttr->ValueType)
+    {
+        status = _MemJournalPutBytes(
+                     pBuffer,
+                     pAttr->pDefaultValue,
+                     pAttr->DefaultValueLen);
+        BAIL_ON_NT_STATUS(status);
+        status = _MemJournalPutString(pBuffer, pAttr->pwszDocString);
+        BAIL_ON_NT_STATUS(status);
+        status = _MemJournalPutDword(pBuffer, pAttr->RangeType);
+        BAIL_ON_NT_STATUS(status);
+        status = _MemJournalPutDword(pBuffer, pAttr->Hint);
+        BAIL_ON_NT_STATUS(status);
+
+        switch (pAttr->RangeType)
+        {
+            case LWREG_VALUE_RANGE_TYPE_INTEGER:
+                status = _MemJournalPutDword(
+                             pBuffer,
+                             pAttr->Range.RangeInteger.Min);
+                BAIL_ON_NT_STATUS(status);
+                status = _MemJournalPutDword(
+                             pBuffer,
+                             pAttr->Range.RangeInteger.Max);
+                BAIL_ON_NT_STATUS(status);
+                break;
+
+            case LWREG_VALUE_RANGE_TYPE_ENUM:
+                for (dwCount=0;
+                     pAttr->Range.ppwszRangeEnumStrings &&
+                     pAttr->Range.ppwszRangeEnumStrings[dwCount];
+                     dwCount++)
+                {
+                    ;
+                }
+                status = _MemJournalPutDword(pBuffer, dwCount);
+                BAIL_ON_NT_STATUS(status);
+                for (index=0; index < dwCount; index++)
+                {
+                    status = _MemJournalPutString(
+                                 pBuffer,
+                                 pAttr->Range.ppwszRangeEnumStrings[index]);
+                    BAIL_ON_NT_STATUS(status);
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    _MemJournalEndRecord(pBuffer, dwOffset);
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+static NTSTATUS
+_MemJournalGetDword(
+    IN PMEMDB_JOURNAL_READER pReader,
+    OUT PDWORD pdwValue)
+{
+    if (pReader->dwLen - pReader->dwOffset < sizeof(*pdwValue))
+    {
+        return STATUS_FILE_CORRUPT_ERROR;
+    }
+
+    memcpy(pdwValue, pReader->pData + pReader->dwOffset, sizeof(*pdwValue));
+    pReader->dwOffset += sizeof(*pdwValue);
+
+    return STATUS_SUCCESS;
+}
+
+
+/*
+ * Returns a pointer into the reader's buffer, or NULL when empty
+ */
+static NTSTATUS
+_MemJournalGetBytes(
+    IN PMEMDB_JOURNAL_READER pReader,
+    OUT PVOID *ppData,
+    OUT PDWORD pdwLen)
+{
+    NTSTATUS status = 0;
+    DWORD dwLen = 0;
+
+    status = _MemJournalGetDword(pReader, &dwLen);
+    BAIL_ON_NT_STATUS(status);
+
+    if (MEMDB_JOURNAL_PAD(dwLen) < dwLen ||
+        pReader->dwLen - pReader->dwOffset < MEMDB_JOURNAL_PAD(dwLen))
+    {
+        status = STATUS_FILE_CORRUPT_ERROR;
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    *ppData = dwLen ? pReader->pData + pReader->dwOffset : NULL;
+    *pdwLen = dwLen;
+    pReader->dwOffset += MEMDB_JOURNAL_PAD(dwLen);
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+static NTSTATUS
+_MemJournalGetString(
+    IN PMEMDB_JOURNAL_READER pReader,
+    OUT PWSTR *ppwszValue)
+{
+    NTSTATUS status = 0;
+    PWSTR pwszValue = NULL;
+    DWORD dwLen = 0;
+
+    status = _MemJournalGetBytes(pReader, (PVOID*) &pwszValue, &dwLen);
+    BAIL_ON_NT_STATUS(status);
+
+    if (dwLen &&
+        (dwLen % sizeof(WCHAR) ||
+         pwszValue[dwLen / sizeof(WCHAR) - 1] != '\0'))
+    {
+        status = STATUS_FILE_CORRUPT_ERROR;
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    *ppwszValue = pwszValue;
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+/*
+ * Finds the key at a full path, creating it and any missing parents
+ * when bCreate is set. The path is split in place and restored.
+ */
+static NTSTATUS
+_MemJournalFindKey(
+    IN PWSTR pwszPath,
+    IN BOOLEAN bCreate,
+    IN OPTIONAL PSECURITY_DESCRIPTOR_RELATIVE pSecDescRel,
+    IN ULONG ulSecDescLen,
+    OUT PMEMREG_NODE *phNode)
+{
+    NTSTATUS status = 0;
+    PMEMREG_NODE hRoot = MemRegRoot()->pMemReg;
+    PMEMREG_NODE hParent = NULL;
+    PMEMREG_NODE hNode = NULL;
+    PWSTR pwszLeaf = NULL;
+    PWSTR pwszPtr = NULL;
+
+    if (!pwszPath || !*pwszPath)
+    {
+        status = STATUS_FILE_CORRUPT_ERROR;
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    status = MemRegStoreFindNodeSubkey(hRoot, pwszPath, &hNode);
+    if (status == STATUS_OBJECT_NAME_NOT_FOUND && bCreate)
+    {
+        for (pwszPtr = pwszPath; *pwszPtr; pwszPtr++)
+        {
+            if (*pwszPtr == '\\')
+            {
+                pwszLeaf = pwszPtr;
+            }
+        }
+
+        if (pwszLeaf)
+        {
+            *pwszLeaf = '\0';
+            status = _MemJournalFindKey(pwszPath, TRUE, NULL, 0, &hParent);
+            *pwszLeaf++ = '\\';
+            BAIL_ON_NT_STATUS(status);
+        }
+        else
+        {
+            hParent = hRoot;
+            pwszLeaf = pwszPath;
+        }
+
+        status = MemRegStoreAddNode(
+                     hParent,
+                     pwszLeaf,
+                     hParent == hRoot ? MEMREG_TYPE_HIVE : MEMREG_TYPE_KEY,
+                     pSecDescRel,
+                     ulSecDescLen,
+                     NULL,
+                     &hNode);
+    }
+    BAIL_ON_NT_STATUS(status);
+
+    *phNode = hNode;
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+static NTSTATUS
+_MemJournalDeleteTree(
+    IN PMEMREG_NODE hNode)
+{
+    NTSTATUS status = 0;
+
+    while (hNode->NodesLen > 0)
+    {
+        status = _MemJournalDeleteTree(hNode->SubNodes[hNode->NodesLen - 1]);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    status = MemRegStoreDeleteNode(hNode);
+    BAIL_ON_NT_STATUS(status);
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+static NTSTATUS
+_MemJournalReplayKey(
+    IN PMEMDB_JOURNAL_READER pReader)
+{
+    NTSTATUS status = 0;
+    PWSTR pwszPath = NULL;
+    PSECURITY_DESCRIPTOR_RELATIVE pSecDescRel = NULL;
+    DWORD dwSecDescLen = 0;
+    PMEMREG_NODE hNode = NULL;
+    REG_DB_CONNECTION regDbConn = {0};
+
+    status = _MemJournalGetString(pReader, &pwszPath);
+    BAIL_ON_NT_STATUS(status);
+    status = _MemJournalGetBytes(pReader, (PVOID*) &pSecDescRel, &dwSecDescLen);
+    BAIL_ON_NT_STATUS(status);
+
+    status = _MemJournalFindKey(
+                 pwszPath,
+                 TRUE,
+                 pSecDescRel,
+                 dwSecDescLen,
+                 &hNode);
+    BAIL_ON_NT_STATUS(status);
+
+    /* No-op when the key was just created with this descriptor */
+    regDbConn.pMemReg = hNode;
+    status = MemDbSetKeyAcl(NULL, &regDbConn, pSecDescRel, dwSecDescLen);
+    BAIL_ON_NT_STATUS(status);
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+static NTSTATUS
+_MemJournalReplayKeyDelete(
+    IN PMEMDB_JOURNAL_READER pReader)
+{
+    NTSTATUS status = 0;
+    PWSTR pwszPath = NULL;
+    PMEMREG_NODE hNode = NULL;
+
+    status = _MemJournalGetString(pReader, &pwszPath);
+    BAIL_ON_NT_STATUS(status);
+
+    status = _MemJournalFindKey(pwszPath, FALSE, NULL, 0, &hNode);
+    if (status == STATUS_OBJECT_NAME_NOT_FOUND)
+    {
+        status = 0;
+        goto cleanup;
+    }
+    BAIL_ON_NT_STATUS(status);
+
+    status = _MemJournalDeleteTree(hNode);
+    BAIL_ON_NT_STATUS(status);
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+static NTSTATUS
+_MemJournalReplayValue(
+    IN PMEMDB_JOURNAL_READER pReader)
+{
+    NTSTATUS status = 0;
+    PWSTR pwszPath = NULL;
+    PWSTR pwszName = NULL;
+    DWORD dwType = 0;
+    PBYTE pData = NULL;
+    DWORD cbData = 0;
+    DWORD dwValue = 0;
+    DWORD dwCount = 0;
+    DWORD index = 0;
+    LWREG_VALUE_ATTRIBUTES attr = {0};
+    PWSTR *ppwszEnumStrings = NULL;
+    PMEMREG_NODE hNode = NULL;
+    PMEMREG_VALUE hValue = NULL;
+
+    status = _MemJournalGetString(pReader, &pwszPath);
+    BAIL_ON_NT_STATUS(status);
+    status = _MemJournalGetString(pReader, &pwszName);
+    BAIL_ON_NT_STATUS(status);
+    status = _MemJournalGetDword(pReader, &dwType);
+    BAIL_ON_NT_STATUS(status);
+    status = _MemJournalGetBytes(pReader, (PVOID*) &pData, &cbData);
+    BAIL_ON_NT_STATUS(status);
+    status = _MemJournalGetDword(pReader, &dwValue);
+    BAIL_ON_NT_STATUS(status);
+    attr.ValueType = dwValue;
+
+    if (attr.ValueType)
+    {
+        status = _MemJournalGetBytes(
+                     pReader,
+                     &attr.pDefaultValue,
+                     &attr.DefaultValueLen);
+        BAIL_ON_NT_STATUS(status);
+        status = _MemJournalGetString(pReader, &attr.pwszDocString);
+        BAIL_ON_NT_STATUS(status);
+        status = _MemJournalGetDword(pReader, &dwValue);
+        BAIL_ON_NT_STATUS(status);
+        attr.RangeType = dwValue;
+        status = _MemJournalGetDword(pReader, &dwValue);
+        BAIL_ON_NT_STATUS(status);
+        attr.Hint = dwValue;
+
+        switch (attr.RangeType)
+        {
+            case LWREG_VALUE_RANGE_TYPE_INTEGER:
+                status = _MemJournalGetDword(
+                             pReader,
+                             &attr.Range.RangeInteger.Min);
+                BAIL_ON_NT_STATUS(status);
+                status = _MemJournalGetDword(
+                             pReader,
+                             &attr.Range.RangeInteger.Max);
+                BAIL_ON_NT_STATUS(status);
+                break;
+
+            case LWREG_VALUE_RANGE_TYPE_ENUM:
+                status = _MemJournalGetDword(pReader, &dwCount);
+                BAIL_ON_NT_STATUS(status);
+
+                /* Each string takes at least 4 bytes of the record */
+                if (dwCount > pReader->dwLen / sizeof(DWORD))
+                {
+                    status = STATUS_FILE_CORRUPT_ERROR;
+                    BAIL_ON_NT_STATUS(status);
+                }
+
+                status = LW_RTL_ALLOCATE(
+                             (PVOID*) &ppwszEnumStrings,
+                             PWSTR,
+                             sizeof(PWSTR) * (dwCount + 1));
+                BAIL_ON_NT_STATUS(status);
+
+                for (index=0; index < dwCount; index++)
+                {
+                    status = _MemJournalGetString(
+                                 pReader,
+                                 &ppwszEnumStrings[index]);
+                    BAIL_ON_NT_STATUS(status);
+                    if (!ppwszEnumStrings[index])
+                    {
+                        status = STATUS_FILE_CORRUPT_ERROR;
+                        BAIL_ON_NT_STATUS(status);
+                    }
+                }
+                attr.Range.ppwszRangeEnumStrings = ppwszEnumStrings;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    status = _MemJournalFindKey(pwszPath, TRUE, NULL, 0, &hNode);
+    BAIL_ON_NT_STATUS(status);
+
+    status = MemRegStoreFindNodeValue(hNode, pwszName, &hValue);
+    if (status == STATUS_OBJECT_NAME_NOT_FOUND)
+    {
+        status = MemRegStoreAddNodeValue(
+                     hNode,
+                     pwszName,
+                     0,
+                     dwType,
+                     pData,
+                     cbData);
+        BAIL_ON_NT_STATUS(status);
+
+        status = MemRegStoreFindNodeValue(hNode, pwszName, &hValue);
+        BAIL_ON_NT_STATUS(status);
+    }
+    else
+    {
+        BAIL_ON_NT_STATUS(status);
+
+        hValue->Type = dwType;
+        if (cbData)
+        {
+            status = MemRegStoreChangeNodeValue(hValue, pData, cbData);
+            BAIL_ON_NT_STATUS(status);
+        }
+        else
+        {
+            LWREG_SAFE_FREE_MEMORY(hValue->Data);
+            hValue->DataLen = 0;
+        }
+    }
+
+    if (attr.ValueType)
+    {
+        status = MemRegStoreAddNodeAttribute(hValue, &attr);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+cleanup:
+    LWREG_SAFE_FREE_MEMORY(ppwszEnumStrings);
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+static NTSTATUS
+_MemJournalReplayValueDelete(
+    IN PMEMDB_JOURNAL_READER pReader)
+{
+    NTSTATUS status = 0;
+    PWSTR pwszPath = NULL;
+    PWSTR pwszName = NULL;
+    PMEMREG_NODE hNode = NULL;
+
+    status = _MemJournalGetString(pReader, &pwszPath);
+    BAIL_ON_NT_STATUS(status);
+    status = _MemJournalGetString(pReader, &pwszName);
+    BAIL_ON_NT_STATUS(status);
+
+    status = _MemJournalFindKey(pwszPath, FALSE, NULL, 0, &hNode);
+    if (status == 0)
+    {
+        status = MemRegStoreDeleteNodeValue(hNode, pwszName);
+    }
+    if (status == STATUS_OBJECT_NAME_NOT_FOUND)
+    {
+        status = 0;
+    }
+    BAIL_ON_NT_STATUS(status);
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+/*
+ * Applies records until the end of the data or the first record that
+ * is short or fails its checksum, which is where a write was torn.
+ * *pdwValidLen receives the length of the intact prefix.
+ */
+static NTSTATUS
+_MemJournalReplay(
+    IN PBYTE pData,
+    IN DWORD dwLen,
+    OUT PDWORD pdwValidLen)
+{
+    NTSTATUS status = 0;
+    DWORD dwOffset = sizeof(MEMDB_JOURNAL_HEADER);
+    DWORD dwType = 0;
+    MEMDB_JOURNAL_RECORD_HEADER header = {0};
+    MEMDB_JOURNAL_READER reader = {0};
+
+    while (dwLen - dwOffset >= sizeof(header))
+    {
+        memcpy(&header, pData + dwOffset, sizeof(header));
+        if (header.dwLength < sizeof(DWORD) ||
+            header.dwLength % sizeof(DWORD) ||
+            header.dwLength > dwLen - dwOffset - sizeof(header) ||
+            header.dwChecksum != _MemJournalChecksum(
+                                     pData + dwOffset + sizeof(header),
+                                     header.dwLength))
+        {
+            break;
+        }
+
+        reader.pData = pData + dwOffset + sizeof(header);
+        reader.dwLen = header.dwLength;
+        reader.dwOffset = 0;
+
+        status = _MemJournalGetDword(&reader, &dwType);
+        BAIL_ON_NT_STATUS(status);
+
+        switch (dwType)
+        {
+            case MEMDB_JOURNAL_RECORD_KEY:
+                status = _MemJournalReplayKey(&reader);
+                break;
+
+            case MEMDB_JOURNAL_RECORD_KEY_DELETE:
+                status = _MemJournalReplayKeyDelete(&reader);
+                break;
+
+            case MEMDB_JOURNAL_RECORD_VALUE:
+                status = _MemJournalReplayValue(&reader);
+                break;
+
+            case MEMDB_JOURNAL_RECORD_VALUE_DELETE:
+                status = _MemJournalReplayValueDelete(&reader);
+                break;
+
+            default:
+                status = STATUS_FILE_CORRUPT_ERROR;
+                break;
+        }
+        BAIL_ON_NT_STATUS(status);
+
+        dwOffset += sizeof(header) + header.dwLength;
+    }
+
+    *pdwValidLen = dwOffset;
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+/*
+ * Reads a whole snapshot or journal file with one read
+ */
+static NTSTATUS
+_MemJournalReadFile(
+    IN PCSTR pszPath,
+    IN MEMDB_JOURNAL_KIND Kind,
+    OUT PBYTE *ppData,
+    OUT PDWORD pdwLen,
+    OUT PULONG64 pGeneration)
+{
+    NTSTATUS status = 0;
+    int fd = -1;
+    struct stat statbuf = {0};
+    PBYTE pData = NULL;
+    DWORD dwLen = 0;
+    ssize_t sts = 0;
+    MEMDB_JOURNAL_HEADER header = {{0}};
+
+    fd = open(pszPath, O_RDONLY);
+    if (fd == -1)
+    {
+        status = LwErrnoToNtStatus(errno);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    if (fstat(fd, &statbuf) == -1)
+    {
+        status = LwErrnoToNtStatus(errno);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    if (statbuf.st_size < (off_t) sizeof(header) ||
+        statbuf.st_size > (off_t) (DWORD) -1)
+    {
+        status = STATUS_FILE_CORRUPT_ERROR;
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    status = LW_RTL_ALLOCATE((PVOID*) &pData, BYTE, statbuf.st_size);
+    BAIL_ON_NT_STATUS(status);
+
+    while (dwLen < (DWORD) statbuf.st_size)
+    {
+        sts = read(fd, pData + dwLen, statbuf.st_size - dwLen);
+        if (sts == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (sts == -1)
+        {
+            status = LwErrnoToNtStatus(errno);
+            BAIL_ON_NT_STATUS(status);
+        }
+        else if (sts == 0)
+        {
+            break;
+        }
+        dwLen += sts;
+    }
+
+    memcpy(&header, pData, sizeof(header));
+    if (dwLen < sizeof(header) ||
+        memcmp(header.Magic, MEMDB_JOURNAL_MAGIC, sizeof(header.Magic)) ||
+        header.dwVersion != MEMDB_JOURNAL_VERSION ||
+        header.dwKind != Kind)
+    {
+        status = STATUS_FILE_CORRUPT_ERROR;
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    *ppData = pData;
+    *pdwLen = dwLen;
+    *pGeneration = header.Generation;
+
+cleanup:
+    if (fd != -1)
+    {
+        close(fd);
+    }
+    return status;
+
+error:
+    LWREG_SAFE_FREE_MEMORY(pData);
+    goto cleanup;
+}
+
+
+static NTSTATUS
+_MemJournalWriteAll(
+    IN int fd,
+    IN const BYTE *pData,
+    IN DWORD dwLen)
+{
+    NTSTATUS status = 0;
+    ssize_t sts = 0;
+
+    while (dwLen > 0)
+    {
+        sts = write(fd, pData, dwLen);
+        if (sts == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (sts == -1)
+        {
+            status = LwErrnoToNtStatus(errno);
+            BAIL_ON_NT_STATUS(status);
+        }
+        pData += sts;
+        dwLen -= sts;
+    }
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+static NTSTATUS
+_MemJournalCreateFile(
+    IN PCSTR pszPath,
+    IN MEMDB_JOURNAL_KIND Kind,
+    IN ULONG64 Generation,
+    OUT int *pfd)
+{
+    NTSTATUS status = 0;
+    int fd = -1;
+    MEMDB_JOURNAL_HEADER header = {{0}};
+
+    fd = open(pszPath, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1)
+    {
+        status = LwErrnoToNtStatus(errno);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    memcpy(header.Magic, MEMDB_JOURNAL_MAGIC, sizeof(header.Magic));
+    header.dwVersion = MEMDB_JOURNAL_VERSION;
+    header.dwKind = Kind;
+    header.Generation = Generation;
+
+    status = _MemJournalWriteAll(fd, (PBYTE) &header, sizeof(header));
+    BAIL_ON_NT_STATUS(status);
+
+    *pfd = fd;
+
+cleanup:
+    return status;
+
+error:
+    if (fd != -1)
+    {
+        close(fd);
+    }
+    goto cleanup;
+}
+
+
+/*
+ * Flushes a finished file to disk and moves it into place
+ */
+static NTSTATUS
+_MemJournalCommitFile(
+    IN int fd,
+    IN int dfd,
+    IN PCSTR pszTmpPath,
+    IN PCSTR pszPath)
+{
+    NTSTATUS status = 0;
+
+    if (fsync(fd) == -1 ||
+        rename(pszTmpPath, pszPath) == -1 ||
+        fsync(dfd) == -1)
+    {
+        status = LwErrnoToNtStatus(errno);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+/*
+ * Writes a key, its values and its subkeys in that order, so replaying
+ * a snapshot always finds the parent of each key in place. Walks the
+ * tree directly, keeping the path in one buffer, rather than through
+ * MemDbRecurseRegistry, whose stack limits the number of sibling keys.
+ */
+static NTSTATUS
+_MemJournalSnapshotNode(
+    IN PMEMDB_JOURNAL_SNAPSHOT_CTX pCtx,
+    IN PMEMREG_NODE hNode)
+{
+    NTSTATUS status = 0;
+    PWSTR pwszPath = NULL;
+    DWORD dwPathLen = pCtx->dwPathLen;
+    DWORD dwNameLen = RtlWC16StringNumChars(hNode->Name);
+    DWORD dwSize = 0;
+    DWORD index = 0;
+
+    if ((dwPathLen + dwNameLen + 2) * sizeof(WCHAR) > pCtx->dwPathSize)
+    {
+        dwSize = (dwPathLen + dwNameLen + 2) * sizeof(WCHAR) * 2;
+        status = NtRegReallocMemory(pCtx->pwszPath, (PVOID) &pwszPath, dwSize);
+        BAIL_ON_NT_STATUS(status);
+        pCtx->pwszPath = pwszPath;
+        pCtx->dwPathSize = dwSize;
+    }
+
+    if (dwPathLen)
+    {
+        pCtx->pwszPath[pCtx->dwPathLen++] = '\\';
+    }
+    memcpy(&pCtx->pwszPath[pCtx->dwPathLen],
+           hNode->Name,
+           dwNameLen * sizeof(WCHAR));
+    pCtx->dwPathLen += dwNameLen;
+    pCtx->pwszPath[pCtx->dwPathLen] = '\0';
+
+    status = _MemJournalPutKey(&pCtx->Buffer, pCtx->pwszPath, hNode);
+    BAIL_ON_NT_STATUS(status);
+
+    for (index=0; index < hNode->ValuesLen; index++)
+    {
+        status = _MemJournalPutValue(
+                     &pCtx->Buffer,
+                     pCtx->pwszPath,
+                     hNode->Values[index]);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    if (pCtx->Buffer.dwLen >= MEMDB_JOURNAL_FLUSH_SIZE)
+    {
+        status = _MemJournalWriteAll(
+                     pCtx->fd,
+                     pCtx->Buffer.pData,
+                     pCtx->Buffer.dwLen);
+        BAIL_ON_NT_STATUS(status);
+        pCtx->Size += pCtx->Buffer.dwLen;
+        pCtx->Buffer.dwLen = 0;
+    }
+
+    for (index=0; index < hNode->NodesLen; index++)
+    {
+        status = _MemJournalSnapshotNode(pCtx, hNode->SubNodes[index]);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+cleanup:
+    pCtx->dwPathLen = dwPathLen;
+    if (pCtx->pwszPath)
+    {
+        pCtx->pwszPath[dwPathLen] = '\0';
+    }
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+NTSTATUS
+MemJournalOpen(
+    OUT PBOOLEAN pbLoaded)
+{
+    NTSTATUS status = 0;
+    PMEMDB_JOURNAL pJournal = NULL;
+    PBYTE pData = NULL;
+    DWORD dwLen = 0;
+    DWORD dwValidLen = 0;
+    ULONG64 Generation = 0;
+    BOOLEAN bLoaded = FALSE;
+    int fd = -1;
+
+    status = LW_RTL_ALLOCATE(
+                 (PVOID*) &pJournal,
+                 MEMDB_JOURNAL,
+                 sizeof(*pJournal));
+    BAIL_ON_NT_STATUS(status);
+
+    /* Nothing is appended until a journal matching the snapshot is open */
+    pJournal->fd = -1;
+    pJournal->bFailed = TRUE;
+    MemRegRoot()->pJournal = pJournal;
+
+    status = _MemJournalReadFile(
+                 MEMDB_SNAPSHOT_FILE,
+                 MEMDB_JOURNAL_KIND_SNAPSHOT,
+                 &pData,
+                 &dwLen,
+                 &Generation);
+    if (status == STATUS_OBJECT_NAME_NOT_FOUND)
+    {
+        status = 0;
+        goto cleanup;
+    }
+    BAIL_ON_NT_STATUS(status);
+
+    /* Snapshots are renamed into place whole, so any damage is fatal */
+    status = _MemJournalReplay(pData, dwLen, &dwValidLen);
+    BAIL_ON_NT_STATUS(status);
+    if (dwValidLen != dwLen)
+    {
+        status = STATUS_FILE_CORRUPT_ERROR;
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    pJournal->Generation = Generation;
+    pJournal->SnapshotSize = dwLen;
+    bLoaded = TRUE;
+    LWREG_SAFE_FREE_MEMORY(pData);
+
+    status = _MemJournalReadFile(
+                 MEMDB_JOURNAL_FILE,
+                 MEMDB_JOURNAL_KIND_JOURNAL,
+                 &pData,
+                 &dwLen,
+                 &Generation);
+    if (status || Generation != pJournal->Generation)
+    {
+        /*
+         * A journal left from before the snapshot is already part of
+         * it. The next sync starts a new one.
+         */
+        REG_LOG_INFO("Ignoring registry journal %s (status 0x%x)",
+                     MEMDB_JOURNAL_FILE, status);
+        status = 0;
+        goto cleanup;
+    }
+
+    status = _MemJournalReplay(pData, dwLen, &dwValidLen);
+    BAIL_ON_NT_STATUS(status);
+    if (dwValidLen != dwLen)
+    {
+        REG_LOG_ERROR("Discarding %u bytes of incomplete records at the "
+                      "end of registry journal %s",
+                      dwLen - dwValidLen,
+                      MEMDB_JOURNAL_FILE);
+    }
+
+    /* Cut off a torn tail so new records follow the intact ones */
+    fd = open(MEMDB_JOURNAL_FILE, O_WRONLY);
+    if (fd == -1 ||
+        ftruncate(fd, dwValidLen) == -1 ||
+        lseek(fd, 0, SEEK_END) == -1)
+    {
+        REG_LOG_ERROR("Failed reopening registry journal %s: %s",
+                      MEMDB_JOURNAL_FILE, strerror(errno));
+        goto cleanup;
+    }
+
+    pJournal->fd = fd;
+    fd = -1;
+    pJournal->Size = dwValidLen;
+    pJournal->bFailed = FALSE;
+
+cleanup:
+    if (fd != -1)
+    {
+        close(fd);
+    }
+    LWREG_SAFE_FREE_MEMORY(pData);
+    *pbLoaded = bLoaded;
+    return status;
+
+error:
+    if (status == STATUS_FILE_CORRUPT_ERROR)
+    {
+        REG_LOG_ERROR("Registry snapshot %s or journal %s is corrupt",
+                      MEMDB_SNAPSHOT_FILE, MEMDB_JOURNAL_FILE);
+    }
+    bLoaded = FALSE;
+    goto cleanup;
+}
+
+
+/*
+ * Drops whatever a failed MemJournalOpen() replayed and moves the
+ * snapshot and journal aside, so the caller can rebuild the tree from
+ * the text export. The caller must keep mutators out of the tree.
+ */
+NTSTATUS
+MemJournalDiscard(
+    VOID)
+{
+    NTSTATUS status = 0;
+    PMEMDB_JOURNAL pJournal = _MemJournal();
+    PMEMREG_NODE hOldRoot = MemRegRoot()->pMemReg;
+    PMEMREG_NODE hNewRoot = NULL;
+
+    /* A fresh root brings back the predefined hives */
+    status = MemRegStoreOpen(&hNewRoot);
+    BAIL_ON_NT_STATUS(status);
+
+    while (hOldRoot->NodesLen > 0)
+    {
+        status = _MemJournalDeleteTree(
+                     hOldRoot->SubNodes[hOldRoot->NodesLen - 1]);
+        BAIL_ON_NT_STATUS(status);
+    }
+    MemRegStoreClose(hOldRoot);
+    MemRegRoot()->pMemReg = hNewRoot;
+    hNewRoot = NULL;
+
+    if (rename(MEMDB_SNAPSHOT_FILE, MEMDB_SNAPSHOT_FILE ".corrupt") == -1 &&
+        errno != ENOENT)
+    {
+        REG_LOG_ERROR("Failed moving aside registry snapshot %s: %s",
+                      MEMDB_SNAPSHOT_FILE, strerror(errno));
+    }
+    if (rename(MEMDB_JOURNAL_FILE, MEMDB_JOURNAL_FILE ".corrupt") == -1 &&
+        errno != ENOENT)
+    {
+        REG_LOG_ERROR("Failed moving aside registry journal %s: %s",
+                      MEMDB_JOURNAL_FILE, strerror(errno));
+    }
+
+    if (pJournal)
+    {
+        if (pJournal->fd != -1)
+        {
+            close(pJournal->fd);
+            pJournal->fd = -1;
+        }
+        pJournal->Generation = 0;
+        pJournal->Size = 0;
+        pJournal->SnapshotSize = 0;
+        pJournal->bFailed = TRUE;
+    }
+
+cleanup:
+    return status;
+
+error:
+    if (hNewRoot)
+    {
+        while (hNewRoot->NodesLen > 0 &&
+               !_MemJournalDeleteTree(
+                   hNewRoot->SubNodes[hNewRoot->NodesLen - 1]));
+        MemRegStoreClose(hNewRoot);
+    }
+    goto cleanup;
+}
+
+
+/*
+ * Writes the whole tree to a new snapshot and starts an empty journal
+ * on top of it. The caller must keep mutators out of the tree.
+ */
+NTSTATUS
+MemJournalCompact(
+    VOID)
+{
+    NTSTATUS status = 0;
+    PMEMDB_JOURNAL pJournal = _MemJournal();
+    MEMDB_JOURNAL_SNAPSHOT_CTX ctx = {0};
+    PMEMREG_NODE hRoot = NULL;
+    DWORD index = 0;
+    ULONG64 Generation = 0;
+    int dfd = -1;
+    int jfd = -1;
+
+    ctx.fd = -1;
+
+    if (!pJournal)
+    {
+        goto cleanup;
+    }
+    Generation = pJournal->Generation + 1;
+
+    dfd = open(MEMDB_EXPORT_DIR, O_RDONLY);
+    if (dfd == -1)
+    {
+        status = LwErrnoToNtStatus(errno);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    status = _MemJournalCreateFile(
+                 MEMDB_SNAPSHOT_FILE ".tmp",
+                 MEMDB_JOURNAL_KIND_SNAPSHOT,
+                 Generation,
+                 &ctx.fd);
+    BAIL_ON_NT_STATUS(status);
+    ctx.Size = sizeof(MEMDB_JOURNAL_HEADER);
+
+    hRoot = MemRegRoot()->pMemReg;
+    for (index=0; index < hRoot->NodesLen; index++)
+    {
+        status = _MemJournalSnapshotNode(&ctx, hRoot->SubNodes[index]);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    status = _MemJournalWriteAll(ctx.fd, ctx.Buffer.pData, ctx.Buffer.dwLen);
+    BAIL_ON_NT_STATUS(status);
+    ctx.Size += ctx.Buffer.dwLen;
+
+    /*
+     * The snapshot must be durable before the journal is replaced;
+     * until then the old snapshot and journal remain the valid pair.
+     */
+    status = _MemJournalCommitFile(
+                 ctx.fd,
+                 dfd,
+                 MEMDB_SNAPSHOT_FILE ".tmp",
+                 MEMDB_SNAPSHOT_FILE);
+    BAIL_ON_NT_STATUS(status);
+
+    if (pJournal->fd != -1)
+    {
+        close(pJournal->fd);
+    }
+    pJournal->fd = -1;
+    pJournal->bFailed = TRUE;
+    pJournal->Generation = Generation;
+    pJournal->SnapshotSize = ctx.Size;
+
+    status = _MemJournalCreateFile(
+                 MEMDB_JOURNAL_FILE ".tmp",
+                 MEMDB_JOURNAL_KIND_JOURNAL,
+                 Generation,
+                 &jfd);
+    BAIL_ON_NT_STATUS(status);
+
+    status = _MemJournalCommitFile(
+                 jfd,
+                 dfd,
+                 MEMDB_JOURNAL_FILE ".tmp",
+                 MEMDB_JOURNAL_FILE);
+    BAIL_ON_NT_STATUS(status);
+
+    pJournal->fd = jfd;
+    jfd = -1;
+    pJournal->Size = sizeof(MEMDB_JOURNAL_HEADER);
+    pJournal->bFailed = FALSE;
+
+cleanup:
+    if (ctx.fd != -1)
+    {
+        close(ctx.fd);
+    }
+    if (jfd != -1)
+    {
+        close(jfd);
+    }
+    if (dfd != -1)
+    {
+        close(dfd);
+    }
+    LWREG_SAFE_FREE_MEMORY(ctx.Buffer.pData);
+    LWREG_SAFE_FREE_MEMORY(ctx.pwszPath);
+    return status;
+
+error:
+    REG_LOG_ERROR("Failed writing registry snapshot %s (status 0x%x)",
+                  MEMDB_SNAPSHOT_FILE, status);
+    unlink(MEMDB_SNAPSHOT_FILE ".tmp");
+    unlink(MEMDB_JOURNAL_FILE ".tmp");
+    goto cleanup;
+}
+
+
+/*
+ * Makes appended records durable, compacting instead when the journal
+ * has outgrown its snapshot or could not be written.
+ */
+NTSTATUS
+MemJournalSync(
+    VOID)
+{
+    NTSTATUS status = 0;
+    PMEMDB_JOURNAL pJournal = _MemJournal();
+
+    if (!pJournal)
+    {
+        goto cleanup;
+    }
+
+    if (pJournal->bFailed ||
+        (pJournal->Size > MEMDB_JOURNAL_COMPACT_SIZE &&
+         pJournal->Size > pJournal->SnapshotSize))
+    {
+        status = MemJournalCompact();
+        BAIL_ON_NT_STATUS(status);
+    }
+    else if (fsync(pJournal->fd) == -1)
+    {
+        status = LwErrnoToNtStatus(errno);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+VOID
+MemJournalClose(
+    VOID)
+{
+    PMEMDB_JOURNAL pJournal = _MemJournal();
+
+    if (pJournal)
+    {
+        if (pJournal->fd != -1)
+        {
+            close(pJournal->fd);
+        }
+        LWREG_SAFE_FREE_MEMORY(pJournal->Record.pData);
+        LWREG_SAFE_FREE_MEMORY(MemRegRoot()->pJournal);
+    }
+}
+
+
+/*
+ * Builds the full path of a key below the root, as used by the records
+ */
+static NTSTATUS
+_MemJournalNodePath(
+    IN PMEMREG_NODE hNode,
+    OUT PWSTR *ppwszPath)
+{
+    NTSTATUS status = 0;
+    PMEMREG_NODE hKey = NULL;
+    PWSTR pwszPath = NULL;
+    size_t len = 0;
+    size_t nameLen = 0;
+
+    for (hKey = hNode; hKey && hKey->ParentNode; hKey = hKey->ParentNode)
+    {
+        len += RtlWC16StringNumChars(hKey->Name) + 1;
+    }
+    if (!len)
+    {
+        status = STATUS_INVALID_PARAMETER;
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    status = LW_RTL_ALLOCATE((PVOID*) &pwszPath, WCHAR, len * sizeof(WCHAR));
+    BAIL_ON_NT_STATUS(status);
+
+    pwszPath[--len] = '\0';
+    for (hKey = hNode; hKey && hKey->ParentNode; hKey = hKey->ParentNode)
+    {
+        nameLen = RtlWC16StringNumChars(hKey->Name);
+        len -= nameLen;
+        memcpy(&pwszPath[len], hKey->Name, nameLen * sizeof(WCHAR));
+        if (len)
+        {
+            pwszPath[--len] = '\\';
+        }
+    }
+
+    *ppwszPath = pwszPath;
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+static VOID
+_MemJournalAppend(
+    IN PMEMDB_JOURNAL pJournal,
+    IN NTSTATUS status)
+{
+    if (status == 0)
+    {
+        status = _MemJournalWriteAll(
+                     pJournal->fd,
+                     pJournal->Record.pData,
+                     pJournal->Record.dwLen);
+    }
+
+    if (status)
+    {
+        /* Leave no partial record behind; a snapshot will cover it */
+        REG_LOG_ERROR("Failed appending to registry journal %s "
+                      "(status 0x%x)",
+                      MEMDB_JOURNAL_FILE, status);
+        if (ftruncate(pJournal->fd, pJournal->Size) == -1)
+        {
+            REG_LOG_DEBUG("Failed truncating registry journal %s",
+                          MEMDB_JOURNAL_FILE);
+        }
+        pJournal->bFailed = TRUE;
+    }
+    else
+    {
+        pJournal->Size += pJournal->Record.dwLen;
+    }
+    pJournal->Record.dwLen = 0;
+}
+
+
+VOID
+MemJournalLogKey(
+    IN PMEMREG_NODE hNode)
+{
+    NTSTATUS status = 0;
+    PMEMDB_JOURNAL pJournal = _MemJournal();
+    PWSTR pwszPath = NULL;
+
+    if (!pJournal || pJournal->bFailed)
+    {
+        return;
+    }
+
+    status = _MemJournalNodePath(hNode, &pwszPath);
+    if (status == 0)
+    {
+        status = _MemJournalPutKey(&pJournal->Record, pwszPath, hNode);
+    }
+    _MemJournalAppend(pJournal, status);
+
+    LWREG_SAFE_FREE_MEMORY(pwszPath);
+}
+
+
+/*
+ * Must be called before the node is deleted, while its path is known
+ */
+VOID
+MemJournalLogKeyDelete(
+    IN PMEMREG_NODE hNode)
+{
+    NTSTATUS status = 0;
+    PMEMDB_JOURNAL pJournal = _MemJournal();
+    PWSTR pwszPath = NULL;
+    DWORD dwOffset = 0;
+
+    if (!pJournal || pJournal->bFailed)
+    {
+        return;
+    }
+
+    status = _MemJournalNodePath(hNode, &pwszPath);
+    BAIL_ON_NT_STATUS(status);
+
+    status = _MemJournalBeginRecord(
+                 &pJournal->Record,
+                 MEMDB_JOURNAL_RECORD_KEY_DELETE,
+                 &dwOffset);
+    BAIL_ON_NT_STATUS(status);
+    status = _MemJournalPutString(&pJournal->Record, pwszPath);
+    BAIL_ON_NT_STATUS(status);
+    _MemJournalEndRecord(&pJournal->Record, dwOffset);
+
+error:
+    _MemJournalAppend(pJournal, status);
+    LWREG_SAFE_FREE_MEMORY(pwszPath);
+}
+
+
+/*
+ * Records the current state of a value, or its removal when the
+ * value no longer exists
+ */
+VOID
+MemJournalLogValue(
+    IN PMEMREG_NODE hNode,
+    IN OPTIONAL PCWSTR pValueName)
+{
+    NTSTATUS status = 0;
+    PMEMDB_JOURNAL pJournal = _MemJournal();
+    PWSTR pwszPath = NULL;
+    PMEMREG_VALUE hValue = NULL;
+    DWORD dwOffset = 0;
+    WCHAR pwszNull[1] = {0};
+
+    if (!pJournal || pJournal->bFailed)
+    {
+        return;
+    }
+
+    status = _MemJournalNodePath(hNode, &pwszPath);
+    BAIL_ON_NT_STATUS(status);
+
+    status = MemRegStoreFindNodeValue(hNode, pValueName, &hValue);
+    if (status == 0)
+    {
+        status = _MemJournalPutValue(&pJournal->Record, pwszPath, hValue);
+        BAIL_ON_NT_STATUS(status);
+    }
+    else if (status == STATUS_OBJECT_NAME_NOT_FOUND)
+    {
+        status = _MemJournalBeginRecord(
+                     &pJournal->Record,
+                     MEMDB_JOURNAL_RECORD_VALUE_DELETE,
+                     &dwOffset);
+        BAIL_ON_NT_STATUS(status);
+        status = _MemJournalPutString(&pJournal->Record, pwszPath);
+        BAIL_ON_NT_STATUS(status);
+        status = _MemJournalPutString(
+                     &pJournal->Record,
+                     pValueName ? pValueName : pwszNull);
+        BAIL_ON_NT_STATUS(status);
+        _MemJournalEndRecord(&pJournal->Record, dwOffset);
+    }
+    BAIL_ON_NT_STATUS(status);
+
+error:
+    _MemJournalAppend(pJournal, status);
+    LWREG_SAFE_FREE_MEMORY(pwszPath);
+}
+
+
+/*
+local variables:
+mode: c
+c-basic-offset: 4
+indent-tabs-mode: nil
+tab-width: 4
+end:
+*/
@@ -0,0 +1,165 @@
+/* Editor Settings: expandtabs and use 4 spaces for indentation
+ * ex: set softtabstop=4 tabstop=8 expandtab shiftwidth=4: *
+ */
+
+/*
+ * Copyright Likewise Software
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.  You should have received a copy of the GNU General
+ * Public License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *        memjournal.h
+ *
+ * Abstract:
+ *        Binary snapshot and change journal for the registry memory
+ *        provider backend
+ */
+#ifndef _MEMJOURNAL_H_
+#define _MEMJOURNAL_H_
+
+#define MEMDB_SNAPSHOT_FILE MEMDB_EXPORT_DIR "/memprovider.snap"
+#define MEMDB_JOURNAL_FILE MEMDB_EXPORT_DIR "/memprovider.jnl"
+
+/*
+ * The journal is folded into a new snapshot once it grows past this
+ * size and past the size of the snapshot it applies to.
+ */
+#define MEMDB_JOURNAL_COMPACT_SIZE (1024 * 1024)
+
+#define MEMDB_JOURNAL_MAGIC "LWREGMDB"
+#define MEMDB_JOURNAL_VERSION 1
+
+/*
+ * Both files start with a MEMDB_JOURNAL_HEADER followed by records.
+ * A record is a MEMDB_JOURNAL_RECORD_HEADER and dwLength bytes of
+ * payload. Every field is padded to 4 bytes, so strings can be handed
+ * to the store straight out of the file buffer. Files are in host byte
+ * order; they never leave the machine that wrote them.
+ */
+typedef enum _MEMDB_JOURNAL_KIND
+{
+    MEMDB_JOURNAL_KIND_SNAPSHOT = 1,
+    MEMDB_JOURNAL_KIND_JOURNAL = 2,
+} MEMDB_JOURNAL_KIND;
+
+typedef enum _MEMDB_JOURNAL_RECORD_TYPE
+{
+    /* Path, security descriptor (empty when inherited) */
+    MEMDB_JOURNAL_RECORD_KEY = 1,
+    /* Path */
+    MEMDB_JOURNAL_RECORD_KEY_DELETE,
+    /* Path, name, type, data, attributes */
+    MEMDB_JOURNAL_RECORD_VALUE,
+    /* Path, name */
+    MEMDB_JOURNAL_RECORD_VALUE_DELETE,
+} MEMDB_JOURNAL_RECORD_TYPE;
+
+typedef struct _MEMDB_JOURNAL_HEADER
+{
+    CHAR Magic[8];
+    DWORD dwVersion;
+    DWORD dwKind;
+    ULONG64 Generation;
+} MEMDB_JOURNAL_HEADER, *PMEMDB_JOURNAL_HEADER;
+
+typedef struct _MEMDB_JOURNAL_RECORD_HEADER
+{
+    DWORD dwLength;
+    DWORD dwChecksum;
+} MEMDB_JOURNAL_RECORD_HEADER, *PMEMDB_JOURNAL_RECORD_HEADER;
+
+typedef struct _MEMDB_JOURNAL_BUFFER
+{
+    PBYTE pData;
+    DWORD dwLen;
+    DWORD dwSize;
+} MEMDB_JOURNAL_BUFFER, *PMEMDB_JOURNAL_BUFFER;
+
+/*
+ * Records are appended by mutators holding the registry lock
+ * exclusively. The export thread syncs and compacts holding it shared,
+ * which keeps the mutators out.
+ */
+typedef struct _MEMDB_JOURNAL
+{
+    int fd;
+    ULONG64 Generation;
+    ULONG64 Size;
+    ULONG64 SnapshotSize;
+
+    /*
+     * Set when an append failed or no journal could be opened. No
+     * further records are written until a compaction captures the
+     * whole tree in a new snapshot.
+     */
+    BOOLEAN bFailed;
+    MEMDB_JOURNAL_BUFFER Record;
+} MEMDB_JOURNAL;
+
+
+NTSTATUS
+MemJournalOpen(
+    OUT PBOOLEAN pbLoaded
+    );
+
+NTSTATUS
+MemJournalDiscard(
+    VOID
+    );
+
+NTSTATUS
+MemJournalCompact(
+    VOID
+    );
+
+NTSTATUS
+MemJournalSync(
+    VOID
+    );
+
+VOID
+MemJournalClose(
+    VOID
+    );
+
+VOID
+MemJournalLogKey(
+    IN PMEMREG_NODE hNode
+    );
+
+VOID
+MemJournalLogKeyDelete(
+    IN PMEMREG_NODE hNode
+    );
+
+VOID
+MemJournalLogValue(
+    IN PMEMREG_NODE hNode,
+    IN OPTIONAL PCWSTR pValueName
+    );
+
+#endif
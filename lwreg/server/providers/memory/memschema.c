@@ -52,15 +52,37 @@ MemSetValueAttributes(
     NTSTATUS status = 0;
     REG_DB_CONNECTION regDbConn = {0};
     PREG_KEY_HANDLE pKeyHandle = (PREG_KEY_HANDLE) hKey;
+    PMEMREG_NODE hKeyNode = NULL;
+    BOOLEAN bInLock = FALSE;
 
     regDbConn.pMemReg = pKeyHandle->pKey->hNode;
+    LWREG_LOCK_RWMUTEX_EXCLUSIVE(bInLock, &MemRegRoot()->lock);
     status = MemDbSetValueAttributes(
                  hRegConnection,
                  &regDbConn,
                  pwszSubKey,
                  pValueName,
                  pValueAttributes);
+    BAIL_ON_NT_STATUS(status);
+
+    hKeyNode = regDbConn.pMemReg;
+    if (pwszSubKey)
+    {
+        status = MemRegStoreFindNode(
+                     regDbConn.pMemReg,
+                     pwszSubKey,
+                     &hKeyNode);
+        BAIL_ON_NT_STATUS(status);
+    }
+    MemJournalLogValue(hKeyNode, pValueName);
+    MemDbExportEntryChanged();
+
+cleanup:
+    LWREG_UNLOCK_RWMUTEX(bInLock, &MemRegRoot()->lock);
     return status;
+
+error:
+    goto cleanup;
 }
 
 
@@ -113,6 +113,179 @@ error:
 }
 
 
+static DWORD
+_MemRegHashName(
+    IN PCWSTR Name,
+    IN size_t NameLen)
+{
+    DWORD hash = 2166136261U;
+    size_t index = 0;
+
+    /* FNV-1a over the same case folding LwRtlWC16StringIsEqual uses */
+    for (index=0; index < NameLen; index++)
+    {
+        hash ^= (WCHAR) towupper((wint_t) Name[index]);
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+
+static BOOLEAN
+_MemRegNameIsEqual(
+    IN PCWSTR NodeName,
+    IN PCWSTR Name,
+    IN size_t NameLen)
+{
+    size_t index = 0;
+
+    for (index=0; index < NameLen; index++)
+    {
+        if (!NodeName[index] ||
+            towupper((wint_t) NodeName[index]) != towupper((wint_t) Name[index]))
+        {
+            return FALSE;
+        }
+    }
+
+    return NodeName[NameLen] == '\0';
+}
+
+
+static VOID
+_MemRegIndexInsert(
+    IN PMEMREG_NODE hParentNode,
+    IN PMEMREG_NODE hNode)
+{
+    DWORD bucket = hNode->NameHash & (hParentNode->HashBucketsLen - 1);
+
+    hNode->HashNext = hParentNode->HashBuckets[bucket];
+    hParentNode->HashBuckets[bucket] = hNode;
+}
+
+
+static VOID
+_MemRegIndexRemove(
+    IN PMEMREG_NODE hParentNode,
+    IN PMEMREG_NODE hNode)
+{
+    PMEMREG_NODE *phEntry = NULL;
+
+    if (!hParentNode->HashBucketsLen)
+    {
+        return;
+    }
+
+    phEntry = &hParentNode->HashBuckets[
+                  hNode->NameHash & (hParentNode->HashBucketsLen - 1)];
+    while (*phEntry && *phEntry != hNode)
+    {
+        phEntry = &(*phEntry)->HashNext;
+    }
+    if (*phEntry)
+    {
+        *phEntry = hNode->HashNext;
+    }
+    hNode->HashNext = NULL;
+}
+
+
+/*
+ * Make room in the subkey index for one more node, creating the
+ * index once the node has enough subkeys to make scanning costly.
+ */
+static NTSTATUS
+_MemRegIndexReserve(
+    IN PMEMREG_NODE hParentNode)
+{
+    NTSTATUS status = 0;
+    PMEMREG_NODE *pBuckets = NULL;
+    DWORD bucketsLen = 0;
+    DWORD index = 0;
+
+    if (hParentNode->NodesLen + 1 < MEMREG_SUBNODE_INDEX_MIN ||
+        hParentNode->NodesLen + 1 <= hParentNode->HashBucketsLen)
+    {
+        goto cleanup;
+    }
+
+    bucketsLen = hParentNode->HashBucketsLen ?
+                     hParentNode->HashBucketsLen * 2 :
+                     MEMREG_SUBNODE_INDEX_MIN * 2;
+
+    status = LW_RTL_ALLOCATE(
+                 (PVOID*) &pBuckets,
+                 PMEMREG_NODE,
+                 sizeof(*pBuckets) * bucketsLen);
+    BAIL_ON_NT_STATUS(status);
+
+    LWREG_SAFE_FREE_MEMORY(hParentNode->HashBuckets);
+    hParentNode->HashBuckets = pBuckets;
+    hParentNode->HashBucketsLen = bucketsLen;
+    pBuckets = NULL;
+
+    for (index=0; index < hParentNode->NodesLen; index++)
+    {
+        _MemRegIndexInsert(hParentNode, hParentNode->SubNodes[index]);
+    }
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+
+static NTSTATUS
+_MemRegStoreLookupNode(
+    IN PMEMREG_NODE hDbNode,
+    IN PCWSTR Name,
+    IN size_t NameLen,
+    OUT PMEMREG_NODE *pphNode)
+{
+    PMEMREG_NODE hNode = NULL;
+    DWORD hash = 0;
+    DWORD nodeIndex = 0;
+
+    if (hDbNode->HashBucketsLen)
+    {
+        hash = _MemRegHashName(Name, NameLen);
+        for (hNode = hDbNode->HashBuckets[hash & (hDbNode->HashBucketsLen - 1)];
+             hNode;
+             hNode = hNode->HashNext)
+        {
+            if (hNode->NameHash == hash &&
+                _MemRegNameIsEqual(hNode->Name, Name, NameLen))
+            {
+                break;
+            }
+        }
+    }
+    else
+    {
+        for (nodeIndex=0; nodeIndex<hDbNode->NodesLen; nodeIndex++)
+        {
+            if (hDbNode->SubNodes[nodeIndex] &&
+                _MemRegNameIsEqual(hDbNode->SubNodes[nodeIndex]->Name, Name, NameLen))
+            {
+                hNode = hDbNode->SubNodes[nodeIndex];
+                break;
+            }
+        }
+    }
+
+    if (!hNode)
+    {
+        return STATUS_OBJECT_NAME_NOT_FOUND;
+    }
+
+    *pphNode = hNode;
+    return STATUS_SUCCESS;
+}
+
+
 NTSTATUS
 MemRegStoreOpen(
     OUT PMEMREG_NODE *pphDbNode)
@@ -193,6 +366,7 @@ MemRegStoreClose(
     {
         LWREG_SAFE_FREE_MEMORY(hRootNode->Name);
     }
+    LWREG_SAFE_FREE_MEMORY(hRootNode->HashBuckets);
 
     LWREG_SAFE_FREE_MEMORY(hRootNode);
 cleanup:
@@ -210,60 +384,43 @@ MemRegStoreFindNodeSubkey(
     OUT PMEMREG_NODE * phNode)
 {
     NTSTATUS status = 0;
-    PWSTR pwszTmpFullPath = NULL;
-    PWSTR pwszSubKey = NULL;
-    PWSTR pwszPtr = NULL;
+    PCWSTR pwszSubKey = NULL;
+    PCWSTR pwszPtr = NULL;
     PMEMREG_NODE hParentKey = NULL;
     PMEMREG_NODE hSubKey = NULL;
-    BOOLEAN bEndOfString = FALSE;
-
-
-    BAIL_ON_NT_STATUS(status);
 
     if (!pwszSubKeyPath)
     {
         pwszSubKeyPath = (PCWSTR) L"";
     }
 
-
-    status = LwRtlWC16StringDuplicate(&pwszTmpFullPath, pwszSubKeyPath);
-    BAIL_ON_NT_STATUS(status);
-
+    /*
+     * Iterate over subkeys in \ separated path, matching each
+     * component in place.
+     */
     hParentKey = hDbNode;
-    pwszSubKey = pwszTmpFullPath;
+    pwszSubKey = pwszSubKeyPath;
     do
     {
-        pwszPtr = pwstr_wcschr(pwszSubKey, L'\\');
-        if (pwszPtr)
-        {
-            *pwszPtr++ = L'\0';
-        }
-        else
+        for (pwszPtr = pwszSubKey; *pwszPtr && *pwszPtr != '\\'; pwszPtr++)
         {
-            pwszPtr = pwszSubKey;
-            bEndOfString = TRUE;
+            ;
         }
 
-        /*
-         * Iterate over subkeys in \ sepearated path.
-         */
-        status = MemRegStoreFindNode(
+        status = _MemRegStoreLookupNode(
                      hParentKey,
                      pwszSubKey,
+                     pwszPtr - pwszSubKey,
                      &hSubKey);
         hParentKey = hSubKey;
-        pwszSubKey = pwszPtr;
-    } while (status == 0 && !bEndOfString);
+        pwszSubKey = pwszPtr + 1;
+    } while (status == 0 && *pwszPtr);
     if (status == 0)
     {
         *phNode = hParentKey;
     }
 
-cleanup:
-    LWREG_SAFE_FREE_MEMORY(pwszTmpFullPath);
     return status;
-error:
-    goto cleanup;
 }
 
 
@@ -273,41 +430,16 @@ MemRegStoreFindNode(
     IN PCWSTR Name,
     OUT PMEMREG_NODE *pphNode)
 {
-    NTSTATUS status = 0;
-    DWORD nodeIndex = 0;
-    BOOLEAN bFoundNode = FALSE;
-
-    BAIL_ON_NT_STATUS(status);
-
     if (!Name)
     {
         Name = (PCWSTR) L"";
     }
 
-    for (nodeIndex=0; nodeIndex<hDbNode->NodesLen; nodeIndex++)
-    {
-        if (hDbNode->SubNodes[nodeIndex] &&
-            LwRtlWC16StringIsEqual(Name, hDbNode->SubNodes[nodeIndex]->Name, FALSE))
-        {
-            bFoundNode = TRUE;
-            break;
-        }
-    }
-
-    if (bFoundNode)
-    {
-        *pphNode = hDbNode->SubNodes[nodeIndex];
-    }
-    else
-    {
-        status = STATUS_OBJECT_NAME_NOT_FOUND;
-    }
-
-cleanup:
-    return status;
-
-error:
-    goto cleanup;
+    return _MemRegStoreLookupNode(
+               hDbNode,
+               Name,
+               RtlWC16StringNumChars(Name),
+               pphNode);
 }
 
 
@@ -354,6 +486,7 @@ MemRegStoreDeleteNode(
     }
     if (bNodeFound)
     {
+        _MemRegIndexRemove(hDbNode->ParentNode, hDbNode);
         hDbNode->ParentNode->SubNodes[index] = NULL;
 
         /* Shift all pointers right of node just removed left over empty slot */
@@ -382,6 +515,7 @@ MemRegStoreDeleteNode(
         LWREG_SAFE_FREE_MEMORY(hDbNode->pNodeSd->SecurityDescriptor);
     }
     LWREG_SAFE_FREE_MEMORY(hDbNode->pNodeSd);
+    LWREG_SAFE_FREE_MEMORY(hDbNode->HashBuckets);
     LWREG_SAFE_FREE_MEMORY(hDbNode->Name);
     LWREG_SAFE_FREE_MEMORY(hDbNode);
 
@@ -415,11 +549,21 @@ MemRegStoreAddNode(
         status = STATUS_TOO_MANY_NAMES;
         BAIL_ON_NT_STATUS(status);
     }
+
+    /*
+     * Everything that can fail happens before the parent is modified,
+     * so SubNodes and its index never reference a freed node.
+     */
+    status = _MemRegIndexReserve(hParentNode);
+    BAIL_ON_NT_STATUS(status);
+
     status = NtRegReallocMemory(
                  hParentNode->SubNodes, 
                  (PVOID) &pNodesArray,
                  (hParentNode->NodesLen + 1) * sizeof(PMEMREG_NODE));
     BAIL_ON_NT_STATUS(status);
+    hParentNode->SubNodes = pNodesArray;
+    pNodesArray = NULL;
 
     status = LW_RTL_ALLOCATE(
                  (PVOID*) &pNewNode, PMEMREG_NODE, sizeof(MEMREG_NODE));
@@ -428,10 +572,15 @@ MemRegStoreAddNode(
 
     status = LwRtlWC16StringDuplicate(&newNodeName, Name);
     BAIL_ON_NT_STATUS(status);
+
+    status = MemRegStoreCreateSecurityDescriptor(
+                 hParentNode->pNodeSd,
+                 SecurityDescriptor,
+                 SecurityDescriptorLen,
+                 &pUpdatedNodeSd);
+    BAIL_ON_NT_STATUS(status);
   
-    pNodesArray[hParentNode->NodesLen] = NULL;
-    hParentNode->SubNodes = pNodesArray;
-    pNodesArray = NULL;
+    hParentNode->SubNodes[hParentNode->NodesLen] = NULL;
 
     if (NodeType > 1)
     {
@@ -472,19 +621,15 @@ MemRegStoreAddNode(
     pNewNode->NodeType = NodeType;
     pNewNode->Name = newNodeName;
     newNodeName = NULL;
+    pNewNode->NameHash = _MemRegHashName(
+                             pNewNode->Name,
+                             RtlWC16StringNumChars(pNewNode->Name));
+    pNewNode->pNodeSd = pUpdatedNodeSd;
 
-    status = MemRegStoreCreateSecurityDescriptor(
-                 hParentNode->pNodeSd,
-                 SecurityDescriptor,
-                 SecurityDescriptorLen,
-                 &pUpdatedNodeSd);
-    BAIL_ON_NT_STATUS(status);
-    if (pNewNode->pNodeSd)
+    if (hParentNode->HashBucketsLen)
     {
-        LWREG_SAFE_FREE_MEMORY(pNewNode->pNodeSd->SecurityDescriptor);
+        _MemRegIndexInsert(hParentNode, pNewNode);
     }
-    LWREG_SAFE_FREE_MEMORY(pNewNode->pNodeSd);
-    pNewNode->pNodeSd = pUpdatedNodeSd;
 
     hParentNode->NodesLen++;
     pNewNode->SubNodeDepth = hParentNode->SubNodeDepth+1;
@@ -51,6 +51,11 @@
 #define MEMREG_MAX_SUBNODE_STACK (MEMREG_MAX_SUBNODES * 16)
 #define MEMREG_MAX_VALUENAME_LEN 255
 
+/*
+ * Nodes with at least this many subkeys get a hash index over them
+ */
+#define MEMREG_SUBNODE_INDEX_MIN 8
+
 typedef struct _MEMREG_VALUE
 {
     PWSTR Name;
@@ -95,6 +100,16 @@ typedef struct _MEMREG_NODE
     struct _MEMREG_NODE **SubNodes;
     DWORD NodesLen;
 
+    /*
+     * Hash index over SubNodes by case-folded name, chained through
+     * HashNext. SubNodes keeps the sorted order used for enumeration.
+     * HashBucketsLen is 0 or a power of 2.
+     */
+    struct _MEMREG_NODE **HashBuckets;
+    DWORD HashBucketsLen;
+    DWORD NameHash;
+    struct _MEMREG_NODE *HashNext;
+
     PMEMREG_VALUE *Values;
     DWORD ValuesLen;
 } MEMREG_NODE;
@@ -224,7 +224,6 @@ SqliteGetValueAttributes_Internal(
     PLWREG_CURRENT_VALUEINFO pCurrentValue = NULL;
     BOOLEAN bInDbLock = FALSE;
     BOOLEAN bInLock = FALSE;
-    PSTR pszError = NULL;
     PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)ghCacheConnection;
     PREG_SRV_API_STATE pServerState = (PREG_SRV_API_STATE)hRegConnection;
 
@@ -260,13 +259,8 @@ SqliteGetValueAttributes_Internal(
 
     ENTER_SQLITE_LOCK(&pConn->lock, bInDbLock);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     // pServerState->pToken should be created at this point
     status = SqliteOpenKeyInternal_inlock_inDblock(
@@ -343,13 +337,8 @@ SqliteGetValueAttributes_Internal(
         BAIL_ON_NT_STATUS(status);
     }
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c SqliteGetValueAttributes_Internal() finished");
 
@@ -382,15 +371,7 @@ cleanup:
     return status;
 
 error:
-    if (pszError)
-    {
-        sqlite3_free(pszError);
-    }
-    sqlite3_exec(pConn->pDb,
-                 "rollback",
-                 NULL,
-                 NULL,
-                 NULL);
+    RegDbRollbackTransaction_inlock(pConn);
 
     if (ppCurrentValue)
     {
@@ -54,6 +54,24 @@ RegDbUpdateKeyAclContent_inlock(
     IN ULONG ulSecDescToSetLen
     );
 
+static
+NTSTATUS
+RegDbFreePreparedStatements(
+    IN OUT PREG_DB_CONNECTION pConn
+    );
+
+static
+VOID
+RegDbCloseReader(
+    IN OUT PREG_DB_CONNECTION* ppReader
+    );
+
+static
+VOID
+RegDbCloseReaders(
+    IN OUT PREG_DB_CONNECTION pConn
+    );
+
 
 NTSTATUS
 RegDbUnpackCacheInfo(
@@ -339,57 +357,15 @@ error:
     goto cleanup;
 }
 
+static
 NTSTATUS
-RegDbOpen(
-    IN PCSTR pszDbPath,
-    OUT PREG_DB_HANDLE phDb
+RegDbPrepareStatements(
+    IN OUT PREG_DB_CONNECTION pConn
     )
 {
-	NTSTATUS status = 0;
-    BOOLEAN bLockCreated = FALSE;
-    PREG_DB_CONNECTION pConn = NULL;
-    BOOLEAN bExists = FALSE;
-    PSTR pszDbDir = NULL;
+    NTSTATUS status = STATUS_SUCCESS;
     PWSTR pwszQueryStatement = NULL;
 
-    status = RegGetDirectoryFromPath(
-                    pszDbPath,
-                    &pszDbDir);
-    BAIL_ON_NT_STATUS(status);
-
-    status = LW_RTL_ALLOCATE((PVOID*)&pConn, REG_DB_CONNECTION, sizeof(*pConn));
-    BAIL_ON_NT_STATUS(status);
-
-    memset(pConn, 0, sizeof(*pConn));
-
-    status = pthread_rwlock_init(&pConn->lock, NULL);
-    BAIL_ON_NT_STATUS(status);
-    bLockCreated = TRUE;
-
-    status = RegCheckDirectoryExists(pszDbDir, &bExists);
-    BAIL_ON_NT_STATUS(status);
-
-    if (!bExists)
-    {
-        mode_t cacheDirMode = S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH;
-
-        status = RegCreateDirectory(pszDbDir, cacheDirMode);
-        BAIL_ON_NT_STATUS(status);
-    }
-
-    /* restrict access to u+rwx to the db folder */
-    status = RegChangeOwnerAndPermissions(pszDbDir, 0, 0, S_IRWXU);
-    BAIL_ON_NT_STATUS(status);
-
-    status = sqlite3_open(pszDbPath, &pConn->pDb);
-    BAIL_ON_NT_STATUS(status);
-
-    status = RegChangeOwnerAndPermissions(pszDbPath, 0, 0, S_IRWXU);
-    BAIL_ON_NT_STATUS(status);
-
-    status = RegDbSetup(pConn->pDb);
-    BAIL_ON_NT_STATUS(status);
-
 	/*pstCreateRegKey*/
 	status = LwRtlWC16StringAllocateFromCString(&pwszQueryStatement, REG_DB_INSERT_REG_KEY);
 	BAIL_ON_NT_STATUS(status);
@@ -849,23 +825,238 @@ RegDbOpen(
     LWREG_SAFE_FREE_MEMORY(pwszQueryStatement);
 
 
+    status = sqlite3_prepare_v2(
+            pConn->pDb,
+            "begin",
+            -1,
+            &pConn->pstBegin,
+            NULL);
+    BAIL_ON_SQLITE3_ERROR(status, sqlite3_errmsg(pConn->pDb));
+
+    status = sqlite3_prepare_v2(
+            pConn->pDb,
+            "end",
+            -1,
+            &pConn->pstEnd,
+            NULL);
+    BAIL_ON_SQLITE3_ERROR(status, sqlite3_errmsg(pConn->pDb));
+
+    status = sqlite3_prepare_v2(
+            pConn->pDb,
+            "rollback",
+            -1,
+            &pConn->pstRollback,
+            NULL);
+    BAIL_ON_SQLITE3_ERROR(status, sqlite3_errmsg(pConn->pDb));
+
+cleanup:
+
+    LWREG_SAFE_FREE_MEMORY(pwszQueryStatement);
+
+    return status;
+
+error:
+
+    goto cleanup;
+}
+
+static
+NTSTATUS
+RegDbOpenReaders(
+    IN OUT PREG_DB_CONNECTION pConn,
+    IN PCSTR pszDbPath
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    sqlite3_stmt *pstJournalMode = NULL;
+    PCSTR pszJournalMode = NULL;
+    PREG_DB_CONNECTION pReader = NULL;
+    DWORD dwReaderCount = 0;
+
+    status = sqlite3_prepare_v2(
+            pConn->pDb,
+            "PRAGMA journal_mode=WAL",
+            -1,
+            &pstJournalMode,
+            NULL);
+    BAIL_ON_SQLITE3_ERROR(status, sqlite3_errmsg(pConn->pDb));
+
+    // Returns the journal mode in effect, which stays the old one if
+    // this sqlite or the file system cannot do WAL.
+    status = (DWORD)sqlite3_step(pstJournalMode);
+    if (status == SQLITE_ROW)
+    {
+        pszJournalMode = (PCSTR)sqlite3_column_text(pstJournalMode, 0);
+        status = STATUS_SUCCESS;
+    }
+    BAIL_ON_SQLITE3_ERROR(status, sqlite3_errmsg(pConn->pDb));
+
+    REG_LOG_INFO("Registry database journal mode is '%s'",
+                 REG_SAFE_LOG_STRING(pszJournalMode));
+
+    // The open statement would keep the readers locked out
+    sqlite3_finalize(pstJournalMode);
+    pstJournalMode = NULL;
+
+    dwReaderCount = LwRtlGetCpuCount();
+    if (dwReaderCount > REG_DB_MAX_READERS)
+    {
+        dwReaderCount = REG_DB_MAX_READERS;
+    }
+
+    while (pConn->dwReaderCount < dwReaderCount)
+    {
+        status = LW_RTL_ALLOCATE((PVOID*)&pReader, REG_DB_CONNECTION, sizeof(*pReader));
+        BAIL_ON_NT_STATUS(status);
+
+        status = sqlite3_open_v2(
+                pszDbPath,
+                &pReader->pDb,
+                SQLITE_OPEN_READONLY,
+                NULL);
+        BAIL_ON_SQLITE3_ERROR(status, sqlite3_errmsg(pReader->pDb));
+
+        status = sqlite3_busy_timeout(pReader->pDb, REG_DB_READER_BUSY_TIMEOUT);
+        BAIL_ON_SQLITE3_ERROR(status, sqlite3_errmsg(pReader->pDb));
+
+        status = RegDbPrepareStatements(pReader);
+        BAIL_ON_NT_STATUS(status);
+
+        pReader->pNextReader = pConn->pFreeReaders;
+        pConn->pFreeReaders = pReader;
+        pConn->dwReaderCount++;
+        pReader = NULL;
+    }
+
+cleanup:
+
+    if (pstJournalMode)
+    {
+        sqlite3_finalize(pstJournalMode);
+    }
+
+    return status;
+
+error:
+
+    // Whatever readers did open are still usable
+    REG_LOG_ERROR("Failed to open registry database reader [%d], %d available",
+                  status, pConn->dwReaderCount);
+    RegDbCloseReader(&pReader);
+    status = STATUS_SUCCESS;
+
+    goto cleanup;
+}
+
+NTSTATUS
+RegDbOpen(
+    IN PCSTR pszDbPath,
+    OUT PREG_DB_HANDLE phDb
+    )
+{
+	NTSTATUS status = 0;
+    BOOLEAN bLockCreated = FALSE;
+    BOOLEAN bReaderLockCreated = FALSE;
+    BOOLEAN bLockAttrCreated = FALSE;
+    pthread_rwlockattr_t lockAttr;
+    PREG_DB_CONNECTION pConn = NULL;
+    BOOLEAN bExists = FALSE;
+    PSTR pszDbDir = NULL;
+
+    status = RegGetDirectoryFromPath(
+                    pszDbPath,
+                    &pszDbDir);
+    BAIL_ON_NT_STATUS(status);
+
+    status = LW_RTL_ALLOCATE((PVOID*)&pConn, REG_DB_CONNECTION, sizeof(*pConn));
+    BAIL_ON_NT_STATUS(status);
+
+    memset(pConn, 0, sizeof(*pConn));
+
+    status = pthread_rwlockattr_init(&lockAttr);
+    BAIL_ON_NT_STATUS(status);
+    bLockAttrCreated = TRUE;
+
+#if defined(__GLIBC__)
+    // Readers share the lock; glibc would otherwise let a steady stream
+    // of them starve writers.
+    status = pthread_rwlockattr_setkind_np(
+                    &lockAttr,
+                    PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    BAIL_ON_NT_STATUS(status);
+#endif
+
+    status = pthread_rwlock_init(&pConn->lock, &lockAttr);
+    BAIL_ON_NT_STATUS(status);
+    bLockCreated = TRUE;
+
+    status = pthread_mutex_init(&pConn->readerMutex, NULL);
+    BAIL_ON_NT_STATUS(status);
+
+    status = pthread_cond_init(&pConn->readerCond, NULL);
+    BAIL_ON_NT_STATUS(status);
+    bReaderLockCreated = TRUE;
+
+    status = RegCheckDirectoryExists(pszDbDir, &bExists);
+    BAIL_ON_NT_STATUS(status);
+
+    if (!bExists)
+    {
+        mode_t cacheDirMode = S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH;
+
+        status = RegCreateDirectory(pszDbDir, cacheDirMode);
+        BAIL_ON_NT_STATUS(status);
+    }
+
+    /* restrict access to u+rwx to the db folder */
+    status = RegChangeOwnerAndPermissions(pszDbDir, 0, 0, S_IRWXU);
+    BAIL_ON_NT_STATUS(status);
+
+    status = sqlite3_open(pszDbPath, &pConn->pDb);
+    BAIL_ON_NT_STATUS(status);
+
+    status = RegChangeOwnerAndPermissions(pszDbPath, 0, 0, S_IRWXU);
+    BAIL_ON_NT_STATUS(status);
+
+    status = RegDbSetup(pConn->pDb);
+    BAIL_ON_NT_STATUS(status);
+
+    status = RegDbPrepareStatements(pConn);
+    BAIL_ON_NT_STATUS(status);
+
+    status = RegDbOpenReaders(pConn, pszDbPath);
+    BAIL_ON_NT_STATUS(status);
+
     *phDb = pConn;
 
 cleanup:
 
+    if (bLockAttrCreated)
+    {
+        pthread_rwlockattr_destroy(&lockAttr);
+    }
+
     LWREG_SAFE_FREE_STRING(pszDbDir);
-    LWREG_SAFE_FREE_MEMORY(pwszQueryStatement);
 
     return status;
 
 error:
     if (pConn != NULL)
     {
+        RegDbCloseReaders(pConn);
+        RegDbFreePreparedStatements(pConn);
+
         if (bLockCreated)
         {
             pthread_rwlock_destroy(&pConn->lock);
         }
 
+        if (bReaderLockCreated)
+        {
+            pthread_cond_destroy(&pConn->readerCond);
+            pthread_mutex_destroy(&pConn->readerMutex);
+        }
+
         if (pConn->pDb != NULL)
         {
             sqlite3_close(pConn->pDb);
@@ -877,6 +1068,131 @@ error:
     goto cleanup;
 }
 
+VOID
+RegDbAcquireReader(
+    IN REG_DB_HANDLE hDb,
+    OUT PREG_DB_HANDLE phReader
+    )
+{
+    PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
+    PREG_DB_CONNECTION pReader = NULL;
+
+    if (!pConn->dwReaderCount)
+    {
+        pthread_rwlock_wrlock(&pConn->lock);
+        *phReader = pConn;
+        return;
+    }
+
+    // Readers exclude writers but not each other, so they never see a
+    // key that a concurrent writer is about to delete from the cache.
+    pthread_rwlock_rdlock(&pConn->lock);
+
+    pthread_mutex_lock(&pConn->readerMutex);
+
+    while (!pConn->pFreeReaders)
+    {
+        pthread_cond_wait(&pConn->readerCond, &pConn->readerMutex);
+    }
+
+    pReader = pConn->pFreeReaders;
+    pConn->pFreeReaders = pReader->pNextReader;
+    pReader->pNextReader = NULL;
+
+    pthread_mutex_unlock(&pConn->readerMutex);
+
+    *phReader = pReader;
+}
+
+VOID
+RegDbReleaseReader(
+    IN REG_DB_HANDLE hDb,
+    IN OUT PREG_DB_HANDLE phReader
+    )
+{
+    PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
+    PREG_DB_CONNECTION pReader = *phReader;
+
+    if (!pReader)
+    {
+        return;
+    }
+
+    if (pReader != pConn)
+    {
+        pthread_mutex_lock(&pConn->readerMutex);
+
+        pReader->pNextReader = pConn->pFreeReaders;
+        pConn->pFreeReaders = pReader;
+        pthread_cond_signal(&pConn->readerCond);
+
+        pthread_mutex_unlock(&pConn->readerMutex);
+    }
+
+    pthread_rwlock_unlock(&pConn->lock);
+
+    *phReader = NULL;
+}
+
+static
+NTSTATUS
+RegDbExecPrepared_inlock(
+    IN PREG_DB_CONNECTION pConn,
+    IN sqlite3_stmt* pstQuery
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+
+    status = (DWORD)sqlite3_step(pstQuery);
+    if (status == SQLITE_DONE)
+    {
+        status = STATUS_SUCCESS;
+    }
+    BAIL_ON_SQLITE3_ERROR_DB(status, pConn->pDb);
+
+cleanup:
+
+    sqlite3_reset(pstQuery);
+
+    return status;
+
+error:
+
+    goto cleanup;
+}
+
+NTSTATUS
+RegDbBeginTransaction_inlock(
+    IN REG_DB_HANDLE hDb
+    )
+{
+    PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
+
+    return RegDbExecPrepared_inlock(pConn, pConn->pstBegin);
+}
+
+NTSTATUS
+RegDbEndTransaction_inlock(
+    IN REG_DB_HANDLE hDb
+    )
+{
+    PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
+
+    return RegDbExecPrepared_inlock(pConn, pConn->pstEnd);
+}
+
+VOID
+RegDbRollbackTransaction_inlock(
+    IN REG_DB_HANDLE hDb
+    )
+{
+    PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
+
+    // Fails harmlessly when the transaction never started
+    sqlite3_step(pConn->pstRollback);
+    sqlite3_reset(pConn->pstRollback);
+}
+
 NTSTATUS
 RegDbStoreRegValues(
     IN HANDLE hDB,
@@ -886,18 +1202,12 @@ RegDbStoreRegValues(
 {
     NTSTATUS status = 0;
     PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDB;
-    PSTR pszError = NULL;
     BOOLEAN bInLock = FALSE;
 
     ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
 
-    status = sqlite3_exec(
-    		        pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     status = RegDbStoreRegValues_inlock(
                                  hDB,
@@ -905,13 +1215,8 @@ RegDbStoreRegValues(
                                  ppValues);
     BAIL_ON_NT_STATUS(status);
 
-    status = sqlite3_exec(
-    		        pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c RegDbStoreRegValues() finished");
 
@@ -923,15 +1228,7 @@ cleanup:
 
  error:
 
-    if (pszError)
-    {
-        sqlite3_free(pszError);
-    }
-    sqlite3_exec(pConn->pDb,
- 				 "rollback",
- 				 NULL,
-				 NULL,
-				 NULL);
+    RegDbRollbackTransaction_inlock(pConn);
 
     goto cleanup;
 }
@@ -945,32 +1242,21 @@ RegDbUpdateRegValues(
 {
     NTSTATUS status = 0;
     PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDB;
-    PSTR pszError = NULL;
     BOOLEAN bInLock = FALSE;
 
 
     ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     status = RegDbUpdateRegValues_inlock(hDB,
                                          dwEntryCount,
                                          ppValues);
     BAIL_ON_NT_STATUS(status);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c RegDbUpdateRegValues() finished");
 
@@ -981,15 +1267,7 @@ cleanup:
 
 error:
 
-    if (pszError)
-    {
-        sqlite3_free(pszError);
-    }
-    sqlite3_exec(pConn->pDb,
-                 "rollback",
-                 NULL,
-                 NULL,
-                 NULL);
+    RegDbRollbackTransaction_inlock(pConn);
 
     goto cleanup;
 }
@@ -1002,52 +1280,35 @@ RegDbOpenKey(
     )
 {
     NTSTATUS status = 0;
-    PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
-    PSTR pszError = NULL;
-    BOOLEAN bInLock = FALSE;
+    REG_DB_HANDLE hReader = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbAcquireReader(hDb, &hReader);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(hReader);
+    BAIL_ON_NT_STATUS(status);
 
-    status = RegDbOpenKey_inlock(hDb,
+    status = RegDbOpenKey_inlock(hReader,
     		                     pwszFullKeyPath,
     		                     ppRegKey);
     BAIL_ON_NT_STATUS(status);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(hReader);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c RegDbOpenKey() finished");
 
 cleanup:
 
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbReleaseReader(hDb, &hReader);
 
     return status;
 
 error:
 
-    if (pszError)
+    if (hReader)
     {
-        sqlite3_free(pszError);
+        RegDbRollbackTransaction_inlock(hReader);
     }
-    sqlite3_exec(pConn->pDb,
-                 "rollback",
-                 NULL,
-                 NULL,
-                 NULL);
 
     goto cleanup;
 }
@@ -1069,7 +1330,6 @@ RegDbCreateKey(
     PCWSTR pwszKeyName = RegStrrchr(pwszFullKeyName, '\\');
     BOOLEAN bInLock = FALSE;
     BOOLEAN bInDbLock = FALSE;
-    PSTR pszError = NULL;
     PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
 
     if (pwszKeyName)
@@ -1106,13 +1366,8 @@ RegDbCreateKey(
 
     ENTER_SQLITE_LOCK(&pConn->lock, bInDbLock);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     status = RegDbStoreRegKeys_inlock(
                  hDb,
@@ -1123,13 +1378,8 @@ RegDbCreateKey(
 	status = RegDbOpenKey_inlock(hDb, pRegKey->pwszFullKeyName, &pRegKeyFull);
 	BAIL_ON_NT_STATUS(status);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
 	pRegKey->qwAclIndex = pRegKeyFull->qwAclIndex;
 	pRegKey->qwParentId = pRegKeyFull->qwParentId;
@@ -1158,15 +1408,7 @@ error:
     RegDbSafeFreeEntryKey(&pRegKeyFull);
     *ppRegKey = NULL;
 
-    if (pszError)
-    {
-        sqlite3_free(pszError);
-    }
-    sqlite3_exec(pConn->pDb,
-                 "rollback",
-                 NULL,
-                 NULL,
-                 NULL);
+    RegDbRollbackTransaction_inlock(pConn);
 
     goto cleanup;
 }
@@ -1246,20 +1488,14 @@ RegDbSetKeyValue(
 {
 	NTSTATUS status = STATUS_SUCCESS;
 	BOOLEAN bIsWrongType = FALSE;
-	PSTR pszError = NULL;
 	PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
     PREG_DB_VALUE pRegEntry = NULL;
     BOOLEAN bInLock = FALSE;
 
     ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     status = RegDbGetKeyValue_inlock(
                               hDb,
@@ -1303,13 +1539,8 @@ RegDbSetKeyValue(
     }
     BAIL_ON_NT_STATUS(status);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c RegDbSetKeyValue() finished");
 
@@ -1330,15 +1561,7 @@ cleanup:
     return status;
 
 error:
-    if (pszError)
-    {
-        sqlite3_free(pszError);
-    }
-    sqlite3_exec(pConn->pDb,
-                 "rollback",
-                 NULL,
-                 NULL,
-                 NULL);
+    RegDbRollbackTransaction_inlock(pConn);
 
     RegDbSafeFreeEntryValue(&pRegEntry);
     if (ppRegEntry)
@@ -1360,9 +1583,7 @@ RegDbGetKeyValue(
     )
 {
     NTSTATUS status = STATUS_SUCCESS;
-    PSTR pszError = NULL;
-    PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    REG_DB_HANDLE hReader = NULL;
 
     BAIL_ON_NT_INVALID_STRING(pwszValueName);
 
@@ -1372,18 +1593,13 @@ RegDbGetKeyValue(
     	BAIL_ON_NT_STATUS(status);
     }
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbAcquireReader(hDb, &hReader);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(hReader);
+    BAIL_ON_NT_STATUS(status);
 
     status = RegDbGetKeyValue_inlock(
-                           hDb,
+                           hReader,
                            qwParentKeyId,
                            pwszValueName,
                            valueType,
@@ -1391,32 +1607,22 @@ RegDbGetKeyValue(
                            ppRegEntry);
     BAIL_ON_NT_STATUS(status);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(hReader);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c RegDbGetKeyValue() finished");
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbReleaseReader(hDb, &hReader);
 
     return status;
 
 error:
 
-    if (pszError)
+    if (hReader)
     {
-        sqlite3_free(pszError);
+        RegDbRollbackTransaction_inlock(hReader);
     }
-    sqlite3_exec(pConn->pDb,
-                 "rollback",
-                 NULL,
-                 NULL,
-                 NULL);
 
     goto cleanup;
 }
@@ -1430,20 +1636,14 @@ RegDbDeleteKey(
     )
 {
 	NTSTATUS status = STATUS_SUCCESS;
-	PSTR pszError = NULL;
     BOOLEAN bInLock = FALSE;
     PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
 
 
     ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
 
-    status = sqlite3_exec(
-    		        pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     status = RegDbDeleteKey_inlock(hDb,
                                    qwId,
@@ -1451,13 +1651,8 @@ RegDbDeleteKey(
                                    pwszFullKeyName);
     BAIL_ON_NT_STATUS(status);
 
-    status = sqlite3_exec(
-    		        pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c RegDbDeleteKey() finished");
 
@@ -1469,15 +1664,7 @@ cleanup:
 
  error:
 
-    if (pszError)
-    {
-        sqlite3_free(pszError);
-    }
-    sqlite3_exec(pConn->pDb,
- 				 "rollback",
- 				 NULL,
-				 NULL,
-				 NULL);
+    RegDbRollbackTransaction_inlock(pConn);
 
     goto cleanup;
 }
@@ -1535,8 +1722,7 @@ RegDbQueryInfoKeyCount(
     )
 {
 	NTSTATUS status = STATUS_SUCCESS;
-    PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    REG_DB_HANDLE hReader = NULL;
 
     if (qwId <= 0)
     {
@@ -1544,16 +1730,16 @@ RegDbQueryInfoKeyCount(
     	BAIL_ON_NT_STATUS(status);
     }
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbAcquireReader(hDb, &hReader);
 
-    status = RegDbQueryInfoKeyCount_inlock(hDb,
+    status = RegDbQueryInfoKeyCount_inlock(hReader,
     		                               qwId,
     		                               queryType,
     		                               psCount);
     BAIL_ON_NT_STATUS(status);
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbReleaseReader(hDb, &hReader);
 
     return status;
 
@@ -1576,8 +1762,7 @@ RegDbQueryInfoKey(
     )
 {
 	NTSTATUS status = STATUS_SUCCESS;
-    PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    REG_DB_HANDLE hReader = NULL;
 
     if (qwId <= 0)
     {
@@ -1585,9 +1770,9 @@ RegDbQueryInfoKey(
     	BAIL_ON_NT_STATUS(status);
     }
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbAcquireReader(hDb, &hReader);
 
-    status = RegDbQueryInfoKey_inlock(hDb,
+    status = RegDbQueryInfoKey_inlock(hReader,
     		                          pwszKeyName,
     		                          qwId,
     		                          dwLimit,
@@ -1598,7 +1783,7 @@ RegDbQueryInfoKey(
 
 cleanup:
 
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbReleaseReader(hDb, &hReader);
 
     return status;
 
@@ -1618,8 +1803,7 @@ RegDbQueryInfoKeyValue(
     )
 {
 	NTSTATUS status = STATUS_SUCCESS;
-    PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
-    BOOLEAN bInLock = FALSE;
+    PREG_DB_CONNECTION pReader = NULL;
     // do not free
     sqlite3_stmt *pstQuery = NULL;
     size_t sResultCount = 0;
@@ -1636,9 +1820,9 @@ RegDbQueryInfoKeyValue(
     	BAIL_ON_NT_STATUS(status);
     }
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbAcquireReader(hDb, &pReader);
 
-    pstQuery = pConn->pstQueryValues;
+    pstQuery = pReader->pstQueryValues;
 
     status = RegSqliteBindInt64(pstQuery, 1, qwId);
     BAIL_ON_SQLITE3_ERROR_STMT(status, pstQuery);
@@ -1689,10 +1873,10 @@ RegDbQueryInfoKeyValue(
         // No more results found
         status = STATUS_SUCCESS;
     }
-    BAIL_ON_SQLITE3_ERROR_DB(status, pConn->pDb);
+    BAIL_ON_SQLITE3_ERROR_DB(status, pReader->pDb);
 
     status = (DWORD)sqlite3_reset(pstQuery);
-    BAIL_ON_SQLITE3_ERROR_DB(status, pConn->pDb);
+    BAIL_ON_SQLITE3_ERROR_DB(status, pReader->pDb);
 
 cleanup:
     if (!status)
@@ -1714,7 +1898,7 @@ cleanup:
         *psCount = 0;
     }
 
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbReleaseReader(hDb, &pReader);
 
 
     return status;
@@ -1814,7 +1998,6 @@ RegDbUpdateKeyAcl(
 	NTSTATUS status = STATUS_SUCCESS;
     BOOLEAN bInLock = FALSE;
     PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
-    PSTR pszError = NULL;
     int64_t qwAclIndex = -1;
     // Do not free
     sqlite3_stmt *pstCreateKeyAcl = pConn->pstCreateRegAcl;
@@ -1822,13 +2005,8 @@ RegDbUpdateKeyAcl(
 
     ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
 
-    status = sqlite3_exec(
-    		        pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
    	// Check whether the current ACL still has reference to it in the DB
     // If not, delete this ACL
@@ -1880,13 +2058,8 @@ RegDbUpdateKeyAcl(
 	    BAIL_ON_NT_STATUS(status);
 	}
 
-    status = sqlite3_exec(
-    		        pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c RegDbUpdateKeyAcl() finished");
 
@@ -1900,15 +2073,7 @@ cleanup:
 
  error:
 
-	if (pszError)
-	{
-		sqlite3_free(pszError);
-	}
-	sqlite3_exec(pConn->pDb,
-				 "rollback",
-				 NULL,
-				 NULL,
-				 NULL);
+	RegDbRollbackTransaction_inlock(pConn);
 
 	goto cleanup;
 }
@@ -1923,61 +2088,44 @@ RegDbGetKeyAclByKeyId(
     )
 {
 	NTSTATUS status = 0;
-	PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
-	PSTR pszError = NULL;
-	BOOLEAN bInLock = FALSE;
+	REG_DB_HANDLE hReader = NULL;
 	int64_t qwKeyAclId = -1;
 
-	ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+	RegDbAcquireReader(hDb, &hReader);
 
-	status = sqlite3_exec(
-					pConn->pDb,
-					"begin;",
-					NULL,
-					NULL,
-					&pszError);
-	BAIL_ON_SQLITE3_ERROR(status, pszError);
+	status = RegDbBeginTransaction_inlock(hReader);
+	BAIL_ON_NT_STATUS(status);
 
-	status = RegDbGetKeyAclIndexByKeyId_inlock(hDb, qwKeyDbId, &qwKeyAclId);
+	status = RegDbGetKeyAclIndexByKeyId_inlock(hReader, qwKeyDbId, &qwKeyAclId);
 	BAIL_ON_NT_STATUS(status);
 
 	if (qwKeyAclId != -1)
 	{
-        status = RegDbGetKeyAclByAclIndex_inlock(hDb,
+        status = RegDbGetKeyAclByAclIndex_inlock(hReader,
     	                                         qwKeyAclId,
     		                                     ppSecDescRel,
     		                                     pSecDescLen);
         BAIL_ON_NT_STATUS(status);
 	}
 
-    status = sqlite3_exec(
-    		        pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(hReader);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c RegDbOpenKey() finished");
 
     *pqwKeyAclId = qwKeyAclId;
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbReleaseReader(hDb, &hReader);
 
     return status;
 
 error:
 
-    if (pszError)
+    if (hReader)
     {
-        sqlite3_free(pszError);
+        RegDbRollbackTransaction_inlock(hReader);
     }
-    sqlite3_exec(pConn->pDb,
- 				 "rollback",
- 				 NULL,
-				 NULL,
-				 NULL);
 
     goto cleanup;
 }
@@ -1990,7 +2138,6 @@ RegDbFixAcls(
 {
     NTSTATUS status = 0;
     PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
-    PSTR pszError = NULL;
     BOOLEAN bInLock = FALSE;
     size_t sAclCount = 0;
     int iAclIndex = 0;
@@ -2018,13 +2165,8 @@ RegDbFixAcls(
 
     ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     status = RegDbQueryTotalAclCount_inlock(hDb, &sAclCount);
     BAIL_ON_NT_STATUS(status);
@@ -2184,13 +2326,8 @@ RegDbFixAcls(
         ulGroupLen = 0;
     }
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c RegDbFixAcls() finished");
 
@@ -2206,15 +2343,7 @@ cleanup:
 
 error:
 
-    if (pszError)
-    {
-        sqlite3_free(pszError);
-    }
-    sqlite3_exec(pConn->pDb,
-                 "rollback",
-                 NULL,
-                 NULL,
-                 NULL);
+    RegDbRollbackTransaction_inlock(pConn);
 
     goto cleanup;
 }
@@ -2264,7 +2393,11 @@ RegDbFreePreparedStatements(
         &pConn->pstDeleteValueAttributes,
         &pConn->pstDeleteAllValueAttributes,
         &pConn->pstQueryDefaultValues,
-        &pConn->pstQueryDefaultValuesCount
+        &pConn->pstQueryDefaultValuesCount,
+
+        &pConn->pstBegin,
+        &pConn->pstEnd,
+        &pConn->pstRollback
     };
 
     for (i = 0; i < sizeof(pppstFreeList)/sizeof(pppstFreeList[0]); i++)
@@ -2284,6 +2417,47 @@ error:
     goto cleanup;
 }
 
+static
+VOID
+RegDbCloseReader(
+    IN OUT PREG_DB_CONNECTION* ppReader
+    )
+{
+    PREG_DB_CONNECTION pReader = *ppReader;
+
+    if (pReader)
+    {
+        RegDbFreePreparedStatements(pReader);
+
+        if (pReader->pDb)
+        {
+            sqlite3_close(pReader->pDb);
+        }
+
+        LWREG_SAFE_FREE_MEMORY(pReader);
+        *ppReader = NULL;
+    }
+}
+
+/* All readers must have been released */
+static
+VOID
+RegDbCloseReaders(
+    IN OUT PREG_DB_CONNECTION pConn
+    )
+{
+    PREG_DB_CONNECTION pReader = NULL;
+
+    while (pConn->pFreeReaders)
+    {
+        pReader = pConn->pFreeReaders;
+        pConn->pFreeReaders = pReader->pNextReader;
+        RegDbCloseReader(&pReader);
+    }
+
+    pConn->dwReaderCount = 0;
+}
+
 void
 RegDbSafeClose(
     PREG_DB_HANDLE phDb
@@ -2306,6 +2480,8 @@ RegDbSafeClose(
         goto cleanup;
     }
 
+    RegDbCloseReaders(pConn);
+
     status = RegDbFreePreparedStatements(pConn);
     if (status != STATUS_SUCCESS)
     {
@@ -2325,6 +2501,9 @@ RegDbSafeClose(
         REG_LOG_ERROR("Error destroying lock [%d]", status);
         status = STATUS_SUCCESS;
     }
+
+    pthread_cond_destroy(&pConn->readerCond);
+    pthread_mutex_destroy(&pConn->readerMutex);
     LWREG_SAFE_FREE_MEMORY(pConn);
 
     *phDb = (HANDLE)0;
@@ -53,6 +53,9 @@
     "delete from " REG_DB_TABLE_NAME_CACHE_TAGS " where CacheId NOT IN " \
         "CacheId NOT IN ( select CacheId from " REG_DB_TABLE_NAME_ENTRIES " );\n"
 
+#define REG_DB_MAX_READERS            8
+#define REG_DB_READER_BUSY_TIMEOUT    5000 // milliseconds
+
 typedef struct _REG_DB_CONNECTION
 {
     sqlite3 *pDb;
@@ -97,6 +100,19 @@ typedef struct _REG_DB_CONNECTION
     sqlite3_stmt *pstQueryDefaultValues;
     sqlite3_stmt *pstQueryDefaultValuesCount;
 
+    // transaction control, prepared once instead of on every request
+    sqlite3_stmt *pstBegin;
+    sqlite3_stmt *pstEnd;
+    sqlite3_stmt *pstRollback;
+
+    // Read-only connections to the same database, handed out by
+    // RegDbAcquireReader to callers holding lock shared. If none could
+    // be opened, readers use this connection with lock held exclusively.
+    pthread_mutex_t readerMutex;
+    pthread_cond_t readerCond;
+    DWORD dwReaderCount;
+    struct _REG_DB_CONNECTION* pFreeReaders;
+    struct _REG_DB_CONNECTION* pNextReader;
 
 } REG_DB_CONNECTION, *PREG_DB_CONNECTION;
 
@@ -254,6 +270,18 @@ RegDbOpen(
     OUT PREG_DB_HANDLE phDb
     );
 
+VOID
+RegDbAcquireReader(
+    IN REG_DB_HANDLE hDb,
+    OUT PREG_DB_HANDLE phReader
+    );
+
+VOID
+RegDbReleaseReader(
+    IN REG_DB_HANDLE hDb,
+    IN OUT PREG_DB_HANDLE phReader
+    );
+
 NTSTATUS
 RegDbUpdateRegValues(
     IN HANDLE hDB,
@@ -443,6 +471,21 @@ RegDbFlushNOP(
 
 
 //Inlock db utility functions
+NTSTATUS
+RegDbBeginTransaction_inlock(
+    IN REG_DB_HANDLE hDb
+    );
+
+NTSTATUS
+RegDbEndTransaction_inlock(
+    IN REG_DB_HANDLE hDb
+    );
+
+VOID
+RegDbRollbackTransaction_inlock(
+    IN REG_DB_HANDLE hDb
+    );
+
 NTSTATUS
 RegDbOpenKeyName_inlock(
     IN REG_DB_HANDLE hDb,
@@ -199,7 +199,6 @@ RegDbStoreRegValueAttributes(
     int iColumnPos = 1;
     PREG_DB_VALUE_ATTRIBUTES pEntry = NULL;
     DWORD dwIndex = 0;
-    PSTR pszError = NULL;
     BOOLEAN bGotNow = FALSE;
     time_t now = 0;
     BOOLEAN bInLock = FALSE;
@@ -208,13 +207,8 @@ RegDbStoreRegValueAttributes(
 
     ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
 
     for (dwIndex = 0; dwIndex < dwEntryCount; dwIndex++)
@@ -323,13 +317,8 @@ RegDbStoreRegValueAttributes(
         RTL_FREE(&pRange);
     }
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c RegDbStoreERegValues() finished");
 
@@ -346,15 +335,7 @@ cleanup:
 
  error:
 
-    if (pszError)
-    {
-        sqlite3_free(pszError);
-    }
-    sqlite3_exec(pConn->pDb,
-                 "rollback",
-                 NULL,
-                 NULL,
-                 NULL);
+    RegDbRollbackTransaction_inlock(pConn);
 
     goto cleanup;
 }
@@ -412,7 +393,6 @@ RegDbUpdateRegValueAttributes(
     int iColumnPos = 1;
     PREG_DB_VALUE_ATTRIBUTES pEntry = NULL;
     DWORD dwIndex = 0;
-    PSTR pszError = NULL;
     BOOLEAN bGotNow = FALSE;
     time_t now = 0;
     BOOLEAN bInLock = FALSE;
@@ -421,13 +401,8 @@ RegDbUpdateRegValueAttributes(
 
     ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
 
     for (dwIndex = 0; dwIndex < dwEntryCount; dwIndex++)
@@ -527,13 +502,8 @@ RegDbUpdateRegValueAttributes(
         BAIL_ON_SQLITE3_ERROR_DB(status, pConn->pDb);
     }
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c RegDbStoreEntries() finished");
 
@@ -550,15 +520,7 @@ cleanup:
 
  error:
 
-    if (pszError)
-    {
-        sqlite3_free(pszError);
-    }
-    sqlite3_exec(pConn->pDb,
-                 "rollback",
-                 NULL,
-                 NULL,
-                 NULL);
+    RegDbRollbackTransaction_inlock(pConn);
 
     goto cleanup;
 }
@@ -624,9 +586,7 @@ RegDbGetValueAttributes(
     )
 {
     NTSTATUS status = STATUS_SUCCESS;
-    PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
-    PSTR pszError = NULL;
-    BOOLEAN bInLock = FALSE;
+    REG_DB_HANDLE hReader = NULL;
 
 
     BAIL_ON_NT_INVALID_STRING(pwszValueName);
@@ -637,18 +597,13 @@ RegDbGetValueAttributes(
         BAIL_ON_NT_STATUS(status);
     }
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbAcquireReader(hDb, &hReader);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(hReader);
+    BAIL_ON_NT_STATUS(status);
 
     status = RegDbGetValueAttributes_inlock(
-                                     hDb,
+                                     hReader,
                                      qwParentKeyId,
                                      pwszValueName,
                                      valueType,
@@ -656,33 +611,22 @@ RegDbGetValueAttributes(
                                      ppRegEntry);
     BAIL_ON_NT_STATUS(status);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(hReader);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c RegDbGetValueAttributes() finished");
 
 
 cleanup:
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbReleaseReader(hDb, &hReader);
 
     return status;
 
 error:
-    if (pszError)
+    if (hReader)
     {
-        sqlite3_free(pszError);
+        RegDbRollbackTransaction_inlock(hReader);
     }
-    sqlite3_exec(
-             pConn->pDb,
-            "rollback",
-             NULL,
-             NULL,
-             NULL);
 
     goto cleanup;
 }
@@ -873,53 +817,36 @@ RegDbQueryDefaultValuesCount(
     )
 {
     NTSTATUS status = 0;
-    PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
-    PSTR pszError = NULL;
-    BOOLEAN bInLock = FALSE;
+    REG_DB_HANDLE hReader = NULL;
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbAcquireReader(hDb, &hReader);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(hReader);
+    BAIL_ON_NT_STATUS(status);
 
     status = RegDbQueryDefaultValuesCount_inlock(
-                                 hDb,
+                                 hReader,
                                  qwKeyId,
                                  psCount);
     BAIL_ON_NT_STATUS(status);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(hReader);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c RegDbQueryDefaultValuesCount() finished");
 
 cleanup:
 
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbReleaseReader(hDb, &hReader);
 
     return status;
 
  error:
 
-    if (pszError)
+    if (hReader)
     {
-        sqlite3_free(pszError);
+        RegDbRollbackTransaction_inlock(hReader);
     }
-    sqlite3_exec(pConn->pDb,
-                 "rollback",
-                 NULL,
-                 NULL,
-                 NULL);
 
     goto cleanup;
 }
@@ -1019,9 +946,7 @@ RegDbQueryDefaultValues(
     )
 {
     NTSTATUS status = 0;
-    PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)hDb;
-    PSTR pszError = NULL;
-    BOOLEAN bInLock = FALSE;
+    REG_DB_HANDLE hReader = NULL;
 
     if (qwId <= 0)
     {
@@ -1029,18 +954,13 @@ RegDbQueryDefaultValues(
         BAIL_ON_NT_STATUS(status);
     }
 
-    ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbAcquireReader(hDb, &hReader);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(hReader);
+    BAIL_ON_NT_STATUS(status);
 
     status = RegDbQueryDefaultValues_inlock(
-                                     hDb,
+                                     hReader,
                                      qwId,
                                      dwLimit,
                                      dwOffset,
@@ -1048,33 +968,23 @@ RegDbQueryDefaultValues(
                                      pppRegEntries);
     BAIL_ON_NT_STATUS(status);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(hReader);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c RegDbQueryDefaultValues() finished");
 
 cleanup:
 
-    LEAVE_SQLITE_LOCK(&pConn->lock, bInLock);
+    RegDbReleaseReader(hDb, &hReader);
 
     return status;
 
  error:
 
-    if (pszError)
+    if (hReader)
     {
-        sqlite3_free(pszError);
+        RegDbRollbackTransaction_inlock(hReader);
     }
-    sqlite3_exec(pConn->pDb,
-                 "rollback",
-                 NULL,
-                 NULL,
-                 NULL);
 
     goto cleanup;
 
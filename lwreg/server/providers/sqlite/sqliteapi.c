@@ -993,7 +993,6 @@ SqliteDeleteValue(
     PREG_KEY_CONTEXT pKeyCtx = NULL;
     BOOLEAN bInLock = FALSE;
     PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)ghCacheConnection;
-    PSTR pszError = NULL;
 
 
     BAIL_ON_NT_INVALID_POINTER(pKeyHandle);
@@ -1009,13 +1008,8 @@ SqliteDeleteValue(
 
     ENTER_SQLITE_LOCK(&pConn->lock, bInLock);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     status = RegDbGetKeyValue_inlock((REG_DB_HANDLE)pConn,
     		                         pKeyCtx->qwId,
@@ -1051,13 +1045,8 @@ SqliteDeleteValue(
     }
     BAIL_ON_NT_STATUS(status);
 
-    status = sqlite3_exec(
-                    pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c SqliteDeleteValue() finished");
 
@@ -1073,15 +1062,7 @@ cleanup:
     return status;
 
 error:
-    if (pszError)
-    {
-        sqlite3_free(pszError);
-    }
-    sqlite3_exec(pConn->pDb,
-                 "rollback",
-                 NULL,
-                 NULL,
-                 NULL);
+    RegDbRollbackTransaction_inlock(pConn);
 
     goto cleanup;
 }
@@ -1291,7 +1272,6 @@ SqliteDeleteTree(
     HKEY hCurrKey = NULL;
     BOOLEAN bInDbLock = FALSE;
     BOOLEAN bInLock = FALSE;
-    PSTR pszError = NULL;
     PREG_DB_CONNECTION pConn = (PREG_DB_CONNECTION)ghCacheConnection;
     PREG_SRV_API_STATE pServerState = (PREG_SRV_API_STATE)Handle;
 
@@ -1313,13 +1293,8 @@ SqliteDeleteTree(
 
     ENTER_SQLITE_LOCK(&pConn->lock, bInDbLock);
 
-    status = sqlite3_exec(
-    		        pConn->pDb,
-                    "begin;",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbBeginTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     if (pSubKey)
     {
@@ -1352,13 +1327,8 @@ SqliteDeleteTree(
         BAIL_ON_NT_STATUS(status);
     }
 
-    status = sqlite3_exec(
-    		        pConn->pDb,
-                    "end",
-                    NULL,
-                    NULL,
-                    &pszError);
-    BAIL_ON_SQLITE3_ERROR(status, pszError);
+    status = RegDbEndTransaction_inlock(pConn);
+    BAIL_ON_NT_STATUS(status);
 
     REG_LOG_VERBOSE("Registry::sqldb.c SqliteDeleteTree() finished");
 
@@ -1375,15 +1345,7 @@ cleanup:
     return status;
 
 error:
-    if (pszError)
-    {
-        sqlite3_free(pszError);
-    }
-    sqlite3_exec(pConn->pDb,
-	 			 "rollback",
-	 			 NULL,
-	 		     NULL,
-			     NULL);
+    RegDbRollbackTransaction_inlock(pConn);
 
     goto cleanup;
 }
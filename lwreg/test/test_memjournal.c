@@ -0,0 +1,671 @@
+/*
+ * Copyright Likewise Software
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the license, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.  You should have received a copy
+ * of the GNU Lesser General Public License along with this program.  If
+ * not, see <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * LESSER GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        test_memjournal.c
+ *
+ * Abstract:
+ *
+ *        Registry
+ *
+ *        Memory provider snapshot and journal tests. Runs the provider
+ *        in-process against the scratch directory it is built for.
+ */
+
+#include "includes.h"
+
+#include <uuid/uuid.h>
+#include <lwmsg/lwmsg.h>
+#include <reg/lwntreg.h>
+#include <parse/includes.h>
+#include "rsutils.h"
+#include "regsrvutils.h"
+#include "regserver.h"
+#include "regipc.h"
+#include "regprovspi.h"
+#include "memstore_p.h"
+#include "memdb_p.h"
+#include "memjournal.h"
+#include "memstore.h"
+#include "memapi.h"
+#include "externs.h"
+
+#define TEST_PARAMETERS_KEY "HKEY_THIS_MACHINE\\Services\\memjournal"
+#define TEST_EXPORT_KEY "HKEY_THIS_MACHINE\\Services\\exported"
+
+#define TEST_CHECK(expr)                                        \
+    do                                                          \
+    {                                                           \
+        if (!(expr))                                            \
+        {                                                       \
+            printf("%s:%d: check failed: %s\n",                 \
+                   __FUNCTION__, __LINE__, #expr);              \
+            status = STATUS_UNSUCCESSFUL;                       \
+            BAIL_ON_NT_STATUS(status);                          \
+        }                                                       \
+    } while (0)
+
+/* Owned by the server API; lwregd creates it in RegSrvApiInit() */
+extern PLW_MAP_SECURITY_CONTEXT gpRegLwMapSecurityCtx;
+
+static REG_DB_CONNECTION gTestConn;
+
+static
+VOID
+MemJournalTestRemoveFiles(
+    VOID
+    )
+{
+    unlink(MEMDB_SNAPSHOT_FILE);
+    unlink(MEMDB_SNAPSHOT_FILE ".corrupt");
+    unlink(MEMDB_JOURNAL_FILE);
+    unlink(MEMDB_JOURNAL_FILE ".corrupt");
+    unlink(MEMDB_JOURNAL_FILE ".stale");
+    unlink(MEMDB_EXPORT_FILE);
+}
+
+static
+BOOLEAN
+MemJournalTestFileExists(
+    PCSTR pszPath
+    )
+{
+    struct stat st;
+
+    return stat(pszPath, &st) == 0;
+}
+
+/*
+ * Stands in for a restart of lwregd: a new tree loaded from the files
+ */
+static
+NTSTATUS
+MemJournalTestOpen(
+    PBOOLEAN pbLoaded
+    )
+{
+    NTSTATUS status = 0;
+
+    memset(&gTestConn, 0, sizeof(gTestConn));
+    MemRegRootInit(&gTestConn);
+
+    status = MemDbOpen(&gTestConn.pMemReg);
+    BAIL_ON_NT_STATUS(status);
+
+    status = MemJournalOpen(pbLoaded);
+    BAIL_ON_NT_STATUS(status);
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+static
+VOID
+MemJournalTestClose(
+    VOID
+    )
+{
+    MemDbClose(&gTestConn);
+    MemRegRootInit(NULL);
+}
+
+static
+PMEMREG_NODE
+MemJournalTestFindKey(
+    PCSTR pszPath
+    )
+{
+    PWSTR pwszPath = NULL;
+    PMEMREG_NODE hNode = NULL;
+
+    if (LwRtlWC16StringAllocateFromCString(&pwszPath, pszPath) ||
+        MemRegStoreFindNodeSubkey(MemRegRoot()->pMemReg, pwszPath, &hNode))
+    {
+        hNode = NULL;
+    }
+
+    LWREG_SAFE_FREE_MEMORY(pwszPath);
+    return hNode;
+}
+
+/*
+ * Creates pszName below pszParent, journaled as MemCreateKeyEx does
+ */
+static
+NTSTATUS
+MemJournalTestCreateKey(
+    PCSTR pszParent,
+    PCSTR pszName
+    )
+{
+    NTSTATUS status = 0;
+    PWSTR pwszName = NULL;
+    PMEMREG_NODE hParent = NULL;
+    PMEMREG_NODE hNode = NULL;
+
+    hParent = MemJournalTestFindKey(pszParent);
+    TEST_CHECK(hParent != NULL);
+
+    status = LwRtlWC16StringAllocateFromCString(&pwszName, pszName);
+    BAIL_ON_NT_STATUS(status);
+
+    status = MemRegStoreAddNode(
+                 hParent,
+                 pwszName,
+                 MEMREG_TYPE_KEY,
+                 NULL,
+                 0,
+                 NULL,
+                 &hNode);
+    BAIL_ON_NT_STATUS(status);
+
+    MemJournalLogKey(hNode);
+
+cleanup:
+    LWREG_SAFE_FREE_MEMORY(pwszName);
+    return status;
+
+error:
+    goto cleanup;
+}
+
+static
+NTSTATUS
+MemJournalTestDeleteKey(
+    PCSTR pszPath
+    )
+{
+    NTSTATUS status = 0;
+    PMEMREG_NODE hNode = MemJournalTestFindKey(pszPath);
+
+    TEST_CHECK(hNode != NULL);
+
+    MemJournalLogKeyDelete(hNode);
+    status = MemRegStoreDeleteNode(hNode);
+    BAIL_ON_NT_STATUS(status);
+
+cleanup:
+    return status;
+
+error:
+    goto cleanup;
+}
+
+static
+NTSTATUS
+MemJournalTestSetDword(
+    PCSTR pszKey,
+    PCSTR pszValueName,
+    DWORD dwData
+    )
+{
+    NTSTATUS status = 0;
+    PWSTR pwszValueName = NULL;
+    PMEMREG_NODE hNode = NULL;
+    PMEMREG_VALUE pValue = NULL;
+
+    hNode = MemJournalTestFindKey(pszKey);
+    TEST_CHECK(hNode != NULL);
+
+    status = LwRtlWC16StringAllocateFromCString(&pwszValueName, pszValueName);
+    BAIL_ON_NT_STATUS(status);
+
+    if (MemRegStoreFindNodeValue(hNode, pwszValueName, &pValue))
+    {
+        status = MemRegStoreAddNodeValue(
+                     hNode,
+                     pwszValueName,
+                     0,
+                     REG_DWORD,
+                     (PBYTE) &dwData,
+                     sizeof(dwData));
+    }
+    else
+    {
+        status = MemRegStoreChangeNodeValue(
+                     pValue,
+                     (PBYTE) &dwData,
+                     sizeof(dwData));
+    }
+    BAIL_ON_NT_STATUS(status);
+
+    MemJournalLogValue(hNode, pwszValueName);
+
+cleanup:
+    LWREG_SAFE_FREE_MEMORY(pwszValueName);
+    return status;
+
+error:
+    goto cleanup;
+}
+
+static
+NTSTATUS
+MemJournalTestCheckDword(
+    PCSTR pszKey,
+    PCSTR pszValueName,
+    DWORD dwExpected
+    )
+{
+    NTSTATUS status = 0;
+    PWSTR pwszValueName = NULL;
+    PMEMREG_NODE hNode = NULL;
+    PMEMREG_VALUE pValue = NULL;
+    DWORD dwData = 0;
+
+    hNode = MemJournalTestFindKey(pszKey);
+    TEST_CHECK(hNode != NULL);
+
+    status = LwRtlWC16StringAllocateFromCString(&pwszValueName, pszValueName);
+    BAIL_ON_NT_STATUS(status);
+
+    status = MemRegStoreFindNodeValue(hNode, pwszValueName, &pValue);
+    BAIL_ON_NT_STATUS(status);
+
+    TEST_CHECK(pValue->Type == REG_DWORD);
+    TEST_CHECK(pValue->DataLen == sizeof(dwData));
+    memcpy(&dwData, pValue->Data, sizeof(dwData));
+    if (dwData != dwExpected)
+    {
+        printf("%s\\%s is %u, expected %u\n",
+               pszKey, pszValueName, dwData, dwExpected);
+        status = STATUS_UNSUCCESSFUL;
+        BAIL_ON_NT_STATUS(status);
+    }
+
+cleanup:
+    LWREG_SAFE_FREE_MEMORY(pwszValueName);
+    return status;
+
+error:
+    goto cleanup;
+}
+
+static
+NTSTATUS
+MemJournalTestAppendFile(
+    PCSTR pszPath,
+    PCSTR pszData
+    )
+{
+    NTSTATUS status = 0;
+    FILE *fp = fopen(pszPath, "a");
+
+    TEST_CHECK(fp != NULL);
+    TEST_CHECK(fputs(pszData, fp) >= 0);
+
+cleanup:
+    if (fp)
+    {
+        fclose(fp);
+    }
+    return status;
+
+error:
+    goto cleanup;
+}
+
+static
+NTSTATUS
+MemJournalTestCopyFile(
+    PCSTR pszFrom,
+    PCSTR pszTo
+    )
+{
+    NTSTATUS status = 0;
+    FILE *fpFrom = fopen(pszFrom, "r");
+    FILE *fpTo = fopen(pszTo, "w");
+    char buf[4096];
+    size_t len = 0;
+
+    TEST_CHECK(fpFrom != NULL && fpTo != NULL);
+
+    while ((len = fread(buf, 1, sizeof(buf), fpFrom)) > 0)
+    {
+        TEST_CHECK(fwrite(buf, 1, len, fpTo) == len);
+    }
+
+cleanup:
+    if (fpFrom)
+    {
+        fclose(fpFrom);
+    }
+    if (fpTo)
+    {
+        fclose(fpTo);
+    }
+    return status;
+
+error:
+    goto cleanup;
+}
+
+/*
+ * A compacted tree comes back from the snapshot alone
+ */
+static
+NTSTATUS
+MemJournalTestSnapshot(
+    VOID
+    )
+{
+    NTSTATUS status = 0;
+    BOOLEAN bLoaded = FALSE;
+    ULONG64 Size = 0;
+
+    MemJournalTestRemoveFiles();
+
+    status = MemJournalTestOpen(&bLoaded);
+    BAIL_ON_NT_STATUS(status);
+    TEST_CHECK(!bLoaded);
+
+    status = MemJournalTestCreateKey("HKEY_THIS_MACHINE", "Services");
+    BAIL_ON_NT_STATUS(status);
+    status = MemJournalTestCreateKey("HKEY_THIS_MACHINE\\Services",
+                                     "memjournal");
+    BAIL_ON_NT_STATUS(status);
+    status = MemJournalTestSetDword(TEST_PARAMETERS_KEY, "LogLevel", 5);
+    BAIL_ON_NT_STATUS(status);
+
+    status = MemJournalCompact();
+    BAIL_ON_NT_STATUS(status);
+    Size = MemRegRoot()->pJournal->Size;
+    MemJournalTestClose();
+
+    /* Nothing but the journal header follows the snapshot */
+    status = MemJournalTestOpen(&bLoaded);
+    BAIL_ON_NT_STATUS(status);
+    TEST_CHECK(bLoaded);
+    TEST_CHECK(MemRegRoot()->pJournal->Size == Size);
+    TEST_CHECK(!MemRegRoot()->pJournal->bFailed);
+
+    status = MemJournalTestCheckDword(TEST_PARAMETERS_KEY, "LogLevel", 5);
+    BAIL_ON_NT_STATUS(status);
+
+cleanup:
+    MemJournalTestClose();
+    return status;
+
+error:
+    goto cleanup;
+}
+
+/*
+ * Changes made after the snapshot are replayed from the journal
+ */
+static
+NTSTATUS
+MemJournalTestReplay(
+    VOID
+    )
+{
+    NTSTATUS status = 0;
+    BOOLEAN bLoaded = FALSE;
+    ULONG64 Size = 0;
+
+    status = MemJournalTestOpen(&bLoaded);
+    BAIL_ON_NT_STATUS(status);
+
+    status = MemJournalTestSetDword(TEST_PARAMETERS_KEY, "LogLevel", 6);
+    BAIL_ON_NT_STATUS(status);
+    status = MemJournalTestCreateKey(TEST_PARAMETERS_KEY, "kept");
+    BAIL_ON_NT_STATUS(status);
+    status = MemJournalTestCreateKey(TEST_PARAMETERS_KEY, "gone");
+    BAIL_ON_NT_STATUS(status);
+    Size = MemRegRoot()->pJournal->Size;
+    status = MemJournalTestDeleteKey(TEST_PARAMETERS_KEY "\\gone");
+    BAIL_ON_NT_STATUS(status);
+    TEST_CHECK(MemRegRoot()->pJournal->Size > Size);
+    MemJournalTestClose();
+
+    status = MemJournalTestOpen(&bLoaded);
+    BAIL_ON_NT_STATUS(status);
+    TEST_CHECK(bLoaded);
+
+    status = MemJournalTestCheckDword(TEST_PARAMETERS_KEY, "LogLevel", 6);
+    BAIL_ON_NT_STATUS(status);
+    TEST_CHECK(MemJournalTestFindKey(TEST_PARAMETERS_KEY "\\kept") != NULL);
+    TEST_CHECK(MemJournalTestFindKey(TEST_PARAMETERS_KEY "\\gone") == NULL);
+
+cleanup:
+    MemJournalTestClose();
+    return status;
+
+error:
+    goto cleanup;
+}
+
+/*
+ * A record cut short by a crash is dropped and later appends follow the
+ * last intact record
+ */
+static
+NTSTATUS
+MemJournalTestTornTail(
+    VOID
+    )
+{
+    NTSTATUS status = 0;
+    BOOLEAN bLoaded = FALSE;
+    ULONG64 Size = 0;
+    struct stat st;
+
+    status = MemJournalTestOpen(&bLoaded);
+    BAIL_ON_NT_STATUS(status);
+    Size = MemRegRoot()->pJournal->Size;
+    MemJournalTestClose();
+
+    status = MemJournalTestAppendFile(MEMDB_JOURNAL_FILE, "\x40torn");
+    BAIL_ON_NT_STATUS(status);
+
+    status = MemJournalTestOpen(&bLoaded);
+    BAIL_ON_NT_STATUS(status);
+    TEST_CHECK(bLoaded);
+    TEST_CHECK(!MemRegRoot()->pJournal->bFailed);
+    TEST_CHECK(MemRegRoot()->pJournal->Size == Size);
+    TEST_CHECK(stat(MEMDB_JOURNAL_FILE, &st) == 0 && st.st_size == Size);
+
+    status = MemJournalTestCheckDword(TEST_PARAMETERS_KEY, "LogLevel", 6);
+    BAIL_ON_NT_STATUS(status);
+
+    status = MemJournalTestSetDword(TEST_PARAMETERS_KEY, "LogLevel", 7);
+    BAIL_ON_NT_STATUS(status);
+    MemJournalTestClose();
+
+    status = MemJournalTestOpen(&bLoaded);
+    BAIL_ON_NT_STATUS(status);
+    TEST_CHECK(bLoaded);
+
+    status = MemJournalTestCheckDword(TEST_PARAMETERS_KEY, "LogLevel", 7);
+    BAIL_ON_NT_STATUS(status);
+
+cleanup:
+    MemJournalTestClose();
+    return status;
+
+error:
+    goto cleanup;
+}
+
+/*
+ * A journal from before the last compaction is already in the snapshot
+ * and must not be replayed over it
+ */
+static
+NTSTATUS
+MemJournalTestGeneration(
+    VOID
+    )
+{
+    NTSTATUS status = 0;
+    BOOLEAN bLoaded = FALSE;
+
+    status = MemJournalTestOpen(&bLoaded);
+    BAIL_ON_NT_STATUS(status);
+
+    status = MemJournalTestSetDword(TEST_PARAMETERS_KEY, "LogLevel", 8);
+    BAIL_ON_NT_STATUS(status);
+    status = MemJournalTestCopyFile(MEMDB_JOURNAL_FILE,
+                                    MEMDB_JOURNAL_FILE ".stale");
+    BAIL_ON_NT_STATUS(status);
+
+    status = MemJournalTestSetDword(TEST_PARAMETERS_KEY, "LogLevel", 9);
+    BAIL_ON_NT_STATUS(status);
+    status = MemJournalCompact();
+    BAIL_ON_NT_STATUS(status);
+    MemJournalTestClose();
+
+    TEST_CHECK(rename(MEMDB_JOURNAL_FILE ".stale", MEMDB_JOURNAL_FILE) == 0);
+
+    status = MemJournalTestOpen(&bLoaded);
+    BAIL_ON_NT_STATUS(status);
+    TEST_CHECK(bLoaded);
+    TEST_CHECK(MemRegRoot()->pJournal->bFailed);
+
+    status = MemJournalTestCheckDword(TEST_PARAMETERS_KEY, "LogLevel", 9);
+    BAIL_ON_NT_STATUS(status);
+
+cleanup:
+    MemJournalTestClose();
+    return status;
+
+error:
+    goto cleanup;
+}
+
+/*
+ * A damaged snapshot is moved aside and the provider starts from the
+ * text export instead
+ */
+static
+NTSTATUS
+MemJournalTestCorrupt(
+    VOID
+    )
+{
+    NTSTATUS status = 0;
+    PREGPROV_PROVIDER_FUNCTION_TABLE pFnTable = NULL;
+    struct stat st;
+    FILE *fp = NULL;
+    int byte = 0;
+
+    TEST_CHECK(stat(MEMDB_SNAPSHOT_FILE, &st) == 0 && st.st_size > 1);
+
+    /* Flip a byte in the middle, past the file header */
+    fp = fopen(MEMDB_SNAPSHOT_FILE, "r+");
+    TEST_CHECK(fp != NULL);
+    TEST_CHECK(fseek(fp, st.st_size / 2, SEEK_SET) == 0);
+    byte = fgetc(fp);
+    TEST_CHECK(byte != EOF);
+    TEST_CHECK(fseek(fp, st.st_size / 2, SEEK_SET) == 0);
+    TEST_CHECK(fputc(~byte & 0xff, fp) != EOF);
+    fclose(fp);
+    fp = NULL;
+
+    status = MemJournalTestAppendFile(
+                 MEMDB_EXPORT_FILE,
+                 "[HKEY_THIS_MACHINE\\Services]\n"
+                 "[" TEST_EXPORT_KEY "]\n"
+                 "\"LogLevel\"=dword:0000002a\n");
+    BAIL_ON_NT_STATUS(status);
+
+    status = MemProvider_Initialize(&pFnTable, NULL);
+    BAIL_ON_NT_STATUS(status);
+
+    TEST_CHECK(MemJournalTestFileExists(MEMDB_SNAPSHOT_FILE ".corrupt"));
+    TEST_CHECK(MemJournalTestFileExists(MEMDB_JOURNAL_FILE ".corrupt"));
+    TEST_CHECK(MemJournalTestFindKey(TEST_PARAMETERS_KEY) == NULL);
+
+    status = MemJournalTestCheckDword(TEST_EXPORT_KEY, "LogLevel", 42);
+    BAIL_ON_NT_STATUS(status);
+
+    /* The import was compacted into a fresh snapshot */
+    TEST_CHECK(MemJournalTestFileExists(MEMDB_SNAPSHOT_FILE));
+    TEST_CHECK(!MemRegRoot()->pJournal->bFailed);
+
+cleanup:
+    if (fp)
+    {
+        fclose(fp);
+    }
+    if (pFnTable)
+    {
+        MemProvider_Shutdown(pFnTable);
+    }
+    return status;
+
+error:
+    goto cleanup;
+}
+
+int main(int argc, char *argv[])
+{
+    NTSTATUS status = 0;
+
+    status = LwMapSecurityCreateContext(&gpRegLwMapSecurityCtx);
+    BAIL_ON_NT_STATUS(status);
+
+    mkdir(MEMDB_EXPORT_DIR, 0700);
+
+    printf("Snapshot round trip\n");
+    status = MemJournalTestSnapshot();
+    BAIL_ON_NT_STATUS(status);
+
+    printf("Journal replay\n");
+    status = MemJournalTestReplay();
+    BAIL_ON_NT_STATUS(status);
+
+    printf("Torn journal tail\n");
+    status = MemJournalTestTornTail();
+    BAIL_ON_NT_STATUS(status);
+
+    printf("Stale journal generation\n");
+    status = MemJournalTestGeneration();
+    BAIL_ON_NT_STATUS(status);
+
+    printf("Corrupt snapshot\n");
+    status = MemJournalTestCorrupt();
+    BAIL_ON_NT_STATUS(status);
+
+    printf("All memory provider journal tests passed\n");
+
+cleanup:
+    MemJournalTestRemoveFiles();
+    LwMapSecurityFreeContext(&gpRegLwMapSecurityCtx);
+    return status ? 1 : 0;
+
+error:
+    printf("Failed with status 0x%x (%s)\n",
+           status, LwNtStatusToName(status));
+    goto cleanup;
+}
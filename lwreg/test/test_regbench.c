@@ -0,0 +1,443 @@
+/*
+ * Copyright Likewise Software
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the license, or (at
+ * your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+ * General Public License for more details.  You should have received a copy
+ * of the GNU Lesser General Public License along with this program.  If
+ * not, see <http://www.gnu.org/licenses/>.
+ *
+ * LIKEWISE SOFTWARE MAKES THIS SOFTWARE AVAILABLE UNDER OTHER LICENSING
+ * TERMS AS WELL.  IF YOU HAVE ENTERED INTO A SEPARATE LICENSE AGREEMENT
+ * WITH LIKEWISE SOFTWARE, THEN YOU MAY ELECT TO USE THE SOFTWARE UNDER THE
+ * TERMS OF THAT SOFTWARE LICENSE AGREEMENT INSTEAD OF THE TERMS OF THE GNU
+ * LESSER GENERAL PUBLIC LICENSE, NOTWITHSTANDING THE ABOVE NOTICE.  IF YOU
+ * HAVE QUESTIONS, OR WISH TO REQUEST A COPY OF THE ALTERNATE LICENSING
+ * TERMS OFFERED BY LIKEWISE SOFTWARE, PLEASE CONTACT LIKEWISE SOFTWARE AT
+ * license@likewisesoftware.com
+ */
+
+/*
+ * Copyright (C) Likewise Software. All rights reserved.
+ *
+ * Module Name:
+ *
+ *        test_regbench.c
+ *
+ * Abstract:
+ *
+ *        Registry
+ *
+ *        Multi-threaded lwregd benchmark driving a mixed
+ *        read/write/enumerate load
+ */
+
+#include "includes.h"
+
+#include <pthread.h>
+#include <sys/time.h>
+
+#define REGBENCH_KEY "regbench"
+#define REGBENCH_VALUES_PER_KEY 8
+
+#define REGBENCH_DEFAULT_THREADS 4
+#define REGBENCH_DEFAULT_SECONDS 10
+#define REGBENCH_DEFAULT_KEYS 64
+#define REGBENCH_DEFAULT_READ_PERCENT 80
+#define REGBENCH_DEFAULT_WRITE_PERCENT 10
+
+typedef enum _REGBENCH_OP
+{
+    REGBENCH_OP_READ = 0,
+    REGBENCH_OP_WRITE,
+    REGBENCH_OP_ENUM,
+    REGBENCH_OP_COUNT
+} REGBENCH_OP;
+
+typedef struct _REGBENCH_CONTEXT
+{
+    pthread_t thread;
+    DWORD dwThreadNum;
+    DWORD dwKeys;
+    DWORD dwReadPercent;
+    DWORD dwWritePercent;
+    double dDeadline;
+    ULONG64 Ops[REGBENCH_OP_COUNT];
+    DWORD dwError;
+} REGBENCH_CONTEXT, *PREGBENCH_CONTEXT;
+
+static PCSTR gpszOpNames[REGBENCH_OP_COUNT] = { "read", "write", "enumerate" };
+
+static
+double
+RegBenchNow(
+    VOID
+    )
+{
+    struct timeval tv = {0};
+
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static
+DWORD
+RegBenchPopulate(
+    DWORD dwKeys
+    )
+{
+    DWORD dwError = 0;
+    HANDLE hReg = NULL;
+    HKEY hRootKey = NULL;
+    HKEY hBenchKey = NULL;
+    HKEY hSubKey = NULL;
+    CHAR szName[32];
+    DWORD dwKey = 0;
+    DWORD dwValue = 0;
+
+    dwError = RegOpenServer(&hReg);
+    BAIL_ON_REG_ERROR(dwError);
+
+    dwError = RegOpenKeyExA(hReg, NULL, HKEY_THIS_MACHINE, 0, KEY_ALL_ACCESS, &hRootKey);
+    BAIL_ON_REG_ERROR(dwError);
+
+    // Start from a clean tree so earlier runs do not skew the results
+    dwError = RegDeleteTreeA(hReg, hRootKey, REGBENCH_KEY);
+    if (dwError == LWREG_ERROR_NO_SUCH_KEY_OR_VALUE)
+    {
+        dwError = 0;
+    }
+    BAIL_ON_REG_ERROR(dwError);
+
+    dwError = RegCreateKeyExA(hReg, hRootKey, REGBENCH_KEY, 0, NULL, 0,
+                              KEY_ALL_ACCESS, NULL, &hBenchKey, NULL);
+    BAIL_ON_REG_ERROR(dwError);
+
+    for (dwKey = 0; dwKey < dwKeys; dwKey++)
+    {
+        snprintf(szName, sizeof(szName), "key-%u", dwKey);
+
+        dwError = RegCreateKeyExA(hReg, hBenchKey, szName, 0, NULL, 0,
+                                  KEY_ALL_ACCESS, NULL, &hSubKey, NULL);
+        BAIL_ON_REG_ERROR(dwError);
+
+        for (dwValue = 0; dwValue < REGBENCH_VALUES_PER_KEY; dwValue++)
+        {
+            snprintf(szName, sizeof(szName), "value-%u", dwValue);
+
+            dwError = RegSetValueExA(hReg, hSubKey, szName, 0, REG_DWORD,
+                                     (PBYTE)&dwValue, sizeof(dwValue));
+            BAIL_ON_REG_ERROR(dwError);
+        }
+
+        RegCloseKey(hReg, hSubKey);
+        hSubKey = NULL;
+    }
+
+cleanup:
+    if (hSubKey)
+    {
+        RegCloseKey(hReg, hSubKey);
+    }
+    if (hBenchKey)
+    {
+        RegCloseKey(hReg, hBenchKey);
+    }
+    if (hRootKey)
+    {
+        RegCloseKey(hReg, hRootKey);
+    }
+    if (hReg)
+    {
+        RegCloseServer(hReg);
+    }
+    return dwError;
+
+error:
+    RegPrintError("RegBenchPopulate", dwError);
+    goto cleanup;
+}
+
+static
+DWORD
+RegBenchEnumerate(
+    HANDLE hReg,
+    HKEY hKey
+    )
+{
+    DWORD dwError = 0;
+    DWORD dwIndex = 0;
+    CHAR szValueName[MAX_VALUE_LENGTH];
+    DWORD dwValueNameLen = 0;
+    DWORD dwType = 0;
+    BYTE data[MAX_VALUE_LENGTH];
+    DWORD dwDataLen = 0;
+
+    for (dwIndex = 0; ; dwIndex++)
+    {
+        dwValueNameLen = sizeof(szValueName);
+        dwDataLen = sizeof(data);
+
+        dwError = RegEnumValueA(hReg, hKey, dwIndex, szValueName, &dwValueNameLen,
+                                NULL, &dwType, data, &dwDataLen);
+        if (dwError == LWREG_ERROR_NO_MORE_KEYS_OR_VALUES)
+        {
+            dwError = 0;
+            break;
+        }
+        BAIL_ON_REG_ERROR(dwError);
+    }
+
+error:
+    return dwError;
+}
+
+static
+PVOID
+RegBenchThread(
+    PVOID pArg
+    )
+{
+    PREGBENCH_CONTEXT pCtx = (PREGBENCH_CONTEXT)pArg;
+    DWORD dwError = 0;
+    HANDLE hReg = NULL;
+    HKEY hRootKey = NULL;
+    HKEY hBenchKey = NULL;
+    HKEY hSubKey = NULL;
+    CHAR szKeyPath[64];
+    CHAR szValueName[32];
+    unsigned int seed = pCtx->dwThreadNum + 1;
+    DWORD dwRoll = 0;
+    DWORD dwData = 0;
+    DWORD dwDataLen = 0;
+    DWORD dwIteration = 0;
+
+    dwError = RegOpenServer(&hReg);
+    BAIL_ON_REG_ERROR(dwError);
+
+    dwError = RegOpenKeyExA(hReg, NULL, HKEY_THIS_MACHINE, 0, KEY_ALL_ACCESS, &hRootKey);
+    BAIL_ON_REG_ERROR(dwError);
+
+    dwError = RegOpenKeyExA(hReg, hRootKey, REGBENCH_KEY, 0, KEY_ALL_ACCESS, &hBenchKey);
+    BAIL_ON_REG_ERROR(dwError);
+
+    // Checking the clock is not free, so only do it every few operations
+    for (dwIteration = 0;
+         (dwIteration % 64) || RegBenchNow() < pCtx->dDeadline;
+         dwIteration++)
+    {
+        snprintf(szKeyPath, sizeof(szKeyPath), "key-%u",
+                 (DWORD)rand_r(&seed) % pCtx->dwKeys);
+        snprintf(szValueName, sizeof(szValueName), "value-%u",
+                 (DWORD)rand_r(&seed) % REGBENCH_VALUES_PER_KEY);
+        dwRoll = (DWORD)rand_r(&seed) % 100;
+
+        if (dwRoll < pCtx->dwReadPercent)
+        {
+            dwDataLen = sizeof(dwData);
+
+            dwError = RegGetValueA(hReg, hBenchKey, szKeyPath, szValueName,
+                                   RRF_RT_REG_DWORD, NULL, &dwData, &dwDataLen);
+            BAIL_ON_REG_ERROR(dwError);
+
+            pCtx->Ops[REGBENCH_OP_READ]++;
+            continue;
+        }
+
+        dwError = RegOpenKeyExA(hReg, hBenchKey, szKeyPath, 0,
+                                KEY_ALL_ACCESS, &hSubKey);
+        BAIL_ON_REG_ERROR(dwError);
+
+        if (dwRoll < pCtx->dwReadPercent + pCtx->dwWritePercent)
+        {
+            dwData = dwIteration;
+
+            dwError = RegSetValueExA(hReg, hSubKey, szValueName, 0, REG_DWORD,
+                                     (PBYTE)&dwData, sizeof(dwData));
+            BAIL_ON_REG_ERROR(dwError);
+
+            pCtx->Ops[REGBENCH_OP_WRITE]++;
+        }
+        else
+        {
+            dwError = RegBenchEnumerate(hReg, hSubKey);
+            BAIL_ON_REG_ERROR(dwError);
+
+            pCtx->Ops[REGBENCH_OP_ENUM]++;
+        }
+
+        RegCloseKey(hReg, hSubKey);
+        hSubKey = NULL;
+    }
+
+cleanup:
+    if (hSubKey)
+    {
+        RegCloseKey(hReg, hSubKey);
+    }
+    if (hBenchKey)
+    {
+        RegCloseKey(hReg, hBenchKey);
+    }
+    if (hRootKey)
+    {
+        RegCloseKey(hReg, hRootKey);
+    }
+    if (hReg)
+    {
+        RegCloseServer(hReg);
+    }
+    pCtx->dwError = dwError;
+    return NULL;
+
+error:
+    RegPrintError("RegBenchThread", dwError);
+    goto cleanup;
+}
+
+static
+VOID
+RegBenchUsage(
+    PCSTR pszProgram
+    )
+{
+    printf("usage: %s [-t threads] [-s seconds] [-k keys] "
+           "[-r read%%] [-w write%%]\n"
+           "  Operations that are neither reads nor writes enumerate the\n"
+           "  values of a key. Defaults: -t %d -s %d -k %d -r %d -w %d\n",
+           pszProgram,
+           REGBENCH_DEFAULT_THREADS,
+           REGBENCH_DEFAULT_SECONDS,
+           REGBENCH_DEFAULT_KEYS,
+           REGBENCH_DEFAULT_READ_PERCENT,
+           REGBENCH_DEFAULT_WRITE_PERCENT);
+}
+
+int main(int argc, char *argv[])
+{
+    DWORD dwError = 0;
+    PREGBENCH_CONTEXT pContexts = NULL;
+    DWORD dwThreads = REGBENCH_DEFAULT_THREADS;
+    DWORD dwSeconds = REGBENCH_DEFAULT_SECONDS;
+    DWORD dwKeys = REGBENCH_DEFAULT_KEYS;
+    DWORD dwReadPercent = REGBENCH_DEFAULT_READ_PERCENT;
+    DWORD dwWritePercent = REGBENCH_DEFAULT_WRITE_PERCENT;
+    ULONG64 Totals[REGBENCH_OP_COUNT] = {0};
+    ULONG64 Total = 0;
+    double dStart = 0;
+    double dElapsed = 0;
+    DWORD dwStarted = 0;
+    DWORD i = 0;
+    DWORD op = 0;
+    int opt = 0;
+
+    while ((opt = getopt(argc, argv, "t:s:k:r:w:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 't':
+                dwThreads = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                dwSeconds = strtoul(optarg, NULL, 10);
+                break;
+            case 'k':
+                dwKeys = strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                dwReadPercent = strtoul(optarg, NULL, 10);
+                break;
+            case 'w':
+                dwWritePercent = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                RegBenchUsage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (!dwThreads || !dwSeconds || !dwKeys ||
+        dwReadPercent + dwWritePercent > 100)
+    {
+        RegBenchUsage(argv[0]);
+        return 1;
+    }
+
+    printf("Populating %u keys with %u values each\n",
+           dwKeys, REGBENCH_VALUES_PER_KEY);
+
+    dwError = RegBenchPopulate(dwKeys);
+    BAIL_ON_REG_ERROR(dwError);
+
+    dwError = RegAllocateMemory(sizeof(*pContexts) * dwThreads, (PVOID*)&pContexts);
+    BAIL_ON_REG_ERROR(dwError);
+
+    printf("Running %u threads for %u seconds: %u%% read, %u%% write, "
+           "%u%% enumerate\n",
+           dwThreads, dwSeconds, dwReadPercent, dwWritePercent,
+           100 - dwReadPercent - dwWritePercent);
+
+    dStart = RegBenchNow();
+
+    for (i = 0; i < dwThreads; i++)
+    {
+        pContexts[i].dwThreadNum = i;
+        pContexts[i].dwKeys = dwKeys;
+        pContexts[i].dwReadPercent = dwReadPercent;
+        pContexts[i].dwWritePercent = dwWritePercent;
+        pContexts[i].dDeadline = dStart + dwSeconds;
+
+        dwError = pthread_create(&pContexts[i].thread, NULL,
+                                 RegBenchThread, &pContexts[i]);
+        if (dwError)
+        {
+            printf("pthread_create: Error %u\n", dwError);
+            break;
+        }
+        dwStarted++;
+    }
+
+    for (i = 0; i < dwStarted; i++)
+    {
+        pthread_join(pContexts[i].thread, NULL);
+
+        for (op = 0; op < REGBENCH_OP_COUNT; op++)
+        {
+            Totals[op] += pContexts[i].Ops[op];
+        }
+
+        if (!dwError)
+        {
+            dwError = pContexts[i].dwError;
+        }
+    }
+
+    dElapsed = RegBenchNow() - dStart;
+
+    for (op = 0; op < REGBENCH_OP_COUNT; op++)
+    {
+        printf("%-10s %12llu ops %12.1f ops/sec\n",
+               gpszOpNames[op],
+               (unsigned long long)Totals[op],
+               Totals[op] / dElapsed);
+        Total += Totals[op];
+    }
+
+    printf("%-10s %12llu ops %12.1f ops/sec\n",
+           "total", (unsigned long long)Total, Total / dElapsed);
+
+cleanup:
+    LWREG_SAFE_FREE_MEMORY(pContexts);
+    return dwError ? 1 : 0;
+
+error:
+    goto cleanup;
+}
@@ -76,6 +76,9 @@ LWNetSvcmStart(
 {
     DWORD dwError = 0;
 
+    dwError = RegEnableValueCache();
+    BAIL_ON_LWNET_ERROR(dwError);
+
     dwError = LWNetSrvSetDefaults();
     BAIL_ON_LWNET_ERROR(dwError);
 
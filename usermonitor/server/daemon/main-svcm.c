@@ -77,6 +77,9 @@ SvcmStart(
 {
     DWORD dwError = 0;
 
+    dwError = RegEnableValueCache();
+    BAIL_ON_UMN_ERROR(dwError);
+
     dwError = pthread_rwlock_init(&gUmnConfigLock, NULL);
     BAIL_ON_UMN_ERROR(dwError);
 